@@ -0,0 +1,593 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "AudioTransform.h"
+
+// Frames converted per pass through the planar scratch, which keeps the scratch for
+// 64 channels within L2
+static const uint32_t	kBlockFrames	= 256;
+
+static const float		kInt16Scale		= 32768.0f;
+static const float		kInt32Scale		= 2147483648.0f;
+// Largest float below 2^31, full scale positive input would overflow int32
+static const float		kInt32Max		= 2147483520.0f;
+// Dither random numbers keep their top 24 bits
+static const float		kDitherScale	= 1.0f / 16777216.0f;
+
+// Scalar kernels, also used for the frames and channels the vector loops leave over
+
+static inline uint32_t NextRandom(uint32_t& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+// Triangular PDF dither in 16-bit LSBs, between -1 and 1
+static inline float Triangular(uint32_t* state)
+{
+	int32_t a = (int32_t)(NextRandom(state[0]) >> 8);
+	int32_t b = (int32_t)(NextRandom(state[0]) >> 8);
+	return (a - b) * kDitherScale;
+}
+
+static inline float LoadSample(const int16_t* p)	{ return *p * (1.0f / kInt16Scale); }
+static inline float LoadSample(const int32_t* p)	{ return *p * (1.0f / kInt32Scale); }
+static inline float LoadSample(const float* p)		{ return *p; }
+
+static inline void StoreSample(int16_t* p, float value, uint32_t* dither)
+{
+	float sample = value * kInt16Scale;
+	if (dither != NULL)
+		sample += Triangular(dither);
+	*p = (int16_t)lrintf(std::min(std::max(sample, -32768.0f), 32767.0f));
+}
+
+static inline void StoreSample(int32_t* p, float value, uint32_t*)
+{
+	*p = (int32_t)lrintf(std::min(std::max(value * kInt32Scale, -kInt32Scale), kInt32Max));
+}
+
+static inline void StoreSample(float* p, float value, uint32_t*)
+{
+	*p = value;
+}
+
+#if defined(__SSE2__)
+
+// Vector kernels, four samples at a time
+
+static inline __m128i NextRandom4(__m128i state)
+{
+	state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+	state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+	return _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+}
+
+static inline __m128 Triangular4(__m128i& state)
+{
+	state = NextRandom4(state);
+	__m128i a = _mm_srli_epi32(state, 8);
+	state = NextRandom4(state);
+	__m128i b = _mm_srli_epi32(state, 8);
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(a, b)), _mm_set1_ps(kDitherScale));
+}
+
+static inline __m128 Load4(const int16_t* p)
+{
+	__m128i v = _mm_loadl_epi64((const __m128i*)p);
+	v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+	return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f / kInt16Scale));
+}
+
+static inline __m128 Load4(const int32_t* p)
+{
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)p)), _mm_set1_ps(1.0f / kInt32Scale));
+}
+
+static inline __m128 Load4(const float* p)
+{
+	return _mm_loadu_ps(p);
+}
+
+static inline void Store4(int16_t* p, __m128 value, __m128i* dither)
+{
+	value = _mm_mul_ps(value, _mm_set1_ps(kInt16Scale));
+	if (dither != NULL)
+		value = _mm_add_ps(value, Triangular4(*dither));
+	value = _mm_min_ps(_mm_max_ps(value, _mm_set1_ps(-32768.0f)), _mm_set1_ps(32767.0f));
+
+	__m128i v = _mm_cvtps_epi32(value);
+	_mm_storel_epi64((__m128i*)p, _mm_packs_epi32(v, v));
+}
+
+static inline void Store4(int32_t* p, __m128 value, __m128i*)
+{
+	value = _mm_mul_ps(value, _mm_set1_ps(kInt32Scale));
+	value = _mm_min_ps(_mm_max_ps(value, _mm_set1_ps(-kInt32Scale)), _mm_set1_ps(kInt32Max));
+	_mm_storeu_si128((__m128i*)p, _mm_cvtps_epi32(value));
+}
+
+static inline void Store4(float* p, __m128 value, __m128i*)
+{
+	_mm_storeu_ps(p, value);
+}
+
+#endif
+
+// Interleaved samples to one float plane per channel
+template <typename T>
+static void Deinterleave(const T* input, int channels, uint32_t frames, float* planes)
+{
+	int c = 0;
+#if defined(__SSE2__)
+	if (channels == 2)
+	{
+		uint32_t f = 0;
+		for (; f + 4 <= frames; f += 4)
+		{
+			__m128 a = Load4(input + f * 2);
+			__m128 b = Load4(input + f * 2 + 4);
+			_mm_storeu_ps(planes + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(planes + kBlockFrames + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+		for (; f < frames; f++)
+		{
+			planes[f]					= LoadSample(input + f * 2);
+			planes[kBlockFrames + f]	= LoadSample(input + f * 2 + 1);
+		}
+		return;
+	}
+
+	// Transpose 4 frames by 4 channels at a time.  Each group of channels is done for
+	// the whole block, so the planes are written in order.
+	for (; c + 4 <= channels; c += 4)
+	{
+		float*		plane = planes + c * kBlockFrames;
+		uint32_t	f = 0;
+
+		for (; f + 4 <= frames; f += 4)
+		{
+			const T*	samples = input + (size_t)f * channels + c;
+			__m128		r0 = Load4(samples);
+			__m128		r1 = Load4(samples + channels);
+			__m128		r2 = Load4(samples + channels * 2);
+			__m128		r3 = Load4(samples + channels * 3);
+
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+			_mm_storeu_ps(plane + f, r0);
+			_mm_storeu_ps(plane + kBlockFrames + f, r1);
+			_mm_storeu_ps(plane + kBlockFrames * 2 + f, r2);
+			_mm_storeu_ps(plane + kBlockFrames * 3 + f, r3);
+		}
+		for (; f < frames; f++)
+		{
+			for (int k = 0; k < 4; k++)
+				plane[kBlockFrames * k + f] = LoadSample(input + (size_t)f * channels + c + k);
+		}
+	}
+#endif
+	for (; c < channels; c++)
+	{
+		for (uint32_t f = 0; f < frames; f++)
+			planes[c * kBlockFrames + f] = LoadSample(input + (size_t)f * channels + c);
+	}
+}
+
+// Float planes to interleaved samples
+template <typename T>
+static void Interleave(const float* const* planes, int channels, uint32_t frames, T* output, uint32_t* dither)
+{
+	int			c = 0;
+	uint32_t	f = 0;
+#if defined(__SSE2__)
+	// The vector loops carry the dither state in a register, the scalar tails share
+	// its first lane
+	__m128i		ditherState = _mm_setzero_si128();
+	__m128i*	vectorDither = NULL;
+
+	if (dither != NULL)
+	{
+		ditherState		= _mm_loadu_si128((const __m128i*)dither);
+		vectorDither	= &ditherState;
+	}
+
+	if (channels == 2)
+	{
+		for (; f + 4 <= frames; f += 4)
+		{
+			__m128 left		= _mm_loadu_ps(planes[0] + f);
+			__m128 right	= _mm_loadu_ps(planes[1] + f);
+			Store4(output + f * 2, _mm_unpacklo_ps(left, right), vectorDither);
+			Store4(output + f * 2 + 4, _mm_unpackhi_ps(left, right), vectorDither);
+		}
+	}
+	else
+	{
+		// Transpose 4 channels by 4 frames at a time
+		for (; c + 4 <= channels; c += 4)
+		{
+			for (f = 0; f + 4 <= frames; f += 4)
+			{
+				__m128	r0 = _mm_loadu_ps(planes[c] + f);
+				__m128	r1 = _mm_loadu_ps(planes[c + 1] + f);
+				__m128	r2 = _mm_loadu_ps(planes[c + 2] + f);
+				__m128	r3 = _mm_loadu_ps(planes[c + 3] + f);
+				T*		samples = output + (size_t)f * channels + c;
+
+				_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+				Store4(samples, r0, vectorDither);
+				Store4(samples + channels, r1, vectorDither);
+				Store4(samples + channels * 2, r2, vectorDither);
+				Store4(samples + channels * 3, r3, vectorDither);
+			}
+
+			if (f < frames)
+			{
+				if (dither != NULL)
+					_mm_storeu_si128((__m128i*)dither, ditherState);
+
+				for (; f < frames; f++)
+				{
+					for (int k = 0; k < 4; k++)
+						StoreSample(output + (size_t)f * channels + c + k, planes[c + k][f], dither);
+				}
+
+				if (dither != NULL)
+					ditherState = _mm_loadu_si128((const __m128i*)dither);
+			}
+		}
+		f = 0;
+	}
+
+	if (dither != NULL)
+		_mm_storeu_si128((__m128i*)dither, ditherState);
+#endif
+	// Whole channels left over, or the last frames of stereo
+	uint32_t firstFrame = f;
+	for (; c < channels; c++)
+	{
+		for (f = firstFrame; f < frames; f++)
+			StoreSample(output + (size_t)f * channels + c, planes[c][f], dither);
+	}
+}
+
+// One float plane to one planar output channel
+template <typename T>
+static void ConvertPlane(const float* plane, uint32_t frames, T* output, uint32_t* dither)
+{
+	uint32_t f = 0;
+#if defined(__SSE2__)
+	__m128i		ditherState = _mm_setzero_si128();
+	__m128i*	vectorDither = NULL;
+
+	if (dither != NULL)
+	{
+		ditherState		= _mm_loadu_si128((const __m128i*)dither);
+		vectorDither	= &ditherState;
+	}
+
+	for (; f + 4 <= frames; f += 4)
+		Store4(output + f, _mm_loadu_ps(plane + f), vectorDither);
+
+	if (dither != NULL)
+		_mm_storeu_si128((__m128i*)dither, ditherState);
+#endif
+	for (; f < frames; f++)
+		StoreSample(output + f, plane[f], dither);
+}
+
+static void ScalePlane(const float* input, float gain, float* output, uint32_t frames)
+{
+	uint32_t f = 0;
+#if defined(__SSE2__)
+	const __m128 g = _mm_set1_ps(gain);
+	for (; f + 4 <= frames; f += 4)
+		_mm_storeu_ps(output + f, _mm_mul_ps(_mm_loadu_ps(input + f), g));
+#endif
+	for (; f < frames; f++)
+		output[f] = input[f] * gain;
+}
+
+static void AccumulatePlane(const float* input, float gain, float* output, uint32_t frames)
+{
+	uint32_t f = 0;
+#if defined(__SSE2__)
+	const __m128 g = _mm_set1_ps(gain);
+	for (; f + 4 <= frames; f += 4)
+		_mm_storeu_ps(output + f, _mm_add_ps(_mm_loadu_ps(output + f), _mm_mul_ps(_mm_loadu_ps(input + f), g)));
+#endif
+	for (; f < frames; f++)
+		output[f] += input[f] * gain;
+}
+
+static bool IsUnityCopy(const AudioRoute& route)
+{
+	return route.inputs.size() == 1 && route.gains[0] == 1.0f;
+}
+
+AudioTransform::AudioTransform() :
+	m_inputChannels(0),
+	m_inputFormat(kAudioSampleInt16),
+	m_outputFormat(kAudioSampleInt16),
+	m_planarOutput(false),
+	m_dither(false)
+{
+	// Any non-zero seeds will do for xorshift
+	m_ditherState[0] = 0x9E3779B9;
+	m_ditherState[1] = 0x7F4A7C15;
+	m_ditherState[2] = 0x85EBCA6B;
+	m_ditherState[3] = 0xC2B2AE35;
+}
+
+AudioTransform::~AudioTransform()
+{
+}
+
+int AudioTransform::GetSampleBytes(AudioSampleFormat format)
+{
+	return format == kAudioSampleInt16 ? 2 : 4;
+}
+
+bool AudioTransform::Configure(int inputChannels, AudioSampleFormat inputFormat, AudioSampleFormat outputFormat, bool planarOutput, const std::vector<AudioRoute>& routes)
+{
+	bool unity = true;
+
+	if (inputChannels < 1)
+		return false;
+
+	m_routes = routes;
+	if (m_routes.empty())
+	{
+		m_routes.resize(inputChannels);
+		for (int c = 0; c < inputChannels; c++)
+		{
+			m_routes[c].inputs.push_back(c);
+			m_routes[c].gains.push_back(1.0f);
+		}
+	}
+
+	for (const AudioRoute& route : m_routes)
+	{
+		if (route.inputs.empty() || route.inputs.size() != route.gains.size())
+			return false;
+
+		for (int input : route.inputs)
+		{
+			if (input < 0 || input >= inputChannels)
+				return false;
+		}
+
+		unity = unity && IsUnityCopy(route);
+	}
+
+	m_inputChannels	= inputChannels;
+	m_inputFormat	= inputFormat;
+	m_outputFormat	= outputFormat;
+	m_planarOutput	= planarOutput;
+	// Only a word length reduction, or mixing, needs dither
+	m_dither		= (outputFormat == kAudioSampleInt16) && !(inputFormat == kAudioSampleInt16 && unity);
+
+	m_inputPlanes.assign((size_t)inputChannels * kBlockFrames, 0.0f);
+	m_outputPlanes.assign(m_routes.size() * kBlockFrames, 0.0f);
+	m_routedPlanes.resize(m_routes.size());
+
+	for (size_t o = 0; o < m_routes.size(); o++)
+	{
+		if (IsUnityCopy(m_routes[o]))
+			m_routedPlanes[o] = &m_inputPlanes[(size_t)m_routes[o].inputs[0] * kBlockFrames];
+		else
+			m_routedPlanes[o] = &m_outputPlanes[o * kBlockFrames];
+	}
+
+	return true;
+}
+
+bool AudioTransform::CanProcessInPlace() const
+{
+	// A block is fully read into the scratch before its output is written, so output
+	// never overtakes input that has not been read
+	return !m_planarOutput && m_routes.size() * GetSampleBytes(m_outputFormat) <= (size_t)m_inputChannels * GetSampleBytes(m_inputFormat);
+}
+
+size_t AudioTransform::Process(const void* input, void* output, uint32_t frameCount)
+{
+	const uint8_t*	inputBytes		= (const uint8_t*)input;
+	size_t			inputFrameSize	= (size_t)m_inputChannels * GetSampleBytes(m_inputFormat);
+
+	for (uint32_t firstFrame = 0; firstFrame < frameCount; firstFrame += kBlockFrames)
+	{
+		uint32_t frames = std::min(kBlockFrames, frameCount - firstFrame);
+
+		DeinterleaveBlock(inputBytes + firstFrame * inputFrameSize, frames);
+		RouteBlock(frames);
+		WriteBlock((uint8_t*)output, firstFrame, frames, frameCount);
+	}
+
+	return GetOutputSize(frameCount);
+}
+
+void AudioTransform::DeinterleaveBlock(const uint8_t* input, uint32_t frames)
+{
+	switch (m_inputFormat)
+	{
+		case kAudioSampleInt16:
+			Deinterleave((const int16_t*)input, m_inputChannels, frames, &m_inputPlanes[0]);
+			break;
+		case kAudioSampleInt32:
+			Deinterleave((const int32_t*)input, m_inputChannels, frames, &m_inputPlanes[0]);
+			break;
+		case kAudioSampleFloat32:
+			Deinterleave((const float*)input, m_inputChannels, frames, &m_inputPlanes[0]);
+			break;
+	}
+}
+
+void AudioTransform::RouteBlock(uint32_t frames)
+{
+	for (size_t o = 0; o < m_routes.size(); o++)
+	{
+		const AudioRoute&	route = m_routes[o];
+		float*				output = &m_outputPlanes[o * kBlockFrames];
+
+		if (IsUnityCopy(route))
+			continue;
+
+		ScalePlane(&m_inputPlanes[(size_t)route.inputs[0] * kBlockFrames], route.gains[0], output, frames);
+		for (size_t i = 1; i < route.inputs.size(); i++)
+			AccumulatePlane(&m_inputPlanes[(size_t)route.inputs[i] * kBlockFrames], route.gains[i], output, frames);
+	}
+}
+
+void AudioTransform::WriteBlock(uint8_t* output, uint32_t firstFrame, uint32_t frames, uint32_t frameCount)
+{
+	uint32_t*	dither		= m_dither ? m_ditherState : NULL;
+	int			channels	= (int)m_routes.size();
+
+	if (!m_planarOutput)
+	{
+		switch (m_outputFormat)
+		{
+			case kAudioSampleInt16:
+				Interleave(&m_routedPlanes[0], channels, frames, (int16_t*)output + (size_t)firstFrame * channels, dither);
+				break;
+			case kAudioSampleInt32:
+				Interleave(&m_routedPlanes[0], channels, frames, (int32_t*)output + (size_t)firstFrame * channels, dither);
+				break;
+			case kAudioSampleFloat32:
+				Interleave(&m_routedPlanes[0], channels, frames, (float*)output + (size_t)firstFrame * channels, dither);
+				break;
+		}
+		return;
+	}
+
+	// Planar output holds each channel for the whole packet in turn
+	for (int o = 0; o < channels; o++)
+	{
+		size_t offset = (size_t)o * frameCount + firstFrame;
+
+		switch (m_outputFormat)
+		{
+			case kAudioSampleInt16:
+				ConvertPlane(m_routedPlanes[o], frames, (int16_t*)output + offset, dither);
+				break;
+			case kAudioSampleInt32:
+				ConvertPlane(m_routedPlanes[o], frames, (int32_t*)output + offset, dither);
+				break;
+			case kAudioSampleFloat32:
+				ConvertPlane(m_routedPlanes[o], frames, (float*)output + offset, dither);
+				break;
+		}
+	}
+}
+
+bool AudioTransform::ParseRouting(const char* spec, int inputChannels, std::vector<AudioRoute>& routes)
+{
+	const char* p = spec;
+
+	routes.clear();
+
+	while (true)
+	{
+		AudioRoute route;
+
+		while (true)
+		{
+			char*	end;
+			long	channel = strtol(p, &end, 10);
+			float	gain = 1.0f;
+
+			if (end == p || channel < 0 || channel >= inputChannels)
+				return false;
+			p = end;
+
+			if (*p == '*')
+			{
+				gain = strtof(p + 1, &end);
+				if (end == p + 1)
+					return false;
+				p = end;
+			}
+
+			route.inputs.push_back((int)channel);
+			route.gains.push_back(gain);
+
+			if (*p != '+')
+				break;
+			p++;
+		}
+
+		routes.push_back(route);
+
+		if (*p == '\0')
+			return true;
+		if (*p != ',')
+			return false;
+		p++;
+	}
+}
+
+bool AudioTransform::ParseSampleFormat(const char* name, AudioSampleFormat& format, bool& planar)
+{
+	if (strncmp(name, "s16", 3) == 0)
+		format = kAudioSampleInt16;
+	else if (strncmp(name, "s32", 3) == 0)
+		format = kAudioSampleInt32;
+	else if (strncmp(name, "f32", 3) == 0)
+		format = kAudioSampleFloat32;
+	else
+		return false;
+
+	planar = (name[3] == 'p');
+	return name[planar ? 4 : 3] == '\0';
+}
@@ -0,0 +1,113 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+
+#ifndef __AUDIO_TRANSFORM_H__
+#define __AUDIO_TRANSFORM_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+enum AudioSampleFormat
+{
+	kAudioSampleInt16,
+	kAudioSampleInt32,
+	kAudioSampleFloat32
+};
+
+// One output channel, the sum of input channels each scaled by a gain
+struct AudioRoute
+{
+	std::vector<int>	inputs;
+	std::vector<float>	gains;
+};
+
+// Converts interleaved audio packets between sample formats and channel layouts.
+// Samples are deinterleaved to planar float a block of frames at a time, routed
+// through the channel matrix and then converted and interleaved, or written planar,
+// into the output.  Reducing to 16-bit adds triangular dither.  The kernels use SSE2
+// where available.  A transform keeps scratch state, so one thread uses it at a time.
+class AudioTransform
+{
+public:
+	AudioTransform();
+	virtual ~AudioTransform();
+
+	// Empty routes pass every input channel straight through
+	bool		Configure(int inputChannels, AudioSampleFormat inputFormat, AudioSampleFormat outputFormat, bool planarOutput, const std::vector<AudioRoute>& routes);
+
+	int			GetOutputChannels(void) const { return (int)m_routes.size(); }
+	size_t		GetOutputSize(uint32_t frameCount) const { return (size_t)frameCount * m_routes.size() * GetSampleBytes(m_outputFormat); }
+
+	// Output may be the same buffer as the input when each output frame is no larger
+	// than an input frame and the output is interleaved
+	bool		CanProcessInPlace(void) const;
+	// Returns the number of output bytes
+	size_t		Process(const void* input, void* output, uint32_t frameCount);
+
+	// Routing is a comma separated list of output channels, each a '+' separated list
+	// of input channels with an optional gain, eg. "0+2*0.707,1+2*0.707"
+	static bool	ParseRouting(const char* spec, int inputChannels, std::vector<AudioRoute>& routes);
+	// s16, s32 or f32, with a 'p' suffix for planar output, eg. "f32p"
+	static bool	ParseSampleFormat(const char* name, AudioSampleFormat& format, bool& planar);
+	static int	GetSampleBytes(AudioSampleFormat format);
+
+private:
+	void		DeinterleaveBlock(const uint8_t* input, uint32_t frames);
+	void		RouteBlock(uint32_t frames);
+	void		WriteBlock(uint8_t* output, uint32_t firstFrame, uint32_t frames, uint32_t frameCount);
+
+	int							m_inputChannels;
+	AudioSampleFormat			m_inputFormat;
+	AudioSampleFormat			m_outputFormat;
+	bool						m_planarOutput;
+	bool						m_dither;
+	std::vector<AudioRoute>		m_routes;
+
+	// Planar float scratch for one block.  Outputs that copy a single input at unity
+	// gain point straight at the input plane.
+	std::vector<float>			m_inputPlanes;
+	std::vector<float>			m_outputPlanes;
+	std::vector<const float*>	m_routedPlanes;
+	uint32_t					m_ditherState[4];
+};
+
+#endif
@@ -0,0 +1,142 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+
+// Times AudioTransform on 64 channels of 32-bit audio in 1602 frame packets, one 59.94p
+// frame at 48kHz, on one core.  Build and run with "make bench", which runs it with the
+// SSE2 kernels and again with the scalar loops used where SSE2 is not available.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+#include "AudioTransform.h"
+
+static const int		kInputChannels		= 64;
+static const uint32_t	kPacketFrames		= 1602;
+static const int		kPacketsPerRound	= 500;
+static const int		kRounds				= 5;
+
+struct BenchmarkCase
+{
+	const char*			name;
+	AudioSampleFormat	outputFormat;
+	bool				planarOutput;
+	const char*			routing;		// NULL passes every channel through
+};
+
+static uint64_t GetNanoseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Returns the time per packet in microseconds, the fastest of the rounds
+static double RunCase(const BenchmarkCase& benchmarkCase, const std::vector<int32_t>& input)
+{
+	AudioTransform				transform;
+	std::vector<AudioRoute>		routes;
+	std::vector<uint8_t>		output;
+	double						fastest = 0.0;
+
+	if (benchmarkCase.routing != NULL && !AudioTransform::ParseRouting(benchmarkCase.routing, kInputChannels, routes))
+		return -1.0;
+
+	if (!transform.Configure(kInputChannels, kAudioSampleInt32, benchmarkCase.outputFormat, benchmarkCase.planarOutput, routes))
+		return -1.0;
+
+	output.resize(transform.GetOutputSize(kPacketFrames));
+
+	// The first round also warms the caches
+	for (int round = 0; round <= kRounds; round++)
+	{
+		uint64_t startTime = GetNanoseconds();
+
+		for (int packet = 0; packet < kPacketsPerRound; packet++)
+			transform.Process(input.data(), output.data(), kPacketFrames);
+
+		double packetTime = (GetNanoseconds() - startTime) / 1000.0 / kPacketsPerRound;
+		if (round > 0 && (fastest == 0.0 || packetTime < fastest))
+			fastest = packetTime;
+	}
+
+	return fastest;
+}
+
+int main(void)
+{
+	const BenchmarkCase cases[] =
+	{
+		{ "planar f32",				kAudioSampleFloat32,	true,	NULL },
+		{ "interleaved f32",		kAudioSampleFloat32,	false,	NULL },
+		{ "dithered s16",			kAudioSampleInt16,		false,	NULL },
+		{ "6 to 2 downmix to s16",	kAudioSampleInt16,		false,	"0+2*0.707+4*0.5,1+2*0.707+5*0.5" },
+	};
+	std::vector<int32_t>	input((size_t)kInputChannels * kPacketFrames);
+	int						failures = 0;
+
+	srand(1);
+	for (int32_t& sample : input)
+		sample = (int32_t)(((uint32_t)rand() << 16) ^ (uint32_t)rand());
+
+#if defined(__SSE2__)
+	printf("AudioTransform, SSE2 kernels, %d channels of s32, %u frame packets\n", kInputChannels, kPacketFrames);
+#else
+	printf("AudioTransform, scalar loops, %d channels of s32, %u frame packets\n", kInputChannels, kPacketFrames);
+#endif
+
+	for (const BenchmarkCase& benchmarkCase : cases)
+	{
+		double packetTime = RunCase(benchmarkCase, input);
+		if (packetTime < 0.0)
+		{
+			printf("  %-24s could not be configured\n", benchmarkCase.name);
+			failures++;
+			continue;
+		}
+
+		printf("  %-24s %8.1f us per packet\n", benchmarkCase.name, packetTime);
+	}
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
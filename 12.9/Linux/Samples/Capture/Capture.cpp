@@ -38,33 +38,41 @@
 ** -LICENSE-END-
 */
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <time.h>
 #include <csignal>
+#include <vector>
 
 #include "DeckLinkAPI.h"
 #include "Capture.h"
+#include "CaptureInput.h"
 #include "Config.h"
+#include "IOScheduler.h"
+#include "SliceCompressor.h"
+#include "FrameChecksum.h"
+#include "FrameTrace.h"
+
+// Bytes each input may write per scheduling turn
+static const size_t		kWriteQuantum = 4 * 1024 * 1024;
+static const int		kStatisticsIntervalSeconds = 1;
 
 static pthread_mutex_t	g_sleepMutex;
 static pthread_cond_t	g_sleepCond;
-static int				g_videoOutputFile = -1;
-static int				g_audioOutputFile = -1;
 static bool				g_do_exit = false;
+static bool				g_restart = false;
+static bool				g_startRecording = false;
 
 static BMDConfig		g_config;
 
-static IDeckLinkInput*	g_deckLinkInput = NULL;
-
-static unsigned long	g_frameCount = 0;
-
-DeckLinkCaptureDelegate::DeckLinkCaptureDelegate() : 
+DeckLinkCaptureDelegate::DeckLinkCaptureDelegate(CaptureInput* input) : 
 	m_refCount(1),
-	m_pixelFormat(g_config.m_pixelFormat)
+	m_input(input)
 {
 }
 
@@ -86,162 +94,129 @@ ULONG DeckLinkCaptureDelegate::Release(void)
 
 HRESULT DeckLinkCaptureDelegate::VideoInputFrameArrived(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkAudioInputPacket* audioFrame)
 {
-	IDeckLinkVideoFrame*				rightEyeFrame = NULL;
-	IDeckLinkVideoFrame3DExtensions*	threeDExtensions = NULL;
-	void*								frameBytes;
-	void*								audioFrameBytes;
-
-	// Handle Video Frame
 	if (videoFrame)
-	{
-		// If 3D mode is enabled we retreive the 3D extensions interface which gives.
-		// us access to the right eye frame by calling GetFrameForRightEye() .
-		if ( (videoFrame->QueryInterface(IID_IDeckLinkVideoFrame3DExtensions, (void **) &threeDExtensions) != S_OK) ||
-			(threeDExtensions->GetFrameForRightEye(&rightEyeFrame) != S_OK))
-		{
-			rightEyeFrame = NULL;
-		}
+		m_input->VideoFrameArrived(videoFrame, audioFrame);
 
-		if (threeDExtensions)
-			threeDExtensions->Release();
-
-		if (videoFrame->GetFlags() & bmdFrameHasNoInputSource)
-		{
-			printf("Frame received (#%lu) - No input signal detected\n", g_frameCount);
-		}
-		else
-		{
-			const char *timecodeString = NULL;
-			if (g_config.m_timecodeFormat != 0)
-			{
-				IDeckLinkTimecode *timecode;
-				if (videoFrame->GetTimecode(g_config.m_timecodeFormat, &timecode) == S_OK)
-				{
-					timecode->GetString(&timecodeString);
-				}
-			}
-
-			printf("Frame received (#%lu) [%s] - %s - Size: %li bytes\n",
-				g_frameCount,
-				timecodeString != NULL ? timecodeString : "No timecode",
-				rightEyeFrame != NULL ? "Valid Frame (3D left/right)" : "Valid Frame",
-				videoFrame->GetRowBytes() * videoFrame->GetHeight());
-
-			if (timecodeString)
-				free((void*)timecodeString);
-
-			if (g_videoOutputFile != -1)
-			{
-				videoFrame->GetBytes(&frameBytes);
-				write(g_videoOutputFile, frameBytes, videoFrame->GetRowBytes() * videoFrame->GetHeight());
-
-				if (rightEyeFrame)
-				{
-					rightEyeFrame->GetBytes(&frameBytes);
-					write(g_videoOutputFile, frameBytes, videoFrame->GetRowBytes() * videoFrame->GetHeight());
-				}
-			}
-		}
+	if (audioFrame)
+		m_input->AudioPacketArrived(audioFrame);
 
-		if (rightEyeFrame)
-			rightEyeFrame->Release();
+	return S_OK;
+}
 
-		g_frameCount++;
-	}
+HRESULT DeckLinkCaptureDelegate::VideoInputFormatChanged(BMDVideoInputFormatChangedEvents events, IDeckLinkDisplayMode *mode, BMDDetectedVideoInputFormatFlags formatFlags)
+{
+	m_input->VideoFormatChanged(events, mode, formatFlags);
+	return S_OK;
+}
 
-	// Handle Audio Frame
-	if (audioFrame)
-	{
-		if (g_audioOutputFile != -1)
-		{
-			audioFrame->GetBytes(&audioFrameBytes);
-			write(g_audioOutputFile, audioFrameBytes, audioFrame->GetSampleFrameCount() * g_config.m_audioChannels * (g_config.m_audioSampleDepth / 8));
-		}
-	}
+void NotifyCaptureStateChanged(void)
+{
+	pthread_mutex_lock(&g_sleepMutex);
+	pthread_cond_signal(&g_sleepCond);
+	pthread_mutex_unlock(&g_sleepMutex);
+}
 
-	if (g_config.m_maxFrames > 0 && videoFrame && g_frameCount >= g_config.m_maxFrames)
-	{
+static void sigfunc(int signum)
+{
+	if (signum == SIGINT || signum == SIGTERM)
 		g_do_exit = true;
-		pthread_cond_signal(&g_sleepCond);
-	}
+	else if (signum == SIGHUP)
+		g_restart = true;
+	else if (signum == SIGUSR1)
+		g_startRecording = true;
 
-	return S_OK;
+	pthread_cond_signal(&g_sleepCond);
 }
 
-HRESULT DeckLinkCaptureDelegate::VideoInputFormatChanged(BMDVideoInputFormatChangedEvents events, IDeckLinkDisplayMode *mode, BMDDetectedVideoInputFormatFlags formatFlags)
+static bool AllInputsFinished(const std::vector<CaptureInput*>& inputs)
 {
-	// This only gets called if bmdVideoInputEnableFormatDetection was set
-	// when enabling video input
-	HRESULT	result;
-	char*	displayModeName = NULL;
-	BMDPixelFormat	pixelFormat = m_pixelFormat;
-	
-	if (events & bmdVideoInputColorspaceChanged)
+	for (CaptureInput* input : inputs)
 	{
-		// Detected a change in colorspace, change pixel format to match detected format
-		if (formatFlags & bmdDetectedVideoInputRGB444)
-			pixelFormat = bmdFormat10BitRGB;
-		else if (formatFlags & bmdDetectedVideoInputYCbCr422)
-			pixelFormat = (g_config.m_pixelFormat == bmdFormat8BitYUV) ? bmdFormat8BitYUV : bmdFormat10BitYUV;
-		else
-			goto bail;
+		if (!input->IsFinished())
+			return false;
 	}
+	return true;
+}
 
-	// Restart streams if either display mode or pixel format have changed
-	if ((events & bmdVideoInputDisplayModeChanged) || (m_pixelFormat != pixelFormat))
-	{
-		mode->GetName((const char**)&displayModeName);
-		printf("Video format changed to %s %s\n", displayModeName, formatFlags & bmdDetectedVideoInputRGB444 ? "RGB" : "YUV");
+// Per-input and total statistics, with write throughput since the previous report
+static void PrintStatistics(const std::vector<CaptureInput*>& inputs, std::vector<uint64_t>& lastBytesWritten, double intervalSeconds)
+{
+	CaptureStatistics	total = {};
+	double				totalRate = 0.0;
 
-		if (displayModeName)
-			free(displayModeName);
+	fprintf(stderr, "%-4s %-32s %10s %10s %10s %10s %8s %10s\n", "In", "Device", "Frames", "No signal", "Dropped", "Audio drop", "Queued", "MB/s");
 
-		if (g_deckLinkInput)
-		{
-			g_deckLinkInput->StopStreams();
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		CaptureStatistics statistics;
+		inputs[i]->GetStatistics(statistics);
+
+		double rate = (intervalSeconds > 0.0) ? (statistics.bytesWritten - lastBytesWritten[i]) / intervalSeconds / 1e6 : 0.0;
+		lastBytesWritten[i] = statistics.bytesWritten;
+
+		fprintf(stderr, "%-4d %-32.32s %10llu %10llu %10llu %10llu %8u %10.1f%s\n",
+			inputs[i]->GetInputNumber(), inputs[i]->GetName(),
+			(unsigned long long)statistics.framesReceived, (unsigned long long)statistics.framesWithoutSignal,
+			(unsigned long long)statistics.framesDropped, (unsigned long long)statistics.audioPacketsDropped,
+			statistics.queuedBuffers, rate, statistics.writeErrors ? " (write errors)" : "");
+
+		total.framesReceived		+= statistics.framesReceived;
+		total.framesWithoutSignal	+= statistics.framesWithoutSignal;
+		total.framesDropped			+= statistics.framesDropped;
+		total.audioPacketsDropped	+= statistics.audioPacketsDropped;
+		total.queuedBuffers			+= statistics.queuedBuffers;
+		totalRate					+= rate;
+	}
 
-			result = g_deckLinkInput->EnableVideoInput(mode->GetDisplayMode(), pixelFormat, g_config.m_inputFlags);
-			if (result != S_OK)
-			{
-				fprintf(stderr, "Failed to switch video mode\n");
-				goto bail;
-			}
+	fprintf(stderr, "%-4s %-32s %10llu %10llu %10llu %10llu %8u %10.1f\n\n", "", "Total",
+		(unsigned long long)total.framesReceived, (unsigned long long)total.framesWithoutSignal,
+		(unsigned long long)total.framesDropped, (unsigned long long)total.audioPacketsDropped,
+		total.queuedBuffers, totalRate);
+}
 
-			g_deckLinkInput->StartStreams();
-		}
+static void PrintCompressionStatistics(SliceCompressor* compressor, const std::vector<CaptureInput*>& inputs)
+{
+	SliceCompressorStatistics	statistics;
+	uint64_t					framesStoredRaw = 0;
+
+	compressor->GetStatistics(statistics);
 
-		m_pixelFormat = pixelFormat;
+	for (CaptureInput* input : inputs)
+	{
+		CaptureStatistics inputStatistics;
+		input->GetStatistics(inputStatistics);
+		framesStoredRaw += inputStatistics.framesStoredRaw;
 	}
 
-bail:
-	return S_OK;
+	fprintf(stderr, "Compression (%s): %llu frames compressed %.2f:1 at %.1f MB/s, %llu frames stored raw\n\n",
+		SliceCompressor::GetCompressionName(compressor->GetCompression()),
+		(unsigned long long)statistics.framesCompressed,
+		statistics.outputBytes ? (double)statistics.inputBytes / statistics.outputBytes : 0.0,
+		statistics.busyNanoseconds ? statistics.inputBytes * 1e3 / statistics.busyNanoseconds : 0.0,
+		(unsigned long long)framesStoredRaw);
 }
 
-static void sigfunc(int signum)
+static void PrintChecksumStatistics(FrameChecksum* checksum)
 {
-	if (signum == SIGINT || signum == SIGTERM)
-		g_do_exit = true;
+	FrameChecksumStatistics		statistics;
 
-	pthread_cond_signal(&g_sleepCond);
+	checksum->GetStatistics(statistics);
+
+	fprintf(stderr, "Checksums (CRC32C %s): %llu buffers at %.1f MB/s\n\n",
+		Crc32cImplementationName(),
+		(unsigned long long)statistics.buffersChecksummed,
+		statistics.busyNanoseconds ? statistics.bytesChecksummed * 1e3 / statistics.busyNanoseconds : 0.0);
 }
 
 int main(int argc, char *argv[])
 {
-	HRESULT							result;
 	int								exitStatus = 1;
-
-	IDeckLinkIterator*				deckLinkIterator = NULL;
-	IDeckLink*						deckLink = NULL;
-
-	IDeckLinkProfileAttributes*		deckLinkAttributes = NULL;
-	bool							formatDetectionSupported;
-	int64_t							duplexMode;
-
-	IDeckLinkDisplayMode*			displayMode = NULL;
-	char*							displayModeName = NULL;
-	bool							supported;
-
-	DeckLinkCaptureDelegate*		delegate = NULL;
+	bool							started = false;
+	std::vector<CaptureInput*>		inputs;
+	std::vector<uint64_t>			lastBytesWritten;
+	IOScheduler*					scheduler = NULL;
+	SliceCompressor*				compressor = NULL;
+	FrameChecksum*					checksum = NULL;
 
 	pthread_mutex_init(&g_sleepMutex, NULL);
 	pthread_cond_init(&g_sleepCond, NULL);
@@ -250,6 +225,10 @@ int main(int argc, char *argv[])
 	signal(SIGTERM, sigfunc);
 	signal(SIGHUP, sigfunc);
 
+	// Set FRAME_TRACE_FILE to record a per-frame trace of the capture
+	FrameTrace::startFromEnvironment();
+	signal(SIGUSR1, sigfunc);
+
 	// Process the command line arguments
 	if (!g_config.ParseArguments(argc, argv))
 	{
@@ -257,177 +236,137 @@ int main(int argc, char *argv[])
 		goto bail;
 	}
 
-	// Get the DeckLink device
-	deckLink = g_config.GetSelectedDeckLink();
-	if (deckLink == NULL)
-	{
-		fprintf(stderr, "Unable to get DeckLink device %u\n", g_config.m_deckLinkIndex);
-		goto bail;
-	}
+	scheduler = new IOScheduler(g_config.m_writerThreads, kWriteQuantum);
 
-	result = deckLink->QueryInterface(IID_IDeckLinkProfileAttributes, (void**)&deckLinkAttributes);
-	if (result != S_OK)
+	if (g_config.m_compression != kRawCompressionNone)
 	{
-		fprintf(stderr, "Unable to get DeckLink attributes interface\n");
-		goto bail;
-	}
-
-	// Check the DeckLink device is active
-	result = deckLinkAttributes->GetInt(BMDDeckLinkDuplex, &duplexMode);
-	if ((result != S_OK) || (duplexMode == bmdDuplexInactive))
-	{
-		fprintf(stderr, "The selected DeckLink device is inactive\n");
-		goto bail;
+		compressor = new SliceCompressor(g_config.m_compression, g_config.m_compressionLevel, g_config.m_compressionThreads);
+		if (!compressor->Start())
+		{
+			fprintf(stderr, "%s compression is not available, recording uncompressed\n", SliceCompressor::GetCompressionName(g_config.m_compression));
+			delete compressor;
+			compressor = NULL;
+		}
 	}
 
-	// Get the input (capture) interface of the DeckLink device
-	result = deckLink->QueryInterface(IID_IDeckLinkInput, (void**)&g_deckLinkInput);
-	if (result != S_OK)
+	if (g_config.m_containerOutput != NULL && g_config.m_checksumThreads > 0)
 	{
-		fprintf(stderr, "The selected device does not have an input interface\n");
-		goto bail;
+		checksum = new FrameChecksum(g_config.m_checksumThreads);
+		checksum->Start();
 	}
 
-	// Get the display mode
-	if (g_config.m_displayModeIndex == -1)
+	// Open every selected device in this one process, they share the writer threads
+	for (size_t i = 0; i < g_config.m_deckLinkSelectors.size(); i++)
 	{
-		// Check the card supports format detection
-		result = deckLinkAttributes->GetFlag(BMDDeckLinkSupportsInputFormatDetection, &formatDetectionSupported);
-		if (result != S_OK || !formatDetectionSupported)
+		IDeckLink* deckLink = g_config.GetSelectedDeckLink(i);
+		if (deckLink == NULL)
 		{
-			fprintf(stderr, "Format detection is not supported on this device\n");
+			fprintf(stderr, "Unable to get DeckLink device %zu\n", i);
 			goto bail;
 		}
 
-		g_config.m_inputFlags |= bmdVideoInputEnableFormatDetection;
-	}
-
-	displayMode = g_config.GetSelectedDeckLinkDisplayMode(deckLink);
+		CaptureInput* input = new CaptureInput((int)i, &g_config, scheduler, compressor, checksum);
+		inputs.push_back(input);
 
-	if (displayMode == NULL)
-	{
-		fprintf(stderr, "Unable to get display mode %d\n", g_config.m_displayModeIndex);
-		goto bail;
-	}
-
-	// Get display mode name
-	result = displayMode->GetName((const char**)&displayModeName);
-	if (result != S_OK)
-	{
-		displayModeName = (char *)malloc(32);
-		snprintf(displayModeName, 32, "[index %d]", g_config.m_displayModeIndex);
-	}
+		bool opened = input->Open(deckLink);
+		deckLink->Release();
 
-	// Check display mode is supported with given options
-	result = g_deckLinkInput->DoesSupportVideoMode(bmdVideoConnectionUnspecified, displayMode->GetDisplayMode(), g_config.m_pixelFormat, bmdNoVideoInputConversion, bmdSupportedVideoModeDefault, NULL, &supported);
-	if (result != S_OK)
-		goto bail;
+		if (!opened)
+			goto bail;
 
-	if (! supported)
-	{
-		fprintf(stderr, "The display mode %s is not supported with the selected pixel format\n", displayModeName);
-		goto bail;
+		if (inputs.size() > 1)
+			fprintf(stderr, "Input %zu: %s\n", i, input->GetName());
 	}
 
-	if (g_config.m_inputFlags & bmdVideoInputDualStream3D)
-	{
-		if (!(displayMode->GetFlags() & bmdDisplayModeSupports3D))
-		{
-			fprintf(stderr, "The display mode %s is not supported with 3D\n", displayModeName);
-			goto bail;
-		}
-	}
+	lastBytesWritten.resize(inputs.size(), 0);
 
 	// Print the selected configuration
 	g_config.DisplayConfiguration();
 
-	// Configure the capture callback
-	delegate = new DeckLinkCaptureDelegate();
-	g_deckLinkInput->SetCallback(delegate);
-
-	// Open output files
-	if (g_config.m_videoOutputFile != NULL)
-	{
-		g_videoOutputFile = open(g_config.m_videoOutputFile, O_WRONLY|O_CREAT|O_TRUNC, 0664);
-		if (g_videoOutputFile < 0)
-		{
-			fprintf(stderr, "Could not open video output file \"%s\"\n", g_config.m_videoOutputFile);
-			goto bail;
-		}
-	}
-
-	if (g_config.m_audioOutputFile != NULL)
-	{
-		g_audioOutputFile = open(g_config.m_audioOutputFile, O_WRONLY|O_CREAT|O_TRUNC, 0664);
-		if (g_audioOutputFile < 0)
-		{
-			fprintf(stderr, "Could not open audio output file \"%s\"\n", g_config.m_audioOutputFile);
-			goto bail;
-		}
-	}
+	if (!scheduler->Start())
+		goto bail;
 
 	// Block main thread until signal occurs
 	while (!g_do_exit)
 	{
 		// Start capturing
-		result = g_deckLinkInput->EnableVideoInput(displayMode->GetDisplayMode(), g_config.m_pixelFormat, g_config.m_inputFlags);
-		if (result != S_OK)
+		for (CaptureInput* input : inputs)
 		{
-			fprintf(stderr, "Failed to enable video input. Is another application using the card?\n");
-			goto bail;
+			if (!input->Start())
+				goto bail;
 		}
-
-		result = g_deckLinkInput->EnableAudioInput(bmdAudioSampleRate48kHz, g_config.m_audioSampleDepth, g_config.m_audioChannels);
-		if (result != S_OK)
-			goto bail;
-
-		result = g_deckLinkInput->StartStreams();
-		if (result != S_OK)
-			goto bail;
+		started = true;
 
 		// All Okay.
 		exitStatus = 0;
 
 		pthread_mutex_lock(&g_sleepMutex);
-		pthread_cond_wait(&g_sleepCond, &g_sleepMutex);
+		while (!g_do_exit && !g_restart)
+		{
+			struct timespec	deadline;
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_sec += kStatisticsIntervalSeconds;
+
+			if (pthread_cond_timedwait(&g_sleepCond, &g_sleepMutex, &deadline) == ETIMEDOUT && inputs.size() > 1)
+			{
+				PrintStatistics(inputs, lastBytesWritten, kStatisticsIntervalSeconds);
+				if (compressor != NULL)
+					PrintCompressionStatistics(compressor, inputs);
+			}
+
+			// Pre-record trigger
+			if (g_startRecording)
+			{
+				for (CaptureInput* input : inputs)
+					input->StartRecording();
+				g_startRecording = false;
+			}
+
+			if (AllInputsFinished(inputs))
+				g_do_exit = true;
+		}
+		g_restart = false;
 		pthread_mutex_unlock(&g_sleepMutex);
 
 		fprintf(stderr, "Stopping Capture\n");
-		g_deckLinkInput->StopStreams();
-		g_deckLinkInput->DisableAudioInput();
-		g_deckLinkInput->DisableVideoInput();
+		for (CaptureInput* input : inputs)
+			input->Stop();
+		started = false;
 	}
 
 bail:
-	if (g_videoOutputFile != 0)
-		close(g_videoOutputFile);
+	if (started)
+	{
+		for (CaptureInput* input : inputs)
+			input->Stop();
+	}
 
-	if (g_audioOutputFile != 0)
-		close(g_audioOutputFile);
+	// Drain the write queues before closing the files
+	if (scheduler != NULL)
+		scheduler->Stop();
 
-	if (displayModeName != NULL)
-		free(displayModeName);
+	if (inputs.size() > 1 && exitStatus == 0)
+		PrintStatistics(inputs, lastBytesWritten, 0.0);
 
-	if (displayMode != NULL)
-		displayMode->Release();
+	if (compressor != NULL && exitStatus == 0)
+		PrintCompressionStatistics(compressor, inputs);
 
-	if (delegate != NULL)
-		delegate->Release();
+	if (checksum != NULL && exitStatus == 0)
+		PrintChecksumStatistics(checksum);
 
-	if (g_deckLinkInput != NULL)
-	{
-		g_deckLinkInput->Release();
-		g_deckLinkInput = NULL;
-	}
+	for (CaptureInput* input : inputs)
+		delete input;
 
-	if (deckLinkAttributes != NULL)
-		deckLinkAttributes->Release();
+	if (scheduler != NULL)
+		delete scheduler;
 
-	if (deckLink != NULL)
-		deckLink->Release();
+	if (compressor != NULL)
+		delete compressor;
+
+	if (checksum != NULL)
+		delete checksum;
 
-	if (deckLinkIterator != NULL)
-		deckLinkIterator->Release();
+	FrameTrace::stop();
 
 	return exitStatus;
 }
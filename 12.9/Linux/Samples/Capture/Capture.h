@@ -43,10 +43,12 @@
 
 #include "DeckLinkAPI.h"
 
+class CaptureInput;
+
 class DeckLinkCaptureDelegate : public IDeckLinkInputCallback
 {
 public:
-	DeckLinkCaptureDelegate();
+	DeckLinkCaptureDelegate(CaptureInput* input);
 
 	virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) { return E_NOINTERFACE; }
 	virtual ULONG STDMETHODCALLTYPE AddRef(void);
@@ -56,7 +58,10 @@ public:
 
 private:
 	int32_t				m_refCount;
-	BMDPixelFormat		m_pixelFormat;
+	CaptureInput*		m_input;
 };
 
+// Wakes the main thread to re-check whether all inputs have finished
+void NotifyCaptureStateChanged(void);
+
 #endif
@@ -0,0 +1,125 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <stdlib.h>
+#include "CaptureBufferPool.h"
+
+static const size_t kBufferAlignment = 4096;
+
+static bool AllocateBytes(CaptureBuffer* buffer, size_t capacity)
+{
+	void* bytes = NULL;
+
+	if (posix_memalign(&bytes, kBufferAlignment, capacity) != 0)
+		return false;
+
+	buffer->bytes = (uint8_t*)bytes;
+	buffer->capacity = capacity;
+	return true;
+}
+
+CaptureBufferPool::CaptureBufferPool()
+{
+	pthread_mutex_init(&m_mutex, NULL);
+}
+
+CaptureBufferPool::~CaptureBufferPool()
+{
+	for (CaptureBuffer* buffer : m_buffers)
+	{
+		free(buffer->bytes);
+		delete buffer;
+	}
+
+	pthread_mutex_destroy(&m_mutex);
+}
+
+bool CaptureBufferPool::Allocate(int count, size_t capacity)
+{
+	pthread_mutex_lock(&m_mutex);
+
+	for (int i = 0; i < count; i++)
+	{
+		CaptureBuffer* buffer = new CaptureBuffer();
+		buffer->fileDescriptor = -1;
+		buffer->pool = this;
+
+		if (!AllocateBytes(buffer, capacity))
+		{
+			delete buffer;
+			pthread_mutex_unlock(&m_mutex);
+			return false;
+		}
+
+		m_buffers.push_back(buffer);
+		m_freeBuffers.push_back(buffer);
+	}
+
+	pthread_mutex_unlock(&m_mutex);
+	return true;
+}
+
+CaptureBuffer* CaptureBufferPool::Acquire(size_t size)
+{
+	CaptureBuffer* buffer = NULL;
+
+	// Called from the capture callback, which must not allocate, so data larger than
+	// the buffers is dropped
+	pthread_mutex_lock(&m_mutex);
+	if (!m_freeBuffers.empty() && m_freeBuffers.back()->capacity >= size)
+	{
+		buffer = m_freeBuffers.back();
+		m_freeBuffers.pop_back();
+	}
+	pthread_mutex_unlock(&m_mutex);
+
+	if (buffer == NULL)
+		return NULL;
+
+	buffer->size = size;
+	return buffer;
+}
+
+void CaptureBufferPool::Release(CaptureBuffer* buffer)
+{
+	pthread_mutex_lock(&m_mutex);
+	m_freeBuffers.push_back(buffer);
+	pthread_mutex_unlock(&m_mutex);
+}
@@ -0,0 +1,82 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __CAPTURE_BUFFER_POOL_H__
+#define __CAPTURE_BUFFER_POOL_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+class CaptureBufferPool;
+
+struct CaptureBuffer
+{
+	uint8_t*			bytes;
+	size_t				capacity;
+	size_t				size;
+	int					fileDescriptor;		// Destination of the buffered data
+	CaptureBufferPool*	pool;
+};
+
+// Fixed set of page aligned buffers, allocated up front so that the capture
+// callback never allocates.  When the pool is empty the caller drops the data
+// rather than waiting for the writer.
+class CaptureBufferPool
+{
+public:
+	CaptureBufferPool();
+	virtual ~CaptureBufferPool();
+
+	bool			Allocate(int count, size_t capacity);
+
+	// Returns NULL if no buffer is free or size is larger than the buffers, which
+	// the caller counts as a drop.  Buffers are never reallocated.
+	CaptureBuffer*	Acquire(size_t size);
+	void			Release(CaptureBuffer* buffer);
+
+private:
+	pthread_mutex_t					m_mutex;
+	std::vector<CaptureBuffer*>		m_buffers;
+	std::vector<CaptureBuffer*>		m_freeBuffers;
+};
+
+#endif
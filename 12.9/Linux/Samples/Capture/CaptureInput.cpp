@@ -0,0 +1,969 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "Capture.h"
+#include "CaptureInput.h"
+#include "Config.h"
+#include "FrameTrace.h"
+
+// Enough for one packet per frame at the lowest frame rates
+static const int	kAudioBufferCount		= 32;
+static const int	kMaxAudioSampleFrames	= kRawMaxAudioSampleFrames;
+// One record is compressed at a time per input, the spare covers a buffer being regrown
+static const int	kCompressedBufferCount	= 2;
+// Shared frame ring slots, of which the newest kPublishedFrames stay readable by clients
+static const int	kPublishSlotCount		= 16;
+static const int	kPublishedFrames		= 6;
+
+static long GetRowBytes(BMDPixelFormat pixelFormat, long width)
+{
+	switch (pixelFormat)
+	{
+		case bmdFormat8BitYUV:
+			return width * 2;
+		case bmdFormat10BitYUV:
+			return ((width + 47) / 48) * 128;
+		case bmdFormat10BitRGB:
+			return ((width + 63) / 64) * 256;
+		default:
+			return width * 4;
+	}
+}
+
+CaptureInput::CaptureInput(int inputNumber, BMDConfig* config, IOScheduler* scheduler, SliceCompressor* compressor, FrameChecksum* checksum) :
+	m_inputNumber(inputNumber),
+	m_config(config),
+	m_scheduler(scheduler),
+	m_compressor(compressor),
+	m_checksum(checksum),
+	m_deckLinkInput(NULL),
+	m_delegate(NULL),
+	m_reconfigurator(NULL),
+	m_name(NULL),
+	m_displayMode(bmdModeUnknown),
+	m_pixelFormat(config->m_pixelFormat),
+	m_inputFlags(config->m_inputFlags),
+	m_frameDuration(0),
+	m_timeScale(0),
+	m_formatChanged(false),
+	m_verbose(config->m_deckLinkSelectors.size() == 1),
+	m_videoOutputFile(-1),
+	m_audioOutputFile(-1),
+	m_publisher(NULL),
+	m_container(NULL),
+	m_preRecord(NULL),
+	m_audioTransform(NULL),
+	m_frameCount(0),
+	m_finished(false),
+	m_framesWithoutSignal(0),
+	m_framesDropped(0),
+	m_framesStoredRaw(0),
+	m_audioPacketsDropped(0),
+	m_bytesWritten(0),
+	m_writeErrors(0)
+{
+	pthread_mutex_init(&m_queueMutex, NULL);
+}
+
+CaptureInput::~CaptureInput()
+{
+	m_scheduler->RemoveStream(this);
+
+	// Return anything the writer did not get to
+	for (CaptureBuffer* buffer : m_writeQueue)
+		buffer->pool->Release(buffer);
+	m_writeQueue.clear();
+
+	if (m_reconfigurator != NULL)
+		delete m_reconfigurator;
+
+	if (m_deckLinkInput != NULL)
+	{
+		m_deckLinkInput->SetCallback(NULL);
+		if (m_publisher != NULL)
+			m_deckLinkInput->SetVideoInputFrameMemoryAllocator(NULL);
+		m_deckLinkInput->Release();
+	}
+
+	if (m_publisher != NULL)
+	{
+		m_publisher->Close();
+		m_publisher->Release();
+	}
+
+	if (m_delegate != NULL)
+		m_delegate->Release();
+
+	if (m_videoOutputFile != -1)
+		close(m_videoOutputFile);
+
+	if (m_audioOutputFile != -1)
+		close(m_audioOutputFile);
+
+	// Writes the index of the last segment
+	if (m_container != NULL)
+	{
+		if (!m_container->Close())
+			fprintf(stderr, "%s: Could not finish the container index\n", m_name);
+		delete m_container;
+	}
+
+	if (m_preRecord != NULL)
+		delete m_preRecord;
+
+	if (m_audioTransform != NULL)
+		delete m_audioTransform;
+
+	if (m_name != NULL)
+		free(m_name);
+
+	pthread_mutex_destroy(&m_queueMutex);
+}
+
+bool CaptureInput::OpenOutputFile(const char* filename, int& fileDescriptor)
+{
+	std::string path = m_config->GetOutputFilename(filename, m_inputNumber);
+
+	fileDescriptor = open(path.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (fileDescriptor < 0)
+	{
+		fprintf(stderr, "Could not open output file \"%s\"\n", path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+size_t CaptureInput::GetLargestFrameSize(IDeckLinkDisplayMode* displayMode, long& rowBytes)
+{
+	IDeckLinkDisplayModeIterator*	displayModeIterator = NULL;
+	IDeckLinkDisplayMode*			mode = NULL;
+	size_t							frameSize;
+
+	rowBytes	= GetRowBytes(m_pixelFormat, displayMode->GetWidth());
+	frameSize	= rowBytes * displayMode->GetHeight();
+
+	// With format detection the input may switch to any mode, and to RGB.  Sizing for
+	// the largest up front means a switch never regrows buffers on the capture thread.
+	if ((m_inputFlags & bmdVideoInputEnableFormatDetection) && m_deckLinkInput->GetDisplayModeIterator(&displayModeIterator) == S_OK)
+	{
+		while (displayModeIterator->Next(&mode) == S_OK)
+		{
+			long rgbRowBytes = GetRowBytes(bmdFormat10BitRGB, mode->GetWidth());
+			long yuvRowBytes = GetRowBytes(m_pixelFormat, mode->GetWidth());
+
+			rowBytes	= std::max(rowBytes, std::max(rgbRowBytes, yuvRowBytes));
+			frameSize	= std::max(frameSize, (size_t)std::max(rgbRowBytes, yuvRowBytes) * mode->GetHeight());
+			mode->Release();
+		}
+		displayModeIterator->Release();
+	}
+
+	return frameSize;
+}
+
+bool CaptureInput::OpenPublisher(IDeckLinkDisplayMode* displayMode)
+{
+	long		rowBytes;
+	// Slots can not grow once clients have mapped them
+	uint64_t	slotSize = GetLargestFrameSize(displayMode, rowBytes);
+
+	m_publisher = new FramePublisher();
+	if (!m_publisher->Create(m_config->GetOutputFilename(m_config->m_publishName, m_inputNumber), kPublishSlotCount, slotSize, kPublishedFrames))
+		return false;
+
+	if (m_deckLinkInput->SetVideoInputFrameMemoryAllocator(m_publisher) != S_OK)
+	{
+		fprintf(stderr, "%s: Could not set the frame allocator for publishing\n", m_name);
+		return false;
+	}
+
+	return true;
+}
+
+bool CaptureInput::OpenPreRecord(size_t frameSize, size_t maxAudioSize)
+{
+	// The pre-record period, plus the usual buffering for frames arriving while the
+	// ring is written out after the trigger
+	uint32_t slotCount = (uint32_t)(m_config->m_preRecordSeconds * m_timeScale / m_frameDuration + 0.5) + m_config->m_bufferedFrames;
+
+	m_preRecord = new PreRecordRing();
+	if (!m_preRecord->Allocate(slotCount, RawRecordSize(frameSize, maxAudioSize)))
+	{
+		fprintf(stderr, "%s: Could not allocate %u frames for pre-record\n", m_name, slotCount);
+		return false;
+	}
+
+	fprintf(stderr, "%s: Pre-recording %.1f seconds in %.0f MB of %s\n", m_name, m_config->m_preRecordSeconds,
+		m_preRecord->GetMemorySize() / 1048576.0, m_preRecord->IsHugePageBacked() ? "huge pages" : "memory");
+
+	return true;
+}
+
+void CaptureInput::StartRecording()
+{
+	if (m_preRecord == NULL || m_preRecord->IsRecording())
+		return;
+
+	m_preRecord->StartRecording();
+	m_scheduler->Notify();
+
+	fprintf(stderr, "%s: Recording, starting with %u pre-recorded frames\n", m_name, m_preRecord->GetPendingCount());
+}
+
+bool CaptureInput::Open(IDeckLink* deckLink)
+{
+	HRESULT						result;
+	bool						success = false;
+	IDeckLinkProfileAttributes*	deckLinkAttributes = NULL;
+	IDeckLinkDisplayMode*		displayMode = NULL;
+	char*						displayModeName = NULL;
+	bool						formatDetectionSupported;
+	bool						supported;
+	int64_t						duplexMode;
+	int64_t						maxAudioChannels;
+	size_t						frameSize;
+	long						rowBytes;
+
+	if (deckLink->GetDisplayName((const char**)&m_name) != S_OK)
+		m_name = strdup("Unknown");
+
+	result = deckLink->QueryInterface(IID_IDeckLinkProfileAttributes, (void**)&deckLinkAttributes);
+	if (result != S_OK)
+	{
+		fprintf(stderr, "%s: Unable to get DeckLink attributes interface\n", m_name);
+		goto bail;
+	}
+
+	// Check the DeckLink device is active
+	result = deckLinkAttributes->GetInt(BMDDeckLinkDuplex, &duplexMode);
+	if ((result != S_OK) || (duplexMode == bmdDuplexInactive))
+	{
+		fprintf(stderr, "%s: The selected DeckLink device is inactive\n", m_name);
+		goto bail;
+	}
+
+	// 32 and 64 channels are only available on some devices
+	result = deckLinkAttributes->GetInt(BMDDeckLinkMaximumAudioChannels, &maxAudioChannels);
+	if (result == S_OK && m_config->m_audioChannels > maxAudioChannels)
+	{
+		fprintf(stderr, "%s: The device captures at most %d audio channels\n", m_name, (int)maxAudioChannels);
+		goto bail;
+	}
+
+	// Get the input (capture) interface of the DeckLink device
+	result = deckLink->QueryInterface(IID_IDeckLinkInput, (void**)&m_deckLinkInput);
+	if (result != S_OK)
+	{
+		fprintf(stderr, "%s: The selected device does not have an input interface\n", m_name);
+		goto bail;
+	}
+
+	// Get the display mode
+	if (m_config->m_displayModeIndex == -1)
+	{
+		// Check the card supports format detection
+		result = deckLinkAttributes->GetFlag(BMDDeckLinkSupportsInputFormatDetection, &formatDetectionSupported);
+		if (result != S_OK || !formatDetectionSupported)
+		{
+			fprintf(stderr, "%s: Format detection is not supported on this device\n", m_name);
+			goto bail;
+		}
+
+		m_inputFlags |= bmdVideoInputEnableFormatDetection;
+	}
+
+	displayMode = m_config->GetSelectedDeckLinkDisplayMode(deckLink);
+	if (displayMode == NULL)
+	{
+		fprintf(stderr, "%s: Unable to get display mode %d\n", m_name, m_config->m_displayModeIndex);
+		goto bail;
+	}
+
+	// Get display mode name
+	result = displayMode->GetName((const char**)&displayModeName);
+	if (result != S_OK)
+	{
+		displayModeName = (char *)malloc(32);
+		snprintf(displayModeName, 32, "[index %d]", m_config->m_displayModeIndex);
+	}
+
+	// Check display mode is supported with given options
+	result = m_deckLinkInput->DoesSupportVideoMode(bmdVideoConnectionUnspecified, displayMode->GetDisplayMode(), m_pixelFormat, bmdNoVideoInputConversion, bmdSupportedVideoModeDefault, NULL, &supported);
+	if (result != S_OK)
+		goto bail;
+
+	if (! supported)
+	{
+		fprintf(stderr, "%s: The display mode %s is not supported with the selected pixel format\n", m_name, displayModeName);
+		goto bail;
+	}
+
+	if (m_inputFlags & bmdVideoInputDualStream3D)
+	{
+		if (!(displayMode->GetFlags() & bmdDisplayModeSupports3D))
+		{
+			fprintf(stderr, "%s: The display mode %s is not supported with 3D\n", m_name, displayModeName);
+			goto bail;
+		}
+	}
+
+	m_displayMode = displayMode->GetDisplayMode();
+	displayMode->GetFrameRate(&m_frameDuration, &m_timeScale);
+
+	frameSize = GetLargestFrameSize(displayMode, rowBytes);
+	if (m_inputFlags & bmdVideoInputDualStream3D)
+		frameSize *= 2;
+
+	if (m_inputFlags & bmdVideoInputEnableFormatDetection)
+	{
+		fprintf(stderr, "%s: Buffers sized for %.1f MB frames, the largest detectable format\n", m_name, frameSize / 1048576.0);
+		m_reconfigurator = new FormatReconfigurator(m_name, m_deckLinkInput, m_inputFlags, this);
+	}
+
+	// Open output files and preallocate their buffers
+	if (m_config->m_videoOutputFile != NULL)
+	{
+		if (!OpenOutputFile(m_config->m_videoOutputFile, m_videoOutputFile))
+			goto bail;
+
+		if (!m_videoBuffers.Allocate(m_config->m_bufferedFrames, frameSize))
+		{
+			fprintf(stderr, "%s: Could not allocate video buffers\n", m_name);
+			goto bail;
+		}
+	}
+
+	if (m_config->m_audioOutputFile != NULL)
+	{
+		if (!OpenOutputFile(m_config->m_audioOutputFile, m_audioOutputFile))
+			goto bail;
+
+		size_t frameBytes = m_config->m_audioChannels * (m_config->m_audioSampleDepth / 8);
+
+		if (m_config->m_transformAudio)
+		{
+			m_audioTransform = new AudioTransform();
+			if (!m_audioTransform->Configure(m_config->m_audioChannels, (m_config->m_audioSampleDepth == 16) ? kAudioSampleInt16 : kAudioSampleInt32,
+											 m_config->m_audioOutputFormat, m_config->m_audioPlanar, m_config->m_audioRoutes))
+			{
+				fprintf(stderr, "%s: Invalid audio conversion\n", m_name);
+				goto bail;
+			}
+
+			frameBytes = std::max(frameBytes, m_audioTransform->GetOutputSize(1));
+		}
+
+		if (!m_audioBuffers.Allocate(kAudioBufferCount, kMaxAudioSampleFrames * frameBytes))
+		{
+			fprintf(stderr, "%s: Could not allocate audio buffers\n", m_name);
+			goto bail;
+		}
+	}
+
+	if (m_config->m_containerOutput != NULL)
+	{
+		m_container = new RawContainerWriter(m_config->GetOutputFilename(m_config->m_containerOutput, m_inputNumber), m_name,
+											 m_config->m_segmentBytes, m_config->m_segmentSeconds);
+		if (!m_container->Open())
+			goto bail;
+
+		// Records carry the frame's audio packet, so size buffers for both
+		if (m_config->m_preRecordSeconds > 0)
+		{
+			if (!OpenPreRecord(frameSize, kMaxAudioSampleFrames * m_config->m_audioChannels * (m_config->m_audioSampleDepth / 8)))
+				goto bail;
+		}
+		else if (!m_videoBuffers.Allocate(m_config->m_bufferedFrames, RawRecordSize(frameSize, kMaxAudioSampleFrames * m_config->m_audioChannels * (m_config->m_audioSampleDepth / 8))))
+		{
+			fprintf(stderr, "%s: Could not allocate record buffers\n", m_name);
+			goto bail;
+		}
+
+		if (m_compressor != NULL &&
+			!m_compressedBuffers.Allocate(kCompressedBufferCount, RawRecordSize(m_compressor->MaxStoredSize(frameSize, rowBytes),
+																			   kMaxAudioSampleFrames * m_config->m_audioChannels * (m_config->m_audioSampleDepth / 8))))
+		{
+			fprintf(stderr, "%s: Could not allocate compression buffers\n", m_name);
+			goto bail;
+		}
+	}
+
+	if (m_config->m_publishName != NULL && !OpenPublisher(displayMode))
+		goto bail;
+
+	// Configure the capture callback
+	m_delegate = new DeckLinkCaptureDelegate(this);
+	m_deckLinkInput->SetCallback(m_delegate);
+
+	m_scheduler->AddStream(this);
+	success = true;
+
+bail:
+	if (displayModeName != NULL)
+		free(displayModeName);
+
+	if (displayMode != NULL)
+		displayMode->Release();
+
+	if (deckLinkAttributes != NULL)
+		deckLinkAttributes->Release();
+
+	return success;
+}
+
+bool CaptureInput::Start()
+{
+	HRESULT result;
+
+	result = m_deckLinkInput->EnableVideoInput(m_displayMode, m_pixelFormat, m_inputFlags);
+	if (result != S_OK)
+	{
+		fprintf(stderr, "%s: Failed to enable video input. Is another application using the card?\n", m_name);
+		return false;
+	}
+
+	result = m_deckLinkInput->EnableAudioInput(bmdAudioSampleRate48kHz, m_config->m_audioSampleDepth, m_config->m_audioChannels);
+	if (result != S_OK)
+		return false;
+
+	if (m_reconfigurator != NULL && !m_reconfigurator->Start())
+		return false;
+
+	return m_deckLinkInput->StartStreams() == S_OK;
+}
+
+void CaptureInput::Stop()
+{
+	// A format switch in progress would restart the streams
+	if (m_reconfigurator != NULL)
+		m_reconfigurator->Stop();
+
+	m_deckLinkInput->StopStreams();
+	m_deckLinkInput->DisableAudioInput();
+	m_deckLinkInput->DisableVideoInput();
+}
+
+void CaptureInput::GetStatistics(CaptureStatistics& statistics)
+{
+	statistics.framesReceived		= m_frameCount;
+	statistics.framesWithoutSignal	= m_framesWithoutSignal;
+	statistics.framesDropped		= m_framesDropped;
+	statistics.framesStoredRaw		= m_framesStoredRaw;
+	statistics.audioPacketsDropped	= m_audioPacketsDropped;
+	statistics.bytesWritten			= m_bytesWritten;
+	statistics.writeErrors			= m_writeErrors;
+
+	pthread_mutex_lock(&m_queueMutex);
+	statistics.queuedBuffers		= (uint32_t)m_writeQueue.size();
+	pthread_mutex_unlock(&m_queueMutex);
+}
+
+void CaptureInput::QueueBuffer(CaptureBuffer* buffer)
+{
+	pthread_mutex_lock(&m_queueMutex);
+	m_writeQueue.push_back(buffer);
+	pthread_mutex_unlock(&m_queueMutex);
+
+	m_scheduler->Notify();
+}
+
+void CaptureInput::VideoFrameArrived(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkAudioInputPacket* audioPacket)
+{
+	IDeckLinkVideoFrame*				rightEyeFrame = NULL;
+	IDeckLinkVideoFrame3DExtensions*	threeDExtensions = NULL;
+	IDeckLinkTimecode*					timecode = NULL;
+	void*								frameBytes;
+
+	FRAME_TRACE_SPAN("VideoFrameArrived", m_frameCount);
+
+	// If 3D mode is enabled we retreive the 3D extensions interface which gives.
+	// us access to the right eye frame by calling GetFrameForRightEye() .
+	if ( (videoFrame->QueryInterface(IID_IDeckLinkVideoFrame3DExtensions, (void **) &threeDExtensions) != S_OK) ||
+		(threeDExtensions->GetFrameForRightEye(&rightEyeFrame) != S_OK))
+	{
+		rightEyeFrame = NULL;
+	}
+
+	if (threeDExtensions)
+		threeDExtensions->Release();
+
+	if (videoFrame->GetFlags() & bmdFrameHasNoInputSource)
+	{
+		if (m_verbose)
+			printf("Frame received (#%lu) - No input signal detected\n", (unsigned long)m_frameCount);
+
+		m_framesWithoutSignal++;
+	}
+	else
+	{
+		size_t eyeSize = videoFrame->GetRowBytes() * videoFrame->GetHeight();
+
+		if (m_reconfigurator != NULL)
+			m_reconfigurator->FrameArrived();
+
+		if (m_config->m_timecodeFormat != 0 && videoFrame->GetTimecode(m_config->m_timecodeFormat, &timecode) != S_OK)
+			timecode = NULL;
+
+		if (m_verbose)
+		{
+			const char *timecodeString = NULL;
+			if (timecode != NULL)
+				timecode->GetString(&timecodeString);
+
+			printf("Frame received (#%lu) [%s] - %s - Size: %li bytes\n",
+				(unsigned long)m_frameCount,
+				timecodeString != NULL ? timecodeString : "No timecode",
+				rightEyeFrame != NULL ? "Valid Frame (3D left/right)" : "Valid Frame",
+				(long)eyeSize);
+
+			if (timecodeString)
+				free((void*)timecodeString);
+		}
+
+		if (m_videoOutputFile != -1)
+		{
+			CaptureBuffer* buffer = m_videoBuffers.Acquire(rightEyeFrame ? eyeSize * 2 : eyeSize);
+			if (buffer == NULL)
+			{
+				m_framesDropped++;
+			}
+			else
+			{
+				videoFrame->GetBytes(&frameBytes);
+				memcpy(buffer->bytes, frameBytes, eyeSize);
+
+				if (rightEyeFrame)
+				{
+					rightEyeFrame->GetBytes(&frameBytes);
+					memcpy(buffer->bytes + eyeSize, frameBytes, eyeSize);
+				}
+
+				buffer->fileDescriptor = m_videoOutputFile;
+				QueueBuffer(buffer);
+			}
+		}
+
+		if (m_container != NULL)
+			QueueContainerRecord(videoFrame, rightEyeFrame, audioPacket, timecode);
+
+		if (m_publisher != NULL)
+			m_publisher->Publish(videoFrame, rightEyeFrame, timecode, m_timeScale);
+
+		if (timecode != NULL)
+			timecode->Release();
+	}
+
+	if (rightEyeFrame)
+		rightEyeFrame->Release();
+
+	m_frameCount++;
+
+	if (m_config->m_maxFrames > 0 && m_frameCount >= (unsigned long)m_config->m_maxFrames && !m_finished)
+	{
+		m_finished = true;
+		NotifyCaptureStateChanged();
+	}
+}
+
+void CaptureInput::QueueContainerRecord(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkVideoFrame* rightEyeFrame, IDeckLinkAudioInputPacket* audioPacket, IDeckLinkTimecode* timecode)
+{
+	size_t			eyeSize		= videoFrame->GetRowBytes() * videoFrame->GetHeight();
+	size_t			videoSize	= rightEyeFrame ? eyeSize * 2 : eyeSize;
+	size_t			audioSize	= 0;
+	size_t			recordSize;
+
+	if (audioPacket != NULL)
+		audioSize = audioPacket->GetSampleFrameCount() * m_config->m_audioChannels * (m_config->m_audioSampleDepth / 8);
+
+	recordSize = RawRecordSize(videoSize, audioSize);
+
+	// Pre-record keeps records in its ring, which the writer drains once triggered
+	if (m_preRecord != NULL)
+	{
+		uint8_t* record = m_preRecord->BeginWrite(recordSize);
+		if (record == NULL)
+		{
+			m_framesDropped++;
+			return;
+		}
+
+		FillContainerRecord(record, recordSize, videoFrame, rightEyeFrame, audioPacket, timecode);
+		if (m_preRecord->EndWrite())
+			m_scheduler->Notify();
+		return;
+	}
+
+	// Header, payloads and padding go out in a single write
+	CaptureBuffer* buffer = m_videoBuffers.Acquire(recordSize);
+	if (buffer == NULL)
+	{
+		m_framesDropped++;
+		return;
+	}
+
+	FillContainerRecord(buffer->bytes, recordSize, videoFrame, rightEyeFrame, audioPacket, timecode);
+
+	buffer->fileDescriptor = -1;
+	QueueBuffer(buffer);
+}
+
+void CaptureInput::FillContainerRecord(uint8_t* record, size_t recordSize, IDeckLinkVideoInputFrame* videoFrame, IDeckLinkVideoFrame* rightEyeFrame, IDeckLinkAudioInputPacket* audioPacket, IDeckLinkTimecode* timecode)
+{
+	size_t			eyeSize		= videoFrame->GetRowBytes() * videoFrame->GetHeight();
+	size_t			videoSize	= rightEyeFrame ? eyeSize * 2 : eyeSize;
+	size_t			audioSize	= 0;
+	void*			bytes;
+	BMDTimeValue	streamTime;
+	BMDTimeValue	frameDuration;
+
+	FRAME_TRACE_SPAN("FillContainerRecord", m_frameCount);
+
+	if (audioPacket != NULL)
+		audioSize = audioPacket->GetSampleFrameCount() * m_config->m_audioChannels * (m_config->m_audioSampleDepth / 8);
+
+	RawFrameHeader* header = (RawFrameHeader*)record;
+	memset(record, 0, kRawContainerAlignment);
+
+	if (videoFrame->GetStreamTime(&streamTime, &frameDuration, m_timeScale) != S_OK)
+	{
+		streamTime		= 0;
+		frameDuration	= m_frameDuration;
+	}
+
+	header->magic				= kRawFrameMagic;
+	header->headerSize			= kRawContainerAlignment;
+	header->frameNumber			= m_frameCount;
+	header->streamTime			= streamTime;
+	header->frameDuration		= frameDuration;
+	header->timeScale			= m_timeScale;
+	header->pixelFormat			= videoFrame->GetPixelFormat();
+	header->width				= (uint32_t)videoFrame->GetWidth();
+	header->height				= (uint32_t)videoFrame->GetHeight();
+	header->rowBytes			= (uint32_t)videoFrame->GetRowBytes();
+	header->videoSize			= videoSize;
+	header->audioSize			= audioSize;
+	header->recordSize			= recordSize;
+
+	if (timecode != NULL)
+	{
+		header->timecodeBCD		= timecode->GetBCD();
+		header->timecodeFlags	= timecode->GetFlags();
+		header->flags			|= kRawFrameHasTimecode;
+		if (header->timecodeFlags & bmdTimecodeIsDropFrame)
+			header->flags		|= kRawFrameDropFrameTimecode;
+	}
+
+	if (rightEyeFrame)
+		header->flags			|= kRawFrame3D;
+
+	if (m_formatChanged)
+	{
+		header->flags			|= kRawFrameFormatChanged;
+		m_formatChanged			= false;
+	}
+
+	uint8_t* payload = record + kRawContainerAlignment;
+
+	// The checksum is taken over the copy as it goes, so the frame is only read once
+	videoFrame->GetBytes(&bytes);
+	if (m_checksum != NULL)
+		header->videoChecksum = m_checksum->CopyAndChecksum(payload, (const uint8_t*)bytes, eyeSize);
+	else
+		memcpy(payload, bytes, eyeSize);
+
+	if (rightEyeFrame)
+	{
+		rightEyeFrame->GetBytes(&bytes);
+		if (m_checksum != NULL)
+			header->videoChecksum = Crc32cCombine(header->videoChecksum, m_checksum->CopyAndChecksum(payload + eyeSize, (const uint8_t*)bytes, eyeSize), eyeSize);
+		else
+			memcpy(payload + eyeSize, bytes, eyeSize);
+	}
+
+	if (audioPacket != NULL)
+	{
+		header->audioSampleFrames	= (uint32_t)audioPacket->GetSampleFrameCount();
+		header->audioChannels		= m_config->m_audioChannels;
+		header->audioSampleDepth	= m_config->m_audioSampleDepth;
+
+		audioPacket->GetBytes(&bytes);
+		memcpy(payload + videoSize, bytes, audioSize);
+	}
+
+	if (m_checksum != NULL)
+	{
+		header->audioChecksum	= Crc32c(payload + videoSize, audioSize);
+		header->flags			|= kRawFrameHasChecksum;
+	}
+
+	memset(payload + videoSize + audioSize, 0, recordSize - kRawContainerAlignment - videoSize - audioSize);
+}
+
+void CaptureInput::AudioPacketArrived(IDeckLinkAudioInputPacket* audioPacket)
+{
+	void* audioBytes;
+
+	if (m_audioOutputFile == -1)
+		return;
+
+	uint32_t		frameCount = (uint32_t)audioPacket->GetSampleFrameCount();
+	CaptureBuffer*	buffer;
+
+	if (m_audioTransform != NULL)
+		buffer = m_audioBuffers.Acquire(m_audioTransform->GetOutputSize(frameCount));
+	else
+		buffer = m_audioBuffers.Acquire(frameCount * m_config->m_audioChannels * (m_config->m_audioSampleDepth / 8));
+
+	if (buffer == NULL)
+	{
+		m_audioPacketsDropped++;
+		return;
+	}
+
+	audioPacket->GetBytes(&audioBytes);
+	// Converting straight from the packet saves the copy
+	if (m_audioTransform != NULL)
+		m_audioTransform->Process(audioBytes, buffer->bytes, frameCount);
+	else
+		memcpy(buffer->bytes, audioBytes, buffer->size);
+
+	buffer->fileDescriptor = m_audioOutputFile;
+	QueueBuffer(buffer);
+}
+
+void CaptureInput::VideoFormatChanged(BMDVideoInputFormatChangedEvents events, IDeckLinkDisplayMode* mode, BMDDetectedVideoInputFormatFlags formatFlags)
+{
+	// This only gets called if bmdVideoInputEnableFormatDetection was set
+	// when enabling video input
+	uint64_t		eventTime = FormatReconfigurator::GetNanoseconds();
+	char*			displayModeName = NULL;
+	BMDPixelFormat	pixelFormat = m_pixelFormat;
+	FormatChange	change;
+
+	if (events & bmdVideoInputColorspaceChanged)
+	{
+		// Detected a change in colorspace, change pixel format to match detected format
+		if (formatFlags & bmdDetectedVideoInputRGB444)
+			pixelFormat = bmdFormat10BitRGB;
+		else if (formatFlags & bmdDetectedVideoInputYCbCr422)
+			pixelFormat = (m_config->m_pixelFormat == bmdFormat8BitYUV) ? bmdFormat8BitYUV : bmdFormat10BitYUV;
+		else
+			return;
+	}
+
+	// Restart streams if either display mode or pixel format have changed
+	if ((events & bmdVideoInputDisplayModeChanged) || (m_pixelFormat != pixelFormat))
+	{
+		mode->GetName((const char**)&displayModeName);
+		printf("%s: Video format changed to %s %s\n", m_name, displayModeName, formatFlags & bmdDetectedVideoInputRGB444 ? "RGB" : "YUV");
+
+		change.displayMode	= mode->GetDisplayMode();
+		change.pixelFormat	= pixelFormat;
+		change.eventTime	= eventTime;
+		mode->GetFrameRate(&change.frameDuration, &change.timeScale);
+		snprintf(change.name, sizeof(change.name), "%s %s", displayModeName ? displayModeName : "unknown mode", formatFlags & bmdDetectedVideoInputRGB444 ? "RGB" : "YUV");
+
+		if (displayModeName)
+			free(displayModeName);
+
+		// Restarting the streams from their own callback would hold up the callback
+		// thread for the whole switch
+		m_reconfigurator->RequestChange(change);
+	}
+}
+
+void CaptureInput::ApplyFormatChange(const FormatChange& change)
+{
+	// No frames arrive while the reconfigurator has the streams stopped
+	m_displayMode	= change.displayMode;
+	m_pixelFormat	= change.pixelFormat;
+	m_frameDuration	= change.frameDuration;
+	m_timeScale		= change.timeScale;
+	m_formatChanged	= true;
+}
+
+CaptureBuffer* CaptureInput::CompressRecord(const uint8_t* record, size_t backlog)
+{
+	const RawFrameHeader*	header = (const RawFrameHeader*)record;
+	const uint8_t*			payload = record + kRawContainerAlignment;
+
+	FRAME_TRACE_SPAN("CompressRecord", header->frameNumber);
+
+	// Writing raw costs more disk bandwidth but no CPU, so when frames queue up the
+	// compressor is the bottleneck and frames are stored raw until it catches up
+	if (backlog >= (size_t)m_config->m_bufferedFrames / 2)
+	{
+		m_framesStoredRaw++;
+		return NULL;
+	}
+
+	CaptureBuffer* compressed = m_compressedBuffers.Acquire(RawRecordSize(m_compressor->MaxStoredSize(header->videoSize, header->rowBytes), header->audioSize));
+	if (compressed == NULL)
+	{
+		m_framesStoredRaw++;
+		return NULL;
+	}
+
+	RawFrameHeader*	compressedHeader = (RawFrameHeader*)compressed->bytes;
+	uint8_t*		compressedPayload = compressed->bytes + kRawContainerAlignment;
+
+	memcpy(compressedHeader, header, kRawContainerAlignment);
+
+	size_t videoSize = m_compressor->CompressFrame(payload, header->videoSize, header->rowBytes, compressedPayload, compressed->capacity - kRawContainerAlignment, compressedHeader);
+	if (videoSize == 0)
+	{
+		m_framesStoredRaw++;
+		compressed->pool->Release(compressed);
+		return NULL;
+	}
+
+	memcpy(compressedPayload + videoSize, payload + header->videoSize, header->audioSize);
+
+	compressedHeader->recordSize = RawRecordSize(videoSize, header->audioSize);
+	compressed->size = compressedHeader->recordSize;
+	memset(compressedPayload + videoSize + header->audioSize, 0, compressed->size - kRawContainerAlignment - videoSize - header->audioSize);
+
+	return compressed;
+}
+
+size_t CaptureInput::WriteContainerRecord(const uint8_t* record, size_t backlog)
+{
+	// The writer rotates segments and builds the index
+	CaptureBuffer*	compressed = (m_compressor != NULL) ? CompressRecord(record, backlog) : NULL;
+	size_t			written = 0;
+
+	if (compressed != NULL)
+		record = compressed->bytes;
+
+	FRAME_TRACE_SPAN("WriteContainerRecord", ((const RawFrameHeader*)record)->frameNumber);
+
+	if (m_container->WriteRecord(record))
+		written = ((const RawFrameHeader*)record)->recordSize;
+	else
+		m_writeErrors++;
+
+	if (compressed != NULL)
+		compressed->pool->Release(compressed);
+
+	return written;
+}
+
+bool CaptureInput::HasPendingWrites()
+{
+	if (m_preRecord != NULL && m_preRecord->GetPendingCount() > 0)
+		return true;
+
+	pthread_mutex_lock(&m_queueMutex);
+	bool pending = !m_writeQueue.empty();
+	pthread_mutex_unlock(&m_queueMutex);
+
+	return pending;
+}
+
+size_t CaptureInput::ServiceWrites(size_t byteBudget)
+{
+	size_t written = 0;
+
+	// Once triggered, the pre-record ring holds the recording from its oldest frame
+	while (m_preRecord != NULL && written < byteBudget)
+	{
+		const uint8_t* record = m_preRecord->BeginRead();
+		if (record == NULL)
+			break;
+
+		m_bytesWritten += WriteContainerRecord(record, m_preRecord->GetPendingCount() - 1);
+		written += ((const RawFrameHeader*)record)->recordSize;
+		m_preRecord->EndRead();
+	}
+
+	while (written < byteBudget)
+	{
+		CaptureBuffer*	buffer;
+		size_t			backlog;
+
+		pthread_mutex_lock(&m_queueMutex);
+		if (m_writeQueue.empty())
+		{
+			pthread_mutex_unlock(&m_queueMutex);
+			break;
+		}
+		buffer = m_writeQueue.front();
+		m_writeQueue.pop_front();
+		backlog = m_writeQueue.size();
+		pthread_mutex_unlock(&m_queueMutex);
+
+		size_t offset = 0;
+		if (buffer->fileDescriptor < 0)
+		{
+			offset = WriteContainerRecord(buffer->bytes, backlog);
+		}
+		else
+		{
+			while (offset < buffer->size)
+			{
+				ssize_t result = write(buffer->fileDescriptor, buffer->bytes + offset, buffer->size - offset);
+				if (result < 0)
+				{
+					if (errno == EINTR)
+						continue;
+
+					m_writeErrors++;
+					break;
+				}
+				offset += result;
+			}
+		}
+
+		m_bytesWritten += offset;
+		written += buffer->size;
+		buffer->pool->Release(buffer);
+	}
+
+	return written;
+}
@@ -0,0 +1,157 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __CAPTURE_INPUT_H__
+#define __CAPTURE_INPUT_H__
+
+#include <atomic>
+#include <deque>
+#include <pthread.h>
+#include "DeckLinkAPI.h"
+#include "CaptureBufferPool.h"
+#include "IOScheduler.h"
+#include "RawContainer.h"
+#include "SliceCompressor.h"
+#include "FrameChecksum.h"
+#include "FramePublisher.h"
+#include "PreRecordRing.h"
+#include "FormatReconfigurator.h"
+#include "AudioTransform.h"
+
+class BMDConfig;
+class DeckLinkCaptureDelegate;
+
+struct CaptureStatistics
+{
+	uint64_t	framesReceived;
+	uint64_t	framesWithoutSignal;
+	uint64_t	framesDropped;			// No free buffer large enough, usually the writer falling behind
+	uint64_t	framesStoredRaw;		// Not compressed, the compressor is falling behind
+	uint64_t	audioPacketsDropped;
+	uint64_t	bytesWritten;
+	uint64_t	writeErrors;
+	uint32_t	queuedBuffers;
+};
+
+// One capture device with its own callback, buffers and output files.  Frames are
+// copied into pooled buffers on the capture thread and written out by the shared
+// IOScheduler.
+class CaptureInput : public IOStream, public FormatChangeTarget
+{
+public:
+	CaptureInput(int inputNumber, BMDConfig* config, IOScheduler* scheduler, SliceCompressor* compressor, FrameChecksum* checksum);
+	virtual ~CaptureInput();
+
+	bool		Open(IDeckLink* deckLink);
+	bool		Start(void);
+	void		Stop(void);
+
+	int			GetInputNumber(void) const { return m_inputNumber; }
+	const char*	GetName(void) const { return m_name; }
+	bool		IsFinished(void) const { return m_finished; }
+	// Starts writing the pre-record ring to the container, from its oldest frame
+	void		StartRecording(void);
+	void		GetStatistics(CaptureStatistics& statistics);
+
+	// Called from DeckLinkCaptureDelegate
+	void		VideoFrameArrived(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkAudioInputPacket* audioPacket);
+	void		AudioPacketArrived(IDeckLinkAudioInputPacket* audioPacket);
+	void		VideoFormatChanged(BMDVideoInputFormatChangedEvents events, IDeckLinkDisplayMode* mode, BMDDetectedVideoInputFormatFlags formatFlags);
+
+	// IOStream
+	virtual size_t	ServiceWrites(size_t byteBudget);
+	virtual bool	HasPendingWrites(void);
+
+	// FormatChangeTarget
+	virtual void	ApplyFormatChange(const FormatChange& change);
+
+private:
+	void		QueueBuffer(CaptureBuffer* buffer);
+	bool		OpenOutputFile(const char* filename, int& fileDescriptor);
+	size_t		GetLargestFrameSize(IDeckLinkDisplayMode* displayMode, long& rowBytes);
+	bool		OpenPublisher(IDeckLinkDisplayMode* displayMode);
+	bool		OpenPreRecord(size_t frameSize, size_t maxAudioSize);
+	CaptureBuffer*	CompressRecord(const uint8_t* record, size_t backlog);
+	size_t		WriteContainerRecord(const uint8_t* record, size_t backlog);
+	void		QueueContainerRecord(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkVideoFrame* rightEyeFrame, IDeckLinkAudioInputPacket* audioPacket, IDeckLinkTimecode* timecode);
+	void		FillContainerRecord(uint8_t* record, size_t recordSize, IDeckLinkVideoInputFrame* videoFrame, IDeckLinkVideoFrame* rightEyeFrame, IDeckLinkAudioInputPacket* audioPacket, IDeckLinkTimecode* timecode);
+
+	int							m_inputNumber;
+	BMDConfig*					m_config;
+	IOScheduler*				m_scheduler;
+	SliceCompressor*			m_compressor;
+	FrameChecksum*				m_checksum;				// Container records get CRC32C checksums when set
+
+	IDeckLinkInput*				m_deckLinkInput;
+	DeckLinkCaptureDelegate*	m_delegate;
+	FormatReconfigurator*		m_reconfigurator;		// Only with format detection
+	char*						m_name;
+	BMDDisplayMode				m_displayMode;
+	BMDPixelFormat				m_pixelFormat;
+	BMDVideoInputFlags			m_inputFlags;
+	BMDTimeValue				m_frameDuration;
+	BMDTimeScale				m_timeScale;
+	bool						m_formatChanged;		// Marks the next container record
+	bool						m_verbose;
+
+	int							m_videoOutputFile;
+	int							m_audioOutputFile;
+	FramePublisher*				m_publisher;			// Also the input's frame allocator
+	RawContainerWriter*			m_container;			// Written by the IOScheduler, buffers have no file descriptor
+	PreRecordRing*				m_preRecord;			// Replaces m_videoBuffers for container records
+	CaptureBufferPool			m_videoBuffers;
+	CaptureBufferPool			m_audioBuffers;
+	AudioTransform*				m_audioTransform;		// Converts audio on its way into m_audioBuffers
+	CaptureBufferPool			m_compressedBuffers;
+
+	pthread_mutex_t				m_queueMutex;
+	std::deque<CaptureBuffer*>	m_writeQueue;
+
+	std::atomic<unsigned long>	m_frameCount;
+	std::atomic<bool>			m_finished;
+	std::atomic<uint64_t>		m_framesWithoutSignal;
+	std::atomic<uint64_t>		m_framesDropped;
+	std::atomic<uint64_t>		m_framesStoredRaw;
+	std::atomic<uint64_t>		m_audioPacketsDropped;
+	std::atomic<uint64_t>		m_bytesWritten;
+	std::atomic<uint64_t>		m_writeErrors;
+};
+
+#endif
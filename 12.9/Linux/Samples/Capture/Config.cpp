@@ -50,14 +50,29 @@ BMDConfig::BMDConfig() :
 	m_displayModeIndex(-2),
 	m_audioChannels(2),
 	m_audioSampleDepth(16),
+	m_transformAudio(false),
+	m_audioOutputFormat(kAudioSampleInt16),
+	m_audioPlanar(false),
 	m_maxFrames(-1),
+	m_writerThreads(2),
+	m_bufferedFrames(16),
 	m_inputFlags(bmdVideoInputFlagDefault),
 	m_pixelFormat(bmdFormat8BitYUV),
 	m_timecodeFormat(),
 	m_videoOutputFile(),
 	m_audioOutputFile(),
+	m_containerOutput(),
+	m_publishName(),
+	m_segmentSeconds(0),
+	m_segmentBytes(0),
+	m_preRecordSeconds(0),
+	m_compression(kRawCompressionNone),
+	m_compressionLevel(1),
+	m_compressionThreads(0),
+	m_checksumThreads(4),
 	m_deckLinkName(),
-	m_displayModeName()
+	m_displayModeName(),
+	m_audioRouting()
 {
 }
 
@@ -75,12 +90,36 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 	int		ch;
 	bool	displayHelp = false;
 
-	while ((ch = getopt(argc, argv, "d:?h3c:s:v:a:m:n:p:t:")) != -1)
+	while ((ch = getopt(argc, argv, "d:i:?h3c:s:v:a:F:R:o:T:M:B:C:W:K:P:m:n:p:t:w:q:")) != -1)
 	{
 		switch (ch)
 		{
 			case 'd':
-				m_deckLinkIndex = atoi(optarg);
+				m_deckLinkSelectors.push_back({ false, atoi(optarg) });
+				if (m_deckLinkIndex < 0)
+					m_deckLinkIndex = atoi(optarg);
+				break;
+
+			case 'i':
+				m_deckLinkSelectors.push_back({ true, (int64_t)strtoull(optarg, NULL, 16) });
+				break;
+
+			case 'w':
+				m_writerThreads = atoi(optarg);
+				if (m_writerThreads < 1)
+				{
+					fprintf(stderr, "Invalid argument: At least one writer thread is required\n");
+					return false;
+				}
+				break;
+
+			case 'q':
+				m_bufferedFrames = atoi(optarg);
+				if (m_bufferedFrames < 2)
+				{
+					fprintf(stderr, "Invalid argument: At least two frames must be buffered\n");
+					return false;
+				}
 				break;
 
 			case 'm':
@@ -91,9 +130,11 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 				m_audioChannels = atoi(optarg);
 				if (m_audioChannels != 2 &&
 					m_audioChannels != 8 &&
-					m_audioChannels != 16)
+					m_audioChannels != 16 &&
+					m_audioChannels != 32 &&
+					m_audioChannels != 64)
 				{
-					fprintf(stderr, "Invalid argument: Audio Channels must be either 2, 8 or 16\n");
+					fprintf(stderr, "Invalid argument: Audio Channels must be either 2, 8, 16, 32 or 64\n");
 					return false;
 				}
 				break;
@@ -115,6 +156,96 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 				m_audioOutputFile = optarg;
 				break;
 
+			case 'F':
+				if (!AudioTransform::ParseSampleFormat(optarg, m_audioOutputFormat, m_audioPlanar))
+				{
+					fprintf(stderr, "Invalid argument: Audio format must be s16, s32 or f32, with an optional p for planar\n");
+					return false;
+				}
+				m_transformAudio = true;
+				break;
+
+			case 'R':
+				m_audioRouting = optarg;
+				break;
+
+			case 'o':
+				m_containerOutput = optarg;
+				break;
+
+			case 'T':
+				m_segmentSeconds = atof(optarg);
+				if (m_segmentSeconds < 0)
+				{
+					fprintf(stderr, "Invalid argument: Segment duration must not be negative\n");
+					return false;
+				}
+				break;
+
+			case 'M':
+				if (atoi(optarg) < 0)
+				{
+					fprintf(stderr, "Invalid argument: Segment size must not be negative\n");
+					return false;
+				}
+				m_segmentBytes = (uint64_t)atoi(optarg) << 20;
+				break;
+
+			case 'B':
+				m_preRecordSeconds = atof(optarg);
+				if (m_preRecordSeconds <= 0)
+				{
+					fprintf(stderr, "Invalid argument: Pre-record time must be positive\n");
+					return false;
+				}
+				break;
+
+			case 'C':
+			{
+				const char* level = strchr(optarg, ':');
+				size_t nameLength = level ? (size_t)(level - optarg) : strlen(optarg);
+
+				if (nameLength == 3 && !strncmp(optarg, "lz4", 3))
+					m_compression = kRawCompressionLZ4;
+				else if (nameLength == 4 && !strncmp(optarg, "zstd", 4))
+					m_compression = kRawCompressionZstd;
+				else
+				{
+					fprintf(stderr, "Invalid argument: Compression \"%s\" is invalid\n", optarg);
+					return false;
+				}
+
+				m_compressionLevel = level ? atoi(level + 1) : 1;
+				if (m_compressionLevel < 1)
+				{
+					fprintf(stderr, "Invalid argument: Compression level must be at least 1\n");
+					return false;
+				}
+				break;
+			}
+
+			case 'W':
+				m_compressionThreads = atoi(optarg);
+				if (m_compressionThreads < 1)
+				{
+					fprintf(stderr, "Invalid argument: At least one compression thread is required\n");
+					return false;
+				}
+				break;
+
+			case 'K':
+				m_checksumThreads = atoi(optarg);
+				if (m_checksumThreads < 0)
+				{
+					fprintf(stderr, "Invalid argument: Checksum threads must not be negative\n");
+					return false;
+				}
+				break;
+
+			case 'P':
+				m_publishName = optarg;
+				break;
+
 			case 'n':
 				m_maxFrames = atoi(optarg);
 				break;
@@ -155,7 +286,7 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 		}
 	}
 
-	if (m_deckLinkIndex < 0)
+	if (m_deckLinkSelectors.empty())
 	{
 		fprintf(stderr, "You must select a device\n");
 		DisplayUsage(1);
@@ -167,6 +298,47 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 		DisplayUsage(1);
 	}
 
+	if (m_containerOutput != NULL && (m_videoOutputFile != NULL || m_audioOutputFile != NULL))
+	{
+		fprintf(stderr, "A container recording already holds video and audio, it can not be combined with -v or -a\n");
+		DisplayUsage(1);
+	}
+
+	if (m_preRecordSeconds > 0 && m_containerOutput == NULL)
+	{
+		fprintf(stderr, "Pre-record writes to the container, it requires -o\n");
+		DisplayUsage(1);
+	}
+
+	if (m_compression != kRawCompressionNone && m_containerOutput == NULL)
+	{
+		fprintf(stderr, "Compression stores slice sizes in the container, it requires -o\n");
+		DisplayUsage(1);
+	}
+
+	if (m_audioRouting != NULL)
+	{
+		// Channel numbers are checked against the final channel count
+		if (!AudioTransform::ParseRouting(m_audioRouting, m_audioChannels, m_audioRoutes))
+		{
+			fprintf(stderr, "Invalid argument: Audio routing \"%s\" is not a list of input channels 0 to %d\n", m_audioRouting, m_audioChannels - 1);
+			return false;
+		}
+
+		if (!m_transformAudio)
+			m_audioOutputFormat = (m_audioSampleDepth == 16) ? kAudioSampleInt16 : kAudioSampleInt32;
+		m_transformAudio = true;
+	}
+
+	if (m_transformAudio && m_audioOutputFile == NULL)
+	{
+		fprintf(stderr, "Audio conversion applies to the audio written with -a\n");
+		DisplayUsage(1);
+	}
+
+	if (m_compressionThreads == 0)
+		m_compressionThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
 	if (displayHelp)
 		DisplayUsage(0);
 
@@ -203,13 +375,20 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 	return true;
 }
 
-IDeckLink* BMDConfig::GetSelectedDeckLink()
+IDeckLink* BMDConfig::GetSelectedDeckLink(size_t selectorIndex)
 {
-	HRESULT				result;
+	HRESULT				result = E_FAIL;
 	IDeckLink*			deckLink;
-	IDeckLinkIterator*	deckLinkIterator = CreateDeckLinkIteratorInstance();
-	int					i = m_deckLinkIndex;
+	IDeckLinkIterator*	deckLinkIterator;
+	int64_t				i;
 
+	if (selectorIndex >= m_deckLinkSelectors.size())
+		return NULL;
+
+	const DeckLinkSelector& selector = m_deckLinkSelectors[selectorIndex];
+	i = selector.value;
+
+	deckLinkIterator = CreateDeckLinkIteratorInstance();
 	if (!deckLinkIterator)
 	{
 		fprintf(stderr, "This application requires the DeckLink drivers installed.\n");
@@ -232,9 +411,23 @@ IDeckLink* BMDConfig::GetSelectedDeckLink()
 		if ((deckLinkAttributes->GetInt(BMDDeckLinkVideoIOSupport, &intAttribute) == S_OK) && 
 			((intAttribute & bmdDeviceSupportsCapture) != 0))
 		{
-			if (i == 0)
-				break;
-			--i;
+			if (selector.usePersistentID)
+			{
+				if ((deckLinkAttributes->GetInt(BMDDeckLinkPersistentID, &intAttribute) == S_OK) && (intAttribute == i))
+				{
+					deckLinkAttributes->Release();
+					break;
+				}
+			}
+			else
+			{
+				if (i == 0)
+				{
+					deckLinkAttributes->Release();
+					break;
+				}
+				--i;
+			}
 		}
 
 		deckLinkAttributes->Release();
@@ -249,6 +442,26 @@ IDeckLink* BMDConfig::GetSelectedDeckLink()
 	return deckLink;
 }
 
+std::string BMDConfig::GetOutputFilename(const char* filename, int inputNumber) const
+{
+	std::string	name(filename);
+	size_t		position;
+
+	if (m_deckLinkSelectors.size() <= 1)
+		return name;
+
+	position = name.find("%d");
+	if (position != std::string::npos)
+		return name.replace(position, 2, std::to_string(inputNumber));
+
+	// Insert before the extension, unless the only dot is in a directory name
+	position = name.rfind('.');
+	if (position == std::string::npos || name.find('/', position) != std::string::npos)
+		position = name.size();
+
+	return name.insert(position, "-" + std::to_string(inputNumber));
+}
+
 IDeckLinkDisplayMode* BMDConfig::GetSelectedDeckLinkDisplayMode(IDeckLink* deckLink)
 {
 	HRESULT							result;
@@ -316,9 +529,9 @@ void BMDConfig::DisplayUsage(int status)
 	char*							displayModeName;
 
 	fprintf(stderr,
-		"Usage: Capture -d <device id> -m <mode id> [OPTIONS]\n"
+		"Usage: Capture -d <device id> [-d <device id> ...] -m <mode id> [OPTIONS]\n"
 		"\n"
-		"    -d <device id>:\n"
+		"    -d <device id>:      May be repeated to capture from several devices\n"
 	);
 
 	// Loop through all available devices
@@ -438,16 +651,33 @@ bail:
 		"         0:  8 bit YUV (4:2:2) (default)\n"
 		"         1:  10 bit YUV (4:2:2)\n"
 		"         2:  10 bit RGB (4:4:4)\n"
-		"    -t <format>          Print timecode\n"
+		"    -t <format>          Print timecode, and record it with -o\n"
 		"         rp188:  RP 188\n"
 		"         vitc:   VITC\n"
 		"         serial: Serial Timecode\n"
 		"    -v <filename>        Filename raw video will be written to\n"
 		"    -a <filename>        Filename raw audio will be written to\n"
-		"    -c <channels>        Audio Channels (2, 8 or 16 - default is 2)\n"
+		"    -F <format>          Convert the audio written with -a to s16, s32 or f32, add p for planar packets (eg. f32p)\n"
+		"    -R <routing>         Route audio channels, each output is a sum of inputs with optional gains\n"
+		"                         (eg. 0+2*0.707+4*0.5,1+2*0.707+5*0.5 for a stereo downmix)\n"
+		"    -o <basename>        Record video, audio and timecode to indexed segments <basename>.NNNNNN.dlraw\n"
+		"    -T <seconds>         Start a new segment after this much stream time (default is unlimited)\n"
+		"    -M <megabytes>       Start a new segment before it exceeds this size (default is unlimited)\n"
+		"    -B <seconds>         Keep the last <seconds> in memory, and only record from then on after SIGUSR1\n"
+		"    -C <lz4|zstd>[:level] Compress video in the container, level is the LZ4 acceleration or zstd level (default is 1)\n"
+		"    -W <threads>         Compression threads shared by all inputs (default is one per CPU)\n"
+		"    -K <threads>         Threads for the CRC32C checksums of container frames, 0 disables them (default is 4)\n"
+		"    -P <name>            Publish frames to other processes in shared memory object <name>\n"
+		"    -c <channels>        Audio Channels (2, 8, 16, 32 or 64 - default is 2)\n"
 		"    -s <depth>           Audio Sample Depth (16 or 32 - default is 16)\n"
 		"    -n <frames>          Number of frames to capture (default is unlimited)\n"
 		"    -3                   Capture Stereoscopic 3D (Requires 3D Hardware support)\n"
+		"    -i <persistent id>   Select a device by its hexadecimal persistent ID, may be repeated\n"
+		"    -w <threads>         Writer threads shared by all inputs (default is 2)\n"
+		"    -q <frames>          Frames buffered per input before frames are dropped (default is 16)\n"
+		"\n"
+		"With several devices, output filenames get the input number inserted before the\n"
+		"extension, or in place of %%d if the filename contains it.\n"
 		"\n"
 		"Capture video and/or audio to a file. Raw video and/or audio can be viewed with mplayer eg:\n"
 		"\n"
@@ -476,12 +706,13 @@ bail:
 void BMDConfig::DisplayConfiguration()
 {
 	fprintf(stderr, "Capturing with the following configuration:\n"
-		" - Capture device: %s\n"
+		" - Capture device: %s%s\n"
 		" - Video mode: %s %s\n"
 		" - Pixel format: %s\n"
 		" - Audio channels: %u\n"
 		" - Audio sample depth: %u bit \n",
 		m_deckLinkName,
+		(m_deckLinkSelectors.size() > 1) ? " and others" : "",
 		m_displayModeName,
 		(m_inputFlags & bmdVideoInputDualStream3D) ? "3D" : "",
 		GetPixelFormatName(m_pixelFormat),
@@ -41,7 +41,19 @@
 #ifndef BMD_CONFIG_H
 #define BMD_CONFIG_H
 
+#include <string>
+#include <vector>
 #include "DeckLinkAPI.h"
+#include "RawContainer.h"
+#include "AudioTransform.h"
+
+// A capture device is selected either by its index among capture devices or by
+// its persistent ID, which stays the same across reboots and slot changes
+struct DeckLinkSelector
+{
+	bool					usePersistentID;
+	int64_t					value;
+};
 
 class BMDConfig
 {
@@ -54,12 +66,20 @@ public:
 	void DisplayConfiguration();
 
 	int						m_deckLinkIndex;
+	std::vector<DeckLinkSelector>	m_deckLinkSelectors;
 	int						m_displayModeIndex;
 
 	int						m_audioChannels;
 	int						m_audioSampleDepth;
+	// Conversion of the audio written with -a, only when m_transformAudio is set
+	bool					m_transformAudio;
+	AudioSampleFormat		m_audioOutputFormat;
+	bool					m_audioPlanar;
+	std::vector<AudioRoute>	m_audioRoutes;
 
 	int						m_maxFrames;
+	int						m_writerThreads;
+	int						m_bufferedFrames;
 
 	BMDVideoInputFlags		m_inputFlags;
 	BMDPixelFormat			m_pixelFormat;
@@ -67,13 +87,26 @@ public:
 
 	const char*				m_videoOutputFile;
 	const char*				m_audioOutputFile;
+	const char*				m_containerOutput;
+	const char*				m_publishName;
+	double					m_segmentSeconds;
+	uint64_t				m_segmentBytes;
+	double					m_preRecordSeconds;
+	RawCompression			m_compression;
+	int						m_compressionLevel;
+	int						m_compressionThreads;
+	int						m_checksumThreads;		// 0 records without checksums
 
-	IDeckLink* GetSelectedDeckLink(void);
+	IDeckLink* GetSelectedDeckLink(size_t selectorIndex = 0);
+	// Output filename for one of several inputs: "%d" in the name is replaced with the
+	// input number, otherwise the number is inserted before the extension
+	std::string GetOutputFilename(const char* filename, int inputNumber) const;
 	IDeckLinkDisplayMode* GetSelectedDeckLinkDisplayMode(IDeckLink* deckLink);
 
 private:
 	char*					m_deckLinkName;
 	char*					m_displayModeName;
+	const char*				m_audioRouting;
 
 	static const char* GetPixelFormatName(BMDPixelFormat pixelFormat);
 };
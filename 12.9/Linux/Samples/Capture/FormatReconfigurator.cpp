@@ -0,0 +1,247 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "FormatReconfigurator.h"
+
+// A switch with no frame by then is reported without its first frame time, the new
+// source may simply have no signal yet
+static const int	kFirstFrameTimeoutSeconds	= 5;
+
+uint64_t FormatReconfigurator::GetNanoseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+FormatReconfigurator::FormatReconfigurator(const char* name, IDeckLinkInput* deckLinkInput, BMDVideoInputFlags inputFlags, FormatChangeTarget* target) :
+	m_name(name),
+	m_deckLinkInput(deckLinkInput),
+	m_inputFlags(inputFlags),
+	m_target(target),
+	m_running(false),
+	m_stopping(false),
+	m_hasPending(false),
+	m_awaitingFrame(false),
+	m_firstFrameTime(0),
+	m_changeCount(0)
+{
+	memset(&m_pending, 0, sizeof(m_pending));
+	pthread_mutex_init(&m_mutex, NULL);
+	pthread_cond_init(&m_cond, NULL);
+}
+
+FormatReconfigurator::~FormatReconfigurator()
+{
+	Stop();
+
+	pthread_cond_destroy(&m_cond);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+bool FormatReconfigurator::Start()
+{
+	m_stopping		= false;
+	m_hasPending	= false;
+
+	if (pthread_create(&m_thread, NULL, ThreadFunc, this) != 0)
+	{
+		fprintf(stderr, "%s: Could not create format change thread\n", m_name);
+		return false;
+	}
+
+	m_running = true;
+	return true;
+}
+
+void FormatReconfigurator::Stop()
+{
+	if (!m_running)
+		return;
+
+	pthread_mutex_lock(&m_mutex);
+	m_stopping = true;
+	pthread_cond_signal(&m_cond);
+	pthread_mutex_unlock(&m_mutex);
+
+	pthread_join(m_thread, NULL);
+	m_running		= false;
+	m_awaitingFrame	= false;
+}
+
+void FormatReconfigurator::RequestChange(const FormatChange& change)
+{
+	pthread_mutex_lock(&m_mutex);
+	m_pending		= change;
+	m_hasPending	= true;
+	pthread_cond_signal(&m_cond);
+	pthread_mutex_unlock(&m_mutex);
+}
+
+void FormatReconfigurator::FirstFrameArrived()
+{
+	// Only the first frame after a switch records its time
+	if (!m_awaitingFrame.exchange(false))
+		return;
+
+	pthread_mutex_lock(&m_mutex);
+	m_firstFrameTime = GetNanoseconds();
+	pthread_cond_signal(&m_cond);
+	pthread_mutex_unlock(&m_mutex);
+}
+
+void* FormatReconfigurator::ThreadFunc(void* context)
+{
+	static_cast<FormatReconfigurator*>(context)->Run();
+	return NULL;
+}
+
+void FormatReconfigurator::Run()
+{
+	pthread_mutex_lock(&m_mutex);
+
+	while (!m_stopping)
+	{
+		if (!m_hasPending)
+		{
+			pthread_cond_wait(&m_cond, &m_mutex);
+			continue;
+		}
+
+		FormatChange	change = m_pending;
+		Timings			timings;
+
+		m_hasPending = false;
+		pthread_mutex_unlock(&m_mutex);
+
+		memset(&timings, 0, sizeof(timings));
+		timings.dequeued = GetNanoseconds();
+
+		bool restarted = Reconfigure(change, timings);
+
+		pthread_mutex_lock(&m_mutex);
+		if (!restarted)
+			continue;
+
+		m_changeCount++;
+
+		// Wait for the first frame in the new format, unless the input is stopped or
+		// the format changes again first
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += kFirstFrameTimeoutSeconds;
+
+		while (m_firstFrameTime == 0 && !m_stopping && !m_hasPending)
+		{
+			if (pthread_cond_timedwait(&m_cond, &m_mutex, &deadline) == ETIMEDOUT)
+				break;
+		}
+
+		bool superseded = m_hasPending;
+
+		m_awaitingFrame		= false;
+		timings.firstFrame	= m_firstFrameTime;
+		pthread_mutex_unlock(&m_mutex);
+
+		Report(change, timings, superseded);
+
+		pthread_mutex_lock(&m_mutex);
+	}
+
+	pthread_mutex_unlock(&m_mutex);
+}
+
+bool FormatReconfigurator::Reconfigure(const FormatChange& change, Timings& timings)
+{
+	m_deckLinkInput->StopStreams();
+	timings.stopped = GetNanoseconds();
+
+	if (m_deckLinkInput->EnableVideoInput(change.displayMode, change.pixelFormat, m_inputFlags) != S_OK)
+	{
+		fprintf(stderr, "%s: Failed to switch video mode to %s\n", m_name, change.name);
+		return false;
+	}
+	timings.enabled = GetNanoseconds();
+
+	m_target->ApplyFormatChange(change);
+	timings.applied = GetNanoseconds();
+
+	pthread_mutex_lock(&m_mutex);
+	m_firstFrameTime = 0;
+	pthread_mutex_unlock(&m_mutex);
+	m_awaitingFrame = true;
+
+	if (m_deckLinkInput->StartStreams() != S_OK)
+	{
+		m_awaitingFrame = false;
+		fprintf(stderr, "%s: Failed to restart streams in %s\n", m_name, change.name);
+		return false;
+	}
+	timings.started = GetNanoseconds();
+
+	return true;
+}
+
+void FormatReconfigurator::Report(const FormatChange& change, const Timings& timings, bool superseded)
+{
+	const double	toMilliseconds = 1e-6;
+	char			firstFrame[64];
+
+	if (timings.firstFrame != 0)
+		snprintf(firstFrame, sizeof(firstFrame), "%.1f ms", (timings.firstFrame - timings.started) * toMilliseconds);
+	else
+		snprintf(firstFrame, sizeof(firstFrame), "%s", superseded ? "superseded" : "none");
+
+	// Downtime runs from the notification to the first frame in the new format
+	fprintf(stderr, "%s: Switched to %s, downtime %.1f ms (queued %.1f, stop %.1f, enable %.1f, apply %.1f, start %.1f ms, first frame %s)\n",
+		m_name, change.name,
+		((timings.firstFrame != 0 ? timings.firstFrame : timings.started) - change.eventTime) * toMilliseconds,
+		(timings.dequeued - change.eventTime) * toMilliseconds,
+		(timings.stopped - timings.dequeued) * toMilliseconds,
+		(timings.enabled - timings.stopped) * toMilliseconds,
+		(timings.applied - timings.enabled) * toMilliseconds,
+		(timings.started - timings.applied) * toMilliseconds,
+		firstFrame);
+}
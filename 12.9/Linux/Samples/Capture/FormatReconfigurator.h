@@ -0,0 +1,131 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+
+#ifndef __FORMAT_RECONFIGURATOR_H__
+#define __FORMAT_RECONFIGURATOR_H__
+
+#include <atomic>
+#include <pthread.h>
+#include <stdint.h>
+#include "DeckLinkAPI.h"
+
+struct FormatChange
+{
+	BMDDisplayMode	displayMode;
+	BMDPixelFormat	pixelFormat;
+	BMDTimeValue	frameDuration;
+	BMDTimeScale	timeScale;
+	char			name[64];
+	uint64_t		eventTime;		// CLOCK_MONOTONIC nanoseconds of the notification
+};
+
+class FormatChangeTarget
+{
+public:
+	virtual ~FormatChangeTarget() {}
+
+	// Called on the reconfiguration thread once the new mode is enabled, while the
+	// streams are stopped and no capture callback can run
+	virtual void	ApplyFormatChange(const FormatChange& change) = 0;
+};
+
+// Restarts an input in a newly detected format on its own thread, so the capture
+// callback returns immediately.  A change that arrives while one is in progress
+// replaces any change still waiting.  Each switch is timed through stop, enable,
+// apply and start up to the first frame with a signal, and reported on stderr.
+class FormatReconfigurator
+{
+public:
+	FormatReconfigurator(const char* name, IDeckLinkInput* deckLinkInput, BMDVideoInputFlags inputFlags, FormatChangeTarget* target);
+	virtual ~FormatReconfigurator();
+
+	bool		Start(void);
+	// Waits for a switch in progress, and discards a waiting one
+	void		Stop(void);
+
+	// Called from the capture callback
+	void		RequestChange(const FormatChange& change);
+	// Called for every frame with a signal, cheap unless a switch is waiting for it
+	void		FrameArrived(void)
+	{
+		if (m_awaitingFrame.load(std::memory_order_relaxed))
+			FirstFrameArrived();
+	}
+
+	uint32_t	GetChangeCount(void) const { return m_changeCount; }
+
+	static uint64_t	GetNanoseconds(void);
+
+private:
+	struct Timings
+	{
+		uint64_t	dequeued;
+		uint64_t	stopped;
+		uint64_t	enabled;
+		uint64_t	applied;
+		uint64_t	started;
+		uint64_t	firstFrame;
+	};
+
+	static void*	ThreadFunc(void* context);
+	void			Run(void);
+	bool			Reconfigure(const FormatChange& change, Timings& timings);
+	void			FirstFrameArrived(void);
+	void			Report(const FormatChange& change, const Timings& timings, bool superseded);
+
+	const char*				m_name;
+	IDeckLinkInput*			m_deckLinkInput;
+	BMDVideoInputFlags		m_inputFlags;
+	FormatChangeTarget*		m_target;
+
+	pthread_mutex_t			m_mutex;
+	pthread_cond_t			m_cond;
+	pthread_t				m_thread;
+	bool					m_running;
+	bool					m_stopping;
+	bool					m_hasPending;
+	FormatChange			m_pending;
+	std::atomic<bool>		m_awaitingFrame;
+	uint64_t				m_firstFrameTime;
+	uint32_t				m_changeCount;
+};
+
+#endif
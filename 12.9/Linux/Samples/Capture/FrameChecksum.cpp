@@ -0,0 +1,614 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+#include "FrameChecksum.h"
+
+// Reflected CRC32C polynomial
+static const uint32_t	kCrc32cPolynomial	= 0x82F63B78;
+
+// The hardware loop runs three independent CRCs over adjacent blocks to hide the
+// latency of the CRC instruction, then shifts and merges them
+static const size_t		kInterleaveBlock	= 4096;
+// Slices are no smaller than this, so small buffers are checksummed inline
+static const size_t		kMinSliceSize		= 1 << 20;
+static const int		kMaxSlices			= 64;
+// Without a fused copy, CopyAndChecksum copies this much at a time, then checksums
+// it from cache
+static const size_t		kCopyChunkSize		= 64 * 1024;
+
+typedef uint32_t (*Crc32cUpdateFunc)(uint32_t crc, const uint8_t* bytes, size_t size);
+typedef uint32_t (*Crc32cCopyFunc)(uint32_t crc, uint8_t* destination, const uint8_t* source, size_t size);
+
+static pthread_once_t		gCrc32cOnceControl = PTHREAD_ONCE_INIT;
+static Crc32cUpdateFunc		gCrc32cUpdateFunc = NULL;
+static Crc32cCopyFunc		gCrc32cCopyFunc = NULL;
+static const char*			gCrc32cImplementationName = "software";
+static uint32_t				gCrc32cTable[8][256];
+static uint32_t				gPowersOfX[64];				// x^(2^n) modulo the polynomial
+static uint32_t				gShiftOneBlock;				// x^(8 * kInterleaveBlock)
+static uint32_t				gShiftTwoBlocks;
+
+static uint64_t GetNanoseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Product of two polynomials modulo the CRC polynomial, in reflected bit order
+static uint32_t MultiplyModP(uint32_t a, uint32_t b)
+{
+	uint32_t	mask	= 1U << 31;
+	uint32_t	product	= 0;
+
+	while (mask != 0)
+	{
+		if (a & mask)
+		{
+			product ^= b;
+			if ((a & (mask - 1)) == 0)
+				break;
+		}
+		mask >>= 1;
+		b = (b & 1) ? (b >> 1) ^ kCrc32cPolynomial : b >> 1;
+	}
+
+	return product;
+}
+
+// x^(8 * byteCount), which shifts a CRC register over byteCount zero bytes
+static uint32_t ShiftForBytes(uint64_t byteCount)
+{
+	uint32_t	power = 1U << 31;		// x^0
+	int			n = 3;
+
+	while (byteCount != 0)
+	{
+		if (byteCount & 1)
+			power = MultiplyModP(gPowersOfX[n & 63], power);
+		byteCount >>= 1;
+		n++;
+	}
+
+	return power;
+}
+
+// Slicing-by-8 for CPUs without CRC32C instructions
+static uint32_t Crc32cUpdateSoftware(uint32_t crc, const uint8_t* bytes, size_t size)
+{
+	while (size > 0 && ((uintptr_t)bytes & 7) != 0)
+	{
+		crc = gCrc32cTable[0][(crc ^ *bytes++) & 0xFF] ^ (crc >> 8);
+		size--;
+	}
+
+	while (size >= 8)
+	{
+		uint64_t word;
+		memcpy(&word, bytes, 8);
+		word ^= crc;
+		crc = gCrc32cTable[7][word & 0xFF] ^
+			  gCrc32cTable[6][(word >> 8) & 0xFF] ^
+			  gCrc32cTable[5][(word >> 16) & 0xFF] ^
+			  gCrc32cTable[4][(word >> 24) & 0xFF] ^
+			  gCrc32cTable[3][(word >> 32) & 0xFF] ^
+			  gCrc32cTable[2][(word >> 40) & 0xFF] ^
+			  gCrc32cTable[1][(word >> 48) & 0xFF] ^
+			  gCrc32cTable[0][word >> 56];
+		bytes += 8;
+		size -= 8;
+	}
+
+	while (size > 0)
+	{
+		crc = gCrc32cTable[0][(crc ^ *bytes++) & 0xFF] ^ (crc >> 8);
+		size--;
+	}
+
+	return crc;
+}
+
+static uint32_t Crc32cCopyChunked(uint32_t crc, uint8_t* destination, const uint8_t* source, size_t size)
+{
+	for (size_t done = 0; done < size; done += kCopyChunkSize)
+	{
+		size_t chunk = std::min(kCopyChunkSize, size - done);
+		memcpy(destination + done, source + done, chunk);
+		crc = gCrc32cUpdateFunc(crc, destination + done, chunk);
+	}
+
+	return crc;
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("sse4.2")))
+static uint32_t Crc32cUpdateSSE42(uint32_t crc, const uint8_t* bytes, size_t size)
+{
+	while (size > 0 && ((uintptr_t)bytes & 7) != 0)
+	{
+		crc = _mm_crc32_u8(crc, *bytes++);
+		size--;
+	}
+
+	while (size >= 3 * kInterleaveBlock)
+	{
+		const uint64_t*	words	= (const uint64_t*)bytes;
+		uint64_t		crc0	= crc;
+		uint64_t		crc1	= 0;
+		uint64_t		crc2	= 0;
+
+		for (size_t i = 0; i < kInterleaveBlock / 8; i++)
+		{
+			crc0 = _mm_crc32_u64(crc0, words[i]);
+			crc1 = _mm_crc32_u64(crc1, words[i + kInterleaveBlock / 8]);
+			crc2 = _mm_crc32_u64(crc2, words[i + 2 * kInterleaveBlock / 8]);
+		}
+
+		crc = MultiplyModP(gShiftTwoBlocks, (uint32_t)crc0) ^ MultiplyModP(gShiftOneBlock, (uint32_t)crc1) ^ (uint32_t)crc2;
+		bytes += 3 * kInterleaveBlock;
+		size -= 3 * kInterleaveBlock;
+	}
+
+	uint64_t crc64 = crc;
+	while (size >= 8)
+	{
+		crc64 = _mm_crc32_u64(crc64, *(const uint64_t*)bytes);
+		bytes += 8;
+		size -= 8;
+	}
+	crc = (uint32_t)crc64;
+
+	while (size > 0)
+	{
+		crc = _mm_crc32_u8(crc, *bytes++);
+		size--;
+	}
+
+	return crc;
+}
+
+// Checksums the source as it streams it to the destination with non-temporal
+// stores, so the frame is only read once and the copy does not evict the cache
+__attribute__((target("sse4.2")))
+static uint32_t Crc32cCopySSE42(uint32_t crc, uint8_t* destination, const uint8_t* source, size_t size)
+{
+	const size_t kBlockVectors = kInterleaveBlock / 16;
+
+	if (((uintptr_t)destination & 15) != 0)
+		return Crc32cCopyChunked(crc, destination, source, size);
+
+	while (size >= 3 * kInterleaveBlock)
+	{
+		const __m128i*	input	= (const __m128i*)source;
+		__m128i*		output	= (__m128i*)destination;
+		uint64_t		crc0	= crc;
+		uint64_t		crc1	= 0;
+		uint64_t		crc2	= 0;
+
+		for (size_t i = 0; i < kBlockVectors; i++)
+		{
+			__m128i v0 = _mm_loadu_si128(input + i);
+			__m128i v1 = _mm_loadu_si128(input + i + kBlockVectors);
+			__m128i v2 = _mm_loadu_si128(input + i + 2 * kBlockVectors);
+
+			crc0 = _mm_crc32_u64(_mm_crc32_u64(crc0, _mm_cvtsi128_si64(v0)), _mm_extract_epi64(v0, 1));
+			crc1 = _mm_crc32_u64(_mm_crc32_u64(crc1, _mm_cvtsi128_si64(v1)), _mm_extract_epi64(v1, 1));
+			crc2 = _mm_crc32_u64(_mm_crc32_u64(crc2, _mm_cvtsi128_si64(v2)), _mm_extract_epi64(v2, 1));
+
+			_mm_stream_si128(output + i, v0);
+			_mm_stream_si128(output + i + kBlockVectors, v1);
+			_mm_stream_si128(output + i + 2 * kBlockVectors, v2);
+		}
+
+		crc = MultiplyModP(gShiftTwoBlocks, (uint32_t)crc0) ^ MultiplyModP(gShiftOneBlock, (uint32_t)crc1) ^ (uint32_t)crc2;
+		source += 3 * kInterleaveBlock;
+		destination += 3 * kInterleaveBlock;
+		size -= 3 * kInterleaveBlock;
+	}
+
+	// Order the streaming stores before the buffer is handed to another thread
+	_mm_sfence();
+
+	memcpy(destination, source, size);
+	return Crc32cUpdateSSE42(crc, destination, size);
+}
+
+#elif defined(__aarch64__)
+
+__attribute__((target("+crc")))
+static uint32_t Crc32cUpdateARMv8(uint32_t crc, const uint8_t* bytes, size_t size)
+{
+	while (size > 0 && ((uintptr_t)bytes & 7) != 0)
+	{
+		crc = __builtin_aarch64_crc32cb(crc, *bytes++);
+		size--;
+	}
+
+	while (size >= 3 * kInterleaveBlock)
+	{
+		const uint64_t*	words	= (const uint64_t*)bytes;
+		uint32_t		crc0	= crc;
+		uint32_t		crc1	= 0;
+		uint32_t		crc2	= 0;
+
+		for (size_t i = 0; i < kInterleaveBlock / 8; i++)
+		{
+			crc0 = __builtin_aarch64_crc32cx(crc0, words[i]);
+			crc1 = __builtin_aarch64_crc32cx(crc1, words[i + kInterleaveBlock / 8]);
+			crc2 = __builtin_aarch64_crc32cx(crc2, words[i + 2 * kInterleaveBlock / 8]);
+		}
+
+		crc = MultiplyModP(gShiftTwoBlocks, crc0) ^ MultiplyModP(gShiftOneBlock, crc1) ^ crc2;
+		bytes += 3 * kInterleaveBlock;
+		size -= 3 * kInterleaveBlock;
+	}
+
+	while (size >= 8)
+	{
+		crc = __builtin_aarch64_crc32cx(crc, *(const uint64_t*)bytes);
+		bytes += 8;
+		size -= 8;
+	}
+
+	while (size > 0)
+	{
+		crc = __builtin_aarch64_crc32cb(crc, *bytes++);
+		size--;
+	}
+
+	return crc;
+}
+
+#endif
+
+static void InitCrc32c(void)
+{
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		uint32_t crc = i;
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc & 1) ? (crc >> 1) ^ kCrc32cPolynomial : crc >> 1;
+		gCrc32cTable[0][i] = crc;
+	}
+
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		for (int slice = 1; slice < 8; slice++)
+			gCrc32cTable[slice][i] = gCrc32cTable[0][gCrc32cTable[slice - 1][i] & 0xFF] ^ (gCrc32cTable[slice - 1][i] >> 8);
+	}
+
+	gPowersOfX[0] = 1U << 30;		// x^1
+	for (int n = 1; n < 64; n++)
+		gPowersOfX[n] = MultiplyModP(gPowersOfX[n - 1], gPowersOfX[n - 1]);
+
+	gShiftOneBlock	= ShiftForBytes(kInterleaveBlock);
+	gShiftTwoBlocks	= ShiftForBytes(2 * kInterleaveBlock);
+
+	gCrc32cUpdateFunc	= Crc32cUpdateSoftware;
+	gCrc32cCopyFunc		= Crc32cCopyChunked;
+
+#if defined(__x86_64__)
+	if (__builtin_cpu_supports("sse4.2"))
+	{
+		gCrc32cUpdateFunc			= Crc32cUpdateSSE42;
+		gCrc32cCopyFunc				= Crc32cCopySSE42;
+		gCrc32cImplementationName	= "SSE4.2";
+	}
+#elif defined(__aarch64__)
+	if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+	{
+		gCrc32cUpdateFunc			= Crc32cUpdateARMv8;
+		gCrc32cImplementationName	= "ARMv8 CRC";
+	}
+#endif
+}
+
+uint32_t Crc32c(const void* bytes, size_t size, uint32_t crc)
+{
+	pthread_once(&gCrc32cOnceControl, InitCrc32c);
+	return ~gCrc32cUpdateFunc(~crc, (const uint8_t*)bytes, size);
+}
+
+uint32_t Crc32cCombine(uint32_t crcA, uint32_t crcB, uint64_t sizeB)
+{
+	pthread_once(&gCrc32cOnceControl, InitCrc32c);
+	return MultiplyModP(ShiftForBytes(sizeB), crcA) ^ crcB;
+}
+
+const char* Crc32cImplementationName()
+{
+	pthread_once(&gCrc32cOnceControl, InitCrc32c);
+	return gCrc32cImplementationName;
+}
+
+// One buffer's slices.  Slices are claimed by any thread working on the batch; the
+// submitter waits until every slice is done and no worker still refers to it.
+struct FrameChecksum::Batch
+{
+	uint8_t*			destination;				// NULL to only checksum
+	const uint8_t*		source;
+	size_t				size;
+	size_t				sliceSize;
+	int					count;
+	uint32_t			crc[kMaxSlices];
+	std::atomic<int>	next;
+	int					completed;					// Protected by m_mutex
+	int					users;						// Protected by m_mutex
+};
+
+FrameChecksum::FrameChecksum(int threadCount) :
+	m_threadCount(std::max(threadCount, 1)),
+	m_stopping(false),
+	m_buffersChecksummed(0),
+	m_bytesChecksummed(0),
+	m_busyNanoseconds(0),
+	m_framesVerified(0),
+	m_framesUnverified(0),
+	m_videoMismatches(0),
+	m_audioMismatches(0)
+{
+	pthread_once(&gCrc32cOnceControl, InitCrc32c);
+
+	pthread_mutex_init(&m_mutex, NULL);
+	pthread_cond_init(&m_workCondition, NULL);
+	pthread_cond_init(&m_doneCondition, NULL);
+}
+
+FrameChecksum::~FrameChecksum()
+{
+	Stop();
+
+	pthread_cond_destroy(&m_doneCondition);
+	pthread_cond_destroy(&m_workCondition);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+bool FrameChecksum::Start()
+{
+	m_stopping = false;
+
+	// The submitting thread also works on its own buffer
+	for (int i = 1; i < m_threadCount; i++)
+	{
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, WorkerThread, this) != 0)
+			break;
+		m_threads.push_back(thread);
+	}
+
+	return true;
+}
+
+void FrameChecksum::Stop()
+{
+	pthread_mutex_lock(&m_mutex);
+	m_stopping = true;
+	pthread_cond_broadcast(&m_workCondition);
+	pthread_mutex_unlock(&m_mutex);
+
+	for (pthread_t thread : m_threads)
+		pthread_join(thread, NULL);
+
+	m_threads.clear();
+}
+
+void FrameChecksum::GetStatistics(FrameChecksumStatistics& statistics) const
+{
+	statistics.buffersChecksummed	= m_buffersChecksummed;
+	statistics.bytesChecksummed		= m_bytesChecksummed;
+	statistics.busyNanoseconds		= m_busyNanoseconds;
+	statistics.framesVerified		= m_framesVerified;
+	statistics.framesUnverified		= m_framesUnverified;
+	statistics.videoMismatches		= m_videoMismatches;
+	statistics.audioMismatches		= m_audioMismatches;
+}
+
+void* FrameChecksum::WorkerThread(void* context)
+{
+	static_cast<FrameChecksum*>(context)->WorkerLoop();
+	return NULL;
+}
+
+void FrameChecksum::WorkerLoop()
+{
+	pthread_mutex_lock(&m_mutex);
+	while (!m_stopping)
+	{
+		if (m_batches.empty())
+		{
+			pthread_cond_wait(&m_workCondition, &m_mutex);
+			continue;
+		}
+
+		Batch* batch = m_batches.front();
+		if (batch->next >= batch->count)
+		{
+			// Every slice is claimed, the remaining work belongs to other threads
+			m_batches.pop_front();
+			continue;
+		}
+
+		batch->users++;
+		pthread_mutex_unlock(&m_mutex);
+
+		ProcessBatch(*batch);
+
+		pthread_mutex_lock(&m_mutex);
+		if (--batch->users == 0 && batch->completed == batch->count)
+			pthread_cond_broadcast(&m_doneCondition);
+	}
+	pthread_mutex_unlock(&m_mutex);
+}
+
+void FrameChecksum::ProcessBatch(Batch& batch)
+{
+	int processed = 0;
+	int slice;
+
+	while ((slice = batch.next++) < batch.count)
+	{
+		size_t			offset	= slice * batch.sliceSize;
+		size_t			size	= std::min(batch.sliceSize, batch.size - offset);
+		const uint8_t*	source	= batch.source + offset;
+		uint32_t		crc		= ~0U;
+
+		if (batch.destination != NULL)
+			crc = gCrc32cCopyFunc(crc, batch.destination + offset, source, size);
+		else
+		{
+			crc = gCrc32cUpdateFunc(crc, source, size);
+		}
+
+		batch.crc[slice] = ~crc;
+		processed++;
+	}
+
+	if (processed > 0)
+	{
+		pthread_mutex_lock(&m_mutex);
+		batch.completed += processed;
+		if (batch.completed == batch.count)
+			pthread_cond_broadcast(&m_doneCondition);
+		pthread_mutex_unlock(&m_mutex);
+	}
+}
+
+uint32_t FrameChecksum::RunBatch(uint8_t* destination, const uint8_t* source, size_t size)
+{
+	Batch		batch;
+	uint64_t	startTime = GetNanoseconds();
+	uint32_t	crc;
+
+	// Enough slices to share between the threads, rounded to whole pages
+	batch.count			= (int)std::min<size_t>(std::min<size_t>(size / kMinSliceSize, m_threadCount * 2), kMaxSlices);
+	batch.count			= std::max(batch.count, 1);
+	batch.sliceSize		= ((size + batch.count - 1) / batch.count + 4095) & ~(size_t)4095;
+	batch.count			= (int)((size + batch.sliceSize - 1) / batch.sliceSize);
+	batch.destination	= destination;
+	batch.source		= source;
+	batch.size			= size;
+	batch.next			= 0;
+	batch.completed		= 0;
+	batch.users			= 0;
+
+	if (batch.count > 1 && !m_threads.empty())
+	{
+		pthread_mutex_lock(&m_mutex);
+		m_batches.push_back(&batch);
+		pthread_cond_broadcast(&m_workCondition);
+		pthread_mutex_unlock(&m_mutex);
+	}
+
+	ProcessBatch(batch);
+
+	pthread_mutex_lock(&m_mutex);
+	while (batch.completed < batch.count || batch.users > 0)
+		pthread_cond_wait(&m_doneCondition, &m_mutex);
+
+	auto queued = std::find(m_batches.begin(), m_batches.end(), &batch);
+	if (queued != m_batches.end())
+		m_batches.erase(queued);
+	pthread_mutex_unlock(&m_mutex);
+
+	crc = batch.crc[0];
+	for (int i = 1; i < batch.count; i++)
+		crc = Crc32cCombine(crc, batch.crc[i], std::min(batch.sliceSize, size - i * batch.sliceSize));
+
+	m_buffersChecksummed++;
+	m_bytesChecksummed	+= size;
+	m_busyNanoseconds	+= GetNanoseconds() - startTime;
+
+	return crc;
+}
+
+uint32_t FrameChecksum::CopyAndChecksum(uint8_t* destination, const uint8_t* source, size_t size)
+{
+	if (size == 0)
+		return 0;
+
+	return RunBatch(destination, source, size);
+}
+
+uint32_t FrameChecksum::Checksum(const uint8_t* bytes, size_t size)
+{
+	if (size == 0)
+		return 0;
+
+	return RunBatch(NULL, bytes, size);
+}
+
+bool FrameChecksum::VerifyFrame(const RawFrameHeader* header, const uint8_t* video, const uint8_t* audio)
+{
+	bool		valid = true;
+	uint64_t	videoSize = (header->compression != kRawCompressionNone) ? header->uncompressedVideoSize : header->videoSize;
+
+	if ((header->flags & kRawFrameHasChecksum) == 0)
+	{
+		m_framesUnverified++;
+		return true;
+	}
+
+	if (Checksum(video, videoSize) != header->videoChecksum)
+	{
+		m_videoMismatches++;
+		valid = false;
+	}
+
+	if (header->audioSize > 0 && Crc32c(audio, header->audioSize) != header->audioChecksum)
+	{
+		m_audioMismatches++;
+		valid = false;
+	}
+
+	m_framesVerified++;
+	return valid;
+}
@@ -0,0 +1,123 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __FRAME_CHECKSUM_H__
+#define __FRAME_CHECKSUM_H__
+
+#include <atomic>
+#include <deque>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "RawContainer.h"
+
+// CRC32C (Castagnoli) of a buffer, continuing from a previous CRC or 0 to start.
+// Uses the SSE4.2 or ARMv8 CRC instructions when the CPU has them.
+uint32_t		Crc32c(const void* bytes, size_t size, uint32_t crc = 0);
+// CRC of A followed by B, from the CRCs of A and B and the size of B
+uint32_t		Crc32cCombine(uint32_t crcA, uint32_t crcB, uint64_t sizeB);
+const char*		Crc32cImplementationName(void);
+
+struct FrameChecksumStatistics
+{
+	uint64_t	buffersChecksummed;
+	uint64_t	bytesChecksummed;
+	uint64_t	busyNanoseconds;			// Wall time spent in CopyAndChecksum and Checksum
+	uint64_t	framesVerified;
+	uint64_t	framesUnverified;			// Recorded without checksums
+	uint64_t	videoMismatches;
+	uint64_t	audioMismatches;
+};
+
+// Per-frame CRC32C of container payloads.  Large buffers are split into slices
+// that a pool of worker threads checksum in parallel, and the slice CRCs are then
+// combined into the CRC of the whole buffer, so the result does not depend on the
+// number of threads.  Several threads may checksum frames at the same time, and the
+// calling thread works on its own frame's slices while it waits.
+class FrameChecksum
+{
+public:
+	FrameChecksum(int threadCount);
+	virtual ~FrameChecksum();
+
+	bool		Start(void);
+	void		Stop(void);
+
+	// Copies size bytes and returns the CRC of the copy, each slice is checksummed
+	// straight after it is copied while it is still in cache
+	uint32_t	CopyAndChecksum(uint8_t* destination, const uint8_t* source, size_t size);
+	uint32_t	Checksum(const uint8_t* bytes, size_t size);
+
+	// Checks the payloads of a record against the CRCs in its header.  video is the
+	// uncompressed video, of header->uncompressedVideoSize bytes when compressed.
+	// Records without checksums are counted as unverified and pass.
+	bool		VerifyFrame(const RawFrameHeader* header, const uint8_t* video, const uint8_t* audio);
+
+	void		GetStatistics(FrameChecksumStatistics& statistics) const;
+
+private:
+	struct Batch;
+
+	uint32_t	RunBatch(uint8_t* destination, const uint8_t* source, size_t size);
+	void		ProcessBatch(Batch& batch);
+
+	static void*	WorkerThread(void* context);
+	void			WorkerLoop(void);
+
+	int							m_threadCount;
+
+	pthread_mutex_t				m_mutex;
+	pthread_cond_t				m_workCondition;
+	pthread_cond_t				m_doneCondition;
+	std::deque<Batch*>			m_batches;
+	std::vector<pthread_t>		m_threads;
+	bool						m_stopping;
+
+	std::atomic<uint64_t>		m_buffersChecksummed;
+	std::atomic<uint64_t>		m_bytesChecksummed;
+	std::atomic<uint64_t>		m_busyNanoseconds;
+	std::atomic<uint64_t>		m_framesVerified;
+	std::atomic<uint64_t>		m_framesUnverified;
+	std::atomic<uint64_t>		m_videoMismatches;
+	std::atomic<uint64_t>		m_audioMismatches;
+};
+
+#endif
@@ -0,0 +1,378 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "FramePublisher.h"
+
+FramePublisher::FramePublisher() :
+	m_refCount(1),
+	m_fileDescriptor(-1),
+	m_region(NULL),
+	m_regionSize(0),
+	m_header(NULL),
+	m_retainedFrames(0),
+	m_sequence(0),
+	m_reportedOversize(false)
+{
+	pthread_mutex_init(&m_bufferMutex, NULL);
+	pthread_mutex_init(&m_frameMutex, NULL);
+}
+
+FramePublisher::~FramePublisher()
+{
+	if (m_region != NULL)
+		munmap(m_region, m_regionSize);
+
+	if (m_fileDescriptor >= 0)
+		close(m_fileDescriptor);
+
+	pthread_mutex_destroy(&m_frameMutex);
+	pthread_mutex_destroy(&m_bufferMutex);
+}
+
+bool FramePublisher::Create(const std::string& name, uint32_t slotCount, uint64_t slotSize, uint32_t retainedFrames)
+{
+	if (slotCount == 0 || slotCount > kSharedFrameMaxSlots || retainedFrames >= slotCount)
+		return false;
+
+	// Shared memory object names start with a single slash
+	m_name = (name[0] == '/') ? name : "/" + name;
+
+	slotSize		= (slotSize + kSharedFrameAlignment - 1) & ~(uint64_t)(kSharedFrameAlignment - 1);
+	m_regionSize	= SharedFrameRingDataOffset() + slotCount * slotSize;
+
+	// A previous run that did not exit cleanly leaves its region behind
+	shm_unlink(m_name.c_str());
+
+	m_fileDescriptor = shm_open(m_name.c_str(), O_RDWR|O_CREAT|O_EXCL, 0660);
+	if (m_fileDescriptor < 0)
+	{
+		fprintf(stderr, "Could not create shared frame ring \"%s\": %s\n", m_name.c_str(), strerror(errno));
+		return false;
+	}
+
+	if (ftruncate(m_fileDescriptor, m_regionSize) != 0)
+	{
+		fprintf(stderr, "Could not size shared frame ring \"%s\" to %zu bytes\n", m_name.c_str(), m_regionSize);
+		shm_unlink(m_name.c_str());
+		return false;
+	}
+
+	m_region = (uint8_t*)mmap(NULL, m_regionSize, PROT_READ|PROT_WRITE, MAP_SHARED, m_fileDescriptor, 0);
+	if (m_region == MAP_FAILED)
+	{
+		m_region = NULL;
+		shm_unlink(m_name.c_str());
+		return false;
+	}
+
+	// The new object is zero filled, so every slot starts unpublished
+	m_header				= (SharedFrameRingHeader*)m_region;
+	m_header->magic			= kSharedFrameRingMagic;
+	m_header->version		= kSharedFrameRingVersion;
+	m_header->slotCount		= slotCount;
+	m_header->slotSize		= slotSize;
+	m_header->dataOffset	= SharedFrameRingDataOffset();
+	m_header->regionSize	= m_regionSize;
+	m_header->publisherPid	= getpid();
+	m_header->state.store(kSharedFrameRingActive);
+
+	m_retainedFrames = retainedFrames;
+
+	for (uint32_t slot = slotCount; slot > 0; slot--)
+		m_freeSlots.push_back(slot - 1);
+
+	return true;
+}
+
+void FramePublisher::Close()
+{
+	std::vector<HeldFrame> frames;
+
+	if (m_header == NULL)
+		return;
+
+	pthread_mutex_lock(&m_frameMutex);
+	for (const HeldFrame& held : m_published)
+		m_header->slots[held.slot].sequence.store(0);
+
+	frames.insert(frames.end(), m_published.begin(), m_published.end());
+	frames.insert(frames.end(), m_retired.begin(), m_retired.end());
+	m_published.clear();
+	m_retired.clear();
+
+	m_header->state.store(kSharedFrameRingClosed);
+	m_header->publishCount.fetch_add(1);
+	syscall(SYS_futex, (uint32_t*)&m_header->publishCount, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+	pthread_mutex_unlock(&m_frameMutex);
+
+	// Capture has stopped, so the buffers are not overwritten even if a client is
+	// still reading.  Clients keep their mapping after the name is removed.
+	for (const HeldFrame& held : frames)
+		held.frame->Release();
+
+	shm_unlink(m_name.c_str());
+}
+
+bool FramePublisher::GetSlot(void* bytes, uint32_t& slot) const
+{
+	uint8_t* data = m_region + m_header->dataOffset;
+
+	if ((uint8_t*)bytes < data || (uint8_t*)bytes >= m_region + m_regionSize)
+		return false;
+
+	uint64_t offset = (uint8_t*)bytes - data;
+	if (offset % m_header->slotSize != 0)
+		return false;
+
+	slot = (uint32_t)(offset / m_header->slotSize);
+	return true;
+}
+
+void FramePublisher::ReleaseUnreadFrames()
+{
+	std::vector<IDeckLinkVideoInputFrame*> frames;
+
+	pthread_mutex_lock(&m_frameMutex);
+	for (size_t i = 0; i < m_retired.size(); )
+	{
+		// The slot's sequence was cleared when it was retired, a reader arriving now
+		// sees that and backs out
+		if (m_header->slots[m_retired[i].slot].readers.load() == 0)
+		{
+			frames.push_back(m_retired[i].frame);
+			m_retired[i] = m_retired.back();
+			m_retired.pop_back();
+		}
+		else
+			i++;
+	}
+	pthread_mutex_unlock(&m_frameMutex);
+
+	// Releasing a frame may return its buffer through ReleaseBuffer
+	for (IDeckLinkVideoInputFrame* frame : frames)
+		frame->Release();
+}
+
+bool FramePublisher::Publish(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkVideoFrame* rightEyeFrame, IDeckLinkTimecode* timecode, BMDTimeScale timeScale)
+{
+	void*								bytes;
+	uint32_t							slotIndex;
+	uint32_t							rightEyeSlot;
+	BMDTimeValue						streamTime;
+	BMDTimeValue						frameDuration;
+	IDeckLinkVideoFrameMetadataExtensions*	metadataExtensions = NULL;
+
+	if (m_header == NULL || videoFrame->GetBytes(&bytes) != S_OK || !GetSlot(bytes, slotIndex))
+		return false;
+
+	SharedFrameSlot&		slot = m_header->slots[slotIndex];
+	SharedFrameMetadata&	metadata = slot.metadata;
+
+	// The slot is not readable until its sequence is set below
+	memset(&metadata, 0, sizeof(metadata));
+
+	if (videoFrame->GetStreamTime(&streamTime, &frameDuration, timeScale) == S_OK)
+	{
+		metadata.streamTime		= streamTime;
+		metadata.frameDuration	= frameDuration;
+		metadata.timeScale		= timeScale;
+	}
+
+	metadata.pixelFormat	= videoFrame->GetPixelFormat();
+	metadata.width			= (uint32_t)videoFrame->GetWidth();
+	metadata.height			= (uint32_t)videoFrame->GetHeight();
+	metadata.rowBytes		= (uint32_t)videoFrame->GetRowBytes();
+	metadata.frameFlags		= videoFrame->GetFlags();
+
+	if (timecode != NULL)
+	{
+		metadata.timecodeBCD	= timecode->GetBCD();
+		metadata.timecodeFlags	= timecode->GetFlags();
+		metadata.flags			|= kSharedFrameHasTimecode;
+	}
+
+	// The right eye stays valid for as long as the left eye frame is held
+	if (rightEyeFrame != NULL && rightEyeFrame->GetBytes(&bytes) == S_OK && GetSlot(bytes, rightEyeSlot))
+		metadata.rightEyeOffset = m_header->dataOffset + rightEyeSlot * m_header->slotSize;
+
+	if ((metadata.frameFlags & bmdFrameContainsHDRMetadata) &&
+		videoFrame->QueryInterface(IID_IDeckLinkVideoFrameMetadataExtensions, (void**)&metadataExtensions) == S_OK)
+	{
+		metadataExtensions->GetInt(bmdDeckLinkFrameMetadataColorspace, &metadata.colorspace);
+		metadataExtensions->GetInt(bmdDeckLinkFrameMetadataHDRElectroOpticalTransferFunc, &metadata.electroOpticalTransferFunc);
+		metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRDisplayPrimariesRedX, &metadata.displayPrimariesRedX);
+		metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRDisplayPrimariesRedY, &metadata.displayPrimariesRedY);
+		metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRDisplayPrimariesGreenX, &metadata.displayPrimariesGreenX);
+		metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRDisplayPrimariesGreenY, &metadata.displayPrimariesGreenY);
+		metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRDisplayPrimariesBlueX, &metadata.displayPrimariesBlueX);
+		metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRDisplayPrimariesBlueY, &metadata.displayPrimariesBlueY);
+		metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRWhitePointX, &metadata.whitePointX);
+		metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRWhitePointY, &metadata.whitePointY);
+		metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRMaxDisplayMasteringLuminance, &metadata.maxDisplayMasteringLuminance);
+		metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRMinDisplayMasteringLuminance, &metadata.minDisplayMasteringLuminance);
+		metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRMaximumContentLightLevel, &metadata.maxContentLightLevel);
+		metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRMaximumFrameAverageLightLevel, &metadata.maxFrameAverageLightLevel);
+		metadataExtensions->Release();
+
+		metadata.flags |= kSharedFrameHasHDRMetadata;
+	}
+
+	videoFrame->AddRef();
+
+	pthread_mutex_lock(&m_frameMutex);
+	m_published.push_back({ slotIndex, videoFrame });
+
+	uint64_t sequence = ++m_sequence;
+	slot.sequence.store(sequence);
+	m_header->entries[sequence % m_header->slotCount].store((sequence << 8) | slotIndex);
+	m_header->writeSequence.store(sequence);
+
+	// Retire the oldest frames so the driver keeps enough buffers to capture into
+	while (m_published.size() > m_retainedFrames)
+	{
+		HeldFrame oldest = m_published.front();
+		m_published.pop_front();
+
+		m_header->slots[oldest.slot].sequence.store(0);
+		m_retired.push_back(oldest);
+	}
+	pthread_mutex_unlock(&m_frameMutex);
+
+	m_header->publishCount.fetch_add(1);
+	if (m_header->waiters.load() > 0)
+		syscall(SYS_futex, (uint32_t*)&m_header->publishCount, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+
+	ReleaseUnreadFrames();
+	return true;
+}
+
+HRESULT FramePublisher::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	*ppv = NULL;
+	return E_NOINTERFACE;
+}
+
+ULONG FramePublisher::AddRef(void)
+{
+	return __sync_add_and_fetch(&m_refCount, 1);
+}
+
+ULONG FramePublisher::Release(void)
+{
+	int32_t newRefValue = __sync_sub_and_fetch(&m_refCount, 1);
+	if (newRefValue == 0)
+	{
+		delete this;
+		return 0;
+	}
+	return newRefValue;
+}
+
+HRESULT FramePublisher::AllocateBuffer(uint32_t bufferSize, void** allocatedBuffer)
+{
+	uint32_t slot;
+
+	if (m_header == NULL)
+		return E_FAIL;
+
+	if (bufferSize > m_header->slotSize)
+	{
+		if (!m_reportedOversize)
+			fprintf(stderr, "Frames of %u bytes do not fit the shared frame ring, restart capture to publish this format\n", bufferSize);
+		m_reportedOversize = true;
+		return E_OUTOFMEMORY;
+	}
+
+	pthread_mutex_lock(&m_bufferMutex);
+	bool empty = m_freeSlots.empty();
+	pthread_mutex_unlock(&m_bufferMutex);
+
+	// Clients may have finished with retired frames since the last publish
+	if (empty)
+		ReleaseUnreadFrames();
+
+	pthread_mutex_lock(&m_bufferMutex);
+	if (m_freeSlots.empty())
+	{
+		pthread_mutex_unlock(&m_bufferMutex);
+		return E_OUTOFMEMORY;
+	}
+
+	slot = m_freeSlots.back();
+	m_freeSlots.pop_back();
+	pthread_mutex_unlock(&m_bufferMutex);
+
+	*allocatedBuffer = m_region + m_header->dataOffset + slot * m_header->slotSize;
+	return S_OK;
+}
+
+HRESULT FramePublisher::ReleaseBuffer(void* buffer)
+{
+	uint32_t slot;
+
+	if (!GetSlot(buffer, slot))
+		return E_INVALIDARG;
+
+	pthread_mutex_lock(&m_bufferMutex);
+	m_freeSlots.push_back(slot);
+	pthread_mutex_unlock(&m_bufferMutex);
+
+	return S_OK;
+}
+
+HRESULT FramePublisher::Commit(void)
+{
+	return S_OK;
+}
+
+HRESULT FramePublisher::Decommit(void)
+{
+	return S_OK;
+}
@@ -0,0 +1,112 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __FRAME_PUBLISHER_H__
+#define __FRAME_PUBLISHER_H__
+
+#include <deque>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include "DeckLinkAPI.h"
+#include "SharedFrameRing.h"
+
+// Publishes captured frames to other processes through a shared frame ring.  As the
+// input's frame memory allocator it hands the driver buffers inside the shared
+// region, so publishing a frame only fills in its metadata.  Published frames are
+// held, keeping their buffers away from the driver, until they are among the oldest
+// and no client is reading them.
+class FramePublisher : public IDeckLinkMemoryAllocator
+{
+public:
+	FramePublisher();
+
+	// retainedFrames is how many of the newest frames stay readable, the remaining
+	// slots are left for the driver to capture into
+	bool		Create(const std::string& name, uint32_t slotCount, uint64_t slotSize, uint32_t retainedFrames);
+	// Releases every held frame and tells clients that the publisher has gone
+	void		Close(void);
+
+	// Called from the capture callback.  Fails if the frame is not in the ring,
+	// which happens if the driver could not get a buffer from this allocator.
+	bool		Publish(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkVideoFrame* rightEyeFrame, IDeckLinkTimecode* timecode, BMDTimeScale timeScale);
+
+	// IUnknown
+	virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv);
+	virtual ULONG STDMETHODCALLTYPE AddRef(void);
+	virtual ULONG STDMETHODCALLTYPE Release(void);
+
+	// IDeckLinkMemoryAllocator
+	virtual HRESULT STDMETHODCALLTYPE AllocateBuffer(uint32_t bufferSize, void** allocatedBuffer);
+	virtual HRESULT STDMETHODCALLTYPE ReleaseBuffer(void* buffer);
+	virtual HRESULT STDMETHODCALLTYPE Commit(void);
+	virtual HRESULT STDMETHODCALLTYPE Decommit(void);
+
+private:
+	struct HeldFrame
+	{
+		uint32_t					slot;
+		IDeckLinkVideoInputFrame*	frame;
+	};
+
+	virtual ~FramePublisher();
+
+	bool		GetSlot(void* bytes, uint32_t& slot) const;
+	void		ReleaseUnreadFrames(void);
+
+	int32_t						m_refCount;
+	std::string					m_name;
+	int							m_fileDescriptor;
+	uint8_t*					m_region;
+	size_t						m_regionSize;
+	SharedFrameRingHeader*		m_header;
+	uint32_t					m_retainedFrames;
+	uint64_t					m_sequence;
+	bool						m_reportedOversize;
+
+	pthread_mutex_t				m_bufferMutex;		// Protects m_freeSlots, used by driver threads
+	std::vector<uint32_t>		m_freeSlots;
+
+	pthread_mutex_t				m_frameMutex;		// Protects m_published and m_retired
+	std::deque<HeldFrame>		m_published;
+	std::vector<HeldFrame>		m_retired;			// No longer readable, waiting for readers to finish
+};
+
+#endif
@@ -0,0 +1,214 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <stdio.h>
+#include "IOScheduler.h"
+#include "FrameTrace.h"
+
+IOScheduler::IOScheduler(int threadCount, size_t quantum) :
+	m_threadCount(threadCount > 0 ? threadCount : 1),
+	m_quantum(quantum),
+	m_nextStream(0),
+	m_stopping(false)
+{
+	pthread_mutex_init(&m_mutex, NULL);
+	pthread_cond_init(&m_workCond, NULL);
+	pthread_cond_init(&m_idleCond, NULL);
+}
+
+IOScheduler::~IOScheduler()
+{
+	Stop();
+
+	pthread_cond_destroy(&m_idleCond);
+	pthread_cond_destroy(&m_workCond);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+void IOScheduler::AddStream(IOStream* stream)
+{
+	StreamState state = { stream, 0, false };
+
+	pthread_mutex_lock(&m_mutex);
+	m_streams.push_back(state);
+	pthread_mutex_unlock(&m_mutex);
+}
+
+void IOScheduler::RemoveStream(IOStream* stream)
+{
+	pthread_mutex_lock(&m_mutex);
+
+	// Wait for a writer thread to finish with the stream before letting it go
+	StreamState* state;
+	while ((state = FindStream(stream)) != NULL && state->busy)
+		pthread_cond_wait(&m_idleCond, &m_mutex);
+
+	if (state != NULL)
+		m_streams.erase(m_streams.begin() + (state - &m_streams[0]));
+
+	pthread_mutex_unlock(&m_mutex);
+}
+
+bool IOScheduler::Start()
+{
+	m_stopping = false;
+
+	for (int i = 0; i < m_threadCount; i++)
+	{
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, ThreadFunc, this) != 0)
+		{
+			fprintf(stderr, "Could not create writer thread\n");
+			Stop();
+			return false;
+		}
+		m_threads.push_back(thread);
+	}
+
+	return true;
+}
+
+void IOScheduler::Stop()
+{
+	pthread_mutex_lock(&m_mutex);
+	m_stopping = true;
+	pthread_cond_broadcast(&m_workCond);
+	pthread_mutex_unlock(&m_mutex);
+
+	for (pthread_t thread : m_threads)
+		pthread_join(thread, NULL);
+
+	m_threads.clear();
+}
+
+void IOScheduler::Notify()
+{
+	pthread_mutex_lock(&m_mutex);
+	pthread_cond_signal(&m_workCond);
+	pthread_mutex_unlock(&m_mutex);
+}
+
+void* IOScheduler::ThreadFunc(void* context)
+{
+	FRAME_TRACE_THREAD_NAME("IO scheduler");
+	static_cast<IOScheduler*>(context)->Run();
+	return NULL;
+}
+
+IOScheduler::StreamState* IOScheduler::FindStream(IOStream* stream)
+{
+	for (StreamState& state : m_streams)
+	{
+		if (state.stream == stream)
+			return &state;
+	}
+	return NULL;
+}
+
+IOScheduler::StreamState* IOScheduler::SelectStream()
+{
+	size_t	streamCount = m_streams.size();
+	bool	foundPending = true;
+
+	// Each visit tops up a stream's deficit by one quantum.  A stream that overran
+	// its budget on a previous turn is passed over until its deficit is positive.
+	while (foundPending)
+	{
+		foundPending = false;
+
+		for (size_t n = 0; n < streamCount; n++)
+		{
+			size_t			index = (m_nextStream + n) % streamCount;
+			StreamState&	state = m_streams[index];
+
+			if (state.busy || !state.stream->HasPendingWrites())
+				continue;
+
+			foundPending = true;
+			state.deficit += m_quantum;
+			if (state.deficit > 0)
+			{
+				m_nextStream = index + 1;
+				return &state;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+void IOScheduler::Run()
+{
+	pthread_mutex_lock(&m_mutex);
+
+	while (true)
+	{
+		StreamState* state = SelectStream();
+		if (state == NULL)
+		{
+			if (m_stopping)
+				break;
+
+			pthread_cond_wait(&m_workCond, &m_mutex);
+			continue;
+		}
+
+		IOStream*	stream = state->stream;
+		size_t		budget = (size_t)state->deficit;
+		state->busy = true;
+
+		pthread_mutex_unlock(&m_mutex);
+		size_t written = stream->ServiceWrites(budget);
+		pthread_mutex_lock(&m_mutex);
+
+		// Streams may have been added while unlocked, look the state up again
+		state = FindStream(stream);
+		state->busy = false;
+		state->deficit -= (int64_t)written;
+
+		// An idle stream does not accumulate credit
+		if (!stream->HasPendingWrites())
+			state->deficit = 0;
+
+		pthread_cond_broadcast(&m_idleCond);
+	}
+
+	pthread_mutex_unlock(&m_mutex);
+}
@@ -0,0 +1,105 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __IO_SCHEDULER_H__
+#define __IO_SCHEDULER_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// A source of queued writes, serviced by IOScheduler threads.  A stream is only
+// ever serviced by one thread at a time, so its writes stay in order.
+class IOStream
+{
+public:
+	virtual ~IOStream() {}
+
+	// Perform queued writes totalling roughly byteBudget bytes and return the number
+	// of bytes written.  Writes are not split, so the budget may be overrun.
+	virtual size_t	ServiceWrites(size_t byteBudget) = 0;
+	virtual bool	HasPendingWrites(void) = 0;
+};
+
+// Shares a small number of writer threads between all capture inputs.  Streams are
+// serviced with deficit round robin, so each input gets an equal share of disk
+// bandwidth regardless of frame size and a busy input cannot starve the others.
+class IOScheduler
+{
+public:
+	IOScheduler(int threadCount, size_t quantum);
+	virtual ~IOScheduler();
+
+	void	AddStream(IOStream* stream);
+	void	RemoveStream(IOStream* stream);
+
+	bool	Start(void);
+	// Returns once all pending writes have been serviced
+	void	Stop(void);
+
+	// Wake a writer thread after queueing data on a stream
+	void	Notify(void);
+
+private:
+	struct StreamState
+	{
+		IOStream*	stream;
+		int64_t		deficit;
+		bool		busy;
+	};
+
+	static void*	ThreadFunc(void* context);
+	void			Run(void);
+	StreamState*	FindStream(IOStream* stream);
+	StreamState*	SelectStream(void);
+
+	pthread_mutex_t				m_mutex;
+	pthread_cond_t				m_workCond;
+	pthread_cond_t				m_idleCond;
+	std::vector<StreamState>	m_streams;
+	std::vector<pthread_t>		m_threads;
+	int							m_threadCount;
+	size_t						m_quantum;
+	size_t						m_nextStream;
+	bool						m_stopping;
+};
+
+#endif
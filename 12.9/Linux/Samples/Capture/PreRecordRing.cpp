@@ -0,0 +1,180 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include "PreRecordRing.h"
+
+static const size_t		kHugePageSize = 2 * 1024 * 1024;
+
+PreRecordRing::PreRecordRing() :
+	m_memory(NULL),
+	m_memorySize(0),
+	m_hugePages(false),
+	m_slotCount(0),
+	m_slotSize(0),
+	m_writeCount(0),
+	m_readCount(0),
+	m_recording(false)
+{
+	pthread_mutex_init(&m_mutex, NULL);
+}
+
+PreRecordRing::~PreRecordRing()
+{
+	if (m_memory != NULL)
+		munmap(m_memory, m_memorySize);
+
+	pthread_mutex_destroy(&m_mutex);
+}
+
+bool PreRecordRing::Allocate(uint32_t slotCount, size_t slotSize)
+{
+	void* memory;
+
+	if (slotCount == 0 || slotSize == 0)
+		return false;
+
+	m_slotCount		= slotCount;
+	m_slotSize		= slotSize;
+	m_memorySize	= ((slotCount * slotSize) + kHugePageSize - 1) & ~(kHugePageSize - 1);
+
+	// Reserved huge pages first, then transparent huge pages, both prefaulted so that
+	// the first pass around the ring does not take page faults on the capture thread
+	memory = mmap(NULL, m_memorySize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB|MAP_POPULATE, -1, 0);
+	if (memory != MAP_FAILED)
+	{
+		m_hugePages = true;
+	}
+	else
+	{
+		memory = mmap(NULL, m_memorySize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (memory == MAP_FAILED)
+			return false;
+
+		m_hugePages = (madvise(memory, m_memorySize, MADV_HUGEPAGE) == 0);
+		madvise(memory, m_memorySize, MADV_WILLNEED);
+		memset(memory, 0, m_memorySize);
+	}
+
+	m_memory = (uint8_t*)memory;
+	return true;
+}
+
+uint8_t* PreRecordRing::BeginWrite(size_t recordSize)
+{
+	uint8_t* slot = NULL;
+
+	if (recordSize > m_slotSize)
+		return NULL;
+
+	pthread_mutex_lock(&m_mutex);
+	if (m_writeCount - m_readCount == m_slotCount)
+	{
+		// Full.  Before recording the oldest record is simply forgotten.
+		if (!m_recording)
+			m_readCount++;
+	}
+
+	if (m_writeCount - m_readCount < m_slotCount)
+		slot = m_memory + (m_writeCount % m_slotCount) * m_slotSize;
+	pthread_mutex_unlock(&m_mutex);
+
+	return slot;
+}
+
+bool PreRecordRing::EndWrite()
+{
+	bool recording;
+
+	pthread_mutex_lock(&m_mutex);
+	m_writeCount++;
+	recording = m_recording;
+	pthread_mutex_unlock(&m_mutex);
+
+	return recording;
+}
+
+void PreRecordRing::StartRecording()
+{
+	pthread_mutex_lock(&m_mutex);
+	m_recording = true;
+	pthread_mutex_unlock(&m_mutex);
+}
+
+bool PreRecordRing::IsRecording()
+{
+	pthread_mutex_lock(&m_mutex);
+	bool recording = m_recording;
+	pthread_mutex_unlock(&m_mutex);
+
+	return recording;
+}
+
+const uint8_t* PreRecordRing::BeginRead()
+{
+	const uint8_t* slot = NULL;
+
+	// Only one writer thread services an input at a time, so the slot stays put
+	// until EndRead
+	pthread_mutex_lock(&m_mutex);
+	if (m_recording && m_readCount < m_writeCount)
+		slot = m_memory + (m_readCount % m_slotCount) * m_slotSize;
+	pthread_mutex_unlock(&m_mutex);
+
+	return slot;
+}
+
+void PreRecordRing::EndRead()
+{
+	pthread_mutex_lock(&m_mutex);
+	m_readCount++;
+	pthread_mutex_unlock(&m_mutex);
+}
+
+uint32_t PreRecordRing::GetPendingCount()
+{
+	pthread_mutex_lock(&m_mutex);
+	uint32_t pending = m_recording ? (uint32_t)(m_writeCount - m_readCount) : 0;
+	pthread_mutex_unlock(&m_mutex);
+
+	return pending;
+}
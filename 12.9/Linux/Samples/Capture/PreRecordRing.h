@@ -0,0 +1,88 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __PRE_RECORD_RING_H__
+#define __PRE_RECORD_RING_H__
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed ring of container records that keeps the most recent frames in memory until
+// recording is triggered.  Before the trigger the oldest record is overwritten; after
+// it the writer drains the ring from the oldest record, and the capture side drops
+// frames rather than overwrite records that have not been written.  All memory is
+// allocated up front, from huge pages when the system has them.
+class PreRecordRing
+{
+public:
+	PreRecordRing();
+	virtual ~PreRecordRing();
+
+	bool		Allocate(uint32_t slotCount, size_t slotSize);
+	bool		IsHugePageBacked(void) const { return m_hugePages; }
+	size_t		GetMemorySize(void) const { return m_memorySize; }
+
+	// Capture side.  BeginWrite returns NULL if the record does not fit a slot or the
+	// writer has fallen a whole ring behind.  EndWrite returns true once recording.
+	uint8_t*	BeginWrite(size_t recordSize);
+	bool		EndWrite(void);
+
+	void		StartRecording(void);
+	bool		IsRecording(void);
+
+	// Writer side, returns NULL until recording has started or when nothing is pending
+	const uint8_t*	BeginRead(void);
+	void			EndRead(void);
+	uint32_t		GetPendingCount(void);
+
+private:
+	pthread_mutex_t		m_mutex;
+	uint8_t*			m_memory;
+	size_t				m_memorySize;
+	bool				m_hugePages;
+	uint32_t			m_slotCount;
+	size_t				m_slotSize;
+	uint64_t			m_writeCount;		// Records committed
+	uint64_t			m_readCount;		// Records written out, or overwritten before recording
+	bool				m_recording;
+};
+
+#endif
@@ -0,0 +1,544 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "RawContainer.h"
+
+static uint64_t AlignUp(uint64_t size)
+{
+	return (size + kRawContainerAlignment - 1) & ~(uint64_t)(kRawContainerAlignment - 1);
+}
+
+static bool ReadFully(int fileDescriptor, void* bytes, size_t size, uint64_t offset)
+{
+	size_t done = 0;
+
+	while (done < size)
+	{
+		ssize_t result = pread(fileDescriptor, (uint8_t*)bytes + done, size - done, offset + done);
+		if (result < 0 && errno == EINTR)
+			continue;
+		if (result <= 0)
+			return false;
+		done += result;
+	}
+
+	return true;
+}
+
+static int BCDToInt(uint32_t bcd)
+{
+	return ((bcd >> 4) & 0xF) * 10 + (bcd & 0xF);
+}
+
+// Frames since 00:00:00:00 at the timecode rate, which is half the frame rate above 30 fps
+static int64_t TimecodeToFrames(uint32_t timecodeBCD, int timecodeRate, bool dropFrame)
+{
+	int		hours	= BCDToInt(timecodeBCD >> 24);
+	int		minutes	= BCDToInt(timecodeBCD >> 16);
+	int		seconds	= BCDToInt(timecodeBCD >> 8);
+	int		frames	= BCDToInt(timecodeBCD);
+	int64_t	count	= ((int64_t)(hours * 60 + minutes) * 60 + seconds) * timecodeRate + frames;
+
+	if (dropFrame)
+	{
+		// Frame numbers 0 and 1 are skipped every minute except every tenth minute
+		int64_t	totalMinutes = hours * 60 + minutes;
+		count -= 2 * (totalMinutes - totalMinutes / 10) * (timecodeRate / 30);
+	}
+
+	return count;
+}
+
+uint64_t RawRecordSize(uint64_t videoSize, uint64_t audioSize)
+{
+	return kRawContainerAlignment + AlignUp(videoSize + audioSize);
+}
+
+std::string RawSegmentFilename(const std::string& basename, uint32_t segmentNumber)
+{
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".%06u.dlraw", segmentNumber);
+	return basename + suffix;
+}
+
+RawContainerWriter::RawContainerWriter(const std::string& basename, const char* deviceName, uint64_t maxSegmentBytes, double maxSegmentSeconds) :
+	m_basename(basename),
+	m_deviceName(deviceName != NULL ? deviceName : ""),
+	m_maxSegmentBytes(maxSegmentBytes),
+	m_maxSegmentSeconds(maxSegmentSeconds),
+	m_fileDescriptor(-1),
+	m_segmentNumber(0),
+	m_segmentBytes(0),
+	m_firstFrameNumber(0),
+	m_firstStreamTime(0),
+	m_frameDuration(0),
+	m_timeScale(0)
+{
+}
+
+RawContainerWriter::~RawContainerWriter()
+{
+	Close();
+}
+
+bool RawContainerWriter::Open()
+{
+	m_segmentNumber = 0;
+	return OpenSegment(0);
+}
+
+bool RawContainerWriter::WriteFully(const void* bytes, size_t size)
+{
+	size_t done = 0;
+
+	while (done < size)
+	{
+		ssize_t result = write(m_fileDescriptor, (const uint8_t*)bytes + done, size - done);
+		if (result < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		done += result;
+	}
+
+	m_segmentBytes += size;
+	return true;
+}
+
+bool RawContainerWriter::OpenSegment(uint64_t firstFrameNumber)
+{
+	std::string			path = RawSegmentFilename(m_basename, m_segmentNumber);
+	uint8_t				block[kRawContainerAlignment];
+	RawSegmentHeader*	header = (RawSegmentHeader*)block;
+
+	m_fileDescriptor = open(path.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (m_fileDescriptor < 0)
+	{
+		fprintf(stderr, "Could not open output file \"%s\"\n", path.c_str());
+		return false;
+	}
+
+	memset(block, 0, sizeof(block));
+	header->magic				= kRawSegmentMagic;
+	header->version				= kRawContainerVersion;
+	header->segmentNumber		= m_segmentNumber;
+	header->alignment			= kRawContainerAlignment;
+	header->firstFrameNumber	= firstFrameNumber;
+	header->creationTime		= time(NULL);
+	strncpy(header->deviceName, m_deviceName.c_str(), sizeof(header->deviceName) - 1);
+
+	m_segmentBytes		= 0;
+	m_firstFrameNumber	= firstFrameNumber;
+	m_index.clear();
+
+	return WriteFully(block, sizeof(block));
+}
+
+bool RawContainerWriter::CloseSegment()
+{
+	bool				success;
+	RawSegmentFooter	footer;
+
+	if (m_fileDescriptor < 0)
+		return true;
+
+	memset(&footer, 0, sizeof(footer));
+	footer.magic			= kRawIndexMagic;
+	footer.version			= kRawContainerVersion;
+	footer.indexOffset		= m_segmentBytes;
+	footer.firstFrameNumber	= m_firstFrameNumber;
+	footer.entryCount		= m_index.size();
+	footer.frameDuration	= m_frameDuration;
+	footer.timeScale		= m_timeScale;
+
+	success = WriteFully(m_index.data(), m_index.size() * sizeof(RawIndexEntry)) &&
+			  WriteFully(&footer, sizeof(footer));
+
+	// The first frame number is only known once the first record is written
+	if (success)
+	{
+		uint64_t firstFrameNumber = m_firstFrameNumber;
+		success = pwrite(m_fileDescriptor, &firstFrameNumber, sizeof(firstFrameNumber), offsetof(RawSegmentHeader, firstFrameNumber)) == sizeof(firstFrameNumber);
+	}
+
+	if (close(m_fileDescriptor) != 0)
+		success = false;
+
+	m_fileDescriptor = -1;
+	m_segmentNumber++;
+	return success;
+}
+
+bool RawContainerWriter::WriteRecord(const uint8_t* record)
+{
+	const RawFrameHeader*	header = (const RawFrameHeader*)record;
+	RawIndexEntry			entry;
+
+	if (m_fileDescriptor < 0)
+		return false;
+
+	if (!m_index.empty())
+	{
+		uint64_t	nextFrameNumber	= m_firstFrameNumber + m_index.size();
+		bool		rotate			= false;
+
+		if (m_maxSegmentBytes > 0 && m_segmentBytes + header->recordSize > m_maxSegmentBytes)
+			rotate = true;
+
+		if (m_maxSegmentSeconds > 0 && header->timeScale > 0 &&
+			(double)(header->streamTime - m_firstStreamTime) / header->timeScale >= m_maxSegmentSeconds)
+			rotate = true;
+
+		// Keep one video format per segment so that timecode arithmetic within a
+		// segment stays valid, and never let the dense index run backwards
+		if ((header->flags & kRawFrameFormatChanged) || header->frameNumber < nextFrameNumber)
+			rotate = true;
+
+		if (rotate && (!CloseSegment() || !OpenSegment(header->frameNumber)))
+			return false;
+	}
+
+	if (m_index.empty())
+	{
+		m_firstFrameNumber	= header->frameNumber;
+		m_firstStreamTime	= header->streamTime;
+		m_frameDuration		= header->frameDuration;
+		m_timeScale			= header->timeScale;
+	}
+
+	// Dropped frames keep their slot so that lookup by frame number stays O(1)
+	memset(&entry, 0, sizeof(entry));
+	entry.flags = kRawFrameMissing;
+	while (m_firstFrameNumber + m_index.size() < header->frameNumber)
+		m_index.push_back(entry);
+
+	entry.offset		= m_segmentBytes;
+	entry.streamTime	= header->streamTime;
+	entry.timecodeBCD	= header->timecodeBCD;
+	entry.flags			= header->flags;
+
+	if (!WriteFully(record, header->recordSize))
+		return false;
+
+	m_index.push_back(entry);
+	return true;
+}
+
+bool RawContainerWriter::Close()
+{
+	return CloseSegment();
+}
+
+RawContainerReader::RawContainerReader()
+{
+}
+
+RawContainerReader::~RawContainerReader()
+{
+	Close();
+}
+
+bool RawContainerReader::Open(const std::string& basename, int openFlags)
+{
+	Close();
+
+	for (uint32_t segmentNumber = 0; ; segmentNumber++)
+	{
+		std::string			path = RawSegmentFilename(basename, segmentNumber);
+		Segment				segment;
+		RawSegmentHeader	header;
+
+		segment.metadataFileDescriptor = open(path.c_str(), O_RDONLY);
+		if (segment.metadataFileDescriptor < 0)
+			break;
+
+		segment.fileDescriptor = openFlags ? open(path.c_str(), O_RDONLY|openFlags) : segment.metadataFileDescriptor;
+
+		if (segment.fileDescriptor < 0 ||
+			!ReadFully(segment.metadataFileDescriptor, &header, sizeof(header), 0) ||
+			header.magic != kRawSegmentMagic ||
+			header.version != kRawContainerVersion ||
+			header.alignment != kRawContainerAlignment)
+		{
+			fprintf(stderr, "\"%s\" is not a valid raw capture segment\n", path.c_str());
+			if (segment.fileDescriptor >= 0 && segment.fileDescriptor != segment.metadataFileDescriptor)
+				close(segment.fileDescriptor);
+			close(segment.metadataFileDescriptor);
+			break;
+		}
+
+		segment.firstFrameNumber	= header.firstFrameNumber;
+		segment.frameDuration		= 0;
+		segment.timeScale			= 0;
+
+		if (!LoadIndex(segment) && !ScanRecords(segment))
+		{
+			if (segment.fileDescriptor != segment.metadataFileDescriptor)
+				close(segment.fileDescriptor);
+			close(segment.metadataFileDescriptor);
+			break;
+		}
+
+		// Segments without any frames are skipped, lookup relies on increasing frame numbers
+		if (segment.index.empty())
+		{
+			if (segment.fileDescriptor != segment.metadataFileDescriptor)
+				close(segment.fileDescriptor);
+			close(segment.metadataFileDescriptor);
+			continue;
+		}
+
+		m_segments.push_back(segment);
+	}
+
+	return !m_segments.empty();
+}
+
+void RawContainerReader::Close()
+{
+	for (Segment& segment : m_segments)
+	{
+		if (segment.fileDescriptor != segment.metadataFileDescriptor)
+			close(segment.fileDescriptor);
+		close(segment.metadataFileDescriptor);
+	}
+
+	m_segments.clear();
+}
+
+bool RawContainerReader::LoadIndex(Segment& segment)
+{
+	struct stat			status;
+	RawSegmentFooter	footer;
+
+	if (fstat(segment.metadataFileDescriptor, &status) != 0 || (uint64_t)status.st_size < kRawContainerAlignment + sizeof(footer))
+		return false;
+
+	if (!ReadFully(segment.metadataFileDescriptor, &footer, sizeof(footer), status.st_size - sizeof(footer)))
+		return false;
+
+	if (footer.magic != kRawIndexMagic || footer.version != kRawContainerVersion ||
+		footer.indexOffset + footer.entryCount * sizeof(RawIndexEntry) + sizeof(footer) != (uint64_t)status.st_size)
+		return false;
+
+	segment.index.resize(footer.entryCount);
+	if (!ReadFully(segment.metadataFileDescriptor, segment.index.data(), footer.entryCount * sizeof(RawIndexEntry), footer.indexOffset))
+	{
+		segment.index.clear();
+		return false;
+	}
+
+	segment.firstFrameNumber	= footer.firstFrameNumber;
+	segment.frameDuration		= footer.frameDuration;
+	segment.timeScale			= footer.timeScale;
+	return true;
+}
+
+bool RawContainerReader::ScanRecords(Segment& segment)
+{
+	struct stat		status;
+	uint64_t		offset = kRawContainerAlignment;
+	RawFrameHeader	header;
+
+	// The segment was not closed, recover the index from the record headers
+	if (fstat(segment.metadataFileDescriptor, &status) != 0)
+		return false;
+
+	segment.index.clear();
+
+	while (offset + sizeof(header) <= (uint64_t)status.st_size)
+	{
+		if (!ReadFully(segment.metadataFileDescriptor, &header, sizeof(header), offset))
+			break;
+
+		if (header.magic != kRawFrameMagic || header.headerSize != kRawContainerAlignment ||
+			header.recordSize != RawRecordSize(header.videoSize, header.audioSize) ||
+			offset + header.recordSize > (uint64_t)status.st_size)
+			break;
+
+		if (segment.index.empty())
+		{
+			segment.firstFrameNumber	= header.frameNumber;
+			segment.frameDuration		= header.frameDuration;
+			segment.timeScale			= header.timeScale;
+		}
+		else if (header.frameNumber < segment.firstFrameNumber + segment.index.size())
+			break;
+
+		RawIndexEntry entry;
+		memset(&entry, 0, sizeof(entry));
+		entry.flags = kRawFrameMissing;
+		while (segment.firstFrameNumber + segment.index.size() < header.frameNumber)
+			segment.index.push_back(entry);
+
+		entry.offset		= offset;
+		entry.streamTime	= header.streamTime;
+		entry.timecodeBCD	= header.timecodeBCD;
+		entry.flags			= header.flags;
+		segment.index.push_back(entry);
+
+		offset += header.recordSize;
+	}
+
+	return true;
+}
+
+uint64_t RawContainerReader::GetFirstFrameNumber() const
+{
+	return m_segments.empty() ? 0 : m_segments.front().firstFrameNumber;
+}
+
+uint64_t RawContainerReader::GetLastFrameNumber() const
+{
+	return m_segments.empty() ? 0 : m_segments.back().firstFrameNumber + m_segments.back().index.size() - 1;
+}
+
+bool RawContainerReader::FindFrame(uint64_t frameNumber, RawFrameLocation& location) const
+{
+	// Segments are in frame order, find the last one starting at or before the frame
+	auto segment = std::upper_bound(m_segments.begin(), m_segments.end(), frameNumber,
+		[](uint64_t number, const Segment& s) { return number < s.firstFrameNumber; });
+
+	if (segment == m_segments.begin())
+		return false;
+	--segment;
+
+	uint64_t entry = frameNumber - segment->firstFrameNumber;
+	if (entry >= segment->index.size() || segment->index[entry].offset == 0)
+		return false;
+
+	location.segment	= (uint32_t)(segment - m_segments.begin());
+	location.offset		= segment->index[entry].offset;
+	return true;
+}
+
+bool RawContainerReader::FindTimecode(uint32_t timecodeBCD, RawFrameLocation& location) const
+{
+	for (size_t s = 0; s < m_segments.size(); s++)
+	{
+		const Segment&	segment = m_segments[s];
+		size_t			reference;
+
+		for (reference = 0; reference < segment.index.size(); reference++)
+		{
+			if (segment.index[reference].flags & kRawFrameHasTimecode)
+				break;
+		}
+
+		if (reference == segment.index.size())
+			continue;
+
+		// Continuous timecode maps directly to an index entry
+		if (segment.frameDuration > 0)
+		{
+			const RawIndexEntry&	first			= segment.index[reference];
+			int						frameRate		= (int)((segment.timeScale + segment.frameDuration / 2) / segment.frameDuration);
+			int						timecodeRate	= frameRate > 30 ? frameRate / 2 : frameRate;
+			bool					dropFrame		= (first.flags & kRawFrameDropFrameTimecode) != 0;
+			int64_t					delta			= TimecodeToFrames(timecodeBCD, timecodeRate, dropFrame) - TimecodeToFrames(first.timecodeBCD, timecodeRate, dropFrame);
+
+			if (frameRate > 30)
+				delta *= 2;
+
+			// Above 30 fps each timecode value covers two frames
+			for (int64_t candidate = (int64_t)reference + delta; candidate <= (int64_t)reference + delta + (frameRate > 30 ? 1 : 0); candidate++)
+			{
+				if (candidate < 0 || candidate >= (int64_t)segment.index.size())
+					continue;
+
+				const RawIndexEntry& entry = segment.index[candidate];
+				if (entry.offset != 0 && (entry.flags & kRawFrameHasTimecode) && entry.timecodeBCD == timecodeBCD)
+				{
+					location.segment	= (uint32_t)s;
+					location.offset		= entry.offset;
+					return true;
+				}
+			}
+		}
+	}
+
+	// Discontinuous timecode, search every index
+	for (size_t s = 0; s < m_segments.size(); s++)
+	{
+		for (const RawIndexEntry& entry : m_segments[s].index)
+		{
+			if (entry.offset != 0 && (entry.flags & kRawFrameHasTimecode) && entry.timecodeBCD == timecodeBCD)
+			{
+				location.segment	= (uint32_t)s;
+				location.offset		= entry.offset;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool RawContainerReader::ReadHeader(const RawFrameLocation& location, RawFrameHeader& header) const
+{
+	if (location.segment >= m_segments.size())
+		return false;
+
+	if (!ReadFully(m_segments[location.segment].metadataFileDescriptor, &header, sizeof(header), location.offset))
+		return false;
+
+	return header.magic == kRawFrameMagic && header.recordSize == RawRecordSize(header.videoSize, header.audioSize);
+}
+
+bool RawContainerReader::ReadRecord(const RawFrameLocation& location, const RawFrameHeader& header, void* record) const
+{
+	if (location.segment >= m_segments.size())
+		return false;
+
+	return ReadFully(m_segments[location.segment].fileDescriptor, record, header.recordSize, location.offset);
+}
@@ -0,0 +1,246 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __RAW_CONTAINER_H__
+#define __RAW_CONTAINER_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Segmented container for raw captured frames.
+//
+// A recording is a numbered series of segment files, <basename>.000000.dlraw and
+// so on.  Each segment is a segment header block, then one record per frame, then
+// a trailing index and footer.  Every record is a header block followed by the
+// video and audio payloads, padded to kRawContainerAlignment, so a record can be
+// read with O_DIRECT and written with a single large write.
+// The video payload may be stored as independently compressed row slices, see
+// SliceCompressor.  The header can carry CRC32C checksums of the uncompressed video
+// and of the audio, see FrameChecksum.
+//
+// The index has one entry for every frame number between the first and last frame
+// of the segment, with a zero offset for frames that were not recorded, so lookup
+// by frame number is O(1).  A segment without a footer, for example after a crash,
+// is indexed by walking the record headers.
+
+static const uint32_t	kRawContainerAlignment		= 4096;
+static const uint32_t	kRawContainerVersion		= 2;
+static const uint32_t	kRawSegmentMagic			= 0x444C5253;	// 'DLRS'
+static const uint32_t	kRawFrameMagic				= 0x444C4652;	// 'DLFR'
+static const uint32_t	kRawIndexMagic				= 0x444C4958;	// 'DLIX'
+static const uint32_t	kRawMaxSlices				= 256;
+static const uint32_t	kRawSliceStored				= 0x80000000;	// Slice size flag, slice is not compressed
+
+// Largest audio payload of a record, frames with a larger audio packet are dropped
+static const uint32_t	kRawMaxAudioSampleFrames	= 4096;
+static const uint32_t	kRawMaxAudioChannels		= 64;
+static const uint32_t	kRawMaxAudioSampleDepth		= 32;
+
+enum RawFrameFlags : uint32_t
+{
+	kRawFrameHasTimecode		= (1 << 0),
+	kRawFrame3D					= (1 << 1),		// Video payload is left eye followed by right eye
+	kRawFrameFormatChanged		= (1 << 2),		// First frame after an input format change
+	kRawFrameMissing			= (1 << 3),		// Index only, frame was dropped
+	kRawFrameDropFrameTimecode	= (1 << 4),
+	kRawFrameHasChecksum		= (1 << 5),		// videoChecksum and audioChecksum are valid
+};
+
+enum RawCompression : uint32_t
+{
+	kRawCompressionNone			= 0,
+	kRawCompressionLZ4			= 1,
+	kRawCompressionZstd			= 2,
+};
+
+struct RawSegmentHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	segmentNumber;
+	uint32_t	alignment;
+	uint64_t	firstFrameNumber;
+	int64_t		creationTime;				// Seconds since the epoch
+	char		deviceName[64];
+};
+
+struct RawFrameHeader
+{
+	uint32_t	magic;
+	uint32_t	headerSize;					// Offset of the video payload from the start of the record
+	uint64_t	frameNumber;
+	int64_t		streamTime;
+	int64_t		frameDuration;
+	int64_t		timeScale;
+	uint32_t	timecodeBCD;				// BMDTimecodeBCD, valid with kRawFrameHasTimecode
+	uint32_t	timecodeFlags;				// BMDTimecodeFlags
+	uint32_t	pixelFormat;
+	uint32_t	width;
+	uint32_t	height;
+	uint32_t	rowBytes;
+	uint32_t	flags;						// RawFrameFlags
+	uint32_t	audioSampleFrames;
+	uint32_t	audioChannels;
+	uint32_t	audioSampleDepth;
+	uint64_t	videoSize;					// Stored size of the video payload
+	uint64_t	audioSize;					// Audio payload follows the video payload
+	uint64_t	recordSize;					// Header, payloads and padding
+	uint32_t	compression;				// RawCompression of the video payload
+	uint32_t	sliceCount;					// Compressed slice sizes follow this header
+	uint32_t	sliceRows;					// Rows per slice, the last slice may be shorter
+	uint32_t	reserved;
+	uint64_t	uncompressedVideoSize;
+	uint32_t	videoChecksum;				// CRC32C of the uncompressed video payload
+	uint32_t	audioChecksum;				// CRC32C of the audio payload
+};
+
+// Sizes of the compressed slices, stored in the header block after RawFrameHeader
+inline uint32_t* RawSliceSizes(RawFrameHeader* header) { return (uint32_t*)(header + 1); }
+inline const uint32_t* RawSliceSizes(const RawFrameHeader* header) { return (const uint32_t*)(header + 1); }
+
+struct RawIndexEntry
+{
+	uint64_t	offset;						// Record offset in the segment, 0 if missing
+	int64_t		streamTime;
+	uint32_t	timecodeBCD;
+	uint32_t	flags;
+};
+
+struct RawSegmentFooter
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint64_t	indexOffset;
+	uint64_t	firstFrameNumber;
+	uint64_t	entryCount;
+	int64_t		frameDuration;
+	int64_t		timeScale;
+};
+
+// Size of a record with the given payloads, including header and padding
+uint64_t		RawRecordSize(uint64_t videoSize, uint64_t audioSize);
+std::string		RawSegmentFilename(const std::string& basename, uint32_t segmentNumber);
+
+// Appends records to the current segment and starts a new segment when the size or
+// duration limit is reached.  Not thread safe, used from one writer at a time.
+class RawContainerWriter
+{
+public:
+	RawContainerWriter(const std::string& basename, const char* deviceName, uint64_t maxSegmentBytes, double maxSegmentSeconds);
+	virtual ~RawContainerWriter();
+
+	bool		Open(void);
+	// record points to a complete record starting with its RawFrameHeader
+	bool		WriteRecord(const uint8_t* record);
+	bool		Close(void);
+
+	uint32_t	GetSegmentCount(void) const { return m_segmentNumber + (m_fileDescriptor >= 0 ? 1 : 0); }
+
+private:
+	bool		OpenSegment(uint64_t firstFrameNumber);
+	bool		CloseSegment(void);
+	bool		WriteFully(const void* bytes, size_t size);
+
+	std::string					m_basename;
+	std::string					m_deviceName;
+	uint64_t					m_maxSegmentBytes;
+	double						m_maxSegmentSeconds;
+
+	int							m_fileDescriptor;
+	uint32_t					m_segmentNumber;
+	uint64_t					m_segmentBytes;
+	uint64_t					m_firstFrameNumber;
+	int64_t						m_firstStreamTime;
+	int64_t						m_frameDuration;
+	int64_t						m_timeScale;
+	std::vector<RawIndexEntry>	m_index;
+};
+
+struct RawFrameLocation
+{
+	uint32_t	segment;
+	uint64_t	offset;
+};
+
+// Random access to a recording.  Segment indexes are loaded when the recording is
+// opened.
+class RawContainerReader
+{
+public:
+	RawContainerReader();
+	virtual ~RawContainerReader();
+
+	bool		Open(const std::string& basename, int openFlags = 0);
+	void		Close(void);
+
+	uint64_t	GetFirstFrameNumber(void) const;
+	uint64_t	GetLastFrameNumber(void) const;
+
+	bool		FindFrame(uint64_t frameNumber, RawFrameLocation& location) const;
+	// Computes the frame from the timecode, falling back to a search of the index
+	// when timecode is discontinuous
+	bool		FindTimecode(uint32_t timecodeBCD, RawFrameLocation& location) const;
+
+	bool		ReadHeader(const RawFrameLocation& location, RawFrameHeader& header) const;
+	// Reads the whole record into a buffer of at least header.recordSize bytes,
+	// aligned to kRawContainerAlignment when the container was opened with O_DIRECT
+	bool		ReadRecord(const RawFrameLocation& location, const RawFrameHeader& header, void* record) const;
+
+	int			GetFileDescriptor(uint32_t segment) const { return m_segments[segment].fileDescriptor; }
+
+private:
+	struct Segment
+	{
+		int							metadataFileDescriptor;	// Buffered, for headers and the index
+		int							fileDescriptor;			// Opened with the caller's flags, for records
+		uint64_t					firstFrameNumber;
+		int64_t						frameDuration;
+		int64_t						timeScale;
+		std::vector<RawIndexEntry>	index;
+	};
+
+	bool		LoadIndex(Segment& segment);
+	bool		ScanRecords(Segment& segment);
+
+	std::vector<Segment>		m_segments;
+};
+
+#endif
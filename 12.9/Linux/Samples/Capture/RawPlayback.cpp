@@ -0,0 +1,386 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+// Plays a recording made with Capture -o out of a DeckLink output, see RawPlayer.
+// Prints the disk underrun margin once a second while playing.
+
+#include <csignal>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "DeckLinkAPI.h"
+#include "RawContainer.h"
+#include "RawPlayer.h"
+#include "FrameChecksum.h"
+
+static const int		kDefaultReadAheadFrames = 16;
+static const int		kDefaultDecompressThreads = 4;
+
+static volatile sig_atomic_t	g_do_exit = 0;
+
+static void sigfunc(int signum)
+{
+	g_do_exit = 1;
+}
+
+static void DisplayUsage(void)
+{
+	fprintf(stderr,
+		"Usage: RawPlayback -d <device id> [OPTIONS] <basename>\n"
+		"\n"
+		"    -d <device id>       DeckLink output device, 0 is the first device\n"
+		"    -i <frame|timecode>  In point, a frame number or hh:mm:ss:ff timecode (default is the first frame)\n"
+		"    -o <frame|timecode>  Out point, inclusive (default is the last frame)\n"
+		"    -l                   Loop between the in and out points\n"
+		"    -c                   Cue to the in point and wait for <RETURN> before starting\n"
+		"    -b <frames>          Read-ahead window (default is %d frames)\n"
+		"    -t <threads>         Decompression threads for compressed recordings (default is %d)\n"
+		"    -V <threads>         Verify frame checksums with the given number of threads\n"
+		"\n"
+		"    <basename> is the name given to Capture -o, the segments are <basename>.NNNNNN.dlraw\n",
+		kDefaultReadAheadFrames, kDefaultDecompressThreads);
+}
+
+// Accepts a frame number, or a timecode that is looked up in the recording
+static bool ParseFramePosition(const RawContainerReader& reader, const char* text, uint64_t& frameNumber)
+{
+	unsigned int		hours, minutes, seconds, frames;
+	char				separator;
+	RawFrameLocation	location;
+	RawFrameHeader		header;
+
+	if (sscanf(text, "%u:%u:%u%c%u", &hours, &minutes, &seconds, &separator, &frames) == 5)
+	{
+		uint32_t timecodeBCD = ((hours / 10) << 28) | ((hours % 10) << 24) | ((minutes / 10) << 20) | ((minutes % 10) << 16) |
+			((seconds / 10) << 12) | ((seconds % 10) << 8) | ((frames / 10) << 4) | (frames % 10);
+
+		if (!reader.FindTimecode(timecodeBCD, location) || !reader.ReadHeader(location, header))
+		{
+			fprintf(stderr, "Timecode %s is not in the recording\n", text);
+			return false;
+		}
+
+		frameNumber = header.frameNumber;
+		return true;
+	}
+
+	char* end;
+	frameNumber = strtoull(text, &end, 10);
+	if (*text == '\0' || *end != '\0')
+	{
+		fprintf(stderr, "Invalid frame \"%s\"\n", text);
+		return false;
+	}
+
+	return true;
+}
+
+// The recording does not name its display mode, so find the output mode with the same
+// size and frame rate, preferring progressive modes
+static IDeckLinkDisplayMode* FindDisplayMode(IDeckLinkOutput* deckLinkOutput, const RawFrameHeader& format)
+{
+	IDeckLinkDisplayModeIterator*	displayModeIterator = NULL;
+	IDeckLinkDisplayMode*			displayMode = NULL;
+	IDeckLinkDisplayMode*			found = NULL;
+
+	if (deckLinkOutput->GetDisplayModeIterator(&displayModeIterator) != S_OK)
+		return NULL;
+
+	while (displayModeIterator->Next(&displayMode) == S_OK)
+	{
+		BMDTimeValue	frameDuration;
+		BMDTimeScale	timeScale;
+		bool			supported = false;
+
+		displayMode->GetFrameRate(&frameDuration, &timeScale);
+
+		if (displayMode->GetWidth() == (long)format.width && displayMode->GetHeight() == (long)format.height &&
+			frameDuration * format.timeScale == format.frameDuration * timeScale)
+		{
+			if (deckLinkOutput->DoesSupportVideoMode(bmdVideoConnectionUnspecified, displayMode->GetDisplayMode(), (BMDPixelFormat)format.pixelFormat,
+					bmdNoVideoOutputConversion, bmdSupportedVideoModeDefault, NULL, &supported) != S_OK)
+				supported = false;
+		}
+
+		if (supported && (found == NULL || displayMode->GetFieldDominance() == bmdProgressiveFrame))
+		{
+			if (found != NULL)
+				found->Release();
+			found = displayMode;
+			found->AddRef();
+		}
+
+		displayMode->Release();
+	}
+
+	displayModeIterator->Release();
+	return found;
+}
+
+static void PrintStatistics(RawPlayer* player, uint64_t& lastBytesRead, double intervalSeconds)
+{
+	RawPlayerStatistics statistics;
+
+	player->GetStatistics(statistics);
+
+	fprintf(stderr, "Scheduled %8llu  buffered %3u  margin %7.1f ms (lowest %7.1f ms)  read %7.1f MB/s (slowest %6.1f ms)  underruns %llu  late %llu  dropped %llu\n",
+		(unsigned long long)statistics.framesScheduled, statistics.bufferedFrames,
+		statistics.recentMarginMilliseconds, statistics.lowestMarginMilliseconds,
+		intervalSeconds > 0.0 ? (statistics.bytesRead - lastBytesRead) / intervalSeconds / 1e6 : 0.0,
+		statistics.maximumReadMilliseconds,
+		(unsigned long long)statistics.underruns, (unsigned long long)statistics.framesLate, (unsigned long long)statistics.framesDropped);
+
+	lastBytesRead = statistics.bytesRead;
+}
+
+int main(int argc, char *argv[])
+{
+	int						exitStatus = 1;
+	int						ch;
+	int						deckLinkIndex = -1;
+	const char*				inPoint = NULL;
+	const char*				outPoint = NULL;
+	bool					loop = false;
+	bool					cue = false;
+	int						readAheadFrames = kDefaultReadAheadFrames;
+	int						decompressThreads = kDefaultDecompressThreads;
+	int						verifyThreads = 0;
+	int						openFlags = O_DIRECT;
+	uint64_t				inFrame;
+	uint64_t				outFrame;
+	uint64_t				lastBytesRead = 0;
+
+	IDeckLinkIterator*		deckLinkIterator = NULL;
+	IDeckLink*				deckLink = NULL;
+	IDeckLinkOutput*		deckLinkOutput = NULL;
+	IDeckLinkDisplayMode*	displayMode = NULL;
+	RawContainerReader		reader;
+	RawPlayer*				player = NULL;
+	FrameChecksum*			checksum = NULL;
+	bool					audioEnabled = false;
+	char*					displayModeName = NULL;
+
+	while ((ch = getopt(argc, argv, "d:i:o:lcb:t:V:h?")) != -1)
+	{
+		switch (ch)
+		{
+			case 'd':	deckLinkIndex = atoi(optarg);		break;
+			case 'i':	inPoint = optarg;					break;
+			case 'o':	outPoint = optarg;					break;
+			case 'l':	loop = true;						break;
+			case 'c':	cue = true;							break;
+			case 'b':	readAheadFrames = atoi(optarg);		break;
+			case 't':	decompressThreads = atoi(optarg);	break;
+			case 'V':	verifyThreads = atoi(optarg);		break;
+			default:
+				DisplayUsage();
+				return 1;
+		}
+	}
+
+	if (deckLinkIndex < 0 || optind != argc - 1 || readAheadFrames < 2 || decompressThreads < 1)
+	{
+		DisplayUsage();
+		return 1;
+	}
+
+	signal(SIGINT, sigfunc);
+	signal(SIGTERM, sigfunc);
+
+	// O_DIRECT is refused by some file systems, tmpfs for example
+	{
+		int fd = open(RawSegmentFilename(argv[optind], 0).c_str(), O_RDONLY | O_DIRECT);
+		if (fd < 0 && errno == EINVAL)
+		{
+			fprintf(stderr, "The file system does not support O_DIRECT, reading through the page cache\n");
+			openFlags = 0;
+		}
+		if (fd >= 0)
+			close(fd);
+	}
+
+	if (!reader.Open(argv[optind], openFlags))
+	{
+		fprintf(stderr, "Unable to open recording %s\n", argv[optind]);
+		goto bail;
+	}
+
+	inFrame = reader.GetFirstFrameNumber();
+	outFrame = reader.GetLastFrameNumber();
+
+	if ((inPoint != NULL && !ParseFramePosition(reader, inPoint, inFrame)) ||
+		(outPoint != NULL && !ParseFramePosition(reader, outPoint, outFrame)))
+		goto bail;
+
+	if (inFrame < reader.GetFirstFrameNumber() || outFrame > reader.GetLastFrameNumber() || inFrame > outFrame)
+	{
+		fprintf(stderr, "The recording has frames %llu to %llu\n", (unsigned long long)reader.GetFirstFrameNumber(), (unsigned long long)reader.GetLastFrameNumber());
+		goto bail;
+	}
+
+	deckLinkIterator = CreateDeckLinkIteratorInstance();
+	if (deckLinkIterator == NULL)
+	{
+		fprintf(stderr, "A DeckLink iterator could not be created.  The DeckLink drivers may not be installed.\n");
+		goto bail;
+	}
+
+	for (int i = 0; deckLinkIterator->Next(&deckLink) == S_OK; i++)
+	{
+		if (i == deckLinkIndex)
+			break;
+		deckLink->Release();
+		deckLink = NULL;
+	}
+
+	if (deckLink == NULL || deckLink->QueryInterface(IID_IDeckLinkOutput, (void**)&deckLinkOutput) != S_OK)
+	{
+		fprintf(stderr, "Device %d does not support playback\n", deckLinkIndex);
+		goto bail;
+	}
+
+	if (verifyThreads > 0)
+	{
+		checksum = new FrameChecksum(verifyThreads);
+		if (!checksum->Start())
+			goto bail;
+	}
+
+	player = new RawPlayer(deckLinkOutput, &reader, decompressThreads, checksum);
+	if (!player->Open(inFrame, outFrame, loop, readAheadFrames))
+		goto bail;
+
+	displayMode = FindDisplayMode(deckLinkOutput, player->GetFormat());
+	if (displayMode == NULL)
+	{
+		const RawFrameHeader& format = player->GetFormat();
+		fprintf(stderr, "The device has no output mode for %ux%u at %.2f fps in the pixel format of the recording\n",
+			format.width, format.height, (double)format.timeScale / format.frameDuration);
+		goto bail;
+	}
+
+	if (deckLinkOutput->EnableVideoOutput(displayMode->GetDisplayMode(), bmdVideoOutputFlagDefault) != S_OK)
+	{
+		fprintf(stderr, "Unable to enable video output\n");
+		goto bail;
+	}
+
+	if (player->GetFormat().audioChannels > 0)
+	{
+		BMDAudioSampleType sampleType = (player->GetFormat().audioSampleDepth == 16) ? bmdAudioSampleType16bitInteger : bmdAudioSampleType32bitInteger;
+
+		if (deckLinkOutput->EnableAudioOutput(bmdAudioSampleRate48kHz, sampleType, player->GetFormat().audioChannels, bmdAudioOutputStreamTimestamped) != S_OK)
+			fprintf(stderr, "Unable to enable %u channels of audio output, playing video only\n", player->GetFormat().audioChannels);
+		else
+			audioEnabled = true;
+	}
+
+	displayMode->GetName((const char**)&displayModeName);
+	fprintf(stderr, "Playing frames %llu to %llu%s as %s, %d frames read ahead%s\n",
+		(unsigned long long)inFrame, (unsigned long long)outFrame, loop ? " looped" : "",
+		displayModeName ? displayModeName : "unknown mode", readAheadFrames, openFlags ? " with O_DIRECT" : "");
+	free(displayModeName);
+
+	if (!player->Cue())
+		goto bail;
+
+	if (cue)
+	{
+		fprintf(stderr, "Cued at frame %llu, press <RETURN> to start\n", (unsigned long long)inFrame);
+		getchar();
+	}
+
+	if (!player->Play())
+		goto bail;
+
+	while (!g_do_exit && !player->IsFinished())
+	{
+		sleep(1);
+		PrintStatistics(player, lastBytesRead, 1.0);
+	}
+
+	player->Stop();
+	PrintStatistics(player, lastBytesRead, 0.0);
+
+	if (checksum != NULL)
+	{
+		FrameChecksumStatistics statistics;
+		checksum->GetStatistics(statistics);
+
+		fprintf(stderr, "Checksums: %llu frames verified, %llu without checksums, %llu video and %llu audio mismatches\n",
+			(unsigned long long)statistics.framesVerified, (unsigned long long)statistics.framesUnverified,
+			(unsigned long long)statistics.videoMismatches, (unsigned long long)statistics.audioMismatches);
+	}
+
+	exitStatus = 0;
+
+bail:
+	if (player != NULL)
+		player->Release();
+
+	if (deckLinkOutput != NULL)
+	{
+		deckLinkOutput->DisableVideoOutput();
+		if (audioEnabled)
+			deckLinkOutput->DisableAudioOutput();
+		deckLinkOutput->Release();
+	}
+
+	if (displayMode != NULL)
+		displayMode->Release();
+
+	if (deckLink != NULL)
+		deckLink->Release();
+
+	if (deckLinkIterator != NULL)
+		deckLinkIterator->Release();
+
+	if (checksum != NULL)
+	{
+		checksum->Stop();
+		delete checksum;
+	}
+
+	return exitStatus;
+}
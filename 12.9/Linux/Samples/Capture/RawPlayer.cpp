@@ -0,0 +1,659 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+
+#include "RawPlayer.h"
+#include "SliceCompressor.h"
+#include "FrameChecksum.h"
+
+static uint64_t GetNanoseconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Output frame pointing at the video payload of a ring slot
+class RawPlayer::Frame : public IDeckLinkVideoFrame
+{
+public:
+	Frame(const RawFrameHeader& format, uint32_t slotIndex) :
+		m_refCount(1),
+		m_width(format.width),
+		m_height(format.height),
+		m_rowBytes(format.rowBytes),
+		m_pixelFormat((BMDPixelFormat)format.pixelFormat),
+		m_bytes(NULL),
+		m_slotIndex(slotIndex)
+	{
+	}
+
+	void		SetBytes(void* bytes) { m_bytes = bytes; }
+	uint32_t	GetSlotIndex(void) const { return m_slotIndex; }
+
+	virtual long STDMETHODCALLTYPE GetWidth(void) { return m_width; }
+	virtual long STDMETHODCALLTYPE GetHeight(void) { return m_height; }
+	virtual long STDMETHODCALLTYPE GetRowBytes(void) { return m_rowBytes; }
+	virtual BMDPixelFormat STDMETHODCALLTYPE GetPixelFormat(void) { return m_pixelFormat; }
+	virtual BMDFrameFlags STDMETHODCALLTYPE GetFlags(void) { return bmdFrameFlagDefault; }
+	virtual HRESULT STDMETHODCALLTYPE GetBytes(void** buffer) { *buffer = m_bytes; return S_OK; }
+	virtual HRESULT STDMETHODCALLTYPE GetTimecode(BMDTimecodeFormat format, IDeckLinkTimecode** timecode) { return E_NOTIMPL; }
+	virtual HRESULT STDMETHODCALLTYPE GetAncillaryData(IDeckLinkVideoFrameAncillary** ancillary) { return E_NOTIMPL; }
+
+	virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) { return E_NOINTERFACE; }
+	virtual ULONG STDMETHODCALLTYPE AddRef(void) { return __sync_add_and_fetch(&m_refCount, 1); }
+	virtual ULONG STDMETHODCALLTYPE Release(void)
+	{
+		int32_t newRefValue = __sync_sub_and_fetch(&m_refCount, 1);
+		if (newRefValue == 0)
+		{
+			delete this;
+			return 0;
+		}
+		return newRefValue;
+	}
+
+private:
+	int32_t				m_refCount;
+	long				m_width;
+	long				m_height;
+	long				m_rowBytes;
+	BMDPixelFormat		m_pixelFormat;
+	void*				m_bytes;
+	uint32_t			m_slotIndex;
+};
+
+RawPlayer::RawPlayer(IDeckLinkOutput* deckLinkOutput, RawContainerReader* reader, int decompressThreads, FrameChecksum* checksum) :
+	m_refCount(1),
+	m_deckLinkOutput(deckLinkOutput),
+	m_reader(reader),
+	m_decompressThreads(decompressThreads),
+	m_decompressor(NULL),
+	m_checksum(checksum),
+	m_uring(NULL),
+	m_inFrame(0),
+	m_clipLength(0),
+	m_loop(false),
+	m_endPosition(0),
+	m_recordCapacity(0),
+	m_readSize(0),
+	m_threadStarted(false),
+	m_stopping(false),
+	m_playing(false),
+	m_finished(false),
+	m_nextRead(0),
+	m_nextSchedule(0),
+	m_completed(0),
+	m_lastFrameNumber(0),
+	m_lowestMargin(INT64_MAX),
+	m_recentMargin(INT64_MAX),
+	m_maximumReadNanoseconds(0)
+{
+	memset(&m_format, 0, sizeof(m_format));
+	memset(&m_statistics, 0, sizeof(m_statistics));
+
+	pthread_mutex_init(&m_mutex, NULL);
+	pthread_cond_init(&m_condition, NULL);
+
+	m_deckLinkOutput->AddRef();
+}
+
+RawPlayer::~RawPlayer()
+{
+	Stop();
+	FreeSlots();
+
+	if (m_uring != NULL)
+		delete m_uring;
+
+	if (m_decompressor != NULL)
+	{
+		m_decompressor->Stop();
+		delete m_decompressor;
+	}
+
+	m_deckLinkOutput->Release();
+
+	pthread_cond_destroy(&m_condition);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+ULONG RawPlayer::AddRef(void)
+{
+	return __sync_add_and_fetch(&m_refCount, 1);
+}
+
+ULONG RawPlayer::Release(void)
+{
+	int32_t newRefValue = __sync_sub_and_fetch(&m_refCount, 1);
+	if (newRefValue == 0)
+	{
+		delete this;
+		return 0;
+	}
+	return newRefValue;
+}
+
+bool RawPlayer::Open(uint64_t inFrame, uint64_t outFrame, bool loop, int readAheadFrames)
+{
+	RawFrameLocation	location;
+	uint64_t			frameNumber;
+	uint64_t			maxVideoSize;
+	uint64_t			maxAudioSize;
+
+	if (inFrame > outFrame || readAheadFrames < 2)
+		return false;
+
+	m_inFrame		= inFrame;
+	m_clipLength	= outFrame - inFrame + 1;
+	m_loop			= loop;
+	m_endPosition	= loop ? UINT64_MAX : m_clipLength;
+
+	if (!FindSourceFrame(0, frameNumber, location) || !m_reader->ReadHeader(location, m_format))
+	{
+		fprintf(stderr, "Unable to read frame %llu of the recording\n", (unsigned long long)inFrame);
+		return false;
+	}
+
+	if (m_format.width == 0 || m_format.height == 0 || m_format.frameDuration <= 0 || m_format.timeScale <= 0)
+	{
+		fprintf(stderr, "Frame %llu of the recording has no video format\n", (unsigned long long)frameNumber);
+		return false;
+	}
+
+	if (m_format.compression != kRawCompressionNone)
+	{
+		m_decompressor = new SliceCompressor((RawCompression)m_format.compression, 0, m_decompressThreads);
+		if (!m_decompressor->Start())
+		{
+			fprintf(stderr, "The recording is compressed with %s, which is not available\n", SliceCompressor::GetCompressionName((RawCompression)m_format.compression));
+			return false;
+		}
+	}
+
+	// Room for any record of this format.  Compressed video is always smaller than the
+	// frame.  A record without audio doesn't give the audio format, so then room is left
+	// for the largest audio packet at the most channels and the largest samples.
+	maxVideoSize		= (uint64_t)m_format.rowBytes * m_format.height * ((m_format.flags & kRawFrame3D) ? 2 : 1);
+	maxAudioSize		= (uint64_t)kRawMaxAudioSampleFrames *
+						  (m_format.audioChannels != 0 ? m_format.audioChannels : kRawMaxAudioChannels) *
+						  ((m_format.audioSampleDepth != 0 ? m_format.audioSampleDepth : kRawMaxAudioSampleDepth) / 8);
+	m_recordCapacity	= RawRecordSize(std::max(maxVideoSize, m_format.videoSize), maxAudioSize);
+	m_readSize			= m_format.recordSize;
+
+	m_slots.resize(readAheadFrames);
+	for (uint32_t i = 0; i < m_slots.size(); i++)
+	{
+		Slot&	slot = m_slots[i];
+		void*	bytes;
+
+		memset(&slot, 0, sizeof(slot));
+		slot.state = kSlotFree;
+
+		if (posix_memalign(&bytes, kRawContainerAlignment, m_recordCapacity) != 0)
+		{
+			fprintf(stderr, "Unable to allocate %d frames of read-ahead\n", readAheadFrames);
+			return false;
+		}
+		slot.record = (uint8_t*)bytes;
+
+		if (m_format.compression != kRawCompressionNone)
+		{
+			if (posix_memalign(&bytes, kRawContainerAlignment, maxVideoSize) != 0)
+			{
+				fprintf(stderr, "Unable to allocate %d frames of read-ahead\n", readAheadFrames);
+				return false;
+			}
+			slot.video = (uint8_t*)bytes;
+		}
+
+		slot.frame = new Frame(m_format, i);
+	}
+
+	// Continuations of records larger than the first are queued alongside the reads
+	m_uring = new UringReader((unsigned)m_slots.size() * 2);
+	return m_uring->Open();
+}
+
+void RawPlayer::FreeSlots(void)
+{
+	for (Slot& slot : m_slots)
+	{
+		if (slot.frame != NULL)
+			slot.frame->Release();
+		free(slot.record);
+		free(slot.video);
+	}
+	m_slots.clear();
+}
+
+bool RawPlayer::FindSourceFrame(uint64_t position, uint64_t& frameNumber, RawFrameLocation& location)
+{
+	frameNumber = m_inFrame + position % m_clipLength;
+
+	if (m_reader->FindFrame(frameNumber, location))
+		return true;
+
+	// The frame was dropped during capture, hold the previous recorded frame
+	for (uint64_t previous = frameNumber; previous > m_inFrame; )
+	{
+		if (m_reader->FindFrame(--previous, location))
+		{
+			pthread_mutex_lock(&m_mutex);
+			m_statistics.framesRepeated++;
+			pthread_mutex_unlock(&m_mutex);
+
+			frameNumber = previous;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void RawPlayer::StartRead(uint32_t slotIndex)
+{
+	Slot& slot = m_slots[slotIndex];
+
+	slot.bytesRead		= 0;
+	slot.readStartTime	= GetNanoseconds();
+
+	if (!FindSourceFrame(slot.position, slot.frameNumber, slot.location) ||
+		!m_uring->QueueRead(m_reader->GetFileDescriptor(slot.location.segment), slot.record, std::min(m_readSize, m_recordCapacity), slot.location.offset, slotIndex))
+	{
+		CompleteRead(slotIndex, -ENOENT);
+	}
+}
+
+void RawPlayer::CompleteRead(uint32_t slotIndex, int result)
+{
+	Slot&					slot = m_slots[slotIndex];
+	const RawFrameHeader*	header = (const RawFrameHeader*)slot.record;
+	SlotState				state = kSlotSkipped;
+
+	if (result <= 0)
+	{
+		fprintf(stderr, "Unable to read frame %llu - %s\n", (unsigned long long)slot.frameNumber, result < 0 ? strerror(-result) : "end of file");
+		goto done;
+	}
+
+	slot.bytesRead += result;
+
+	pthread_mutex_lock(&m_mutex);
+	m_statistics.bytesRead += result;
+	pthread_mutex_unlock(&m_mutex);
+
+	if (slot.bytesRead < sizeof(RawFrameHeader))
+		goto done;
+
+	if (header->magic != kRawFrameMagic || header->frameNumber != slot.frameNumber || header->recordSize != RawRecordSize(header->videoSize, header->audioSize))
+	{
+		fprintf(stderr, "Frame %llu has an invalid record header\n", (unsigned long long)slot.frameNumber);
+		goto done;
+	}
+
+	if (header->recordSize > m_recordCapacity || header->width != m_format.width || header->height != m_format.height || header->pixelFormat != m_format.pixelFormat)
+	{
+		fprintf(stderr, "Frame %llu changes format, which is not supported\n", (unsigned long long)slot.frameNumber);
+		goto done;
+	}
+
+	if (slot.bytesRead < header->recordSize)
+	{
+		// Larger than any record so far, read the rest and ask for whole records from now on
+		m_readSize = std::max(m_readSize, header->recordSize);
+		if (m_uring->QueueRead(m_reader->GetFileDescriptor(slot.location.segment), slot.record + slot.bytesRead,
+				header->recordSize - slot.bytesRead, slot.location.offset + slot.bytesRead, slotIndex))
+			return;
+		goto done;
+	}
+
+	{
+		const uint8_t*	payload = slot.record + header->headerSize;
+		const uint8_t*	video = payload;
+
+		if (header->compression != kRawCompressionNone)
+		{
+			if (m_decompressor == NULL || !m_decompressor->DecompressFrame(header, payload, slot.video))
+			{
+				fprintf(stderr, "Unable to decompress frame %llu\n", (unsigned long long)slot.frameNumber);
+				goto done;
+			}
+			video = slot.video;
+		}
+
+		if (m_checksum != NULL && !m_checksum->VerifyFrame(header, video, payload + header->videoSize))
+			fprintf(stderr, "Frame %llu does not match its checksum\n", (unsigned long long)slot.frameNumber);
+
+		slot.frame->SetBytes((void*)video);
+		state = kSlotReady;
+	}
+
+done:
+	uint64_t readNanoseconds = GetNanoseconds() - slot.readStartTime;
+
+	pthread_mutex_lock(&m_mutex);
+	slot.state = state;
+	if (state == kSlotSkipped)
+		m_statistics.framesSkipped++;
+	m_maximumReadNanoseconds = std::max(m_maximumReadNanoseconds, readNanoseconds);
+	pthread_mutex_unlock(&m_mutex);
+}
+
+void RawPlayer::ScheduleReadyFrames(void)
+{
+	pthread_mutex_lock(&m_mutex);
+
+	while (!m_stopping && m_nextSchedule < m_nextRead)
+	{
+		uint32_t	slotIndex = (uint32_t)(m_nextSchedule % m_slots.size());
+		Slot&		slot = m_slots[slotIndex];
+
+		if (slot.state != kSlotReady && slot.state != kSlotSkipped)
+			break;
+
+		BMDTimeValue	displayTime = (BMDTimeValue)slot.position * m_format.frameDuration;
+		BMDTimeValue	outputTime;
+		double			playbackSpeed;
+
+		if (slot.state == kSlotSkipped)
+		{
+			// Leave a gap in the schedule, the device repeats the previous frame
+			slot.state = kSlotFree;
+			m_completed++;
+			m_nextSchedule++;
+			pthread_cond_broadcast(&m_condition);
+			continue;
+		}
+
+		// The margin is how long before its output time the frame was ready
+		if (m_playing && m_deckLinkOutput->GetScheduledStreamTime(m_format.timeScale, &outputTime, &playbackSpeed) == S_OK)
+		{
+			int64_t margin = displayTime - outputTime;
+
+			m_lowestMargin = std::min(m_lowestMargin, margin);
+			m_recentMargin = std::min(m_recentMargin, margin);
+			if (margin <= 0)
+				m_statistics.underruns++;
+		}
+
+		if (m_deckLinkOutput->ScheduleVideoFrame(slot.frame, displayTime, m_format.frameDuration, m_format.timeScale) != S_OK)
+		{
+			fprintf(stderr, "Unable to schedule frame %llu\n", (unsigned long long)slot.frameNumber);
+			slot.state = kSlotFree;
+			m_statistics.framesSkipped++;
+			m_completed++;
+		}
+		else
+		{
+			const RawFrameHeader* header = (const RawFrameHeader*)slot.record;
+
+			slot.state = kSlotScheduled;
+			m_statistics.framesScheduled++;
+
+			// Audio is copied by the API, so only the video is held in the ring
+			if (header->audioSampleFrames > 0 && header->audioChannels == m_format.audioChannels && header->audioSampleDepth == m_format.audioSampleDepth)
+			{
+				uint32_t samplesWritten;
+				m_deckLinkOutput->ScheduleAudioSamples(slot.record + header->headerSize + header->videoSize, header->audioSampleFrames,
+					displayTime, m_format.timeScale, &samplesWritten);
+			}
+		}
+
+		m_nextSchedule++;
+		pthread_cond_broadcast(&m_condition);
+	}
+
+	if (m_completed >= m_endPosition)
+		m_finished = true;
+
+	pthread_mutex_unlock(&m_mutex);
+}
+
+HRESULT RawPlayer::ScheduledFrameCompleted(IDeckLinkVideoFrame* completedFrame, BMDOutputFrameCompletionResult result)
+{
+	uint32_t slotIndex = static_cast<Frame*>(completedFrame)->GetSlotIndex();
+
+	pthread_mutex_lock(&m_mutex);
+
+	if (result == bmdOutputFrameDisplayedLate)
+		m_statistics.framesLate++;
+	else if (result == bmdOutputFrameDropped)
+		m_statistics.framesDropped++;
+
+	if (slotIndex < m_slots.size() && m_slots[slotIndex].state == kSlotScheduled)
+	{
+		m_slots[slotIndex].state = kSlotFree;
+		m_completed++;
+	}
+
+	if (m_completed >= m_endPosition)
+		m_finished = true;
+
+	pthread_cond_broadcast(&m_condition);
+	pthread_mutex_unlock(&m_mutex);
+
+	return S_OK;
+}
+
+HRESULT RawPlayer::ScheduledPlaybackHasStopped(void)
+{
+	pthread_mutex_lock(&m_mutex);
+	m_finished = true;
+	pthread_cond_broadcast(&m_condition);
+	pthread_mutex_unlock(&m_mutex);
+
+	return S_OK;
+}
+
+void* RawPlayer::ReaderThread(void* context)
+{
+	static_cast<RawPlayer*>(context)->ReaderLoop();
+	return NULL;
+}
+
+void RawPlayer::ReaderLoop(void)
+{
+	uint64_t	userData;
+	int			result;
+
+	while (true)
+	{
+		pthread_mutex_lock(&m_mutex);
+
+		if (m_stopping)
+		{
+			pthread_mutex_unlock(&m_mutex);
+			break;
+		}
+
+		// Claim free slots for the next frames, in playback order
+		m_startReads.clear();
+		while (m_nextRead < m_endPosition && m_slots[m_nextRead % m_slots.size()].state == kSlotFree)
+		{
+			uint32_t slotIndex = (uint32_t)(m_nextRead % m_slots.size());
+
+			m_slots[slotIndex].state	= kSlotReading;
+			m_slots[slotIndex].position	= m_nextRead++;
+			m_startReads.push_back(slotIndex);
+		}
+
+		if (m_startReads.empty() && m_uring->GetInFlight() == 0)
+		{
+			// The window is full, wait for a frame to complete
+			pthread_cond_wait(&m_condition, &m_mutex);
+			pthread_mutex_unlock(&m_mutex);
+			continue;
+		}
+
+		pthread_mutex_unlock(&m_mutex);
+
+		for (uint32_t slotIndex : m_startReads)
+			StartRead(slotIndex);
+
+		if (!m_uring->Submit())
+		{
+			pthread_mutex_lock(&m_mutex);
+			m_finished = true;
+			pthread_cond_broadcast(&m_condition);
+			pthread_mutex_unlock(&m_mutex);
+			break;
+		}
+
+		// Wait for one read, then take any others that have finished
+		if (m_uring->Reap(userData, result, true))
+		{
+			do
+			{
+				CompleteRead((uint32_t)userData, result);
+			} while (m_uring->Reap(userData, result, false));
+		}
+
+		ScheduleReadyFrames();
+	}
+
+	// Reads still in flight target the ring, which must outlive them
+	while (m_uring->Reap(userData, result, true))
+		;
+}
+
+bool RawPlayer::Cue(void)
+{
+	uint64_t prerollFrames = std::min((uint64_t)m_slots.size(), m_endPosition);
+
+	if (m_threadStarted || m_slots.empty())
+		return false;
+
+	if (m_deckLinkOutput->SetScheduledFrameCompletionCallback(this) != S_OK)
+	{
+		fprintf(stderr, "Unable to set the frame completion callback\n");
+		return false;
+	}
+
+	if (m_format.audioChannels > 0)
+		m_deckLinkOutput->BeginAudioPreroll();
+
+	if (pthread_create(&m_thread, NULL, ReaderThread, this) != 0)
+	{
+		fprintf(stderr, "Unable to start the reader thread\n");
+		return false;
+	}
+	m_threadStarted = true;
+
+	// Preroll the whole read-ahead window
+	pthread_mutex_lock(&m_mutex);
+	while (m_nextSchedule < prerollFrames && !m_finished)
+		pthread_cond_wait(&m_condition, &m_mutex);
+	pthread_mutex_unlock(&m_mutex);
+
+	return true;
+}
+
+bool RawPlayer::Play(void)
+{
+	if (!m_threadStarted && !Cue())
+		return false;
+
+	if (m_format.audioChannels > 0)
+		m_deckLinkOutput->EndAudioPreroll();
+
+	if (m_deckLinkOutput->StartScheduledPlayback(0, m_format.timeScale, 1.0) != S_OK)
+	{
+		fprintf(stderr, "Unable to start scheduled playback\n");
+		return false;
+	}
+
+	pthread_mutex_lock(&m_mutex);
+	m_playing = true;
+	pthread_mutex_unlock(&m_mutex);
+
+	return true;
+}
+
+void RawPlayer::Stop(void)
+{
+	if (!m_threadStarted)
+		return;
+
+	pthread_mutex_lock(&m_mutex);
+	m_stopping = true;
+	pthread_cond_broadcast(&m_condition);
+	pthread_mutex_unlock(&m_mutex);
+
+	pthread_join(m_thread, NULL);
+	m_threadStarted = false;
+
+	if (m_playing)
+		m_deckLinkOutput->StopScheduledPlayback(0, NULL, 0);
+	m_playing = false;
+
+	m_deckLinkOutput->SetScheduledFrameCompletionCallback(NULL);
+}
+
+bool RawPlayer::IsFinished(void)
+{
+	bool finished;
+
+	pthread_mutex_lock(&m_mutex);
+	finished = m_finished;
+	pthread_mutex_unlock(&m_mutex);
+
+	return finished;
+}
+
+void RawPlayer::GetStatistics(RawPlayerStatistics& statistics)
+{
+	pthread_mutex_lock(&m_mutex);
+
+	statistics = m_statistics;
+	statistics.bufferedFrames			= (uint32_t)(m_nextSchedule - m_completed);
+	statistics.lowestMarginMilliseconds	= (m_lowestMargin == INT64_MAX) ? 0.0 : m_lowestMargin * 1000.0 / m_format.timeScale;
+	statistics.recentMarginMilliseconds	= (m_recentMargin == INT64_MAX) ? 0.0 : m_recentMargin * 1000.0 / m_format.timeScale;
+	statistics.maximumReadMilliseconds	= m_maximumReadNanoseconds / 1e6;
+	m_recentMargin = INT64_MAX;
+
+	pthread_mutex_unlock(&m_mutex);
+}
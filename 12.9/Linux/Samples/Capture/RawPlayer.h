@@ -0,0 +1,177 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __RAW_PLAYER_H__
+#define __RAW_PLAYER_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <vector>
+
+#include "DeckLinkAPI.h"
+#include "RawContainer.h"
+#include "UringReader.h"
+
+class SliceCompressor;
+class FrameChecksum;
+
+struct RawPlayerStatistics
+{
+	uint64_t	framesScheduled;
+	uint64_t	framesRepeated;				// Missing from the recording, the previous frame was played
+	uint64_t	framesSkipped;				// Could not be read or decoded
+	uint64_t	framesLate;					// Completed as displayed late
+	uint64_t	framesDropped;				// Completed as dropped
+	uint64_t	underruns;					// Read completed after the frame was due on the wire
+	uint64_t	bytesRead;
+	uint32_t	bufferedFrames;				// Read ahead of the frame on the wire
+	double		lowestMarginMilliseconds;	// Least time a frame was scheduled ahead of output
+	double		recentMarginMilliseconds;	// The same, since the previous call
+	double		maximumReadMilliseconds;	// Longest time to read one record
+};
+
+// Plays a recording made by Capture -o through scheduled playback.
+//
+// Records are read with O_DIRECT, when the file system supports it, straight into a
+// ring of page aligned output frames through io_uring, so the only copy made of an
+// uncompressed frame is the device DMA.  The ring is kept full, a read-ahead window of
+// frames ahead of the frame on the wire, and each frame is scheduled as soon as its
+// read completes.  How far ahead of its output time each frame was scheduled is the
+// disk underrun margin.
+class RawPlayer : public IDeckLinkVideoOutputCallback
+{
+public:
+	// Compressed recordings are decompressed with decompressThreads workers.  Frames are
+	// verified against their checksums when checksum is set.
+	RawPlayer(IDeckLinkOutput* deckLinkOutput, RawContainerReader* reader, int decompressThreads, FrameChecksum* checksum);
+	virtual ~RawPlayer();
+
+	// Plays frames inFrame to outFrame inclusive, returning to inFrame at the end when
+	// looping.  The first record sets the format of the clip.
+	bool		Open(uint64_t inFrame, uint64_t outFrame, bool loop, int readAheadFrames);
+	const RawFrameHeader&	GetFormat(void) const { return m_format; }
+
+	// Fills the read-ahead window and prerolls from the in point, so Play() starts
+	// output on exactly the in frame.  Output must be enabled first.
+	bool		Cue(void);
+	bool		Play(void);
+	void		Stop(void);
+	bool		IsFinished(void);
+
+	void		GetStatistics(RawPlayerStatistics& statistics);
+
+	// IDeckLinkVideoOutputCallback interface
+	virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) { return E_NOINTERFACE; }
+	virtual ULONG STDMETHODCALLTYPE AddRef(void);
+	virtual ULONG STDMETHODCALLTYPE Release(void);
+	virtual HRESULT STDMETHODCALLTYPE ScheduledFrameCompleted(IDeckLinkVideoFrame* completedFrame, BMDOutputFrameCompletionResult result);
+	virtual HRESULT STDMETHODCALLTYPE ScheduledPlaybackHasStopped(void);
+
+private:
+	class Frame;
+
+	enum SlotState
+	{
+		kSlotFree,
+		kSlotReading,
+		kSlotReady,
+		kSlotSkipped,
+		kSlotScheduled,
+	};
+
+	struct Slot
+	{
+		SlotState			state;
+		uint64_t			position;			// Playback position, counting through loops
+		uint64_t			frameNumber;
+		RawFrameLocation	location;
+		uint64_t			bytesRead;
+		uint64_t			readStartTime;
+		uint8_t*			record;
+		uint8_t*			video;				// Decompressed video, for compressed records
+		Frame*				frame;
+	};
+
+	bool		FindSourceFrame(uint64_t position, uint64_t& frameNumber, RawFrameLocation& location);
+	void		StartRead(uint32_t slotIndex);
+	void		CompleteRead(uint32_t slotIndex, int result);
+	void		ScheduleReadyFrames(void);
+	void		FreeSlots(void);
+
+	static void*	ReaderThread(void* context);
+	void			ReaderLoop(void);
+
+	int32_t						m_refCount;
+	IDeckLinkOutput*			m_deckLinkOutput;
+	RawContainerReader*			m_reader;
+	int							m_decompressThreads;
+	SliceCompressor*			m_decompressor;
+	FrameChecksum*				m_checksum;
+	UringReader*				m_uring;
+
+	RawFrameHeader				m_format;
+	uint64_t					m_inFrame;
+	uint64_t					m_clipLength;
+	bool						m_loop;
+	uint64_t					m_endPosition;			// UINT64_MAX when looping
+	uint64_t					m_recordCapacity;
+	uint64_t					m_readSize;				// Largest record seen, read in one request
+	std::vector<Slot>			m_slots;
+	std::vector<uint32_t>		m_startReads;
+
+	pthread_mutex_t				m_mutex;
+	pthread_cond_t				m_condition;
+	pthread_t					m_thread;
+	bool						m_threadStarted;
+	bool						m_stopping;
+	bool						m_playing;
+	bool						m_finished;
+	uint64_t					m_nextRead;
+	uint64_t					m_nextSchedule;
+	uint64_t					m_completed;
+	uint64_t					m_lastFrameNumber;
+
+	RawPlayerStatistics			m_statistics;
+	int64_t						m_lowestMargin;
+	int64_t						m_recentMargin;
+	uint64_t					m_maximumReadNanoseconds;
+};
+
+#endif
@@ -0,0 +1,225 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "SharedFrameClient.h"
+
+SharedFrameClient::SharedFrameClient() :
+	m_fileDescriptor(-1),
+	m_region(NULL),
+	m_regionSize(0),
+	m_header(NULL),
+	m_nextSequence(0),
+	m_framesSkipped(0)
+{
+}
+
+SharedFrameClient::~SharedFrameClient()
+{
+	Close();
+}
+
+bool SharedFrameClient::Open(const char* name)
+{
+	struct stat status;
+
+	Close();
+
+	m_fileDescriptor = shm_open(name, O_RDWR, 0);
+	if (m_fileDescriptor < 0)
+	{
+		fprintf(stderr, "Could not open shared frame ring \"%s\": %s\n", name, strerror(errno));
+		return false;
+	}
+
+	if (fstat(m_fileDescriptor, &status) != 0 || (size_t)status.st_size < sizeof(SharedFrameRingHeader))
+		goto bail;
+
+	m_regionSize	= status.st_size;
+	m_region		= (uint8_t*)mmap(NULL, m_regionSize, PROT_READ|PROT_WRITE, MAP_SHARED, m_fileDescriptor, 0);
+	if (m_region == MAP_FAILED)
+	{
+		m_region = NULL;
+		goto bail;
+	}
+
+	m_header = (SharedFrameRingHeader*)m_region;
+	if (m_header->magic != kSharedFrameRingMagic || m_header->version != kSharedFrameRingVersion ||
+		m_header->regionSize != m_regionSize || m_header->slotCount == 0 || m_header->slotCount > kSharedFrameMaxSlots ||
+		m_header->dataOffset + m_header->slotCount * m_header->slotSize > m_regionSize)
+	{
+		fprintf(stderr, "\"%s\" is not a compatible shared frame ring\n", name);
+		goto bail;
+	}
+
+	m_nextSequence	= 0;
+	m_framesSkipped	= 0;
+	return true;
+
+bail:
+	Close();
+	return false;
+}
+
+void SharedFrameClient::Close()
+{
+	if (m_region != NULL)
+		munmap(m_region, m_regionSize);
+
+	if (m_fileDescriptor >= 0)
+		close(m_fileDescriptor);
+
+	m_region			= NULL;
+	m_header			= NULL;
+	m_fileDescriptor	= -1;
+}
+
+bool SharedFrameClient::IsPublisherClosed() const
+{
+	return m_header == NULL || m_header->state.load() != kSharedFrameRingActive;
+}
+
+bool SharedFrameClient::TryAcquire(uint64_t sequence, SharedFrame& frame)
+{
+	uint64_t	entry = m_header->entries[sequence % m_header->slotCount].load();
+	uint32_t	slotIndex = (uint32_t)(entry & 0xFF);
+
+	if ((entry >> 8) != sequence || slotIndex >= m_header->slotCount)
+		return false;
+
+	SharedFrameSlot& slot = m_header->slots[slotIndex];
+
+	// Take the reference before checking the sequence, see SharedFrameRing.h
+	slot.readers.fetch_add(1);
+	if (slot.sequence.load() != sequence)
+	{
+		slot.readers.fetch_sub(1);
+		return false;
+	}
+
+	frame.metadata		= &slot.metadata;
+	frame.bytes			= m_region + m_header->dataOffset + slotIndex * m_header->slotSize;
+	frame.rightEyeBytes	= NULL;
+	frame.sequence		= sequence;
+	frame.slot			= slotIndex;
+
+	if (slot.metadata.rightEyeOffset != 0 && slot.metadata.rightEyeOffset + m_header->slotSize <= m_regionSize)
+		frame.rightEyeBytes = m_region + slot.metadata.rightEyeOffset;
+
+	return true;
+}
+
+bool SharedFrameClient::WaitForPublish(uint32_t publishCount, int timeoutMilliseconds)
+{
+	struct timespec	timeout;
+	long			result = 0;
+
+	timeout.tv_sec	= timeoutMilliseconds / 1000;
+	timeout.tv_nsec	= (timeoutMilliseconds % 1000) * 1000000L;
+
+	// Registering first means the publisher either sees a waiter or published before
+	// publishCount is read here
+	m_header->waiters.fetch_add(1);
+	if (m_header->publishCount.load() == publishCount)
+		result = syscall(SYS_futex, (uint32_t*)&m_header->publishCount, FUTEX_WAIT, publishCount, &timeout, NULL, 0);
+	m_header->waiters.fetch_sub(1);
+
+	return !(result != 0 && errno == ETIMEDOUT);
+}
+
+bool SharedFrameClient::AcquireNextFrame(SharedFrame& frame, int timeoutMilliseconds)
+{
+	struct timespec	start;
+	struct timespec	now;
+
+	if (m_header == NULL)
+		return false;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while (!IsPublisherClosed())
+	{
+		uint32_t	publishCount = m_header->publishCount.load();
+		uint64_t	latest = m_header->writeSequence.load();
+
+		if (latest != 0 && (m_nextSequence == 0 || m_nextSequence > latest + 1))
+			m_nextSequence = latest;
+
+		if (latest != 0 && m_nextSequence <= latest)
+		{
+			if (TryAcquire(m_nextSequence, frame))
+			{
+				m_nextSequence++;
+				return true;
+			}
+
+			// Too far behind, the frame has been retired.  Jump to the newest frame.
+			m_framesSkipped	+= latest - m_nextSequence + (m_nextSequence == latest ? 1 : 0);
+			m_nextSequence	= (m_nextSequence == latest) ? latest + 1 : latest;
+			continue;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		int elapsed = (int)((now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000);
+		if (elapsed >= timeoutMilliseconds || !WaitForPublish(publishCount, timeoutMilliseconds - elapsed))
+			return false;
+	}
+
+	return false;
+}
+
+void SharedFrameClient::ReleaseFrame(SharedFrame& frame)
+{
+	if (m_header == NULL || frame.bytes == NULL)
+		return;
+
+	m_header->slots[frame.slot].readers.fetch_sub(1);
+	frame.bytes = NULL;
+}
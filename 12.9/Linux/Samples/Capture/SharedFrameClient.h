@@ -0,0 +1,91 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __SHARED_FRAME_CLIENT_H__
+#define __SHARED_FRAME_CLIENT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SharedFrameRing.h"
+
+struct SharedFrame
+{
+	const SharedFrameMetadata*	metadata;
+	const uint8_t*				bytes;
+	const uint8_t*				rightEyeBytes;		// NULL unless 3D
+	uint64_t					sequence;
+	uint32_t					slot;
+};
+
+// Reads frames published by Capture -P from another process.  Each acquired frame
+// holds a reference on its slot until it is released, and must be released promptly
+// since the capture device has a fixed number of buffers.  Not thread safe, use one
+// client per thread.
+class SharedFrameClient
+{
+public:
+	SharedFrameClient();
+	virtual ~SharedFrameClient();
+
+	bool		Open(const char* name);
+	void		Close(void);
+
+	// Waits for the next frame after the last one acquired, skipping ahead to the
+	// newest frame if the client has fallen behind.  Returns false on timeout or
+	// when the publisher has exited.
+	bool		AcquireNextFrame(SharedFrame& frame, int timeoutMilliseconds);
+	void		ReleaseFrame(SharedFrame& frame);
+
+	bool		IsPublisherClosed(void) const;
+	uint64_t	GetFramesSkipped(void) const { return m_framesSkipped; }
+
+private:
+	bool		TryAcquire(uint64_t sequence, SharedFrame& frame);
+	bool		WaitForPublish(uint32_t publishCount, int timeoutMilliseconds);
+
+	int							m_fileDescriptor;
+	uint8_t*					m_region;
+	size_t						m_regionSize;
+	SharedFrameRingHeader*		m_header;
+	uint64_t					m_nextSequence;
+	uint64_t					m_framesSkipped;
+};
+
+#endif
@@ -0,0 +1,106 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+// Example client for frames published with Capture -P.  Prints each frame it
+// receives, and how many it missed because it fell behind.
+
+#include <csignal>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "DeckLinkAPI.h"
+#include "SharedFrameClient.h"
+
+static volatile sig_atomic_t	g_do_exit = 0;
+
+static void sigfunc(int signum)
+{
+	g_do_exit = 1;
+}
+
+int main(int argc, char *argv[])
+{
+	SharedFrameClient	client;
+	SharedFrame			frame;
+	uint64_t			framesReceived = 0;
+
+	if (argc != 2)
+	{
+		fprintf(stderr, "Usage: SharedFrameMonitor <name>\n\n"
+			"    <name> is the shared memory object given to Capture -P\n");
+		return 1;
+	}
+
+	signal(SIGINT, sigfunc);
+	signal(SIGTERM, sigfunc);
+
+	if (!client.Open(argv[1]))
+		return 1;
+
+	while (!g_do_exit && !client.IsPublisherClosed())
+	{
+		if (!client.AcquireNextFrame(frame, 1000))
+			continue;
+
+		const SharedFrameMetadata* metadata = frame.metadata;
+		char timecode[16] = "No timecode";
+
+		if (metadata->flags & kSharedFrameHasTimecode)
+		{
+			snprintf(timecode, sizeof(timecode), "%02x:%02x:%02x%c%02x",
+				(metadata->timecodeBCD >> 24) & 0xFF, (metadata->timecodeBCD >> 16) & 0xFF, (metadata->timecodeBCD >> 8) & 0xFF,
+				(metadata->timecodeFlags & bmdTimecodeIsDropFrame) ? ';' : ':', metadata->timecodeBCD & 0xFF);
+		}
+
+		printf("Frame %llu [%s] - %ux%u %c%c%c%c, %u bytes per row, stream time %lld/%lld%s%s\n",
+			(unsigned long long)frame.sequence, timecode,
+			metadata->width, metadata->height,
+			(char)(metadata->pixelFormat >> 24), (char)(metadata->pixelFormat >> 16), (char)(metadata->pixelFormat >> 8), (char)metadata->pixelFormat,
+			metadata->rowBytes, (long long)metadata->streamTime, (long long)metadata->timeScale,
+			frame.rightEyeBytes ? " 3D" : "",
+			(metadata->flags & kSharedFrameHasHDRMetadata) ? " HDR" : "");
+
+		client.ReleaseFrame(frame);
+		framesReceived++;
+	}
+
+	printf("%llu frames received, %llu skipped\n", (unsigned long long)framesReceived, (unsigned long long)client.GetFramesSkipped());
+	return 0;
+}
@@ -0,0 +1,142 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __SHARED_FRAME_RING_H__
+#define __SHARED_FRAME_RING_H__
+
+#include <atomic>
+#include <stdint.h>
+
+// Layout of the POSIX shared memory region that a capture input publishes its frames
+// in.  The region is a SharedFrameRingHeader followed by slotCount frame buffers of
+// slotSize bytes.  The DeckLink driver captures straight into the buffers, so frames
+// are never copied.
+//
+// A published frame has its slot's sequence set.  Readers increment the slot's reader
+// count and then check that the sequence is still the one they looked up; the
+// publisher clears the sequence and then checks the reader count before letting the
+// driver reuse the buffer.  Both sides use sequentially consistent operations, so a
+// buffer is never recaptured while a reader holds it.
+
+static const uint32_t	kSharedFrameRingMagic		= 0x444C5352;	// 'DLSR'
+static const uint32_t	kSharedFrameRingVersion		= 1;
+static const uint32_t	kSharedFrameMaxSlots		= 64;
+static const uint32_t	kSharedFrameAlignment		= 4096;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "Shared memory atomics must be lock free");
+
+enum SharedFrameRingState : uint32_t
+{
+	kSharedFrameRingActive		= 1,
+	kSharedFrameRingClosed		= 2,		// The publisher has exited
+};
+
+enum SharedFrameFlags : uint32_t
+{
+	kSharedFrameHasTimecode		= (1 << 0),
+	kSharedFrameHasHDRMetadata	= (1 << 1),
+};
+
+struct SharedFrameMetadata
+{
+	int64_t		streamTime;
+	int64_t		frameDuration;
+	int64_t		timeScale;
+	uint32_t	timecodeBCD;				// BMDTimecodeBCD
+	uint32_t	timecodeFlags;				// BMDTimecodeFlags
+	uint32_t	pixelFormat;
+	uint32_t	width;
+	uint32_t	height;
+	uint32_t	rowBytes;
+	uint32_t	frameFlags;					// BMDFrameFlags
+	uint32_t	flags;						// SharedFrameFlags
+	uint64_t	rightEyeOffset;				// Region offset of the right eye for 3D, 0 otherwise
+
+	// HDR static metadata, valid with kSharedFrameHasHDRMetadata
+	int64_t		colorspace;					// BMDColorspace
+	int64_t		electroOpticalTransferFunc;
+	double		displayPrimariesRedX;
+	double		displayPrimariesRedY;
+	double		displayPrimariesGreenX;
+	double		displayPrimariesGreenY;
+	double		displayPrimariesBlueX;
+	double		displayPrimariesBlueY;
+	double		whitePointX;
+	double		whitePointY;
+	double		maxDisplayMasteringLuminance;
+	double		minDisplayMasteringLuminance;
+	double		maxContentLightLevel;
+	double		maxFrameAverageLightLevel;
+};
+
+struct alignas(64) SharedFrameSlot
+{
+	std::atomic<uint64_t>	sequence;		// Sequence of the published frame, 0 when not readable
+	std::atomic<uint32_t>	readers;
+	uint32_t				reserved;
+	SharedFrameMetadata		metadata;
+};
+
+struct SharedFrameRingHeader
+{
+	uint32_t				magic;
+	uint32_t				version;
+	std::atomic<uint32_t>	state;			// SharedFrameRingState
+	uint32_t				slotCount;
+	uint64_t				slotSize;
+	uint64_t				dataOffset;		// Region offset of the first slot's buffer
+	uint64_t				regionSize;
+	int32_t					publisherPid;
+	std::atomic<uint32_t>	waiters;		// Clients blocked on publishCount
+	std::atomic<uint32_t>	publishCount;	// Futex word, incremented on every publish
+	uint32_t				reserved;
+	std::atomic<uint64_t>	writeSequence;	// Last published sequence, sequences start at 1
+
+	// Published sequences by sequence % slotCount, as (sequence << 8) | slot
+	std::atomic<uint64_t>	entries[kSharedFrameMaxSlots];
+	SharedFrameSlot			slots[kSharedFrameMaxSlots];
+};
+
+inline uint64_t SharedFrameRingDataOffset(void)
+{
+	return (sizeof(SharedFrameRingHeader) + kSharedFrameAlignment - 1) & ~(uint64_t)(kSharedFrameAlignment - 1);
+}
+
+#endif
@@ -0,0 +1,530 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+
+#include "SliceCompressor.h"
+
+#define kLZ4Library_Name	"liblz4.so.1"
+#define kZstdLibrary_Name	"libzstd.so.1"
+
+// Only the few entry points used here are declared, so no compression headers are needed
+typedef int			(*LZ4CompressFastFunc)(const char* source, char* destination, int sourceSize, int capacity, int acceleration);
+typedef int			(*LZ4DecompressSafeFunc)(const char* source, char* destination, int compressedSize, int capacity);
+typedef int			(*LZ4CompressBoundFunc)(int sourceSize);
+typedef size_t		(*ZstdCompressBoundFunc)(size_t sourceSize);
+typedef void*		(*ZstdCreateCCtxFunc)(void);
+typedef size_t		(*ZstdFreeCCtxFunc)(void* context);
+typedef size_t		(*ZstdCompressCCtxFunc)(void* context, void* destination, size_t capacity, const void* source, size_t sourceSize, int level);
+typedef size_t		(*ZstdDecompressFunc)(void* destination, size_t capacity, const void* source, size_t compressedSize);
+typedef unsigned	(*ZstdIsErrorFunc)(size_t code);
+
+static pthread_once_t			gLZ4OnceControl = PTHREAD_ONCE_INIT;
+static pthread_once_t			gZstdOnceControl = PTHREAD_ONCE_INIT;
+
+static bool						gLoadedLZ4 = false;
+static bool						gLoadedZstd = false;
+
+static LZ4CompressFastFunc		gLZ4CompressFastFunc = NULL;
+static LZ4DecompressSafeFunc	gLZ4DecompressSafeFunc = NULL;
+static LZ4CompressBoundFunc		gLZ4CompressBoundFunc = NULL;
+static ZstdCompressBoundFunc	gZstdCompressBoundFunc = NULL;
+static ZstdCreateCCtxFunc		gZstdCreateCCtxFunc = NULL;
+static ZstdFreeCCtxFunc			gZstdFreeCCtxFunc = NULL;
+static ZstdCompressCCtxFunc		gZstdCompressCCtxFunc = NULL;
+static ZstdDecompressFunc		gZstdDecompressFunc = NULL;
+static ZstdIsErrorFunc			gZstdIsErrorFunc = NULL;
+
+static void* LoadSymbol(void* libraryHandle, const char* name)
+{
+	void* symbol = dlsym(libraryHandle, name);
+	if (!symbol)
+		fprintf(stderr, "%s\n", dlerror());
+	return symbol;
+}
+
+static void InitLZ4(void)
+{
+	void* libraryHandle = dlopen(kLZ4Library_Name, RTLD_NOW|RTLD_LOCAL);
+	if (!libraryHandle)
+	{
+		fprintf(stderr, "%s\n", dlerror());
+		return;
+	}
+
+	gLZ4CompressFastFunc	= (LZ4CompressFastFunc)LoadSymbol(libraryHandle, "LZ4_compress_fast");
+	gLZ4DecompressSafeFunc	= (LZ4DecompressSafeFunc)LoadSymbol(libraryHandle, "LZ4_decompress_safe");
+	gLZ4CompressBoundFunc	= (LZ4CompressBoundFunc)LoadSymbol(libraryHandle, "LZ4_compressBound");
+
+	gLoadedLZ4 = gLZ4CompressFastFunc && gLZ4DecompressSafeFunc && gLZ4CompressBoundFunc;
+}
+
+static void InitZstd(void)
+{
+	void* libraryHandle = dlopen(kZstdLibrary_Name, RTLD_NOW|RTLD_LOCAL);
+	if (!libraryHandle)
+	{
+		fprintf(stderr, "%s\n", dlerror());
+		return;
+	}
+
+	gZstdCompressBoundFunc	= (ZstdCompressBoundFunc)LoadSymbol(libraryHandle, "ZSTD_compressBound");
+	gZstdCreateCCtxFunc		= (ZstdCreateCCtxFunc)LoadSymbol(libraryHandle, "ZSTD_createCCtx");
+	gZstdFreeCCtxFunc		= (ZstdFreeCCtxFunc)LoadSymbol(libraryHandle, "ZSTD_freeCCtx");
+	gZstdCompressCCtxFunc	= (ZstdCompressCCtxFunc)LoadSymbol(libraryHandle, "ZSTD_compressCCtx");
+	gZstdDecompressFunc		= (ZstdDecompressFunc)LoadSymbol(libraryHandle, "ZSTD_decompress");
+	gZstdIsErrorFunc		= (ZstdIsErrorFunc)LoadSymbol(libraryHandle, "ZSTD_isError");
+
+	gLoadedZstd = gZstdCompressBoundFunc && gZstdCreateCCtxFunc && gZstdFreeCCtxFunc &&
+				  gZstdCompressCCtxFunc && gZstdDecompressFunc && gZstdIsErrorFunc;
+}
+
+static uint64_t GetNanoseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// One frame's slices.  Slices are claimed by any thread working on the batch; the
+// submitter waits until every slice is done and no worker still refers to it.
+struct SliceCompressor::Batch
+{
+	bool				decompress;
+	int					count;
+	const uint8_t*		source[kRawMaxSlices];
+	size_t				sourceSize[kRawMaxSlices];
+	uint8_t*			destination[kRawMaxSlices];
+	size_t				capacity[kRawMaxSlices];
+	bool				stored[kRawMaxSlices];		// Decompress: copy, the slice is not compressed
+	size_t				result[kRawMaxSlices];		// Output size, 0 on failure
+	std::atomic<int>	next;
+	int					completed;					// Protected by m_mutex
+	int					users;						// Protected by m_mutex
+};
+
+SliceCompressor::SliceCompressor(RawCompression compression, int level, int threadCount) :
+	m_compression(compression),
+	m_level(level),
+	m_threadCount(std::max(threadCount, 1)),
+	m_stopping(false),
+	m_framesCompressed(0),
+	m_inputBytes(0),
+	m_outputBytes(0),
+	m_busyNanoseconds(0)
+{
+	pthread_mutex_init(&m_mutex, NULL);
+	pthread_cond_init(&m_workCondition, NULL);
+	pthread_cond_init(&m_doneCondition, NULL);
+}
+
+SliceCompressor::~SliceCompressor()
+{
+	Stop();
+
+	for (void* context : m_contexts)
+		gZstdFreeCCtxFunc(context);
+
+	pthread_cond_destroy(&m_doneCondition);
+	pthread_cond_destroy(&m_workCondition);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+const char* SliceCompressor::GetCompressionName(RawCompression compression)
+{
+	switch (compression)
+	{
+		case kRawCompressionLZ4:
+			return "LZ4";
+		case kRawCompressionZstd:
+			return "zstd";
+		default:
+			return "none";
+	}
+}
+
+bool SliceCompressor::Start()
+{
+	if (m_compression == kRawCompressionLZ4)
+	{
+		pthread_once(&gLZ4OnceControl, InitLZ4);
+		if (!gLoadedLZ4)
+			return false;
+	}
+	else if (m_compression == kRawCompressionZstd)
+	{
+		pthread_once(&gZstdOnceControl, InitZstd);
+		if (!gLoadedZstd)
+			return false;
+	}
+	else
+		return false;
+
+	m_stopping = false;
+
+	// The submitting writer thread also works on its own frame
+	for (int i = 1; i < m_threadCount; i++)
+	{
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, WorkerThread, this) != 0)
+			break;
+		m_threads.push_back(thread);
+	}
+
+	return true;
+}
+
+void SliceCompressor::Stop()
+{
+	pthread_mutex_lock(&m_mutex);
+	m_stopping = true;
+	pthread_cond_broadcast(&m_workCondition);
+	pthread_mutex_unlock(&m_mutex);
+
+	for (pthread_t thread : m_threads)
+		pthread_join(thread, NULL);
+
+	m_threads.clear();
+}
+
+void SliceCompressor::GetStatistics(SliceCompressorStatistics& statistics) const
+{
+	statistics.framesCompressed	= m_framesCompressed;
+	statistics.inputBytes		= m_inputBytes;
+	statistics.outputBytes		= m_outputBytes;
+	statistics.busyNanoseconds	= m_busyNanoseconds;
+}
+
+void SliceCompressor::GetSliceLayout(size_t videoSize, uint32_t rowBytes, uint32_t& sliceCount, uint32_t& sliceRows) const
+{
+	size_t rows = videoSize / rowBytes;
+
+	// A few slices per thread keeps the threads busy when slices compress at different speeds
+	sliceCount	= (uint32_t)std::min<size_t>(std::min<size_t>(kRawMaxSlices, m_threadCount * 4), rows);
+	sliceRows	= (uint32_t)((rows + sliceCount - 1) / sliceCount);
+	sliceCount	= (uint32_t)((rows + sliceRows - 1) / sliceRows);
+}
+
+size_t SliceCompressor::SliceBound(size_t sliceSize) const
+{
+	if (m_compression == kRawCompressionLZ4)
+		return gLZ4CompressBoundFunc((int)sliceSize);
+	else
+		return gZstdCompressBoundFunc(sliceSize);
+}
+
+size_t SliceCompressor::MaxStoredSize(size_t videoSize, uint32_t rowBytes) const
+{
+	uint32_t sliceCount;
+	uint32_t sliceRows;
+
+	if (rowBytes == 0 || videoSize == 0 || videoSize % rowBytes != 0)
+		return videoSize;
+
+	GetSliceLayout(videoSize, rowBytes, sliceCount, sliceRows);
+	return sliceCount * std::max(SliceBound((size_t)sliceRows * rowBytes), (size_t)sliceRows * rowBytes);
+}
+
+void* SliceCompressor::AcquireContext()
+{
+	void* context = NULL;
+
+	pthread_mutex_lock(&m_mutex);
+	if (!m_contexts.empty())
+	{
+		context = m_contexts.back();
+		m_contexts.pop_back();
+	}
+	pthread_mutex_unlock(&m_mutex);
+
+	// Bounded by the number of threads that can work at once
+	if (context == NULL)
+		context = gZstdCreateCCtxFunc();
+
+	return context;
+}
+
+void SliceCompressor::ReleaseContext(void* context)
+{
+	pthread_mutex_lock(&m_mutex);
+	m_contexts.push_back(context);
+	pthread_mutex_unlock(&m_mutex);
+}
+
+void SliceCompressor::ProcessBatch(Batch& batch)
+{
+	void*	context = NULL;
+	int		processed = 0;
+	int		slice;
+
+	while ((slice = batch.next++) < batch.count)
+	{
+		const char*	source		= (const char*)batch.source[slice];
+		char*		destination	= (char*)batch.destination[slice];
+		size_t		sourceSize	= batch.sourceSize[slice];
+		size_t		capacity	= batch.capacity[slice];
+		size_t		result		= 0;
+
+		if (batch.decompress && batch.stored[slice])
+		{
+			if (sourceSize == capacity)
+			{
+				memcpy(destination, source, sourceSize);
+				result = sourceSize;
+			}
+		}
+		else if (m_compression == kRawCompressionLZ4)
+		{
+			int size;
+			if (batch.decompress)
+				size = gLZ4DecompressSafeFunc(source, destination, (int)sourceSize, (int)capacity);
+			else
+				size = gLZ4CompressFastFunc(source, destination, (int)sourceSize, (int)capacity, m_level);
+			result = (size > 0) ? size : 0;
+		}
+		else
+		{
+			size_t size;
+			if (batch.decompress)
+			{
+				size = gZstdDecompressFunc(destination, capacity, source, sourceSize);
+			}
+			else
+			{
+				if (context == NULL)
+					context = AcquireContext();
+				size = gZstdCompressCCtxFunc(context, destination, capacity, source, sourceSize, m_level);
+			}
+			result = gZstdIsErrorFunc(size) ? 0 : size;
+		}
+
+		batch.result[slice] = result;
+		processed++;
+	}
+
+	if (context != NULL)
+		ReleaseContext(context);
+
+	if (processed > 0)
+	{
+		pthread_mutex_lock(&m_mutex);
+		batch.completed += processed;
+		if (batch.completed == batch.count)
+			pthread_cond_broadcast(&m_doneCondition);
+		pthread_mutex_unlock(&m_mutex);
+	}
+}
+
+void SliceCompressor::RunBatch(Batch& batch)
+{
+	batch.next		= 0;
+	batch.completed	= 0;
+	batch.users		= 0;
+
+	if (batch.count > 1 && !m_threads.empty())
+	{
+		pthread_mutex_lock(&m_mutex);
+		m_batches.push_back(&batch);
+		pthread_cond_broadcast(&m_workCondition);
+		pthread_mutex_unlock(&m_mutex);
+	}
+
+	ProcessBatch(batch);
+
+	pthread_mutex_lock(&m_mutex);
+	while (batch.completed < batch.count || batch.users > 0)
+		pthread_cond_wait(&m_doneCondition, &m_mutex);
+
+	auto queued = std::find(m_batches.begin(), m_batches.end(), &batch);
+	if (queued != m_batches.end())
+		m_batches.erase(queued);
+	pthread_mutex_unlock(&m_mutex);
+}
+
+void* SliceCompressor::WorkerThread(void* context)
+{
+	static_cast<SliceCompressor*>(context)->WorkerLoop();
+	return NULL;
+}
+
+void SliceCompressor::WorkerLoop()
+{
+	pthread_mutex_lock(&m_mutex);
+	while (!m_stopping)
+	{
+		if (m_batches.empty())
+		{
+			pthread_cond_wait(&m_workCondition, &m_mutex);
+			continue;
+		}
+
+		Batch* batch = m_batches.front();
+		if (batch->next >= batch->count)
+		{
+			// Every slice is claimed, the remaining work belongs to other threads
+			m_batches.pop_front();
+			continue;
+		}
+
+		batch->users++;
+		pthread_mutex_unlock(&m_mutex);
+
+		ProcessBatch(*batch);
+
+		pthread_mutex_lock(&m_mutex);
+		if (--batch->users == 0 && batch->completed == batch->count)
+			pthread_cond_broadcast(&m_doneCondition);
+	}
+	pthread_mutex_unlock(&m_mutex);
+}
+
+size_t SliceCompressor::CompressFrame(const uint8_t* video, size_t videoSize, uint32_t rowBytes, uint8_t* destination, size_t capacity, RawFrameHeader* header)
+{
+	Batch		batch;
+	uint32_t	sliceCount;
+	uint32_t	sliceRows;
+	uint32_t*	sliceSizes = RawSliceSizes(header);
+	size_t		sliceSize;
+	size_t		slotSize;
+	size_t		stored = 0;
+	uint64_t	startTime = GetNanoseconds();
+
+	if (rowBytes == 0 || videoSize == 0 || videoSize % rowBytes != 0 || capacity < MaxStoredSize(videoSize, rowBytes))
+		return 0;
+
+	GetSliceLayout(videoSize, rowBytes, sliceCount, sliceRows);
+	sliceSize	= (size_t)sliceRows * rowBytes;
+	slotSize	= std::max(SliceBound(sliceSize), sliceSize);
+
+	// Each slice compresses into its own worst case slot, then the slots are packed
+	batch.decompress	= false;
+	batch.count			= (int)sliceCount;
+	for (uint32_t i = 0; i < sliceCount; i++)
+	{
+		batch.source[i]			= video + i * sliceSize;
+		batch.sourceSize[i]		= std::min(sliceSize, videoSize - i * sliceSize);
+		batch.destination[i]	= destination + i * slotSize;
+		batch.capacity[i]		= slotSize;
+		batch.stored[i]			= false;
+	}
+
+	RunBatch(batch);
+
+	// Packing only moves data towards the start, never over a slot not yet packed
+	for (uint32_t i = 0; i < sliceCount; i++)
+	{
+		if (batch.result[i] == 0 || batch.result[i] >= batch.sourceSize[i])
+		{
+			memcpy(destination + stored, batch.source[i], batch.sourceSize[i]);
+			sliceSizes[i]	= (uint32_t)batch.sourceSize[i] | kRawSliceStored;
+			stored			+= batch.sourceSize[i];
+		}
+		else
+		{
+			memmove(destination + stored, batch.destination[i], batch.result[i]);
+			sliceSizes[i]	= (uint32_t)batch.result[i];
+			stored			+= batch.result[i];
+		}
+	}
+
+	if (stored >= videoSize)
+		return 0;
+
+	header->compression				= m_compression;
+	header->sliceCount				= sliceCount;
+	header->sliceRows				= sliceRows;
+	header->uncompressedVideoSize	= videoSize;
+	header->videoSize				= stored;
+
+	m_framesCompressed++;
+	m_inputBytes		+= videoSize;
+	m_outputBytes		+= stored;
+	m_busyNanoseconds	+= GetNanoseconds() - startTime;
+
+	return stored;
+}
+
+bool SliceCompressor::DecompressFrame(const RawFrameHeader* header, const uint8_t* payload, uint8_t* video)
+{
+	Batch			batch;
+	const uint32_t*	sliceSizes = RawSliceSizes(header);
+	size_t			sliceSize = (size_t)header->sliceRows * header->rowBytes;
+	size_t			offset = 0;
+
+	if (header->compression == kRawCompressionNone)
+	{
+		memcpy(video, payload, header->videoSize);
+		return true;
+	}
+
+	if (header->compression != m_compression || header->sliceCount == 0 || header->sliceCount > kRawMaxSlices ||
+		(uint64_t)header->sliceCount * sliceSize < header->uncompressedVideoSize ||
+		(uint64_t)(header->sliceCount - 1) * sliceSize >= header->uncompressedVideoSize)
+		return false;
+
+	batch.decompress	= true;
+	batch.count			= (int)header->sliceCount;
+	for (uint32_t i = 0; i < header->sliceCount; i++)
+	{
+		batch.source[i]			= payload + offset;
+		batch.sourceSize[i]		= sliceSizes[i] & ~kRawSliceStored;
+		batch.stored[i]			= (sliceSizes[i] & kRawSliceStored) != 0;
+		batch.destination[i]	= video + i * sliceSize;
+		batch.capacity[i]		= std::min<size_t>(sliceSize, header->uncompressedVideoSize - i * sliceSize);
+		offset					+= batch.sourceSize[i];
+	}
+
+	if (offset != header->videoSize)
+		return false;
+
+	RunBatch(batch);
+
+	for (uint32_t i = 0; i < header->sliceCount; i++)
+	{
+		if (batch.result[i] != batch.capacity[i])
+			return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,121 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __SLICE_COMPRESSOR_H__
+#define __SLICE_COMPRESSOR_H__
+
+#include <atomic>
+#include <deque>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "RawContainer.h"
+
+struct SliceCompressorStatistics
+{
+	uint64_t	framesCompressed;
+	uint64_t	inputBytes;
+	uint64_t	outputBytes;
+	uint64_t	busyNanoseconds;			// Wall time spent compressing frames
+};
+
+// Lossless compression of raw video in row slices, spread over a pool of worker
+// threads.  LZ4 and zstd are loaded at run time, so the sample builds and runs
+// without them.  Several writer threads may compress frames at the same time, and
+// the calling thread works on its own frame's slices while it waits.
+class SliceCompressor
+{
+public:
+	SliceCompressor(RawCompression compression, int level, int threadCount);
+	virtual ~SliceCompressor();
+
+	// Fails if the compression library can not be loaded
+	bool		Start(void);
+	void		Stop(void);
+
+	RawCompression	GetCompression(void) const { return m_compression; }
+	static const char*	GetCompressionName(RawCompression compression);
+
+	// Worst case stored size of a video payload, for sizing record buffers
+	size_t		MaxStoredSize(size_t videoSize, uint32_t rowBytes) const;
+
+	// Compresses video into destination and fills in the compression fields and
+	// slice sizes of header.  Returns the stored size, or 0 if it would not be
+	// smaller than the raw video.
+	size_t		CompressFrame(const uint8_t* video, size_t videoSize, uint32_t rowBytes, uint8_t* destination, size_t capacity, RawFrameHeader* header);
+
+	// Restores header->uncompressedVideoSize bytes of video from a stored payload
+	bool		DecompressFrame(const RawFrameHeader* header, const uint8_t* payload, uint8_t* video);
+
+	void		GetStatistics(SliceCompressorStatistics& statistics) const;
+
+private:
+	struct Batch;
+
+	void		GetSliceLayout(size_t videoSize, uint32_t rowBytes, uint32_t& sliceCount, uint32_t& sliceRows) const;
+	size_t		SliceBound(size_t sliceSize) const;
+	void		RunBatch(Batch& batch);
+	void		ProcessBatch(Batch& batch);
+	void*		AcquireContext(void);
+	void		ReleaseContext(void* context);
+
+	static void*	WorkerThread(void* context);
+	void			WorkerLoop(void);
+
+	RawCompression				m_compression;
+	int							m_level;
+	int							m_threadCount;
+
+	pthread_mutex_t				m_mutex;
+	pthread_cond_t				m_workCondition;
+	pthread_cond_t				m_doneCondition;
+	std::deque<Batch*>			m_batches;
+	std::vector<pthread_t>		m_threads;
+	std::vector<void*>			m_contexts;				// Idle zstd compression contexts
+	bool						m_stopping;
+
+	std::atomic<uint64_t>		m_framesCompressed;
+	std::atomic<uint64_t>		m_inputBytes;
+	std::atomic<uint64_t>		m_outputBytes;
+	std::atomic<uint64_t>		m_busyNanoseconds;
+};
+
+#endif
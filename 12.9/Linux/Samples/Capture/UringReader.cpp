@@ -0,0 +1,252 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "UringReader.h"
+
+UringReader::UringReader(unsigned queueDepth) :
+	m_queueDepth(queueDepth),
+	m_ringFileDescriptor(-1),
+	m_inFlight(0),
+	m_queued(0),
+	m_submissionRing(MAP_FAILED),
+	m_submissionRingSize(0),
+	m_completionRing(MAP_FAILED),
+	m_completionRingSize(0),
+	m_submissionEntries(MAP_FAILED),
+	m_submissionEntriesSize(0)
+{
+}
+
+UringReader::~UringReader()
+{
+	Close();
+}
+
+bool UringReader::Open()
+{
+	struct io_uring_params	params;
+	uint8_t*				submissionRing;
+	uint8_t*				completionRing;
+
+	memset(&params, 0, sizeof(params));
+
+	m_ringFileDescriptor = (int)syscall(__NR_io_uring_setup, m_queueDepth, &params);
+	if (m_ringFileDescriptor < 0)
+	{
+		fprintf(stderr, "io_uring is not available (%s), reading synchronously\n", strerror(errno));
+		return true;
+	}
+
+	m_submissionRingSize	= params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	m_completionRingSize	= params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	m_submissionEntriesSize	= params.sq_entries * sizeof(struct io_uring_sqe);
+
+	m_submissionRing = mmap(NULL, m_submissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFileDescriptor, IORING_OFF_SQ_RING);
+	m_completionRing = mmap(NULL, m_completionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFileDescriptor, IORING_OFF_CQ_RING);
+	m_submissionEntries = mmap(NULL, m_submissionEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFileDescriptor, IORING_OFF_SQES);
+
+	if (m_submissionRing == MAP_FAILED || m_completionRing == MAP_FAILED || m_submissionEntries == MAP_FAILED)
+	{
+		fprintf(stderr, "Unable to map io_uring queues - %s\n", strerror(errno));
+		Close();
+		return false;
+	}
+
+	submissionRing = (uint8_t*)m_submissionRing;
+	completionRing = (uint8_t*)m_completionRing;
+
+	m_submissionHead	= (unsigned*)(submissionRing + params.sq_off.head);
+	m_submissionTail	= (unsigned*)(submissionRing + params.sq_off.tail);
+	m_submissionMask	= (unsigned*)(submissionRing + params.sq_off.ring_mask);
+	m_submissionArray	= (unsigned*)(submissionRing + params.sq_off.array);
+	m_completionHead	= (unsigned*)(completionRing + params.cq_off.head);
+	m_completionTail	= (unsigned*)(completionRing + params.cq_off.tail);
+	m_completionMask	= (unsigned*)(completionRing + params.cq_off.ring_mask);
+	m_completionEntries	= completionRing + params.cq_off.cqes;
+
+	// The queue depth may have been rounded up by the kernel
+	m_queueDepth = params.sq_entries;
+	return true;
+}
+
+void UringReader::Close()
+{
+	if (m_submissionEntries != MAP_FAILED)
+		munmap(m_submissionEntries, m_submissionEntriesSize);
+	if (m_completionRing != MAP_FAILED)
+		munmap(m_completionRing, m_completionRingSize);
+	if (m_submissionRing != MAP_FAILED)
+		munmap(m_submissionRing, m_submissionRingSize);
+
+	m_submissionEntries = m_completionRing = m_submissionRing = MAP_FAILED;
+
+	if (m_ringFileDescriptor >= 0)
+		close(m_ringFileDescriptor);
+
+	m_ringFileDescriptor = -1;
+	m_inFlight = 0;
+	m_queued = 0;
+	m_synchronousCompletions.clear();
+}
+
+bool UringReader::QueueRead(int fileDescriptor, void* buffer, size_t size, uint64_t offset, uint64_t userData)
+{
+	if (m_ringFileDescriptor < 0)
+	{
+		Completion	completion;
+		size_t		done = 0;
+		int			error = 0;
+
+		// Synchronous fallback, read the whole buffer now as io_uring would
+		while (done < size)
+		{
+			ssize_t result = pread(fileDescriptor, (uint8_t*)buffer + done, size - done, offset + done);
+			if (result < 0 && errno == EINTR)
+				continue;
+			if (result <= 0)
+			{
+				error = (result < 0) ? errno : 0;
+				break;
+			}
+			done += result;
+		}
+
+		completion.userData	= userData;
+		completion.result	= (done == 0 && error != 0) ? -error : (int)done;
+		m_synchronousCompletions.push_back(completion);
+		m_inFlight++;
+		return true;
+	}
+
+	if (m_inFlight + m_queued >= m_queueDepth)
+		return false;
+
+	unsigned				tail = *m_submissionTail;
+	unsigned				index = tail & *m_submissionMask;
+	struct io_uring_sqe*	entry = (struct io_uring_sqe*)m_submissionEntries + index;
+
+	memset(entry, 0, sizeof(*entry));
+	entry->opcode		= IORING_OP_READ;
+	entry->fd			= fileDescriptor;
+	entry->addr			= (uint64_t)(uintptr_t)buffer;
+	entry->len			= (uint32_t)size;
+	entry->off			= offset;
+	entry->user_data	= userData;
+
+	m_submissionArray[index] = index;
+	__atomic_store_n(m_submissionTail, tail + 1, __ATOMIC_RELEASE);
+
+	m_queued++;
+	return true;
+}
+
+bool UringReader::Enter(unsigned submit, unsigned waitFor)
+{
+	while (true)
+	{
+		int result = (int)syscall(__NR_io_uring_enter, m_ringFileDescriptor, submit, waitFor, waitFor ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+		if (result >= 0)
+		{
+			m_queued	-= result;
+			m_inFlight	+= result;
+			return true;
+		}
+		if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+		{
+			fprintf(stderr, "io_uring_enter failed - %s\n", strerror(errno));
+			return false;
+		}
+		if (errno != EINTR && waitFor == 0)
+			return true;
+	}
+}
+
+bool UringReader::Submit()
+{
+	if (m_ringFileDescriptor < 0 || m_queued == 0)
+		return true;
+
+	return Enter(m_queued, 0);
+}
+
+bool UringReader::Reap(uint64_t& userData, int& result, bool wait)
+{
+	if (m_ringFileDescriptor < 0)
+	{
+		if (m_synchronousCompletions.empty())
+			return false;
+
+		userData	= m_synchronousCompletions.front().userData;
+		result		= m_synchronousCompletions.front().result;
+		m_synchronousCompletions.pop_front();
+		m_inFlight--;
+		return true;
+	}
+
+	while (true)
+	{
+		unsigned head = *m_completionHead;
+
+		if (head != __atomic_load_n(m_completionTail, __ATOMIC_ACQUIRE))
+		{
+			const struct io_uring_cqe* entry = (const struct io_uring_cqe*)m_completionEntries + (head & *m_completionMask);
+
+			userData	= entry->user_data;
+			result		= entry->res;
+			__atomic_store_n(m_completionHead, head + 1, __ATOMIC_RELEASE);
+			m_inFlight--;
+			return true;
+		}
+
+		if (!wait || (m_inFlight == 0 && m_queued == 0))
+			return false;
+
+		if (!Enter(m_queued, 1))
+			return false;
+	}
+}
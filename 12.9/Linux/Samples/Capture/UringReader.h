@@ -0,0 +1,104 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __URING_READER_H__
+#define __URING_READER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+
+// Asynchronous file reads through io_uring, driven directly with the system calls so
+// the sample does not depend on liburing.  Where io_uring is not available, for
+// example in a restricted container, reads are made synchronously with pread() and
+// completed in submission order.  Used from a single thread.
+class UringReader
+{
+public:
+	UringReader(unsigned queueDepth);
+	virtual ~UringReader();
+
+	bool		Open(void);
+	void		Close(void);
+
+	bool		IsAsynchronous(void) const { return m_ringFileDescriptor >= 0; }
+	unsigned	GetInFlight(void) const { return m_inFlight; }
+
+	// Queues a read, submitted to the kernel by the next Submit() or Reap()
+	bool		QueueRead(int fileDescriptor, void* buffer, size_t size, uint64_t offset, uint64_t userData);
+	bool		Submit(void);
+	// Returns a completed read with its byte count or negative errno, waiting for one
+	// if wait is set.  Returns false if there was no completion.
+	bool		Reap(uint64_t& userData, int& result, bool wait);
+
+private:
+	struct Completion
+	{
+		uint64_t	userData;
+		int			result;
+	};
+
+	bool		Enter(unsigned submit, unsigned waitFor);
+
+	unsigned				m_queueDepth;
+	int						m_ringFileDescriptor;
+	unsigned				m_inFlight;
+	unsigned				m_queued;
+
+	void*					m_submissionRing;
+	size_t					m_submissionRingSize;
+	void*					m_completionRing;
+	size_t					m_completionRingSize;
+	void*					m_submissionEntries;
+	size_t					m_submissionEntriesSize;
+
+	unsigned*				m_submissionHead;
+	unsigned*				m_submissionTail;
+	unsigned*				m_submissionMask;
+	unsigned*				m_submissionArray;
+	unsigned*				m_completionHead;
+	unsigned*				m_completionTail;
+	unsigned*				m_completionMask;
+	void*					m_completionEntries;
+
+	std::deque<Completion>	m_synchronousCompletions;
+};
+
+#endif
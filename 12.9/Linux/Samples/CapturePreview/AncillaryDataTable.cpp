@@ -38,6 +38,7 @@
 ** -LICENSE-END-
 */
 
+#include <QTime>
 #include "AncillaryDataTable.h"
 
 AncillaryDataTable::AncillaryDataTable(QObject* parent)
@@ -45,51 +46,167 @@ AncillaryDataTable::AncillaryDataTable(QObject* parent)
 {
 	m_ancillaryDataValues << "" << "" << "" << "" << "" << "" << "" << "" << "" << "" << "" << "";
 	m_metadataValues << "" << "" << "" << "" << "" << "" << "" << "" << "" << "" << "" << "" << "" << "";
+	for (int i = 0; i < kSignalAnalysisTypes.size(); i++)
+		m_signalValues << "";
 }
 
-void AncillaryDataTable::UpdateFrameData(AncillaryDataStruct* newAncData, MetadataStruct* newMetadata)
+static QString FormatTimecode(const TimecodeData& timecode)
 {
-	// VITC timecodes
-	m_ancillaryDataValues.replace(0, newAncData->vitcF1Timecode);
-	m_ancillaryDataValues.replace(1, newAncData->vitcF1UserBits);
-	m_ancillaryDataValues.replace(2, newAncData->vitcF2Timecode);
-	m_ancillaryDataValues.replace(3, newAncData->vitcF2UserBits);
-
-	// RP188 timecodes and user bits
-	m_ancillaryDataValues.replace(4, newAncData->rp188vitc1Timecode);
-	m_ancillaryDataValues.replace(5, newAncData->rp188vitc1UserBits);
-	m_ancillaryDataValues.replace(6, newAncData->rp188vitc2Timecode);
-	m_ancillaryDataValues.replace(7, newAncData->rp188vitc2UserBits);
-	m_ancillaryDataValues.replace(8, newAncData->rp188ltcTimecode);
-	m_ancillaryDataValues.replace(9, newAncData->rp188ltcUserBits);
-	m_ancillaryDataValues.replace(10, newAncData->rp188hfrtcTimecode);
-	m_ancillaryDataValues.replace(11, newAncData->rp188hfrtcUserBits);
+	if (!timecode.valid)
+		return QString();
+
+	QChar frameSeparator = (timecode.flags & bmdTimecodeIsDropFrame) ? ';' : ':';
+	return QString("%1:%2:%3%4%5")
+		.arg(timecode.hours, 2, 10, QChar('0'))
+		.arg(timecode.minutes, 2, 10, QChar('0'))
+		.arg(timecode.seconds, 2, 10, QChar('0'))
+		.arg(frameSeparator)
+		.arg(timecode.frames, 2, 10, QChar('0'));
+}
+
+static QString FormatUserBits(const TimecodeData& timecode)
+{
+	if (!timecode.valid)
+		return QString();
+
+	return QString("0x%1").arg(timecode.userBits, 8, 16, QChar('0'));
+}
+
+static QString FormatElectroOpticalTransferFunction(const MetadataStruct& metadata)
+{
+	if (!metadata.hasElectroOpticalTransferFunction)
+		return QString();
+
+	switch (metadata.electroOpticalTransferFunction)
+	{
+		case 0:
+			return "SDR";
+		case 1:
+			return "HDR";
+		case 2:
+			return "PQ (ST2084)";
+		case 3:
+			return "HLG";
+		default:
+			return QString("Unknown EOTF: %1").arg((int32_t)metadata.electroOpticalTransferFunction);
+	}
+}
+
+static QString FormatColorspace(const MetadataStruct& metadata)
+{
+	if (!metadata.hasColorspace)
+		return QString();
+
+	switch (metadata.colorspace)
+	{
+		case bmdColorspaceRec601:
+			return "Rec.601";
+		case bmdColorspaceRec709:
+			return "Rec.709";
+		case bmdColorspaceRec2020:
+			return "Rec.2020";
+		default:
+			return QString("Unknown Colorspace: %1").arg((int32_t)metadata.colorspace);
+	}
+}
+
+static QString FormatAlarm(const SignalStatistics& signal, SignalAlarm alarm)
+{
+	return (signal.activeAlarms & (1 << static_cast<int>(alarm))) ? "ALARM" : "OK";
+}
+
+static QString FormatLevels(const SignalStatistics& signal, const float* levels)
+{
+	QStringList values;
+	for (int channel = 0; channel < signal.audioChannels; channel++)
+		values << QString::number(levels[channel], 'f', 1);
+	return values.join(" ");
+}
+
+static QString FormatSilence(const SignalStatistics& signal)
+{
+	if (signal.audioChannels == 0)
+		return QString();
+	if (signal.silentChannels == 0)
+		return "OK";
+
+	QStringList channels;
+	for (int channel = 0; channel < signal.audioChannels; channel++)
+	{
+		if (signal.silentChannels & (1 << channel))
+			channels << QString::number(channel + 1);
+	}
+	return QString("ALARM on channel %1").arg(channels.join(", "));
+}
+
+void AncillaryDataTable::UpdateFrameData(const AncillaryDataStruct& newAncData, const MetadataStruct& newMetadata, const SignalStatistics& newSignal)
+{
+	// VITC and RP188 timecodes and user bits
+	for (int i = 0; i < kTimecodeSourceCount; i++)
+	{
+		m_ancillaryDataValues.replace(i * 2, FormatTimecode(newAncData.timecodes[i]));
+		m_ancillaryDataValues.replace(i * 2 + 1, FormatUserBits(newAncData.timecodes[i]));
+	}
 
 	// Static Metadata
-	m_metadataValues.replace(0, newMetadata->electroOpticalTransferFunction);
-	m_metadataValues.replace(1, newMetadata->displayPrimariesRedX);
-	m_metadataValues.replace(2, newMetadata->displayPrimariesRedY);
-	m_metadataValues.replace(3, newMetadata->displayPrimariesGreenX);
-	m_metadataValues.replace(4, newMetadata->displayPrimariesGreenY);
-	m_metadataValues.replace(5, newMetadata->displayPrimariesBlueX);
-	m_metadataValues.replace(6, newMetadata->displayPrimariesBlueY);
-	m_metadataValues.replace(7, newMetadata->whitePointX);
-	m_metadataValues.replace(8, newMetadata->whitePointY);
-	m_metadataValues.replace(9, newMetadata->maxDisplayMasteringLuminance);
-	m_metadataValues.replace(10, newMetadata->minDisplayMasteringLuminance);
-	m_metadataValues.replace(11, newMetadata->maximumContentLightLevel);
-	m_metadataValues.replace(12, newMetadata->maximumFrameAverageLightLevel);
-	m_metadataValues.replace(13, newMetadata->colorspace);
+	m_metadataValues.replace(0, FormatElectroOpticalTransferFunction(newMetadata));
+	for (int i = 0; i < kHDRMetadataValueCount; i++)
+	{
+		if (newMetadata.validHDRValues & (1 << i))
+			m_metadataValues.replace(i + 1, QString::number(newMetadata.hdrValues[i], 'f', 4));
+		else
+			m_metadataValues.replace(i + 1, QString());
+	}
+	m_metadataValues.replace(kHDRMetadataValueCount + 1, FormatColorspace(newMetadata));
+
+	// Signal analysis, the last alarm row is only set by UpdateLastAlarm
+	if (newSignal.videoAnalyzed)
+	{
+		m_signalValues.replace(0, QString("%1% / %2% / %3%")
+			.arg(newSignal.lumaMean * 100.0, 0, 'f', 1)
+			.arg(newSignal.lumaMin * 100.0, 0, 'f', 1)
+			.arg(newSignal.lumaMax * 100.0, 0, 'f', 1));
+		m_signalValues.replace(1, QString("%1%").arg(newSignal.brightFraction * 100.0, 0, 'f', 2));
+		m_signalValues.replace(2, QString("0x%1").arg(newSignal.fingerprint, 16, 16, QChar('0')));
+	}
+	else
+	{
+		m_signalValues.replace(0, QString());
+		m_signalValues.replace(1, QString());
+		m_signalValues.replace(2, QString());
+	}
+	m_signalValues.replace(3, FormatAlarm(newSignal, SignalAlarm::Black));
+	m_signalValues.replace(4, FormatAlarm(newSignal, SignalAlarm::Freeze));
+	m_signalValues.replace(5, FormatLevels(newSignal, newSignal.audioRMS));
+	m_signalValues.replace(6, FormatLevels(newSignal, newSignal.audioPeak));
+	m_signalValues.replace(7, FormatSilence(newSignal));
 
 	emit dataChanged(index(0, static_cast<int>(AncillaryHeader::Values)), index(rowCount()-1, static_cast<int>(AncillaryHeader::Values)));
 }
 
+void AncillaryDataTable::UpdateLastAlarm(const SignalAlarmEvent& alarm)
+{
+	static const char* kAlarmNames[] = { "Black picture", "Frozen picture", "Audio silence" };
+	QString text = QString("%1 %2").arg(kAlarmNames[static_cast<int>(alarm.alarm)]).arg(alarm.raised ? "raised" : "cleared");
+
+	if (alarm.channel >= 0)
+		text += QString(" on channel %1").arg(alarm.channel + 1);
+
+	text += QString(" after %1 s at %2").arg(alarm.duration, 0, 'f', 1).arg(QTime::currentTime().toString("hh:mm:ss"));
+
+	int row = kSignalAnalysisTypes.size() - 1;
+	m_signalValues.replace(row, text);
+
+	row += kAncillaryDataTypes.size() + kMetadataTypes.size();
+	emit dataChanged(index(row, static_cast<int>(AncillaryHeader::Values)), index(row, static_cast<int>(AncillaryHeader::Values)));
+}
+
 QVariant AncillaryDataTable::data(const QModelIndex& index, int role) const
 {
 	if (!index.isValid())
 		return QVariant();
 
-	if ((index.row() >= (kAncillaryDataTypes.size() + kMetadataTypes.size())) || (index.column() >= kAncillaryTableColumnCount))
+	if ((index.row() >= rowCount()) || (index.column() >= kAncillaryTableColumnCount))
 		return QVariant();
 
 	if (role == Qt::DisplayRole)
@@ -98,15 +215,19 @@ QVariant AncillaryDataTable::data(const QModelIndex& index, int role) const
 		{
 			if (index.row() < kAncillaryDataTypes.size())
 				return kAncillaryDataTypes.at(index.row());
-			else
+			else if (index.row() < kAncillaryDataTypes.size() + kMetadataTypes.size())
 				return kMetadataTypes.at(index.row() - kAncillaryDataTypes.size());
+			else
+				return kSignalAnalysisTypes.at(index.row() - kAncillaryDataTypes.size() - kMetadataTypes.size());
 		}
 		else if (index.column() == static_cast<int>(AncillaryHeader::Values))
 		{
 			if (index.row() < kAncillaryDataTypes.size())
 				return m_ancillaryDataValues.at(index.row());
-			else
+			else if (index.row() < kAncillaryDataTypes.size() + kMetadataTypes.size())
 				return m_metadataValues.at(index.row() - kAncillaryDataTypes.size());
+			else
+				return m_signalValues.at(index.row() - kAncillaryDataTypes.size() - kMetadataTypes.size());
 		}
 	}
 
@@ -44,6 +44,9 @@
 #include <QMutex>
 #include <QStringList>
 
+#include "DeckLinkAPI.h"
+#include "SignalAnalyzer.h"
+
 enum class AncillaryHeader : int { Types, Values };
 const int kAncillaryTableColumnCount = 2;
 
@@ -79,41 +82,82 @@ const QStringList kMetadataTypes = {
 	"Static Colorspace",
 };
 
+const QStringList kSignalAnalysisTypes = {
+	"Luma mean / min / max",
+	"Samples above black",
+	"Frame fingerprint",
+	"Black picture",
+	"Frozen picture",
+	"Audio RMS (dBFS)",
+	"Audio peak (dBFS)",
+	"Audio silence",
+	"Last alarm",
+};
+
+// Captured values are stored as plain data so the capture thread can publish them without
+// allocating; they are only formatted for display when the table is updated.
+enum class TimecodeSource : int
+{
+	VITCField1,
+	VITCField2,
+	RP188VITC1,
+	RP188VITC2,
+	RP188LTC,
+	RP188HFRTC,
+	Count
+};
+const int kTimecodeSourceCount = static_cast<int>(TimecodeSource::Count);
+
+// Static HDR metadata values, in the same order as kMetadataTypes
+enum class HDRMetadataValue : int
+{
+	DisplayPrimariesRedX,
+	DisplayPrimariesRedY,
+	DisplayPrimariesGreenX,
+	DisplayPrimariesGreenY,
+	DisplayPrimariesBlueX,
+	DisplayPrimariesBlueY,
+	WhitePointX,
+	WhitePointY,
+	MaxDisplayMasteringLuminance,
+	MinDisplayMasteringLuminance,
+	MaximumContentLightLevel,
+	MaximumFrameAverageLightLevel,
+	Count
+};
+const int kHDRMetadataValueCount = static_cast<int>(HDRMetadataValue::Count);
+
+typedef struct {
+	bool					valid;
+	uint8_t					hours;
+	uint8_t					minutes;
+	uint8_t					seconds;
+	uint8_t					frames;
+	BMDTimecodeFlags		flags;
+	BMDTimecodeUserBits		userBits;
+} TimecodeData;
+
 typedef struct {
-	// VITC timecodes and user bits for field 1 & 2
-	QString vitcF1Timecode;
-	QString vitcF1UserBits;
-	QString vitcF2Timecode;
-	QString vitcF2UserBits;
-
-	// RP188 timecodes and user bits (VITC1, VITC2, LTC and HFRTC)
-	QString rp188vitc1Timecode;
-	QString rp188vitc1UserBits;
-	QString rp188vitc2Timecode;
-	QString rp188vitc2UserBits;
-	QString rp188ltcTimecode;
-	QString rp188ltcUserBits;
-	QString rp188hfrtcTimecode;
-	QString rp188hfrtcUserBits;
+	// VITC timecodes for field 1 & 2, RP188 timecodes (VITC1, VITC2, LTC and HFRTC)
+	TimecodeData			timecodes[kTimecodeSourceCount];
 } AncillaryDataStruct;
 
 typedef struct {
-	QString electroOpticalTransferFunction;
-	QString displayPrimariesRedX;
-	QString displayPrimariesRedY;
-	QString displayPrimariesGreenX;
-	QString displayPrimariesGreenY;
-	QString displayPrimariesBlueX;
-	QString displayPrimariesBlueY;
-	QString whitePointX;
-	QString whitePointY;
-	QString maxDisplayMasteringLuminance;
-	QString minDisplayMasteringLuminance;
-	QString maximumContentLightLevel;
-	QString maximumFrameAverageLightLevel;
-	QString colorspace;
+	bool					hasElectroOpticalTransferFunction;
+	int64_t					electroOpticalTransferFunction;
+	uint32_t				validHDRValues;			// Bit mask of HDRMetadataValue
+	double					hdrValues[kHDRMetadataValueCount];
+	bool					hasColorspace;
+	int64_t					colorspace;
 } MetadataStruct;
 
+typedef struct {
+	bool					signalValid;
+	AncillaryDataStruct		ancillaryData;
+	MetadataStruct			metadata;
+	SignalStatistics		signal;
+} FrameDataStruct;
+
 class AncillaryDataTable : public QAbstractTableModel
 {
 	Q_OBJECT
@@ -122,10 +166,11 @@ public:
 	AncillaryDataTable(QObject* parent = nullptr);
 	virtual ~AncillaryDataTable() {}
 
-	void UpdateFrameData(AncillaryDataStruct* newAncData, MetadataStruct* newMetadata);
+	void UpdateFrameData(const AncillaryDataStruct& newAncData, const MetadataStruct& newMetadata, const SignalStatistics& newSignal);
+	void UpdateLastAlarm(const SignalAlarmEvent& alarm);
 
 	// QAbstractTableModel methods
-	int			rowCount(const QModelIndex& parent = QModelIndex()) const override { Q_UNUSED(parent); return kAncillaryDataTypes.size() + kMetadataTypes.size(); }
+	int			rowCount(const QModelIndex& parent = QModelIndex()) const override { Q_UNUSED(parent); return kAncillaryDataTypes.size() + kMetadataTypes.size() + kSignalAnalysisTypes.size(); }
 	int			columnCount(const QModelIndex& parent = QModelIndex()) const override { Q_UNUSED(parent); return kAncillaryTableColumnCount; }
 	QVariant	data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
 	QVariant	headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
@@ -134,5 +179,6 @@ private:
 	QMutex			m_updateMutex;
 	QStringList		m_ancillaryDataValues;
 	QStringList		m_metadataValues;
+	QStringList		m_signalValues;
 };
 
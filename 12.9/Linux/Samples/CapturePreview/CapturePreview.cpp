@@ -38,7 +38,9 @@
 ** -LICENSE-END-
 */
 
+#include <QGuiApplication>
 #include <QMessageBox>
+#include <QScreen>
 #include <QStandardItemModel>
 #include <QStandardItem>
 #include "CapturePreview.h"
@@ -63,7 +65,8 @@ CapturePreview::CapturePreview(QWidget *parent) :
 	ui(new Ui::CapturePreviewDialog),
 	m_selectedDevice(nullptr),
 	m_deckLinkDiscovery(nullptr),
-	m_selectedInputConnection(bmdVideoConnectionUnspecified)
+	m_selectedInputConnection(bmdVideoConnectionUnspecified),
+	m_frameDataGeneration(0)
 {
 	ui->setupUi(this);
 
@@ -82,6 +85,13 @@ CapturePreview::CapturePreview(QWidget *parent) :
 
 	ui->invalidSignalLabel->setVisible(false);
 
+	// Sample the latest captured frame data once per display refresh rather than per frame
+	m_frameDataTimer = new QTimer(this);
+	QScreen* screen = QGuiApplication::primaryScreen();
+	qreal refreshRate = (screen && screen->refreshRate() > 0) ? screen->refreshRate() : 60.0;
+	m_frameDataTimer->setInterval(qMax(1, qRound(1000.0 / refreshRate)));
+	connect(m_frameDataTimer, &QTimer::timeout, this, &CapturePreview::updateFrameData);
+
 	connect(ui->startButton, &QPushButton::clicked, this, &CapturePreview::toggleStart);
 	connect(ui->inputDevicePopup, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &CapturePreview::inputDeviceChanged);
 	connect(ui->inputConnectionPopup, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &CapturePreview::inputConnectionChanged);
@@ -126,16 +136,24 @@ void CapturePreview::customEvent(QEvent *event)
 		DeckLinkInputFormatChangedEvent* formatEvent = dynamic_cast<DeckLinkInputFormatChangedEvent*>(event);
 		videoFormatChanged(formatEvent->DisplayMode());
 	}
-	else if (event->type() == kVideoFrameArrivedEvent)
+	else if (event->type() == kSignalAlarmEvent)
 	{
-		DeckLinkInputFrameArrivedEvent* frameArrivedEvent = dynamic_cast<DeckLinkInputFrameArrivedEvent*>(event);
-		ui->invalidSignalLabel->setVisible(!frameArrivedEvent->SignalValid());
-		m_ancillaryDataTable->UpdateFrameData(frameArrivedEvent->AncillaryData(), frameArrivedEvent->Metadata());
-		delete frameArrivedEvent->AncillaryData();
-		delete frameArrivedEvent->Metadata();
+		DeckLinkSignalAlarmEvent* alarmEvent = dynamic_cast<DeckLinkSignalAlarmEvent*>(event);
+		m_ancillaryDataTable->UpdateLastAlarm(alarmEvent->Alarm());
 	}
 }
 
+void CapturePreview::updateFrameData()
+{
+	FrameDataStruct frameData;
+
+	if (!m_selectedDevice || !m_selectedDevice->getLatestFrameData(frameData, m_frameDataGeneration))
+		return;
+
+	ui->invalidSignalLabel->setVisible(!frameData.signalValid);
+	m_ancillaryDataTable->UpdateFrameData(frameData.ancillaryData, frameData.metadata, frameData.signal);
+}
+
 void CapturePreview::closeEvent(QCloseEvent *)
 {
 	if (m_selectedDevice)
@@ -168,12 +186,19 @@ void CapturePreview::startCapture()
 	QVariant v = ui->videoFormatPopup->itemData(ui->videoFormatPopup->currentIndex());
 	displayMode = (BMDDisplayMode)v.value<unsigned int>();
 
-	if (m_selectedDevice && 
-		m_selectedDevice->startCapture(displayMode, m_previewView->delegate(), applyDetectedInputMode))
+	if (!m_selectedDevice)
+		return;
+
+	// The mailbox outlives each capture session, ignore frame data left over from the last one
+	m_frameDataGeneration = m_selectedDevice->getFrameDataGeneration();
+
+	if (m_selectedDevice->startCapture(displayMode, m_previewView->delegate(), applyDetectedInputMode))
 	{
 		// Update UI
 		ui->startButton->setText("Stop");
 		enableInterface(false);
+
+		m_frameDataTimer->start();
 	}
 }
 
@@ -182,6 +207,8 @@ void CapturePreview::stopCapture()
 	if (m_selectedDevice)
 		m_selectedDevice->stopCapture();
 
+	m_frameDataTimer->stop();
+
 	// Update UI
 	ui->invalidSignalLabel->setVisible(false);
 	ui->startButton->setText("Start");
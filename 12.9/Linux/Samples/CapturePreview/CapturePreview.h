@@ -42,6 +42,7 @@
 
 #include <QEvent>
 #include <QMainWindow>
+#include <QTimer>
 #include <QWidget>
 
 #include "DeckLinkInputDevice.h"
@@ -83,6 +84,8 @@ private:
 	DeckLinkOpenGLWidget*				m_previewView;
 	AncillaryDataTable*					m_ancillaryDataTable;
 	BMDVideoConnection					m_selectedInputConnection;
+	QTimer*								m_frameDataTimer;
+	uint64_t							m_frameDataGeneration;
 
 	std::map<intptr_t, com_ptr<DeckLinkInputDevice>>		m_inputDevices;
 
@@ -90,4 +93,5 @@ public slots:
 	void inputDeviceChanged(int selectedDeviceIndex);
 	void inputConnectionChanged(int selectedConnectionIndex);
 	void toggleStart();
+	void updateFrameData();
 };
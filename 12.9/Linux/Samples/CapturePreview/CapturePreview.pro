@@ -34,14 +34,17 @@ SOURCES += \
 	DeckLinkInputDevice.cpp \
 	DeckLinkOpenGLWidget.cpp \
 	CapturePreview.cpp \
-	AncillaryDataTable.cpp
+	AncillaryDataTable.cpp \
+	SignalAnalyzer.cpp
 
 HEADERS += \
 	CapturePreview.h \
 	DeckLinkDeviceDiscovery.h \
 	DeckLinkInputDevice.h \
+	LatestValueMailbox.h \
 	DeckLinkOpenGLWidget.h \
-	AncillaryDataTable.h
+	AncillaryDataTable.h \
+	SignalAnalyzer.h
 
 FORMS += \
 	CapturePreview.ui
@@ -55,9 +55,15 @@ DeckLinkInputDevice::DeckLinkInputDevice(QObject* owner, com_ptr<IDeckLink>& dev
 	m_supportsFormatDetection(false),
 	m_currentlyCapturing(false),
 	m_applyDetectedInputMode(false),
-	m_supportedInputConnections(0)
+	m_supportedInputConnections(0),
+	m_audioChannelCount(0)
 {
 	m_deckLink->AddRef();
+
+	m_signalAnalyzer.setAlarmHandler([this](const SignalAlarmEvent& alarm) {
+		if (m_owner != nullptr)
+			QCoreApplication::postEvent(m_owner, new DeckLinkSignalAlarmEvent(alarm));
+	});
 }
 
 HRESULT	DeckLinkInputDevice::QueryInterface(REFIID iid, LPVOID *ppv)
@@ -134,6 +140,16 @@ bool DeckLinkInputDevice::Init()
 	// Get the supported input connections for the device
 	if (deckLinkAttributes->GetInt(BMDDeckLinkVideoInputConnections, &m_supportedInputConnections) != S_OK)
 		m_supportedInputConnections = 0;
+
+	// Capture as many audio channels as the analyzer reports, 16, 8 or 2
+	if (deckLinkAttributes->GetInt(BMDDeckLinkMaximumAudioChannels, &m_audioChannelCount) != S_OK)
+		m_audioChannelCount = 2;
+	if (m_audioChannelCount >= 16)
+		m_audioChannelCount = 16;
+	else if (m_audioChannelCount >= 8)
+		m_audioChannelCount = 8;
+	else
+		m_audioChannelCount = 2;
 		
 	// Enable all EDID functionality if possible
 	if (m_deckLinkHDMIInputEDID)
@@ -196,6 +212,12 @@ bool DeckLinkInputDevice::startCapture(BMDDisplayMode displayMode, IDeckLinkScre
 		return false;
 	}
 
+	// Audio is only captured for level measurement and silence detection, so carry on without it
+	if (m_deckLinkInput->EnableAudioInput(bmdAudioSampleRate48kHz, bmdAudioSampleType32bitInteger, (uint32_t)m_audioChannelCount) != S_OK)
+		m_deckLinkInput->DisableAudioInput();
+
+	m_signalAnalyzer.reset();
+
 	// Start the capture
 	result = m_deckLinkInput->StartStreams();
 	if (result != S_OK)
@@ -215,6 +237,7 @@ void DeckLinkInputDevice::stopCapture()
 	{
 		// Stop the capture
 		m_deckLinkInput->StopStreams();
+		m_deckLinkInput->DisableAudioInput();
 
 		//
 		m_deckLinkInput->SetScreenPreviewCallback(nullptr);
@@ -275,6 +298,9 @@ HRESULT DeckLinkInputDevice::VideoInputFormatChanged (BMDVideoInputFormatChanged
 			return result;
 		}
 
+		// Alarm durations and the frozen picture fingerprint do not carry over to the new format
+		m_signalAnalyzer.reset();
+
 		// Start the capture
 		result = m_deckLinkInput->StartStreams();
 		if (result != S_OK)
@@ -291,173 +317,114 @@ HRESULT DeckLinkInputDevice::VideoInputFormatChanged (BMDVideoInputFormatChanged
 	return S_OK;
 }
 
-HRESULT DeckLinkInputDevice::VideoInputFrameArrived (IDeckLinkVideoInputFrame* videoFrame, IDeckLinkAudioInputPacket* /* audioPacket */)
+HRESULT DeckLinkInputDevice::VideoInputFrameArrived (IDeckLinkVideoInputFrame* videoFrame, IDeckLinkAudioInputPacket* audioPacket)
 {
-	bool					validFrame;
-	AncillaryDataStruct*	ancillaryData;
-	MetadataStruct*			metadata;
+	FrameDataStruct		frameData;
+	BMDTimeValue		frameTime;
+	BMDTimeValue		frameDuration;
+	void*				bytes;
 
 	if (videoFrame == nullptr)
 		return S_OK;
 
-	validFrame = (videoFrame->GetFlags() & bmdFrameHasNoInputSource) == 0;
+	frameData.signalValid = (videoFrame->GetFlags() & bmdFrameHasNoInputSource) == 0;
 
 	// Get the various timecodes and userbits attached to this frame
-	ancillaryData = new AncillaryDataStruct();
-	GetAncillaryDataFromFrame(videoFrame, bmdTimecodeVITC,					&ancillaryData->vitcF1Timecode,		&ancillaryData->vitcF1UserBits);
-	GetAncillaryDataFromFrame(videoFrame, bmdTimecodeVITCField2,			&ancillaryData->vitcF2Timecode,		&ancillaryData->vitcF2UserBits);
-	GetAncillaryDataFromFrame(videoFrame, bmdTimecodeRP188VITC1,			&ancillaryData->rp188vitc1Timecode,	&ancillaryData->rp188vitc1UserBits);
-	GetAncillaryDataFromFrame(videoFrame, bmdTimecodeRP188VITC2,			&ancillaryData->rp188vitc2Timecode,	&ancillaryData->rp188vitc2UserBits);
-	GetAncillaryDataFromFrame(videoFrame, bmdTimecodeRP188LTC,				&ancillaryData->rp188ltcTimecode,	&ancillaryData->rp188ltcUserBits);
-	GetAncillaryDataFromFrame(videoFrame, bmdTimecodeRP188HighFrameRate,	&ancillaryData->rp188hfrtcTimecode,	&ancillaryData->rp188hfrtcUserBits);
-
-	metadata = new MetadataStruct();
-	GetMetadataFromFrame(videoFrame, metadata);
-
-	// Update the UI with new Ancillary data
-	if (m_owner != nullptr)
-		QCoreApplication::postEvent(m_owner, new DeckLinkInputFrameArrivedEvent(ancillaryData, metadata, validFrame));
+	GetAncillaryDataFromFrame(videoFrame, bmdTimecodeVITC,					&frameData.ancillaryData.timecodes[static_cast<int>(TimecodeSource::VITCField1)]);
+	GetAncillaryDataFromFrame(videoFrame, bmdTimecodeVITCField2,			&frameData.ancillaryData.timecodes[static_cast<int>(TimecodeSource::VITCField2)]);
+	GetAncillaryDataFromFrame(videoFrame, bmdTimecodeRP188VITC1,			&frameData.ancillaryData.timecodes[static_cast<int>(TimecodeSource::RP188VITC1)]);
+	GetAncillaryDataFromFrame(videoFrame, bmdTimecodeRP188VITC2,			&frameData.ancillaryData.timecodes[static_cast<int>(TimecodeSource::RP188VITC2)]);
+	GetAncillaryDataFromFrame(videoFrame, bmdTimecodeRP188LTC,				&frameData.ancillaryData.timecodes[static_cast<int>(TimecodeSource::RP188LTC)]);
+	GetAncillaryDataFromFrame(videoFrame, bmdTimecodeRP188HighFrameRate,	&frameData.ancillaryData.timecodes[static_cast<int>(TimecodeSource::RP188HFRTC)]);
+
+	GetMetadataFromFrame(videoFrame, &frameData.metadata);
+
+	// Signal analysis reads the captured buffer in place
+	if (frameData.signalValid &&
+		(videoFrame->GetStreamTime(&frameTime, &frameDuration, 1000000) == S_OK) &&
+		(videoFrame->GetBytes(&bytes) == S_OK))
+	{
+		m_signalAnalyzer.analyzeVideo(bytes, videoFrame->GetWidth(), videoFrame->GetHeight(), videoFrame->GetRowBytes(),
+										videoFrame->GetPixelFormat(), frameDuration / 1000000.0);
+	}
 	else
 	{
-		delete ancillaryData;
-		delete metadata;
+		m_signalAnalyzer.videoMissing();
+	}
+
+	if ((audioPacket != nullptr) && (audioPacket->GetBytes(&bytes) == S_OK))
+	{
+		m_signalAnalyzer.analyzeAudio(bytes, (uint32_t)audioPacket->GetSampleFrameCount(), (int)m_audioChannelCount,
+										bmdAudioSampleType32bitInteger, bmdAudioSampleRate48kHz);
 	}
 
+	frameData.signal = m_signalAnalyzer.statistics();
+
+	// Publish the latest values, the UI samples them at display rate
+	m_frameData.store(frameData);
+
 	return S_OK;
 }
 
-void DeckLinkInputDevice::GetAncillaryDataFromFrame(IDeckLinkVideoInputFrame* videoFrame, BMDTimecodeFormat timecodeFormat, QString* timecodeString, QString* userBitsString)
+void DeckLinkInputDevice::GetAncillaryDataFromFrame(IDeckLinkVideoInputFrame* videoFrame, BMDTimecodeFormat timecodeFormat, TimecodeData* timecodeData)
 {
 	com_ptr<IDeckLinkTimecode>		timecode;
-	const char*						timecodeStr;
-	BMDTimecodeUserBits				userBits	= 0;
 
-	if ((videoFrame != nullptr) && (timecodeString != nullptr) && (userBitsString != nullptr)
-		&& (videoFrame->GetTimecode(timecodeFormat, timecode.releaseAndGetAddressOf()) == S_OK))
+	timecodeData->valid = false;
+	timecodeData->userBits = 0;
+
+	if ((videoFrame != nullptr) && (videoFrame->GetTimecode(timecodeFormat, timecode.releaseAndGetAddressOf()) == S_OK))
 	{
-		if (timecode->GetString(&timecodeStr) == S_OK)
-		{
-			*timecodeString = timecodeStr;
-			free((void*)timecodeStr);
-		}
-		else
+		if (timecode->GetComponents(&timecodeData->hours, &timecodeData->minutes, &timecodeData->seconds, &timecodeData->frames) == S_OK)
 		{
-			*timecodeString = "";
+			timecodeData->flags = timecode->GetFlags();
+			timecodeData->valid = true;
 		}
 
-		timecode->GetTimecodeUserBits(&userBits);
-		*userBitsString = QString("0x%1").arg(userBits, 8, 16, QChar('0'));
-	}
-	else
-	{
-		*timecodeString = "";
-		*userBitsString = "";
+		timecode->GetTimecodeUserBits(&timecodeData->userBits);
 	}
 }
 
 void DeckLinkInputDevice::GetMetadataFromFrame(IDeckLinkVideoInputFrame* videoFrame, MetadataStruct* metadata)
 {
+	static const BMDDeckLinkFrameMetadataID kHDRMetadataIDs[kHDRMetadataValueCount] =
+	{
+		bmdDeckLinkFrameMetadataHDRDisplayPrimariesRedX,
+		bmdDeckLinkFrameMetadataHDRDisplayPrimariesRedY,
+		bmdDeckLinkFrameMetadataHDRDisplayPrimariesGreenX,
+		bmdDeckLinkFrameMetadataHDRDisplayPrimariesGreenY,
+		bmdDeckLinkFrameMetadataHDRDisplayPrimariesBlueX,
+		bmdDeckLinkFrameMetadataHDRDisplayPrimariesBlueY,
+		bmdDeckLinkFrameMetadataHDRWhitePointX,
+		bmdDeckLinkFrameMetadataHDRWhitePointY,
+		bmdDeckLinkFrameMetadataHDRMaxDisplayMasteringLuminance,
+		bmdDeckLinkFrameMetadataHDRMinDisplayMasteringLuminance,
+		bmdDeckLinkFrameMetadataHDRMaximumContentLightLevel,
+		bmdDeckLinkFrameMetadataHDRMaximumFrameAverageLightLevel,
+	};
+
 	com_ptr<IDeckLinkVideoFrameMetadataExtensions> metadataExtensions(IID_IDeckLinkVideoFrameMetadataExtensions, com_ptr<IDeckLinkVideoInputFrame>(videoFrame));
 
-	metadata->electroOpticalTransferFunction = "";
-	metadata->displayPrimariesRedX = "";
-	metadata->displayPrimariesRedY = "";
-	metadata->displayPrimariesGreenX = "";
-	metadata->displayPrimariesGreenY = "";
-	metadata->displayPrimariesBlueX = "";
-	metadata->displayPrimariesBlueY = "";
-	metadata->whitePointX = "";
-	metadata->whitePointY = "";
-	metadata->maxDisplayMasteringLuminance = "";
-	metadata->minDisplayMasteringLuminance = "";
-	metadata->maximumContentLightLevel = "";
-	metadata->maximumFrameAverageLightLevel = "";
-	metadata->colorspace = "";
+	metadata->hasElectroOpticalTransferFunction = false;
+	metadata->validHDRValues = 0;
+	metadata->hasColorspace = false;
 
 	if (metadataExtensions)
 	{
-		double doubleValue = 0.0;
-		int64_t intValue = 0;
-
-		if (metadataExtensions->GetInt(bmdDeckLinkFrameMetadataHDRElectroOpticalTransferFunc, &intValue) == S_OK)
-		{
-			switch (intValue)
-			{
-			case 0:
-				metadata->electroOpticalTransferFunction = "SDR";
-				break;
-			case 1:
-				metadata->electroOpticalTransferFunction = "HDR";
-				break;
-			case 2:
-				metadata->electroOpticalTransferFunction = "PQ (ST2084)";
-				break;
-			case 3:
-				metadata->electroOpticalTransferFunction = "HLG";
-				break;
-			default:
-				metadata->electroOpticalTransferFunction = QString("Unknown EOTF: %1").arg((int32_t)intValue);
-				break;
-			}
-		}
+		if (metadataExtensions->GetInt(bmdDeckLinkFrameMetadataHDRElectroOpticalTransferFunc, &metadata->electroOpticalTransferFunction) == S_OK)
+			metadata->hasElectroOpticalTransferFunction = true;
 
 		if (videoFrame->GetFlags() & bmdFrameContainsHDRMetadata)
 		{
-			if (metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRDisplayPrimariesRedX, &doubleValue) == S_OK)
-				metadata->displayPrimariesRedX = QString::number(doubleValue, 'f', 4);
-
-			if (metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRDisplayPrimariesRedY, &doubleValue) == S_OK)
-				metadata->displayPrimariesRedY = QString::number(doubleValue, 'f', 4);
-
-			if (metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRDisplayPrimariesGreenX, &doubleValue) == S_OK)
-				metadata->displayPrimariesGreenX = QString::number(doubleValue, 'f', 4);
-
-			if (metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRDisplayPrimariesGreenY, &doubleValue) == S_OK)
-				metadata->displayPrimariesGreenY = QString::number(doubleValue, 'f', 4);
-
-			if (metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRDisplayPrimariesBlueX, &doubleValue) == S_OK)
-				metadata->displayPrimariesBlueX = QString::number(doubleValue, 'f', 4);
-
-			if (metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRDisplayPrimariesBlueY, &doubleValue) == S_OK)
-				metadata->displayPrimariesBlueY = QString::number(doubleValue, 'f', 4);
-
-			if (metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRWhitePointX, &doubleValue) == S_OK)
-				metadata->whitePointX = QString::number(doubleValue, 'f', 4);
-
-			if (metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRWhitePointY, &doubleValue) == S_OK)
-				metadata->whitePointY = QString::number(doubleValue, 'f', 4);
-
-			if (metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRMaxDisplayMasteringLuminance, &doubleValue) == S_OK)
-				metadata->maxDisplayMasteringLuminance = QString::number(doubleValue, 'f', 4);
-
-			if (metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRMinDisplayMasteringLuminance, &doubleValue) == S_OK)
-				metadata->minDisplayMasteringLuminance = QString::number(doubleValue, 'f', 4);
-
-			if (metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRMaximumContentLightLevel, &doubleValue) == S_OK)
-				metadata->maximumContentLightLevel = QString::number(doubleValue, 'f', 4);
-
-			if (metadataExtensions->GetFloat(bmdDeckLinkFrameMetadataHDRMaximumFrameAverageLightLevel, &doubleValue) == S_OK)
-				metadata->maximumFrameAverageLightLevel = QString::number(doubleValue, 'f', 4);
-		}
-
-		if (metadataExtensions->GetInt(bmdDeckLinkFrameMetadataColorspace, &intValue) == S_OK)
-		{
-			switch (intValue)
+			for (int i = 0; i < kHDRMetadataValueCount; i++)
 			{
-			case bmdColorspaceRec601:
-				metadata->colorspace = "Rec.601";
-				break;
-			case bmdColorspaceRec709:
-				metadata->colorspace = "Rec.709";
-				break;
-			case bmdColorspaceRec2020:
-				metadata->colorspace = "Rec.2020";
-				break;
-			default:
-				metadata->colorspace = QString("Unknown Colorspace: %1").arg((int32_t)intValue);
-				break;
+				if (metadataExtensions->GetFloat(kHDRMetadataIDs[i], &metadata->hdrValues[i]) == S_OK)
+					metadata->validHDRValues |= (1 << i);
 			}
 		}
+
+		if (metadataExtensions->GetInt(bmdDeckLinkFrameMetadataColorspace, &metadata->colorspace) == S_OK)
+			metadata->hasColorspace = true;
 	}
 }
 
@@ -466,9 +433,7 @@ DeckLinkInputFormatChangedEvent::DeckLinkInputFormatChangedEvent(BMDDisplayMode
 {
 }
 
-DeckLinkInputFrameArrivedEvent::DeckLinkInputFrameArrivedEvent(AncillaryDataStruct* ancillaryData, MetadataStruct* metadata, bool signalValid)
-	: QEvent(kVideoFrameArrivedEvent), m_ancillaryData(ancillaryData), m_metadata(metadata), m_signalValid(signalValid)
+DeckLinkSignalAlarmEvent::DeckLinkSignalAlarmEvent(const SignalAlarmEvent& alarm)
+	: QEvent(kSignalAlarmEvent), m_alarm(alarm)
 {
 }
-
-
@@ -48,6 +48,8 @@
 #include "com_ptr.h"
 #include "CapturePreviewEvents.h"
 #include "AncillaryDataTable.h"
+#include "LatestValueMailbox.h"
+#include "SignalAnalyzer.h"
 
 class DeckLinkInputDevice : public IDeckLinkInputCallback
 {
@@ -72,6 +74,10 @@ public:
 	com_ptr<IDeckLinkInput>				getDeckLinkInput() const { return m_deckLinkInput; }
 	com_ptr<IDeckLinkConfiguration>		getDeckLinkConfiguration() const { return m_deckLinkConfig; }
 
+	// Sampled by the UI at display rate, frames captured in between are not reported
+	bool						getLatestFrameData(FrameDataStruct& frameData, uint64_t& lastGeneration) const { return m_frameData.load(frameData, lastGeneration); }
+	uint64_t					getFrameDataGeneration() const { return m_frameData.generation(); }
+
 	// IUnknown interface
 	HRESULT		QueryInterface (REFIID iid, LPVOID *ppv) override;
 	ULONG		AddRef(void) override;
@@ -95,8 +101,12 @@ private:
 	bool								m_currentlyCapturing;
 	bool								m_applyDetectedInputMode;
 	int64_t								m_supportedInputConnections;
+	LatestValueMailbox<FrameDataStruct>	m_frameData;
+	int64_t								m_audioChannelCount;
+	// Only used from the capture callback thread while streams are running
+	SignalAnalyzer						m_signalAnalyzer;
 	//
-	static void	GetAncillaryDataFromFrame(IDeckLinkVideoInputFrame* frame, BMDTimecodeFormat format, QString* timecodeString, QString* userBitsString);
+	static void	GetAncillaryDataFromFrame(IDeckLinkVideoInputFrame* frame, BMDTimecodeFormat format, TimecodeData* timecodeData);
 	static void	GetMetadataFromFrame(IDeckLinkVideoInputFrame* videoFrame, MetadataStruct* metadata);
 };
 
@@ -112,19 +122,15 @@ private:
 	BMDDisplayMode m_displayMode;
 };
 
-class DeckLinkInputFrameArrivedEvent : public QEvent
+class DeckLinkSignalAlarmEvent : public QEvent
 {
 public:
-	DeckLinkInputFrameArrivedEvent(AncillaryDataStruct* ancillaryData, MetadataStruct* metadata, bool signalValid);
-	virtual ~DeckLinkInputFrameArrivedEvent() {}
+	DeckLinkSignalAlarmEvent(const SignalAlarmEvent& alarm);
+	virtual ~DeckLinkSignalAlarmEvent() {}
 
-	AncillaryDataStruct*	AncillaryData(void) const { return m_ancillaryData; }
-	MetadataStruct*			Metadata(void) const { return m_metadata; }
-	bool					SignalValid(void) const { return m_signalValid; }
+	const SignalAlarmEvent& Alarm() const { return m_alarm; }
 
 private:
-	AncillaryDataStruct*	m_ancillaryData;
-	MetadataStruct*			m_metadata;
-	bool					m_signalValid;
+	SignalAlarmEvent m_alarm;
 };
 
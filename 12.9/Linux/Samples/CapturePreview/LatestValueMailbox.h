@@ -0,0 +1,123 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+// Single producer, single consumer mailbox holding only the most recent value.
+// The producer never blocks or allocates: it writes into whichever of the two slots
+// is not currently published, using a per-slot sequence count so the consumer can
+// detect (and retry) the rare read that races with the producer lapping it.
+template<typename T>
+class LatestValueMailbox
+{
+	static_assert(std::is_trivially_copyable<T>::value, "LatestValueMailbox requires a POD value type");
+
+public:
+	LatestValueMailbox();
+
+	void		store(const T& value);
+	// Returns false if nothing newer than lastGeneration has been stored
+	bool		load(T& value, uint64_t& lastGeneration) const;
+	// Generation of the latest value, so a consumer can skip values stored before it started
+	uint64_t	generation() const { return m_generation.load(std::memory_order_acquire); }
+
+private:
+	struct Slot
+	{
+		std::atomic<uint32_t>	sequence;
+		T						value;
+	};
+
+	Slot						m_slots[2];
+	std::atomic<uint64_t>		m_generation;
+};
+
+template<typename T>
+LatestValueMailbox<T>::LatestValueMailbox() :
+	m_generation(0)
+{
+	m_slots[0].sequence = 0;
+	m_slots[1].sequence = 0;
+}
+
+template<typename T>
+void LatestValueMailbox<T>::store(const T& value)
+{
+	uint64_t	generation	= m_generation.load(std::memory_order_relaxed) + 1;
+	Slot&		slot		= m_slots[generation & 1];
+	uint32_t	sequence	= slot.sequence.load(std::memory_order_relaxed);
+
+	// An odd sequence marks the slot as being written
+	slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.value = value;
+	slot.sequence.store(sequence + 2, std::memory_order_release);
+
+	m_generation.store(generation, std::memory_order_release);
+}
+
+template<typename T>
+bool LatestValueMailbox<T>::load(T& value, uint64_t& lastGeneration) const
+{
+	for (;;)
+	{
+		uint64_t generation = m_generation.load(std::memory_order_acquire);
+		if (generation == lastGeneration)
+			return false;
+
+		const Slot&	slot		= m_slots[generation & 1];
+		uint32_t	sequence	= slot.sequence.load(std::memory_order_acquire);
+		if (sequence & 1)
+			continue;
+
+		value = slot.value;
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if (slot.sequence.load(std::memory_order_relaxed) == sequence)
+		{
+			lastGeneration = generation;
+			return true;
+		}
+	}
+}
@@ -0,0 +1,556 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "SignalAnalyzer.h"
+
+namespace
+{
+	const long		kSampledRows		= 128;
+	const float		kMinimumDbfs		= -120.0f;
+
+	// Rec.709 luma weights out of 256, for 8-bit RGB
+	const int		kRedWeight			= 54;
+	const int		kGreenWeight		= 183;
+	const int		kBlueWeight			= 19;
+
+	// Luma code values of the pixel format
+	struct LumaRange
+	{
+		uint32_t	black;
+		uint32_t	white;
+		uint32_t	maxCode;
+	};
+
+	// Luma statistics of the sampled rows, in code values
+	struct LumaStatistics
+	{
+		uint64_t	sum;
+		uint64_t	count;
+		uint64_t	bright;
+		uint32_t	min;
+		uint32_t	max;
+	};
+
+	// Fletcher style 64-bit sums over the row bytes taken as pairs of 64-bit words.
+	// Cheap enough to run alongside the statistics, and any change to the sampled
+	// rows changes the sums.
+	struct Fingerprint
+	{
+		uint64_t	a[2];
+		uint64_t	b[2];
+	};
+
+	inline uint64_t mix64(uint64_t x)
+	{
+		x ^= x >> 30;
+		x *= 0xBF58476D1CE4E5B9ULL;
+		x ^= x >> 27;
+		x *= 0x94D049BB133111EBULL;
+		return x ^ (x >> 31);
+	}
+
+	inline void addLuma(LumaStatistics& statistics, uint32_t luma, uint32_t threshold)
+	{
+		statistics.sum		+= luma;
+		statistics.count	+= 1;
+		statistics.bright	+= (luma > threshold) ? 1 : 0;
+		statistics.min		= std::min(statistics.min, luma);
+		statistics.max		= std::max(statistics.max, luma);
+	}
+
+	// Hashes whole 16 byte words, and a final partial word padded with zeros
+	void hashBytes(const uint8_t* bytes, size_t length, Fingerprint& fingerprint)
+	{
+		for (size_t offset = 0; offset < length; offset += 16)
+		{
+			uint64_t words[2] = { 0, 0 };
+			memcpy(words, bytes + offset, std::min<size_t>(16, length - offset));
+
+			for (int lane = 0; lane < 2; lane++)
+			{
+				fingerprint.a[lane] += words[lane];
+				fingerprint.b[lane] += fingerprint.a[lane];
+			}
+		}
+	}
+
+	inline uint32_t v210Luma(const uint32_t* group, int pixel)
+	{
+		// Luma sits in the middle of word 0 and 2, and at both ends of words 1 and 3
+		switch (pixel)
+		{
+			case 0:		return (group[0] >> 10) & 0x3ff;
+			case 1:		return group[1] & 0x3ff;
+			case 2:		return (group[1] >> 20) & 0x3ff;
+			case 3:		return (group[2] >> 10) & 0x3ff;
+			case 4:		return group[3] & 0x3ff;
+			default:	return (group[3] >> 20) & 0x3ff;
+		}
+	}
+
+	inline uint32_t rgbLuma(const uint8_t* pixel, const int* weights)
+	{
+		return (pixel[0] * weights[0] + pixel[1] * weights[1] + pixel[2] * weights[2] + pixel[3] * weights[3]) >> 8;
+	}
+
+#if defined(__SSE2__)
+	// Per-lane accumulation of one row, luma in 32-bit lanes with unused lanes zero
+	struct VectorAccumulator
+	{
+		__m128i		sum;
+		__m128i		max;
+		__m128i		maxInverted;		// Max of maxCode - luma, giving the min
+		__m128i		bright;
+		__m128i		threshold;
+		__m128i		maxCode;
+		__m128i		a;
+		__m128i		b;
+
+		VectorAccumulator(uint32_t thresholdValue, uint32_t maxCodeValue, const Fingerprint& fingerprint)
+		{
+			sum			= _mm_setzero_si128();
+			max			= _mm_setzero_si128();
+			maxInverted	= _mm_setzero_si128();
+			bright		= _mm_setzero_si128();
+			threshold	= _mm_set1_epi32((int)thresholdValue);
+			maxCode		= _mm_set1_epi32((int)maxCodeValue);
+			a			= _mm_loadu_si128((const __m128i*)fingerprint.a);
+			b			= _mm_loadu_si128((const __m128i*)fingerprint.b);
+		}
+
+		inline void add(__m128i luma, __m128i valid)
+		{
+			// Luma fits 16 bits, so 16-bit max works on the 32-bit lanes
+			sum			= _mm_add_epi32(sum, luma);
+			max			= _mm_max_epi16(max, luma);
+			maxInverted	= _mm_max_epi16(maxInverted, _mm_and_si128(_mm_xor_si128(luma, maxCode), valid));
+			bright		= _mm_sub_epi32(bright, _mm_cmpgt_epi32(luma, threshold));
+		}
+
+		inline void hash(__m128i bytes)
+		{
+			a = _mm_add_epi64(a, bytes);
+			b = _mm_add_epi64(b, a);
+		}
+
+		void finish(uint64_t count, uint32_t maxCodeValue, LumaStatistics& statistics, Fingerprint& fingerprint)
+		{
+			uint32_t lanes[4][4];
+			_mm_storeu_si128((__m128i*)lanes[0], sum);
+			_mm_storeu_si128((__m128i*)lanes[1], max);
+			_mm_storeu_si128((__m128i*)lanes[2], maxInverted);
+			_mm_storeu_si128((__m128i*)lanes[3], bright);
+
+			for (int lane = 0; lane < 4; lane++)
+			{
+				statistics.sum		+= lanes[0][lane];
+				statistics.bright	+= lanes[3][lane];
+				statistics.max		= std::max(statistics.max, lanes[1][lane]);
+				statistics.min		= std::min(statistics.min, maxCodeValue - lanes[2][lane]);
+			}
+			statistics.count += count;
+
+			_mm_storeu_si128((__m128i*)fingerprint.a, a);
+			_mm_storeu_si128((__m128i*)fingerprint.b, b);
+		}
+	};
+#endif
+
+	void analyzeV210Row(const uint8_t* row, long width, uint32_t threshold, LumaStatistics& statistics, Fingerprint& fingerprint)
+	{
+		long	groups = width / 6;
+		long	group = 0;
+
+#if defined(__SSE2__)
+		VectorAccumulator	accumulator(threshold, 0x3ff, fingerprint);
+		const __m128i		mask = _mm_set1_epi32(0x3ff);
+		const __m128i		evenLanes = _mm_set_epi32(0, -1, 0, -1);
+		const __m128i		oddLanes = _mm_set_epi32(-1, 0, -1, 0);
+
+		for (; group < groups; group++)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(row + group * 16));
+			accumulator.hash(v);
+
+			__m128i low		= _mm_and_si128(v, mask);
+			__m128i middle	= _mm_and_si128(_mm_srli_epi32(v, 10), mask);
+			__m128i high	= _mm_and_si128(_mm_srli_epi32(v, 20), mask);
+
+			accumulator.add(_mm_and_si128(middle, evenLanes), evenLanes);
+			accumulator.add(_mm_and_si128(low, oddLanes), oddLanes);
+			accumulator.add(_mm_and_si128(high, oddLanes), oddLanes);
+		}
+		accumulator.finish((uint64_t)groups * 6, 0x3ff, statistics, fingerprint);
+#else
+		hashBytes(row, groups * 16, fingerprint);
+#endif
+		for (; group < groups; group++)
+		{
+			const uint32_t* words = (const uint32_t*)(row + group * 16);
+			for (int pixel = 0; pixel < 6; pixel++)
+				addLuma(statistics, v210Luma(words, pixel), threshold);
+		}
+
+		// The last group is only partly used
+		if (width % 6 != 0)
+		{
+			const uint32_t* words = (const uint32_t*)(row + groups * 16);
+			for (int pixel = 0; pixel < width % 6; pixel++)
+				addLuma(statistics, v210Luma(words, pixel), threshold);
+			hashBytes(row + groups * 16, 16, fingerprint);
+		}
+	}
+
+	void analyze2vuyRow(const uint8_t* row, long width, uint32_t threshold, LumaStatistics& statistics, Fingerprint& fingerprint)
+	{
+		long	length = width * 2;
+		long	offset = 0;
+
+#if defined(__SSE2__)
+		VectorAccumulator	accumulator(threshold, 0xff, fingerprint);
+		const __m128i		zero = _mm_setzero_si128();
+		const __m128i		allLanes = _mm_set1_epi32(-1);
+
+		for (; offset + 16 <= length; offset += 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(row + offset));
+			accumulator.hash(v);
+
+			// Luma is the odd bytes
+			__m128i luma = _mm_srli_epi16(v, 8);
+			accumulator.add(_mm_unpacklo_epi16(luma, zero), allLanes);
+			accumulator.add(_mm_unpackhi_epi16(luma, zero), allLanes);
+		}
+		accumulator.finish((uint64_t)offset / 2, 0xff, statistics, fingerprint);
+#endif
+		hashBytes(row + offset, length - offset, fingerprint);
+		for (; offset < length; offset += 2)
+			addLuma(statistics, row[offset + 1], threshold);
+	}
+
+	void analyzeRGBRow(const uint8_t* row, long width, const int* weights, uint32_t threshold, LumaStatistics& statistics, Fingerprint& fingerprint)
+	{
+		long	length = width * 4;
+		long	offset = 0;
+
+#if defined(__SSE2__)
+		VectorAccumulator	accumulator(threshold, 0xff, fingerprint);
+		const __m128i		zero = _mm_setzero_si128();
+		const __m128i		allLanes = _mm_set1_epi32(-1);
+		const __m128i		weightVector = _mm_set_epi16(weights[3], weights[2], weights[1], weights[0], weights[3], weights[2], weights[1], weights[0]);
+
+		for (; offset + 16 <= length; offset += 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(row + offset));
+			accumulator.hash(v);
+
+			// Two weighted pairs per pixel, summed across lanes
+			__m128i low		= _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), weightVector);
+			__m128i high	= _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), weightVector);
+			__m128	first	= _mm_shuffle_ps(_mm_castsi128_ps(low), _mm_castsi128_ps(high), _MM_SHUFFLE(2, 0, 2, 0));
+			__m128	second	= _mm_shuffle_ps(_mm_castsi128_ps(low), _mm_castsi128_ps(high), _MM_SHUFFLE(3, 1, 3, 1));
+			__m128i luma	= _mm_srli_epi32(_mm_add_epi32(_mm_castps_si128(first), _mm_castps_si128(second)), 8);
+
+			accumulator.add(luma, allLanes);
+		}
+		accumulator.finish((uint64_t)offset / 4, 0xff, statistics, fingerprint);
+#endif
+		hashBytes(row + offset, length - offset, fingerprint);
+		for (; offset < length; offset += 4)
+			addLuma(statistics, rgbLuma(row + offset, weights), threshold);
+	}
+
+	float toDbfs(double level)
+	{
+		if (level <= 0.0)
+			return kMinimumDbfs;
+		return std::max(kMinimumDbfs, (float)(20.0 * std::log10(level)));
+	}
+}
+
+SignalAnalyzer::SignalAnalyzer()
+{
+	m_settings.blackLevel			= 0.02f;
+	m_settings.maxBrightFraction	= 0.01f;
+	m_settings.silenceLevel			= -60.0f;
+	m_settings.blackHoldSeconds		= 2.0;
+	m_settings.freezeHoldSeconds	= 2.0;
+	m_settings.silenceHoldSeconds	= 2.0;
+
+	reset();
+}
+
+bool SignalAnalyzer::isSupportedPixelFormat(BMDPixelFormat pixelFormat)
+{
+	return pixelFormat == bmdFormat8BitYUV || pixelFormat == bmdFormat10BitYUV ||
+		pixelFormat == bmdFormat8BitARGB || pixelFormat == bmdFormat8BitBGRA;
+}
+
+void SignalAnalyzer::reset()
+{
+	memset(&m_statistics, 0, sizeof(m_statistics));
+	m_hasFingerprint	= false;
+	m_lastFingerprint	= 0;
+	m_black				= { false, 0.0 };
+	m_freeze			= { false, 0.0 };
+	for (AlarmState& silence : m_silence)
+		silence = { false, 0.0 };
+}
+
+void SignalAnalyzer::updateAlarm(AlarmState& state, SignalAlarm alarm, int channel, bool condition, double seconds, double holdSeconds)
+{
+	SignalAlarmEvent event = { alarm, false, channel, 0.0 };
+
+	if (condition)
+	{
+		state.duration += seconds;
+		if (state.active || state.duration < holdSeconds)
+			return;
+
+		state.active	= true;
+		event.raised	= true;
+		event.duration	= state.duration;
+	}
+	else
+	{
+		bool wasActive = state.active;
+
+		event.duration	= state.duration;
+		state.active	= false;
+		state.duration	= 0.0;
+
+		if (!wasActive)
+			return;
+	}
+
+	if (m_alarmHandler)
+		m_alarmHandler(event);
+}
+
+void SignalAnalyzer::analyzeVideo(const void* bytes, long width, long height, long rowBytes, BMDPixelFormat pixelFormat, double frameSeconds)
+{
+	static const int	kBGRAWeights[4] = { kBlueWeight, kGreenWeight, kRedWeight, 0 };
+	static const int	kARGBWeights[4] = { 0, kRedWeight, kGreenWeight, kBlueWeight };
+	LumaRange			range;
+	LumaStatistics		statistics = { 0, 0, 0, UINT32_MAX, 0 };
+	Fingerprint			fingerprint = { { 0, 0 }, { 0, 0 } };
+
+	switch (pixelFormat)
+	{
+		case bmdFormat10BitYUV:
+			range = { 64, 940, 0x3ff };
+			break;
+		case bmdFormat8BitYUV:
+			range = { 16, 235, 0xff };
+			break;
+		case bmdFormat8BitARGB:
+		case bmdFormat8BitBGRA:
+			range = { 0, 255, 0xff };
+			break;
+		default:
+			videoMissing();
+			return;
+	}
+
+	uint32_t	threshold	= range.black + (uint32_t)(m_settings.blackLevel * (range.white - range.black));
+	long		rowStep		= std::max(1L, height / kSampledRows);
+
+	for (long y = rowStep / 2; y < height; y += rowStep)
+	{
+		const uint8_t* row = (const uint8_t*)bytes + y * rowBytes;
+
+		if (pixelFormat == bmdFormat10BitYUV)
+			analyzeV210Row(row, width, threshold, statistics, fingerprint);
+		else if (pixelFormat == bmdFormat8BitYUV)
+			analyze2vuyRow(row, width, threshold, statistics, fingerprint);
+		else
+			analyzeRGBRow(row, width, pixelFormat == bmdFormat8BitBGRA ? kBGRAWeights : kARGBWeights, threshold, statistics, fingerprint);
+	}
+
+	if (statistics.count == 0)
+	{
+		videoMissing();
+		return;
+	}
+
+	auto normalize = [&range](double code) { return (float)std::min(1.0, std::max(0.0, (code - range.black) / (range.white - range.black))); };
+
+	m_statistics.videoAnalyzed	= true;
+	m_statistics.lumaMean		= normalize((double)statistics.sum / statistics.count);
+	m_statistics.lumaMin		= normalize(statistics.min);
+	m_statistics.lumaMax		= normalize(statistics.max);
+	m_statistics.brightFraction	= (float)statistics.bright / statistics.count;
+	m_statistics.fingerprint	= mix64(fingerprint.a[0]) ^ mix64(fingerprint.a[1] + 1) ^ mix64(fingerprint.b[0] + 2) ^ mix64(fingerprint.b[1] + 3);
+
+	// A black picture is also a still one, only report it as black
+	bool black	= m_statistics.lumaMean <= m_settings.blackLevel && m_statistics.brightFraction <= m_settings.maxBrightFraction;
+	bool frozen	= !black && m_hasFingerprint && m_statistics.fingerprint == m_lastFingerprint;
+
+	m_hasFingerprint	= true;
+	m_lastFingerprint	= m_statistics.fingerprint;
+
+	updateAlarm(m_black, SignalAlarm::Black, -1, black, frameSeconds, m_settings.blackHoldSeconds);
+	updateAlarm(m_freeze, SignalAlarm::Freeze, -1, frozen, frameSeconds, m_settings.freezeHoldSeconds);
+
+	m_statistics.activeAlarms &= ~((1 << static_cast<int>(SignalAlarm::Black)) | (1 << static_cast<int>(SignalAlarm::Freeze)));
+	if (m_black.active)
+		m_statistics.activeAlarms |= 1 << static_cast<int>(SignalAlarm::Black);
+	if (m_freeze.active)
+		m_statistics.activeAlarms |= 1 << static_cast<int>(SignalAlarm::Freeze);
+}
+
+void SignalAnalyzer::videoMissing()
+{
+	// Frames without a picture are neither black nor frozen, keep the alarms as they are
+	m_statistics.videoAnalyzed	= false;
+	m_hasFingerprint			= false;
+}
+
+void SignalAnalyzer::analyzeAudio(const void* samples, uint32_t sampleFrameCount, int channels, BMDAudioSampleType sampleType, BMDAudioSampleRate sampleRate)
+{
+	double		sumSquares[kMaxAnalyzedAudioChannels] = {};
+	float		peaks[kMaxAnalyzedAudioChannels] = {};
+	int			analyzedChannels = std::min(channels, kMaxAnalyzedAudioChannels);
+	size_t		sampleCount = (size_t)sampleFrameCount * channels;
+	size_t		sample = 0;
+	float		scale = (sampleType == bmdAudioSampleType16bitInteger) ? 1.0f / 32768.0f : 1.0f / 2147483648.0f;
+
+	if (sampleFrameCount == 0 || channels <= 0)
+		return;
+
+#if defined(__SSE2__)
+	// Four consecutive samples per vector.  With 1, 2 or 4 channels one accumulator
+	// holds whole frames, with a multiple of 4 each group of 4 channels has its own.
+	if (channels <= kMaxAnalyzedAudioChannels && (channels % 4 == 0 || 4 % channels == 0))
+	{
+		const int		accumulatorCount = std::max(1, channels / 4);
+		const __m128	scaleVector = _mm_set1_ps(scale);
+		const __m128	absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		__m128			squares[4];
+		__m128			maxima[4];
+		int				accumulator = 0;
+
+		for (int i = 0; i < accumulatorCount; i++)
+		{
+			squares[i]	= _mm_setzero_ps();
+			maxima[i]	= _mm_setzero_ps();
+		}
+
+		for (; sample + 4 <= sampleCount; sample += 4)
+		{
+			__m128i v;
+			if (sampleType == bmdAudioSampleType16bitInteger)
+			{
+				v = _mm_loadl_epi64((const __m128i*)((const int16_t*)samples + sample));
+				v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+			}
+			else
+			{
+				v = _mm_loadu_si128((const __m128i*)((const int32_t*)samples + sample));
+			}
+
+			__m128 x = _mm_mul_ps(_mm_cvtepi32_ps(v), scaleVector);
+			squares[accumulator]	= _mm_add_ps(squares[accumulator], _mm_mul_ps(x, x));
+			maxima[accumulator]		= _mm_max_ps(maxima[accumulator], _mm_and_ps(x, absMask));
+
+			if (++accumulator == accumulatorCount)
+				accumulator = 0;
+		}
+
+		for (int i = 0; i < accumulatorCount; i++)
+		{
+			float laneSquares[4];
+			float laneMaxima[4];
+			_mm_storeu_ps(laneSquares, squares[i]);
+			_mm_storeu_ps(laneMaxima, maxima[i]);
+
+			for (int lane = 0; lane < 4; lane++)
+			{
+				int channel = (i * 4 + lane) % channels;
+				sumSquares[channel]	+= laneSquares[lane];
+				peaks[channel]		= std::max(peaks[channel], laneMaxima[lane]);
+			}
+		}
+	}
+#endif
+	for (; sample < sampleCount; sample++)
+	{
+		int channel = (int)(sample % channels);
+		if (channel >= analyzedChannels)
+			continue;
+
+		float x;
+		if (sampleType == bmdAudioSampleType16bitInteger)
+			x = ((const int16_t*)samples)[sample] * scale;
+		else
+			x = ((const int32_t*)samples)[sample] * scale;
+
+		sumSquares[channel]	+= x * x;
+		peaks[channel]		= std::max(peaks[channel], std::fabs(x));
+	}
+
+	double seconds = (double)sampleFrameCount / sampleRate;
+
+	m_statistics.audioChannels = analyzedChannels;
+	m_statistics.silentChannels = 0;
+
+	for (int channel = 0; channel < analyzedChannels; channel++)
+	{
+		m_statistics.audioRMS[channel]	= toDbfs(std::sqrt(sumSquares[channel] / sampleFrameCount));
+		m_statistics.audioPeak[channel]	= toDbfs(peaks[channel]);
+
+		updateAlarm(m_silence[channel], SignalAlarm::Silence, channel, m_statistics.audioRMS[channel] < m_settings.silenceLevel, seconds, m_settings.silenceHoldSeconds);
+		if (m_silence[channel].active)
+			m_statistics.silentChannels |= 1 << channel;
+	}
+
+	if (m_statistics.silentChannels != 0)
+		m_statistics.activeAlarms |= 1 << static_cast<int>(SignalAlarm::Silence);
+	else
+		m_statistics.activeAlarms &= ~(1 << static_cast<int>(SignalAlarm::Silence));
+}
@@ -0,0 +1,129 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "DeckLinkAPI.h"
+
+const int kMaxAnalyzedAudioChannels = 16;
+
+enum class SignalAlarm : int { Black, Freeze, Silence, Count };
+
+// Plain data, so the capture thread can publish it with the other frame data
+typedef struct {
+	bool		videoAnalyzed;			// False for no signal, or a pixel format that is not analysed
+	float		lumaMean;				// 0.0 is black and 1.0 white, over the sampled rows
+	float		lumaMin;
+	float		lumaMax;
+	float		brightFraction;			// Samples above the black level
+	uint64_t	fingerprint;
+	int			audioChannels;
+	float		audioRMS[kMaxAnalyzedAudioChannels];		// dBFS
+	float		audioPeak[kMaxAnalyzedAudioChannels];		// dBFS
+	uint32_t	activeAlarms;			// Bit mask of SignalAlarm
+	uint32_t	silentChannels;			// Bit mask of channels with a silence alarm
+} SignalStatistics;
+
+typedef struct {
+	SignalAlarm		alarm;
+	bool			raised;				// Otherwise cleared
+	int				channel;			// Audio channel for silence, otherwise -1
+	double			duration;			// Seconds the condition had lasted
+} SignalAlarmEvent;
+
+// Black picture, frozen picture and audio silence detection, run on the capture
+// thread directly on the captured buffers of 2vuy, v210, ARGB or BGRA frames.  Luma
+// statistics come from about 128 evenly spaced rows whatever the frame height, and
+// a 64-bit fingerprint of the same rows is compared between frames to find a frozen
+// picture.  Audio gets per-channel RMS and peak levels.  The kernels use SSE2 where
+// available.  An alarm is raised through the handler once its condition has lasted
+// the hold time, and cleared on the first frame or packet without it.
+class SignalAnalyzer
+{
+public:
+	using AlarmHandler = std::function<void(const SignalAlarmEvent&)>;
+
+	struct Settings
+	{
+		float	blackLevel;				// Luma at or below this is black
+		float	maxBrightFraction;		// Samples allowed above blackLevel, eg. for a logo
+		float	silenceLevel;			// dBFS RMS
+		double	blackHoldSeconds;
+		double	freezeHoldSeconds;
+		double	silenceHoldSeconds;
+	};
+
+	SignalAnalyzer();
+	virtual ~SignalAnalyzer() = default;
+
+	void	setAlarmHandler(const AlarmHandler& handler) { m_alarmHandler = handler; }
+	void	setSettings(const Settings& settings) { m_settings = settings; }
+	// Clears alarms and history, for a new capture or video format
+	void	reset(void);
+
+	void	analyzeVideo(const void* bytes, long width, long height, long rowBytes, BMDPixelFormat pixelFormat, double frameSeconds);
+	void	videoMissing(void);
+	void	analyzeAudio(const void* samples, uint32_t sampleFrameCount, int channels, BMDAudioSampleType sampleType, BMDAudioSampleRate sampleRate);
+
+	const SignalStatistics&	statistics() const { return m_statistics; }
+
+	static bool	isSupportedPixelFormat(BMDPixelFormat pixelFormat);
+
+private:
+	struct AlarmState
+	{
+		bool	active;
+		double	duration;
+	};
+
+	void	updateAlarm(AlarmState& state, SignalAlarm alarm, int channel, bool condition, double seconds, double holdSeconds);
+
+	Settings			m_settings;
+	AlarmHandler		m_alarmHandler;
+	SignalStatistics	m_statistics;
+	bool				m_hasFingerprint;
+	uint64_t			m_lastFingerprint;
+	AlarmState			m_black;
+	AlarmState			m_freeze;
+	AlarmState			m_silence[kMaxAnalyzedAudioChannels];
+};
@@ -0,0 +1,655 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <thread>
+#include "platform.h"
+#include "DisplayModeTables.h"
+#include "CapabilityMatrix.h"
+
+namespace
+{
+	const uint32_t	kCacheMagic		= 0x444C434D;	// 'DLCM'
+	const uint32_t	kCacheVersion	= 2;
+
+	struct PendingDevice
+	{
+		IDeckLink*	deckLink;
+		size_t		index;
+	};
+
+	int64_t getIntAttribute(IDeckLinkProfileAttributes* attributes, BMDDeckLinkAttributeID id, int64_t defaultValue)
+	{
+		int64_t value;
+		return (attributes->GetInt(id, &value) == S_OK) ? value : defaultValue;
+	}
+
+	bool getFlagAttribute(IDeckLinkProfileAttributes* attributes, BMDDeckLinkAttributeID id)
+	{
+		dlbool_t value;
+		return (attributes->GetFlag(id, &value) == S_OK) && value;
+	}
+
+	void readKey(IDeckLink* deckLink, int64_t apiVersion, DeviceCapabilities& capabilities)
+	{
+		IDeckLinkProfileAttributes* attributes = NULL;
+
+		capabilities.key.deviceID = 0;
+		capabilities.key.hasPersistentID = false;
+		capabilities.key.apiVersion = apiVersion;
+		capabilities.key.profileID = 0;
+		capabilities.topologicalID = 0;
+
+		if (deckLink->QueryInterface(IID_IDeckLinkProfileAttributes, (void**)&attributes) != S_OK)
+			return;
+
+		capabilities.topologicalID = getIntAttribute(attributes, BMDDeckLinkTopologicalID, 0);
+		capabilities.key.hasPersistentID = (attributes->GetInt(BMDDeckLinkPersistentID, &capabilities.key.deviceID) == S_OK);
+		if (!capabilities.key.hasPersistentID)
+			capabilities.key.deviceID = capabilities.topologicalID;
+		capabilities.key.profileID = getIntAttribute(attributes, BMDDeckLinkProfileID, 0);
+
+		attributes->Release();
+	}
+
+	template<typename DeckLinkIO>
+	void collectDisplayModes(DeckLinkIO* deckLinkIO, std::vector<IDeckLinkDisplayMode*>& modes, std::vector<DisplayModeInfo>& infos)
+	{
+		IDeckLinkDisplayModeIterator*	displayModeIterator = NULL;
+		IDeckLinkDisplayMode*			displayMode = NULL;
+
+		if (deckLinkIO->GetDisplayModeIterator(&displayModeIterator) != S_OK)
+			return;
+
+		while (displayModeIterator->Next(&displayMode) == S_OK)
+		{
+			DisplayModeInfo	info;
+			dlstring_t		nameString;
+			bool			known = false;
+
+			modes.push_back(displayMode);
+
+			info.displayMode = displayMode->GetDisplayMode();
+			for (const auto& existing : infos)
+				known |= (existing.displayMode == info.displayMode);
+
+			if (known)
+				continue;
+
+			if (displayMode->GetName(&nameString) == S_OK)
+			{
+				info.name = DlToStdString(nameString);
+				DeleteString(nameString);
+			}
+			info.width = (int32_t)displayMode->GetWidth();
+			info.height = (int32_t)displayMode->GetHeight();
+			displayMode->GetFrameRate(&info.frameDuration, &info.timeScale);
+			infos.push_back(info);
+		}
+
+		displayModeIterator->Release();
+	}
+
+	template<typename DeckLinkIO, typename ConversionMode>
+	void probeSetup(DeckLinkIO* deckLinkIO, const std::vector<IDeckLinkDisplayMode*>& modes, BMDVideoConnection connection, ConversionMode conversion, BMDSupportedVideoModeFlags flags, std::vector<ModeCapability>& capabilities)
+	{
+		for (auto displayMode : modes)
+		{
+			ModeCapability	capability;
+			uint32_t		bit = 1;
+
+			capability.connection		= connection;
+			capability.conversion		= conversion;
+			capability.flags			= flags;
+			capability.displayMode		= displayMode->GetDisplayMode();
+			capability.actualMode		= capability.displayMode;
+			capability.pixelFormatMask	= 0;
+
+			for (const auto& pixelFormat : gPixelFormats)
+			{
+				dlbool_t		supported;
+				BMDDisplayMode	actualMode;
+
+				if (deckLinkIO->DoesSupportVideoMode(connection, capability.displayMode, pixelFormat.first, conversion, flags, &actualMode, &supported) == S_OK && supported)
+				{
+					capability.pixelFormatMask |= bit;
+					if (actualMode != bmdModeUnknown)
+						capability.actualMode = actualMode;
+				}
+				bit <<= 1;
+			}
+
+			if (capability.pixelFormatMask != 0)
+				capabilities.push_back(capability);
+		}
+	}
+
+	// Same connection, conversion and flag combinations that DeviceList prints with --connections --conversions
+	void probeOutputModes(IDeckLink* deckLink, IDeckLinkProfileAttributes* attributes, DeviceCapabilities& capabilities)
+	{
+		IDeckLinkOutput*					deckLinkOutput = NULL;
+		std::vector<IDeckLinkDisplayMode*>	modes;
+
+		if (deckLink->QueryInterface(IID_IDeckLinkOutput, (void**)&deckLinkOutput) != S_OK)
+			return;
+
+		collectDisplayModes(deckLinkOutput, modes, capabilities.displayModes);
+
+		for (const auto& connection : gConnections)
+		{
+			if (connection.first != bmdVideoConnectionUnspecified && (capabilities.outputConnections & connection.first) == 0)
+				continue;
+
+			for (const auto& conversion : gOutputConversions)
+			{
+				if (connection.first == bmdVideoConnectionSDI || connection.first == bmdVideoConnectionOpticalSDI)
+				{
+					for (const auto& link : gSDILinks)
+					{
+						bool multilinkSupported = false;
+						if (link.first & bmdSupportedVideoModeSDIDualLink)
+						{
+							if (!(multilinkSupported = getFlagAttribute(attributes, BMDDeckLinkSupportsDualLinkSDI)))
+								continue;
+						}
+						else if (link.first & bmdSupportedVideoModeSDIQuadLink)
+						{
+							if (!(multilinkSupported = getFlagAttribute(attributes, BMDDeckLinkSupportsQuadLinkSDI)))
+								continue;
+						}
+
+						probeSetup(deckLinkOutput, modes, connection.first, conversion.first, link.first, capabilities.outputModes);
+						probeSetup(deckLinkOutput, modes, connection.first, conversion.first, (BMDSupportedVideoModeFlags)(link.first | bmdSupportedVideoModePsF), capabilities.outputModes);
+						if (multilinkSupported)
+						{
+							probeSetup(deckLinkOutput, modes, connection.first, conversion.first, (BMDSupportedVideoModeFlags)(link.first | bmdSupportedVideoModeDualStream3D), capabilities.outputModes);
+							probeSetup(deckLinkOutput, modes, connection.first, conversion.first, (BMDSupportedVideoModeFlags)(link.first | bmdSupportedVideoModePsF | bmdSupportedVideoModeDualStream3D), capabilities.outputModes);
+						}
+					}
+				}
+				else
+				{
+					probeSetup(deckLinkOutput, modes, connection.first, conversion.first, bmdSupportedVideoModeDefault, capabilities.outputModes);
+					probeSetup(deckLinkOutput, modes, connection.first, conversion.first, bmdSupportedVideoModePsF, capabilities.outputModes);
+					probeSetup(deckLinkOutput, modes, connection.first, conversion.first, bmdSupportedVideoModeDualStream3D, capabilities.outputModes);
+				}
+
+				if (capabilities.supportsKeying && conversion.first == bmdNoVideoOutputConversion &&
+					(connection.first == bmdVideoConnectionSDI || connection.first == bmdVideoConnectionOpticalSDI ||
+					connection.first == bmdVideoConnectionEthernet || connection.first == bmdVideoConnectionOpticalEthernet))
+				{
+					probeSetup(deckLinkOutput, modes, connection.first, conversion.first, bmdSupportedVideoModeKeying, capabilities.outputModes);
+				}
+			}
+		}
+
+		for (auto displayMode : modes)
+			displayMode->Release();
+		deckLinkOutput->Release();
+	}
+
+	void probeInputModes(IDeckLink* deckLink, DeviceCapabilities& capabilities)
+	{
+		IDeckLinkInput*						deckLinkInput = NULL;
+		std::vector<IDeckLinkDisplayMode*>	modes;
+
+		if (deckLink->QueryInterface(IID_IDeckLinkInput, (void**)&deckLinkInput) != S_OK)
+			return;
+
+		collectDisplayModes(deckLinkInput, modes, capabilities.displayModes);
+
+		for (const auto& connection : gConnections)
+		{
+			if (connection.first != bmdVideoConnectionUnspecified && (capabilities.inputConnections & connection.first) == 0)
+				continue;
+
+			for (const auto& conversion : gInputConversions)
+			{
+				probeSetup(deckLinkInput, modes, connection.first, conversion.first, bmdSupportedVideoModeDefault, capabilities.inputModes);
+				probeSetup(deckLinkInput, modes, connection.first, conversion.first, bmdSupportedVideoModePsF, capabilities.inputModes);
+				probeSetup(deckLinkInput, modes, connection.first, conversion.first, bmdSupportedVideoModeDualStream3D, capabilities.inputModes);
+				probeSetup(deckLinkInput, modes, connection.first, conversion.first, (BMDSupportedVideoModeFlags)(bmdSupportedVideoModePsF | bmdSupportedVideoModeDualStream3D), capabilities.inputModes);
+			}
+		}
+
+		for (auto displayMode : modes)
+			displayMode->Release();
+		deckLinkInput->Release();
+	}
+
+	void probeDevice(IDeckLink* deckLink, DeviceCapabilities& capabilities)
+	{
+		IDeckLinkProfileAttributes*	attributes = NULL;
+		dlstring_t					nameString;
+
+		if (deckLink->GetModelName(&nameString) == S_OK)
+		{
+			capabilities.modelName = DlToStdString(nameString);
+			DeleteString(nameString);
+		}
+
+		if (deckLink->GetDisplayName(&nameString) == S_OK)
+		{
+			capabilities.displayName = DlToStdString(nameString);
+			DeleteString(nameString);
+		}
+
+		if (deckLink->QueryInterface(IID_IDeckLinkProfileAttributes, (void**)&attributes) != S_OK)
+			return;
+
+		capabilities.duplexMode						= getIntAttribute(attributes, BMDDeckLinkDuplex, bmdDuplexInactive);
+		capabilities.videoIOSupport					= getIntAttribute(attributes, BMDDeckLinkVideoIOSupport, 0);
+		capabilities.inputConnections				= getIntAttribute(attributes, BMDDeckLinkVideoInputConnections, 0);
+		capabilities.outputConnections				= getIntAttribute(attributes, BMDDeckLinkVideoOutputConnections, 0);
+		capabilities.maxAudioChannels				= getIntAttribute(attributes, BMDDeckLinkMaximumAudioChannels, 0);
+		capabilities.supportsInputFormatDetection	= getFlagAttribute(attributes, BMDDeckLinkSupportsInputFormatDetection);
+		capabilities.supportsKeying					= getFlagAttribute(attributes, BMDDeckLinkSupportsInternalKeying) || getFlagAttribute(attributes, BMDDeckLinkSupportsExternalKeying);
+
+		// Sub-devices that are inactive in the current profile have no usable modes
+		if (capabilities.duplexMode != bmdDuplexInactive)
+		{
+			if (capabilities.videoIOSupport & bmdDeviceSupportsPlayback)
+				probeOutputModes(deckLink, attributes, capabilities);
+
+			if (capabilities.videoIOSupport & bmdDeviceSupportsCapture)
+				probeInputModes(deckLink, capabilities);
+		}
+
+		attributes->Release();
+	}
+
+	// Cache file serialization, host byte order
+
+	class CacheWriter
+	{
+	public:
+		CacheWriter(FILE* file) : m_file(file), m_ok(true) {}
+
+		template<typename T>
+		void put(const T& value) { m_ok &= (fwrite(&value, sizeof(value), 1, m_file) == 1); }
+
+		void putString(const std::string& value)
+		{
+			put((uint32_t)value.size());
+			m_ok &= (fwrite(value.data(), 1, value.size(), m_file) == value.size());
+		}
+
+		bool ok(void) const { return m_ok; }
+
+	private:
+		FILE*	m_file;
+		bool	m_ok;
+	};
+
+	class CacheReader
+	{
+	public:
+		CacheReader(FILE* file) : m_file(file), m_ok(true) {}
+
+		template<typename T>
+		T get(void)
+		{
+			T value = T();
+			m_ok &= (fread(&value, sizeof(value), 1, m_file) == 1);
+			return value;
+		}
+
+		std::string getString(void)
+		{
+			uint32_t size = get<uint32_t>();
+			if (!m_ok || size > (1 << 16))
+			{
+				m_ok = false;
+				return std::string();
+			}
+
+			std::string value(size, '\0');
+			m_ok &= (fread(&value[0], 1, size, m_file) == size);
+			return value;
+		}
+
+		uint32_t getCount(void)
+		{
+			uint32_t count = get<uint32_t>();
+			if (count > (1 << 20))
+				m_ok = false;
+			return m_ok ? count : 0;
+		}
+
+		bool ok(void) const { return m_ok; }
+
+	private:
+		FILE*	m_file;
+		bool	m_ok;
+	};
+
+	void writeModeCapabilities(CacheWriter& writer, const std::vector<ModeCapability>& capabilities)
+	{
+		writer.put((uint32_t)capabilities.size());
+		for (const auto& capability : capabilities)
+		{
+			writer.put((uint32_t)capability.connection);
+			writer.put(capability.conversion);
+			writer.put((uint32_t)capability.flags);
+			writer.put((uint32_t)capability.displayMode);
+			writer.put((uint32_t)capability.actualMode);
+			writer.put(capability.pixelFormatMask);
+		}
+	}
+
+	void readModeCapabilities(CacheReader& reader, std::vector<ModeCapability>& capabilities)
+	{
+		capabilities.resize(reader.getCount());
+		for (auto& capability : capabilities)
+		{
+			capability.connection		= (BMDVideoConnection)reader.get<uint32_t>();
+			capability.conversion		= reader.get<uint32_t>();
+			capability.flags			= (BMDSupportedVideoModeFlags)reader.get<uint32_t>();
+			capability.displayMode		= (BMDDisplayMode)reader.get<uint32_t>();
+			capability.actualMode		= (BMDDisplayMode)reader.get<uint32_t>();
+			capability.pixelFormatMask	= reader.get<uint32_t>();
+		}
+	}
+
+	void writeJSONString(FILE* file, const std::string& value)
+	{
+		fputc('"', file);
+		for (char c : value)
+		{
+			if (c == '"' || c == '\\')
+				fprintf(file, "\\%c", c);
+			else if ((unsigned char)c < 0x20)
+				fprintf(file, "\\u%04x", c);
+			else
+				fputc(c, file);
+		}
+		fputc('"', file);
+	}
+
+	void writeJSONModeCapabilities(FILE* file, const char* name, const std::vector<ModeCapability>& capabilities)
+	{
+		// [connection, conversion, flags, displayMode, actualMode, pixelFormatMask]
+		fprintf(file, ",\"%s\":[", name);
+		for (size_t i = 0; i < capabilities.size(); i++)
+		{
+			const ModeCapability& capability = capabilities[i];
+			fprintf(file, "%s[%u,%u,%u,%u,%u,%u]", i ? "," : "",
+					(uint32_t)capability.connection, capability.conversion, (uint32_t)capability.flags,
+					(uint32_t)capability.displayMode, (uint32_t)capability.actualMode, capability.pixelFormatMask);
+		}
+		fprintf(file, "]");
+	}
+}
+
+CapabilityMatrix::CapabilityMatrix() :
+	m_apiVersion(0)
+{
+}
+
+const DeviceCapabilities* CapabilityMatrix::find(const CapabilityKey& key) const
+{
+	// Devices without a stable identifier are always probed
+	if (key.deviceID == 0)
+		return NULL;
+
+	for (const auto& device : m_devices)
+	{
+		if (device.key == key)
+			return &device;
+	}
+
+	return NULL;
+}
+
+int CapabilityMatrix::build(IDeckLinkIterator* deckLinkIterator, const CapabilityMatrix* cache)
+{
+	IDeckLinkAPIInformation*	deckLinkAPIInformation = NULL;
+	IDeckLink*					deckLink = NULL;
+	std::vector<PendingDevice>	pendingDevices;
+	std::vector<std::thread>	probeThreads;
+
+	m_devices.clear();
+
+	if (deckLinkIterator->QueryInterface(IID_IDeckLinkAPIInformation, (void**)&deckLinkAPIInformation) == S_OK)
+	{
+		deckLinkAPIInformation->GetInt(BMDDeckLinkAPIVersion, &m_apiVersion);
+		deckLinkAPIInformation->Release();
+	}
+
+	while (deckLinkIterator->Next(&deckLink) == S_OK)
+	{
+		DeviceCapabilities			capabilities = DeviceCapabilities();
+		const DeviceCapabilities*	cached;
+
+		readKey(deckLink, m_apiVersion, capabilities);
+
+		cached = cache ? cache->find(capabilities.key) : NULL;
+		if (cached)
+		{
+			m_devices.push_back(*cached);
+			deckLink->Release();
+		}
+		else
+		{
+			pendingDevices.push_back({ deckLink, m_devices.size() });
+			m_devices.push_back(capabilities);
+		}
+	}
+
+	// Each device is probed on its own thread, m_devices is not resized from here on
+	for (const auto& pending : pendingDevices)
+	{
+		probeThreads.emplace_back([this, pending]()
+		{
+			probeDevice(pending.deckLink, m_devices[pending.index]);
+			pending.deckLink->Release();
+		});
+	}
+
+	for (auto& thread : probeThreads)
+		thread.join();
+
+	return (int)pendingDevices.size();
+}
+
+bool CapabilityMatrix::load(const char* path)
+{
+	FILE*	file = fopen(path, "rb");
+
+	m_devices.clear();
+
+	if (!file)
+		return false;
+
+	CacheReader reader(file);
+
+	if (reader.get<uint32_t>() != kCacheMagic || reader.get<uint32_t>() != kCacheVersion)
+	{
+		fclose(file);
+		return false;
+	}
+
+	m_apiVersion = reader.get<int64_t>();
+	m_devices.resize(reader.getCount());
+
+	for (auto& device : m_devices)
+	{
+		device.key.deviceID						= reader.get<int64_t>();
+		device.key.hasPersistentID				= reader.get<uint8_t>() != 0;
+		device.key.apiVersion					= reader.get<int64_t>();
+		device.key.profileID					= reader.get<int64_t>();
+		device.modelName						= reader.getString();
+		device.displayName						= reader.getString();
+		device.topologicalID					= reader.get<int64_t>();
+		device.duplexMode						= reader.get<int64_t>();
+		device.videoIOSupport					= reader.get<int64_t>();
+		device.inputConnections					= reader.get<int64_t>();
+		device.outputConnections				= reader.get<int64_t>();
+		device.maxAudioChannels					= reader.get<int64_t>();
+		device.supportsInputFormatDetection		= reader.get<uint8_t>() != 0;
+		device.supportsKeying					= reader.get<uint8_t>() != 0;
+
+		device.displayModes.resize(reader.getCount());
+		for (auto& displayMode : device.displayModes)
+		{
+			displayMode.displayMode		= (BMDDisplayMode)reader.get<uint32_t>();
+			displayMode.name			= reader.getString();
+			displayMode.width			= reader.get<int32_t>();
+			displayMode.height			= reader.get<int32_t>();
+			displayMode.frameDuration	= reader.get<int64_t>();
+			displayMode.timeScale		= reader.get<int64_t>();
+		}
+
+		readModeCapabilities(reader, device.outputModes);
+		readModeCapabilities(reader, device.inputModes);
+
+		if (!reader.ok())
+			break;
+	}
+
+	fclose(file);
+
+	if (!reader.ok())
+		m_devices.clear();
+
+	return reader.ok();
+}
+
+bool CapabilityMatrix::save(const char* path) const
+{
+	std::string	temporaryPath = std::string(path) + ".tmp";
+	FILE*		file = fopen(temporaryPath.c_str(), "wb");
+
+	if (!file)
+		return false;
+
+	CacheWriter writer(file);
+
+	writer.put(kCacheMagic);
+	writer.put(kCacheVersion);
+	writer.put(m_apiVersion);
+	writer.put((uint32_t)m_devices.size());
+
+	for (const auto& device : m_devices)
+	{
+		writer.put(device.key.deviceID);
+		writer.put((uint8_t)device.key.hasPersistentID);
+		writer.put(device.key.apiVersion);
+		writer.put(device.key.profileID);
+		writer.putString(device.modelName);
+		writer.putString(device.displayName);
+		writer.put(device.topologicalID);
+		writer.put(device.duplexMode);
+		writer.put(device.videoIOSupport);
+		writer.put(device.inputConnections);
+		writer.put(device.outputConnections);
+		writer.put(device.maxAudioChannels);
+		writer.put((uint8_t)device.supportsInputFormatDetection);
+		writer.put((uint8_t)device.supportsKeying);
+
+		writer.put((uint32_t)device.displayModes.size());
+		for (const auto& displayMode : device.displayModes)
+		{
+			writer.put((uint32_t)displayMode.displayMode);
+			writer.putString(displayMode.name);
+			writer.put(displayMode.width);
+			writer.put(displayMode.height);
+			writer.put((int64_t)displayMode.frameDuration);
+			writer.put((int64_t)displayMode.timeScale);
+		}
+
+		writeModeCapabilities(writer, device.outputModes);
+		writeModeCapabilities(writer, device.inputModes);
+	}
+
+	bool ok = writer.ok();
+	ok &= (fclose(file) == 0);
+
+	// Replace the previous cache atomically so concurrent readers never see a partial file
+	if (ok)
+		ok = (rename(temporaryPath.c_str(), path) == 0);
+	else
+		remove(temporaryPath.c_str());
+
+	return ok;
+}
+
+void CapabilityMatrix::writeJSON(FILE* file) const
+{
+	fprintf(file, "{\"apiVersion\":%lld,\"pixelFormats\":[", (long long)m_apiVersion);
+	for (auto it = gPixelFormats.begin(); it != gPixelFormats.end(); ++it)
+		fprintf(file, "%s%u", it == gPixelFormats.begin() ? "" : ",", (uint32_t)it->first);
+	fprintf(file, "],\"modeFields\":[\"connection\",\"conversion\",\"flags\",\"displayMode\",\"actualMode\",\"pixelFormatMask\"],\"devices\":[");
+
+	for (size_t i = 0; i < m_devices.size(); i++)
+	{
+		const DeviceCapabilities& device = m_devices[i];
+
+		fprintf(file, "%s\n{\"persistentID\":", i ? "," : "");
+		// The key falls back to the topological ID, which is reported separately
+		if (device.key.hasPersistentID)
+			fprintf(file, "%lld", (long long)device.key.deviceID);
+		else
+			fprintf(file, "null");
+		fprintf(file, ",\"topologicalID\":%lld,\"profileID\":%lld,\"modelName\":", (long long)device.topologicalID, (long long)device.key.profileID);
+		writeJSONString(file, device.modelName);
+		fprintf(file, ",\"displayName\":");
+		writeJSONString(file, device.displayName);
+		fprintf(file, ",\"duplex\":%lld,\"videoIOSupport\":%lld,\"inputConnections\":%lld,\"outputConnections\":%lld,\"maxAudioChannels\":%lld,\"inputFormatDetection\":%s,\"keying\":%s",
+				(long long)device.duplexMode, (long long)device.videoIOSupport, (long long)device.inputConnections, (long long)device.outputConnections,
+				(long long)device.maxAudioChannels, device.supportsInputFormatDetection ? "true" : "false", device.supportsKeying ? "true" : "false");
+
+		// [displayMode, name, width, height, frameDuration, timeScale]
+		fprintf(file, ",\"displayModes\":[");
+		for (size_t m = 0; m < device.displayModes.size(); m++)
+		{
+			const DisplayModeInfo& displayMode = device.displayModes[m];
+			fprintf(file, "%s[%u,", m ? "," : "", (uint32_t)displayMode.displayMode);
+			writeJSONString(file, displayMode.name);
+			fprintf(file, ",%d,%d,%lld,%lld]", displayMode.width, displayMode.height, (long long)displayMode.frameDuration, (long long)displayMode.timeScale);
+		}
+		fprintf(file, "]");
+
+		writeJSONModeCapabilities(file, "output", device.outputModes);
+		writeJSONModeCapabilities(file, "input", device.inputModes);
+		fprintf(file, "}");
+	}
+
+	fprintf(file, "\n]}\n");
+}
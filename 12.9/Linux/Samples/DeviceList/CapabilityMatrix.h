@@ -0,0 +1,123 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "DeckLinkAPI.h"
+
+// Identifies a device configuration whose capabilities can be reused.  Probed
+// results are only valid for the same device, driver version and active profile.
+struct CapabilityKey
+{
+	int64_t			deviceID;			// Persistent ID, or topological ID if not supported
+	bool			hasPersistentID;
+	int64_t			apiVersion;
+	int64_t			profileID;
+
+	bool operator==(const CapabilityKey& other) const
+	{
+		return deviceID == other.deviceID && hasPersistentID == other.hasPersistentID && apiVersion == other.apiVersion && profileID == other.profileID;
+	}
+};
+
+struct DisplayModeInfo
+{
+	BMDDisplayMode	displayMode;
+	std::string		name;
+	int32_t			width;
+	int32_t			height;
+	BMDTimeValue	frameDuration;
+	BMDTimeScale	timeScale;
+};
+
+// One supported (connection, conversion, flags, display mode) combination.
+// pixelFormatMask has bit i set if the i-th entry of gPixelFormats is supported.
+struct ModeCapability
+{
+	BMDVideoConnection			connection;
+	uint32_t					conversion;			// BMDVideoOutputConversionMode or BMDVideoInputConversionMode
+	BMDSupportedVideoModeFlags	flags;
+	BMDDisplayMode				displayMode;
+	BMDDisplayMode				actualMode;
+	uint32_t					pixelFormatMask;
+};
+
+struct DeviceCapabilities
+{
+	CapabilityKey				key;
+	std::string					modelName;
+	std::string					displayName;
+	int64_t						topologicalID;
+	int64_t						duplexMode;
+	int64_t						videoIOSupport;
+	int64_t						inputConnections;
+	int64_t						outputConnections;
+	int64_t						maxAudioChannels;
+	bool						supportsInputFormatDetection;
+	bool						supportsKeying;
+	std::vector<DisplayModeInfo>	displayModes;
+	std::vector<ModeCapability>		outputModes;
+	std::vector<ModeCapability>		inputModes;
+};
+
+class CapabilityMatrix
+{
+public:
+	CapabilityMatrix();
+
+	// Reuses cached entries whose key matches a present device, probes every other
+	// device on its own thread.  Returns the number of devices that were probed.
+	int		build(IDeckLinkIterator* deckLinkIterator, const CapabilityMatrix* cache);
+
+	bool	load(const char* path);
+	bool	save(const char* path) const;
+	void	writeJSON(FILE* file) const;
+
+	const std::vector<DeviceCapabilities>&	devices(void) const { return m_devices; }
+
+private:
+	const DeviceCapabilities*	find(const CapabilityKey& key) const;
+
+	int64_t							m_apiVersion;
+	std::vector<DeviceCapabilities>	m_devices;
+};
@@ -0,0 +1,109 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <list>
+#include <string>
+#include "DeckLinkAPI.h"
+
+// List of known pixel formats and their matching display names
+static const std::list<std::pair<BMDPixelFormat, std::string>> gPixelFormats =
+{
+	{ bmdFormat8BitYUV,     "8-bit YUV" },
+	{ bmdFormat10BitYUV,    "10-bit YUV" },
+	{ bmdFormat10BitYUVA,    "10-bit YUVA" },
+	{ bmdFormat8BitARGB,    "8-bit ARGB" },
+	{ bmdFormat8BitBGRA,    "8-bit BGRA" },
+	{ bmdFormat10BitRGB,    "10-bit RGB" },
+	{ bmdFormat12BitRGB,    "12-bit RGB" },
+	{ bmdFormat12BitRGBLE,  "12-bit RGBLE" },
+	{ bmdFormat10BitRGBXLE, "10-bit RGBXLE" },
+	{ bmdFormat10BitRGBX,   "10-bit RGBX" },
+};
+
+static const std::list<std::pair<BMDVideoConnection, std::string>> gConnections =
+{
+	{ bmdVideoConnectionUnspecified, "Unspecified Connection" },
+	{ bmdVideoConnectionSDI,         "SDI" },
+	{ bmdVideoConnectionHDMI,        "HDMI" },
+	{ bmdVideoConnectionOpticalSDI,  "Optical SDI" },
+	{ bmdVideoConnectionComponent,   "Component" },
+	{ bmdVideoConnectionComposite,   "Composite" },
+	{ bmdVideoConnectionSVideo,      "S-Video" },
+	{ bmdVideoConnectionEthernet,	 "Ethernet" },
+	{ bmdVideoConnectionOpticalEthernet,  "Optical Ethernet" },
+};
+
+static const std::list<std::pair<BMDSupportedVideoModeFlags, std::string>> gSDILinks =
+{
+	{ bmdSupportedVideoModeSDISingleLink,	"Single-Link" },
+	{ bmdSupportedVideoModeSDIDualLink,		"Dual-Link" },
+	{ bmdSupportedVideoModeSDIQuadLink,		"Quad-Link" },
+};
+
+static const std::list<std::pair<BMDVideoOutputConversionMode, std::string>> gOutputConversions =
+{
+	{ bmdNoVideoOutputConversion,                             "No Conversion" },
+	{ bmdVideoOutputLetterboxDownconversion,                  "Down-Conversion Letterbox (Software)" },
+	{ bmdVideoOutputAnamorphicDownconversion,                 "Down-Conversion Anamorphic (Software)" },
+	{ bmdVideoOutputHD720toHD1080Conversion,                  "Cross-Conversion 720 to 1080 (Software)" },
+	{ bmdVideoOutputHardwareLetterboxDownconversion,          "Down-Conversion Letterbox (Hardware)" },
+	{ bmdVideoOutputHardwareAnamorphicDownconversion,         "Down-Conversion Anamorphic (Hardware)" },
+	{ bmdVideoOutputHardwareCenterCutDownconversion,          "Down-Conversion Center Cut (Hardware)" },
+	{ bmdVideoOutputHardware720p1080pCrossconversion,         "Cross-Conversion 720p to/from 1080i (Hardware)" },
+	{ bmdVideoOutputHardwareAnamorphic720pUpconversion,       "Up-Conversion to 720p Anamorphic (Hardware)" },
+	{ bmdVideoOutputHardwareAnamorphic1080iUpconversion,      "Up-Conversion to 1080i Anamorphic (Hardware)" },
+	{ bmdVideoOutputHardwareAnamorphic149To720pUpconversion,  "Up-Conversion to 720p 14:9 Zoom (Hardware)" },
+	{ bmdVideoOutputHardwareAnamorphic149To1080iUpconversion, "Up-Conversion to 1080i 14:9 Zoom (Hardware)" },
+	{ bmdVideoOutputHardwarePillarbox720pUpconversion,        "Up-Conversion to 720p Pillarbox (Hardware)" },
+	{ bmdVideoOutputHardwarePillarbox1080iUpconversion,       "Up-Conversion to 1080i Pillarbox (Hardware)" },
+};
+
+static const std::list<std::pair<BMDVideoInputConversionMode, std::string>> gInputConversions =
+{
+	{ bmdNoVideoInputConversion,                       "No Conversion" },
+	{ bmdVideoInputLetterboxDownconversionFromHD1080,  "Down-Conversion from 1080 Letterbox (Software)" },
+	{ bmdVideoInputAnamorphicDownconversionFromHD1080, "Down-Conversion from 1080 Anamorphic (Software)" },
+	{ bmdVideoInputLetterboxDownconversionFromHD720,   "Down-Conversion from 720 Letterbox (Software)" },
+	{ bmdVideoInputAnamorphicDownconversionFromHD720,  "Down-Conversion from 720 Anamorphic (Software)" },
+	{ bmdVideoInputLetterboxUpconversion,              "Up-Conversion 16:9 Zoom (Software)" },
+	{ bmdVideoInputAnamorphicUpconversion,             "Up-Conversion Anamorphic (Software)" },
+};
@@ -43,44 +43,11 @@
 #include <map>
 #include <string>
 #include "platform.h"
+#include "DisplayModeTables.h"
+#include "CapabilityMatrix.h"
 
 #define kMaxHeaderLength 128
 
-// List of known pixel formats and their matching display names
-static const std::list<std::pair<BMDPixelFormat, std::string>> gPixelFormats =
-{
-	{ bmdFormat8BitYUV,     "8-bit YUV" },
-	{ bmdFormat10BitYUV,    "10-bit YUV" },
-	{ bmdFormat10BitYUVA,    "10-bit YUVA" },
-	{ bmdFormat8BitARGB,    "8-bit ARGB" },
-	{ bmdFormat8BitBGRA,    "8-bit BGRA" },
-	{ bmdFormat10BitRGB,    "10-bit RGB" },
-	{ bmdFormat12BitRGB,    "12-bit RGB" },
-	{ bmdFormat12BitRGBLE,  "12-bit RGBLE" },
-	{ bmdFormat10BitRGBXLE, "10-bit RGBXLE" },
-	{ bmdFormat10BitRGBX,   "10-bit RGBX" },
-};
-
-static const std::list<std::pair<BMDVideoConnection, std::string>> gConnections =
-{
-	{ bmdVideoConnectionUnspecified, "Unspecified Connection" },
-	{ bmdVideoConnectionSDI,         "SDI" },
-	{ bmdVideoConnectionHDMI,        "HDMI" },
-	{ bmdVideoConnectionOpticalSDI,  "Optical SDI" },
-	{ bmdVideoConnectionComponent,   "Component" },
-	{ bmdVideoConnectionComposite,   "Composite" },
-	{ bmdVideoConnectionSVideo,      "S-Video" },
-	{ bmdVideoConnectionEthernet,	 "Ethernet" },
-	{ bmdVideoConnectionOpticalEthernet,  "Optical Ethernet" },
-};
-
-static const std::list<std::pair<BMDSupportedVideoModeFlags, std::string>> gSDILinks =
-{
-	{ bmdSupportedVideoModeSDISingleLink,	"Single-Link" },
-	{ bmdSupportedVideoModeSDIDualLink,		"Dual-Link" },
-	{ bmdSupportedVideoModeSDIQuadLink,		"Quad-Link" },
-};
-
 static const std::map<uint32_t, const char*> gDuplexModes =
 {
 	{ bmdDuplexInactive, 	"Inactive" },
@@ -89,42 +56,14 @@ static const std::map<uint32_t, const char*> gDuplexModes =
 	{ bmdDuplexHalf, 		"Half" },
 };
 
-static const std::list<std::pair<BMDVideoOutputConversionMode, std::string>> gOutputConversions =
-{
-	{ bmdNoVideoOutputConversion,                             "No Conversion" },
-	{ bmdVideoOutputLetterboxDownconversion,                  "Down-Conversion Letterbox (Software)" },
-	{ bmdVideoOutputAnamorphicDownconversion,                 "Down-Conversion Anamorphic (Software)" },
-	{ bmdVideoOutputHD720toHD1080Conversion,                  "Cross-Conversion 720 to 1080 (Software)" },
-	{ bmdVideoOutputHardwareLetterboxDownconversion,          "Down-Conversion Letterbox (Hardware)" },
-	{ bmdVideoOutputHardwareAnamorphicDownconversion,         "Down-Conversion Anamorphic (Hardware)" },
-	{ bmdVideoOutputHardwareCenterCutDownconversion,          "Down-Conversion Center Cut (Hardware)" },
-	{ bmdVideoOutputHardware720p1080pCrossconversion,         "Cross-Conversion 720p to/from 1080i (Hardware)" },
-	{ bmdVideoOutputHardwareAnamorphic720pUpconversion,       "Up-Conversion to 720p Anamorphic (Hardware)" },
-	{ bmdVideoOutputHardwareAnamorphic1080iUpconversion,      "Up-Conversion to 1080i Anamorphic (Hardware)" },
-	{ bmdVideoOutputHardwareAnamorphic149To720pUpconversion,  "Up-Conversion to 720p 14:9 Zoom (Hardware)" },
-	{ bmdVideoOutputHardwareAnamorphic149To1080iUpconversion, "Up-Conversion to 1080i 14:9 Zoom (Hardware)" },
-	{ bmdVideoOutputHardwarePillarbox720pUpconversion,        "Up-Conversion to 720p Pillarbox (Hardware)" },
-	{ bmdVideoOutputHardwarePillarbox1080iUpconversion,       "Up-Conversion to 1080i Pillarbox (Hardware)" },
-};
-
-static const std::list<std::pair<BMDVideoInputConversionMode, std::string>> gInputConversions =
-{
-	{ bmdNoVideoInputConversion,                       "No Conversion" },
-	{ bmdVideoInputLetterboxDownconversionFromHD1080,  "Down-Conversion from 1080 Letterbox (Software)" },
-	{ bmdVideoInputAnamorphicDownconversionFromHD1080, "Down-Conversion from 1080 Anamorphic (Software)" },
-	{ bmdVideoInputLetterboxDownconversionFromHD720,   "Down-Conversion from 720 Letterbox (Software)" },
-	{ bmdVideoInputAnamorphicDownconversionFromHD720,  "Down-Conversion from 720 Anamorphic (Software)" },
-	{ bmdVideoInputLetterboxUpconversion,              "Up-Conversion 16:9 Zoom (Software)" },
-	{ bmdVideoInputAnamorphicUpconversion,             "Up-Conversion Anamorphic (Software)" },
-};
-
 enum PrintFlags : uint32_t
 {
 	kPrintDisplayModeConnections = (1 << 0),
 	kPrintDisplayModeConversions = (1 << 1),
 };
 
-void	parse_arguments(int argc, char** argv, uint32_t& printFlags);
+void	parse_arguments(int argc, char** argv, uint32_t& printFlags, const char*& jsonPath, const char*& cachePath);
+int		write_capability_matrix(IDeckLinkIterator* deckLinkIterator, const char* jsonPath, const char* cachePath);
 void	print_attributes (IDeckLink* deckLink, bool showConnectorAttributes);
 void	mode_name(IDeckLinkDisplayMode *displayMode, std::string& modeName);
 void	print_output_mode(IDeckLinkOutput* deckLinkOutput, BMDVideoConnection connection, BMDVideoOutputConversionMode conversion, BMDSupportedVideoModeFlags flags, IDeckLinkDisplayMode *displayMode, const char*& header);
@@ -143,9 +82,11 @@ int		main (int argc, char** argv)
 	IDeckLinkProfileAttributes*	deckLinkAttributes = NULL;
 	int							numDevices = 0;
 	uint32_t					printFlags = 0;
+	const char*					jsonPath = NULL;
+	const char*					cachePath = NULL;
 	HRESULT						result;
 
-	parse_arguments(argc, argv, printFlags);
+	parse_arguments(argc, argv, printFlags, jsonPath, cachePath);
 	
 	// Create an IDeckLinkIterator object to enumerate all DeckLink cards in the system
 	result = GetDeckLinkIterator(&deckLinkIterator);
@@ -154,6 +95,14 @@ int		main (int argc, char** argv)
 		fprintf(stderr, "A DeckLink iterator could not be created.  The DeckLink drivers may not be installed.\n");
 		return 1;
 	}
+
+	// Machine-readable capability matrix instead of the printed listing
+	if (jsonPath || cachePath)
+	{
+		int exitCode = write_capability_matrix(deckLinkIterator, jsonPath, cachePath);
+		deckLinkIterator->Release();
+		return exitCode;
+	}
 	
 	// We can get the version of the API like this:
 	result = deckLinkIterator->QueryInterface(IID_IDeckLinkAPIInformation, (void**)&deckLinkAPIInformation);
@@ -250,11 +199,15 @@ int		main (int argc, char** argv)
 	return 0;
 }
 
-void	parse_arguments(int argc, char** argv, uint32_t& printFlags)
+void	parse_arguments(int argc, char** argv, uint32_t& printFlags, const char*& jsonPath, const char*& cachePath)
 {
 	for (int i = 1; i < argc; ++i)
 	{
-		if (strcmp(argv[i], "--connections") == 0 || strcmp(argv[i], "-c") == 0)
+		if ((strcmp(argv[i], "--json") == 0 || strcmp(argv[i], "-j") == 0) && i + 1 < argc)
+			jsonPath = argv[++i];
+		else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+			cachePath = argv[++i];
+		else if (strcmp(argv[i], "--connections") == 0 || strcmp(argv[i], "-c") == 0)
 			printFlags |= kPrintDisplayModeConnections;
 		else if (strcmp(argv[i], "--conversions") == 0|| strcmp(argv[i], "-v") == 0)
 			printFlags |= kPrintDisplayModeConversions;
@@ -265,7 +218,10 @@ void	parse_arguments(int argc, char** argv, uint32_t& printFlags)
 			       "Options:\n"
 			       "    -h, --help           Display this help message\n"
 			       "    -c, --connections    Display the supported modes for each connection type\n"
-			       "    -v, --conversions    Display the supported modes for each conversion type\n", argv[0]);
+			       "    -v, --conversions    Display the supported modes for each conversion type\n"
+			       "    -j, --json <file>    Write the capability matrix of all devices as JSON, - for stdout\n"
+			       "        --cache <file>   Reuse capabilities cached for the same device, driver and profile,\n"
+			       "                         probe the remaining devices in parallel and update the cache\n", argv[0]);
 			exit(0);
 		}
 		else
@@ -276,6 +232,39 @@ void	parse_arguments(int argc, char** argv, uint32_t& printFlags)
 	}
 }
 
+int		write_capability_matrix(IDeckLinkIterator* deckLinkIterator, const char* jsonPath, const char* cachePath)
+{
+	CapabilityMatrix	cache;
+	CapabilityMatrix	matrix;
+	bool				cacheLoaded = false;
+	int					probedCount;
+
+	if (cachePath)
+		cacheLoaded = cache.load(cachePath);
+
+	probedCount = matrix.build(deckLinkIterator, cacheLoaded ? &cache : NULL);
+
+	if (cachePath && probedCount > 0 && !matrix.save(cachePath))
+		fprintf(stderr, "Could not write capability cache %s\n", cachePath);
+
+	if (jsonPath)
+	{
+		FILE* file = (strcmp(jsonPath, "-") == 0) ? stdout : fopen(jsonPath, "w");
+		if (!file)
+		{
+			fprintf(stderr, "Could not open %s\n", jsonPath);
+			return 1;
+		}
+
+		matrix.writeJSON(file);
+
+		if (file != stdout)
+			fclose(file);
+	}
+
+	return 0;
+}
+
 void	print_attributes (IDeckLink* deckLink, bool showConnectorAttributes)
 {
 	IDeckLinkProfileAttributes*			deckLinkAttributes = NULL;
@@ -48,6 +48,7 @@ INCLUDEPATH += .\
 }
 
 QT += widgets
+CONFIG += c++11
 
 TARGET = H265TestEncoder
 TEMPLATE = app
@@ -57,6 +58,8 @@ SOURCES += "src/main.cpp"\
            "src/ControllerImp.cpp"\
            "src/ControllerWidget.cpp"\
            "src/VideoWriter.cpp"\
+           "src/TransportStreamMuxer.cpp"\
+           "src/RecordingIndex.cpp"\
            "src/DeckLinkDevice.cpp"\
            "src/CommonGui.cpp"\
            "src/ColourPalette.cpp"\
@@ -67,6 +70,8 @@ HEADERS += "src/MainWindow.h"\
            "src/ControllerImp.h"\
            "src/ControllerWidget.h"\
            "src/VideoWriter.h"\
+           "src/TransportStreamMuxer.h"\
+           "src/RecordingIndex.h"\
            "src/DeckLinkDevice.h"\
            "src/CommonGui.h"\
            "src/ColourPalette.h"\
@@ -46,6 +46,8 @@ using namespace std;
 #include <QStandardPaths>
 #include <QTime>
 
+static const uint32_t kAudioChannelCount = 2;
+
 DeckLinkDevice::DeckLinkDevice(ControllerImp* ui, IDeckLink* device) :
 	m_deckLink(device),
 	m_deckLinkEncoderInput(NULL),
@@ -171,36 +173,46 @@ bool DeckLinkDevice::startCapture(int videoModeIndex, uint32_t bitrate)
 	m_modeList[videoModeIndex]->GetFrameRate(&duration, &timeScale);
 
 	QString filePath = QStandardPaths::writableLocation(QStandardPaths::MoviesLocation);
-	QString fileName = filePath + "/BlackmagicDesign_Recording " + QDateTime::currentDateTime().toString("yyyy-MM-dd HH.mm.ss") + ".hevc";
+	QString fileName = filePath + "/BlackmagicDesign_Recording " + QDateTime::currentDateTime().toString("yyyy-MM-dd HH.mm.ss") + ".ts";
 
-	m_videoWriter = new VideoWriter(fileName);
+	m_videoWriter = new VideoWriter(fileName.toStdString());
 	if (!m_videoWriter)
 	{
 		m_uiDelegate->showErrorMessage("Error starting recording", "Failed to allocate video writer");
 		return false;
 	}
 
-	if (!m_videoWriter->open())
+	// Audio is optional, record video only if the encoder cannot capture PCM.  From here on
+	// a failure disables the inputs and removes the file again through stopCapture().
+	uint32_t audioChannelCount = kAudioChannelCount;
+	if (m_deckLinkEncoderInput->EnableAudioInput(bmdAudioFormatPCM, bmdAudioSampleRate48kHz, bmdAudioSampleType32bitInteger, kAudioChannelCount) != S_OK)
+		audioChannelCount = 0;
+
+	if (!m_videoWriter->open(duration, timeScale, audioChannelCount))
 	{
 		m_uiDelegate->showErrorMessage("Error starting recording", "Failed to open output file");
+		stopCapture(true);
 		return false;
 	}
 
 	if (m_deckLinkEncoderConfiguration->SetInt(bmdDeckLinkEncoderConfigPreferredBitDepth, 10) != S_OK)
 	{
 		m_uiDelegate->showErrorMessage("Error starting recording", "Failed to set bit depth.");
+		stopCapture(true);
 		return false;
 	}
 
 	if (m_deckLinkEncoderConfiguration->SetInt(bmdDeckLinkEncoderConfigFrameCodingMode, bmdVideoEncoderFrameCodingModeInter) != S_OK)
 	{
 		m_uiDelegate->showErrorMessage("Failed to set frame coding mode.", "Error starting recording");
+		stopCapture(true);
 		return false;
 	}
 
 	if (m_deckLinkEncoderConfiguration->SetInt(bmdDeckLinkEncoderConfigH265TargetBitrate, bitrate) != S_OK)
 	{
 		m_uiDelegate->showErrorMessage("Error starting recording", "Failed to set target bit depth.");
+		stopCapture(true);
 		return false;
 	}
 
@@ -209,6 +221,7 @@ bool DeckLinkDevice::startCapture(int videoModeIndex, uint32_t bitrate)
 	if (hr != S_OK || ! supported)
 	{
 		m_uiDelegate->showErrorMessage("Error starting recording", "The encoder does not support the chosen video mode.");
+		stopCapture(true);
 		return false;
 	}
 
@@ -217,12 +230,14 @@ bool DeckLinkDevice::startCapture(int videoModeIndex, uint32_t bitrate)
 	if (m_deckLinkEncoderInput->EnableVideoInput(m_modeList[videoModeIndex]->GetDisplayMode(), bmdFormatH265, videoInputFlags) != S_OK)
 	{
 		m_uiDelegate->showErrorMessage("Error starting recording", "This application was unable to select the chosen video mode. Perhaps, the selected device is currently in-use.");
+		stopCapture(true);
 		return false;
 	}
 
 	if (m_deckLinkEncoderInput->StartStreams() != S_OK)
 	{
 		m_uiDelegate->showErrorMessage("Error starting the capture", "This application was unable to start the capture. Perhaps, the selected device is currently in-use.");
+		stopCapture(true);
 		return false;
 	}
 
@@ -236,12 +251,23 @@ void DeckLinkDevice::stopCapture(bool deleteFile)
 	m_deckLinkEncoderInput->StopStreams();
 	m_deckLinkEncoderInput->SetCallback(NULL);
 	m_deckLinkEncoderInput->DisableVideoInput();
+	m_deckLinkEncoderInput->DisableAudioInput();
 
 	if (m_videoWriter)
 	{
-		m_videoWriter->close(deleteFile);
+		bool		written			= m_videoWriter->close(deleteFile);
+		bool		indexWritten	= !m_videoWriter->indexWriteFailed();
+		uint64_t	droppedPackets	= m_videoWriter->droppedPacketCount();
+
 		delete m_videoWriter;
 		m_videoWriter = NULL;
+
+		if (!deleteFile && !written)
+			m_uiDelegate->showErrorMessage("Error recording", "The recording could not be written to disk and is incomplete.");
+		else if (!deleteFile && !indexWritten)
+			m_uiDelegate->showErrorMessage("Error recording", "The recording index could not be written to disk and does not cover the whole recording.");
+		else if (!deleteFile && droppedPackets > 0)
+			m_uiDelegate->showErrorMessage("Error recording", QString("The disk did not keep up with the encoder, %1 packets were dropped from the recording.").arg(droppedPackets));
 	}
 	
 	m_currentlyCapturing = false;
@@ -293,20 +319,17 @@ QString DeckLinkDevice::getDisplayModeName(int displayModeIndex)
 
 HRESULT DeckLinkDevice::VideoPacketArrived(IDeckLinkEncoderVideoPacket* videoPacket)
 {
-	void* buffer = NULL;
-	videoPacket->GetBytes(&buffer);
-
-	if (buffer && m_videoWriter)
-	{
-		if (videoPacket->GetPacketType() == bmdPacketTypeStreamData)
-			m_videoWriter->writeVideo((uint8_t*)buffer, videoPacket->GetSize());
-	}
+	if (m_videoWriter && videoPacket->GetPacketType() == bmdPacketTypeStreamData)
+		m_videoWriter->writeVideo(videoPacket);
 
 	return S_OK;
 }
 
-HRESULT DeckLinkDevice::AudioPacketArrived(IDeckLinkEncoderAudioPacket*)
+HRESULT DeckLinkDevice::AudioPacketArrived(IDeckLinkEncoderAudioPacket* audioPacket)
 {
+	if (m_videoWriter && audioPacket->GetPacketType() == bmdPacketTypeStreamData)
+		m_videoWriter->writeAudio(audioPacket);
+
 	return S_OK;
 }
 
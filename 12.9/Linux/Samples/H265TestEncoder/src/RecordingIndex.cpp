@@ -0,0 +1,137 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#include "RecordingIndex.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+void initRecordingIndexHeader(RecordingIndexHeader& header, uint32_t timeScale)
+{
+	memcpy(header.magic, "HVIX", sizeof(header.magic));
+	header.version = kRecordingIndexVersion;
+	header.timeScale = timeScale;
+	header.entrySize = sizeof(RecordingIndexEntry);
+}
+
+RecordingIndex::RecordingIndex() :
+	m_timeScale(0)
+{
+}
+
+bool RecordingIndex::load(const std::string& path)
+{
+	RecordingIndexHeader	header;
+	FILE*					file = fopen(path.c_str(), "rb");
+	bool					result = false;
+
+	m_entries.clear();
+	m_keyframes.clear();
+
+	if (!file)
+		return false;
+
+	if (fread(&header, sizeof(header), 1, file) == 1 &&
+		memcmp(header.magic, "HVIX", sizeof(header.magic)) == 0 &&
+		header.version == kRecordingIndexVersion &&
+		header.entrySize == sizeof(RecordingIndexEntry))
+	{
+		long start = ftell(file);
+		fseek(file, 0, SEEK_END);
+		// Ignore a trailing partial entry left by an interrupted recording
+		size_t count = (size_t)(ftell(file) - start) / sizeof(RecordingIndexEntry);
+		fseek(file, start, SEEK_SET);
+
+		m_entries.resize(count);
+		if (count == 0 || fread(m_entries.data(), sizeof(RecordingIndexEntry), count, file) == count)
+		{
+			m_timeScale = header.timeScale;
+			for (size_t i = 0; i < count; i++)
+			{
+				if (m_entries[i].flags & kRecordingIndexKeyframe)
+					m_keyframes.push_back(i);
+			}
+			result = true;
+		}
+		else
+		{
+			m_entries.clear();
+		}
+	}
+
+	fclose(file);
+	return result;
+}
+
+long RecordingIndex::findKeyframe(int64_t pts) const
+{
+	// IRAP pictures are never reordered, so keyframe presentation times are increasing
+	auto it = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), pts,
+							   [this](int64_t value, size_t index) { return value < m_entries[index].pts; });
+	if (it == m_keyframes.begin())
+		return -1;
+
+	return (long)*(it - 1);
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> RecordingIndex::segments(size_t segmentCount, uint64_t fileSize) const
+{
+	std::vector<std::pair<uint64_t, uint64_t>> ranges;
+
+	if (segmentCount == 0 || m_keyframes.empty())
+		return ranges;
+
+	// Choose the keyframe nearest each evenly spaced byte position
+	std::vector<uint64_t> starts;
+	starts.push_back(m_entries[m_keyframes.front()].offset);
+	for (size_t i = 1; i < segmentCount; i++)
+	{
+		uint64_t target = fileSize / segmentCount * i;
+		auto it = std::lower_bound(m_keyframes.begin(), m_keyframes.end(), target,
+								   [this](size_t index, uint64_t value) { return m_entries[index].offset < value; });
+		if (it != m_keyframes.end() && m_entries[*it].offset > starts.back())
+			starts.push_back(m_entries[*it].offset);
+	}
+
+	for (size_t i = 0; i < starts.size(); i++)
+		ranges.push_back(std::make_pair(starts[i], (i + 1 < starts.size()) ? starts[i + 1] : fileSize));
+
+	return ranges;
+}
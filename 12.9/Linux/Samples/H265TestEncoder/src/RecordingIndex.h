@@ -0,0 +1,101 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Sidecar index written next to each recording.  It is a fixed size header followed
+// by one entry per access unit in decode order, so a partially written index from an
+// interrupted recording remains usable.
+
+enum
+{
+	kRecordingIndexKeyframe		= 1 << 0,		// IRAP picture, decoding can start here
+	kRecordingIndexIDR			= 1 << 1,		// IDR picture, no leading pictures
+};
+
+struct RecordingIndexHeader
+{
+	char		magic[4];						// "HVIX"
+	uint32_t	version;
+	uint32_t	timeScale;
+	uint32_t	entrySize;
+};
+
+struct RecordingIndexEntry
+{
+	uint64_t	offset;							// Byte offset of the access unit (and preceding PAT/PMT) in the recording
+	int64_t		pts;
+	uint32_t	decodeDelay;					// pts - dts
+	uint32_t	flags;
+};
+
+static const uint32_t kRecordingIndexVersion = 1;
+
+void		initRecordingIndexHeader(RecordingIndexHeader& header, uint32_t timeScale);
+
+class RecordingIndex
+{
+public:
+	RecordingIndex();
+
+	bool						load(const std::string& path);
+
+	size_t						entryCount() const { return m_entries.size(); }
+	const RecordingIndexEntry&	entry(size_t index) const { return m_entries[index]; }
+	uint32_t					timeScale() const { return m_timeScale; }
+
+	// Returns the entry index of the last keyframe presented at or before pts, or -1
+	long						findKeyframe(int64_t pts) const;
+
+	// Splits the recording into at most segmentCount [begin, end) byte ranges which
+	// each start on a keyframe, for independent processing in parallel.
+	std::vector<std::pair<uint64_t, uint64_t>>	segments(size_t segmentCount, uint64_t fileSize) const;
+
+private:
+	std::vector<RecordingIndexEntry>	m_entries;
+	std::vector<size_t>					m_keyframes;
+	uint32_t							m_timeScale;
+};
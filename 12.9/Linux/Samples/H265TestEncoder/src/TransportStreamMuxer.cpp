@@ -0,0 +1,356 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#include "TransportStreamMuxer.h"
+#include <string.h>
+#include <algorithm>
+
+static const uint16_t	kPatPid					= 0x0000;
+static const uint16_t	kPmtPid					= 0x1000;
+static const uint16_t	kVideoPid				= 0x0100;
+static const uint16_t	kAudioPid				= 0x0101;
+static const uint16_t	kProgramNumber			= 1;
+
+static const uint8_t	kStreamTypeHEVC			= 0x24;
+static const uint8_t	kStreamTypePrivatePES	= 0x06;
+static const uint8_t	kStreamIdVideo			= 0xE0;
+static const uint8_t	kStreamIdPrivate1		= 0xBD;
+
+// Offset applied to PTS/DTS relative to the PCR so that decoders have time to buffer
+static const int64_t	kMuxDelay				= 63000;
+// Repeat PAT/PMT at least this often even if the stream contains no IRAP pictures
+static const uint32_t	kTableInterval			= 30;
+
+static const size_t		kAES3HeaderSize			= 4;
+static const size_t		kMaxPesPayload			= 65535 - 8;
+
+static uint32_t crc32Mpeg(const uint8_t* data, size_t size)
+{
+	uint32_t crc = 0xFFFFFFFF;
+	for (size_t i = 0; i < size; i++)
+	{
+		crc ^= (uint32_t)data[i] << 24;
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : (crc << 1);
+	}
+	return crc;
+}
+
+static inline uint8_t reverseBits(uint8_t value)
+{
+	value = (uint8_t)(((value & 0xF0) >> 4) | ((value & 0x0F) << 4));
+	value = (uint8_t)(((value & 0xCC) >> 2) | ((value & 0x33) << 2));
+	value = (uint8_t)(((value & 0xAA) >> 1) | ((value & 0x55) << 1));
+	return value;
+}
+
+static uint8_t* writeTimestamp(uint8_t* p, uint8_t prefix, int64_t timestamp)
+{
+	uint64_t ts = (uint64_t)timestamp & 0x1FFFFFFFFULL;
+	p[0] = (uint8_t)((prefix << 4) | ((ts >> 29) & 0x0E) | 0x01);
+	p[1] = (uint8_t)(ts >> 22);
+	p[2] = (uint8_t)(((ts >> 14) & 0xFE) | 0x01);
+	p[3] = (uint8_t)(ts >> 7);
+	p[4] = (uint8_t)(((ts << 1) & 0xFE) | 0x01);
+	return p + 5;
+}
+
+TransportStreamMuxer::TransportStreamMuxer(const PacketSink& sink) :
+	m_sink(sink),
+	m_audioChannelCount(0),
+	m_patContinuity(0),
+	m_pmtContinuity(0),
+	m_videoContinuity(0),
+	m_audioContinuity(0),
+	m_accessUnitsSinceTables(kTableInterval),
+	m_aes3FramingIndex(0)
+{
+}
+
+void TransportStreamMuxer::setAudioChannelCount(uint32_t channelCount)
+{
+	if (channelCount < 2)
+		m_audioChannelCount = 0;
+	else
+		m_audioChannelCount = std::min<uint32_t>(channelCount, 8) & ~1U;
+}
+
+void TransportStreamMuxer::writeVideoAccessUnit(const uint8_t* data, size_t size, int64_t pts, int64_t dts, bool randomAccess)
+{
+	if (randomAccess || m_accessUnitsSinceTables >= kTableInterval)
+	{
+		writeProgramTables();
+		m_accessUnitsSinceTables = 0;
+	}
+	m_accessUnitsSinceTables++;
+
+	writePes(kVideoPid, kStreamIdVideo, data, size, pts, dts, randomAccess, true);
+}
+
+void TransportStreamMuxer::writeAudioSamples(const int32_t* samples, uint32_t sampleFrameCount, uint32_t sourceChannelCount, int64_t pts)
+{
+	if (m_audioChannelCount == 0 || sourceChannelCount < m_audioChannelCount)
+		return;
+
+	// SMPTE 302M 24-bit: each channel pair packs into 7 bytes, bit-reversed, with the
+	// AES3 block start flag set on the first pair of every 192-frame block.
+	const size_t	bytesPerSampleFrame	= (m_audioChannelCount / 2) * 7;
+	const uint32_t	framesPerPes		= (uint32_t)((kMaxPesPayload - kAES3HeaderSize) / bytesPerSampleFrame);
+
+	for (uint32_t firstFrame = 0; firstFrame < sampleFrameCount; firstFrame += framesPerPes)
+	{
+		uint32_t	frameCount	= std::min(framesPerPes, sampleFrameCount - firstFrame);
+		size_t		dataSize	= frameCount * bytesPerSampleFrame;
+
+		m_audioPayload.resize(kAES3HeaderSize + dataSize);
+		uint8_t* o = m_audioPayload.data();
+
+		o[0] = (uint8_t)(dataSize >> 8);
+		o[1] = (uint8_t)dataSize;
+		o[2] = (uint8_t)(((m_audioChannelCount - 2) >> 1) << 6);
+		o[3] = 0x20;	// 24 bits per sample, no alignment bits
+		o += kAES3HeaderSize;
+
+		for (uint32_t frame = firstFrame; frame < firstFrame + frameCount; frame++)
+		{
+			const uint32_t*	s		= (const uint32_t*)samples + (size_t)frame * sourceChannelCount;
+			uint8_t			vucf	= (m_aes3FramingIndex == 0) ? 0x10 : 0;
+
+			for (uint32_t channel = 0; channel < m_audioChannelCount; channel += 2)
+			{
+				o[0] = reverseBits((uint8_t)((s[0] & 0x0000FF00) >> 8));
+				o[1] = reverseBits((uint8_t)((s[0] & 0x00FF0000) >> 16));
+				o[2] = reverseBits((uint8_t)((s[0] & 0xFF000000) >> 24));
+				o[3] = reverseBits((uint8_t)((s[1] & 0x00000F00) >> 4)) | vucf;
+				o[4] = reverseBits((uint8_t)((s[1] & 0x000FF000) >> 12));
+				o[5] = reverseBits((uint8_t)((s[1] & 0x0FF00000) >> 20));
+				o[6] = reverseBits((uint8_t)((s[1] & 0xF0000000) >> 28));
+				o += 7;
+				s += 2;
+			}
+
+			if (++m_aes3FramingIndex >= 192)
+				m_aes3FramingIndex = 0;
+		}
+
+		int64_t chunkPts = pts + ((int64_t)firstFrame * 90000) / 48000;
+		writePes(kAudioPid, kStreamIdPrivate1, m_audioPayload.data(), m_audioPayload.size(), chunkPts, chunkPts, false, false);
+	}
+}
+
+void TransportStreamMuxer::writeProgramTables()
+{
+	uint8_t		section[64];
+	uint8_t*	p;
+	uint32_t	crc;
+
+	// Program association table
+	p = section;
+	*p++ = 0x00;								// table_id
+	*p++ = 0xB0;								// section_syntax_indicator, section_length (patched below)
+	*p++ = 0x00;
+	*p++ = 0x00; *p++ = 0x01;					// transport_stream_id
+	*p++ = 0xC1;								// version 0, current_next_indicator
+	*p++ = 0x00;								// section_number
+	*p++ = 0x00;								// last_section_number
+	*p++ = (uint8_t)(kProgramNumber >> 8);
+	*p++ = (uint8_t)kProgramNumber;
+	*p++ = (uint8_t)(0xE0 | (kPmtPid >> 8));
+	*p++ = (uint8_t)kPmtPid;
+	section[2] = (uint8_t)(p - section + 4 - 3);
+	crc = crc32Mpeg(section, p - section);
+	*p++ = (uint8_t)(crc >> 24); *p++ = (uint8_t)(crc >> 16); *p++ = (uint8_t)(crc >> 8); *p++ = (uint8_t)crc;
+	writeSection(kPatPid, section, p - section);
+
+	// Program map table
+	p = section;
+	*p++ = 0x02;								// table_id
+	*p++ = 0xB0;
+	*p++ = 0x00;
+	*p++ = (uint8_t)(kProgramNumber >> 8);
+	*p++ = (uint8_t)kProgramNumber;
+	*p++ = 0xC1;
+	*p++ = 0x00;
+	*p++ = 0x00;
+	*p++ = (uint8_t)(0xE0 | (kVideoPid >> 8));	// PCR_PID
+	*p++ = (uint8_t)kVideoPid;
+	*p++ = 0xF0; *p++ = 0x00;					// program_info_length
+
+	*p++ = kStreamTypeHEVC;
+	*p++ = (uint8_t)(0xE0 | (kVideoPid >> 8));
+	*p++ = (uint8_t)kVideoPid;
+	*p++ = 0xF0; *p++ = 0x00;
+
+	if (m_audioChannelCount > 0)
+	{
+		*p++ = kStreamTypePrivatePES;
+		*p++ = (uint8_t)(0xE0 | (kAudioPid >> 8));
+		*p++ = (uint8_t)kAudioPid;
+		*p++ = 0xF0; *p++ = 0x06;				// ES_info_length
+		*p++ = 0x05; *p++ = 0x04;				// registration_descriptor
+		*p++ = 'B'; *p++ = 'S'; *p++ = 'S'; *p++ = 'D';
+	}
+
+	section[2] = (uint8_t)(p - section + 4 - 3);
+	crc = crc32Mpeg(section, p - section);
+	*p++ = (uint8_t)(crc >> 24); *p++ = (uint8_t)(crc >> 16); *p++ = (uint8_t)(crc >> 8); *p++ = (uint8_t)crc;
+	writeSection(kPmtPid, section, p - section);
+}
+
+void TransportStreamMuxer::writeSection(uint16_t pid, const uint8_t* section, size_t size)
+{
+	uint8_t		packet[kPacketSize];
+	uint8_t&	continuity = (pid == kPatPid) ? m_patContinuity : m_pmtContinuity;
+
+	memset(packet, 0xFF, sizeof(packet));
+	packet[0] = 0x47;
+	packet[1] = (uint8_t)(0x40 | (pid >> 8));
+	packet[2] = (uint8_t)pid;
+	packet[3] = (uint8_t)(0x10 | continuity);
+	packet[4] = 0x00;							// pointer_field
+	memcpy(packet + 5, section, size);
+
+	continuity = (continuity + 1) & 0x0F;
+	m_sink(packet);
+}
+
+void TransportStreamMuxer::writePes(uint16_t pid, uint8_t streamId, const uint8_t* payload, size_t size, int64_t pts, int64_t dts, bool randomAccess, bool withPcr)
+{
+	uint8_t		header[19];
+	uint8_t*	p			= header;
+	bool		withDts		= (dts != pts);
+	uint8_t&	continuity	= (pid == kVideoPid) ? m_videoContinuity : m_audioContinuity;
+
+	size_t headerDataLength	= withDts ? 10 : 5;
+	size_t pesLength		= 3 + headerDataLength + size;
+
+	*p++ = 0x00; *p++ = 0x00; *p++ = 0x01;
+	*p++ = streamId;
+	// A zero length is permitted for video elementary streams that exceed 64KB
+	if (pesLength > 0xFFFF)
+		pesLength = 0;
+	*p++ = (uint8_t)(pesLength >> 8);
+	*p++ = (uint8_t)pesLength;
+	*p++ = 0x84;								// data_alignment_indicator, every PES starts an access unit
+	*p++ = withDts ? 0xC0 : 0x80;
+	*p++ = (uint8_t)headerDataLength;
+	p = writeTimestamp(p, withDts ? 0x3 : 0x2, pts + kMuxDelay);
+	if (withDts)
+		p = writeTimestamp(p, 0x1, dts + kMuxDelay);
+
+	const size_t	headerSize	= p - header;
+	size_t			remaining	= headerSize + size;
+	size_t			position	= 0;
+	bool			first		= true;
+
+	while (remaining > 0)
+	{
+		uint8_t		packet[kPacketSize];
+		uint8_t*	q				= packet + 4;
+		size_t		adaptationSize	= 0;
+
+		packet[0] = 0x47;
+		packet[1] = (uint8_t)((first ? 0x40 : 0x00) | (pid >> 8));
+		packet[2] = (uint8_t)pid;
+
+		if (first && (withPcr || randomAccess))
+		{
+			q[1] = randomAccess ? 0x40 : 0x00;
+			adaptationSize = 2;
+			if (withPcr)
+			{
+				// The first decode times precede stream time zero when pictures are reordered
+				uint64_t pcrBase = (uint64_t)std::max<int64_t>(dts, 0) & 0x1FFFFFFFFULL;
+				q[1] |= 0x10;
+				q[2] = (uint8_t)(pcrBase >> 25);
+				q[3] = (uint8_t)(pcrBase >> 17);
+				q[4] = (uint8_t)(pcrBase >> 9);
+				q[5] = (uint8_t)(pcrBase >> 1);
+				q[6] = (uint8_t)(((pcrBase & 1) << 7) | 0x7E);
+				q[7] = 0x00;
+				adaptationSize += 6;
+			}
+		}
+
+		// Stuff the final packet through the adaptation field
+		if (remaining < kPacketSize - 4 - adaptationSize)
+		{
+			size_t stuffedSize = kPacketSize - 4 - remaining;
+			if (adaptationSize == 0 && stuffedSize >= 2)
+			{
+				q[1] = 0x00;
+				adaptationSize = 2;
+			}
+			else if (adaptationSize == 0)
+			{
+				adaptationSize = 1;
+			}
+			memset(q + adaptationSize, 0xFF, stuffedSize - adaptationSize);
+			adaptationSize = stuffedSize;
+		}
+
+		if (adaptationSize > 0)
+			q[0] = (uint8_t)(adaptationSize - 1);
+
+		packet[3] = (uint8_t)(((adaptationSize > 0) ? 0x30 : 0x10) | continuity);
+		continuity = (continuity + 1) & 0x0F;
+
+		q += adaptationSize;
+		size_t available = kPacketSize - (q - packet);
+		while (available > 0)
+		{
+			if (position < headerSize)
+			{
+				size_t count = std::min(available, headerSize - position);
+				memcpy(q, header + position, count);
+				q += count; position += count; available -= count; remaining -= count;
+			}
+			else
+			{
+				size_t count = std::min(available, headerSize + size - position);
+				memcpy(q, payload + (position - headerSize), count);
+				q += count; position += count; available -= count; remaining -= count;
+			}
+		}
+
+		first = false;
+		m_sink(packet);
+	}
+}
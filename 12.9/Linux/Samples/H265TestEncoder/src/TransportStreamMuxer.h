@@ -0,0 +1,80 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <vector>
+
+// Minimal MPEG-2 transport stream multiplexer for an H.265 elementary stream
+// with optional SMPTE 302M (AES3) PCM audio.  All timestamps are 90kHz.
+class TransportStreamMuxer
+{
+public:
+	static const size_t		kPacketSize = 188;
+
+	typedef std::function<void(const uint8_t* packet)>	PacketSink;
+
+	TransportStreamMuxer(const PacketSink& sink);
+
+	// Must be called before the first access unit is written.  Only even channel
+	// counts of 2-8 can be carried by SMPTE 302M, extra source channels are dropped.
+	void					setAudioChannelCount(uint32_t channelCount);
+
+	void					writeVideoAccessUnit(const uint8_t* data, size_t size, int64_t pts, int64_t dts, bool randomAccess);
+	void					writeAudioSamples(const int32_t* samples, uint32_t sampleFrameCount, uint32_t sourceChannelCount, int64_t pts);
+
+private:
+	void					writeProgramTables();
+	void					writeSection(uint16_t pid, const uint8_t* section, size_t size);
+	void					writePes(uint16_t pid, uint8_t streamId, const uint8_t* payload, size_t size, int64_t pts, int64_t dts, bool randomAccess, bool withPcr);
+
+	PacketSink				m_sink;
+	uint32_t				m_audioChannelCount;
+	uint8_t					m_patContinuity;
+	uint8_t					m_pmtContinuity;
+	uint8_t					m_videoContinuity;
+	uint8_t					m_audioContinuity;
+	uint32_t				m_accessUnitsSinceTables;
+	uint32_t				m_aes3FramingIndex;
+	std::vector<uint8_t>	m_audioPayload;
+};
@@ -39,52 +39,597 @@
  */
 
 #include "VideoWriter.h"
+#include <errno.h>
 #include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <limits>
 
-VideoWriter::VideoWriter(const QString& filename)
+static const BMDTimeScale	kTimeScale				= 90000;
+static const size_t			kRingSize				= 32 * 1024 * 1024;
+static const size_t			kRingAlignment			= 16;
+static const size_t			kQueueDepth				= 8192;
+// A whole number of transport packets that is also a multiple of the page size
+static const size_t			kOutputBufferSize		= TransportStreamMuxer::kPacketSize * 4096 * 2;
+static const size_t			kOutputBufferAlignment	= 4096;
+static const size_t			kIndexReserve			= 1024;
+
+static const uint8_t		kNalUnitTypeUnknown		= 0xFF;
+static const uint8_t		kNalUnitTypeSPS			= 33;
+static const uint8_t		kNalUnitTypeAUD			= 35;
+// Upper bound of sps_max_num_reorder_pics (MaxDpbSize - 1), assumed until an SPS is seen
+static const uint32_t		kMaxReorderPictures		= 15;
+static const uint8_t		kAccessUnitDelimiter[]	= { 0x00, 0x00, 0x00, 0x01, 0x46, 0x01, 0x50 };
+
+static inline bool isRandomAccessPoint(uint8_t nalUnitType)
+{
+	// BLA, IDR and CRA pictures (IRAP, nal_unit_type 16-23)
+	return nalUnitType >= 16 && nalUnitType <= 23;
+}
+
+static inline bool isIDR(uint8_t nalUnitType)
+{
+	// IDR_W_RADL and IDR_N_LP
+	return nalUnitType == 19 || nalUnitType == 20;
+}
+
+static bool writeFully(int fd, const void* buffer, size_t size)
+{
+	const uint8_t*	bytes	= (const uint8_t*)buffer;
+	size_t			written	= 0;
+
+	while (written < size)
+	{
+		ssize_t result = ::write(fd, bytes + written, size - written);
+		if (result < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		written += result;
+	}
+
+	return true;
+}
+
+static uint8_t parseNalUnitType(const uint8_t* data, size_t size)
+{
+	// Skip the Annex B start code prefix
+	size_t i = 0;
+	while (i < size && data[i] == 0x00)
+		i++;
+	if (i + 1 >= size || data[i] != 0x01)
+		return kNalUnitTypeUnknown;
+	return (data[i + 1] >> 1) & 0x3F;
+}
+
+// Reads the fields of an RBSP, skipping emulation prevention bytes
+class NalBitReader
+{
+public:
+	NalBitReader(const uint8_t* data, size_t size) :
+		m_data(data), m_size(size), m_position(0), m_byte(0), m_bitsLeft(0), m_zeroCount(0), m_overrun(false)
+	{
+	}
+
+	uint32_t readBits(int count)
+	{
+		uint32_t value = 0;
+		while (count-- > 0)
+			value = (value << 1) | readBit();
+		return value;
+	}
+
+	// Unsigned exp-Golomb code
+	uint32_t readUE()
+	{
+		int leadingZeros = 0;
+		while (readBit() == 0)
+		{
+			if (m_overrun || ++leadingZeros > 31)
+			{
+				m_overrun = true;
+				return 0;
+			}
+		}
+		return (uint32_t)(((uint64_t)1 << leadingZeros) - 1 + readBits(leadingZeros));
+	}
+
+	bool overrun() const { return m_overrun; }
+
+private:
+	uint32_t readBit()
+	{
+		if (m_bitsLeft == 0)
+		{
+			if (m_zeroCount >= 2 && m_position < m_size && m_data[m_position] == 0x03)
+			{
+				m_position++;
+				m_zeroCount = 0;
+			}
+			if (m_position >= m_size)
+			{
+				m_overrun = true;
+				return 0;
+			}
+			m_byte = m_data[m_position++];
+			m_zeroCount = (m_byte == 0) ? m_zeroCount + 1 : 0;
+			m_bitsLeft = 8;
+		}
+		m_bitsLeft--;
+		return (m_byte >> m_bitsLeft) & 1;
+	}
+
+	const uint8_t*	m_data;
+	size_t			m_size;
+	size_t			m_position;
+	uint8_t			m_byte;
+	int				m_bitsLeft;
+	int				m_zeroCount;
+	bool			m_overrun;
+};
+
+// Extracts sps_max_num_reorder_pics of the highest sub-layer from an Annex B SPS NAL unit
+static bool parseMaxReorderPictures(const uint8_t* data, size_t size, uint32_t& reorderPictures)
+{
+	size_t i = 0;
+	while (i < size && data[i] == 0x00)
+		i++;
+	// Start code suffix and the two byte NAL unit header
+	if (i + 3 >= size || data[i] != 0x01)
+		return false;
+
+	NalBitReader reader(data + i + 3, size - i - 3);
+
+	reader.readBits(4);										// sps_video_parameter_set_id
+	uint32_t maxSubLayersMinus1 = reader.readBits(3);
+	reader.readBits(1);										// sps_temporal_id_nesting_flag
+
+	// profile_tier_level(1, sps_max_sub_layers_minus1)
+	bool subLayerProfilePresent[8];
+	bool subLayerLevelPresent[8];
+	reader.readBits(32); reader.readBits(32); reader.readBits(24);	// general profile, 88 bits
+	reader.readBits(8);										// general_level_idc
+	for (uint32_t layer = 0; layer < maxSubLayersMinus1; layer++)
+	{
+		subLayerProfilePresent[layer] = reader.readBits(1) != 0;
+		subLayerLevelPresent[layer] = reader.readBits(1) != 0;
+	}
+	if (maxSubLayersMinus1 > 0)
+	{
+		for (uint32_t layer = maxSubLayersMinus1; layer < 8; layer++)
+			reader.readBits(2);								// reserved_zero_2bits
+	}
+	for (uint32_t layer = 0; layer < maxSubLayersMinus1; layer++)
+	{
+		if (subLayerProfilePresent[layer])
+		{
+			reader.readBits(32); reader.readBits(32); reader.readBits(24);
+		}
+		if (subLayerLevelPresent[layer])
+			reader.readBits(8);
+	}
+
+	reader.readUE();										// sps_seq_parameter_set_id
+	if (reader.readUE() == 3)								// chroma_format_idc
+		reader.readBits(1);									// separate_colour_plane_flag
+	reader.readUE();										// pic_width_in_luma_samples
+	reader.readUE();										// pic_height_in_luma_samples
+	if (reader.readBits(1))									// conformance_window_flag
+	{
+		for (int offset = 0; offset < 4; offset++)
+			reader.readUE();
+	}
+	reader.readUE();										// bit_depth_luma_minus8
+	reader.readUE();										// bit_depth_chroma_minus8
+	reader.readUE();										// log2_max_pic_order_cnt_lsb_minus4
+
+	// Without sub-layer ordering info only the values for the highest sub-layer are sent
+	uint32_t layer = reader.readBits(1) ? 0 : maxSubLayersMinus1;
+	uint32_t reorder = 0;
+	for (; layer <= maxSubLayersMinus1; layer++)
+	{
+		reader.readUE();									// sps_max_dec_pic_buffering_minus1
+		reorder = reader.readUE();							// sps_max_num_reorder_pics
+		reader.readUE();									// sps_max_latency_increase_plus1
+	}
+
+	if (reader.overrun() || reorder > kMaxReorderPictures)
+		return false;
+
+	reorderPictures = reorder;
+	return true;
+}
+
+VideoWriter::VideoWriter(const std::string& filename)
 :
-	m_filename(filename)
+	m_filename(filename),
+	m_indexFilename(filename + ".idx"),
+	m_fd(-1),
+	m_indexFd(-1),
+	m_audioChannelCount(0),
+	m_ringWrite(0),
+	m_ringUsed(0),
+	m_queueHead(0),
+	m_queueCount(0),
+	m_stopping(false),
+	m_droppedPackets(0),
+	m_muxer([this](const uint8_t* packet) { writeTransportPacket(packet); }),
+	m_accessUnitPts(0),
+	m_accessUnitFlags(0),
+	m_frameDuration(0),
+	m_frameTimeScale(0),
+	m_reorderPictures(kMaxReorderPictures),
+	m_dtsOrigin(0),
+	m_decodeIndex(0),
+	m_lastDts(std::numeric_limits<int64_t>::min()),
+	m_outputBuffer(NULL),
+	m_outputSize(0),
+	m_transportBytes(0),
+	m_writeFailed(false),
+	m_indexWriteFailed(false)
 {
 }
 
 VideoWriter::~VideoWriter()
 {	
+	if (m_fd >= 0)
+		close();
 }
 
-bool VideoWriter::writeVideo(uint8_t* buffer, uint32_t length)
+bool VideoWriter::writeVideo(IDeckLinkEncoderVideoPacket* packet)
 {
-	fwrite(buffer, 1, length, m_file);
-	return true;
+	void*					bytes			= NULL;
+	BMDTimeValue			streamTime		= 0;
+	uint8_t					nalUnitType		= kNalUnitTypeUnknown;
+	IDeckLinkH265NALPacket*	nalPacket		= NULL;
+
+	if (packet->GetBytes(&bytes) != S_OK || !bytes)
+		return false;
+
+	if (packet->GetStreamTime(&streamTime, kTimeScale) != S_OK)
+		return false;
+
+	if (packet->QueryInterface(IID_IDeckLinkH265NALPacket, (void**)&nalPacket) == S_OK)
+	{
+		if (nalPacket->GetUnitType(&nalUnitType) != S_OK)
+			nalUnitType = kNalUnitTypeUnknown;
+		nalPacket->Release();
+	}
+
+	return enqueuePacket(kVideoPacket, bytes, packet->GetSize(), streamTime, nalUnitType);
+}
+
+bool VideoWriter::writeAudio(IDeckLinkEncoderAudioPacket* packet)
+{
+	void*			bytes		= NULL;
+	BMDTimeValue	streamTime	= 0;
+
+	if (m_audioChannelCount == 0)
+		return false;
+
+	if (packet->GetBytes(&bytes) != S_OK || !bytes)
+		return false;
+
+	if (packet->GetStreamTime(&streamTime, kTimeScale) != S_OK)
+		return false;
+
+	return enqueuePacket(kAudioPacket, bytes, packet->GetSize(), streamTime, kNalUnitTypeUnknown);
 }
 
-bool VideoWriter::writeAudio(uint64_t)
+bool VideoWriter::enqueuePacket(PacketKind kind, const void* bytes, size_t size, int64_t streamTime, uint8_t nalUnitType)
 {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	size_t alignedSize	= (size + kRingAlignment - 1) & ~(kRingAlignment - 1);
+	size_t offset		= m_ringWrite;
+	size_t padding		= 0;
+
+	if (m_stopping || alignedSize > m_ring.size())
+		return false;
+
+	// Packets are stored contiguously, skip the tail of the ring if this one doesn't fit
+	if (offset + alignedSize > m_ring.size())
+	{
+		padding = m_ring.size() - offset;
+		offset = 0;
+	}
+
+	if (m_queueCount == m_queue.size() || m_ringUsed + padding + alignedSize > m_ring.size())
+	{
+		// Never block the encoder callback, the writer is not keeping up with the stream
+		m_droppedPackets++;
+		return false;
+	}
+
+	memcpy(&m_ring[offset], bytes, size);
+
+	QueuedPacket& entry = m_queue[(m_queueHead + m_queueCount) % m_queue.size()];
+	entry.kind			= kind;
+	entry.offset		= offset;
+	entry.size			= size;
+	entry.releaseSize	= padding + alignedSize;
+	entry.streamTime	= streamTime;
+	entry.nalUnitType	= nalUnitType;
+
+	m_queueCount++;
+	m_ringUsed += padding + alignedSize;
+	m_ringWrite = offset + alignedSize;
+
+	m_queueCondition.notify_one();
 	return true;
 }
 
+void VideoWriter::writerThread()
+{
+	for (;;)
+	{
+		QueuedPacket packet;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_queueCondition.wait(lock, [this]{ return m_queueCount > 0 || m_stopping; });
+			if (m_queueCount == 0)
+				break;
+			packet = m_queue[m_queueHead];
+		}
+
+		// The ring region stays owned by this thread until it is released below
+		muxPacket(packet);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queueHead = (m_queueHead + 1) % m_queue.size();
+			m_queueCount--;
+			m_ringUsed -= packet.releaseSize;
+		}
+	}
+
+	flushAccessUnit();
+	flushOutputBuffer();
+}
+
+void VideoWriter::muxPacket(const QueuedPacket& packet)
+{
+	const uint8_t* data = &m_ring[packet.offset];
+
+	if (packet.kind == kAudioPacket)
+	{
+		uint32_t sampleFrameCount = (uint32_t)(packet.size / (sizeof(int32_t) * m_audioChannelCount));
+		m_muxer.writeAudioSamples((const int32_t*)data, sampleFrameCount, m_audioChannelCount, packet.streamTime);
+		return;
+	}
+
+	uint8_t nalUnitType = packet.nalUnitType;
+	if (nalUnitType == kNalUnitTypeUnknown)
+		nalUnitType = parseNalUnitType(data, packet.size);
+
+	// The encoder delivers one NAL unit per packet, group them into access units by stream time
+	if (nalUnitType == kNalUnitTypeAUD || (!m_accessUnit.empty() && packet.streamTime != m_accessUnitPts))
+		flushAccessUnit();
+
+	if (m_accessUnit.empty())
+	{
+		m_accessUnitPts = packet.streamTime;
+		m_accessUnitFlags = 0;
+		// HEVC in MPEG-TS requires each access unit to start with a delimiter
+		if (nalUnitType != kNalUnitTypeAUD)
+			m_accessUnit.insert(m_accessUnit.end(), kAccessUnitDelimiter, kAccessUnitDelimiter + sizeof(kAccessUnitDelimiter));
+	}
+
+	if (isRandomAccessPoint(nalUnitType))
+		m_accessUnitFlags |= kRecordingIndexKeyframe;
+	if (isIDR(nalUnitType))
+		m_accessUnitFlags |= kRecordingIndexIDR;
+	if (nalUnitType == kNalUnitTypeSPS)
+		parseMaxReorderPictures(data, packet.size, m_reorderPictures);
+
+	m_accessUnit.insert(m_accessUnit.end(), data, data + packet.size);
+}
+
+void VideoWriter::flushAccessUnit()
+{
+	if (m_accessUnit.empty())
+		return;
+
+	// Stream time is in presentation order.  Decode time advances by one frame per access
+	// unit and starts the SPS reorder depth before the first presentation time, so no
+	// picture can be decoded after it is presented.  Nothing preceding an IDR picture in
+	// decode order is presented after it, so the timeline is moved forward there to
+	// absorb frames dropped by the encoder.
+	int64_t pts = m_accessUnitPts;
+	int64_t dts = m_dtsOrigin + frameTime((int64_t)m_decodeIndex - m_reorderPictures);
+	int64_t idrDts = pts - frameTime(m_reorderPictures);
+	if (m_lastDts == std::numeric_limits<int64_t>::min() || ((m_accessUnitFlags & kRecordingIndexIDR) && idrDts > dts))
+	{
+		m_dtsOrigin = pts;
+		m_decodeIndex = 0;
+		dts = idrDts;
+	}
+	m_decodeIndex++;
+
+	// A change of reorder depth at a CRA picture, or the frame duration being rounded to
+	// the 90kHz clock, must still never let DTS run backwards or pass PTS
+	if (dts <= m_lastDts)
+		dts = m_lastDts + 1;
+	dts = std::min(dts, pts);
+	m_lastDts = dts;
+
+	RecordingIndexEntry entry;
+	entry.offset = m_transportBytes;
+	entry.pts = pts;
+	entry.decodeDelay = (uint32_t)(pts - dts);
+	entry.flags = m_accessUnitFlags;
+
+	m_muxer.writeVideoAccessUnit(m_accessUnit.data(), m_accessUnit.size(), pts, dts, (m_accessUnitFlags & kRecordingIndexKeyframe) != 0);
+	m_accessUnit.clear();
+
+	m_indexEntries.push_back(entry);
+}
+
+int64_t VideoWriter::frameTime(int64_t frameCount) const
+{
+	return frameCount * m_frameDuration * kTimeScale / m_frameTimeScale;
+}
+
+void VideoWriter::writeTransportPacket(const uint8_t* packet)
+{
+	memcpy(m_outputBuffer + m_outputSize, packet, TransportStreamMuxer::kPacketSize);
+	m_outputSize += TransportStreamMuxer::kPacketSize;
+	m_transportBytes += TransportStreamMuxer::kPacketSize;
+
+	if (m_outputSize == kOutputBufferSize)
+		flushOutputBuffer();
+}
+
+bool VideoWriter::flushOutputBuffer()
+{
+	if (!m_writeFailed && !writeFully(m_fd, m_outputBuffer, m_outputSize))
+		m_writeFailed = true;
+
+	m_outputSize = 0;
+
+	// Index entries are only written once the access units they refer to are in the file
+	if (!m_writeFailed)
+		flushIndex();
+
+	return !m_writeFailed;
+}
+
+bool VideoWriter::flushIndex()
+{
+	bool result = true;
+
+	if (m_indexFd >= 0 && !m_indexEntries.empty())
+		result = writeFully(m_indexFd, m_indexEntries.data(), m_indexEntries.size() * sizeof(RecordingIndexEntry));
+
+	// Entries after a failed write would be out of step with the file, so stop there
+	if (!result)
+	{
+		::close(m_indexFd);
+		m_indexFd = -1;
+		m_indexWriteFailed = true;
+	}
+
+	m_indexEntries.clear();
+	return result;
+}
+
 bool VideoWriter::addVideoStream()
 {
+	m_accessUnit.clear();
+	m_accessUnit.reserve(4 * 1024 * 1024);
+	m_reorderPictures = kMaxReorderPictures;
+	m_dtsOrigin = 0;
+	m_decodeIndex = 0;
+	m_lastDts = std::numeric_limits<int64_t>::min();
 	return true;
 }
 
 bool VideoWriter::addAudioStream()
 {
+	m_muxer.setAudioChannelCount(m_audioChannelCount);
 	return true;
 }
 
-bool VideoWriter::open()
+bool VideoWriter::open(BMDTimeValue frameDuration, BMDTimeScale frameTimeScale, uint32_t audioChannelCount)
 {
-	m_file = fopen(m_filename.toStdString().c_str(), "wb");
-	if (!m_file)
+	void* outputBuffer = NULL;
+
+	if (frameDuration <= 0 || frameTimeScale <= 0)
 		return false;
-	
+
+	m_fd = ::open(m_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (m_fd < 0)
+		return false;
+
+	if (posix_memalign(&outputBuffer, kOutputBufferAlignment, kOutputBufferSize) != 0)
+	{
+		::close(m_fd);
+		m_fd = -1;
+		return false;
+	}
+
+	m_outputBuffer = (uint8_t*)outputBuffer;
+	m_outputSize = 0;
+	m_transportBytes = 0;
+	m_writeFailed = false;
+	m_indexWriteFailed = false;
+
+	// The recording is still usable without its index, so failing to create it is only
+	// reported when the recording is closed
+	RecordingIndexHeader indexHeader;
+	initRecordingIndexHeader(indexHeader, kTimeScale);
+	m_indexFd = ::open(m_indexFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (m_indexFd < 0 || !writeFully(m_indexFd, &indexHeader, sizeof(indexHeader)))
+	{
+		if (m_indexFd >= 0)
+			::close(m_indexFd);
+		m_indexFd = -1;
+		m_indexWriteFailed = true;
+	}
+	m_indexEntries.clear();
+	m_indexEntries.reserve(kIndexReserve);
+
+	m_ring.assign(kRingSize, 0);
+	m_queue.resize(kQueueDepth);
+	m_ringWrite = 0;
+	m_ringUsed = 0;
+	m_queueHead = 0;
+	m_queueCount = 0;
+	m_stopping = false;
+	m_droppedPackets = 0;
+
+	m_frameDuration = frameDuration;
+	m_frameTimeScale = frameTimeScale;
+	m_audioChannelCount = audioChannelCount;
+	if (!addVideoStream() || !addAudioStream())
+	{
+		close(true);
+		return false;
+	}
+
+	m_thread = std::thread(&VideoWriter::writerThread, this);
 	return true;
 }
 
-void VideoWriter::close(bool deleteFile)
+bool VideoWriter::close(bool deleteFile)
 {
-	fclose(m_file);
+	if (m_thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_queueCondition.notify_all();
+		m_thread.join();
+	}
+
+	if (m_fd >= 0)
+	{
+		if (::close(m_fd) != 0)
+			m_writeFailed = true;
+		m_fd = -1;
+	}
+
+	if (m_indexFd >= 0)
+	{
+		if (::close(m_indexFd) != 0)
+			m_indexWriteFailed = true;
+		m_indexFd = -1;
+	}
+
 	if (deleteFile)
-		remove(m_filename.toStdString().c_str());
-	m_file = 0;
+	{
+		remove(m_filename.c_str());
+		remove(m_indexFilename.c_str());
+	}
+
+	free(m_outputBuffer);
+	m_outputBuffer = NULL;
+
+	return !m_writeFailed;
 }
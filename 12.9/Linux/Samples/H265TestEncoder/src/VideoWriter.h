@@ -41,27 +41,104 @@
 #pragma once
 
 #include <stdint.h>
-#include <cstdio>
-#include <QString>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
 
+#include "DeckLinkAPI.h"
+#include "RecordingIndex.h"
+#include "TransportStreamMuxer.h"
+
+// Records encoder packets to an MPEG-TS file.  The encoder callbacks only copy the
+// packet payload into a preallocated ring; muxing and file I/O happen on a
+// dedicated writer thread which flushes in large, page aligned blocks, and records
+// the position of every access unit in a sidecar index (<filename>.idx).
+//
+// Decode times are derived from the frame rate and the reorder depth signalled in
+// the SPS (sps_max_num_reorder_pics), so the writer needs no lookahead.
 class VideoWriter
 {
 public:
-	VideoWriter(const QString& filename);
+	VideoWriter(const std::string& filename);
 	~VideoWriter();
 
-	bool					open();
-	void					close(bool deleteFile = false);
+	bool					open(BMDTimeValue frameDuration, BMDTimeScale frameTimeScale, uint32_t audioChannelCount = 0);
+	// Returns false if any part of the transport stream could not be written to disk
+	bool					close(bool deleteFile = false);
+
+	bool					writeVideo(IDeckLinkEncoderVideoPacket* packet);
+	bool					writeAudio(IDeckLinkEncoderAudioPacket* packet);
 
-	bool					writeVideo(uint8_t* buffer, uint32_t length);
-	bool					writeAudio(uint64_t seq);
+	uint64_t				droppedPacketCount() const { return m_droppedPackets; }
+	// The index stops at the first entry that could not be written, valid after close()
+	bool					indexWriteFailed() const { return m_indexWriteFailed; }
 
 private:
+	enum PacketKind
+	{
+		kVideoPacket,
+		kAudioPacket
+	};
+
+	struct QueuedPacket
+	{
+		PacketKind			kind;
+		size_t				offset;
+		size_t				size;
+		size_t				releaseSize;
+		int64_t				streamTime;
+		uint8_t				nalUnitType;
+	};
 
 	bool					addVideoStream();
 	bool					addAudioStream();
 
-	QString					m_filename;
-	FILE*					m_file;
-};
+	bool					enqueuePacket(PacketKind kind, const void* bytes, size_t size, int64_t streamTime, uint8_t nalUnitType);
+	void					writerThread();
+	void					muxPacket(const QueuedPacket& packet);
+	void					flushAccessUnit();
+	int64_t					frameTime(int64_t frameCount) const;
+	void					writeTransportPacket(const uint8_t* packet);
+	bool					flushOutputBuffer();
+	bool					flushIndex();
 
+	std::string				m_filename;
+	std::string				m_indexFilename;
+	int						m_fd;
+	int						m_indexFd;
+	uint32_t				m_audioChannelCount;
+
+	// Packet ring, shared between the encoder callbacks and the writer thread
+	std::vector<uint8_t>		m_ring;
+	size_t					m_ringWrite;
+	size_t					m_ringUsed;
+	std::vector<QueuedPacket>	m_queue;
+	size_t					m_queueHead;
+	size_t					m_queueCount;
+	std::mutex				m_mutex;
+	std::condition_variable		m_queueCondition;
+	bool					m_stopping;
+	std::thread				m_thread;
+	std::atomic<uint64_t>		m_droppedPackets;
+
+	// Writer thread state
+	TransportStreamMuxer		m_muxer;
+	std::vector<uint8_t>		m_accessUnit;
+	int64_t					m_accessUnitPts;
+	uint32_t				m_accessUnitFlags;
+	BMDTimeValue			m_frameDuration;
+	BMDTimeScale			m_frameTimeScale;
+	uint32_t				m_reorderPictures;
+	int64_t					m_dtsOrigin;
+	uint64_t				m_decodeIndex;
+	int64_t					m_lastDts;
+	uint8_t*				m_outputBuffer;
+	size_t					m_outputSize;
+	uint64_t				m_transportBytes;
+	std::vector<RecordingIndexEntry>	m_indexEntries;
+	bool					m_writeFailed;
+	bool					m_indexWriteFailed;
+};
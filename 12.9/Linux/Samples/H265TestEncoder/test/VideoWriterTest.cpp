@@ -0,0 +1,595 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+// Replays recorded encoder NAL unit streams through VideoWriter, then parses the
+// transport stream and sidecar index it wrote back and checks their timestamps, and
+// the keyframe lookup and segment splitting of RecordingIndex.
+// Build and run with "make check".
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "DeckLinkAPI.h"
+#include "RecordingIndex.h"
+#include "VideoWriter.h"
+
+static const BMDTimeScale	kTimeScale				= 90000;
+static const uint16_t		kVideoPid				= 0x0100;
+static const size_t			kPacketSize				= 188;
+
+static const uint8_t		kNalUnitTypeTrailN		= 0;
+static const uint8_t		kNalUnitTypeTrailR		= 1;
+static const uint8_t		kNalUnitTypeIDR			= 19;
+static const uint8_t		kNalUnitTypeCRA			= 21;
+static const uint8_t		kNalUnitTypeVPS			= 32;
+static const uint8_t		kNalUnitTypeSPS			= 33;
+static const uint8_t		kNalUnitTypePPS			= 34;
+// Reorder depth the writer assumes for a stream without an SPS
+static const uint32_t		kMaxReorderPictures		= 15;
+
+// One NAL unit as delivered by IDeckLinkEncoderInput::VideoPacketArrived
+class RecordedVideoPacket : public IDeckLinkEncoderVideoPacket
+{
+public:
+	RecordedVideoPacket(const std::vector<uint8_t>& bytes, BMDTimeValue streamTime, BMDTimeScale timeScale) :
+		m_bytes(bytes), m_streamTime(streamTime), m_timeScale(timeScale)
+	{
+	}
+
+	virtual HRESULT			QueryInterface(REFIID, LPVOID* ppv) { *ppv = NULL; return E_NOINTERFACE; }
+	virtual ULONG			AddRef() { return 1; }
+	virtual ULONG			Release() { return 1; }
+
+	virtual HRESULT			GetBytes(void** buffer) { *buffer = m_bytes.data(); return S_OK; }
+	virtual long			GetSize() { return (long)m_bytes.size(); }
+	virtual HRESULT			GetStreamTime(BMDTimeValue* frameTime, BMDTimeScale timeScale) { *frameTime = m_streamTime * timeScale / m_timeScale; return S_OK; }
+	virtual BMDPacketType	GetPacketType() { return bmdPacketTypeStreamData; }
+	virtual BMDPixelFormat	GetPixelFormat() { return bmdFormatH265; }
+	virtual HRESULT			GetHardwareReferenceTimestamp(BMDTimeScale, BMDTimeValue*, BMDTimeValue*) { return E_NOTIMPL; }
+	virtual HRESULT			GetTimecode(BMDTimecodeFormat, IDeckLinkTimecode**) { return E_NOTIMPL; }
+
+private:
+	std::vector<uint8_t>	m_bytes;
+	BMDTimeValue			m_streamTime;
+	BMDTimeScale			m_timeScale;
+};
+
+class BitWriter
+{
+public:
+	BitWriter() : m_bitCount(0) {}
+
+	void writeBits(uint32_t value, int count)
+	{
+		while (count-- > 0)
+		{
+			if (m_bitCount % 8 == 0)
+				m_bytes.push_back(0);
+			if ((value >> count) & 1)
+				m_bytes.back() |= 0x80 >> (m_bitCount % 8);
+			m_bitCount++;
+		}
+	}
+
+	void writeUE(uint32_t value)
+	{
+		int length = 0;
+		while (((uint64_t)value + 1) >> (length + 1))
+			length++;
+		writeBits(0, length);
+		writeBits(value + 1, length + 1);
+	}
+
+	// rbsp_trailing_bits
+	std::vector<uint8_t> finish()
+	{
+		writeBits(1, 1);
+		while (m_bitCount % 8)
+			writeBits(0, 1);
+		return m_bytes;
+	}
+
+private:
+	std::vector<uint8_t>	m_bytes;
+	size_t					m_bitCount;
+};
+
+// Wraps an RBSP in an Annex B start code and NAL unit header, inserting emulation prevention bytes
+static std::vector<uint8_t> makeNalUnit(uint8_t nalUnitType, const std::vector<uint8_t>& rbsp)
+{
+	std::vector<uint8_t>	nal		= { 0x00, 0x00, 0x00, 0x01, (uint8_t)(nalUnitType << 1), 0x01 };
+	int						zeros	= 0;
+
+	for (uint8_t byte : rbsp)
+	{
+		if (zeros >= 2 && byte <= 0x03)
+		{
+			nal.push_back(0x03);
+			zeros = 0;
+		}
+		nal.push_back(byte);
+		zeros = (byte == 0) ? zeros + 1 : 0;
+	}
+
+	return nal;
+}
+
+// Main 10 profile SPS for 2160p, signalling the given reorder depth
+static std::vector<uint8_t> makeSPS(uint32_t reorderPictures)
+{
+	BitWriter sps;
+
+	sps.writeBits(0, 4);						// sps_video_parameter_set_id
+	sps.writeBits(0, 3);						// sps_max_sub_layers_minus1
+	sps.writeBits(1, 1);						// sps_temporal_id_nesting_flag
+	sps.writeBits(0, 2);						// general_profile_space
+	sps.writeBits(0, 1);						// general_tier_flag
+	sps.writeBits(2, 5);						// general_profile_idc
+	sps.writeBits(0x20000000, 32);				// general_profile_compatibility_flag[2]
+	sps.writeBits(0x9, 4);						// progressive_source and frame_only_constraint
+	sps.writeBits(0, 32);						// general_reserved_zero_43bits
+	sps.writeBits(0, 11);
+	sps.writeBits(0, 1);						// general_inbld_flag
+	sps.writeBits(153, 8);						// general_level_idc, level 5.1
+	sps.writeUE(0);								// sps_seq_parameter_set_id
+	sps.writeUE(1);								// chroma_format_idc
+	sps.writeUE(3840);							// pic_width_in_luma_samples
+	sps.writeUE(2160);							// pic_height_in_luma_samples
+	sps.writeBits(0, 1);						// conformance_window_flag
+	sps.writeUE(2);								// bit_depth_luma_minus8
+	sps.writeUE(2);								// bit_depth_chroma_minus8
+	sps.writeUE(4);								// log2_max_pic_order_cnt_lsb_minus4
+	sps.writeBits(1, 1);						// sps_sub_layer_ordering_info_present_flag
+	sps.writeUE(reorderPictures + 1);			// sps_max_dec_pic_buffering_minus1
+	sps.writeUE(reorderPictures);				// sps_max_num_reorder_pics
+	sps.writeUE(0);								// sps_max_latency_increase_plus1
+
+	return makeNalUnit(kNalUnitTypeSPS, sps.finish());
+}
+
+static std::vector<uint8_t> makeSlice(uint8_t nalUnitType, int64_t frame)
+{
+	std::vector<uint8_t> payload(64 + (frame % 7) * 1000);
+	for (size_t i = 0; i < payload.size(); i++)
+		payload[i] = (uint8_t)(0x80 | (i + frame));
+	return makeNalUnit(nalUnitType, payload);
+}
+
+struct RecordedPicture
+{
+	uint8_t		nalUnitType;
+	int64_t		frame;							// Presentation order
+};
+
+struct RecordedStream
+{
+	const char*					name;
+	bool						withParameterSets;
+	uint32_t					reorderPictures;
+	std::vector<RecordedPicture>	pictures;	// Decode order
+};
+
+static void appendGop(RecordedStream& stream, uint8_t irapType, const std::vector<int>& frameOffsets, int64_t firstFrame)
+{
+	for (size_t i = 0; i < frameOffsets.size(); i++)
+	{
+		uint8_t nalUnitType = (i == 0) ? irapType : (frameOffsets[i] % 2 ? kNalUnitTypeTrailN : kNalUnitTypeTrailR);
+		stream.pictures.push_back({ nalUnitType, firstFrame + frameOffsets[i] });
+	}
+}
+
+static std::vector<RecordedStream> recordedStreams()
+{
+	std::vector<RecordedStream> streams;
+
+	// Hierarchical B pictures, the deepest reordering the encoder produces
+	RecordedStream hierarchical = { "hierarchical B GOP", true, 2, {} };
+	for (int gop = 0; gop < 4; gop++)
+		appendGop(hierarchical, kNalUnitTypeIDR, { 0, 4, 2, 1, 3, 8, 6, 5, 7 }, gop * 9);
+	streams.push_back(hierarchical);
+
+	// I P B B, with a frame dropped by the encoder before the second IDR and an open
+	// GOP starting at a CRA picture
+	RecordedStream ipbb = { "IPBB GOP with dropped frame", true, 1, {} };
+	appendGop(ipbb, kNalUnitTypeIDR, { 0, 3, 1, 2 }, 0);
+	appendGop(ipbb, kNalUnitTypeIDR, { 0, 3, 1, 2 }, 5);
+	appendGop(ipbb, kNalUnitTypeCRA, { 0, 3, 1, 2 }, 9);
+	appendGop(ipbb, kNalUnitTypeIDR, { 0, 3, 1, 2 }, 13);
+	streams.push_back(ipbb);
+
+	// Without an SPS the writer has to assume the largest reorder depth
+	RecordedStream noSPS = { "B GOP without SPS", false, 0, {} };
+	for (int gop = 0; gop < 3; gop++)
+		appendGop(noSPS, kNalUnitTypeIDR, { 0, 3, 1, 2 }, gop * 4);
+	streams.push_back(noSPS);
+
+	return streams;
+}
+
+static int64_t streamTime(int64_t frame, BMDTimeValue frameDuration, BMDTimeScale frameTimeScale)
+{
+	return frame * frameDuration * kTimeScale / frameTimeScale;
+}
+
+static int64_t readTimestamp(const uint8_t* p)
+{
+	return ((int64_t)(p[0] & 0x0E) << 29) | ((int64_t)p[1] << 22) | ((int64_t)(p[2] & 0xFE) << 14) | ((int64_t)p[3] << 7) | (p[4] >> 1);
+}
+
+struct VideoAccessUnit
+{
+	uint64_t	offset;
+	int64_t		pts;
+	int64_t		dts;
+};
+
+static bool readFile(const std::string& path, std::vector<uint8_t>& contents)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+
+	uint8_t buffer[65536];
+	size_t	size;
+	while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		contents.insert(contents.end(), buffer, buffer + size);
+
+	fclose(file);
+	return true;
+}
+
+// Finds the PES header of every video access unit in the transport stream
+static bool parseTransportStream(const std::vector<uint8_t>& ts, std::vector<VideoAccessUnit>& accessUnits, std::string& error)
+{
+	int64_t lastPcr = -1;
+
+	if (ts.size() % kPacketSize != 0)
+	{
+		error = "file is not a whole number of transport packets";
+		return false;
+	}
+
+	for (size_t offset = 0; offset < ts.size(); offset += kPacketSize)
+	{
+		const uint8_t*	packet	= &ts[offset];
+		const uint8_t*	payload	= packet + 4;
+		uint16_t		pid		= ((packet[1] & 0x1F) << 8) | packet[2];
+
+		if (packet[0] != 0x47)
+		{
+			error = "lost transport packet sync";
+			return false;
+		}
+
+		if (pid != kVideoPid)
+			continue;
+
+		if (packet[3] & 0x20)
+		{
+			if (packet[4] > 0 && (packet[5] & 0x10))
+			{
+				int64_t pcr = ((int64_t)packet[6] << 25) | ((int64_t)packet[7] << 17) | ((int64_t)packet[8] << 9) | ((int64_t)packet[9] << 1) | (packet[10] >> 7);
+				if (pcr < lastPcr)
+				{
+					error = "PCR runs backwards";
+					return false;
+				}
+				lastPcr = pcr;
+			}
+			payload += 1 + packet[4];
+		}
+
+		if (!(packet[1] & 0x40))
+			continue;
+
+		if (payload[0] != 0x00 || payload[1] != 0x00 || payload[2] != 0x01 || payload[3] != 0xE0)
+		{
+			error = "video PES header missing";
+			return false;
+		}
+
+		VideoAccessUnit accessUnit;
+		accessUnit.offset = offset;
+		accessUnit.pts = readTimestamp(payload + 9);
+		accessUnit.dts = (payload[7] & 0x40) ? readTimestamp(payload + 14) : accessUnit.pts;
+		accessUnits.push_back(accessUnit);
+	}
+
+	return true;
+}
+
+// Compares RecordingIndex lookups with a linear search of the recording
+static bool checkIndexLookups(const RecordingIndex& index, const std::vector<uint8_t>& ts, std::string& error)
+{
+	for (size_t i = 0; i < index.entryCount(); i++)
+	{
+		for (int64_t delta = -1; delta <= 1; delta++)
+		{
+			int64_t	pts			= index.entry(i).pts + delta;
+			long	expected	= -1;
+
+			for (size_t j = 0; j < index.entryCount(); j++)
+			{
+				const RecordingIndexEntry& entry = index.entry(j);
+				if ((entry.flags & kRecordingIndexKeyframe) && entry.pts <= pts && (expected < 0 || entry.pts > index.entry(expected).pts))
+					expected = (long)j;
+			}
+
+			if (index.findKeyframe(pts) != expected)
+			{
+				error = "findKeyframe(" + std::to_string(pts) + ") returned " + std::to_string(index.findKeyframe(pts)) + ", expected " + std::to_string(expected);
+				return false;
+			}
+		}
+	}
+
+	for (size_t segmentCount = 1; segmentCount <= 8; segmentCount++)
+	{
+		std::vector<std::pair<uint64_t, uint64_t>>	segments	= index.segments(segmentCount, ts.size());
+		std::string									where		= std::to_string(segmentCount) + " segments: ";
+
+		if (segments.empty() || segments.size() > segmentCount)
+			error = where + "returned " + std::to_string(segments.size()) + " ranges";
+		else if (segments.back().second != ts.size())
+			error = where + "last range does not end at the end of the file";
+
+		for (size_t i = 0; error.empty() && i < segments.size(); i++)
+		{
+			uint64_t	begin		= segments[i].first;
+			bool		keyframe	= false;
+
+			for (size_t j = 0; j < index.entryCount(); j++)
+				keyframe |= (index.entry(j).flags & kRecordingIndexKeyframe) && index.entry(j).offset == begin;
+
+			if (begin >= segments[i].second)
+				error = where + "range " + std::to_string(i) + " is empty";
+			else if (i > 0 && begin != segments[i - 1].second)
+				error = where + "range " + std::to_string(i) + " does not follow the previous one";
+			else if (!keyframe || begin % kPacketSize != 0 || ts[begin] != 0x47)
+				error = where + "range " + std::to_string(i) + " does not start on a keyframe";
+		}
+
+		if (!error.empty())
+			return false;
+	}
+
+	return true;
+}
+
+static bool checkRecording(const RecordedStream& stream, BMDTimeValue frameDuration, BMDTimeScale frameTimeScale, const std::string& directory, std::string& error)
+{
+	std::string						filename	= directory + "/recording.ts";
+	VideoWriter						writer(filename);
+	std::vector<uint8_t>			ts;
+	std::vector<VideoAccessUnit>	accessUnits;
+	RecordingIndex					index;
+
+	if (!writer.open(frameDuration, frameTimeScale))
+	{
+		error = "failed to open recording";
+		return false;
+	}
+
+	for (const RecordedPicture& picture : stream.pictures)
+	{
+		std::vector<std::vector<uint8_t>>	nalUnits;
+		int64_t								time		= streamTime(picture.frame, frameDuration, frameTimeScale);
+
+		if (stream.withParameterSets && picture.nalUnitType >= kNalUnitTypeIDR)
+		{
+			nalUnits.push_back(makeNalUnit(kNalUnitTypeVPS, { 0x0C, 0x01, 0xFF, 0xFF }));
+			nalUnits.push_back(makeSPS(stream.reorderPictures));
+			nalUnits.push_back(makeNalUnit(kNalUnitTypePPS, { 0xC1, 0x72, 0xB4, 0x62, 0x40 }));
+		}
+		nalUnits.push_back(makeSlice(picture.nalUnitType, picture.frame));
+
+		for (const std::vector<uint8_t>& nalUnit : nalUnits)
+		{
+			RecordedVideoPacket packet(nalUnit, time, kTimeScale);
+			if (!writer.writeVideo(&packet))
+			{
+				error = "writer dropped a packet";
+				return false;
+			}
+		}
+	}
+
+	if (!writer.close() || writer.droppedPacketCount() != 0 || writer.indexWriteFailed())
+	{
+		error = "recording was not written completely";
+		return false;
+	}
+
+	if (!readFile(filename, ts) || !parseTransportStream(ts, accessUnits, error))
+	{
+		if (error.empty())
+			error = "failed to read recording";
+		return false;
+	}
+
+	if (accessUnits.size() != stream.pictures.size())
+	{
+		error = "recording has " + std::to_string(accessUnits.size()) + " access units, expected " + std::to_string(stream.pictures.size());
+		return false;
+	}
+
+	if (!index.load(filename + ".idx") || index.entryCount() != accessUnits.size())
+	{
+		error = "index does not match the recording";
+		return false;
+	}
+
+	// The first picture is decoded the reorder depth ahead of its presentation
+	uint32_t reorderPictures = stream.withParameterSets ? stream.reorderPictures : kMaxReorderPictures;
+	if (accessUnits[0].pts - accessUnits[0].dts != streamTime(reorderPictures, frameDuration, frameTimeScale))
+	{
+		error = "first decode delay is not the SPS reorder depth";
+		return false;
+	}
+
+	int64_t firstPts = accessUnits[0].pts - streamTime(stream.pictures[0].frame, frameDuration, frameTimeScale);
+
+	for (size_t i = 0; i < accessUnits.size(); i++)
+	{
+		const VideoAccessUnit&		accessUnit	= accessUnits[i];
+		const RecordingIndexEntry&	entry		= index.entry(i);
+		int64_t						pts			= streamTime(stream.pictures[i].frame, frameDuration, frameTimeScale);
+		std::string					where		= "access unit " + std::to_string(i) + ": ";
+
+		if (accessUnit.pts - firstPts != pts)
+			error = where + "PTS does not match the stream time";
+		else if (accessUnit.dts > accessUnit.pts)
+			error = where + "DTS " + std::to_string(accessUnit.dts) + " is later than PTS " + std::to_string(accessUnit.pts);
+		else if (i > 0 && accessUnit.dts <= accessUnits[i - 1].dts)
+			error = where + "DTS does not increase";
+		else if (entry.pts != pts || entry.offset > accessUnit.offset || entry.decodeDelay != (uint32_t)(accessUnit.pts - accessUnit.dts))
+			error = where + "index entry does not match the recording";
+		else if (((entry.flags & kRecordingIndexKeyframe) != 0) != (stream.pictures[i].nalUnitType >= kNalUnitTypeIDR))
+			error = where + "index keyframe flag is wrong";
+
+		if (!error.empty())
+			return false;
+	}
+
+	// Every picture must be decoded before it is presented, which in decode order means
+	// no DTS may exceed the PTS of any picture still waiting to be presented
+	for (size_t i = 0; i < accessUnits.size(); i++)
+	{
+		for (size_t j = 0; j < i; j++)
+		{
+			if (accessUnits[i].dts > accessUnits[j].pts && accessUnits[i].pts < accessUnits[j].pts)
+			{
+				error = "access unit " + std::to_string(i) + " is decoded after a later picture is presented";
+				return false;
+			}
+		}
+	}
+
+	return checkIndexLookups(index, ts, error);
+}
+
+// The index is left out when it can't be written, without failing the recording
+static bool checkIndexWriteFailure(const std::string& directory, std::string& error)
+{
+	std::string		filename	= directory + "/unindexed.ts";
+	std::string		indexPath	= filename + ".idx";
+	VideoWriter		writer(filename);
+	bool			passed		= false;
+
+	// A directory in place of the index can't be opened for writing
+	if (mkdir(indexPath.c_str(), 0755) != 0)
+	{
+		error = "failed to create a directory in place of the index";
+		return false;
+	}
+
+	if (!writer.open(1000, 25000))
+		error = "failed to open recording";
+	else
+	{
+		RecordedVideoPacket packet(makeSlice(kNalUnitTypeIDR, 0), 0, kTimeScale);
+		if (!writer.writeVideo(&packet))
+			error = "writer dropped a packet";
+		else if (!writer.close())
+			error = "recording failed with the index";
+		else if (!writer.indexWriteFailed())
+			error = "index failure was not reported";
+		else
+			passed = true;
+	}
+
+	writer.close();
+	unlink(filename.c_str());
+	rmdir(indexPath.c_str());
+	return passed;
+}
+
+int main()
+{
+	struct FrameRate
+	{
+		const char*		name;
+		BMDTimeValue	duration;
+		BMDTimeScale	timeScale;
+	};
+
+	const FrameRate		frameRates[]	= { { "25p", 1000, 25000 }, { "59.94p", 1001, 60000 } };
+	char				directory[]		= "/tmp/VideoWriterTestXXXXXX";
+	int					failures		= 0;
+
+	if (!mkdtemp(directory))
+	{
+		fprintf(stderr, "Could not create a temporary directory\n");
+		return 1;
+	}
+
+	for (const RecordedStream& stream : recordedStreams())
+	{
+		for (const FrameRate& frameRate : frameRates)
+		{
+			std::string error;
+			bool		passed	= checkRecording(stream, frameRate.duration, frameRate.timeScale, directory, error);
+
+			printf("%-6s %s at %s%s%s\n", passed ? "PASS" : "FAIL", stream.name, frameRate.name, passed ? "" : ": ", error.c_str());
+			if (!passed)
+				failures++;
+		}
+	}
+
+	{
+		std::string error;
+		bool		passed	= checkIndexWriteFailure(directory, error);
+
+		printf("%-6s index write failure%s%s\n", passed ? "PASS" : "FAIL", passed ? "" : ": ", error.c_str());
+		if (!passed)
+			failures++;
+	}
+
+	unlink((std::string(directory) + "/recording.ts").c_str());
+	unlink((std::string(directory) + "/recording.ts.idx").c_str());
+	rmdir(directory);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+
+#include "BandWorkerPool.h"
+#include "FrameTrace.h"
+
+BandWorkerPool::BandWorkerPool(unsigned threadCount) :
+	m_generation(0),
+	m_busyWorkers(0),
+	m_quit(false),
+	m_bandFunction(nullptr),
+	m_bandCount(0),
+	m_nextBand(0)
+{
+	for (unsigned i = 1; i < threadCount; i++)
+		m_workers.push_back(std::thread(&BandWorkerPool::workerThread, this, i));
+}
+
+BandWorkerPool::~BandWorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_workerMutex);
+		m_quit = true;
+	}
+	m_startCondition.notify_all();
+
+	for (std::thread& worker : m_workers)
+		worker.join();
+}
+
+void BandWorkerPool::run(long bandCount, const BandFunction& bandFunction)
+{
+	std::lock_guard<std::mutex> runLock(m_runMutex);
+
+	m_bandFunction = &bandFunction;
+	m_bandCount = bandCount;
+
+	{
+		std::lock_guard<std::mutex> lock(m_workerMutex);
+		m_nextBand = 0;
+		m_busyWorkers = (unsigned)m_workers.size();
+		++m_generation;
+	}
+	m_startCondition.notify_all();
+
+	runBands(0);
+
+	{
+		std::unique_lock<std::mutex> lock(m_workerMutex);
+		m_doneCondition.wait(lock, [this]{ return m_busyWorkers == 0; });
+	}
+
+	m_bandFunction = nullptr;
+}
+
+void BandWorkerPool::workerThread(unsigned threadIndex)
+{
+	uint64_t generation = 0;
+
+	FRAME_TRACE_THREAD_NAME("Band worker");
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_workerMutex);
+			m_startCondition.wait(lock, [&]{ return m_quit || m_generation != generation; });
+			if (m_quit)
+				return;
+			generation = m_generation;
+		}
+
+		runBands(threadIndex);
+
+		{
+			std::lock_guard<std::mutex> lock(m_workerMutex);
+			if (--m_busyWorkers == 0)
+				m_doneCondition.notify_one();
+		}
+	}
+}
+
+void BandWorkerPool::runBands(unsigned threadIndex)
+{
+	for (long band = m_nextBand++; band < m_bandCount; band = m_nextBand++)
+		(*m_bandFunction)(threadIndex, band);
+}
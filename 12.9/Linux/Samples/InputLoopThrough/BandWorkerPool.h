@@ -0,0 +1,89 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads that split the bands of a frame between them, shared by the compositor and the
+// scaler so that compositing and scaling the same frame don't compete for the cores.
+//
+// run() hands out the bands one at a time to the workers and to the thread calling it,
+// and returns once all of them are done.  Each thread is given its own index, 0 for the
+// calling thread, for state it keeps between bands.  Calls are serialised, so only one
+// frame is split between the threads at a time.
+class BandWorkerPool
+{
+public:
+	using BandFunction = std::function<void(unsigned threadIndex, long band)>;
+
+	BandWorkerPool(unsigned threadCount);
+	virtual ~BandWorkerPool();
+
+	// Threads taking part in run(), including the thread calling it
+	unsigned	getThreadCount(void) const { return (unsigned)m_workers.size() + 1; }
+
+	void		run(long bandCount, const BandFunction& bandFunction);
+
+private:
+	std::mutex									m_runMutex;
+
+	std::vector<std::thread>					m_workers;
+	std::mutex									m_workerMutex;
+	std::condition_variable						m_startCondition;
+	std::condition_variable						m_doneCondition;
+	uint64_t									m_generation;
+	unsigned									m_busyWorkers;
+	bool										m_quit;
+
+	// Per run state, set by run() for the workers
+	const BandFunction*							m_bandFunction;
+	long										m_bandCount;
+	std::atomic<long>							m_nextBand;
+
+	void		workerThread(unsigned threadIndex);
+	void		runBands(unsigned threadIndex);
+};
@@ -0,0 +1,603 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <string.h>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "Compositor.h"
+
+// 10-bit video levels.  Keyed samples are limited to the range a blend can't push outside
+// the 10-bit code values, which also keeps the SDI reserved codes out of the frame.
+static const int		kMinimumLevel		= 4;
+static const int		kMaximumLevel		= 1019;
+static const int		kNeutralChroma		= 512;
+static const int		kOpaqueAlpha		= 1023;
+
+static const long		kTileBytes			= 128;
+
+// Luma coefficients, Kg = 1 - Kr - Kb
+static const double		kRec601Kr			= 0.299;
+static const double		kRec601Kb			= 0.114;
+static const double		kRec709Kr			= 0.2126;
+static const double		kRec709Kb			= 0.0722;
+
+namespace
+{
+	// The inverse alpha is stored in 10 bits, 1023 standing for 1.0.  Adding the top bit
+	// back in maps it onto 0..1024 so that a transparent sample is passed through exactly.
+	inline uint32_t expandInverseAlpha(uint32_t inverseAlpha)
+	{
+		return inverseAlpha + (inverseAlpha >> 9);
+	}
+
+	// Each of the three 10-bit components in a word becomes layer + frame * inverse alpha
+	inline uint32_t blendWord(uint32_t frame, uint32_t premultiplied, uint32_t inverseAlpha)
+	{
+		uint32_t result = 0;
+
+		for (int shift = 0; shift < 30; shift += 10)
+		{
+			uint32_t f = (frame >> shift) & 0x3FF;
+			uint32_t p = (premultiplied >> shift) & 0x3FF;
+			uint32_t a = expandInverseAlpha((inverseAlpha >> shift) & 0x3FF);
+
+			result |= (p + ((f * a + 512) >> 10)) << shift;
+		}
+
+		return result;
+	}
+
+#if defined(__SSE2__)
+	template<int kShift>
+	inline __m128i blendComponent(__m128i frame, __m128i premultiplied, __m128i inverseAlpha)
+	{
+		const __m128i mask = _mm_set1_epi32(0x3FF);
+		__m128i f = _mm_and_si128(_mm_srli_epi32(frame, kShift), mask);
+		__m128i p = _mm_and_si128(_mm_srli_epi32(premultiplied, kShift), mask);
+		__m128i a = _mm_and_si128(_mm_srli_epi32(inverseAlpha, kShift), mask);
+
+		// Both factors are in the low half of each word, so the multiply-add is a 32-bit product
+		a = _mm_add_epi32(a, _mm_srli_epi32(a, 9));
+		f = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(f, a), _mm_set1_epi32(512)), 10);
+		return _mm_slli_epi32(_mm_add_epi32(p, f), kShift);
+	}
+#elif defined(__ARM_NEON)
+	template<int kShift>
+	inline uint32x4_t blendComponent(uint32x4_t frame, uint32x4_t premultiplied, uint32x4_t inverseAlpha)
+	{
+		const uint32x4_t mask = vdupq_n_u32(0x3FF);
+		const int32x4_t shiftRight = vdupq_n_s32(-kShift);
+		uint32x4_t f = vandq_u32(vshlq_u32(frame, shiftRight), mask);
+		uint32x4_t p = vandq_u32(vshlq_u32(premultiplied, shiftRight), mask);
+		uint32x4_t a = vandq_u32(vshlq_u32(inverseAlpha, shiftRight), mask);
+
+		a = vaddq_u32(a, vshrq_n_u32(a, 9));
+		f = vrshrq_n_u32(vmulq_u32(f, a), 10);
+		return vshlq_u32(vaddq_u32(p, f), vdupq_n_s32(kShift));
+	}
+#endif
+
+	// Blends one row of a tile, a whole number of v210 groups
+	void blendRow(uint8_t* dest, const uint32_t* premultiplied, const uint32_t* inverseAlpha, long wordCount)
+	{
+		uint32_t* words = (uint32_t*)dest;
+#if defined(__SSE2__)
+		for (long i = 0; i < wordCount; i += 4)
+		{
+			__m128i f = _mm_loadu_si128((const __m128i*)(words + i));
+			__m128i p = _mm_loadu_si128((const __m128i*)(premultiplied + i));
+			__m128i a = _mm_loadu_si128((const __m128i*)(inverseAlpha + i));
+			__m128i result = _mm_or_si128(_mm_or_si128(blendComponent<0>(f, p, a), blendComponent<10>(f, p, a)), blendComponent<20>(f, p, a));
+			_mm_storeu_si128((__m128i*)(words + i), result);
+		}
+#elif defined(__ARM_NEON)
+		for (long i = 0; i < wordCount; i += 4)
+		{
+			uint32x4_t f = vld1q_u32(words + i);
+			uint32x4_t p = vld1q_u32(premultiplied + i);
+			uint32x4_t a = vld1q_u32(inverseAlpha + i);
+			vst1q_u32(words + i, vorrq_u32(vorrq_u32(blendComponent<0>(f, p, a), blendComponent<10>(f, p, a)), blendComponent<20>(f, p, a)));
+		}
+#else
+		for (long i = 0; i < wordCount; i++)
+			words[i] = blendWord(words[i], premultiplied[i], inverseAlpha[i]);
+#endif
+	}
+
+	inline int clampLevel(int value)
+	{
+		return std::min(std::max(value, kMinimumLevel), kMaximumLevel);
+	}
+
+	inline uint32_t readBigEndian32(const uint8_t* bytes)
+	{
+		return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+	}
+
+	// Premultiplied sample and 10-bit inverse alpha for a level keyed with alpha (0..1023),
+	// using the same expanded inverse alpha as the blend
+	inline void keySample(int level, int alpha, uint32_t& premultiplied, uint32_t& inverseAlpha)
+	{
+		inverseAlpha = (uint32_t)(kOpaqueAlpha - alpha);
+		premultiplied = ((1024 - expandInverseAlpha(inverseAlpha)) * (uint32_t)clampLevel(level)) >> 10;
+	}
+}
+
+Compositor::Compositor(std::shared_ptr<BandWorkerPool> workerPool) :
+	m_width(0),
+	m_height(0),
+	m_columns(0),
+	m_bands(0),
+	m_rec601(false),
+	m_statistics(),
+	m_frameBytes(nullptr),
+	m_frameRowBytes(0),
+	m_frameTilesBlended(0),
+	m_frameTilesCopied(0),
+	m_workerPool(workerPool)
+{
+}
+
+Compositor::~Compositor()
+{
+}
+
+bool Compositor::isLayerPixelFormatSupported(BMDPixelFormat pixelFormat)
+{
+	return (pixelFormat == bmdFormat8BitBGRA) || (pixelFormat == bmdFormat10BitYUVA);
+}
+
+bool Compositor::start(long width, long height, BMDPixelFormat pixelFormat)
+{
+	std::lock_guard<std::mutex> updateLock(m_updateMutex);
+	std::lock_guard<std::mutex> compositeLock(m_compositeMutex);
+	std::lock_guard<std::mutex> layerLock(m_layerMutex);
+
+	for (Layer& layer : m_layers)
+		layer.tiles.reset();
+
+	if ((pixelFormat != bmdFormat10BitYUV) || (width <= 0) || (height <= 0))
+	{
+		m_width = 0;
+		m_height = 0;
+		return false;
+	}
+
+	m_width		= width;
+	m_height	= height;
+	m_columns	= (width + kTileWidth - 1) / kTileWidth;
+	m_bands		= (height + kTileRows - 1) / kTileRows;
+	m_rec601	= (height <= 576);
+
+	m_statistics = CompositorStatistics();
+	m_statistics.tilesPerFrame = (uint64_t)(m_columns * m_bands);
+
+	return true;
+}
+
+void Compositor::stop(void)
+{
+	std::lock_guard<std::mutex> updateLock(m_updateMutex);
+	std::lock_guard<std::mutex> compositeLock(m_compositeMutex);
+	std::lock_guard<std::mutex> layerLock(m_layerMutex);
+
+	for (Layer& layer : m_layers)
+		layer.tiles.reset();
+
+	m_width = 0;
+	m_height = 0;
+}
+
+bool Compositor::setLayer(unsigned index, BMDPixelFormat pixelFormat, long width, long height, long left, long top,
+						  bool premultiplied, const void* bytes, long rowBytes)
+{
+	Layer layer;
+
+	if ((index >= kMaxLayers) || !isLayerPixelFormatSupported(pixelFormat) || (width <= 0) || (height <= 0) || (rowBytes < width * 4))
+		return false;
+
+	layer.pixelFormat	= pixelFormat;
+	layer.width			= width;
+	layer.height		= height;
+	layer.left			= left;
+	layer.top			= top;
+	layer.premultiplied	= premultiplied;
+
+	std::lock_guard<std::mutex> updateLock(m_updateMutex);
+
+	if (!convertTiles(layer, bytes, rowBytes, CompositorRect { 0, 0, width, height }))
+		return false;
+
+	std::lock_guard<std::mutex> lock(m_layerMutex);
+	m_layers[index] = layer;
+	++m_statistics.layerUpdates;
+	return true;
+}
+
+bool Compositor::updateLayer(unsigned index, const void* bytes, long rowBytes, const CompositorRect& dirtyRect)
+{
+	Layer layer;
+
+	if (index >= kMaxLayers)
+		return false;
+
+	std::lock_guard<std::mutex> updateLock(m_updateMutex);
+
+	{
+		std::lock_guard<std::mutex> lock(m_layerMutex);
+		layer = m_layers[index];
+	}
+
+	if (!layer.tiles || (rowBytes < layer.width * 4))
+		return false;
+
+	if (!convertTiles(layer, bytes, rowBytes, dirtyRect))
+		return false;
+
+	std::lock_guard<std::mutex> lock(m_layerMutex);
+	m_layers[index].tiles = layer.tiles;
+	++m_statistics.layerUpdates;
+	return true;
+}
+
+void Compositor::clearLayer(unsigned index)
+{
+	if (index >= kMaxLayers)
+		return;
+
+	std::lock_guard<std::mutex> updateLock(m_updateMutex);
+	std::lock_guard<std::mutex> lock(m_layerMutex);
+	m_layers[index].tiles.reset();
+}
+
+bool Compositor::compositeFrame(IDeckLinkVideoFrame* videoFrame)
+{
+	void* bytes;
+	long rowBytes = videoFrame->GetRowBytes();
+
+	if ((videoFrame->GetPixelFormat() != bmdFormat10BitYUV) || (videoFrame->GetBytes(&bytes) != S_OK))
+		return false;
+
+	std::lock_guard<std::mutex> compositeLock(m_compositeMutex);
+
+	{
+		std::lock_guard<std::mutex> lock(m_layerMutex);
+
+		if ((m_width == 0) || (videoFrame->GetWidth() != m_width) || (videoFrame->GetHeight() != m_height) || (rowBytes < m_columns * kTileBytes))
+			return false;
+
+		for (const Layer& layer : m_layers)
+		{
+			if (layer.tiles)
+				m_frameLayers.push_back(layer.tiles);
+		}
+	}
+
+	if (m_frameLayers.empty())
+		return false;
+
+	m_frameBytes = (uint8_t*)bytes;
+	m_frameRowBytes = rowBytes;
+	m_frameTilesBlended = 0;
+	m_frameTilesCopied = 0;
+
+	// Each band is composited with all of the layers while it is in the cache
+	m_workerPool->run(m_bands, [this](unsigned, long band)
+	{
+		uint64_t tilesBlended = 0;
+		uint64_t tilesCopied = 0;
+
+		for (const std::shared_ptr<const LayerTiles>& layer : m_frameLayers)
+			compositeBand(*layer, band, tilesBlended, tilesCopied);
+
+		m_frameTilesBlended += tilesBlended;
+		m_frameTilesCopied += tilesCopied;
+	});
+
+	m_frameLayers.clear();
+
+	std::lock_guard<std::mutex> lock(m_layerMutex);
+	++m_statistics.framesComposited;
+	m_statistics.tilesBlended += m_frameTilesBlended;
+	m_statistics.tilesCopied += m_frameTilesCopied;
+
+	return true;
+}
+
+void Compositor::getStatistics(CompositorStatistics& statistics)
+{
+	std::lock_guard<std::mutex> lock(m_layerMutex);
+	statistics = m_statistics;
+}
+
+void Compositor::resetStatistics(void)
+{
+	std::lock_guard<std::mutex> lock(m_layerMutex);
+	uint64_t tilesPerFrame = m_statistics.tilesPerFrame;
+
+	m_statistics = CompositorStatistics();
+	m_statistics.tilesPerFrame = tilesPerFrame;
+}
+
+void Compositor::compositeBand(const LayerTiles& layer, long band, uint64_t& tilesBlended, uint64_t& tilesCopied)
+{
+	const std::vector<TileSpan>&	spans = layer.spans[band];
+	const long						firstRow = band * kTileRows;
+	const long						rowCount = std::min(kTileRows, m_height - firstRow);
+
+	if (spans.empty())
+		return;
+
+	// Tile by tile, so that the layer is read sequentially
+	for (const TileSpan& span : spans)
+	{
+		for (long column = span.firstColumn; column < span.firstColumn + span.columnCount; column++)
+		{
+			const Tile*	tile = layer.tiles[band * m_columns + column].get();
+			uint8_t*	dest = m_frameBytes + firstRow * m_frameRowBytes + column * kTileBytes;
+
+			if (tile->opaque)
+			{
+				for (long row = 0; row < rowCount; row++, dest += m_frameRowBytes)
+					memcpy(dest, tile->rows[row].premultiplied, kTileBytes);
+				++tilesCopied;
+			}
+			else
+			{
+				for (long row = 0; row < rowCount; row++, dest += m_frameRowBytes)
+					blendRow(dest, tile->rows[row].premultiplied, tile->rows[row].inverseAlpha, kTileWords);
+				++tilesBlended;
+			}
+		}
+	}
+}
+
+bool Compositor::convertTiles(Layer& layer, const void* bytes, long rowBytes, const CompositorRect& rect)
+{
+	// Called with m_updateMutex held, so the frame geometry can't change
+	if (m_width == 0)
+		return false;
+
+	// A new version shares the tiles outside the rectangle with the previous one
+	std::shared_ptr<LayerTiles> tiles = std::make_shared<LayerTiles>();
+	if (layer.tiles)
+	{
+		*tiles = *layer.tiles;
+	}
+	else
+	{
+		tiles->tiles.resize(m_columns * m_bands);
+		tiles->spans.resize(m_bands);
+	}
+
+	// Frame pixels changed by the rectangle.  Chroma is taken from pixel pairs, so a change
+	// reaches one pixel either side.
+	long left	= std::max(0L, layer.left + std::max(0L, rect.x) - 1);
+	long top	= std::max(0L, layer.top + std::max(0L, rect.y));
+	long right	= std::min(m_width, layer.left + std::min(layer.width, rect.x + rect.width) + 1);
+	long bottom	= std::min(m_height, layer.top + std::min(layer.height, rect.y + rect.height));
+
+	if ((left < right) && (top < bottom))
+	{
+		long firstBand = top / kTileRows;
+		long lastBand = (bottom - 1) / kTileRows;
+		uint64_t tilesUpdated = 0;
+
+		for (long band = firstBand; band <= lastBand; band++)
+		{
+			std::vector<TileSpan>& spans = tiles->spans[band];
+
+			for (long column = left / kTileWidth; column <= (right - 1) / kTileWidth; column++)
+			{
+				tiles->tiles[band * m_columns + column] = convertTile(layer, bytes, rowBytes, column, band);
+				++tilesUpdated;
+			}
+
+			spans.clear();
+			for (long column = 0; column < m_columns; column++)
+			{
+				if (!tiles->tiles[band * m_columns + column])
+					continue;
+
+				if (!spans.empty() && (spans.back().firstColumn + spans.back().columnCount == column))
+					++spans.back().columnCount;
+				else
+					spans.push_back(TileSpan { column, 1 });
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(m_layerMutex);
+		m_statistics.tilesUpdated += tilesUpdated;
+	}
+
+	layer.tiles = tiles;
+	return true;
+}
+
+std::shared_ptr<const Compositor::Tile> Compositor::convertTile(const Layer& layer, const void* bytes, long rowBytes, long column, long band)
+{
+	std::shared_ptr<Tile>	tile = std::make_shared<Tile>();
+	bool					visible = false;
+	bool					opaque = true;
+
+	for (long row = 0; row < kTileRows; row++)
+	{
+		long y = band * kTileRows + row;
+
+		for (long group = 0; group < kTileWords / 4; group++)
+		{
+			// Six pixels in four words, as v210: Cb0 Y0 Cr0 Y1 Cb2 Y2 Cr2 Y3 Cb4 Y4 Cr4 Y5
+			uint32_t	premultiplied[12];
+			uint32_t	inverseAlpha[12];
+			int			luma[6];
+			int			cb[6];
+			int			cr[6];
+			int			alpha[6];
+
+			for (long i = 0; i < 6; i++)
+			{
+				long x = column * kTileWidth + group * 6 + i;
+
+				if ((x < m_width) && (y < m_height))
+					readLayerPixel(layer, bytes, rowBytes, x, y, luma[i], cb[i], cr[i], alpha[i]);
+				else
+				{
+					// Padding, neither visible nor transparent
+					luma[i] = kMinimumLevel;
+					cb[i] = kNeutralChroma;
+					cr[i] = kNeutralChroma;
+					alpha[i] = -1;
+				}
+			}
+
+			for (long pair = 0; pair < 3; pair++)
+			{
+				int* pairAlpha = &alpha[pair * 2];
+				int a0 = std::max(pairAlpha[0], 0);
+				int a1 = std::max(pairAlpha[1], 0);
+				int chromaAlpha = (a0 + a1 + 1) / 2;
+				int pairCb = kNeutralChroma;
+				int pairCr = kNeutralChroma;
+
+				// Chroma of the pair weighted by alpha, so the mean of the premultiplied samples
+				if (a0 + a1 > 0)
+				{
+					pairCb = (a0 * cb[pair * 2] + a1 * cb[pair * 2 + 1] + (a0 + a1) / 2) / (a0 + a1);
+					pairCr = (a0 * cr[pair * 2] + a1 * cr[pair * 2 + 1] + (a0 + a1) / 2) / (a0 + a1);
+				}
+
+				keySample(pairCb, chromaAlpha, premultiplied[pair * 4], inverseAlpha[pair * 4]);
+				keySample(luma[pair * 2], a0, premultiplied[pair * 4 + 1], inverseAlpha[pair * 4 + 1]);
+				keySample(pairCr, chromaAlpha, premultiplied[pair * 4 + 2], inverseAlpha[pair * 4 + 2]);
+				keySample(luma[pair * 2 + 1], a1, premultiplied[pair * 4 + 3], inverseAlpha[pair * 4 + 3]);
+
+				for (long i = 0; i < 2; i++)
+				{
+					if (pairAlpha[i] < 0)
+						continue;
+
+					visible |= (pairAlpha[i] > 0) || (chromaAlpha > 0);
+					opaque &= (pairAlpha[i] == kOpaqueAlpha) && (chromaAlpha == kOpaqueAlpha);
+				}
+			}
+
+			uint32_t* p = &tile->rows[row].premultiplied[group * 4];
+			uint32_t* a = &tile->rows[row].inverseAlpha[group * 4];
+			for (long word = 0; word < 4; word++)
+			{
+				p[word] = premultiplied[word * 3] | (premultiplied[word * 3 + 1] << 10) | (premultiplied[word * 3 + 2] << 20);
+				a[word] = inverseAlpha[word * 3] | (inverseAlpha[word * 3 + 1] << 10) | (inverseAlpha[word * 3 + 2] << 20);
+			}
+		}
+	}
+
+	if (!visible)
+		return nullptr;
+
+	tile->opaque = opaque;
+	return tile;
+}
+
+void Compositor::readLayerPixel(const Layer& layer, const void* bytes, long rowBytes, long x, long y, int& luma, int& cb, int& cr, int& alpha)
+{
+	long			layerX = x - layer.left;
+	long			layerY = y - layer.top;
+	const uint8_t*	row;
+
+	luma	= kMinimumLevel;
+	cb		= kNeutralChroma;
+	cr		= kNeutralChroma;
+	alpha	= 0;
+
+	if ((layerX < 0) || (layerX >= layer.width) || (layerY < 0) || (layerY >= layer.height))
+		return;
+
+	row = (const uint8_t*)bytes + layerY * rowBytes;
+
+	if (layer.pixelFormat == bmdFormat8BitBGRA)
+	{
+		const uint8_t*	pixel = row + layerX * 4;
+		double			kr = m_rec601 ? kRec601Kr : kRec709Kr;
+		double			kb = m_rec601 ? kRec601Kb : kRec709Kb;
+		double			b = pixel[0] / 255.0;
+		double			g = pixel[1] / 255.0;
+		double			r = pixel[2] / 255.0;
+		double			yn;
+
+		if (pixel[3] == 0)
+			return;
+
+		if (layer.premultiplied)
+		{
+			double scale = 255.0 / pixel[3];
+			r = std::min(r * scale, 1.0);
+			g = std::min(g * scale, 1.0);
+			b = std::min(b * scale, 1.0);
+		}
+
+		// R'G'B' to 10-bit Y'CbCr with video levels
+		yn		= kr * r + (1.0 - kr - kb) * g + kb * b;
+		luma	= (int)(64.5 + 876.0 * yn);
+		cb		= (int)(512.5 + 448.0 * (b - yn) / (1.0 - kb));
+		cr		= (int)(512.5 + 448.0 * (r - yn) / (1.0 - kr));
+		alpha	= (pixel[3] * kOpaqueAlpha + 127) / 255;
+	}
+	else
+	{
+		// Ay10 holds a big-endian word per pixel with full range alpha in bits 29-20, chroma in
+		// bits 19-10 and luma in bits 9-0.  Even pixels carry Cb and odd pixels Cr.  See
+		// bmdFormat10BitYUVA in section 3.4 Pixel Formats of the DeckLink SDK manual.
+		long		pairX = layerX & ~1L;
+		uint32_t	word = readBigEndian32(row + layerX * 4);
+		uint32_t	even = readBigEndian32(row + pairX * 4);
+		uint32_t	odd = (pairX + 1 < layer.width) ? readBigEndian32(row + (pairX + 1) * 4) : even;
+
+		luma	= (int)(word & 0x3FF);
+		cb		= (int)((even >> 10) & 0x3FF);
+		cr		= (int)((odd >> 10) & 0x3FF);
+		alpha	= (int)((word >> 20) & 0x3FF);
+	}
+}
@@ -0,0 +1,184 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "DeckLinkAPI.h"
+#include "BandWorkerPool.h"
+
+struct CompositorRect
+{
+	long		x;
+	long		y;
+	long		width;
+	long		height;
+};
+
+struct CompositorStatistics
+{
+	uint64_t	framesComposited;
+	uint64_t	layerUpdates;
+	uint64_t	tilesUpdated;			// tiles converted again by layer updates
+	uint64_t	tilesBlended;			// summed over the frames composited and their layers
+	uint64_t	tilesCopied;			// opaque tiles written without blending, summed as above
+	uint64_t	tilesPerFrame;			// tiles in one layer covering the whole frame
+};
+
+// Keys graphics layers over 10-bit YUV (v210) frames in place, on the CPU.
+//
+// Layers are BGRA or 10-bit YUVA (Ay10) images with straight or premultiplied alpha, at
+// any position on the frame.  When a layer is set or updated it is converted to tiles of
+// 48 pixels, one v210 block, by kTileRows rows.  Each tile holds the layer premultiplied
+// in 10-bit Y'CbCr and the inverse of its alpha, both packed as v210 so that they line up
+// word for word with the frame.  Chroma is keyed with the mean alpha of its pixel pair.
+//
+// Only tiles with something in them are kept.  Compositing a frame skips transparent
+// tiles, copies opaque tiles and blends the rest as frame = layer + frame * (1 - alpha),
+// so the cost depends on what the graphics cover rather than on the frame size.  Updates
+// give the rectangle that changed, and only the tiles it touches are converted again.
+// Tiles are shared between versions of a layer, so an update does not disturb frames
+// being composited with the previous version.
+//
+// Bands of tile rows are split between the threads of the worker pool, and the thread
+// calling compositeFrame() composites bands as well.  Frames are composited one at a time.
+class Compositor
+{
+public:
+	static const unsigned	kMaxLayers = 4;
+
+	Compositor(std::shared_ptr<BandWorkerPool> workerPool);
+	virtual ~Compositor();
+
+	static bool	isLayerPixelFormatSupported(BMDPixelFormat pixelFormat);
+
+	// Sets the size of the frames to composite and removes all layers.  Only 10-bit YUV
+	// frames are supported.  Rec.601 is used for SD frames, otherwise Rec.709.
+	bool		start(long width, long height, BMDPixelFormat pixelFormat);
+	void		stop(void);
+
+	// Layers are composited in index order, so a higher index is on top.  The image is
+	// read during the call and is not kept.
+	bool		setLayer(unsigned index, BMDPixelFormat pixelFormat, long width, long height, long left, long top,
+						 bool premultiplied, const void* bytes, long rowBytes);
+	bool		updateLayer(unsigned index, const void* bytes, long rowBytes, const CompositorRect& dirtyRect);
+	void		clearLayer(unsigned index);
+
+	// Returns false if the frame was left unchanged, because it doesn't match the started
+	// format or there are no layers.  Only the left eye of a 3D frame is composited.
+	bool		compositeFrame(IDeckLinkVideoFrame* videoFrame);
+
+	void		getStatistics(CompositorStatistics& statistics);
+	void		resetStatistics(void);
+
+private:
+	static const long		kTileWidth		= 48;		// pixels in one v210 block
+	static const long		kTileWords		= 32;		// 32-bit words in one v210 block
+	static const long		kTileRows		= 16;
+
+	struct TileRow
+	{
+		uint32_t	premultiplied[kTileWords];
+		uint32_t	inverseAlpha[kTileWords];
+	};
+
+	struct Tile
+	{
+		bool		opaque;
+		TileRow		rows[kTileRows];
+	};
+
+	// Columns of tiles with something in them, for one band
+	struct TileSpan
+	{
+		long		firstColumn;
+		long		columnCount;
+	};
+
+	// One version of a layer.  Versions are never changed once published.
+	struct LayerTiles
+	{
+		std::vector<std::shared_ptr<const Tile>>	tiles;		// band-major, null where transparent
+		std::vector<std::vector<TileSpan>>			spans;		// per band
+	};
+
+	struct Layer
+	{
+		BMDPixelFormat								pixelFormat;
+		long										width;
+		long										height;
+		long										left;
+		long										top;
+		bool										premultiplied;
+		std::shared_ptr<const LayerTiles>			tiles;
+	};
+
+	long										m_width;
+	long										m_height;
+	long										m_columns;
+	long										m_bands;
+	bool										m_rec601;
+
+	// Layer conversions are serialised with changes to the frame geometry
+	std::mutex									m_updateMutex;
+	std::mutex									m_layerMutex;
+	Layer										m_layers[kMaxLayers];
+	CompositorStatistics						m_statistics;
+
+	// Per frame state, set by compositeFrame() for the workers
+	std::mutex									m_compositeMutex;
+	std::vector<std::shared_ptr<const LayerTiles>>	m_frameLayers;
+	uint8_t*									m_frameBytes;
+	long										m_frameRowBytes;
+	std::atomic<uint64_t>						m_frameTilesBlended;
+	std::atomic<uint64_t>						m_frameTilesCopied;
+
+	std::shared_ptr<BandWorkerPool>				m_workerPool;
+
+	void		compositeBand(const LayerTiles& layer, long band, uint64_t& tilesBlended, uint64_t& tilesCopied);
+
+	bool		convertTiles(Layer& layer, const void* bytes, long rowBytes, const CompositorRect& rect);
+	std::shared_ptr<const Tile>	convertTile(const Layer& layer, const void* bytes, long rowBytes, long column, long band);
+	void		readLayerPixel(const Layer& layer, const void* bytes, long rowBytes, long x, long y, int& luma, int& cb, int& cr, int& alpha);
+};
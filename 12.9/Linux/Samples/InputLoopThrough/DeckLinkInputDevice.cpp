@@ -42,6 +42,7 @@
 
 #include "platform.h"
 #include "DeckLinkInputDevice.h"
+#include "FrameTrace.h"
 #include "ReferenceTime.h"
 
 DeckLinkInputDevice::DeckLinkInputDevice(com_ptr<IDeckLink>& device) :
@@ -111,6 +112,8 @@ HRESULT DeckLinkInputDevice::VideoInputFrameArrived(IDeckLinkVideoInputFrame* vi
 {
 	// Get the current timestamp for the entry to callback for latency measurements.
 	BMDTimeValue referenceCount = ReferenceTime::getSteadyClockUptimeCount();
+
+	FRAME_TRACE_NAMED_SPAN(callbackSpan, "VideoInputFrameArrived", FrameTrace::kNoFrame);
 	
 	if (videoFrame)
 	{
@@ -125,6 +128,8 @@ HRESULT DeckLinkInputDevice::VideoInputFrameArrived(IDeckLinkVideoInputFrame* vi
 		if (videoFrame->GetStreamTime(&streamTime, &frameDuration, m_frameTimescale) != S_OK)
 			return E_FAIL;
 
+		FRAME_TRACE_SET_FRAME(callbackSpan, streamTime / frameDuration);
+
 		if (m_seenValidSignal && m_readyForCapture && m_videoInputFrameDroppedCallback)
 		{
 			// If there are any gaps in the stream time, then report the missing frames as dropped
@@ -159,6 +164,9 @@ HRESULT DeckLinkInputDevice::VideoInputFrameArrived(IDeckLinkVideoInputFrame* vi
 				// The time for start of frame on the wire is the timestamp attached to the frame at completion minus the frame duration
 				loopThroughVideoFrame->setInputFrameStartReferenceTime(referenceFrameTime - referenceFrameDuration);
 
+				// Reference times are CLOCK_MONOTONIC_RAW microseconds, the trace clock in nanoseconds
+				FRAME_TRACE_RANGE("Input", streamTime / frameDuration, (referenceFrameTime - referenceFrameDuration) * 1000, referenceCount * 1000);
+
 				loopThroughVideoFrame->setVideoStreamTime(streamTime);
 				loopThroughVideoFrame->setVideoFrameDuration(frameDuration);
 
@@ -41,13 +41,18 @@
 #include <stdexcept>
 
 #include "DeckLinkOutputDevice.h"
+#include "FrameTrace.h"
 #include "ReferenceTime.h"
 
+// Audio packets waiting to be scheduled are held in a ring of 4 seconds
+static const uint32_t kAudioRingSampleFrames = 4 * bmdAudioSampleRate48kHz;
+
 DeckLinkOutputDevice::DeckLinkOutputDevice(com_ptr<IDeckLink>& device, int videoPrerollSize) :
 	m_refCount(1),
 	m_state(PlaybackState::Idle),
 	m_deckLink(device),
 	m_deckLinkOutput(IID_IDeckLinkOutput, device),
+	m_audioFeeder(m_deckLinkOutput.get()),
 	m_videoPrerollSize(videoPrerollSize),
 	m_seenFirstVideoFrame(false),
 	m_seenFirstAudioPacket(false),
@@ -131,6 +136,10 @@ HRESULT	DeckLinkOutputDevice::ScheduledFrameCompleted(IDeckLinkVideoFrame* compl
 					{
 						loopThroughVideoFrame->setOutputCompletionResult(result);
 						loopThroughVideoFrame->setOutputFrameCompletedReferenceTime(frameCompletionTimestamp - loopThroughVideoFrame->getVideoFrameDuration());
+
+						BMDTimeValue outputStartTime = frameCompletionTimestamp - loopThroughVideoFrame->getVideoFrameDuration();
+						FRAME_TRACE_RANGE("Output", loopThroughVideoFrame->getVideoStreamTime() / loopThroughVideoFrame->getVideoFrameDuration(),
+										  (outputStartTime - loopThroughVideoFrame->getOutputLatency()) * 1000, outputStartTime * 1000);
 						m_scheduledFrameCompletedCallback(std::move(*iter));
 					}
 					// Erase item from reverse_iterator
@@ -159,6 +168,8 @@ HRESULT	DeckLinkOutputDevice::ScheduledPlaybackHasStopped()
 
 HRESULT	DeckLinkOutputDevice::RenderAudioSamples(dlbool_t preroll)
 {
+	// Packets are scheduled as they arrive, this catches anything the device could not take at the time
+	m_audioFeeder.feed();
 	return S_OK;
 }
 
@@ -210,6 +221,16 @@ bool DeckLinkOutputDevice::startPlayback(BMDDisplayMode displayMode, bool enable
 	if (m_deckLinkOutput->EnableAudioOutput(bmdAudioSampleRate48kHz, audioSampleType, audioChannelCount, bmdAudioOutputStreamTimestamped) != S_OK)
 		return false;
 
+	// Audio packets are copied into the feeder's ring and scheduled from there, in contiguous spans
+	AudioFeederSettings audioFeederSettings;
+	audioFeederSettings.channelCount = audioChannelCount;
+	audioFeederSettings.sampleDepth = (uint32_t)audioSampleType;
+	audioFeederSettings.timestamped = true;
+	audioFeederSettings.waterLevel = m_audioWaterLevel;
+	audioFeederSettings.ringSampleFrames = kAudioRingSampleFrames;
+	if (!m_audioFeeder.startStream(audioFeederSettings))
+		return false;
+
 	if (requireReferenceLocked)
 	{
 		if (!waitForReferenceSignalToLock())
@@ -278,6 +299,7 @@ void DeckLinkOutputDevice::stopPlayback()
 	// Disable video and audio outputs
 	m_deckLinkOutput->DisableAudioOutput();
 	m_deckLinkOutput->DisableVideoOutput();
+	m_audioFeeder.stop();
 
 	// Dereference DeckLinkOutputDevice delegate from callbacks
 	m_deckLinkOutput->SetScheduledFrameCompletionCallback(nullptr);
@@ -335,12 +357,15 @@ bool DeckLinkOutputDevice::isPlaybackActive()
 
 void DeckLinkOutputDevice::scheduleVideoFramesThread()
 {
+	FRAME_TRACE_THREAD_NAME("Schedule video");
+
 	while (true)
 	{
 		std::shared_ptr<LoopThroughVideoFrame> outputFrame;
 	
 		if (m_outputVideoFrameQueue.waitForSample(outputFrame))
 		{
+			FRAME_TRACE_SPAN("ScheduleVideoFrame", outputFrame->getVideoStreamTime() / outputFrame->getVideoFrameDuration());
 			std::lock_guard<std::mutex> lock(m_mutex);
 
 			// Record the stream time of the first frame, so we can start playing from that point
@@ -390,7 +415,7 @@ void DeckLinkOutputDevice::scheduleAudioPacketsThread()
 			// Get the reference time when audio packet was scheduled
 			BMDTimeValue scheduleReferenceCount = ReferenceTime::getSteadyClockUptimeCount();
 
-			if (m_deckLinkOutput->ScheduleAudioSamples(outputPacket->getBuffer(), (uint32_t)outputPacket->getSampleFrameCount(), outputPacket->getAudioStreamTime(), m_frameTimescale, nullptr) != S_OK)
+			if (!m_audioFeeder.write(outputPacket->getBuffer(), (uint32_t)outputPacket->getSampleFrameCount(), outputPacket->getAudioStreamTime(), m_frameTimescale))
 			{
 				fprintf(stderr, "Unable to schedule output audio packet\n");
 				break;
@@ -431,17 +456,12 @@ bool DeckLinkOutputDevice::waitForReferenceSignalToLock()
 
 void DeckLinkOutputDevice::checkEndOfPreroll()
 {
-	uint32_t prerollAudioSampleCount;
-	
 	// Ensure that both audio and video preroll have sufficient samples, then commence scheduled playback
 	if (m_state == PlaybackState::Prerolling)
 	{
-		// If prerolling, check whether sufficent audio and video samples have been scheduled
-		if (m_deckLinkOutput->GetBufferedAudioSampleFrameCount(&prerollAudioSampleCount) != S_OK)
-		{
-			fprintf(stderr, "Unable to get audio sample count\n");
-			return;
-		}
+		// If prerolling, check whether sufficent audio and video samples have been scheduled.  The feeder
+		// counts the samples it has scheduled, so there is no need to ask the device
+		int64_t prerollAudioSampleCount = m_audioFeeder.getBufferedSampleFrames();
 
 		if ((prerollAudioSampleCount >= m_audioWaterLevel) && (m_scheduledFramesList.size() >= m_videoPrerollSize))
 		{
@@ -49,6 +49,7 @@
 #include <thread>
 
 #include "DeckLinkAPI.h"
+#include "AudioFeeder.h"
 #include "LoopThroughAudioPacket.h"
 #include "LoopThroughVideoFrame.h"
 #include "SampleQueue.h"
@@ -93,6 +94,8 @@ public:
 	void						scheduleVideoFrame(std::shared_ptr<LoopThroughVideoFrame> videoFrame) { m_outputVideoFrameQueue.pushSample(videoFrame); }
 	void						scheduleAudioPacket(std::shared_ptr<LoopThroughAudioPacket> audioPacket) { m_outputAudioPacketQueue.pushSample(audioPacket); }
 
+	void						getAudioFeederStatistics(AudioFeederStatistics& statistics) { m_audioFeeder.getStatistics(statistics); }
+
 	void						onScheduledFrameCompleted(const ScheduledFrameCompletedCallback& callback) { m_scheduledFrameCompletedCallback = callback; }
 	void						onAudioPacketScheduled(const ScheduledAudioPacketCallback& callback) { m_scheduledAudioPacketCallback = callback; }
 
@@ -102,6 +105,7 @@ private:
 	//
 	com_ptr<IDeckLink>										m_deckLink;
 	com_ptr<IDeckLinkOutput>								m_deckLinkOutput;
+	AudioFeeder												m_audioFeeder;
 	//
 	SampleQueue<std::shared_ptr<LoopThroughVideoFrame>>		m_outputVideoFrameQueue;
 	SampleQueue<std::shared_ptr<LoopThroughAudioPacket>>	m_outputAudioPacketQueue;
@@ -78,24 +78,79 @@
 //   - When set to false, the latency for every output frame is displayed to stdout
 //   - In both modes or operation, a full statistical summary is displayed when application
 //     completes
+//
+// Time-shift mode:
+// * Started with -f <file>, the input is played out delayed by -d seconds through a circular
+//     file of -s seconds on disk, see TimeShiftBuffer.  The file is preallocated, so disk space
+//     and memory use are constant however long the delay
+// * The delay can be changed while running by entering a new delay in seconds, the change
+//     takes effect on the next output frame without interrupting playback
+// * The buffer and its delay survive a restart, running again with the same file and format
+//     resumes the delayed output where it stopped
+// * Video, audio and stream times are delayed.  Timecode and ancillary data are not stored,
+//     and a 3D input is played out as its left eye
+//
+// Sync measurement mode:
+// * Started with -m, the output is replaced by test frames to measure the equipment connected
+//     from the output back to the input, see SyncMeasurement.  Each frame carries a VANC
+//     packet with its frame number and the time it was stamped, and once a second a white
+//     frame is output with a 1 kHz beep
+// * The input decodes the stamps to give the glass-to-glass latency, from the start of a frame
+//     on the output wire to the start of that frame on the input wire, and finds the flashes
+//     and beeps to give the A/V offset.  Both are summarised with a histogram
+// * Connecting the output straight to the input measures the latency of the card itself
+// * "make check" runs SyncMeasurementTest, which checks the measurement against a simulated
+//     loopback with known latency and A/V offset
+//
+// Graphics compositing:
+// * Started with one or more -k <file>, graphics layers are keyed over the input in the
+//     processing stage in place of the simulated processing time, see Compositor.  A file is
+//     a raw BGRA frame the size of the input, or a 10-bit YUVA frame if its name ends .ay10.
+//     The first file is the bottom layer
+// * Files are read again when they change, and only the part that changed is converted, so
+//     graphics can be updated by another application while the loop-through is running
+// * Graphics are keyed over 10-bit YUV input only, other pixel formats are passed through
+//
+// Scaling:
+// * Started with -o <mode>, the output runs in another display mode, such as 1080p25 from a
+//     2160p25 input, and the input is scaled to it in the processing stage, see Scaler.  The
+//     filter is chosen with -F, Lanczos by default
+// * The output mode must have the same frame rate as the input, otherwise the input is
+//     looped through unscaled.  Graphics are composited before scaling, at the input size,
+//     and both share one pool of kBandWorkerThreadCount threads, see BandWorkerPool
+// * 8-bit and 10-bit YUV are scaled, other pixel formats are looped through unscaled.  The
+//     output is 2D, and timecode is carried over to it but other ancillary data is not
 //*************************************************************************************/
 
 
 #include <chrono>
+#include <cmath>
 #include <condition_variable>
+#include <cstring>
 #include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <numeric>
 #include <random>
+#include <string>
 #include <thread>
+#include <vector>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "Compositor.h"
 #include "DeckLinkInputDevice.h"
 #include "DeckLinkOutputDevice.h"
 #include "DispatchQueue.h"
+#include "FrameTrace.h"
 #include "SampleQueue.h"
 #include "LatencyStatistics.h"
 #include "ReferenceTime.h"
+#include "Scaler.h"
+#include "SyncMeasurement.h"
+#include "TimeShiftBuffer.h"
 #include "DeckLinkAPI.h"
 #include "com_ptr.h"
 #include "platform.h"
@@ -118,6 +173,17 @@ const long					kRollingAverageUpdateRateMs	= 2000;		// Print rolling average eve
 const double				kProcessingAdditionalTimeMean		= 5.0;		// Mean additional time injected into video processing thread (ms)
 const double				kProcessingAdditionalTimeStdDev		= 0.1;		// Standard deviation of time injected into video processing thread (ms)
 
+const double				kDefaultTimeShiftCapacity	= 60.0;		// Length of the time-shift buffer (seconds)
+const double				kDefaultTimeShiftDelay		= 10.0;		// Delay of a new time-shift buffer (seconds)
+const int					kTimeShiftOutputPreroll		= 4;		// Output preroll in time-shift mode, covers the time to read a frame back from disk
+const uint32_t				kTimeShiftReadBuffers		= 12;		// Frames read back from disk and not yet output
+
+const unsigned				kBandWorkerThreadCount		= 4;		// number of threads compositing and scaling bands of each frame
+const long					kGraphicsPollRateMs			= 500;		// Check graphics files for changes twice a second
+
+const size_t				kHistogramMaxRows			= 20;		// Adjacent histogram bins are merged to print at most this many rows
+const int					kHistogramBarWidth			= 50;
+
 // Output frame completion result pair = { Completion result string, frame output boolean}
 const std::map<BMDOutputFrameCompletionResult, std::pair<const char*, bool>> kOutputCompletionResults
 {
@@ -141,6 +207,26 @@ const std::map<BMDPixelFormat, const char*> kPixelFormats =
 	{ bmdFormat10BitRGBX,	"10-bit RGBX" },
 };
 
+struct TimeShiftOptions
+{
+	const char*	path;				// nullptr for loop-through without a delay
+	double		capacitySeconds;
+	double		delaySeconds;
+	bool		delaySpecified;		// otherwise a resumed buffer keeps its saved delay
+};
+
+struct CompositingOptions
+{
+	std::vector<const char*>	graphicsPaths;		// bottom layer first, empty for no compositing
+	bool						premultiplied;		// BGRA graphics have premultiplied alpha
+};
+
+struct ScalingOptions
+{
+	const char*		outputDisplayModeName;	// nullptr to output in the input display mode
+	ScalerFilter	filter;
+};
+
 struct ThreadNotifier
 {
 	std::mutex mutex;
@@ -184,6 +270,8 @@ LatencyStatistics												g_videoInputLatencyStatistics(kRollingAverageSample
 LatencyStatistics												g_videoProcessingLatencyStatistics(kRollingAverageSampleCount);
 LatencyStatistics												g_videoOutputLatencyStatistics(kRollingAverageSampleCount);
 LatencyStatistics												g_audioProcessingLatencyStatistics(kRollingAverageSampleCount);
+LatencyStatistics												g_compositingTimeStatistics(kRollingAverageSampleCount);
+LatencyStatistics												g_scalingTimeStatistics(kRollingAverageSampleCount);
 
 std::map<BMDOutputFrameCompletionResult, int>					g_frameCompletionResultCount;
 int 															g_outputFrameCount = 0;
@@ -194,6 +282,12 @@ std::normal_distribution<double> 								g_sleepDistribution(kProcessingAddition
 
 ThreadNotifier													g_printRollingAverageNotifier;
 ThreadNotifier													g_loopThroughSessionNotifier;
+ThreadNotifier													g_graphicsPollNotifier;
+
+std::unique_ptr<TimeShiftBuffer>								g_timeShiftBuffer;
+std::unique_ptr<SyncMeasurement>								g_syncMeasurement;
+std::unique_ptr<Compositor>										g_compositor;
+std::unique_ptr<Scaler>											g_scaler;
 
 struct FormatDescription
 {
@@ -202,6 +296,18 @@ struct FormatDescription
 	BMDPixelFormat pixelFormat;
 };
 
+// A graphics layer file and the image last read from it
+struct GraphicsLayerFile
+{
+	std::string				path;
+	BMDPixelFormat			pixelFormat;
+	struct timespec			modifiedTime;
+	bool					loaded;
+	std::vector<uint8_t>	bytes;
+};
+
+std::vector<GraphicsLayerFile>									g_graphicsLayerFiles;
+
 bool operator==(const FormatDescription& desc1, const FormatDescription& desc2)
 {
 	return std::tie(desc1.displayMode, desc1.pixelFormat, desc1.is3D) == std::tie(desc2.displayMode, desc2.pixelFormat, desc2.is3D);
@@ -226,6 +332,21 @@ void dispatch_printf(DispatchQueue& dispatchQueue, const char* format, Args... a
 	});
 }
 
+long getRowBytes(BMDPixelFormat pixelFormat, long width)
+{
+	switch (pixelFormat)
+	{
+		case bmdFormat8BitYUV:
+			return width * 2;
+		case bmdFormat10BitYUV:
+			return ((width + 47) / 48) * 128;
+		case bmdFormat10BitRGB:
+			return ((width + 63) / 64) * 256;
+		default:
+			return width * 4;
+	}
+}
+
 void processVideo(std::shared_ptr<LoopThroughVideoFrame>& videoFrame, com_ptr<DeckLinkOutputDevice>& deckLinkOutput)
 {
 	// Main video processing function, it is intended to invoke with DispatchQueue to allow multi-threading of incoming frames
@@ -240,13 +361,43 @@ void processVideo(std::shared_ptr<LoopThroughVideoFrame>& videoFrame, com_ptr<De
 	if (!deckLinkOutput->isPlaybackActive())
 		return;
 
-	// Simulate doing something by using a busy wait loop
-	// This is more precise than sleeping
-	int delay = (int)std::round(g_sleepDistribution(g_randomEngine) * 1000);
-	auto target = std::chrono::steady_clock::now() + std::chrono::microseconds(delay);
-	uint32_t i = 0;
-	while (std::chrono::steady_clock::now() < target)
-		++i;
+	FRAME_TRACE_SPAN("processVideo", videoFrame->getVideoStreamTime() / videoFrame->getVideoFrameDuration());
+
+	if (g_compositor)
+	{
+		// Key the graphics over the input frame in place
+		BMDTimeValue compositeStartTime = ReferenceTime::getSteadyClockUptimeCount();
+
+		if (g_compositor->compositeFrame(videoFrame->getVideoFramePtr()))
+			g_compositingTimeStatistics.addSample(ReferenceTime::getSteadyClockUptimeCount() - compositeStartTime);
+	}
+	else
+	{
+		// Simulate doing something by using a busy wait loop
+		// This is more precise than sleeping
+		int delay = (int)std::round(g_sleepDistribution(g_randomEngine) * 1000);
+		auto target = std::chrono::steady_clock::now() + std::chrono::microseconds(delay);
+		uint32_t i = 0;
+		while (std::chrono::steady_clock::now() < target)
+			++i;
+	}
+
+	if (g_scaler && g_scaler->isStarted())
+	{
+		// The output is in another display mode, so a frame that can't be scaled is not output
+		BMDTimeValue					scaleStartTime = ReferenceTime::getSteadyClockUptimeCount();
+		com_ptr<IDeckLinkVideoFrame>	scaledFrame = g_scaler->scaleFrame(videoFrame->getVideoFramePtr());
+
+		if (!scaledFrame)
+			return;
+
+		g_scalingTimeStatistics.addSample(ReferenceTime::getSteadyClockUptimeCount() - scaleStartTime);
+		videoFrame->setVideoFrame(scaledFrame);
+	}
+
+	// In sync measurement mode the output is a stamped test frame
+	if (g_syncMeasurement)
+		g_syncMeasurement->stampVideoFrame(videoFrame);
 
 	// At end of function, remember to queue your output frame
 	deckLinkOutput->scheduleVideoFrame(std::move(videoFrame));
@@ -274,6 +425,9 @@ void processAudio(std::shared_ptr<LoopThroughAudioPacket>& audioPacket, com_ptr<
 	uint32_t i = 0;
 	while (std::chrono::steady_clock::now() < target)
 		++i;
+
+	if (g_syncMeasurement)
+		g_syncMeasurement->fillAudioPacket(audioPacket);
 	
 	// At end of function, remember to queue your output audio packet
 	deckLinkOutput->scheduleAudioPacket(std::move(audioPacket));
@@ -356,6 +510,9 @@ void updateCompletedFrameLatency(std::shared_ptr<LoopThroughVideoFrame> complete
 	
 	g_outputFrameCount++;
 	++g_frameCompletionResultCount[completedFrame->getOutputCompletionResult()];
+
+	if (g_syncMeasurement)
+		g_syncMeasurement->frameOutput(completedFrame);
 	
 	if (!kPrintRollingAverage)
 	{
@@ -363,6 +520,163 @@ void updateCompletedFrameLatency(std::shared_ptr<LoopThroughVideoFrame> complete
 	}
 }
 
+void printTimeShiftStatistics(DispatchQueue& printDispatchQueue)
+{
+	TimeShiftStatistics statistics;
+
+	g_timeShiftBuffer->getStatistics(statistics);
+
+	dispatch_printf(printDispatchQueue,
+					"Time-shift delay %.2f s; %llu frames written (%llu copied, %llu dropped), %llu read, %llu repeated (%llu without a free buffer); Maximum write = %.2f ms, read = %.2f ms\n",
+					g_timeShiftBuffer->getDelaySeconds(),
+					(unsigned long long)statistics.framesWritten, (unsigned long long)statistics.framesCopied, (unsigned long long)statistics.writeOverruns,
+					(unsigned long long)statistics.framesRead, (unsigned long long)statistics.framesRepeated, (unsigned long long)statistics.readBufferStarved,
+					(double)statistics.maxWriteTime / ReferenceTime::kTicksPerMilliSec,
+					(double)statistics.maxReadTime / ReferenceTime::kTicksPerMilliSec);
+}
+
+void printHistogram(const char* name, LatencyHistogram& histogram, DispatchQueue& printDispatchQueue)
+{
+	std::vector<uint64_t>	bins;
+	uint64_t				underflowCount;
+	uint64_t				overflowCount;
+	size_t					firstBin;
+	size_t					lastBin;
+
+	histogram.getCounts(bins, underflowCount, overflowCount);
+
+	for (firstBin = 0; (firstBin < bins.size()) && (bins[firstBin] == 0); firstBin++) { }
+	for (lastBin = bins.size(); (lastBin > firstBin) && (bins[lastBin - 1] == 0); lastBin--) { }
+
+	dispatch_printf(printDispatchQueue, "\n%s histogram:\n", name);
+
+	if (underflowCount > 0)
+		dispatch_printf(printDispatchQueue, "  below      %7.1f ms %8llu\n", (double)histogram.getMinimum() / ReferenceTime::kTicksPerMilliSec, (unsigned long long)underflowCount);
+
+	if (firstBin < lastBin)
+	{
+		size_t		binsPerRow = (lastBin - firstBin + kHistogramMaxRows - 1) / kHistogramMaxRows;
+		uint64_t	maxRowCount = 0;
+
+		for (size_t row = firstBin; row < lastBin; row += binsPerRow)
+			maxRowCount = std::max(maxRowCount, std::accumulate(bins.begin() + row, bins.begin() + std::min(row + binsPerRow, lastBin), (uint64_t)0));
+
+		for (size_t row = firstBin; row < lastBin; row += binsPerRow)
+		{
+			uint64_t	rowCount = std::accumulate(bins.begin() + row, bins.begin() + std::min(row + binsPerRow, lastBin), (uint64_t)0);
+			int			barLength = (int)((rowCount * kHistogramBarWidth + maxRowCount - 1) / maxRowCount);
+			std::string	bar = (rowCount > 0) ? " " + std::string(barLength, '#') : "";
+			double		rowStart = (double)(histogram.getMinimum() + (BMDTimeValue)row * histogram.getBinWidth()) / ReferenceTime::kTicksPerMilliSec;
+
+			dispatch_printf(printDispatchQueue, "  %7.1f .. %7.1f ms %8llu%s\n",
+							rowStart, rowStart + (double)(binsPerRow * histogram.getBinWidth()) / ReferenceTime::kTicksPerMilliSec,
+							(unsigned long long)rowCount, bar.c_str());
+		}
+	}
+
+	if (overflowCount > 0)
+		dispatch_printf(printDispatchQueue, "  above      %7.1f ms %8llu\n",
+						(double)(histogram.getMinimum() + (BMDTimeValue)bins.size() * histogram.getBinWidth()) / ReferenceTime::kTicksPerMilliSec, (unsigned long long)overflowCount);
+}
+
+void printSyncMeasurementLatency(const char* name, LatencyStatistics& statistics, DispatchQueue& printDispatchQueue)
+{
+	BMDTimeValue mean;
+	BMDTimeValue stddev;
+
+	// Nothing measured yet
+	if (statistics.getMinimum() > statistics.getMaximum())
+		return;
+
+	std::tie(mean, stddev) = statistics.getMeanAndStdDev();
+	dispatch_printf(printDispatchQueue,
+					"%sMinimum = %6.2f ms, Maximum = %6.2f ms, Mean = %6.2f ms, StdDev = %.2f ms\n",
+					name,
+					(double)statistics.getMinimum() / ReferenceTime::kTicksPerMilliSec,
+					(double)statistics.getMaximum() / ReferenceTime::kTicksPerMilliSec,
+					(double)mean / ReferenceTime::kTicksPerMilliSec,
+					(double)stddev / ReferenceTime::kTicksPerMilliSec);
+}
+
+void printSyncMeasurementSummary(DispatchQueue& printDispatchQueue)
+{
+	SyncMeasurementStatistics statistics;
+
+	g_syncMeasurement->getStatistics(statistics);
+
+	dispatch_printf(printDispatchQueue,
+					"\nSync measurement: %llu frames stamped, %llu stamps decoded, %llu frames without a stamp, %llu stamps lost; %llu flashes output, %llu detected, %llu beeps detected\n",
+					(unsigned long long)statistics.framesStamped, (unsigned long long)statistics.stampsDecoded,
+					(unsigned long long)statistics.framesWithoutStamp, (unsigned long long)statistics.stampsLost,
+					(unsigned long long)statistics.flashesOutput, (unsigned long long)statistics.flashesDetected, (unsigned long long)statistics.beepsDetected);
+
+	printSyncMeasurementLatency("Glass-to-glass Latency:\t", g_syncMeasurement->getGlassToGlassStatistics(), printDispatchQueue);
+	printSyncMeasurementLatency("Stamp to Input Latency:\t", g_syncMeasurement->getStampToInputStatistics(), printDispatchQueue);
+	printSyncMeasurementLatency("Flash Latency:\t\t", g_syncMeasurement->getFlashLatencyStatistics(), printDispatchQueue);
+
+	// Positive when the audio is behind the video
+	printSyncMeasurementLatency("A/V Offset:\t\t", g_syncMeasurement->getAVOffsetStatistics(), printDispatchQueue);
+
+	if (g_syncMeasurement->getGlassToGlassHistogram().getSampleCount() > 0)
+		printHistogram("Glass-to-glass latency", g_syncMeasurement->getGlassToGlassHistogram(), printDispatchQueue);
+
+	if (g_syncMeasurement->getAVOffsetHistogram().getSampleCount() > 0)
+		printHistogram("A/V offset", g_syncMeasurement->getAVOffsetHistogram(), printDispatchQueue);
+}
+
+void printCompositorSummary(DispatchQueue& printDispatchQueue)
+{
+	CompositorStatistics	statistics;
+	BMDTimeValue			mean;
+	BMDTimeValue			stddev;
+
+	g_compositor->getStatistics(statistics);
+	if (statistics.framesComposited == 0)
+		return;
+
+	std::tie(mean, stddev) = g_compositingTimeStatistics.getMeanAndStdDev();
+	dispatch_printf(printDispatchQueue,
+					"Compositing Time:\t\tMinimum = %6.2f ms, Maximum = %6.2f ms, Mean = %6.2f ms, StdDev = %.2f ms\n",
+					(double)g_compositingTimeStatistics.getMinimum() / ReferenceTime::kTicksPerMilliSec,
+					(double)g_compositingTimeStatistics.getMaximum() / ReferenceTime::kTicksPerMilliSec,
+					(double)mean / ReferenceTime::kTicksPerMilliSec,
+					(double)stddev / ReferenceTime::kTicksPerMilliSec);
+
+	dispatch_printf(printDispatchQueue,
+					"Compositing Tiles:\t\tBlended = %.1f, Copied = %.1f of %llu per frame, %llu converted by %llu graphics updates\n",
+					(double)statistics.tilesBlended / statistics.framesComposited,
+					(double)statistics.tilesCopied / statistics.framesComposited,
+					(unsigned long long)statistics.tilesPerFrame,
+					(unsigned long long)statistics.tilesUpdated,
+					(unsigned long long)statistics.layerUpdates);
+}
+
+void printScalerSummary(DispatchQueue& printDispatchQueue)
+{
+	ScalerStatistics	statistics;
+	BMDTimeValue		mean;
+	BMDTimeValue		stddev;
+
+	g_scaler->getStatistics(statistics);
+	if (statistics.framesScaled == 0)
+		return;
+
+	std::tie(mean, stddev) = g_scalingTimeStatistics.getMeanAndStdDev();
+	dispatch_printf(printDispatchQueue,
+					"Scaling Time:\t\t\tMinimum = %6.2f ms, Maximum = %6.2f ms, Mean = %6.2f ms, StdDev = %.2f ms\n",
+					(double)g_scalingTimeStatistics.getMinimum() / ReferenceTime::kTicksPerMilliSec,
+					(double)g_scalingTimeStatistics.getMaximum() / ReferenceTime::kTicksPerMilliSec,
+					(double)mean / ReferenceTime::kTicksPerMilliSec,
+					(double)stddev / ReferenceTime::kTicksPerMilliSec);
+
+	dispatch_printf(printDispatchQueue,
+					"Scaling Frames:\t\t\tScaled = %llu, Not scaled = %llu, %llu output buffers, %llu coefficient tables computed\n",
+					(unsigned long long)statistics.framesScaled,
+					(unsigned long long)statistics.framesRejected,
+					(unsigned long long)statistics.buffersAllocated,
+					(unsigned long long)statistics.tablesBuilt);
+}
+
 void printRollingAverage(DispatchQueue& printDispatchQueue)
 {
 	std::chrono::milliseconds	printRollingAveragePeriod(kRollingAverageUpdateRateMs);
@@ -379,6 +693,35 @@ void printRollingAverage(DispatchQueue& printDispatchQueue)
 							(double)g_videoInputLatencyStatistics.getRollingAverage() / ReferenceTime::kTicksPerMilliSec,
 							(double)g_videoProcessingLatencyStatistics.getRollingAverage() / ReferenceTime::kTicksPerMilliSec,
 							(double)g_videoOutputLatencyStatistics.getRollingAverage() / ReferenceTime::kTicksPerMilliSec);
+
+			if (g_timeShiftBuffer)
+				printTimeShiftStatistics(printDispatchQueue);
+
+			if (g_compositor)
+			{
+				CompositorStatistics compositorStatistics;
+
+				g_compositor->getStatistics(compositorStatistics);
+				dispatch_printf(printDispatchQueue,
+								"Average compositing time = %.2f ms, %llu graphics updates\n",
+								(double)g_compositingTimeStatistics.getRollingAverage() / ReferenceTime::kTicksPerMilliSec,
+								(unsigned long long)compositorStatistics.layerUpdates);
+			}
+
+			if (g_scaler && g_scaler->isStarted())
+			{
+				dispatch_printf(printDispatchQueue,
+								"Average scaling time = %.2f ms\n",
+								(double)g_scalingTimeStatistics.getRollingAverage() / ReferenceTime::kTicksPerMilliSec);
+			}
+
+			if (g_syncMeasurement)
+			{
+				dispatch_printf(printDispatchQueue,
+								"Average glass-to-glass latency = %.2f ms, A/V offset = %.2f ms\n",
+								(double)g_syncMeasurement->getGlassToGlassStatistics().getRollingAverage() / ReferenceTime::kTicksPerMilliSec,
+								(double)g_syncMeasurement->getAVOffsetStatistics().getRollingAverage() / ReferenceTime::kTicksPerMilliSec);
+			}
 		}
 		else
 		{
@@ -387,9 +730,11 @@ void printRollingAverage(DispatchQueue& printDispatchQueue)
 	}
 }
 
-void printOutputSummary(DispatchQueue& printDispatchQueue)
+void printOutputSummary(com_ptr<DeckLinkOutputDevice>& deckLinkOutput, DispatchQueue& printDispatchQueue)
 {
-	int displayedFrames = 0;
+	int						displayedFrames = 0;
+	AudioFeederStatistics	audioFeederStatistics;
+
 	dispatch_printf(printDispatchQueue, "\nFrames dropped on capture: %d\n", g_droppedOnCaptureFrameCount);
 	for (auto completionResultIter : kOutputCompletionResults)
 	{
@@ -440,6 +785,29 @@ void printOutputSummary(DispatchQueue& printDispatchQueue)
 						(double)g_audioProcessingLatencyStatistics.getMaximum() / ReferenceTime::kTicksPerMilliSec,
 						(double)mean / ReferenceTime::kTicksPerMilliSec,
 						(double)stddev / ReferenceTime::kTicksPerMilliSec);	}
+
+	deckLinkOutput->getAudioFeederStatistics(audioFeederStatistics);
+	if (audioFeederStatistics.running)
+	{
+		dispatch_printf(printDispatchQueue,
+						"Audio Output Margin:\t\tMinimum = %6.2f ms, Underruns = %llu, Discontinuities = %llu, Dropped = %llu sample frames\n",
+						(double)audioFeederStatistics.minimumMargin * 1000.0 / AudioFeeder::kSampleRate,
+						(unsigned long long)audioFeederStatistics.underruns,
+						(unsigned long long)audioFeederStatistics.discontinuities,
+						(unsigned long long)audioFeederStatistics.droppedSampleFrames);
+	}
+
+	if (g_compositor)
+		printCompositorSummary(printDispatchQueue);
+
+	if (g_scaler)
+		printScalerSummary(printDispatchQueue);
+
+	if (g_timeShiftBuffer)
+		printTimeShiftStatistics(printDispatchQueue);
+
+	if (g_syncMeasurement)
+		printSyncMeasurementSummary(printDispatchQueue);
 }
 
 void printReferenceStatus(com_ptr<DeckLinkOutputDevice>& deckLinkOutput, DispatchQueue& printDispatchQueue)
@@ -470,7 +838,274 @@ void printReferenceStatus(com_ptr<DeckLinkOutputDevice>& deckLinkOutput, Dispatc
 	}
 }
 
-HRESULT InputLoopThrough(void)
+bool openTimeShiftBuffer(com_ptr<DeckLinkOutputDevice>& deckLinkOutput, const FormatDescription& formatDesc, double delaySeconds, bool overrideDelay, DispatchQueue& printDispatchQueue)
+{
+	com_ptr<IDeckLinkDisplayMode>	deckLinkDisplayMode;
+	TimeShiftFormat					format;
+
+	if (deckLinkOutput->getDeckLinkOutput()->GetDisplayMode(formatDesc.displayMode, deckLinkDisplayMode.releaseAndGetAddressOf()) != S_OK)
+		return false;
+
+	format.width				= deckLinkDisplayMode->GetWidth();
+	format.height				= deckLinkDisplayMode->GetHeight();
+	format.rowBytes				= getRowBytes(formatDesc.pixelFormat, format.width);
+	format.pixelFormat			= formatDesc.pixelFormat;
+	format.audioChannelCount	= g_audioChannelCount;
+	format.audioSampleSize		= kAudioSampleType / 8;
+
+	if (deckLinkDisplayMode->GetFrameRate(&format.frameDuration, &format.frameTimescale) != S_OK)
+		return false;
+
+	if (!g_timeShiftBuffer->open(format, delaySeconds, overrideDelay))
+		return false;
+
+	if (g_timeShiftBuffer->getResumedFrameCount() > 0)
+		dispatch_printf(printDispatchQueue, "Resuming time-shift buffer with %llu frames\n", (unsigned long long)g_timeShiftBuffer->getResumedFrameCount());
+
+	dispatch_printf(printDispatchQueue, "Time-shift delay %.2f s of %.2f s buffer%s\n",
+					g_timeShiftBuffer->getDelaySeconds(), g_timeShiftBuffer->getCapacitySeconds(),
+					g_timeShiftBuffer->isDirectIO() ? ", O_DIRECT" : "");
+
+	return true;
+}
+
+bool startSyncMeasurement(com_ptr<DeckLinkOutputDevice>& deckLinkOutput, const FormatDescription& formatDesc)
+{
+	com_ptr<IDeckLinkDisplayMode>	deckLinkDisplayMode;
+	SyncMeasurementFormat			format;
+
+	if (deckLinkOutput->getDeckLinkOutput()->GetDisplayMode(formatDesc.displayMode, deckLinkDisplayMode.releaseAndGetAddressOf()) != S_OK)
+		return false;
+
+	format.width				= deckLinkDisplayMode->GetWidth();
+	format.height				= deckLinkDisplayMode->GetHeight();
+	format.rowBytes				= getRowBytes(formatDesc.pixelFormat, format.width);
+	format.pixelFormat			= formatDesc.pixelFormat;
+	format.audioChannelCount	= g_audioChannelCount;
+	format.audioSampleSize		= kAudioSampleType / 8;
+
+	if (deckLinkDisplayMode->GetFrameRate(&format.frameDuration, &format.frameTimescale) != S_OK)
+		return false;
+
+	return g_syncMeasurement->start(format);
+}
+
+// Reads the graphics files that are new or have changed and passes them to the compositor.
+// Only the rectangle that differs from the image last read from a file is converted again.
+// Files should be replaced by renaming a new file over them, so they are never read part
+// written.
+void updateGraphicsLayers(long width, long height, bool premultiplied, DispatchQueue& printDispatchQueue)
+{
+	const long		rowBytes = width * 4;
+	const size_t	imageSize = (size_t)(rowBytes * height);
+
+	for (unsigned index = 0; index < g_graphicsLayerFiles.size(); index++)
+	{
+		GraphicsLayerFile&		layerFile = g_graphicsLayerFiles[index];
+		struct stat				fileStat;
+		std::vector<uint8_t>	bytes;
+		FILE*					file;
+		bool					complete;
+
+		if (stat(layerFile.path.c_str(), &fileStat) != 0)
+			continue;
+
+		if (layerFile.loaded &&
+			(fileStat.st_mtim.tv_sec == layerFile.modifiedTime.tv_sec) &&
+			(fileStat.st_mtim.tv_nsec == layerFile.modifiedTime.tv_nsec))
+			continue;
+
+		layerFile.modifiedTime = fileStat.st_mtim;
+
+		if ((size_t)fileStat.st_size != imageSize)
+		{
+			dispatch_printf(printDispatchQueue, "Graphics file %s is not a %ldx%ld image\n", layerFile.path.c_str(), width, height);
+			continue;
+		}
+
+		file = fopen(layerFile.path.c_str(), "rb");
+		if (file == nullptr)
+			continue;
+
+		bytes.resize(imageSize);
+		complete = (fread(bytes.data(), 1, imageSize, file) == imageSize);
+		fclose(file);
+
+		if (!complete)
+			continue;
+
+		if (layerFile.loaded)
+		{
+			CompositorRect	dirtyRect = { width, height, 0, 0 };
+			long			bottom = 0;
+			long			right = 0;
+
+			// Bounding rectangle of the pixels that changed
+			for (long y = 0; y < height; y++)
+			{
+				const uint8_t*	newRow = bytes.data() + y * rowBytes;
+				const uint8_t*	oldRow = layerFile.bytes.data() + y * rowBytes;
+				long			first = 0;
+				long			last = width;
+
+				if (memcmp(newRow, oldRow, rowBytes) == 0)
+					continue;
+
+				while (memcmp(newRow + first * 4, oldRow + first * 4, 4) == 0)
+					++first;
+				while (memcmp(newRow + (last - 1) * 4, oldRow + (last - 1) * 4, 4) == 0)
+					--last;
+
+				dirtyRect.x = std::min(dirtyRect.x, first);
+				dirtyRect.y = std::min(dirtyRect.y, y);
+				right = std::max(right, last);
+				bottom = y + 1;
+			}
+
+			layerFile.bytes.swap(bytes);
+
+			if (bottom > 0)
+			{
+				dirtyRect.width = right - dirtyRect.x;
+				dirtyRect.height = bottom - dirtyRect.y;
+				g_compositor->updateLayer(index, layerFile.bytes.data(), rowBytes, dirtyRect);
+			}
+		}
+		else
+		{
+			layerFile.bytes.swap(bytes);
+
+			if (g_compositor->setLayer(index, layerFile.pixelFormat, width, height, 0, 0, premultiplied, layerFile.bytes.data(), rowBytes))
+			{
+				layerFile.loaded = true;
+				dispatch_printf(printDispatchQueue, "Graphics layer %u: %s\n", index + 1, layerFile.path.c_str());
+			}
+		}
+	}
+}
+
+void pollGraphicsLayers(long width, long height, bool premultiplied, DispatchQueue& printDispatchQueue)
+{
+	std::chrono::milliseconds	pollPeriod(kGraphicsPollRateMs);
+
+	while (true)
+	{
+		std::unique_lock<std::mutex> lock(g_graphicsPollNotifier.mutex);
+		if (g_graphicsPollNotifier.condition.wait_for(lock, pollPeriod, [] { return g_graphicsPollNotifier.isNotifiedLocked(); }))
+			break;
+
+		lock.unlock();
+		updateGraphicsLayers(width, height, premultiplied, printDispatchQueue);
+	}
+}
+
+// Returns true if graphics will be composited over the format
+bool startCompositor(com_ptr<DeckLinkOutputDevice>& deckLinkOutput, const FormatDescription& formatDesc, bool premultiplied, long& width, long& height, DispatchQueue& printDispatchQueue)
+{
+	com_ptr<IDeckLinkDisplayMode> deckLinkDisplayMode;
+
+	if (deckLinkOutput->getDeckLinkOutput()->GetDisplayMode(formatDesc.displayMode, deckLinkDisplayMode.releaseAndGetAddressOf()) != S_OK)
+		return false;
+
+	width = deckLinkDisplayMode->GetWidth();
+	height = deckLinkDisplayMode->GetHeight();
+
+	if (!g_compositor->start(width, height, formatDesc.pixelFormat))
+	{
+		dispatch_printf(printDispatchQueue, "Graphics are only composited over 10-bit YUV, the input is passed through\n");
+		return false;
+	}
+
+	// The layers are read again for the new frame size
+	for (GraphicsLayerFile& layerFile : g_graphicsLayerFiles)
+	{
+		layerFile.loaded = false;
+		layerFile.bytes.clear();
+	}
+
+	updateGraphicsLayers(width, height, premultiplied, printDispatchQueue);
+	return true;
+}
+
+std::string getDisplayModeName(com_ptr<IDeckLinkDisplayMode>& deckLinkDisplayMode)
+{
+	dlstring_t		displayModeName;
+	std::string		displayModeNameString;
+
+	if (deckLinkDisplayMode->GetName(&displayModeName) == S_OK)
+	{
+		displayModeNameString = DlToStdString(displayModeName);
+		DeleteString(displayModeName);
+	}
+
+	return displayModeNameString;
+}
+
+bool findDisplayMode(com_ptr<DeckLinkOutputDevice>& deckLinkOutput, const char* name, BMDDisplayMode& displayMode)
+{
+	com_ptr<IDeckLinkDisplayModeIterator>	displayModeIterator;
+	com_ptr<IDeckLinkDisplayMode>			deckLinkDisplayMode;
+
+	if (deckLinkOutput->getDeckLinkOutput()->GetDisplayModeIterator(displayModeIterator.releaseAndGetAddressOf()) != S_OK)
+		return false;
+
+	while (displayModeIterator->Next(deckLinkDisplayMode.releaseAndGetAddressOf()) == S_OK)
+	{
+		if (strcasecmp(getDisplayModeName(deckLinkDisplayMode).c_str(), name) == 0)
+		{
+			displayMode = deckLinkDisplayMode->GetDisplayMode();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Returns true if the input will be scaled to the output display mode
+bool startScaler(com_ptr<DeckLinkOutputDevice>& deckLinkOutput, const FormatDescription& formatDesc, BMDDisplayMode outputDisplayMode, DispatchQueue& printDispatchQueue)
+{
+	com_ptr<IDeckLinkDisplayMode>	inputDeckLinkDisplayMode;
+	com_ptr<IDeckLinkDisplayMode>	outputDeckLinkDisplayMode;
+	BMDTimeValue					inputFrameDuration;
+	BMDTimeScale					inputTimeScale;
+	BMDTimeValue					outputFrameDuration;
+	BMDTimeScale					outputTimeScale;
+
+	g_scaler->stop();
+
+	if (formatDesc.displayMode == outputDisplayMode)
+		return false;
+
+	if ((deckLinkOutput->getDeckLinkOutput()->GetDisplayMode(formatDesc.displayMode, inputDeckLinkDisplayMode.releaseAndGetAddressOf()) != S_OK) ||
+		(deckLinkOutput->getDeckLinkOutput()->GetDisplayMode(outputDisplayMode, outputDeckLinkDisplayMode.releaseAndGetAddressOf()) != S_OK) ||
+		(inputDeckLinkDisplayMode->GetFrameRate(&inputFrameDuration, &inputTimeScale) != S_OK) ||
+		(outputDeckLinkDisplayMode->GetFrameRate(&outputFrameDuration, &outputTimeScale) != S_OK))
+		return false;
+
+	std::string inputName = getDisplayModeName(inputDeckLinkDisplayMode);
+	std::string outputName = getDisplayModeName(outputDeckLinkDisplayMode);
+
+	// Frames are scaled one for one, so the output can only keep up at the same frame rate
+	if (inputFrameDuration * outputTimeScale != outputFrameDuration * inputTimeScale)
+	{
+		dispatch_printf(printDispatchQueue, "%s has a different frame rate to %s, the input is looped through unscaled\n", inputName.c_str(), outputName.c_str());
+		return false;
+	}
+
+	ScalerGeometry input = { inputDeckLinkDisplayMode->GetWidth(), inputDeckLinkDisplayMode->GetHeight(), inputDeckLinkDisplayMode->GetFieldDominance() };
+	ScalerGeometry output = { outputDeckLinkDisplayMode->GetWidth(), outputDeckLinkDisplayMode->GetHeight(), outputDeckLinkDisplayMode->GetFieldDominance() };
+
+	if (!g_scaler->start(input, output, formatDesc.pixelFormat))
+	{
+		dispatch_printf(printDispatchQueue, "Only 8-bit and 10-bit YUV are scaled, the input is looped through unscaled\n");
+		return false;
+	}
+
+	dispatch_printf(printDispatchQueue, "Scaling %s to %s with the %s filter and %s kernels\n", inputName.c_str(), outputName.c_str(), Scaler::getFilterName(g_scaler->getFilter()), g_scaler->getKernelName());
+	return true;
+}
+
+HRESULT InputLoopThrough(const TimeShiftOptions& timeShiftOptions, bool measureSync, const CompositingOptions& compositingOptions, const ScalingOptions& scalingOptions)
 {
 	HRESULT								result = S_OK;
 
@@ -484,6 +1119,37 @@ HRESULT InputLoopThrough(void)
 	DispatchQueue						printDispatchQueue(kPrintDispatcherThreadCount);
 	
 	std::thread							printRollingAverageThread;
+	std::thread							graphicsPollThread;
+
+	bool								timeShift = (timeShiftOptions.path != nullptr);
+	double								timeShiftDelay = timeShiftOptions.delaySeconds;
+	bool								overrideTimeShiftDelay = timeShiftOptions.delaySpecified;
+	BMDDisplayMode						scalingDisplayMode = bmdModeUnknown;
+	std::shared_ptr<BandWorkerPool>		bandWorkerPool;
+
+	if (timeShift)
+		g_timeShiftBuffer.reset(new TimeShiftBuffer(timeShiftOptions.path, timeShiftOptions.capacitySeconds, kTimeShiftReadBuffers));
+
+	if (measureSync)
+		g_syncMeasurement.reset(new SyncMeasurement(kRollingAverageSampleCount));
+
+	if (!compositingOptions.graphicsPaths.empty())
+	{
+		if (!bandWorkerPool)
+			bandWorkerPool = std::make_shared<BandWorkerPool>(kBandWorkerThreadCount);
+
+		g_compositor.reset(new Compositor(bandWorkerPool));
+
+		for (const char* path : compositingOptions.graphicsPaths)
+		{
+			GraphicsLayerFile	layerFile = {};
+			size_t				length = strlen(path);
+
+			layerFile.path = path;
+			layerFile.pixelFormat = ((length > 5) && (strcasecmp(path + length - 5, ".ay10") == 0)) ? bmdFormat10BitYUVA : bmdFormat8BitBGRA;
+			g_graphicsLayerFiles.push_back(layerFile);
+		}
+	}
 
 	result = GetDeckLinkIterator(deckLinkIterator.releaseAndGetAddressOf());
 	if (result != S_OK)
@@ -560,7 +1226,7 @@ HRESULT InputLoopThrough(void)
 					dispatch_printf(printDispatchQueue, "Warning: Specified video output preroll size is smaller than the minimum supported size; Changing preroll size from %d to %d.\n", kOutputVideoPreroll, minimumPrerollFrames);
 				}
 				
-				int prerollFrames = std::max((int)minimumPrerollFrames, kOutputVideoPreroll);
+				int prerollFrames = std::max((int)minimumPrerollFrames, timeShift ? kTimeShiftOutputPreroll : kOutputVideoPreroll);
 
 				try
 				{
@@ -589,12 +1255,45 @@ HRESULT InputLoopThrough(void)
 		return E_FAIL;
 	}
 
+	if (scalingOptions.outputDisplayModeName != nullptr)
+	{
+		if (!findDisplayMode(deckLinkOutput, scalingOptions.outputDisplayModeName, scalingDisplayMode))
+		{
+			fprintf(stderr, "Output display mode %s is not supported by the output device\n", scalingOptions.outputDisplayModeName);
+			return E_INVALIDARG;
+		}
+
+		if (!bandWorkerPool)
+			bandWorkerPool = std::make_shared<BandWorkerPool>(kBandWorkerThreadCount);
+
+		g_scaler.reset(new Scaler(bandWorkerPool, scalingOptions.filter));
+	}
+
 	std::mutex formatDescMutex;
 	FormatDescription formatDesc = { kInitialDisplayMode, false, kInitialPixelFormat };
 
-	// Monitor for keypress when user wants to exit
+	// Monitor for keypress when user wants to exit.  In time-shift mode a number entered
+	// changes the delay.
 	std::thread userInputThread = std::thread([&] {
-		getchar();
+		char line[64];
+
+		while (fgets(line, sizeof(line), stdin))
+		{
+			char*	end;
+			double	delaySeconds = strtod(line, &end);
+
+			if (!timeShift || (end == line))
+				break;
+
+			std::lock_guard<std::mutex> lock(formatDescMutex);
+			timeShiftDelay = delaySeconds;
+			overrideTimeShiftDelay = true;
+			if (g_timeShiftBuffer->getDelayFrames() > 0)
+			{
+				g_timeShiftBuffer->setDelay(delaySeconds);
+				dispatch_printf(printDispatchQueue, "Time-shift delay changed to %.2f s\n", g_timeShiftBuffer->getDelaySeconds());
+			}
+		}
 		deckLinkOutput->cancelWaitForReference();
 		g_loopThroughSessionNotifier.notify();
 	});
@@ -620,8 +1319,75 @@ HRESULT InputLoopThrough(void)
 			g_loopThroughSessionNotifier.condition.notify_all();
 		});
 
-		deckLinkInput->onVideoInputArrived([&](std::shared_ptr<LoopThroughVideoFrame> videoFrame) { videoDispatchQueue.dispatch(processVideo, videoFrame, deckLinkOutput); });
-		deckLinkInput->onAudioInputArrived([&](std::shared_ptr<LoopThroughAudioPacket> audioPacket) { audioDispatchQueue.dispatch(processAudio, audioPacket, deckLinkOutput); });
+		if (timeShift)
+		{
+			std::lock_guard<std::mutex> lock(formatDescMutex);
+
+			// The input is written to disk as it arrives, and the buffer passes back the
+			// frames from a delay ago to be scheduled in their place
+			if (!openTimeShiftBuffer(deckLinkOutput, currentFormatDesc, timeShiftDelay, overrideTimeShiftDelay, printDispatchQueue))
+			{
+				fprintf(stderr, "Unable to open time-shift buffer %s\n", timeShiftOptions.path);
+				return E_FAIL;
+			}
+
+			g_timeShiftBuffer->onFrameReady([&](std::shared_ptr<LoopThroughVideoFrame> videoFrame, std::shared_ptr<LoopThroughAudioPacket> audioPacket)
+			{
+				if (!deckLinkOutput->isPlaybackActive())
+					return;
+
+				deckLinkOutput->scheduleVideoFrame(std::move(videoFrame));
+				if (audioPacket)
+					deckLinkOutput->scheduleAudioPacket(std::move(audioPacket));
+			});
+
+			deckLinkInput->onVideoInputArrived([&](std::shared_ptr<LoopThroughVideoFrame> videoFrame) { g_timeShiftBuffer->writeVideoFrame(std::move(videoFrame)); });
+			deckLinkInput->onAudioInputArrived([&](std::shared_ptr<LoopThroughAudioPacket> audioPacket) { g_timeShiftBuffer->writeAudioPacket(std::move(audioPacket)); });
+		}
+		else if (measureSync)
+		{
+			std::lock_guard<std::mutex> lock(formatDescMutex);
+
+			if (!startSyncMeasurement(deckLinkOutput, currentFormatDesc))
+			{
+				fprintf(stderr, "Unable to start sync measurement\n");
+				return E_FAIL;
+			}
+
+			// The input is measured in arrival order, before processing replaces it with test frames
+			deckLinkInput->onVideoInputArrived([&](std::shared_ptr<LoopThroughVideoFrame> videoFrame)
+			{
+				g_syncMeasurement->analyzeVideoFrame(videoFrame);
+				videoDispatchQueue.dispatch(processVideo, videoFrame, deckLinkOutput);
+			});
+			deckLinkInput->onAudioInputArrived([&](std::shared_ptr<LoopThroughAudioPacket> audioPacket)
+			{
+				g_syncMeasurement->analyzeAudioPacket(audioPacket);
+				audioDispatchQueue.dispatch(processAudio, audioPacket, deckLinkOutput);
+			});
+		}
+		else
+		{
+			deckLinkInput->onVideoInputArrived([&](std::shared_ptr<LoopThroughVideoFrame> videoFrame) { videoDispatchQueue.dispatch(processVideo, videoFrame, deckLinkOutput); });
+			deckLinkInput->onAudioInputArrived([&](std::shared_ptr<LoopThroughAudioPacket> audioPacket) { audioDispatchQueue.dispatch(processAudio, audioPacket, deckLinkOutput); });
+		}
+		bool	compositing = false;
+		long	compositingWidth = 0;
+		long	compositingHeight = 0;
+
+		if (g_compositor)
+			compositing = startCompositor(deckLinkOutput, currentFormatDesc, compositingOptions.premultiplied, compositingWidth, compositingHeight, printDispatchQueue);
+
+		bool			scaling = false;
+		BMDDisplayMode	outputDisplayMode = currentFormatDesc.displayMode;
+
+		if (g_scaler)
+		{
+			scaling = startScaler(deckLinkOutput, currentFormatDesc, scalingDisplayMode, printDispatchQueue);
+			if (scaling)
+				outputDisplayMode = scalingDisplayMode;
+		}
+
 		deckLinkInput->onVideoInputFrameDropped([&](BMDTimeValue streamTime, BMDTimeValue frameDuration, BMDTimeScale) { printDroppedCaptureFrame(streamTime, frameDuration, std::ref(printDispatchQueue)); });
 
 		// Register output callbacks
@@ -637,7 +1403,8 @@ HRESULT InputLoopThrough(void)
 		if (kWaitForReferenceToLock)
 			dispatch_printf(printDispatchQueue, "Waiting for reference to lock...\n");
 
-		if (!deckLinkOutput->startPlayback(currentFormatDesc.displayMode, currentFormatDesc.is3D, currentFormatDesc.pixelFormat, kAudioSampleType, g_audioChannelCount, kWaitForReferenceToLock))
+		// Only the left eye is stored in time-shift mode or scaled, and test frames are 2D
+		if (!deckLinkOutput->startPlayback(outputDisplayMode, currentFormatDesc.is3D && !timeShift && !measureSync && !scaling, currentFormatDesc.pixelFormat, kAudioSampleType, g_audioChannelCount, kWaitForReferenceToLock))
 		{
 			std::lock_guard<std::mutex> lock(formatDescMutex);
 			if (!g_loopThroughSessionNotifier.isNotified() && formatDesc == currentFormatDesc)
@@ -651,7 +1418,12 @@ HRESULT InputLoopThrough(void)
 
 		printReferenceStatus(deckLinkOutput, printDispatchQueue);
 
-		dispatch_printf(printDispatchQueue, "Starting input loop-through, press <RETURN> to stop/exit\n");
+		if (timeShift)
+			dispatch_printf(printDispatchQueue, "Starting time-shift, enter a new delay in seconds to change it, or press <RETURN> to stop/exit\n");
+		else if (measureSync)
+			dispatch_printf(printDispatchQueue, "Starting sync measurement, connect the output back to the input through the equipment to measure, press <RETURN> to stop/exit\n");
+		else
+			dispatch_printf(printDispatchQueue, "Starting input loop-through, press <RETURN> to stop/exit\n");
 
 		if (kPrintRollingAverage)
 		{
@@ -659,6 +1431,12 @@ HRESULT InputLoopThrough(void)
 			printRollingAverageThread = std::thread(printRollingAverage, std::ref(printDispatchQueue));
 		}
 
+		if (compositing)
+		{
+			g_graphicsPollNotifier.reset();
+			graphicsPollThread = std::thread(pollGraphicsLayers, compositingWidth, compositingHeight, compositingOptions.premultiplied, std::ref(printDispatchQueue));
+		}
+
 		{
 			std::unique_lock<std::mutex> lock(g_loopThroughSessionNotifier.mutex);
 
@@ -675,17 +1453,36 @@ HRESULT InputLoopThrough(void)
 			if (printRollingAverageThread.joinable())
 				printRollingAverageThread.join();
 		}
+
+		if (graphicsPollThread.joinable())
+		{
+			g_graphicsPollNotifier.notify();
+			graphicsPollThread.join();
+		}
 	
 		deckLinkInput->stopCapture();
+
+		// Finish writing the frames already captured before the output stops
+		if (timeShift)
+			g_timeShiftBuffer->close();
+
 		deckLinkOutput->stopPlayback();
 
-		printOutputSummary(printDispatchQueue);
+		printOutputSummary(deckLinkOutput, printDispatchQueue);
 
 		// Reset statistics
 		g_videoInputLatencyStatistics.reset();
 		g_videoProcessingLatencyStatistics.reset();
 		g_videoOutputLatencyStatistics.reset();
 		g_audioProcessingLatencyStatistics.reset();
+		g_compositingTimeStatistics.reset();
+		g_scalingTimeStatistics.reset();
+
+		if (g_syncMeasurement)
+			g_syncMeasurement->reset();
+
+		if (g_scaler)
+			g_scaler->resetStatistics();
 
 		g_frameCompletionResultCount.clear();
 		g_outputFrameCount = 0;
@@ -726,17 +1523,102 @@ HRESULT InputLoopThrough(void)
 
 	dispatch_printf(printDispatchQueue, "\nInputLoopThrough complete\n\n");
 
+	g_timeShiftBuffer.reset();
+	g_syncMeasurement.reset();
+	g_compositor.reset();
+	g_scaler.reset();
+
 	return result;
 }
 
-int main(int argc, const char * argv[])
+void printUsage(void)
 {
-	HRESULT		result;
-	int			exitStatus = EXIT_FAILURE;
+	fprintf(stderr,
+		"Usage: InputLoopThrough [-f <file> [-s <seconds>] [-d <seconds>] | -m | [-k <file> [-k <file>...] [-p]] [-o <mode> [-F <filter>]]]\n"
+		"    -f <file>      Time-shift the output through a buffer file, created or resumed\n"
+		"    -s <seconds>   Length of the buffer file (default %.0f)\n"
+		"    -d <seconds>   Delay (default %.0f for a new buffer, or the delay saved in it)\n"
+		"    -m             Output stamped test frames and measure the glass-to-glass latency\n"
+		"                   and A/V offset of the equipment between the output and the input\n"
+		"    -k <file>      Composite a graphics layer over the input, up to %u layers from the\n"
+		"                   bottom up.  A layer is a raw BGRA image the size of the input, or\n"
+		"                   10-bit YUVA if the file name ends .ay10\n"
+		"    -p             BGRA graphics have premultiplied alpha\n"
+		"    -o <mode>      Output in another display mode with the same frame rate, such as\n"
+		"                   1080p25 for a 2160p25 input, scaling the input to it\n"
+		"    -F <filter>    Scaling filter, bilinear, bicubic or lanczos (default lanczos)\n",
+		kDefaultTimeShiftCapacity, kDefaultTimeShiftDelay, Compositor::kMaxLayers);
+}
 
-	result = InputLoopThrough();
+int main(int argc, char * argv[])
+{
+	HRESULT				result;
+	int					exitStatus = EXIT_FAILURE;
+	TimeShiftOptions	timeShiftOptions = { nullptr, kDefaultTimeShiftCapacity, kDefaultTimeShiftDelay, false };
+	bool				measureSync = false;
+	CompositingOptions	compositingOptions = { {}, false };
+	ScalingOptions		scalingOptions = { nullptr, ScalerFilter::Lanczos };
+	int					ch;
+
+	while ((ch = getopt(argc, argv, "f:s:d:mk:po:F:h")) != -1)
+	{
+		switch (ch)
+		{
+			case 'f':
+				timeShiftOptions.path = optarg;
+				break;
+			case 's':
+				timeShiftOptions.capacitySeconds = atof(optarg);
+				break;
+			case 'd':
+				timeShiftOptions.delaySeconds = atof(optarg);
+				timeShiftOptions.delaySpecified = true;
+				break;
+			case 'm':
+				measureSync = true;
+				break;
+			case 'k':
+				compositingOptions.graphicsPaths.push_back(optarg);
+				break;
+			case 'p':
+				compositingOptions.premultiplied = true;
+				break;
+			case 'o':
+				scalingOptions.outputDisplayModeName = optarg;
+				break;
+			case 'F':
+				if (!Scaler::getFilterFromName(optarg, scalingOptions.filter))
+				{
+					printUsage();
+					return EXIT_FAILURE;
+				}
+				break;
+			default:
+				printUsage();
+				return EXIT_FAILURE;
+		}
+	}
+
+	// The measurement replaces the output, so it cannot be time-shifted.  Graphics are
+	// composited and frames scaled in the processing stage, which neither mode uses for the
+	// input.
+	if ((measureSync && (timeShiftOptions.path != nullptr)) ||
+		(!compositingOptions.graphicsPaths.empty() && (measureSync || (timeShiftOptions.path != nullptr))) ||
+		((scalingOptions.outputDisplayModeName != nullptr) && (measureSync || (timeShiftOptions.path != nullptr))) ||
+		(compositingOptions.graphicsPaths.size() > Compositor::kMaxLayers))
+	{
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	// Set FRAME_TRACE_FILE to record a per-frame trace of the loop-through
+	FrameTrace::startFromEnvironment();
+
+	result = InputLoopThrough(timeShiftOptions, measureSync, compositingOptions, scalingOptions);
 	if (result == S_OK)
 		exitStatus = EXIT_SUCCESS;;
 
+	FrameTrace::stop();
+
 	return exitStatus;
 }
@@ -0,0 +1,99 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <stdexcept>
+#include "LatencyHistogram.h"
+
+LatencyHistogram::LatencyHistogram(BMDTimeValue binWidth, BMDTimeValue minimum, BMDTimeValue maximum) :
+	m_binWidth(binWidth),
+	m_minimum(minimum)
+{
+	if ((binWidth <= 0) || (maximum <= minimum))
+		throw std::invalid_argument("Unexpected histogram range");
+
+	m_bins.resize((size_t)((maximum - minimum + binWidth - 1) / binWidth));
+
+	reset();
+}
+
+void LatencyHistogram::reset()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::fill(m_bins.begin(), m_bins.end(), 0);
+	m_underflowCount	= 0;
+	m_overflowCount		= 0;
+	m_sampleCount		= 0;
+}
+
+void LatencyHistogram::addSample(const BMDTimeValue sample)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	++m_sampleCount;
+
+	if (sample < m_minimum)
+	{
+		++m_underflowCount;
+		return;
+	}
+
+	size_t bin = (size_t)((sample - m_minimum) / m_binWidth);
+	if (bin >= m_bins.size())
+		++m_overflowCount;
+	else
+		++m_bins[bin];
+}
+
+void LatencyHistogram::getCounts(std::vector<uint64_t>& bins, uint64_t& underflowCount, uint64_t& overflowCount)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	bins			= m_bins;
+	underflowCount	= m_underflowCount;
+	overflowCount	= m_overflowCount;
+}
+
+uint64_t LatencyHistogram::getSampleCount()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_sampleCount;
+}
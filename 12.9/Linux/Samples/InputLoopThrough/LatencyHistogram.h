@@ -0,0 +1,73 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include "DeckLinkAPI.h"
+
+// Counts samples in fixed width bins between a minimum and maximum.  Samples outside the
+// range are counted as underflow or overflow rather than widening the range.
+class LatencyHistogram
+{
+public:
+	LatencyHistogram(BMDTimeValue binWidth, BMDTimeValue minimum, BMDTimeValue maximum);
+	virtual ~LatencyHistogram() {}
+
+	void						reset(void);
+	void						addSample(const BMDTimeValue sample);
+
+	BMDTimeValue				getBinWidth(void) const { return m_binWidth; }
+	BMDTimeValue				getMinimum(void) const { return m_minimum; }
+
+	void						getCounts(std::vector<uint64_t>& bins, uint64_t& underflowCount, uint64_t& overflowCount);
+	uint64_t					getSampleCount(void);
+
+private:
+	std::mutex					m_mutex;
+
+	BMDTimeValue				m_binWidth;
+	BMDTimeValue				m_minimum;
+	std::vector<uint64_t>		m_bins;
+	uint64_t					m_underflowCount;
+	uint64_t					m_overflowCount;
+	uint64_t					m_sampleCount;
+};
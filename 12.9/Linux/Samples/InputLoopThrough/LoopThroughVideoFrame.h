@@ -71,6 +71,8 @@ public:
 	IDeckLinkVideoFrame*			getVideoFramePtr(void) const { return m_videoFrame.get(); }
 	BMDTimeValue					getVideoStreamTime(void) const { return m_videoStreamTime; }
 	BMDTimeValue					getVideoFrameDuration(void) const { return m_videoFrameDuration; }
+	BMDTimeValue					getInputFrameStartReferenceTime(void) const { return m_inputFrameStartReferenceTime; }
+	BMDTimeValue					getOutputFrameCompletedReferenceTime(void) const { return m_outputFrameCompletedReferenceTime; }
 	BMDTimeValue					getInputLatency(void) const { return m_inputFrameArrivedReferenceTime - m_inputFrameStartReferenceTime; }
 	BMDTimeValue					getProcessingLatency(void) const { return m_outputFrameScheduledReferenceTime - m_inputFrameArrivedReferenceTime; }
 	BMDTimeValue					getOutputLatency(void) const { return m_outputFrameCompletedReferenceTime - m_outputFrameScheduledReferenceTime; }
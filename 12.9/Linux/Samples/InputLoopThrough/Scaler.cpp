@@ -0,0 +1,1004 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "Scaler.h"
+#include "platform.h"
+
+// Coefficients are fixed point with 14 fractional bits.  Samples filtered across a row keep
+// 2 more fractional bits than the 10-bit input until they are filtered down the columns.
+static const int		kCoefficientBits	= 14;
+static const int		kCoefficientOne		= 1 << kCoefficientBits;
+static const int		kIntermediateBits	= 2;
+static const int		kHorizontalShift	= kCoefficientBits - kIntermediateBits;
+static const int		kVerticalShift		= kCoefficientBits + kIntermediateBits;
+
+// 10-bit video levels, the SDI reserved codes are kept out of the frame.  8-bit samples are
+// scaled as 10-bit and limited to the levels that round to 1..254.
+static const int16_t	kMinimumLevel		= 4;
+static const int16_t	kMaximumLevel		= 1019;
+static const int16_t	kMaximum8BitLevel	= 1016;
+
+// Row buffers hold whole v210 groups, and both their luma and chroma halves whole SIMD blocks
+static const long		kWidthAlignment		= 96;
+
+static const unsigned	kBandsPerThread		= 4;
+static const long		kMinimumBandRows	= 8;
+
+static const BMDTimecodeFormat	kTimecodeFormats[] = { bmdTimecodeRP188VITC1, bmdTimecodeRP188VITC2, bmdTimecodeRP188LTC, bmdTimecodeRP188HighFrameRate };
+
+namespace
+{
+	using HorizontalKernel	= void (*)(const int16_t* source, const int32_t* starts, const int16_t* coefficients, long taps, int16_t* dest, long width);
+	using VerticalKernel	= void (*)(const int16_t* const* sources, const int16_t* coefficients, long taps, int16_t* dest, long width, int16_t minimum, int16_t maximum);
+
+	struct ScalerKernels
+	{
+		const char*			name;
+		HorizontalKernel	horizontal;		// width a multiple of 8, taps a multiple of 4
+		VerticalKernel		vertical;		// width a multiple of 16
+	};
+
+	inline long roundUp(long value, long multiple)
+	{
+		return ((value + multiple - 1) / multiple) * multiple;
+	}
+
+	long getRowBytes(BMDPixelFormat pixelFormat, long width)
+	{
+		return (pixelFormat == bmdFormat10BitYUV) ? ((width + 47) / 48) * 128 : width * 2;
+	}
+
+	bool isInterlaced(BMDFieldDominance fieldDominance)
+	{
+		return (fieldDominance == bmdLowerFieldFirst) || (fieldDominance == bmdUpperFieldFirst);
+	}
+
+	double getFilterSupport(ScalerFilter filter)
+	{
+		switch (filter)
+		{
+			case ScalerFilter::Bilinear:
+				return 1.0;
+			case ScalerFilter::Bicubic:
+				return 2.0;
+			default:
+				return 3.0;
+		}
+	}
+
+	double getFilterWeight(ScalerFilter filter, double x)
+	{
+		x = std::fabs(x);
+
+		switch (filter)
+		{
+			case ScalerFilter::Bilinear:
+				return std::max(0.0, 1.0 - x);
+
+			case ScalerFilter::Bicubic:
+			{
+				// Keys cubic with a = -0.5, the Catmull-Rom spline
+				const double a = -0.5;
+				if (x < 1.0)
+					return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+				if (x < 2.0)
+					return ((a * x - 5.0 * a) * x + 8.0 * a) * x - 4.0 * a;
+				return 0.0;
+			}
+
+			default:
+			{
+				if (x < 1e-9)
+					return 1.0;
+				if (x >= 3.0)
+					return 0.0;
+				double px = M_PI * x;
+				return 3.0 * std::sin(px) * std::sin(px / 3.0) / (px * px);
+			}
+		}
+	}
+
+	// Number of input samples the filter touches around an output sample
+	long getFilterTaps(ScalerFilter filter, double filterScale)
+	{
+		return (long)std::ceil(2.0 * getFilterSupport(filter) * filterScale - 1e-9);
+	}
+
+	// Computes the weights of the samples around center, folded onto a window of taps samples
+	// inside 0..size-1 and normalised so that they add up to exactly one.  Returns the first
+	// sample of the window.
+	long computeWeights(ScalerFilter filter, double center, double filterScale, long size, long taps, int16_t* coefficients)
+	{
+		const double		support = getFilterSupport(filter) * filterScale;
+		const long			first = (long)std::floor(center - support) + 1;
+		const long			last = (long)std::floor(center + support);
+		const long			start = std::max(0L, std::min(first, size - taps));
+		std::vector<double>	weights(taps, 0.0);
+		double				total = 0.0;
+
+		for (long i = first; i <= last; i++)
+		{
+			double weight = getFilterWeight(filter, (i - center) / filterScale);
+			weights[std::max(0L, std::min(i, size - 1)) - start] += weight;
+			total += weight;
+		}
+
+		// The rounding error goes to the largest coefficient, where it matters least
+		int		sum = 0;
+		long	largest = 0;
+
+		for (long i = 0; i < taps; i++)
+		{
+			coefficients[i] = (int16_t)std::lround(weights[i] / total * kCoefficientOne);
+			sum += coefficients[i];
+			if (std::abs(coefficients[i]) > std::abs(coefficients[largest]))
+				largest = i;
+		}
+		coefficients[largest] += (int16_t)(kCoefficientOne - sum);
+
+		return start;
+	}
+
+#if defined(__SSE2__)
+	inline __m128i sumAcross(__m128i a, __m128i b, __m128i c, __m128i d)
+	{
+		// [a0+a2, b0+b2, a1+a3, b1+b3] and the same for c and d, then the halves are added
+		__m128i ab = _mm_add_epi32(_mm_unpacklo_epi32(a, b), _mm_unpackhi_epi32(a, b));
+		__m128i cd = _mm_add_epi32(_mm_unpacklo_epi32(c, d), _mm_unpackhi_epi32(c, d));
+		return _mm_add_epi32(_mm_unpacklo_epi64(ab, cd), _mm_unpackhi_epi64(ab, cd));
+	}
+
+	inline __m128i filterAcross(const int16_t* source, const int16_t* coefficients, long taps)
+	{
+		__m128i	sum = _mm_setzero_si128();
+		long	k = 0;
+
+		for (; k + 8 <= taps; k += 8)
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(source + k)), _mm_loadu_si128((const __m128i*)(coefficients + k))));
+
+		if (k < taps)
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_loadl_epi64((const __m128i*)(source + k)), _mm_loadl_epi64((const __m128i*)(coefficients + k))));
+
+		return sum;
+	}
+
+	void horizontalSSE2(const int16_t* source, const int32_t* starts, const int16_t* coefficients, long taps, int16_t* dest, long width)
+	{
+		const __m128i round = _mm_set1_epi32(1 << (kHorizontalShift - 1));
+		__m128i sums[8];
+
+		for (long x = 0; x < width; x += 8)
+		{
+			for (int i = 0; i < 8; i++)
+				sums[i] = filterAcross(source + starts[x + i], coefficients + (x + i) * taps, taps);
+
+			__m128i low = _mm_srai_epi32(_mm_add_epi32(sumAcross(sums[0], sums[1], sums[2], sums[3]), round), kHorizontalShift);
+			__m128i high = _mm_srai_epi32(_mm_add_epi32(sumAcross(sums[4], sums[5], sums[6], sums[7]), round), kHorizontalShift);
+			_mm_storeu_si128((__m128i*)(dest + x), _mm_packs_epi32(low, high));
+		}
+	}
+
+	void verticalSSE2(const int16_t* const* sources, const int16_t* coefficients, long taps, int16_t* dest, long width, int16_t minimum, int16_t maximum)
+	{
+		const __m128i round = _mm_set1_epi32(1 << (kVerticalShift - 1));
+		const __m128i minimumLevel = _mm_set1_epi16(minimum);
+		const __m128i maximumLevel = _mm_set1_epi16(maximum);
+
+		for (long x = 0; x < width; x += 8)
+		{
+			__m128i low = round;
+			__m128i high = round;
+
+			// Rows are taken in pairs, so that each multiply-add sums two taps
+			for (long k = 0; k < taps; k += 2)
+			{
+				__m128i a = _mm_loadu_si128((const __m128i*)(sources[k] + x));
+				__m128i b = _mm_loadu_si128((const __m128i*)(sources[k + 1] + x));
+				__m128i c = _mm_set1_epi32((uint16_t)coefficients[k] | ((uint32_t)(uint16_t)coefficients[k + 1] << 16));
+
+				low = _mm_add_epi32(low, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), c));
+				high = _mm_add_epi32(high, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), c));
+			}
+
+			__m128i result = _mm_packs_epi32(_mm_srai_epi32(low, kVerticalShift), _mm_srai_epi32(high, kVerticalShift));
+			result = _mm_min_epi16(_mm_max_epi16(result, minimumLevel), maximumLevel);
+			_mm_storeu_si128((__m128i*)(dest + x), result);
+		}
+	}
+#elif defined(__ARM_NEON)
+	inline int32x4_t filterAcross(const int16_t* source, const int16_t* coefficients, long taps)
+	{
+		int32x4_t	sum = vdupq_n_s32(0);
+		long		k = 0;
+
+		for (; k + 8 <= taps; k += 8)
+		{
+			int16x8_t s = vld1q_s16(source + k);
+			int16x8_t c = vld1q_s16(coefficients + k);
+			sum = vmlal_s16(sum, vget_low_s16(s), vget_low_s16(c));
+			sum = vmlal_s16(sum, vget_high_s16(s), vget_high_s16(c));
+		}
+
+		if (k < taps)
+			sum = vmlal_s16(sum, vld1_s16(source + k), vld1_s16(coefficients + k));
+
+		return sum;
+	}
+
+	inline int32x4_t sumAcross(int32x4_t a, int32x4_t b, int32x4_t c, int32x4_t d)
+	{
+		int32x2_t ab = vpadd_s32(vpadd_s32(vget_low_s32(a), vget_high_s32(a)), vpadd_s32(vget_low_s32(b), vget_high_s32(b)));
+		int32x2_t cd = vpadd_s32(vpadd_s32(vget_low_s32(c), vget_high_s32(c)), vpadd_s32(vget_low_s32(d), vget_high_s32(d)));
+		return vcombine_s32(ab, cd);
+	}
+
+	void horizontalNEON(const int16_t* source, const int32_t* starts, const int16_t* coefficients, long taps, int16_t* dest, long width)
+	{
+		int32x4_t sums[8];
+
+		for (long x = 0; x < width; x += 8)
+		{
+			for (int i = 0; i < 8; i++)
+				sums[i] = filterAcross(source + starts[x + i], coefficients + (x + i) * taps, taps);
+
+			int16x4_t low = vqrshrn_n_s32(sumAcross(sums[0], sums[1], sums[2], sums[3]), kHorizontalShift);
+			int16x4_t high = vqrshrn_n_s32(sumAcross(sums[4], sums[5], sums[6], sums[7]), kHorizontalShift);
+			vst1q_s16(dest + x, vcombine_s16(low, high));
+		}
+	}
+
+	void verticalNEON(const int16_t* const* sources, const int16_t* coefficients, long taps, int16_t* dest, long width, int16_t minimum, int16_t maximum)
+	{
+		const int16x8_t minimumLevel = vdupq_n_s16(minimum);
+		const int16x8_t maximumLevel = vdupq_n_s16(maximum);
+
+		for (long x = 0; x < width; x += 8)
+		{
+			int32x4_t low = vdupq_n_s32(0);
+			int32x4_t high = vdupq_n_s32(0);
+
+			for (long k = 0; k < taps; k++)
+			{
+				int16x8_t row = vld1q_s16(sources[k] + x);
+				low = vmlal_n_s16(low, vget_low_s16(row), coefficients[k]);
+				high = vmlal_n_s16(high, vget_high_s16(row), coefficients[k]);
+			}
+
+			int16x8_t result = vcombine_s16(vqrshrn_n_s32(low, kVerticalShift), vqrshrn_n_s32(high, kVerticalShift));
+			vst1q_s16(dest + x, vminq_s16(vmaxq_s16(result, minimumLevel), maximumLevel));
+		}
+	}
+#else
+	inline int16_t saturate(int32_t value)
+	{
+		return (int16_t)std::max(-32768, std::min(32767, value));
+	}
+
+	void horizontalC(const int16_t* source, const int32_t* starts, const int16_t* coefficients, long taps, int16_t* dest, long width)
+	{
+		for (long x = 0; x < width; x++, coefficients += taps)
+		{
+			const int16_t*	s = source + starts[x];
+			int32_t			sum = 1 << (kHorizontalShift - 1);
+
+			for (long k = 0; k < taps; k++)
+				sum += s[k] * coefficients[k];
+
+			dest[x] = saturate(sum >> kHorizontalShift);
+		}
+	}
+
+	void verticalC(const int16_t* const* sources, const int16_t* coefficients, long taps, int16_t* dest, long width, int16_t minimum, int16_t maximum)
+	{
+		for (long x = 0; x < width; x++)
+		{
+			int32_t sum = 1 << (kVerticalShift - 1);
+
+			for (long k = 0; k < taps; k++)
+				sum += sources[k][x] * coefficients[k];
+
+			dest[x] = std::max(minimum, std::min(maximum, saturate(sum >> kVerticalShift)));
+		}
+	}
+#endif
+
+#if defined(__x86_64__)
+	// Two output samples to each 256-bit multiply-add, one in each 128-bit lane
+	__attribute__((target("avx2")))
+	inline __m256i filterAcrossAVX2(const int16_t* source0, const int16_t* source1, const int16_t* coefficients0, const int16_t* coefficients1, long taps)
+	{
+		__m256i	sum = _mm256_setzero_si256();
+		long	k = 0;
+
+		for (; k + 8 <= taps; k += 8)
+		{
+			__m256i s = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(source0 + k))), _mm_loadu_si128((const __m128i*)(source1 + k)), 1);
+			__m256i c = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(coefficients0 + k))), _mm_loadu_si128((const __m128i*)(coefficients1 + k)), 1);
+			sum = _mm256_add_epi32(sum, _mm256_madd_epi16(s, c));
+		}
+
+		if (k < taps)
+		{
+			__m256i s = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadl_epi64((const __m128i*)(source0 + k))), _mm_loadl_epi64((const __m128i*)(source1 + k)), 1);
+			__m256i c = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadl_epi64((const __m128i*)(coefficients0 + k))), _mm_loadl_epi64((const __m128i*)(coefficients1 + k)), 1);
+			sum = _mm256_add_epi32(sum, _mm256_madd_epi16(s, c));
+		}
+
+		return sum;
+	}
+
+	__attribute__((target("avx2")))
+	void horizontalAVX2(const int16_t* source, const int32_t* starts, const int16_t* coefficients, long taps, int16_t* dest, long width)
+	{
+		const __m256i round = _mm256_set1_epi32(1 << (kHorizontalShift - 1));
+		const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+		__m256i sums[4];
+
+		for (long x = 0; x < width; x += 8)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				long x0 = x + 2 * i;
+				sums[i] = filterAcrossAVX2(source + starts[x0], source + starts[x0 + 1], coefficients + x0 * taps, coefficients + (x0 + 1) * taps, taps);
+			}
+
+			// The low lanes sum to samples 0, 2, 4 and 6 and the high lanes to 1, 3, 5 and 7
+			__m256i result = _mm256_hadd_epi32(_mm256_hadd_epi32(sums[0], sums[1]), _mm256_hadd_epi32(sums[2], sums[3]));
+			result = _mm256_permutevar8x32_epi32(result, order);
+			result = _mm256_srai_epi32(_mm256_add_epi32(result, round), kHorizontalShift);
+			_mm_storeu_si128((__m128i*)(dest + x), _mm_packs_epi32(_mm256_castsi256_si128(result), _mm256_extracti128_si256(result, 1)));
+		}
+	}
+
+	__attribute__((target("avx2")))
+	void verticalAVX2(const int16_t* const* sources, const int16_t* coefficients, long taps, int16_t* dest, long width, int16_t minimum, int16_t maximum)
+	{
+		const __m256i round = _mm256_set1_epi32(1 << (kVerticalShift - 1));
+		const __m256i minimumLevel = _mm256_set1_epi16(minimum);
+		const __m256i maximumLevel = _mm256_set1_epi16(maximum);
+
+		for (long x = 0; x < width; x += 16)
+		{
+			__m256i low = round;
+			__m256i high = round;
+
+			// Unpacking and packing both work within 128-bit lanes, so the samples stay in order
+			for (long k = 0; k < taps; k += 2)
+			{
+				__m256i a = _mm256_loadu_si256((const __m256i*)(sources[k] + x));
+				__m256i b = _mm256_loadu_si256((const __m256i*)(sources[k + 1] + x));
+				__m256i c = _mm256_set1_epi32((uint16_t)coefficients[k] | ((uint32_t)(uint16_t)coefficients[k + 1] << 16));
+
+				low = _mm256_add_epi32(low, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), c));
+				high = _mm256_add_epi32(high, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), c));
+			}
+
+			__m256i result = _mm256_packs_epi32(_mm256_srai_epi32(low, kVerticalShift), _mm256_srai_epi32(high, kVerticalShift));
+			result = _mm256_min_epi16(_mm256_max_epi16(result, minimumLevel), maximumLevel);
+			_mm256_storeu_si256((__m256i*)(dest + x), result);
+		}
+	}
+#endif
+
+	ScalerKernels selectKernels(void)
+	{
+#if defined(__x86_64__)
+		if (__builtin_cpu_supports("avx2"))
+			return { "AVX2", horizontalAVX2, verticalAVX2 };
+#endif
+#if defined(__SSE2__)
+		return { "SSE2", horizontalSSE2, verticalSSE2 };
+#elif defined(__ARM_NEON)
+		return { "NEON", horizontalNEON, verticalNEON };
+#else
+		return { "C", horizontalC, verticalC };
+#endif
+	}
+
+	const ScalerKernels& getKernels(void)
+	{
+		static const ScalerKernels kernels = selectKernels();
+		return kernels;
+	}
+}
+
+// Output frame, holding a buffer from the pool and the timecodes of the input frame
+class ScaledVideoFrame : public IDeckLinkVideoFrame
+{
+public:
+	ScaledVideoFrame(std::shared_ptr<uint8_t> buffer, long width, long height, long rowBytes, BMDPixelFormat pixelFormat) :
+		m_refCount(1),
+		m_buffer(buffer),
+		m_width(width),
+		m_height(height),
+		m_rowBytes(rowBytes),
+		m_pixelFormat(pixelFormat)
+	{ }
+	virtual ~ScaledVideoFrame() = default;
+
+	void	copyTimecodes(IDeckLinkVideoFrame* videoFrame)
+	{
+		for (BMDTimecodeFormat format : kTimecodeFormats)
+		{
+			com_ptr<IDeckLinkTimecode> timecode;
+
+			if ((videoFrame->GetTimecode(format, timecode.releaseAndGetAddressOf()) == S_OK) && timecode)
+				m_timecodes.push_back(std::make_pair(format, timecode));
+		}
+	}
+
+	// IUnknown interface
+	HRESULT	STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override
+	{
+		if (ppv == nullptr)
+			return E_INVALIDARG;
+
+		if ((iid == IID_IUnknown) || (iid == IID_IDeckLinkVideoFrame))
+		{
+			*ppv = (IDeckLinkVideoFrame*)this;
+			AddRef();
+			return S_OK;
+		}
+
+		*ppv = nullptr;
+		return E_NOINTERFACE;
+	}
+
+	ULONG	STDMETHODCALLTYPE AddRef() override { return ++m_refCount; }
+
+	ULONG	STDMETHODCALLTYPE Release() override
+	{
+		ULONG newRefValue = --m_refCount;
+
+		if (newRefValue == 0)
+			delete this;
+
+		return newRefValue;
+	}
+
+	// IDeckLinkVideoFrame interface
+	long			STDMETHODCALLTYPE GetWidth() override { return m_width; }
+	long			STDMETHODCALLTYPE GetHeight() override { return m_height; }
+	long			STDMETHODCALLTYPE GetRowBytes() override { return m_rowBytes; }
+	BMDPixelFormat	STDMETHODCALLTYPE GetPixelFormat() override { return m_pixelFormat; }
+	BMDFrameFlags	STDMETHODCALLTYPE GetFlags() override { return bmdFrameFlagDefault; }
+	HRESULT			STDMETHODCALLTYPE GetBytes(void** buffer) override { *buffer = m_buffer.get(); return S_OK; }
+	HRESULT			STDMETHODCALLTYPE GetAncillaryData(IDeckLinkVideoFrameAncillary** ancillary) override { return E_NOTIMPL; }
+
+	HRESULT			STDMETHODCALLTYPE GetTimecode(BMDTimecodeFormat format, IDeckLinkTimecode** timecode) override
+	{
+		for (auto& entry : m_timecodes)
+		{
+			if (entry.first == format)
+			{
+				*timecode = entry.second.get();
+				(*timecode)->AddRef();
+				return S_OK;
+			}
+		}
+
+		*timecode = nullptr;
+		return S_FALSE;
+	}
+
+private:
+	std::atomic<ULONG>												m_refCount;
+	std::shared_ptr<uint8_t>										m_buffer;
+	long															m_width;
+	long															m_height;
+	long															m_rowBytes;
+	BMDPixelFormat													m_pixelFormat;
+	std::vector<std::pair<BMDTimecodeFormat, com_ptr<IDeckLinkTimecode>>>	m_timecodes;
+};
+
+// Output buffers of one size.  A buffer is allocated when none is free, so the pool grows to
+// the number of frames in flight and then stays there.  A buffer returns to the pool when
+// its frame is released, after the pool itself has been released if the scaler was stopped.
+class Scaler::BufferPool : public std::enable_shared_from_this<BufferPool>
+{
+public:
+	BufferPool(size_t bufferSize) :
+		m_bufferSize(bufferSize)
+	{ }
+
+	~BufferPool()
+	{
+		for (auto buffer : m_buffers)
+			free(buffer);
+	}
+
+	std::shared_ptr<uint8_t> acquire(void)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		uint8_t* buffer;
+
+		if (m_freeBuffers.empty())
+		{
+			void* allocated = nullptr;
+
+			if (posix_memalign(&allocated, 64, m_bufferSize) != 0)
+				return nullptr;
+
+			buffer = (uint8_t*)allocated;
+			m_buffers.push_back(buffer);
+		}
+		else
+		{
+			buffer = m_freeBuffers.back();
+			m_freeBuffers.pop_back();
+		}
+
+		auto pool = shared_from_this();
+		return std::shared_ptr<uint8_t>(buffer, [pool](uint8_t* released) {
+			std::lock_guard<std::mutex> lock(pool->m_mutex);
+			pool->m_freeBuffers.push_back(released);
+		});
+	}
+
+	uint64_t getBufferCount(void)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_buffers.size();
+	}
+
+private:
+	size_t					m_bufferSize;
+	std::mutex				m_mutex;
+	std::vector<uint8_t*>	m_buffers;
+	std::vector<uint8_t*>	m_freeBuffers;
+};
+
+Scaler::Scaler(std::shared_ptr<BandWorkerPool> workerPool, ScalerFilter filter) :
+	m_filter(filter),
+	m_started(false),
+	m_input(),
+	m_output(),
+	m_pixelFormat(bmdFormat10BitYUV),
+	m_inputPaddedWidth(0),
+	m_outputPaddedWidth(0),
+	m_outputRowBytes(0),
+	m_bands(0),
+	m_bandRows(0),
+	m_slotCount(0),
+	m_workerPool(workerPool),
+	m_workerRows(workerPool->getThreadCount()),
+	m_statistics(),
+	m_inputBytes(nullptr),
+	m_inputRowBytes(0),
+	m_outputBytes(nullptr)
+{
+}
+
+Scaler::~Scaler()
+{
+}
+
+bool Scaler::isPixelFormatSupported(BMDPixelFormat pixelFormat)
+{
+	return (pixelFormat == bmdFormat10BitYUV) || (pixelFormat == bmdFormat8BitYUV);
+}
+
+bool Scaler::getFilterFromName(const char* name, ScalerFilter& filter)
+{
+	for (ScalerFilter candidate : { ScalerFilter::Bilinear, ScalerFilter::Bicubic, ScalerFilter::Lanczos })
+	{
+		if (strcasecmp(name, getFilterName(candidate)) == 0)
+		{
+			filter = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* Scaler::getFilterName(ScalerFilter filter)
+{
+	switch (filter)
+	{
+		case ScalerFilter::Bilinear:
+			return "bilinear";
+		case ScalerFilter::Bicubic:
+			return "bicubic";
+		default:
+			return "lanczos";
+	}
+}
+
+const char* Scaler::getKernelName(void) const
+{
+	return getKernels().name;
+}
+
+bool Scaler::start(const ScalerGeometry& input, const ScalerGeometry& output, BMDPixelFormat pixelFormat)
+{
+	std::lock_guard<std::mutex> scaleLock(m_scaleMutex);
+
+	m_started = false;
+	m_tables = nullptr;
+	m_bufferPool = nullptr;
+	resetStatistics();
+
+	if (!isPixelFormatSupported(pixelFormat) || (input.width <= 0) || (input.height <= 0) || (output.width <= 0) || (output.height <= 0))
+		return false;
+
+	m_input				= input;
+	m_output			= output;
+	m_pixelFormat		= pixelFormat;
+	m_inputPaddedWidth	= roundUp(input.width, kWidthAlignment);
+	m_outputPaddedWidth	= roundUp(output.width, kWidthAlignment);
+	m_outputRowBytes	= getRowBytes(pixelFormat, output.width);
+
+	TablesKey key(input.width, input.height, input.fieldDominance, output.width, output.height, output.fieldDominance);
+	auto iter = m_tablesCache.find(key);
+
+	if (iter == m_tablesCache.end())
+	{
+		std::shared_ptr<const Tables> tables = buildTables();
+		if (!tables)
+			return false;
+
+		iter = m_tablesCache.insert(std::make_pair(key, tables)).first;
+
+		std::lock_guard<std::mutex> lock(m_statisticsMutex);
+		++m_statistics.tablesBuilt;
+	}
+	m_tables = iter->second;
+
+	// Enough slots to keep the rows of both fields around the output row
+	m_slotCount = 4 * m_tables->vertical.taps;
+
+	unsigned threadCount = (unsigned)m_workerRows.size();
+	m_bandRows = std::max(kMinimumBandRows, (output.height + threadCount * kBandsPerThread - 1) / (threadCount * kBandsPerThread));
+	m_bands = (output.height + m_bandRows - 1) / m_bandRows;
+
+	for (WorkerRows& rows : m_workerRows)
+	{
+		rows.unpacked.assign(2 * m_inputPaddedWidth, 0);
+		rows.filtered.assign(m_slotCount * 2 * m_outputPaddedWidth, 0);
+		rows.slotRows.assign(m_slotCount, -1);
+		rows.scaled.assign(2 * m_outputPaddedWidth, 0);
+		rows.sources.assign(m_tables->vertical.taps, nullptr);
+	}
+
+	m_bufferPool = std::make_shared<BufferPool>(m_outputRowBytes * output.height);
+	m_started = true;
+
+	return true;
+}
+
+void Scaler::stop(void)
+{
+	std::lock_guard<std::mutex> scaleLock(m_scaleMutex);
+
+	m_started = false;
+	m_tables = nullptr;
+	m_bufferPool = nullptr;
+}
+
+com_ptr<IDeckLinkVideoFrame> Scaler::scaleFrame(IDeckLinkVideoFrame* videoFrame)
+{
+	void*							bytes;
+	long							rowBytes = videoFrame->GetRowBytes();
+	std::shared_ptr<uint8_t>		buffer;
+
+	std::lock_guard<std::mutex> scaleLock(m_scaleMutex);
+
+	if (!m_tables || (videoFrame->GetPixelFormat() != m_pixelFormat) ||
+		(videoFrame->GetWidth() != m_input.width) || (videoFrame->GetHeight() != m_input.height) ||
+		(rowBytes < getRowBytes(m_pixelFormat, m_input.width)) || (videoFrame->GetBytes(&bytes) != S_OK))
+	{
+		std::lock_guard<std::mutex> lock(m_statisticsMutex);
+		++m_statistics.framesRejected;
+		return nullptr;
+	}
+
+	buffer = m_bufferPool->acquire();
+	if (!buffer)
+		return nullptr;
+
+	m_inputBytes = (const uint8_t*)bytes;
+	m_inputRowBytes = rowBytes;
+	m_outputBytes = buffer.get();
+
+	m_workerPool->run(m_bands, [this](unsigned threadIndex, long band)
+	{
+		scaleBand(m_workerRows[threadIndex], band);
+	});
+
+	com_ptr<ScaledVideoFrame> scaledFrame = make_com_ptr<ScaledVideoFrame>(buffer, m_output.width, m_output.height, m_outputRowBytes, m_pixelFormat);
+	scaledFrame->copyTimecodes(videoFrame);
+
+	{
+		std::lock_guard<std::mutex> lock(m_statisticsMutex);
+		++m_statistics.framesScaled;
+	}
+
+	return com_ptr<IDeckLinkVideoFrame>(scaledFrame.get());
+}
+
+void Scaler::getStatistics(ScalerStatistics& statistics)
+{
+	std::shared_ptr<BufferPool> bufferPool;
+	{
+		std::lock_guard<std::mutex> lock(m_statisticsMutex);
+		statistics = m_statistics;
+		bufferPool = m_bufferPool;
+	}
+
+	if (bufferPool)
+		statistics.buffersAllocated = bufferPool->getBufferCount();
+}
+
+void Scaler::resetStatistics(void)
+{
+	std::lock_guard<std::mutex> lock(m_statisticsMutex);
+	m_statistics = ScalerStatistics();
+}
+
+void Scaler::scaleBand(WorkerRows& rows, long band)
+{
+	const ScalerKernels&	kernels = getKernels();
+	const VerticalTable&	vertical = m_tables->vertical;
+	const long				firstRow = band * m_bandRows;
+	const long				lastRow = std::min(firstRow + m_bandRows, m_output.height);
+	const long				chromaWidth = m_outputPaddedWidth / 2;
+	const int16_t			maximum = (m_pixelFormat == bmdFormat10BitYUV) ? kMaximumLevel : kMaximum8BitLevel;
+
+	int16_t*				luma = rows.scaled.data();
+	int16_t*				cb = luma + m_outputPaddedWidth;
+	int16_t*				cr = cb + chromaWidth;
+
+	// The rows kept are from the previous frame
+	std::fill(rows.slotRows.begin(), rows.slotRows.end(), -1);
+
+	for (long row = firstRow; row < lastRow; row++)
+	{
+		const int32_t* inputRows = &vertical.rows[row * vertical.taps];
+		const int16_t* coefficients = &vertical.coefficients[row * vertical.taps];
+
+		for (long k = 0; k < vertical.taps; k++)
+			rows.sources[k] = filterInputRow(rows, inputRows[k]);
+
+		kernels.vertical(rows.sources.data(), coefficients, vertical.taps, luma, m_outputPaddedWidth, kMinimumLevel, maximum);
+
+		for (long k = 0; k < vertical.taps; k++)
+			rows.sources[k] += m_outputPaddedWidth;
+		kernels.vertical(rows.sources.data(), coefficients, vertical.taps, cb, chromaWidth, kMinimumLevel, maximum);
+
+		for (long k = 0; k < vertical.taps; k++)
+			rows.sources[k] += chromaWidth;
+		kernels.vertical(rows.sources.data(), coefficients, vertical.taps, cr, chromaWidth, kMinimumLevel, maximum);
+
+		packRow(luma, cb, cr, m_outputBytes + row * m_outputRowBytes);
+	}
+}
+
+const int16_t* Scaler::filterInputRow(WorkerRows& rows, long inputRow)
+{
+	const long	slot = inputRow % m_slotCount;
+	int16_t*	filtered = rows.filtered.data() + slot * 2 * m_outputPaddedWidth;
+
+	if (rows.slotRows[slot] != inputRow)
+	{
+		const ScalerKernels&	kernels = getKernels();
+		const HorizontalTable&	luma = m_tables->luma;
+		const HorizontalTable&	chroma = m_tables->chroma;
+		int16_t*				unpackedLuma = rows.unpacked.data();
+		int16_t*				unpackedCb = unpackedLuma + m_inputPaddedWidth;
+		int16_t*				unpackedCr = unpackedCb + m_inputPaddedWidth / 2;
+
+		unpackRow(m_inputBytes + inputRow * m_inputRowBytes, unpackedLuma, unpackedCb, unpackedCr);
+
+		kernels.horizontal(unpackedLuma, luma.starts.data(), luma.coefficients.data(), luma.taps, filtered, m_outputPaddedWidth);
+		kernels.horizontal(unpackedCb, chroma.starts.data(), chroma.coefficients.data(), chroma.taps, filtered + m_outputPaddedWidth, m_outputPaddedWidth / 2);
+		kernels.horizontal(unpackedCr, chroma.starts.data(), chroma.coefficients.data(), chroma.taps, filtered + m_outputPaddedWidth * 3 / 2, m_outputPaddedWidth / 2);
+
+		rows.slotRows[slot] = inputRow;
+	}
+
+	return filtered;
+}
+
+void Scaler::unpackRow(const uint8_t* source, int16_t* luma, int16_t* cb, int16_t* cr) const
+{
+	if (m_pixelFormat == bmdFormat10BitYUV)
+	{
+		// Each group of 4 words holds 6 pixels, Cb0 Y0 Cr0 | Y1 Cb2 Y2 | Cr2 Y3 Cb4 | Y4 Cr4 Y5
+		const uint32_t*	words = (const uint32_t*)source;
+		const long		groups = (m_input.width + 5) / 6;
+
+		for (long group = 0; group < groups; group++, words += 4, luma += 6, cb += 3, cr += 3)
+		{
+			uint32_t w0 = words[0];
+			uint32_t w1 = words[1];
+			uint32_t w2 = words[2];
+			uint32_t w3 = words[3];
+
+			cb[0]	= w0 & 0x3FF;
+			luma[0]	= (w0 >> 10) & 0x3FF;
+			cr[0]	= (w0 >> 20) & 0x3FF;
+			luma[1]	= w1 & 0x3FF;
+			cb[1]	= (w1 >> 10) & 0x3FF;
+			luma[2]	= (w1 >> 20) & 0x3FF;
+			cr[1]	= w2 & 0x3FF;
+			luma[3]	= (w2 >> 10) & 0x3FF;
+			cb[2]	= (w2 >> 20) & 0x3FF;
+			luma[4]	= w3 & 0x3FF;
+			cr[2]	= (w3 >> 10) & 0x3FF;
+			luma[5]	= (w3 >> 20) & 0x3FF;
+		}
+	}
+	else
+	{
+		// 2vuy, Cb Y0 Cr Y1 for each pair of pixels, scaled to 10 bits
+		for (long pair = 0; pair < m_input.width / 2; pair++, source += 4, luma += 2)
+		{
+			cb[pair]	= source[0] << 2;
+			luma[0]		= source[1] << 2;
+			cr[pair]	= source[2] << 2;
+			luma[1]		= source[3] << 2;
+		}
+	}
+}
+
+void Scaler::packRow(const int16_t* luma, const int16_t* cb, const int16_t* cr, uint8_t* dest) const
+{
+	if (m_pixelFormat == bmdFormat10BitYUV)
+	{
+		// All groups in the row, the padding to the row's end is filled from the padded planes
+		uint32_t*	words = (uint32_t*)dest;
+		const long	groups = m_outputRowBytes / 16;
+
+		for (long group = 0; group < groups; group++, words += 4, luma += 6, cb += 3, cr += 3)
+		{
+			words[0] = cb[0] | (luma[0] << 10) | (cr[0] << 20);
+			words[1] = luma[1] | (cb[1] << 10) | (luma[2] << 20);
+			words[2] = cr[1] | (luma[3] << 10) | (cb[2] << 20);
+			words[3] = luma[4] | (cr[2] << 10) | (luma[5] << 20);
+		}
+	}
+	else
+	{
+		for (long pair = 0; pair < m_output.width / 2; pair++, dest += 4, luma += 2)
+		{
+			dest[0] = (uint8_t)((cb[pair] + 2) >> 2);
+			dest[1] = (uint8_t)((luma[0] + 2) >> 2);
+			dest[2] = (uint8_t)((cr[pair] + 2) >> 2);
+			dest[3] = (uint8_t)((luma[1] + 2) >> 2);
+		}
+	}
+}
+
+std::shared_ptr<const Scaler::Tables> Scaler::buildTables(void) const
+{
+	std::shared_ptr<Tables> tables = std::make_shared<Tables>();
+
+	buildHorizontalTable(tables->luma, m_input.width, m_output.width, m_outputPaddedWidth, false);
+	buildHorizontalTable(tables->chroma, m_input.width / 2, m_output.width / 2, m_outputPaddedWidth / 2, true);
+	buildVerticalTable(tables->vertical);
+
+	if ((tables->luma.taps == 0) || (tables->chroma.taps == 0) || (tables->vertical.taps == 0))
+		return nullptr;
+
+	return tables;
+}
+
+void Scaler::buildHorizontalTable(HorizontalTable& table, long inputWidth, long outputWidth, long outputPaddedWidth, bool chroma) const
+{
+	const double	scale = (double)inputWidth / outputWidth;
+	const double	filterScale = std::max(1.0, scale);
+	const long		taps = roundUp(getFilterTaps(m_filter, filterScale), 8);
+
+	table.taps = 0;
+	if (taps > inputWidth)
+		return;
+
+	// The padding after the row is left with no taps, so it filters to zero
+	table.taps = taps;
+	table.starts.assign(outputPaddedWidth, 0);
+	table.coefficients.assign(outputPaddedWidth * taps, 0);
+
+	for (long x = 0; x < outputWidth; x++)
+	{
+		// Chroma samples are co-sited with the even luma samples, so they are placed by the
+		// position of their luma sample in the full width row
+		double center = chroma ? ((2 * x + 0.5) * scale - 0.5) / 2.0 : (x + 0.5) * scale - 0.5;
+
+		table.starts[x] = (int32_t)computeWeights(m_filter, center, filterScale, inputWidth, taps, &table.coefficients[x * taps]);
+	}
+}
+
+void Scaler::buildVerticalTable(VerticalTable& table) const
+{
+	const bool		fieldScaling = isInterlaced(m_input.fieldDominance) && isInterlaced(m_output.fieldDominance);
+	const double	scale = (double)m_input.height / m_output.height;
+	const double	filterScale = std::max(1.0, scale);
+	const long		taps = roundUp(getFilterTaps(m_filter, filterScale), 2);
+
+	table.taps = 0;
+	if (taps > (fieldScaling ? m_input.height / 2 : m_input.height))
+		return;
+
+	std::vector<int16_t> coefficients(taps);
+
+	table.taps = taps;
+	table.rows.assign(m_output.height * taps, 0);
+	table.coefficients.assign(m_output.height * taps, 0);
+
+	for (long row = 0; row < m_output.height; row++)
+	{
+		double center = (row + 0.5) * scale - 0.5;
+
+		if (fieldScaling)
+		{
+			// Each output field comes from the input field at the same time, which is the
+			// other field in the frame when the two modes have the opposite field dominance
+			long	outputField = row & 1;
+			long	inputField = (m_input.fieldDominance == m_output.fieldDominance) ? outputField : 1 - outputField;
+			long	fieldRows = (m_input.height - inputField + 1) / 2;
+			long	start = computeWeights(m_filter, (center - inputField) / 2.0, filterScale, fieldRows, taps, &table.coefficients[row * taps]);
+
+			for (long k = 0; k < taps; k++)
+				table.rows[row * taps + k] = (int32_t)(2 * (start + k) + inputField);
+		}
+		else
+		{
+			long start = computeWeights(m_filter, center, filterScale, m_input.height, taps, &table.coefficients[row * taps]);
+
+			for (long k = 0; k < taps; k++)
+				table.rows[row * taps + k] = (int32_t)(start + k);
+		}
+	}
+}
@@ -0,0 +1,196 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include "DeckLinkAPI.h"
+#include "com_ptr.h"
+#include "BandWorkerPool.h"
+
+enum class ScalerFilter
+{
+	Bilinear,
+	Bicubic,
+	Lanczos
+};
+
+struct ScalerGeometry
+{
+	long				width;
+	long				height;
+	BMDFieldDominance	fieldDominance;
+};
+
+struct ScalerStatistics
+{
+	uint64_t	framesScaled;
+	uint64_t	framesRejected;			// input frames that didn't match the started geometry
+	uint64_t	tablesBuilt;			// coefficient tables computed, once for each mode pair
+	uint64_t	buffersAllocated;		// output frame buffers, the most that were in flight at once
+};
+
+// Scales 10-bit YUV (v210) and 8-bit YUV (2vuy) frames to another size, on the CPU.
+//
+// A separable polyphase filter, bilinear, bicubic or Lanczos-3, is applied across each row
+// and then down each column.  Rows are unpacked to planes of 16-bit samples and luma and
+// chroma are filtered separately, chroma with its own coefficients for the 4:2:2 samples
+// co-sited with the even luma samples.  When shrinking, the filter is widened by the scale
+// so that it also removes the detail the smaller frame can't hold.
+//
+// The coefficients are computed once for each pair of input and output geometries and kept,
+// so a source switching back and forth between formats doesn't compute them again.  When
+// both the input and the output are interlaced, each output field is scaled from the input
+// field in the same place in time.  Otherwise frames are scaled whole.
+//
+// Bands of output rows are split between the threads of the worker pool, and the thread
+// calling scaleFrame() scales bands as well.  Within a band each input row is filtered across once,
+// then kept for the output rows that need it.  Frames are scaled one at a time, into
+// buffers that are reused once the frames scaled into them are released.
+class Scaler
+{
+public:
+	Scaler(std::shared_ptr<BandWorkerPool> workerPool, ScalerFilter filter);
+	virtual ~Scaler();
+
+	static bool			isPixelFormatSupported(BMDPixelFormat pixelFormat);
+	static bool			getFilterFromName(const char* name, ScalerFilter& filter);
+	static const char*	getFilterName(ScalerFilter filter);
+
+	// Name of the instruction set used, chosen for the processor when the scaler is created
+	const char*			getKernelName(void) const;
+	ScalerFilter		getFilter(void) const { return m_filter; }
+	bool				isStarted(void) const { return m_started; }
+
+	// Sets the geometries to scale between and resets the statistics.  Returns false if the
+	// pixel format is not supported or the input is too small for the filter.
+	bool				start(const ScalerGeometry& input, const ScalerGeometry& output, BMDPixelFormat pixelFormat);
+	void				stop(void);
+
+	// Returns a new frame of the output size, or nullptr if the frame doesn't match the
+	// started geometry and pixel format.  RP188 timecodes are carried over from the input,
+	// ancillary data is not.  Only the left eye of a 3D frame is scaled.
+	com_ptr<IDeckLinkVideoFrame>	scaleFrame(IDeckLinkVideoFrame* videoFrame);
+
+	void				getStatistics(ScalerStatistics& statistics);
+	void				resetStatistics(void);
+
+private:
+	// Polyphase filter across a row.  Each output sample has a window of taps input samples
+	// starting at starts[x], with taps a multiple of 4 and the window always inside the row.
+	struct HorizontalTable
+	{
+		long									taps;
+		std::vector<int32_t>					starts;
+		std::vector<int16_t>					coefficients;
+	};
+
+	// Filter down the columns.  Each output row has taps input rows, an even number.
+	struct VerticalTable
+	{
+		long									taps;
+		std::vector<int32_t>					rows;
+		std::vector<int16_t>					coefficients;
+	};
+
+	struct Tables
+	{
+		HorizontalTable							luma;
+		HorizontalTable							chroma;
+		VerticalTable							vertical;
+	};
+
+	using TablesKey = std::tuple<long, long, BMDFieldDominance, long, long, BMDFieldDominance>;
+
+	// Rows of one worker thread, input rows filtered across are kept in slots by row number
+	struct WorkerRows
+	{
+		std::vector<int16_t>					unpacked;			// luma, then Cb, then Cr
+		std::vector<int16_t>					filtered;			// slotCount rows of luma, Cb and Cr
+		std::vector<long>						slotRows;			// input row held in each slot, or -1
+		std::vector<int16_t>					scaled;				// one output row of luma, Cb and Cr
+		std::vector<const int16_t*>				sources;			// filtered rows for each tap of the output row
+	};
+
+	class BufferPool;
+
+	ScalerFilter								m_filter;
+	std::atomic<bool>							m_started;
+
+	std::mutex									m_scaleMutex;
+	ScalerGeometry								m_input;
+	ScalerGeometry								m_output;
+	BMDPixelFormat								m_pixelFormat;
+	long										m_inputPaddedWidth;		// whole v210 groups and SIMD blocks
+	long										m_outputPaddedWidth;
+	long										m_outputRowBytes;
+	long										m_bands;
+	long										m_bandRows;
+	long										m_slotCount;
+	std::shared_ptr<const Tables>				m_tables;
+	std::map<TablesKey, std::shared_ptr<const Tables>>	m_tablesCache;
+	std::shared_ptr<BufferPool>					m_bufferPool;
+	std::shared_ptr<BandWorkerPool>				m_workerPool;
+	std::vector<WorkerRows>						m_workerRows;		// per thread of the worker pool
+
+	std::mutex									m_statisticsMutex;
+	ScalerStatistics							m_statistics;
+
+	// Per frame state, set by scaleFrame() for the workers
+	const uint8_t*								m_inputBytes;
+	long										m_inputRowBytes;
+	uint8_t*									m_outputBytes;
+
+	void		scaleBand(WorkerRows& rows, long band);
+	const int16_t*	filterInputRow(WorkerRows& rows, long inputRow);
+
+	void		unpackRow(const uint8_t* source, int16_t* luma, int16_t* cb, int16_t* cr) const;
+	void		packRow(const int16_t* luma, const int16_t* cb, const int16_t* cr, uint8_t* dest) const;
+
+	std::shared_ptr<const Tables>	buildTables(void) const;
+	void		buildHorizontalTable(HorizontalTable& table, long inputWidth, long outputWidth, long outputPaddedWidth, bool chroma) const;
+	void		buildVerticalTable(VerticalTable& table) const;
+};
@@ -0,0 +1,643 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include "SyncMeasurement.h"
+#include "ReferenceTime.h"
+#include "platform.h"
+
+// Stamps use a DID from the range for user applications, the payload is 8-bit data
+static const uint8_t		kStampDID				= 0x50;
+static const uint8_t		kStampSDID				= 0x4c;
+static const uint8_t		kStampVersion			= 1;
+static const uint32_t		kStampSize				= 14;		// version, frame number, stamp time, flags
+static const uint8_t		kStampFlagFlash			= 0x01;
+
+static const uint32_t		kAudioSampleRate		= 48000;
+static const uint32_t		kBeepFrequency			= 1000;
+static const double			kBeepLevel				= 0.5;				// -6 dBFS
+static const int64_t		kBeepThreshold			= 1LL << 29;		// a quarter of full scale
+static const uint32_t		kBeepQuietSampleFrames	= kAudioSampleRate / 100;	// 10 ms below the threshold ends a beep
+
+static const uint32_t		kBlackLevel				= 64;
+static const uint32_t		kWhiteLevel				= 940;
+static const uint32_t		kFlashThreshold			= (kBlackLevel + kWhiteLevel) / 2;
+static const long			kLumaSampleRowStep		= 16;
+
+static const uint32_t		kMatchWindowSeconds		= 5;		// output frames not seen on input after this are lost
+static const size_t			kMaxFlashOutputTimes	= 8;
+
+static const BMDTimeValue	kHistogramBinWidth		= ReferenceTime::kTicksPerMilliSec;
+static const BMDTimeValue	kMaxGlassToGlassLatency	= 2000 * ReferenceTime::kTicksPerMilliSec;
+static const BMDTimeValue	kMaxAVOffset			= 1000 * ReferenceTime::kTicksPerMilliSec;
+
+// Stamp carried in the VANC of each output frame, attached to the frame's packet store
+// which releases it
+class SyncStampPacket : public IDeckLinkAncillaryPacket
+{
+public:
+	SyncStampPacket(uint64_t frameNumber, BMDTimeValue stampTime, bool flash) :
+		m_refCount(1)
+	{
+		m_data[0] = kStampVersion;
+		for (int i = 0; i < 4; i++)
+			m_data[1 + i] = (uint8_t)(frameNumber >> (8 * i));
+		for (int i = 0; i < 8; i++)
+			m_data[5 + i] = (uint8_t)((uint64_t)stampTime >> (8 * i));
+		m_data[13] = flash ? kStampFlagFlash : 0;
+	}
+	virtual ~SyncStampPacket() = default;
+
+	// IUnknown interface
+	HRESULT	STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override
+	{
+		if (ppv == nullptr)
+			return E_INVALIDARG;
+
+		*ppv = nullptr;
+		return E_NOINTERFACE;
+	}
+
+	ULONG	STDMETHODCALLTYPE AddRef() override { return ++m_refCount; }
+
+	ULONG	STDMETHODCALLTYPE Release() override
+	{
+		ULONG newRefValue = --m_refCount;
+
+		if (newRefValue == 0)
+			delete this;
+
+		return newRefValue;
+	}
+
+	// IDeckLinkAncillaryPacket interface
+	HRESULT	STDMETHODCALLTYPE GetBytes(BMDAncillaryPacketFormat format, const void** data, uint32_t* size) override
+	{
+		// DeckLink converts 8-bit data to the format it needs
+		if (format != bmdAncillaryPacketFormatUInt8)
+			return E_NOTIMPL;
+
+		if (size)
+			*size = kStampSize;
+		if (data)
+			*data = m_data;
+		return S_OK;
+	}
+
+	uint8_t		STDMETHODCALLTYPE GetDID() override { return kStampDID; }
+	uint8_t		STDMETHODCALLTYPE GetSDID() override { return kStampSDID; }
+	// Zero lets DeckLink place the packet on the first VANC lines of the mode
+	uint32_t	STDMETHODCALLTYPE GetLineNumber() override { return 0; }
+	uint8_t		STDMETHODCALLTYPE GetDataStreamIndex() override { return 0; }
+
+private:
+	std::atomic<ULONG>	m_refCount;
+	uint8_t				m_data[kStampSize];
+};
+
+// Output test frame, a shared black or white picture with its own ancillary packets
+class SyncVideoFrame : public IDeckLinkVideoFrame
+{
+public:
+	SyncVideoFrame(std::shared_ptr<uint8_t> buffer, const SyncMeasurementFormat& format, com_ptr<IDeckLinkVideoFrameAncillaryPackets> ancillaryPackets) :
+		m_refCount(1),
+		m_buffer(buffer),
+		m_format(format),
+		m_ancillaryPackets(ancillaryPackets)
+	{ }
+	virtual ~SyncVideoFrame() = default;
+
+	// IUnknown interface
+	HRESULT	STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override
+	{
+		if (ppv == nullptr)
+			return E_INVALIDARG;
+
+		if ((iid == IID_IUnknown) || (iid == IID_IDeckLinkVideoFrame))
+		{
+			*ppv = (IDeckLinkVideoFrame*)this;
+			AddRef();
+			return S_OK;
+		}
+
+		if ((iid == IID_IDeckLinkVideoFrameAncillaryPackets) && m_ancillaryPackets)
+		{
+			*ppv = m_ancillaryPackets.get();
+			m_ancillaryPackets->AddRef();
+			return S_OK;
+		}
+
+		*ppv = nullptr;
+		return E_NOINTERFACE;
+	}
+
+	ULONG	STDMETHODCALLTYPE AddRef() override { return ++m_refCount; }
+
+	ULONG	STDMETHODCALLTYPE Release() override
+	{
+		ULONG newRefValue = --m_refCount;
+
+		if (newRefValue == 0)
+			delete this;
+
+		return newRefValue;
+	}
+
+	// IDeckLinkVideoFrame interface
+	long			STDMETHODCALLTYPE GetWidth() override { return m_format.width; }
+	long			STDMETHODCALLTYPE GetHeight() override { return m_format.height; }
+	long			STDMETHODCALLTYPE GetRowBytes() override { return m_format.rowBytes; }
+	BMDPixelFormat	STDMETHODCALLTYPE GetPixelFormat() override { return m_format.pixelFormat; }
+	BMDFrameFlags	STDMETHODCALLTYPE GetFlags() override { return bmdFrameFlagDefault; }
+	HRESULT			STDMETHODCALLTYPE GetBytes(void** buffer) override { *buffer = m_buffer.get(); return S_OK; }
+	HRESULT			STDMETHODCALLTYPE GetTimecode(BMDTimecodeFormat format, IDeckLinkTimecode** timecode) override { return E_NOTIMPL; }
+	HRESULT			STDMETHODCALLTYPE GetAncillaryData(IDeckLinkVideoFrameAncillary** ancillary) override { return E_NOTIMPL; }
+
+private:
+	std::atomic<ULONG>								m_refCount;
+	std::shared_ptr<uint8_t>						m_buffer;
+	SyncMeasurementFormat							m_format;
+	com_ptr<IDeckLinkVideoFrameAncillaryPackets>	m_ancillaryPackets;
+};
+
+static bool decodeStamp(IDeckLinkAncillaryPacket* packet, uint64_t& frameNumber, BMDTimeValue& stampTime)
+{
+	const uint8_t*	data;
+	uint32_t		size;
+	uint64_t		time = 0;
+
+	if ((packet->GetBytes(bmdAncillaryPacketFormatUInt8, (const void**)&data, &size) != S_OK) ||
+		(size < kStampSize) || (data[0] != kStampVersion))
+		return false;
+
+	frameNumber = 0;
+	for (int i = 0; i < 4; i++)
+		frameNumber |= (uint64_t)data[1 + i] << (8 * i);
+	for (int i = 0; i < 8; i++)
+		time |= (uint64_t)data[5 + i] << (8 * i);
+	stampTime = (BMDTimeValue)time;
+
+	return true;
+}
+
+static std::shared_ptr<uint8_t> createFrameBuffer(const SyncMeasurementFormat& format, uint32_t level)
+{
+	size_t						size = format.rowBytes * format.height;
+	std::shared_ptr<uint8_t>	buffer(new uint8_t[size], std::default_delete<uint8_t[]>());
+	uint32_t*					words = (uint32_t*)buffer.get();
+
+	if (format.pixelFormat == bmdFormat10BitYUV)
+	{
+		// v210 groups of Cb Y Cr Y, with neutral chroma every group is the same 4 words
+		const uint32_t chroma = 512;
+		const uint32_t group[4] =
+		{
+			chroma | (level << 10) | (chroma << 20),
+			level | (chroma << 10) | (level << 20),
+			chroma | (level << 10) | (chroma << 20),
+			level | (chroma << 10) | (level << 20),
+		};
+
+		for (size_t i = 0; i < size / 4; i++)
+			words[i] = group[i % 4];
+	}
+	else
+	{
+		// r210, big-endian 10-bit R G B
+		uint32_t	pixel = (level << 20) | (level << 10) | level;
+		uint8_t		bytes[4] = { (uint8_t)(pixel >> 24), (uint8_t)(pixel >> 16), (uint8_t)(pixel >> 8), (uint8_t)pixel };
+
+		for (size_t i = 0; i < size; i += 4)
+			memcpy(buffer.get() + i, bytes, 4);
+	}
+
+	return buffer;
+}
+
+SyncMeasurement::SyncMeasurement(int maxRollingSamples) :
+	m_format(),
+	m_flashPeriodFrames(1),
+	m_glassToGlassStatistics(maxRollingSamples),
+	m_stampToInputStatistics(maxRollingSamples),
+	m_flashLatencyStatistics(maxRollingSamples),
+	m_avOffsetStatistics(maxRollingSamples),
+	m_glassToGlassHistogram(kHistogramBinWidth, 0, kMaxGlassToGlassLatency),
+	m_avOffsetHistogram(kHistogramBinWidth, -kMaxAVOffset, kMaxAVOffset)
+{
+	reset();
+}
+
+bool SyncMeasurement::start(const SyncMeasurementFormat& format)
+{
+	com_ptr<IDeckLinkVideoFrameAncillaryPackets> ancillaryPackets;
+
+	if ((format.pixelFormat != bmdFormat10BitYUV) && (format.pixelFormat != bmdFormat10BitRGB))
+	{
+		fprintf(stderr, "Sync measurement needs 10-bit YUV or 10-bit RGB\n");
+		return false;
+	}
+
+	if ((format.audioSampleSize != 2) && (format.audioSampleSize != 4))
+		return false;
+
+	// Custom frames need a packet store from the API to carry the stamps
+	*ancillaryPackets.releaseAndGetAddressOf() = CreateVideoFrameAncillaryPacketsInstance();
+	if (!ancillaryPackets)
+	{
+		fprintf(stderr, "Could not create an ancillary packet store, the DeckLink drivers may be too old\n");
+		return false;
+	}
+
+	reset();
+
+	m_format			= format;
+	m_flashPeriodFrames	= std::max((uint64_t)1, (uint64_t)std::llround((double)format.frameTimescale / format.frameDuration));
+	m_blackFrameBuffer	= createFrameBuffer(format, kBlackLevel);
+	m_whiteFrameBuffer	= createFrameBuffer(format, kWhiteLevel);
+
+	return true;
+}
+
+void SyncMeasurement::reset()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_outputStartTimes.clear();
+		m_unmatchedInputTimes.clear();
+		m_flashOutputTimes.clear();
+		m_lastOutputStartTime	= 0;
+		m_lastFrameWhite		= false;
+		m_inBeep				= false;
+		m_quietSampleFrames		= 0;
+		m_flashPending			= false;
+		m_flashInputTime		= 0;
+		m_flashLatencyPending	= false;
+		m_flashInputStartTime	= 0;
+		m_beepPending			= false;
+		m_beepInputTime			= 0;
+		m_statistics			= SyncMeasurementStatistics();
+	}
+
+	m_glassToGlassStatistics.reset();
+	m_stampToInputStatistics.reset();
+	m_flashLatencyStatistics.reset();
+	m_avOffsetStatistics.reset();
+	m_glassToGlassHistogram.reset();
+	m_avOffsetHistogram.reset();
+}
+
+void SyncMeasurement::stampVideoFrame(std::shared_ptr<LoopThroughVideoFrame>& videoFrame)
+{
+	uint64_t										frameNumber = videoFrame->getVideoStreamTime() / videoFrame->getVideoFrameDuration();
+	bool											flash = isFlashFrame(frameNumber);
+	com_ptr<IDeckLinkVideoFrameAncillaryPackets>	ancillaryPackets;
+
+	*ancillaryPackets.releaseAndGetAddressOf() = CreateVideoFrameAncillaryPacketsInstance();
+	if (ancillaryPackets)
+	{
+		IDeckLinkAncillaryPacket* packet = new SyncStampPacket(frameNumber, ReferenceTime::getSteadyClockUptimeCount(), flash);
+
+		if (ancillaryPackets->AttachPacket(packet) != S_OK)
+		{
+			// The packet store didn't take ownership of the packet
+			packet->Release();
+		}
+	}
+
+	com_ptr<SyncVideoFrame> stampedFrame = make_com_ptr<SyncVideoFrame>(flash ? m_whiteFrameBuffer : m_blackFrameBuffer, m_format, ancillaryPackets);
+	videoFrame->setVideoFrame(com_ptr<IDeckLinkVideoFrame>(stampedFrame.get()));
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	++m_statistics.framesStamped;
+}
+
+void SyncMeasurement::fillAudioPacket(std::shared_ptr<LoopThroughAudioPacket>& audioPacket)
+{
+	long		sampleFrameCount = audioPacket->getSampleFrameCount();
+	size_t		sampleFrameSize = m_format.audioChannelCount * m_format.audioSampleSize;
+	uint8_t*	buffer = new uint8_t[sampleFrameCount * sampleFrameSize]();
+	int64_t		firstSample = (audioPacket->getAudioStreamTime() * kAudioSampleRate + m_format.frameTimescale / 2) / m_format.frameTimescale;
+
+	// The beep lasts for the flash frame, silence otherwise
+	for (long i = 0; i < sampleFrameCount; i++)
+	{
+		int64_t		sample = firstSample + i;
+		uint64_t	frameNumber = (uint64_t)((sample * m_format.frameTimescale) / ((int64_t)kAudioSampleRate * m_format.frameDuration));
+
+		if (!isFlashFrame(frameNumber))
+			continue;
+
+		// Starting at its peak, the beep is found on its first sample
+		double		phase = 2.0 * M_PI * (double)((sample * kBeepFrequency) % kAudioSampleRate) / kAudioSampleRate;
+		int32_t		value = (int32_t)(std::cos(phase) * kBeepLevel * INT32_MAX);
+		uint8_t*	sampleFrame = buffer + i * sampleFrameSize;
+
+		for (uint32_t channel = 0; channel < m_format.audioChannelCount; channel++)
+		{
+			if (m_format.audioSampleSize == 4)
+				((int32_t*)sampleFrame)[channel] = value;
+			else
+				((int16_t*)sampleFrame)[channel] = (int16_t)(value >> 16);
+		}
+	}
+
+	audioPacket->setAudioPacket(buffer, sampleFrameCount, [buffer]() { delete [] buffer; });
+}
+
+void SyncMeasurement::frameOutput(const std::shared_ptr<LoopThroughVideoFrame>& videoFrame)
+{
+	BMDOutputFrameCompletionResult	result = videoFrame->getOutputCompletionResult();
+	uint64_t						frameNumber = videoFrame->getVideoStreamTime() / videoFrame->getVideoFrameDuration();
+	BMDTimeValue					outputStartTime = videoFrame->getOutputFrameCompletedReferenceTime();
+
+	if ((result != bmdOutputFrameCompleted) && (result != bmdOutputFrameDisplayedLate))
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_lastOutputStartTime = outputStartTime;
+
+	if (isFlashFrame(frameNumber))
+	{
+		++m_statistics.flashesOutput;
+		m_flashOutputTimes.push_back(outputStartTime);
+		if (m_flashOutputTimes.size() > kMaxFlashOutputTimes)
+			m_flashOutputTimes.pop_front();
+	}
+
+	// With little latency the frame can be captured before its output completes
+	auto inputIter = m_unmatchedInputTimes.find(frameNumber);
+	if (inputIter != m_unmatchedInputTimes.end())
+	{
+		addGlassToGlassLatency(inputIter->second - outputStartTime);
+		m_unmatchedInputTimes.erase(inputIter);
+	}
+	else
+	{
+		m_outputStartTimes[frameNumber] = outputStartTime;
+	}
+
+	expireOutputTimes(frameNumber);
+	matchFlashLatency();
+}
+
+void SyncMeasurement::analyzeVideoFrame(const std::shared_ptr<LoopThroughVideoFrame>& videoFrame)
+{
+	com_ptr<IDeckLinkVideoFrame>					inputFrame(videoFrame->getVideoFramePtr());
+	com_ptr<IDeckLinkVideoFrameAncillaryPackets>	ancillaryPackets(IID_IDeckLinkVideoFrameAncillaryPackets, inputFrame);
+	com_ptr<IDeckLinkAncillaryPacket>				packet;
+	BMDTimeValue									inputStartTime = videoFrame->getInputFrameStartReferenceTime();
+	uint64_t										frameNumber = 0;
+	BMDTimeValue									stampTime = 0;
+	bool											stamped = false;
+	bool											white = isWhiteFrame(inputFrame.get());
+
+	if (ancillaryPackets && (ancillaryPackets->GetFirstPacketByID(kStampDID, kStampSDID, packet.releaseAndGetAddressOf()) == S_OK))
+		stamped = decodeStamp(packet.get(), frameNumber, stampTime);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (stamped)
+	{
+		++m_statistics.stampsDecoded;
+		m_stampToInputStatistics.addSample(inputStartTime - stampTime);
+
+		auto outputIter = m_outputStartTimes.find(frameNumber);
+		if (outputIter != m_outputStartTimes.end())
+		{
+			addGlassToGlassLatency(inputStartTime - outputIter->second);
+			m_outputStartTimes.erase(outputIter);
+		}
+		else
+		{
+			m_unmatchedInputTimes[frameNumber] = inputStartTime;
+		}
+	}
+	else
+	{
+		++m_statistics.framesWithoutStamp;
+	}
+
+	if (white && !m_lastFrameWhite)
+	{
+		++m_statistics.flashesDetected;
+
+		m_flashPending			= true;
+		m_flashInputTime		= streamTimeToReferenceTicks(videoFrame->getVideoStreamTime());
+		m_flashLatencyPending	= true;
+		m_flashInputStartTime	= inputStartTime;
+
+		matchFlashLatency();
+		matchFlashAndBeep();
+	}
+	m_lastFrameWhite = white;
+}
+
+void SyncMeasurement::analyzeAudioPacket(const std::shared_ptr<LoopThroughAudioPacket>& audioPacket)
+{
+	const uint8_t*	buffer = (const uint8_t*)audioPacket->getBuffer();
+	long			sampleFrameCount = audioPacket->getSampleFrameCount();
+	size_t			sampleFrameSize = m_format.audioChannelCount * m_format.audioSampleSize;
+	BMDTimeValue	packetTime = streamTimeToReferenceTicks(audioPacket->getAudioStreamTime());
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// The beep is found on the first channel
+	for (long i = 0; i < sampleFrameCount; i++)
+	{
+		const uint8_t*	sampleFrame = buffer + i * sampleFrameSize;
+		int64_t			sample;
+
+		if (m_format.audioSampleSize == 4)
+			sample = *(const int32_t*)sampleFrame;
+		else
+			sample = (int64_t)*(const int16_t*)sampleFrame << 16;
+
+		if (std::llabs(sample) >= kBeepThreshold)
+		{
+			if (!m_inBeep)
+			{
+				++m_statistics.beepsDetected;
+
+				m_inBeep		= true;
+				m_beepPending	= true;
+				m_beepInputTime	= packetTime + (BMDTimeValue)i * ReferenceTime::kTimescale / kAudioSampleRate;
+
+				matchFlashAndBeep();
+			}
+			m_quietSampleFrames = 0;
+		}
+		else if (m_inBeep && (++m_quietSampleFrames >= kBeepQuietSampleFrames))
+		{
+			m_inBeep = false;
+		}
+	}
+}
+
+void SyncMeasurement::getStatistics(SyncMeasurementStatistics& statistics)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	statistics = m_statistics;
+}
+
+bool SyncMeasurement::isWhiteFrame(IDeckLinkVideoFrame* videoFrame) const
+{
+	uint8_t*		bytes;
+	long			width = videoFrame->GetWidth();
+	long			height = videoFrame->GetHeight();
+	long			rowBytes = videoFrame->GetRowBytes();
+	BMDPixelFormat	pixelFormat = videoFrame->GetPixelFormat();
+	uint64_t		levelSum = 0;
+	uint64_t		levelCount = 0;
+
+	if ((videoFrame->GetBytes((void**)&bytes) != S_OK) || (bytes == nullptr))
+		return false;
+
+	// Sample the centre of the picture, luma for YUV or green for RGB
+	for (long y = height / 4; y < height * 3 / 4; y += kLumaSampleRowStep)
+	{
+		const uint8_t* row = bytes + y * rowBytes;
+
+		if (pixelFormat == bmdFormat10BitYUV)
+		{
+			const uint32_t* groups = (const uint32_t*)row;
+
+			for (long group = width / 24; group < width / 8; group++)
+				levelSum += groups[group * 4 + 1] & 0x3ff;
+			levelCount += width / 8 - width / 24;
+		}
+		else if (pixelFormat == bmdFormat10BitRGB)
+		{
+			for (long x = width / 4; x < width * 3 / 4; x++)
+			{
+				const uint8_t*	pixel = row + x * 4;
+				uint32_t		value = ((uint32_t)pixel[0] << 24) | ((uint32_t)pixel[1] << 16) | ((uint32_t)pixel[2] << 8) | pixel[3];
+
+				levelSum += (value >> 10) & 0x3ff;
+			}
+			levelCount += width * 3 / 4 - width / 4;
+		}
+	}
+
+	return (levelCount > 0) && (levelSum / levelCount >= kFlashThreshold);
+}
+
+void SyncMeasurement::addGlassToGlassLatency(BMDTimeValue latency)
+{
+	m_glassToGlassStatistics.addSample(latency);
+	m_glassToGlassHistogram.addSample(latency);
+}
+
+void SyncMeasurement::matchFlashLatency()
+{
+	// Completions arrive in order, once a later frame has completed the flash that was
+	// captured has been output, the latest flash output before it is the one captured
+	if (!m_flashLatencyPending || (m_lastOutputStartTime <= m_flashInputStartTime))
+		return;
+
+	for (auto iter = m_flashOutputTimes.rbegin(); iter != m_flashOutputTimes.rend(); ++iter)
+	{
+		if (*iter <= m_flashInputStartTime)
+		{
+			m_flashLatencyStatistics.addSample(m_flashInputStartTime - *iter);
+			break;
+		}
+	}
+
+	m_flashLatencyPending = false;
+}
+
+void SyncMeasurement::matchFlashAndBeep()
+{
+	BMDTimeValue halfPeriod = streamTimeToReferenceTicks(m_flashPeriodFrames * m_format.frameDuration) / 2;
+
+	if (!m_flashPending || !m_beepPending)
+		return;
+
+	BMDTimeValue offset = m_beepInputTime - m_flashInputTime;
+
+	if (std::llabs(offset) < halfPeriod)
+	{
+		m_avOffsetStatistics.addSample(offset);
+		m_avOffsetHistogram.addSample(offset);
+		m_flashPending	= false;
+		m_beepPending	= false;
+	}
+	else if (offset > 0)
+	{
+		// Flash without a beep
+		m_flashPending = false;
+	}
+	else
+	{
+		// Beep without a flash
+		m_beepPending = false;
+	}
+}
+
+void SyncMeasurement::expireOutputTimes(uint64_t frameNumber)
+{
+	uint64_t window = kMatchWindowSeconds * m_flashPeriodFrames;
+
+	if (frameNumber < window)
+		return;
+
+	while (!m_outputStartTimes.empty() && (m_outputStartTimes.begin()->first < frameNumber - window))
+	{
+		++m_statistics.stampsLost;
+		m_outputStartTimes.erase(m_outputStartTimes.begin());
+	}
+
+	// Captured frames whose output was dropped or flushed
+	while (!m_unmatchedInputTimes.empty() && (m_unmatchedInputTimes.begin()->first < frameNumber - window))
+		m_unmatchedInputTimes.erase(m_unmatchedInputTimes.begin());
+}
+
+BMDTimeValue SyncMeasurement::streamTimeToReferenceTicks(BMDTimeValue streamTime) const
+{
+	return streamTime * ReferenceTime::kTimescale / m_format.frameTimescale;
+}
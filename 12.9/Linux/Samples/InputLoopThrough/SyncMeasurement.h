@@ -0,0 +1,157 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "DeckLinkAPI.h"
+#include "LatencyHistogram.h"
+#include "LatencyStatistics.h"
+#include "LoopThroughAudioPacket.h"
+#include "LoopThroughVideoFrame.h"
+#include "com_ptr.h"
+
+// Format of the loop-through while measuring
+struct SyncMeasurementFormat
+{
+	long			width;
+	long			height;
+	long			rowBytes;
+	BMDPixelFormat	pixelFormat;
+	BMDTimeValue	frameDuration;
+	BMDTimeScale	frameTimescale;
+	uint32_t		audioChannelCount;
+	uint32_t		audioSampleSize;		// bytes per sample of one channel
+};
+
+struct SyncMeasurementStatistics
+{
+	uint64_t		framesStamped;
+	uint64_t		stampsDecoded;
+	uint64_t		framesWithoutStamp;		// input frames without a stamp packet
+	uint64_t		stampsLost;				// frames output whose stamp never came back
+	uint64_t		flashesOutput;
+	uint64_t		flashesDetected;
+	uint64_t		beepsDetected;
+};
+
+// Measures the equipment connected between the output and the input, from the output
+// connector to the input connector.
+//
+// Every output frame is replaced by a test frame carrying a stamp in a VANC packet: its
+// frame number and the reference time it was stamped.  Once a second the frame is white
+// instead of black, and the audio of that frame is a 1 kHz beep instead of silence.
+//
+// On input, a decoded frame number is matched with the time that frame started on the
+// output wire, reported by its completion, to give the glass-to-glass latency.  The stamp
+// time gives the latency from the application to the input, including the output preroll.
+// Flashes and beeps are found in the picture and sound rather than the VANC, so they also
+// measure equipment that drops ancillary data: the flash latency, and the A/V offset as
+// the time from the start of a flash to the start of its beep on the input timeline.
+class SyncMeasurement
+{
+public:
+	SyncMeasurement(int maxRollingSamples);
+	virtual ~SyncMeasurement() = default;
+
+	// Only 10-bit YUV and 10-bit RGB, the formats captured by DeckLinkInputDevice
+	bool					start(const SyncMeasurementFormat& format);
+	void					reset(void);
+
+	// Output path, replaces the contents of the loop-through
+	void					stampVideoFrame(std::shared_ptr<LoopThroughVideoFrame>& videoFrame);
+	void					fillAudioPacket(std::shared_ptr<LoopThroughAudioPacket>& audioPacket);
+	void					frameOutput(const std::shared_ptr<LoopThroughVideoFrame>& videoFrame);
+
+	// Input path, before the contents are replaced
+	void					analyzeVideoFrame(const std::shared_ptr<LoopThroughVideoFrame>& videoFrame);
+	void					analyzeAudioPacket(const std::shared_ptr<LoopThroughAudioPacket>& audioPacket);
+
+	// Latencies and offsets are in ReferenceTime ticks
+	LatencyStatistics&		getGlassToGlassStatistics(void) { return m_glassToGlassStatistics; }
+	LatencyStatistics&		getStampToInputStatistics(void) { return m_stampToInputStatistics; }
+	LatencyStatistics&		getFlashLatencyStatistics(void) { return m_flashLatencyStatistics; }
+	LatencyStatistics&		getAVOffsetStatistics(void) { return m_avOffsetStatistics; }
+	LatencyHistogram&		getGlassToGlassHistogram(void) { return m_glassToGlassHistogram; }
+	LatencyHistogram&		getAVOffsetHistogram(void) { return m_avOffsetHistogram; }
+
+	void					getStatistics(SyncMeasurementStatistics& statistics);
+
+private:
+	SyncMeasurementFormat				m_format;
+	uint64_t							m_flashPeriodFrames;
+	std::shared_ptr<uint8_t>			m_blackFrameBuffer;
+	std::shared_ptr<uint8_t>			m_whiteFrameBuffer;
+	//
+	std::mutex							m_mutex;
+	std::map<uint64_t, BMDTimeValue>	m_outputStartTimes;		// frame number to start on the output wire
+	std::map<uint64_t, BMDTimeValue>	m_unmatchedInputTimes;	// decoded before the output completed
+	std::deque<BMDTimeValue>			m_flashOutputTimes;
+	BMDTimeValue						m_lastOutputStartTime;
+	bool								m_lastFrameWhite;
+	bool								m_inBeep;
+	uint32_t							m_quietSampleFrames;
+	bool								m_flashPending;
+	BMDTimeValue						m_flashInputTime;		// input stream time, in ReferenceTime ticks
+	bool								m_flashLatencyPending;
+	BMDTimeValue						m_flashInputStartTime;
+	bool								m_beepPending;
+	BMDTimeValue						m_beepInputTime;
+	SyncMeasurementStatistics			m_statistics;
+	//
+	LatencyStatistics					m_glassToGlassStatistics;
+	LatencyStatistics					m_stampToInputStatistics;
+	LatencyStatistics					m_flashLatencyStatistics;
+	LatencyStatistics					m_avOffsetStatistics;
+	LatencyHistogram					m_glassToGlassHistogram;
+	LatencyHistogram					m_avOffsetHistogram;
+
+	bool			isFlashFrame(uint64_t frameNumber) const { return (frameNumber % m_flashPeriodFrames) == 0; }
+	bool			isWhiteFrame(IDeckLinkVideoFrame* videoFrame) const;
+	void			addGlassToGlassLatency(BMDTimeValue latency);
+	void			matchFlashLatency(void);
+	void			matchFlashAndBeep(void);
+	void			expireOutputTimes(uint64_t frameNumber);
+	BMDTimeValue	streamTimeToReferenceTicks(BMDTimeValue streamTime) const;
+};
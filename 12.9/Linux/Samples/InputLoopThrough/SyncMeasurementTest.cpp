@@ -0,0 +1,336 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+
+// Checks SyncMeasurement against a simulated loopback.  Stamped output frames and their
+// audio are fed back as input after a known delay, as the equipment between the output
+// and the input connectors would, and the measured glass-to-glass latency, flash latency
+// and A/V offset are compared with the simulated ones.  Runs without the DeckLink
+// drivers.  Build and run with "make check".
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "platform.h"
+#include "ReferenceTime.h"
+#include "SyncMeasurement.h"
+
+namespace
+{
+	const BMDTimeValue	kFrameDuration		= 1000;
+	const BMDTimeScale	kFrameTimescale		= 30000;
+	const long			kSamplesPerFrame	= 1600;		// 48kHz at 30 fps
+	const uint32_t		kChannelCount		= 2;
+	const long			kWidth				= 1920;
+	const long			kHeight				= 1080;
+	const int			kLoopbackFrames		= 3;		// Frames between output and input stream times
+	const BMDTimeValue	kOutputStartTime	= 1000000;
+	// One audio sample, in ReferenceTime ticks, the resolution of the beep detection
+	const BMDTimeValue	kAVOffsetTolerance	= ReferenceTime::kTimescale / 48000 + 1;
+
+	// Stand-in for the API's ancillary packet store, which needs the drivers
+	class AncillaryPacketStore : public IDeckLinkVideoFrameAncillaryPackets
+	{
+	public:
+		AncillaryPacketStore() : m_refCount(1) {}
+		virtual ~AncillaryPacketStore()
+		{
+			for (IDeckLinkAncillaryPacket* packet : m_packets)
+				packet->Release();
+		}
+
+		HRESULT	QueryInterface(REFIID, LPVOID* ppv) override { *ppv = nullptr; return E_NOINTERFACE; }
+		ULONG	AddRef() override { return ++m_refCount; }
+		ULONG	Release() override
+		{
+			ULONG newRefValue = --m_refCount;
+			if (newRefValue == 0)
+				delete this;
+			return newRefValue;
+		}
+
+		HRESULT	GetPacketIterator(IDeckLinkAncillaryPacketIterator**) override { return E_NOTIMPL; }
+		HRESULT	GetFirstPacketByID(uint8_t DID, uint8_t SDID, IDeckLinkAncillaryPacket** packet) override
+		{
+			for (IDeckLinkAncillaryPacket* candidate : m_packets)
+			{
+				if (candidate->GetDID() == DID && candidate->GetSDID() == SDID)
+				{
+					candidate->AddRef();
+					*packet = candidate;
+					return S_OK;
+				}
+			}
+			return S_FALSE;
+		}
+		HRESULT	AttachPacket(IDeckLinkAncillaryPacket* packet) override { m_packets.push_back(packet); return S_OK; }
+		HRESULT	DetachPacket(IDeckLinkAncillaryPacket*) override { return E_NOTIMPL; }
+		HRESULT	DetachAllPackets() override { return E_NOTIMPL; }
+
+	private:
+		std::atomic<ULONG>						m_refCount;
+		std::vector<IDeckLinkAncillaryPacket*>	m_packets;
+	};
+
+	// Input frame from equipment that does not pass ancillary data
+	class StrippedVideoFrame : public IDeckLinkVideoFrame
+	{
+	public:
+		StrippedVideoFrame(IDeckLinkVideoFrame* videoFrame) : m_videoFrame(videoFrame), m_refCount(1) {}
+		virtual ~StrippedVideoFrame() = default;
+
+		HRESULT			QueryInterface(REFIID, LPVOID* ppv) override { *ppv = nullptr; return E_NOINTERFACE; }
+		ULONG			AddRef() override { return ++m_refCount; }
+		ULONG			Release() override
+		{
+			ULONG newRefValue = --m_refCount;
+			if (newRefValue == 0)
+				delete this;
+			return newRefValue;
+		}
+
+		long			GetWidth() override { return m_videoFrame->GetWidth(); }
+		long			GetHeight() override { return m_videoFrame->GetHeight(); }
+		long			GetRowBytes() override { return m_videoFrame->GetRowBytes(); }
+		BMDPixelFormat	GetPixelFormat() override { return m_videoFrame->GetPixelFormat(); }
+		BMDFrameFlags	GetFlags() override { return bmdFrameFlagDefault; }
+		HRESULT			GetBytes(void** buffer) override { return m_videoFrame->GetBytes(buffer); }
+		HRESULT			GetTimecode(BMDTimecodeFormat, IDeckLinkTimecode**) override { return E_NOTIMPL; }
+		HRESULT			GetAncillaryData(IDeckLinkVideoFrameAncillary**) override { return E_NOTIMPL; }
+
+	private:
+		com_ptr<IDeckLinkVideoFrame>	m_videoFrame;
+		std::atomic<ULONG>				m_refCount;
+	};
+
+	struct Loopback
+	{
+		const char*		name;
+		BMDPixelFormat	pixelFormat;
+		bool			stripsAncillaryData;
+		BMDTimeValue	glassToGlassLatency;	// From output start to input start, in ReferenceTime ticks
+		long			audioDelaySamples;		// Audio delay relative to video, negative if audio leads
+		BMDTimeValue	inputCallbackDelay;		// From the end of an input frame to its callback
+		int				frameCount;
+	};
+
+	struct Event
+	{
+		BMDTimeValue			time;
+		std::function<void()>	action;
+	};
+
+	BMDTimeValue outputStartTime(int frame)
+	{
+		return kOutputStartTime + (BMDTimeValue)frame * kFrameDuration * ReferenceTime::kTimescale / kFrameTimescale;
+	}
+
+	bool check(bool condition, const char* description, std::vector<const char*>& failures)
+	{
+		if (!condition)
+			failures.push_back(description);
+		return condition;
+	}
+
+	bool isAll(LatencyStatistics& statistics, BMDTimeValue expected, BMDTimeValue tolerance)
+	{
+		return statistics.getMinimum() >= expected - tolerance && statistics.getMaximum() <= expected + tolerance;
+	}
+
+	bool runLoopback(const Loopback& loopback)
+	{
+		SyncMeasurement				syncMeasurement(300);
+		SyncMeasurementFormat		format;
+		std::vector<int32_t>		outputAudio((size_t)loopback.frameCount * kSamplesPerFrame * kChannelCount, 0);
+		std::vector<std::shared_ptr<LoopThroughVideoFrame>>	outputFrames(loopback.frameCount);
+		std::vector<Event>			events;
+		std::vector<const char*>	failures;
+
+		format.width			= kWidth;
+		format.height			= kHeight;
+		format.rowBytes			= (loopback.pixelFormat == bmdFormat10BitYUV) ? ((kWidth + 47) / 48) * 128 : ((kWidth + 63) / 64) * 256;
+		format.pixelFormat		= loopback.pixelFormat;
+		format.frameDuration	= kFrameDuration;
+		format.frameTimescale	= kFrameTimescale;
+		format.audioChannelCount = kChannelCount;
+		format.audioSampleSize	= sizeof(int32_t);
+
+		if (!syncMeasurement.start(format))
+		{
+			printf("FAIL   %s: could not start\n", loopback.name);
+			return false;
+		}
+
+		// Output path: stamp every frame and complete it when the next one starts on the wire
+		for (int frame = 0; frame < loopback.frameCount; frame++)
+		{
+			auto videoFrame = std::make_shared<LoopThroughVideoFrame>(com_ptr<IDeckLinkVideoFrame>());
+			videoFrame->setVideoStreamTime((BMDTimeValue)frame * kFrameDuration);
+			videoFrame->setVideoFrameDuration(kFrameDuration);
+			syncMeasurement.stampVideoFrame(videoFrame);
+			videoFrame->setOutputCompletionResult(bmdOutputFrameCompleted);
+			videoFrame->setOutputFrameCompletedReferenceTime(outputStartTime(frame));
+			outputFrames[frame] = videoFrame;
+
+			auto audioPacket = std::make_shared<LoopThroughAudioPacket>(nullptr, kSamplesPerFrame);
+			audioPacket->setAudioStreamTime((BMDTimeValue)frame * kFrameDuration);
+			syncMeasurement.fillAudioPacket(audioPacket);
+			memcpy(&outputAudio[(size_t)frame * kSamplesPerFrame * kChannelCount], audioPacket->getBuffer(), kSamplesPerFrame * kChannelCount * sizeof(int32_t));
+
+			events.push_back({ outputStartTime(frame + 1), [&syncMeasurement, videoFrame] { syncMeasurement.frameOutput(videoFrame); } });
+		}
+
+		// Input path: frame n is output frame n - kLoopbackFrames, started glassToGlassLatency
+		// after it started on the output.  Audio runs from the start of the input stream, so
+		// a beep that leads its flash is not cut off.
+		for (int frame = 0; frame < loopback.frameCount; frame++)
+		{
+			int										outputFrame = frame - kLoopbackFrames;
+			BMDTimeValue							inputStartTime = outputStartTime(outputFrame) + loopback.glassToGlassLatency;
+			std::shared_ptr<LoopThroughVideoFrame>	videoFrame;
+
+			if (outputFrame >= 0)
+			{
+				com_ptr<IDeckLinkVideoFrame> inputFrame(outputFrames[outputFrame]->getVideoFramePtr());
+				com_ptr<StrippedVideoFrame> strippedFrame;
+				if (loopback.stripsAncillaryData)
+					strippedFrame = make_com_ptr<StrippedVideoFrame>(inputFrame.get());
+
+				if (strippedFrame)
+					videoFrame = std::make_shared<LoopThroughVideoFrame>(com_ptr<IDeckLinkVideoFrame>(strippedFrame.get()));
+				else
+					videoFrame = std::make_shared<LoopThroughVideoFrame>(inputFrame);
+				videoFrame->setVideoStreamTime((BMDTimeValue)frame * kFrameDuration);
+				videoFrame->setVideoFrameDuration(kFrameDuration);
+				videoFrame->setInputFrameStartReferenceTime(inputStartTime);
+			}
+
+			auto inputAudio = std::make_shared<std::vector<int32_t>>(kSamplesPerFrame * kChannelCount, 0);
+			for (long i = 0; i < kSamplesPerFrame; i++)
+			{
+				long sample = (long)outputFrame * kSamplesPerFrame + i - loopback.audioDelaySamples;
+				if (sample >= 0 && sample < (long)loopback.frameCount * kSamplesPerFrame)
+					memcpy(&(*inputAudio)[i * kChannelCount], &outputAudio[sample * kChannelCount], kChannelCount * sizeof(int32_t));
+			}
+			auto audioPacket = std::make_shared<LoopThroughAudioPacket>(inputAudio->data(), kSamplesPerFrame, [inputAudio] {});
+			audioPacket->setAudioStreamTime((BMDTimeValue)frame * kFrameDuration);
+
+			events.push_back({ inputStartTime + outputStartTime(1) - outputStartTime(0) + loopback.inputCallbackDelay,
+				[&syncMeasurement, videoFrame, audioPacket] {
+					if (videoFrame)
+						syncMeasurement.analyzeVideoFrame(videoFrame);
+					syncMeasurement.analyzeAudioPacket(audioPacket);
+				} });
+		}
+
+		std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.time < b.time; });
+		for (const Event& event : events)
+			event.action();
+
+		SyncMeasurementStatistics	statistics;
+		uint64_t					inputFrames = loopback.frameCount - kLoopbackFrames;
+		BMDTimeValue				avOffset = (BMDTimeValue)loopback.audioDelaySamples * ReferenceTime::kTimescale / 48000;
+
+		syncMeasurement.getStatistics(statistics);
+
+		check(statistics.framesStamped == (uint64_t)loopback.frameCount, "every output frame is stamped", failures);
+		check(statistics.flashesOutput > 0 && statistics.flashesDetected == statistics.flashesOutput, "every flash is detected", failures);
+		check(statistics.beepsDetected == statistics.flashesOutput, "every beep is detected", failures);
+		check(isAll(syncMeasurement.getFlashLatencyStatistics(), loopback.glassToGlassLatency, 0), "flash latency is the loopback latency", failures);
+		check(isAll(syncMeasurement.getAVOffsetStatistics(), avOffset, kAVOffsetTolerance), "A/V offset is the loopback audio delay", failures);
+		check(syncMeasurement.getAVOffsetHistogram().getSampleCount() == statistics.beepsDetected, "every A/V offset is in the histogram", failures);
+
+		if (loopback.stripsAncillaryData)
+		{
+			check(statistics.stampsDecoded == 0 && statistics.framesWithoutStamp == inputFrames, "no stamps pass equipment that strips VANC", failures);
+			check(syncMeasurement.getGlassToGlassHistogram().getSampleCount() == 0, "no glass-to-glass latency without stamps", failures);
+		}
+		else
+		{
+			check(statistics.stampsDecoded == inputFrames && statistics.framesWithoutStamp == 0, "every input frame has a stamp", failures);
+			check(statistics.stampsLost == 0, "no stamp is lost", failures);
+			check(isAll(syncMeasurement.getGlassToGlassStatistics(), loopback.glassToGlassLatency, 0), "glass-to-glass latency is the loopback latency", failures);
+			check(syncMeasurement.getGlassToGlassHistogram().getSampleCount() == inputFrames, "every glass-to-glass latency is in the histogram", failures);
+		}
+
+		printf("%-6s %s\n", failures.empty() ? "PASS" : "FAIL", loopback.name);
+		for (const char* failure : failures)
+			printf("         expected %s\n", failure);
+
+		return failures.empty();
+	}
+}
+
+// The test never creates a DeckLink iterator, which platform.cpp wraps
+IDeckLinkIterator* CreateDeckLinkIteratorInstance(void)
+{
+	return nullptr;
+}
+
+IDeckLinkVideoFrameAncillaryPackets* CreateVideoFrameAncillaryPacketsInstance(void)
+{
+	return new AncillaryPacketStore();
+}
+
+int main(void)
+{
+	const Loopback loopbacks[] =
+	{
+		{ "v210, 101.234 ms, audio 20 ms late",			bmdFormat10BitYUV,	false,	101234,	960,	700,	600 },
+		{ "r210, 5 ms, audio 10 ms early",				bmdFormat10BitRGB,	false,	5000,	-480,	700,	600 },
+		{ "v210, 250 ms, VANC stripped",				bmdFormat10BitYUV,	true,	250000,	0,		700,	600 },
+		{ "v210, input callback before output completion",	bmdFormat10BitYUV,	false,	500,	0,		-2000,	300 },
+	};
+	int failures = 0;
+
+	for (const Loopback& loopback : loopbacks)
+	{
+		if (!runLoopback(loopback))
+			failures++;
+	}
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
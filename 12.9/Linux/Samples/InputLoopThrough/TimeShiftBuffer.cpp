@@ -0,0 +1,852 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#include "TimeShiftBuffer.h"
+#include "FrameTrace.h"
+#include "ReferenceTime.h"
+#include "platform.h"
+
+// O_DIRECT transfers must be aligned in memory and on disk, the superblock and each
+// area of a slot are whole blocks
+static const size_t		kBlockSize			= 4096;
+static const char		kSuperblockMagic[8]	= { 'B', 'M', 'D', 'T', 'S', 'R', 'N', 'G' };
+static const uint32_t	kSuperblockVersion	= 1;
+static const uint32_t	kSlotMagic			= 0x544c5354;	// "TSLT"
+
+static const uint32_t	kWriteQueueDepth	= 4;		// frames waiting for the disk before input frames are dropped
+static const auto		kSyncInterval		= std::chrono::seconds(1);
+
+struct TimeShiftSuperblock
+{
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	checksum;
+	uint64_t	ringID;
+	uint64_t	slotSize;
+	uint64_t	slotCount;
+	int64_t		width;
+	int64_t		height;
+	int64_t		rowBytes;
+	int64_t		frameDuration;
+	int64_t		frameTimescale;
+	uint32_t	pixelFormat;
+	uint32_t	audioChannelCount;
+	uint32_t	audioSampleSize;
+	uint32_t	maxAudioSampleFrames;
+	uint32_t	delayFrames;
+	uint32_t	reserved;
+};
+
+struct TimeShiftSlotHeader
+{
+	uint32_t	magic;
+	uint32_t	checksum;
+	uint64_t	ringID;
+	uint64_t	sequence;
+	int64_t		streamTime;
+	uint32_t	videoBytes;
+	uint32_t	audioSampleFrames;
+};
+
+// Last bytes of the slot, a slot interrupted part way through keeps an older footer
+struct TimeShiftSlotFooter
+{
+	uint64_t	ringID;
+	uint64_t	sequence;
+};
+
+static size_t roundUpToBlock(size_t size)
+{
+	return (size + kBlockSize - 1) / kBlockSize * kBlockSize;
+}
+
+// FNV-1a over a structure whose checksum field is zero
+static uint32_t checksumOf(const void* data, size_t size)
+{
+	const uint8_t*	bytes = (const uint8_t*)data;
+	uint32_t		hash = 2166136261u;
+
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ bytes[i]) * 16777619u;
+
+	return hash;
+}
+
+static uint32_t superblockChecksum(TimeShiftSuperblock superblock)
+{
+	superblock.checksum = 0;
+	return checksumOf(&superblock, sizeof(superblock));
+}
+
+static uint32_t slotHeaderChecksum(TimeShiftSlotHeader header)
+{
+	header.checksum = 0;
+	return checksumOf(&header, sizeof(header));
+}
+
+static uint8_t* allocateAligned(size_t size)
+{
+	void* buffer = nullptr;
+
+	if (posix_memalign(&buffer, kBlockSize, size) != 0)
+		return nullptr;
+
+	memset(buffer, 0, size);
+	return (uint8_t*)buffer;
+}
+
+// Fixed set of read buffers shared by the video frame and audio packet read from one slot.
+// A buffer returns to the pool when the last of them is released, after the buffer itself
+// has been released if the pool is destroyed first.
+class TimeShiftBuffer::BufferPool : public std::enable_shared_from_this<BufferPool>
+{
+public:
+	BufferPool() = default;
+
+	~BufferPool()
+	{
+		for (auto buffer : m_buffers)
+			free(buffer);
+	}
+
+	bool allocate(size_t bufferSize, uint32_t bufferCount)
+	{
+		for (uint32_t i = 0; i < bufferCount; i++)
+		{
+			uint8_t* buffer = allocateAligned(bufferSize);
+			if (!buffer)
+				return false;
+
+			m_buffers.push_back(buffer);
+			m_freeBuffers.push_back(buffer);
+		}
+		return true;
+	}
+
+	std::shared_ptr<uint8_t> acquire(void)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (m_freeBuffers.empty())
+			return nullptr;
+
+		uint8_t* buffer = m_freeBuffers.back();
+		m_freeBuffers.pop_back();
+
+		auto pool = shared_from_this();
+		return std::shared_ptr<uint8_t>(buffer, [pool](uint8_t* released) {
+			std::lock_guard<std::mutex> lock(pool->m_mutex);
+			pool->m_freeBuffers.push_back(released);
+		});
+	}
+
+private:
+	std::mutex				m_mutex;
+	std::vector<uint8_t*>	m_buffers;
+	std::vector<uint8_t*>	m_freeBuffers;
+};
+
+// Video frame read back from the ring, played directly from its read buffer
+class TimeShiftVideoFrame : public IDeckLinkVideoFrame
+{
+public:
+	TimeShiftVideoFrame(std::shared_ptr<uint8_t> buffer, const TimeShiftFormat& format) :
+		m_refCount(1),
+		m_buffer(buffer),
+		m_format(format)
+	{ }
+	virtual ~TimeShiftVideoFrame() = default;
+
+	// IUnknown interface
+	HRESULT	STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override
+	{
+		if (ppv == nullptr)
+			return E_INVALIDARG;
+
+		if ((iid == IID_IUnknown) || (iid == IID_IDeckLinkVideoFrame))
+		{
+			*ppv = (IDeckLinkVideoFrame*)this;
+			AddRef();
+			return S_OK;
+		}
+
+		*ppv = nullptr;
+		return E_NOINTERFACE;
+	}
+
+	ULONG	STDMETHODCALLTYPE AddRef() override { return ++m_refCount; }
+
+	ULONG	STDMETHODCALLTYPE Release() override
+	{
+		ULONG newRefValue = --m_refCount;
+
+		if (newRefValue == 0)
+			delete this;
+
+		return newRefValue;
+	}
+
+	// IDeckLinkVideoFrame interface
+	long			STDMETHODCALLTYPE GetWidth() override { return m_format.width; }
+	long			STDMETHODCALLTYPE GetHeight() override { return m_format.height; }
+	long			STDMETHODCALLTYPE GetRowBytes() override { return m_format.rowBytes; }
+	BMDPixelFormat	STDMETHODCALLTYPE GetPixelFormat() override { return m_format.pixelFormat; }
+	BMDFrameFlags	STDMETHODCALLTYPE GetFlags() override { return bmdFrameFlagDefault; }
+	HRESULT			STDMETHODCALLTYPE GetBytes(void** buffer) override { *buffer = m_buffer.get(); return S_OK; }
+	HRESULT			STDMETHODCALLTYPE GetTimecode(BMDTimecodeFormat format, IDeckLinkTimecode** timecode) override { return E_NOTIMPL; }
+	HRESULT			STDMETHODCALLTYPE GetAncillaryData(IDeckLinkVideoFrameAncillary** ancillary) override { return E_NOTIMPL; }
+
+private:
+	std::atomic<ULONG>			m_refCount;
+	std::shared_ptr<uint8_t>	m_buffer;
+	TimeShiftFormat				m_format;
+};
+
+TimeShiftBuffer::TimeShiftBuffer(const std::string& path, double capacitySeconds, uint32_t readBufferCount) :
+	m_path(path),
+	m_capacitySeconds(capacitySeconds),
+	m_slotCount(0),
+	m_readBufferCount(readBufferCount),
+	m_format(),
+	m_ringID(0),
+	m_videoAreaSize(0),
+	m_audioAreaSize(0),
+	m_slotSize(0),
+	m_maxAudioSampleFrames(0),
+	m_directIO(false),
+	m_writeFd(-1),
+	m_readFd(-1),
+	m_delayFrames(0),
+	m_resumedFrameCount(0),
+	m_nextSequence(0),
+	m_nextReadSequence(0),
+	m_lastStreamTime(-1),
+	m_writeQueueDepth(0),
+	m_statistics(),
+	m_frameReadyCallback(nullptr)
+{
+}
+
+TimeShiftBuffer::~TimeShiftBuffer()
+{
+	close();
+}
+
+bool TimeShiftBuffer::open(const TimeShiftFormat& format, double delaySeconds, bool overrideDelay)
+{
+	uint32_t	savedDelayFrames = 0;
+	size_t		audioFrameSize = format.audioChannelCount * format.audioSampleSize;
+
+	close();
+
+	m_format		= format;
+	m_slotCount		= (uint64_t)(m_capacitySeconds * format.frameTimescale / format.frameDuration);
+
+	if (m_slotCount < 4 * (kWriteQueueDepth + 2))
+	{
+		fprintf(stderr, "Time-shift buffer of %.1f seconds is too short\n", m_capacitySeconds);
+		return false;
+	}
+
+	// Allow for audio packets that do not divide evenly into frames, 1601 or 1602 samples for 59.94 Hz
+	m_maxAudioSampleFrames	= (uint32_t)((bmdAudioSampleRate48kHz * format.frameDuration + format.frameTimescale - 1) / format.frameTimescale) + 64;
+	m_videoAreaSize			= roundUpToBlock(format.rowBytes * format.height);
+	m_audioAreaSize			= roundUpToBlock(m_maxAudioSampleFrames * audioFrameSize + sizeof(TimeShiftSlotFooter));
+	m_slotSize				= kBlockSize + m_videoAreaSize + m_audioAreaSize;
+
+	if (!openFile())
+	{
+		close();
+		return false;
+	}
+
+	if (!resumeRing(savedDelayFrames))
+	{
+		if (!createRing())
+		{
+			close();
+			return false;
+		}
+		overrideDelay = true;
+	}
+
+	m_delayFrames = clampDelay(overrideDelay ? secondsToFrames(delaySeconds) : savedDelayFrames);
+	if (!writeSuperblock(m_delayFrames))
+	{
+		close();
+		return false;
+	}
+
+	m_readBufferPool = std::make_shared<BufferPool>();
+	if (!m_readBufferPool->allocate(m_videoAreaSize + m_audioAreaSize, m_readBufferCount))
+	{
+		fprintf(stderr, "Unable to allocate time-shift read buffers\n");
+		close();
+		return false;
+	}
+
+	m_nextReadSequence	= m_nextSequence;
+	m_lastStreamTime	= -1;
+	m_writeQueueDepth	= 0;
+	m_statistics		= TimeShiftStatistics();
+
+	m_writeQueue.reset();
+	m_readQueue.reset();
+
+	m_writeThread	= std::thread(&TimeShiftBuffer::writeThread, this);
+	m_readThread	= std::thread(&TimeShiftBuffer::readThread, this);
+
+	return true;
+}
+
+void TimeShiftBuffer::close()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_inputMutex);
+		commitPendingRecord();
+	}
+
+	// The write thread finishes the frames already queued before it exits
+	m_writeQueue.cancelWaiters();
+	if (m_writeThread.joinable())
+		m_writeThread.join();
+
+	m_readQueue.cancelWaiters();
+	if (m_readThread.joinable())
+		m_readThread.join();
+
+	m_lastOutputFrame = nullptr;
+	m_readBufferPool = nullptr;
+
+	if (m_writeFd >= 0)
+		::close(m_writeFd);
+	if (m_readFd >= 0)
+		::close(m_readFd);
+
+	m_writeFd = -1;
+	m_readFd = -1;
+}
+
+void TimeShiftBuffer::writeVideoFrame(std::shared_ptr<LoopThroughVideoFrame> videoFrame)
+{
+	std::lock_guard<std::mutex>	lock(m_inputMutex);
+	BMDTimeValue				streamTime = videoFrame->getVideoStreamTime();
+	uint64_t					sequence = m_nextSequence;
+
+	if (m_writeFd < 0)
+		return;
+
+	// No audio arrived with the previous frame, it is written without
+	commitPendingRecord();
+
+	// Frames dropped on capture leave their slots unwritten, so the delay stays the same
+	// length of time and the output repeats a frame in their place
+	if ((m_lastStreamTime >= 0) && (streamTime > m_lastStreamTime + m_format.frameDuration))
+		sequence += std::min((uint64_t)((streamTime - m_lastStreamTime) / m_format.frameDuration) - 1, m_slotCount);
+
+	m_lastStreamTime	= streamTime;
+	m_nextSequence		= sequence + 1;
+	m_pendingRecord.reset(new WriteRecord { sequence, std::move(videoFrame), nullptr });
+}
+
+void TimeShiftBuffer::writeAudioPacket(std::shared_ptr<LoopThroughAudioPacket> audioPacket)
+{
+	std::lock_guard<std::mutex> lock(m_inputMutex);
+
+	// The input delivers a frame's audio straight after its video, audio without a
+	// frame to go with it is discarded
+	if (!m_pendingRecord)
+		return;
+
+	m_pendingRecord->audioPacket = std::move(audioPacket);
+	commitPendingRecord();
+}
+
+void TimeShiftBuffer::commitPendingRecord()
+{
+	BMDTimeValue	arrivedTime = ReferenceTime::getSteadyClockUptimeCount();
+
+	if (!m_pendingRecord)
+		return;
+
+	std::shared_ptr<WriteRecord> record(std::move(m_pendingRecord));
+
+	// The queue is short so that a slow disk costs dropped frames rather than memory,
+	// and so the input frames held by it are returned to the device promptly
+	if (m_writeQueueDepth < kWriteQueueDepth)
+	{
+		++m_writeQueueDepth;
+		m_writeQueue.pushSample(record);
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(m_statisticsMutex);
+		++m_statistics.writeOverruns;
+	}
+
+	// Each input frame plays out the frame recorded a delay earlier
+	for (uint64_t sequence = m_nextReadSequence; sequence <= record->sequence; sequence++)
+		m_readQueue.pushSample(ReadRequest { sequence, arrivedTime });
+
+	m_nextReadSequence = record->sequence + 1;
+}
+
+void TimeShiftBuffer::setDelay(double delaySeconds)
+{
+	uint32_t delayFrames = clampDelay(secondsToFrames(delaySeconds));
+
+	m_delayFrames = delayFrames;
+	writeSuperblock(delayFrames);
+}
+
+double TimeShiftBuffer::getDelaySeconds() const
+{
+	return (double)m_delayFrames * m_format.frameDuration / m_format.frameTimescale;
+}
+
+double TimeShiftBuffer::getCapacitySeconds() const
+{
+	return (double)m_slotCount * m_format.frameDuration / m_format.frameTimescale;
+}
+
+uint64_t TimeShiftBuffer::secondsToFrames(double seconds) const
+{
+	return (uint64_t)std::llround(std::max(seconds, 0.0) * m_format.frameTimescale / m_format.frameDuration);
+}
+
+uint32_t TimeShiftBuffer::clampDelay(uint64_t delayFrames) const
+{
+	// Reads stay clear of the slots being written at both ends of the ring
+	uint64_t	minimumFrames = kWriteQueueDepth + 2;
+	uint64_t	maximumFrames = m_slotCount - kWriteQueueDepth - 2;
+
+	return (uint32_t)std::max(std::min(delayFrames, maximumFrames), minimumFrames);
+}
+
+void TimeShiftBuffer::getStatistics(TimeShiftStatistics& statistics)
+{
+	std::lock_guard<std::mutex> lock(m_statisticsMutex);
+	statistics = m_statistics;
+}
+
+off_t TimeShiftBuffer::slotOffset(uint64_t sequence) const
+{
+	return (off_t)(kBlockSize + (sequence % m_slotCount) * m_slotSize);
+}
+
+bool TimeShiftBuffer::openFile()
+{
+	off_t	fileSize = (off_t)(kBlockSize + m_slotCount * m_slotSize);
+
+	m_directIO = true;
+	m_writeFd = ::open(m_path.c_str(), O_RDWR | O_CREAT | O_DIRECT, 0644);
+
+	// O_DIRECT is refused by some file systems, tmpfs for example
+	if ((m_writeFd < 0) && (errno == EINVAL))
+	{
+		fprintf(stderr, "The file system does not support O_DIRECT, the time-shift buffer goes through the page cache\n");
+		m_directIO = false;
+		m_writeFd = ::open(m_path.c_str(), O_RDWR | O_CREAT, 0644);
+	}
+
+	if (m_writeFd < 0)
+	{
+		fprintf(stderr, "Unable to open time-shift buffer %s: %s\n", m_path.c_str(), strerror(errno));
+		return false;
+	}
+
+	m_readFd = ::open(m_path.c_str(), O_RDONLY | (m_directIO ? O_DIRECT : 0));
+	if (m_readFd < 0)
+	{
+		fprintf(stderr, "Unable to open time-shift buffer %s: %s\n", m_path.c_str(), strerror(errno));
+		return false;
+	}
+
+	// Allocate the whole ring up front so that writing it never waits on block allocation
+	// or runs out of space part way through
+	if (fallocate(m_writeFd, 0, 0, fileSize) != 0)
+	{
+		if ((errno != EOPNOTSUPP) || (ftruncate(m_writeFd, fileSize) != 0))
+		{
+			fprintf(stderr, "Unable to allocate %lld bytes for time-shift buffer %s: %s\n", (long long)fileSize, m_path.c_str(), strerror(errno));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool TimeShiftBuffer::resumeRing(uint32_t& delayFrames)
+{
+	std::unique_ptr<uint8_t, decltype(&free)>	buffer(allocateAligned(kBlockSize), &free);
+	TimeShiftSuperblock							superblock;
+	bool										foundSlot = false;
+	uint64_t									newestSequence = 0;
+
+	m_resumedFrameCount = 0;
+
+	if (!buffer || (pread(m_readFd, buffer.get(), kBlockSize, 0) != (ssize_t)kBlockSize))
+		return false;
+
+	memcpy(&superblock, buffer.get(), sizeof(superblock));
+
+	if ((memcmp(superblock.magic, kSuperblockMagic, sizeof(kSuperblockMagic)) != 0) ||
+		(superblock.version != kSuperblockVersion) ||
+		(superblock.checksum != superblockChecksum(superblock)))
+		return false;
+
+	if ((superblock.slotSize != m_slotSize) || (superblock.slotCount != m_slotCount) ||
+		(superblock.width != m_format.width) || (superblock.height != m_format.height) || (superblock.rowBytes != m_format.rowBytes) ||
+		(superblock.pixelFormat != m_format.pixelFormat) ||
+		(superblock.frameDuration != m_format.frameDuration) || (superblock.frameTimescale != m_format.frameTimescale) ||
+		(superblock.audioChannelCount != m_format.audioChannelCount) || (superblock.audioSampleSize != m_format.audioSampleSize))
+	{
+		fprintf(stderr, "Time-shift buffer %s was recorded in a different format or length, starting a new one\n", m_path.c_str());
+		return false;
+	}
+
+	m_ringID = superblock.ringID;
+	delayFrames = superblock.delayFrames;
+
+	// Continue after the newest frame found.  Its footer is checked when it is played.
+	for (uint64_t slot = 0; slot < m_slotCount; slot++)
+	{
+		TimeShiftSlotHeader header;
+
+		if (pread(m_readFd, buffer.get(), kBlockSize, slotOffset(slot)) != (ssize_t)kBlockSize)
+			break;
+
+		memcpy(&header, buffer.get(), sizeof(header));
+
+		if ((header.magic != kSlotMagic) || (header.ringID != m_ringID) || (header.sequence % m_slotCount != slot) ||
+			(header.checksum != slotHeaderChecksum(header)))
+			continue;
+
+		if (!foundSlot || (header.sequence > newestSequence))
+			newestSequence = header.sequence;
+
+		foundSlot = true;
+		++m_resumedFrameCount;
+	}
+
+	m_nextSequence = foundSlot ? newestSequence + 1 : 0;
+	return true;
+}
+
+bool TimeShiftBuffer::createRing()
+{
+	std::random_device	randomDevice;
+
+	// Slots left from an earlier ring in the file have a different ID and are ignored
+	m_ringID				= ((uint64_t)randomDevice() << 32) ^ randomDevice() ^ (uint64_t)std::chrono::system_clock::now().time_since_epoch().count();
+	m_nextSequence			= 0;
+	m_resumedFrameCount		= 0;
+
+	return true;
+}
+
+bool TimeShiftBuffer::writeSuperblock(uint32_t delayFrames)
+{
+	std::lock_guard<std::mutex>					lock(m_superblockMutex);
+	std::unique_ptr<uint8_t, decltype(&free)>	buffer(allocateAligned(kBlockSize), &free);
+	TimeShiftSuperblock							superblock = {};
+
+	if (!buffer || (m_writeFd < 0))
+		return false;
+
+	memcpy(superblock.magic, kSuperblockMagic, sizeof(kSuperblockMagic));
+	superblock.version				= kSuperblockVersion;
+	superblock.ringID				= m_ringID;
+	superblock.slotSize				= m_slotSize;
+	superblock.slotCount			= m_slotCount;
+	superblock.width				= m_format.width;
+	superblock.height				= m_format.height;
+	superblock.rowBytes				= m_format.rowBytes;
+	superblock.frameDuration		= m_format.frameDuration;
+	superblock.frameTimescale		= m_format.frameTimescale;
+	superblock.pixelFormat			= m_format.pixelFormat;
+	superblock.audioChannelCount	= m_format.audioChannelCount;
+	superblock.audioSampleSize		= m_format.audioSampleSize;
+	superblock.maxAudioSampleFrames	= m_maxAudioSampleFrames;
+	superblock.delayFrames			= delayFrames;
+	superblock.checksum				= superblockChecksum(superblock);
+
+	memcpy(buffer.get(), &superblock, sizeof(superblock));
+
+	if ((pwrite(m_writeFd, buffer.get(), kBlockSize, 0) != (ssize_t)kBlockSize) || (fdatasync(m_writeFd) != 0))
+	{
+		fprintf(stderr, "Unable to write time-shift buffer %s: %s\n", m_path.c_str(), strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+void TimeShiftBuffer::writeThread()
+{
+	std::unique_ptr<uint8_t, decltype(&free)>	headerBuffer(allocateAligned(kBlockSize), &free);
+	std::unique_ptr<uint8_t, decltype(&free)>	videoBuffer(allocateAligned(m_videoAreaSize), &free);
+	std::unique_ptr<uint8_t, decltype(&free)>	audioBuffer(allocateAligned(m_audioAreaSize), &free);
+	std::shared_ptr<WriteRecord>				record;
+	auto										lastSync = std::chrono::steady_clock::now();
+
+	FRAME_TRACE_THREAD_NAME("Time-shift write");
+
+	if (!headerBuffer || !videoBuffer || !audioBuffer)
+	{
+		fprintf(stderr, "Unable to allocate time-shift write buffers\n");
+		return;
+	}
+
+	while (m_writeQueue.waitForSample(record))
+	{
+		writeRecord(*record, headerBuffer.get(), videoBuffer.get(), audioBuffer.get());
+		record = nullptr;
+		--m_writeQueueDepth;
+
+		// Bound what a power failure can lose, and commit the allocation of newly written blocks
+		if (std::chrono::steady_clock::now() - lastSync >= kSyncInterval)
+		{
+			fdatasync(m_writeFd);
+			lastSync = std::chrono::steady_clock::now();
+		}
+	}
+
+	// Finish the frames already queued when the buffer is closed
+	while (m_writeQueue.popSample(record))
+	{
+		writeRecord(*record, headerBuffer.get(), videoBuffer.get(), audioBuffer.get());
+		--m_writeQueueDepth;
+	}
+
+	fdatasync(m_writeFd);
+}
+
+bool TimeShiftBuffer::writeRecord(const WriteRecord& record, uint8_t* headerBuffer, uint8_t* videoBuffer, uint8_t* audioBuffer)
+{
+	IDeckLinkVideoFrame*	videoFrame = record.videoFrame->getVideoFramePtr();
+	size_t					videoBytes = m_format.rowBytes * m_format.height;
+	size_t					audioFrameSize = m_format.audioChannelCount * m_format.audioSampleSize;
+	uint32_t				audioSampleFrames = 0;
+	void*					frameBytes;
+	TimeShiftSlotHeader		header = {};
+	TimeShiftSlotFooter		footer = { m_ringID, record.sequence };
+	struct iovec			iov[3];
+	auto					startTime = std::chrono::steady_clock::now();
+	bool					copied = false;
+
+	FRAME_TRACE_SPAN("TimeShiftWrite", record.sequence);
+
+	if ((videoFrame->GetRowBytes() != m_format.rowBytes) || (videoFrame->GetHeight() != m_format.height) ||
+		(videoFrame->GetBytes(&frameBytes) != S_OK))
+		return false;
+
+	// Input frames that meet the O_DIRECT alignment are written from the device's own buffer
+	if ((((uintptr_t)frameBytes % kBlockSize) == 0) && (videoBytes == m_videoAreaSize))
+	{
+		iov[1].iov_base = frameBytes;
+	}
+	else
+	{
+		memcpy(videoBuffer, frameBytes, videoBytes);
+		iov[1].iov_base = videoBuffer;
+		copied = true;
+	}
+	iov[1].iov_len = m_videoAreaSize;
+
+	if (record.audioPacket)
+	{
+		audioSampleFrames = (uint32_t)std::min((long)m_maxAudioSampleFrames, record.audioPacket->getSampleFrameCount());
+		memcpy(audioBuffer, record.audioPacket->getBuffer(), audioSampleFrames * audioFrameSize);
+	}
+	memcpy(audioBuffer + m_audioAreaSize - sizeof(footer), &footer, sizeof(footer));
+	iov[2].iov_base = audioBuffer;
+	iov[2].iov_len = m_audioAreaSize;
+
+	header.magic				= kSlotMagic;
+	header.ringID				= m_ringID;
+	header.sequence				= record.sequence;
+	header.streamTime			= record.videoFrame->getVideoStreamTime();
+	header.videoBytes			= (uint32_t)videoBytes;
+	header.audioSampleFrames	= audioSampleFrames;
+	header.checksum				= slotHeaderChecksum(header);
+	memcpy(headerBuffer, &header, sizeof(header));
+	iov[0].iov_base = headerBuffer;
+	iov[0].iov_len = kBlockSize;
+
+	if (pwritev(m_writeFd, iov, 3, slotOffset(record.sequence)) != (ssize_t)m_slotSize)
+	{
+		fprintf(stderr, "Unable to write frame to time-shift buffer: %s\n", strerror(errno));
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex>	lock(m_statisticsMutex);
+		BMDTimeValue				writeTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+		++m_statistics.framesWritten;
+		if (copied)
+			++m_statistics.framesCopied;
+		m_statistics.maxWriteTime = std::max(m_statistics.maxWriteTime, writeTime);
+	}
+
+	return true;
+}
+
+void TimeShiftBuffer::readThread()
+{
+	std::unique_ptr<uint8_t, decltype(&free)>	headerBuffer(allocateAligned(kBlockSize), &free);
+	ReadRequest									request;
+
+	FRAME_TRACE_THREAD_NAME("Time-shift read");
+
+	if (!headerBuffer)
+	{
+		fprintf(stderr, "Unable to allocate time-shift read buffer\n");
+		return;
+	}
+
+	while (m_readQueue.waitForSample(request))
+	{
+		uint32_t								delayFrames = m_delayFrames;
+		BMDTimeValue							outputTime = (BMDTimeValue)request.sequence * m_format.frameDuration;
+		std::shared_ptr<uint8_t>				buffer;
+		com_ptr<IDeckLinkVideoFrame>			videoFrame;
+		std::shared_ptr<LoopThroughAudioPacket>	audioPacket;
+		uint32_t								audioSampleFrames = 0;
+		auto									startTime = std::chrono::steady_clock::now();
+		bool									starved = false;
+		bool									repeated = false;
+
+		FRAME_TRACE_SPAN("TimeShiftRead", request.sequence);
+
+		if (request.sequence >= delayFrames)
+		{
+			buffer = m_readBufferPool->acquire();
+			starved = !buffer;
+		}
+
+		if (buffer && readSlot(request.sequence - delayFrames, headerBuffer.get(), buffer.get(), audioSampleFrames))
+		{
+			videoFrame = make_com_ptr<TimeShiftVideoFrame>(buffer, m_format).get();
+			m_lastOutputFrame = videoFrame;
+
+			if (audioSampleFrames > 0)
+			{
+				audioPacket = std::make_shared<LoopThroughAudioPacket>(buffer.get() + m_videoAreaSize, audioSampleFrames, [buffer]() { });
+				audioPacket->setAudioStreamTime(outputTime);
+				audioPacket->setInputPacketArrivedReferenceTime(request.inputArrivedTime);
+			}
+		}
+		else if (m_lastOutputFrame)
+		{
+			// The delayed frame was never recorded, or was lost, hold the previous frame
+			// and leave the audio silent
+			videoFrame = m_lastOutputFrame;
+			repeated = true;
+		}
+
+		{
+			std::lock_guard<std::mutex>	lock(m_statisticsMutex);
+			BMDTimeValue				readTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+			if (starved)
+				++m_statistics.readBufferStarved;
+			if (repeated)
+				++m_statistics.framesRepeated;
+			else if (videoFrame)
+				++m_statistics.framesRead;
+			m_statistics.maxReadTime = std::max(m_statistics.maxReadTime, readTime);
+		}
+
+		// Nothing is played until the first delayed frame is available
+		if (!videoFrame || !m_frameReadyCallback)
+			continue;
+
+		auto loopThroughVideoFrame = std::make_shared<LoopThroughVideoFrame>(videoFrame);
+		loopThroughVideoFrame->setVideoStreamTime(outputTime);
+		loopThroughVideoFrame->setVideoFrameDuration(m_format.frameDuration);
+		loopThroughVideoFrame->setInputFrameStartReferenceTime(request.inputArrivedTime);
+		loopThroughVideoFrame->setInputFrameArrivedReferenceTime(request.inputArrivedTime);
+
+		m_frameReadyCallback(std::move(loopThroughVideoFrame), std::move(audioPacket));
+	}
+}
+
+bool TimeShiftBuffer::readSlot(uint64_t sequence, uint8_t* headerBuffer, uint8_t* frameBuffer, uint32_t& audioSampleFrames)
+{
+	TimeShiftSlotHeader		header;
+	TimeShiftSlotFooter		footer;
+	struct iovec			iov[2];
+
+	iov[0].iov_base = headerBuffer;
+	iov[0].iov_len = kBlockSize;
+	iov[1].iov_base = frameBuffer;
+	iov[1].iov_len = m_videoAreaSize + m_audioAreaSize;
+
+	if (preadv(m_readFd, iov, 2, slotOffset(sequence)) != (ssize_t)m_slotSize)
+		return false;
+
+	memcpy(&header, headerBuffer, sizeof(header));
+	memcpy(&footer, frameBuffer + m_videoAreaSize + m_audioAreaSize - sizeof(footer), sizeof(footer));
+
+	// A slot belongs to this frame only if it was completely written for it
+	if ((header.magic != kSlotMagic) || (header.ringID != m_ringID) || (header.sequence != sequence) ||
+		(header.checksum != slotHeaderChecksum(header)) ||
+		(footer.ringID != m_ringID) || (footer.sequence != sequence) ||
+		(header.videoBytes != (uint32_t)(m_format.rowBytes * m_format.height)) || (header.audioSampleFrames > m_maxAudioSampleFrames))
+		return false;
+
+	audioSampleFrames = header.audioSampleFrames;
+	return true;
+}
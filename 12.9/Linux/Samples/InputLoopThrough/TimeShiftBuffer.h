@@ -0,0 +1,192 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DeckLinkAPI.h"
+#include "LoopThroughAudioPacket.h"
+#include "LoopThroughVideoFrame.h"
+#include "SampleQueue.h"
+#include "com_ptr.h"
+
+// Format of the frames held in a time-shift buffer.  A buffer file written with a
+// different format is discarded when it is opened.
+struct TimeShiftFormat
+{
+	long			width;
+	long			height;
+	long			rowBytes;
+	BMDPixelFormat	pixelFormat;
+	BMDTimeValue	frameDuration;
+	BMDTimeScale	frameTimescale;
+	uint32_t		audioChannelCount;
+	uint32_t		audioSampleSize;		// bytes per sample of one channel
+};
+
+struct TimeShiftStatistics
+{
+	uint64_t		framesWritten;
+	uint64_t		framesCopied;			// written through the staging buffer, not directly from the input frame
+	uint64_t		writeOverruns;			// input frames dropped because the disk fell behind
+	uint64_t		framesRead;
+	uint64_t		framesRepeated;			// delayed frame missing or unreadable, previous frame repeated
+	uint64_t		readBufferStarved;		// no free read buffer, previous frame repeated
+	BMDTimeValue	maxWriteTime;			// microseconds
+	BMDTimeValue	maxReadTime;			// microseconds
+};
+
+// Delays the input by a fixed number of frames through a preallocated circular file.
+//
+// The file starts with a superblock describing the format, size and delay of the ring,
+// followed by one fixed size slot per frame, so memory use does not depend on the length
+// of the delay.  Each slot holds a header, the video frame and the audio of that frame,
+// and ends with a footer repeating the sequence number.  A slot is written with a single
+// O_DIRECT write, and is only played when its header and footer agree.  Reopening the file
+// with the same format resumes after the newest complete frame with the saved delay, so
+// the delayed output continues where it stopped after a restart or a crash.
+//
+// Frames are written by one thread and read back by another, each with its own file
+// descriptor.  Each input frame schedules the frame recorded delay frames earlier; output
+// stream times follow the input sequence, so changing the delay only changes which frame
+// is read and never interrupts playback.
+class TimeShiftBuffer
+{
+public:
+	using FrameReadyCallback = std::function<void(std::shared_ptr<LoopThroughVideoFrame>, std::shared_ptr<LoopThroughAudioPacket>)>;
+
+	TimeShiftBuffer(const std::string& path, double capacitySeconds, uint32_t readBufferCount);
+	virtual ~TimeShiftBuffer();
+
+	// Opens or creates the ring for the format.  delaySeconds is used for a new ring, or for
+	// an existing one when overrideDelay is set, otherwise the saved delay is kept.
+	bool		open(const TimeShiftFormat& format, double delaySeconds, bool overrideDelay);
+	void		close(void);
+
+	void		writeVideoFrame(std::shared_ptr<LoopThroughVideoFrame> videoFrame);
+	void		writeAudioPacket(std::shared_ptr<LoopThroughAudioPacket> audioPacket);
+
+	// Takes effect from the next output frame and is saved in the superblock.  The delay is
+	// limited to what the ring can hold.
+	void		setDelay(double delaySeconds);
+	double		getDelaySeconds(void) const;
+	uint32_t	getDelayFrames(void) const { return m_delayFrames; }
+	double		getCapacitySeconds(void) const;
+	uint64_t	getResumedFrameCount(void) const { return m_resumedFrameCount; }
+	bool		isDirectIO(void) const { return m_directIO; }
+
+	void		getStatistics(TimeShiftStatistics& statistics);
+
+	void		onFrameReady(const FrameReadyCallback& callback) { m_frameReadyCallback = callback; }
+
+private:
+	struct WriteRecord
+	{
+		uint64_t								sequence;
+		std::shared_ptr<LoopThroughVideoFrame>	videoFrame;
+		std::shared_ptr<LoopThroughAudioPacket>	audioPacket;
+	};
+
+	struct ReadRequest
+	{
+		uint64_t		sequence;				// output position, the frame read is sequence - delay
+		BMDTimeValue	inputArrivedTime;
+	};
+
+	class BufferPool;
+
+	std::string						m_path;
+	double							m_capacitySeconds;
+	uint64_t						m_slotCount;
+	uint32_t						m_readBufferCount;
+	//
+	TimeShiftFormat					m_format;
+	uint64_t						m_ringID;
+	size_t							m_videoAreaSize;
+	size_t							m_audioAreaSize;
+	size_t							m_slotSize;
+	uint32_t						m_maxAudioSampleFrames;
+	bool							m_directIO;
+	int								m_writeFd;
+	int								m_readFd;
+	//
+	std::atomic<uint32_t>			m_delayFrames;
+	uint64_t						m_resumedFrameCount;
+	uint64_t						m_nextSequence;
+	uint64_t						m_nextReadSequence;
+	BMDTimeValue					m_lastStreamTime;
+	std::unique_ptr<WriteRecord>	m_pendingRecord;
+	std::mutex						m_inputMutex;
+	std::mutex						m_superblockMutex;
+	//
+	SampleQueue<std::shared_ptr<WriteRecord>>	m_writeQueue;
+	std::atomic<uint32_t>			m_writeQueueDepth;
+	SampleQueue<ReadRequest>		m_readQueue;
+	std::thread						m_writeThread;
+	std::thread						m_readThread;
+	std::shared_ptr<BufferPool>		m_readBufferPool;
+	com_ptr<IDeckLinkVideoFrame>	m_lastOutputFrame;
+	//
+	std::mutex						m_statisticsMutex;
+	TimeShiftStatistics				m_statistics;
+	//
+	FrameReadyCallback				m_frameReadyCallback;
+
+	bool		openFile(void);
+	bool		createRing(void);
+	bool		resumeRing(uint32_t& delayFrames);
+	bool		writeSuperblock(uint32_t delayFrames);
+	uint64_t	secondsToFrames(double seconds) const;
+	uint32_t	clampDelay(uint64_t delayFrames) const;
+	void		commitPendingRecord(void);
+	void		writeThread(void);
+	bool		writeRecord(const WriteRecord& record, uint8_t* headerBuffer, uint8_t* videoBuffer, uint8_t* audioBuffer);
+	void		readThread(void);
+	bool		readSlot(uint64_t sequence, uint8_t* headerBuffer, uint8_t* frameBuffer, uint32_t& audioSampleFrames);
+	off_t		slotOffset(uint64_t sequence) const;
+};
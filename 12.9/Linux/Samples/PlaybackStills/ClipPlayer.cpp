@@ -0,0 +1,187 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <stdio.h>
+#include "platform.h"
+#include "ClipPlayer.h"
+
+ClipPlayer::ClipPlayer(IDeckLinkOutput* deckLinkOutput, std::shared_ptr<MappedClip> clip, BMDTimeValue frameDuration, BMDTimeScale frameTimescale, bool loopPlayback) :
+	m_deckLinkOutput(deckLinkOutput), m_clip(clip), m_frameDuration(frameDuration), m_frameTimescale(frameTimescale), m_loopPlayback(loopPlayback),
+	m_running(false), m_position(0), m_framesLate(0), m_framesDropped(0), m_refCount(1)
+{
+	m_deckLinkOutput->AddRef();
+}
+
+ClipPlayer::~ClipPlayer()
+{
+	m_deckLinkOutput->Release();
+}
+
+HRESULT ClipPlayer::Start(int prerollFrames)
+{
+	HRESULT result;
+
+	result = m_deckLinkOutput->SetScheduledFrameCompletionCallback(this);
+	if (result != S_OK)
+	{
+		fprintf(stderr, "Unable to set scheduled frame completion callback\n");
+		return result;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// Preroll, the remaining frames are scheduled as each one completes
+	for (int i = 0; i < prerollFrames; i++)
+	{
+		result = ScheduleNextFrame();
+		if (FAILED(result))
+			return result;
+		if (result != S_OK)
+			break;
+	}
+
+	result = m_deckLinkOutput->StartScheduledPlayback(0, m_frameTimescale, 1.0);
+	if (result != S_OK)
+	{
+		fprintf(stderr, "Unable to start scheduled playback\n");
+		return result;
+	}
+
+	m_running = true;
+	return S_OK;
+}
+
+void ClipPlayer::Stop(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = false;
+	}
+
+	m_deckLinkOutput->StopScheduledPlayback(0, NULL, 0);
+	m_deckLinkOutput->SetScheduledFrameCompletionCallback(NULL);
+}
+
+HRESULT ClipPlayer::ScheduleNextFrame(void)
+{
+	IDeckLinkVideoFrame*	frame = NULL;
+	uint64_t				position = m_position;
+	HRESULT					result;
+
+	if (!m_loopPlayback && (position >= m_clip->GetFrameCount()))
+		return S_FALSE;
+
+	result = m_clip->CreateFrame(position, &frame);
+	if (result != S_OK)
+		return result;
+
+	result = m_deckLinkOutput->ScheduleVideoFrame(frame, position * m_frameDuration, m_frameDuration, m_frameTimescale);
+
+	// The device holds its own reference until the frame completes
+	frame->Release();
+
+	if (result != S_OK)
+	{
+		fprintf(stderr, "Unable to schedule video frame %llu\n", (unsigned long long)position);
+		return result;
+	}
+
+	m_position = position + 1;
+	return S_OK;
+}
+
+HRESULT ClipPlayer::ScheduledFrameCompleted(IDeckLinkVideoFrame* completedFrame, BMDOutputFrameCompletionResult result)
+{
+	if (result == bmdOutputFrameDisplayedLate)
+		m_framesLate++;
+	else if (result == bmdOutputFrameDropped)
+		m_framesDropped++;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_running)
+		ScheduleNextFrame();
+
+	return S_OK;
+}
+
+HRESULT	STDMETHODCALLTYPE ClipPlayer::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	CFUUIDBytes		iunknown;
+	HRESULT 		result = E_NOINTERFACE;
+
+	if (ppv == NULL)
+		return E_INVALIDARG;
+
+	// Initialise the return result
+	*ppv = NULL;
+
+	// Obtain the IUnknown interface and compare it the provided REFIID
+	iunknown = CFUUIDGetUUIDBytes(IUnknownUUID);
+	if (memcmp(&iid, &iunknown, sizeof(REFIID)) == 0)
+	{
+		*ppv = this;
+		AddRef();
+		result = S_OK;
+	}
+
+	else if (memcmp(&iid, &IID_IDeckLinkVideoOutputCallback, sizeof(REFIID)) == 0)
+	{
+		*ppv = (IDeckLinkVideoOutputCallback*)this;
+		AddRef();
+		result = S_OK;
+	}
+
+	return result;
+}
+
+ULONG STDMETHODCALLTYPE ClipPlayer::AddRef(void)
+{
+	return ++m_refCount;
+}
+
+ULONG STDMETHODCALLTYPE ClipPlayer::Release(void)
+{
+	ULONG newRefValue = --m_refCount;
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
@@ -0,0 +1,89 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include "DeckLinkAPI.h"
+#include "MappedVideoFrame.h"
+
+// Plays a MappedClip with scheduled playback, scheduling the next frame of the clip as
+// each frame completes.  Frames are scheduled straight from the mapping.
+class ClipPlayer : public IDeckLinkVideoOutputCallback
+{
+public:
+	ClipPlayer(IDeckLinkOutput* deckLinkOutput, std::shared_ptr<MappedClip> clip, BMDTimeValue frameDuration, BMDTimeScale frameTimescale, bool loopPlayback);
+	virtual ~ClipPlayer();
+
+	HRESULT					Start(int prerollFrames);
+	void					Stop(void);
+
+	uint64_t				GetFramesScheduled(void) const { return m_position; }
+	uint64_t				GetFramesLate(void) const { return m_framesLate; }
+	uint64_t				GetFramesDropped(void) const { return m_framesDropped; }
+
+	// IDeckLinkVideoOutputCallback interface
+	virtual HRESULT			STDMETHODCALLTYPE	ScheduledFrameCompleted(IDeckLinkVideoFrame* completedFrame, BMDOutputFrameCompletionResult result);
+	virtual HRESULT			STDMETHODCALLTYPE	ScheduledPlaybackHasStopped(void) { return S_OK; };
+
+	// IUnknown interface
+	virtual HRESULT			STDMETHODCALLTYPE	QueryInterface(REFIID iid, LPVOID *ppv);
+	virtual ULONG			STDMETHODCALLTYPE	AddRef();
+	virtual ULONG			STDMETHODCALLTYPE	Release();
+
+private:
+	HRESULT					ScheduleNextFrame(void);
+
+	IDeckLinkOutput*			m_deckLinkOutput;
+	std::shared_ptr<MappedClip>	m_clip;
+	BMDTimeValue				m_frameDuration;
+	BMDTimeScale				m_frameTimescale;
+	bool						m_loopPlayback;
+
+	std::mutex					m_mutex;
+	bool						m_running;
+	std::atomic<uint64_t>		m_position;
+	std::atomic<uint64_t>		m_framesLate;
+	std::atomic<uint64_t>		m_framesDropped;
+
+	std::atomic<ULONG>	m_refCount;
+};
@@ -0,0 +1,205 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include "platform.h"
+#include "MappedVideoFrame.h"
+
+/* MappedClip class */
+
+MappedClip::MappedClip() :
+	m_fd(-1), m_mapping(NULL), m_mappingSize(0), m_width(0), m_height(0), m_rowBytes(0), m_pixelFormat(bmdFormat10BitYUV),
+	m_frameStride(0), m_frameCount(0), m_prefetchFrames(0), m_prefetchEnd(0)
+{
+}
+
+MappedClip::~MappedClip()
+{
+	if (m_mapping != NULL)
+		munmap(m_mapping, m_mappingSize);
+
+	if (m_fd >= 0)
+		close(m_fd);
+}
+
+long MappedClip::PaddedFrameSize(long rowBytes, long height)
+{
+	long pageSize = sysconf(_SC_PAGESIZE);
+	return (rowBytes * height + pageSize - 1) / pageSize * pageSize;
+}
+
+HRESULT MappedClip::Open(const std::string& path, long width, long height, long rowBytes, BMDPixelFormat pixelFormat, int prefetchFrames)
+{
+	struct stat		fileStat;
+	void*			mapping;
+
+	if (m_fd >= 0)
+		return E_FAIL;
+
+	m_fd = open(path.c_str(), O_RDONLY);
+	if (m_fd < 0)
+	{
+		fprintf(stderr, "Unable to open clip %s: %s\n", path.c_str(), strerror(errno));
+		return E_FAIL;
+	}
+
+	m_frameStride = PaddedFrameSize(rowBytes, height);
+
+	if ((fstat(m_fd, &fileStat) != 0) || (fileStat.st_size < (off_t)m_frameStride) || (fileStat.st_size % m_frameStride != 0))
+	{
+		fprintf(stderr, "Clip %s is not a whole number of %ld x %ld frames of %zu bytes\n", path.c_str(), width, height, m_frameStride);
+		return E_FAIL;
+	}
+
+	// The frames are only read by the device, so a shared read-only mapping of the page
+	// cache is used directly.  No pages are touched until they are prefetched.
+	mapping = mmap(NULL, fileStat.st_size, PROT_READ, MAP_SHARED, m_fd, 0);
+	if (mapping == MAP_FAILED)
+	{
+		fprintf(stderr, "Unable to map clip %s: %s\n", path.c_str(), strerror(errno));
+		return E_FAIL;
+	}
+
+	m_mapping			= (uint8_t*)mapping;
+	m_mappingSize		= fileStat.st_size;
+	m_width				= width;
+	m_height			= height;
+	m_rowBytes			= rowBytes;
+	m_pixelFormat		= pixelFormat;
+	m_frameCount		= m_mappingSize / m_frameStride;
+	m_prefetchFrames	= prefetchFrames;
+	m_prefetchEnd		= 0;
+
+	return S_OK;
+}
+
+void MappedClip::Prefetch(uint64_t position)
+{
+	// Only the frames that have just come into the prefetch window are requested, the
+	// rest were already queued by earlier calls
+	uint64_t	end = position + m_prefetchFrames + 1;
+	size_t		frameSize = m_rowBytes * m_height;
+
+	for (uint64_t prefetch = std::max(position, m_prefetchEnd); prefetch < end; prefetch++)
+	{
+		off_t offset = (off_t)((prefetch % m_frameCount) * m_frameStride);
+
+		// readahead() queues the read into the page cache without waiting for it,
+		// and madvise() is a fallback on file systems that do not support it
+		if (readahead(m_fd, offset, frameSize) != 0)
+			madvise(m_mapping + offset, m_frameStride, MADV_WILLNEED);
+	}
+
+	m_prefetchEnd = std::max(m_prefetchEnd, end);
+}
+
+HRESULT MappedClip::CreateFrame(uint64_t position, IDeckLinkVideoFrame** frame)
+{
+	if ((frame == NULL) || (m_mapping == NULL))
+		return E_INVALIDARG;
+
+	Prefetch(position);
+
+	*frame = new MappedVideoFrame(shared_from_this(), m_mapping + (position % m_frameCount) * m_frameStride, m_width, m_height, m_rowBytes, m_pixelFormat);
+	return S_OK;
+}
+
+/* MappedVideoFrame class */
+
+// Constructor keeps the clip mapped until the frame is released by the device
+MappedVideoFrame::MappedVideoFrame(std::shared_ptr<MappedClip> clip, void* bytes, long width, long height, long rowBytes, BMDPixelFormat pixelFormat) :
+	m_clip(clip), m_bytes(bytes), m_width(width), m_height(height), m_rowBytes(rowBytes), m_pixelFormat(pixelFormat), m_refCount(1)
+{
+}
+
+HRESULT MappedVideoFrame::GetBytes(void **buffer)
+{
+	*buffer = m_bytes;
+	return S_OK;
+}
+
+HRESULT	STDMETHODCALLTYPE MappedVideoFrame::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	CFUUIDBytes		iunknown;
+	HRESULT 		result = E_NOINTERFACE;
+
+	if (ppv == NULL)
+		return E_INVALIDARG;
+
+	// Initialise the return result
+	*ppv = NULL;
+
+	// Obtain the IUnknown interface and compare it the provided REFIID
+	iunknown = CFUUIDGetUUIDBytes(IUnknownUUID);
+	if (memcmp(&iid, &iunknown, sizeof(REFIID)) == 0)
+	{
+		*ppv = this;
+		AddRef();
+		result = S_OK;
+	}
+
+	else if (memcmp(&iid, &IID_IDeckLinkVideoFrame, sizeof(REFIID)) == 0)
+	{
+		*ppv = (IDeckLinkVideoFrame*)this;
+		AddRef();
+		result = S_OK;
+	}
+
+	return result;
+}
+
+ULONG STDMETHODCALLTYPE MappedVideoFrame::AddRef(void)
+{
+	return ++m_refCount;
+}
+
+ULONG STDMETHODCALLTYPE MappedVideoFrame::Release(void)
+{
+	ULONG newRefValue = --m_refCount;
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
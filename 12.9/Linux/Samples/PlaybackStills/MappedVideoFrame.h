@@ -0,0 +1,117 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <stdint.h>
+#include "DeckLinkAPI.h"
+
+// A pre-rendered clip of raw frames, mapped into memory rather than read.  Each frame
+// starts on a page boundary: frames are rowBytes * height bytes, padded up to a multiple
+// of the page size.  Frames handed out by CreateFrame point directly into the mapping,
+// so playout needs no copies in userspace, and the frames ahead of the one requested
+// are prefetched into the page cache so the device is not stalled by disk reads.
+class MappedClip : public std::enable_shared_from_this<MappedClip>
+{
+public:
+	MappedClip();
+	virtual ~MappedClip();
+
+	HRESULT				Open(const std::string& path, long width, long height, long rowBytes, BMDPixelFormat pixelFormat, int prefetchFrames);
+
+	uint64_t			GetFrameCount(void) const { return m_frameCount; }
+	// Position counts up through loops of the clip, the frame is position % GetFrameCount()
+	HRESULT				CreateFrame(uint64_t position, IDeckLinkVideoFrame** frame);
+
+	static long			PaddedFrameSize(long rowBytes, long height);
+
+private:
+	void				Prefetch(uint64_t position);
+
+	int					m_fd;
+	uint8_t*			m_mapping;
+	size_t				m_mappingSize;
+	long				m_width;
+	long				m_height;
+	long				m_rowBytes;
+	BMDPixelFormat		m_pixelFormat;
+	size_t				m_frameStride;
+	uint64_t			m_frameCount;
+	int					m_prefetchFrames;
+	uint64_t			m_prefetchEnd;
+};
+
+// Video frame whose pixels are a page aligned frame of a MappedClip
+class MappedVideoFrame : public IDeckLinkVideoFrame
+{
+private:
+	std::shared_ptr<MappedClip>	m_clip;
+	void*						m_bytes;
+	long						m_width;
+	long						m_height;
+	long						m_rowBytes;
+	BMDPixelFormat				m_pixelFormat;
+
+	std::atomic<ULONG>	m_refCount;
+
+public:
+	MappedVideoFrame(std::shared_ptr<MappedClip> clip, void* bytes, long width, long height, long rowBytes, BMDPixelFormat pixelFormat);
+	virtual ~MappedVideoFrame() {};
+
+	// IDeckLinkVideoFrame interface
+	virtual long			STDMETHODCALLTYPE	GetWidth(void)			{ return m_width; };
+	virtual long			STDMETHODCALLTYPE	GetHeight(void)			{ return m_height; };
+	virtual long			STDMETHODCALLTYPE	GetRowBytes(void)		{ return m_rowBytes; };
+	virtual HRESULT			STDMETHODCALLTYPE	GetBytes(void** buffer);
+	virtual BMDFrameFlags	STDMETHODCALLTYPE	GetFlags(void)			{ return bmdFrameFlagDefault; };
+	virtual BMDPixelFormat	STDMETHODCALLTYPE	GetPixelFormat(void)	{ return m_pixelFormat; };
+
+	// Dummy implementations of remaining methods in IDeckLinkVideoFrame
+	virtual HRESULT			STDMETHODCALLTYPE	GetAncillaryData(IDeckLinkVideoFrameAncillary** ancillary) { return E_NOTIMPL; };
+	virtual HRESULT			STDMETHODCALLTYPE	GetTimecode(BMDTimecodeFormat format, IDeckLinkTimecode** timecode) { return E_NOTIMPL;	};
+
+	// IUnknown interface
+	virtual HRESULT			STDMETHODCALLTYPE	QueryInterface(REFIID iid, LPVOID *ppv);
+	virtual ULONG			STDMETHODCALLTYPE	AddRef();
+	virtual ULONG			STDMETHODCALLTYPE	Release();
+};
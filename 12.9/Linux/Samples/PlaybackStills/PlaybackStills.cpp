@@ -45,9 +45,13 @@
 #include <condition_variable>
 #include "platform.h"
 #include "ImageLoader.h"
+#include "MappedVideoFrame.h"
+#include "ClipPlayer.h"
 #include "DeckLinkAPI.h"
 
 static const BMDPixelFormat kConvertedPixelFormat = bmdFormat10BitYUV;
+static const BMDPixelFormat kClipPixelFormat = bmdFormat10BitYUV;
+static const int kClipPrerollFrames = 3;
 
 std::mutex					g_playbackMutex;
 std::condition_variable		g_playbackStopCondition;
@@ -231,11 +235,18 @@ void DisplayUsage(const IDeckLinkOutput* selectedDeckLinkOutput, const std::vect
 	fprintf(stderr,
 		"    -i <interval>\n        Playback frame interval rate (default is 1 - every frame)\n"
 		"    -l\n        Loop playback\n"
+		"    -r <clip file>\n        Play a raw v210 clip at the frame rate of the mode instead of PNG stills.  Frames\n"
+		"        are played straight from a memory mapping of the file, each padded to a page boundary\n"
+		"    -a <frames>\n        Number of clip frames to prefetch ahead of playback (default is 8)\n"
 		"    <imagedirectory>\n"
 		"\n"
 		"Playback PNG image stills from a specified directory. eg:\n"
 		"\n"
 		"    ./PlaybackStills -d 0 -m 2 -i 60 -l ~/Pictures/\n"
+		"\n"
+		"Playback a raw clip. eg:\n"
+		"\n"
+		"    ./PlaybackStills -d 0 -m 9 -l -r clip.v210\n"
 		);
 }
 
@@ -250,6 +261,8 @@ int main(int argc, char* argv[])
 	int							updateInterval		= 1;
 	bool						convertOutputFormat = false;
 	std::string					playbackDirectory;
+	std::string					clipFile;
+	int							prefetchFrames		= 8;
 
 	HRESULT						result;
 	int							exitStatus = 1;
@@ -261,6 +274,8 @@ int main(int argc, char* argv[])
 	IDeckLink*					deckLink				= NULL;
 	IDeckLinkOutput*			selectedDeckLinkOutput	= NULL;
 	IDeckLinkMutableVideoFrame*	playbackFrame			= NULL;
+	std::shared_ptr<MappedClip>	clip;
+	ClipPlayer*					clipPlayer				= NULL;
 
 	BMDDisplayMode				selectedDisplayMode		= bmdModeNTSC;
 	std::string					selectedDisplayModeName;
@@ -291,6 +306,12 @@ int main(int argc, char* argv[])
 		else if (strcmp(argv[i], "-l") == 0)
 			loopPlayback = true;
 
+		else if (strcmp(argv[i], "-r") == 0)
+			clipFile = argv[++i];
+
+		else if (strcmp(argv[i], "-a") == 0)
+			prefetchFrames = atoi(argv[++i]);
+
 		else if ((strcmp(argv[i], "?") == 0) || (strcmp(argv[i], "-h") == 0))
 			displayHelp = true;
 
@@ -300,7 +321,21 @@ int main(int argc, char* argv[])
 		}
 	}
 
-	if (playbackDirectory.empty())
+	if (!clipFile.empty())
+	{
+		struct stat clipStat;
+		if ((stat(clipFile.c_str(), &clipStat) != 0) || ((clipStat.st_mode & S_IFMT) != S_IFREG))
+		{
+			fprintf(stderr, "Invalid clip file specified\n");
+			displayHelp = true;
+		}
+		if (prefetchFrames < 0)
+		{
+			fprintf(stderr, "Invalid number of prefetch frames\n");
+			displayHelp = true;
+		}
+	}
+	else if (playbackDirectory.empty())
 	{
 		fprintf(stderr, "You must set a playback directory\n");
 		displayHelp = true;
@@ -423,13 +458,13 @@ int main(int argc, char* argv[])
 			if (result != S_OK)
 				goto bail;
 
-			// Check display mode is supported with given options
-			result = selectedDeckLinkOutput->DoesSupportVideoMode(bmdVideoConnectionUnspecified, selectedDisplayMode, ImageLoader::kImageLoaderPixelFormat, bmdNoVideoOutputConversion, bmdSupportedVideoModeDefault, NULL, &displayModeSupported);
+			// Check display mode is supported with given options, clip frames are played as they are
+			result = selectedDeckLinkOutput->DoesSupportVideoMode(bmdVideoConnectionUnspecified, selectedDisplayMode, clipFile.empty() ? ImageLoader::kImageLoaderPixelFormat : kClipPixelFormat, bmdNoVideoOutputConversion, bmdSupportedVideoModeDefault, NULL, &displayModeSupported);
 			if ((result != S_OK) || (!displayModeSupported))
 			{
 				// Video mode is unsupported, check whether we can support with format conversion
 				result = selectedDeckLinkOutput->DoesSupportVideoMode(bmdVideoConnectionUnspecified, selectedDisplayMode, kConvertedPixelFormat, bmdNoVideoOutputConversion, bmdSupportedVideoModeDefault, nullptr, &displayModeSupported);
-				if ((result != S_OK) || (!displayModeSupported))
+				if ((result != S_OK) || (!displayModeSupported) || (!clipFile.empty()))
 				{
 					fprintf(stderr, "The display mode %s is not supported by device\n", selectedDisplayModeName.c_str());
 					displayHelp = true;
@@ -455,6 +490,51 @@ int main(int argc, char* argv[])
 		fprintf(stderr, "Unable to enable video output\n");
 		goto bail;
 	}
+
+	if (!clipFile.empty())
+	{
+		long	width = displayModes[displayModeIndex]->GetWidth();
+		long	height = displayModes[displayModeIndex]->GetHeight();
+		// Refer to DeckLink SDK Manual - 2.7.4 Pixel Formats
+		long	rowBytes = ((width + 47) / 48) * 128;
+
+		clip = std::make_shared<MappedClip>();
+		result = clip->Open(clipFile, width, height, rowBytes, kClipPixelFormat, prefetchFrames);
+		if (result != S_OK)
+			goto bail;
+
+		fprintf(stderr, "Output with the following configuration:\n"
+			" - Playback device: %s\n"
+			" - Video mode: %s\n"
+			" - Loop Playback: %s\n"
+			" - Clip file: %s\n"
+			" - Number of frames to playback: %llu\n"
+			" - Prefetch frames: %d\n",
+			deckLinkDeviceNames[deckLinkIndex].c_str(),
+			selectedDisplayModeName.c_str(),
+			loopPlayback ? "YES" : "NO",
+			clipFile.c_str(),
+			(unsigned long long)clip->GetFrameCount(),
+			prefetchFrames
+			);
+		fprintf(stderr, "Starting Playback, press <RETURN> to exit\n");
+
+		clipPlayer = new ClipPlayer(selectedDeckLinkOutput, clip, frameDuration, frameTimescale, loopPlayback);
+		result = clipPlayer->Start(kClipPrerollFrames);
+		if (result == S_OK)
+			getchar();
+
+		clipPlayer->Stop();
+		fprintf(stderr, "Stopping Playback - %llu frames scheduled, %llu late, %llu dropped\n",
+			(unsigned long long)clipPlayer->GetFramesScheduled(),
+			(unsigned long long)clipPlayer->GetFramesLate(),
+			(unsigned long long)clipPlayer->GetFramesDropped());
+
+		selectedDeckLinkOutput->DisableVideoOutput();
+		if (result == S_OK)
+			exitStatus = 0;
+		goto bail;
+	}
 	
 	// Create video frame for playback, as we are outputting frame synchronously, 
 	// then we can reuse without waiting on callback 
@@ -522,6 +602,12 @@ bail:
 		playbackFrame = NULL;
 	}
 
+	if (clipPlayer != NULL)
+	{
+		clipPlayer->Release();
+		clipPlayer = NULL;
+	}
+
 	if (selectedDeckLinkOutput != NULL)
 	{
 		selectedDeckLinkOutput->Release();
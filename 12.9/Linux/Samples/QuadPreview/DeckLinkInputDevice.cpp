@@ -112,9 +112,13 @@ ULONG DeckLinkInputDevice::Release(void)
 
 // IDeckLinkInputCallback methods
 
-HRESULT DeckLinkInputDevice::VideoInputFrameArrived(IDeckLinkVideoInputFrame* /* videoFrame */, IDeckLinkAudioInputPacket* /* audioPacket */)
+HRESULT DeckLinkInputDevice::VideoInputFrameArrived(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkAudioInputPacket* /* audioPacket */)
 {
-	// Since this application only previews, everything is driven from IDeckLinkScreenPreviewCallback::DrawFrame
+	// The windowed preview is driven from IDeckLinkScreenPreviewCallback::DrawFrame,
+	// the headless multiviewer takes frames from here
+	if (videoFrame && m_frameArrivedHandler)
+		m_frameArrivedHandler(videoFrame);
+
 	return S_OK;
 }
 
@@ -41,6 +41,7 @@
 #pragma once
 
 #include <atomic>
+#include <functional>
 #include <QString>
 #include "QuadPreviewEvents.h"
 #include <DeckLinkAPI.h>
@@ -50,6 +51,7 @@ class DeckLinkInputDevice : public IDeckLinkInputCallback
 {
 public:
 	using DeckLinkDisplayModeQueryFunc = std::function<void(IDeckLinkDisplayMode*)>;
+	using DeckLinkFrameArrivedFunc = std::function<void(IDeckLinkVideoInputFrame*)>;
 
 	DeckLinkInputDevice(QObject* parent, com_ptr<IDeckLink>& deckLink);
 	virtual ~DeckLinkInputDevice();
@@ -77,6 +79,9 @@ public:
 	void								querySupportedVideoModes(DeckLinkDisplayModeQueryFunc func);
 	HRESULT								setInputVideoConnection(BMDVideoConnection connection);
 
+	// Called on the capture thread for every frame, set before starting capture
+	void								setFrameArrivedHandler(const DeckLinkFrameArrivedFunc& func) { m_frameArrivedHandler = func; }
+
 	com_ptr<IDeckLink>					getDeckLinkInstance(void) const { return m_deckLink; }
 	com_ptr<IDeckLinkInput>				getDeckLinkInput(void) const { return m_deckLinkInput; }
 	com_ptr<IDeckLinkConfiguration>		getDeckLinkConfiguration(void) const { return m_deckLinkConfig; }
@@ -95,6 +100,7 @@ private:
 	bool								m_lastValidFrameStatus;
 	int64_t								m_supportedInputConnections;
 	BMDVideoConnection					m_selectedInputConnection;
+	DeckLinkFrameArrivedFunc			m_frameArrivedHandler;
 	//
 };
 
@@ -49,8 +49,10 @@
 
 DeckLinkPreviewOverlay::DeckLinkPreviewOverlay(QObject *parent) :
 	QObject(parent),
+	m_signalValid(false),
 	m_enableTimecode(false),
-	m_enableDeviceLabel(false)
+	m_enableDeviceLabel(false),
+	m_layoutChanged(true)
 {
 }
 
@@ -62,7 +64,10 @@ void DeckLinkPreviewOverlay::setFrame(com_ptr<IDeckLinkVideoFrame> frame)
 
 		if (frame)
 		{
-			m_signalValid = (frame->GetFlags() & bmdFrameHasNoInputSource) == 0;
+			bool signalValid = (frame->GetFlags() & bmdFrameHasNoInputSource) == 0;
+			if (signalValid != m_signalValid)
+				m_layoutChanged = true;
+			m_signalValid = signalValid;
 
 			if (m_signalValid)
 			{
@@ -95,6 +100,8 @@ void DeckLinkPreviewOverlay::clear()
 {
 	{
 		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_signalValid)
+			m_layoutChanged = true;
 		m_signalValid = false;
 	}
 }
@@ -104,6 +111,7 @@ void DeckLinkPreviewOverlay::setDeviceLabel(const QString& label)
 	{
 		std::lock_guard<std::mutex> lock(m_mutex);
 		m_deviceLabel = label;
+		m_layoutChanged = true;
 	}
 
 	if (m_enableDeviceLabel)
@@ -115,6 +123,7 @@ void DeckLinkPreviewOverlay::enableTimecode(bool enable)
 	{
 		std::lock_guard<std::mutex> lock(m_mutex);
 		m_enableTimecode = enable;
+		m_layoutChanged = true;
 	}
 	emit updatePreview();
 }
@@ -124,10 +133,36 @@ void DeckLinkPreviewOverlay::enableDeviceLabel(bool enable)
 	{
 		std::lock_guard<std::mutex> lock(m_mutex);
 		m_enableDeviceLabel = enable;
+		m_layoutChanged = true;
 	}
 	emit updatePreview();
 }
 
+QRect DeckLinkPreviewOverlay::takeDirtyRect(QPaintDevice* paintDevice)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_layoutChanged)
+	{
+		m_layoutChanged = false;
+		return QRect(0, 0, paintDevice->width(), paintDevice->height());
+	}
+
+	if (m_enableTimecode)
+		return timecodeRect(paintDevice);
+
+	return QRect();
+}
+
+QRect DeckLinkPreviewOverlay::timecodeRect(QPaintDevice* paintDevice)
+{
+	QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+	font.setPixelSize(paintDevice->height() / 16);
+	QFontMetrics metrics(font, paintDevice);
+
+	return QRect(0, paintDevice->height() - (metrics.height() + 4), paintDevice->width(), metrics.height() + 4);
+}
+
 bool DeckLinkPreviewOverlay::signalValid()
 {
 	std::lock_guard<std::mutex> lock(m_mutex);
@@ -172,7 +207,7 @@ void DeckLinkPreviewOverlay::paint(QPaintDevice* paintDevice)
 			font.setPixelSize(paintDevice->height() / 16);
 			QFontMetrics metrics(font, paintDevice);
 
-			QRect box(0, paintDevice->height() - (metrics.height() + 4), paintDevice->width(), metrics.height() + 4);
+			QRect box = timecodeRect(paintDevice);
 			painter.fillRect(box, brush);
 			painter.setPen(QColor(Qt::white));
 			painter.setFont(font);
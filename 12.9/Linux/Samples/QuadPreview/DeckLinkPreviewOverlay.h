@@ -42,6 +42,7 @@
 
 #include <QObject>
 #include <QPaintDevice>
+#include <QRect>
 #include <mutex>
 
 #include "com_ptr.h"
@@ -62,12 +63,16 @@ public:
 	void enableDeviceLabel(bool enable);
 	bool signalValid(void);
 
+	// Area changed since the previous call: just the timecode box while nothing else changes
+	QRect takeDirtyRect(QPaintDevice* paintDevice);
 	void paint(QPaintDevice* paintDevice);
 
 signals:
 	void updatePreview();
 
 private:
+	QRect timecodeRect(QPaintDevice* paintDevice);
+
 	std::mutex								m_mutex;
 
 	QString									m_timecode;
@@ -76,5 +81,6 @@ private:
 
 	bool									m_enableTimecode;
 	bool									m_enableDeviceLabel;
+	bool									m_layoutChanged;
 };
 
@@ -0,0 +1,496 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <QCoreApplication>
+#include <QPainter>
+
+#include "platform.h"
+#include "QuadPreviewEvents.h"
+#include "HeadlessMultiviewer.h"
+
+namespace
+{
+	const uint32_t	kSharedMemoryMagic		= 0x4D565348;	// 'MVSH'
+	const uint32_t	kSharedMemoryVersion	= 2;
+	const uint32_t	kSharedMemorySlotCount	= 3;
+	const uint32_t	kSharedMemoryHeaderSize	= 4096;
+
+	static_assert(kSharedMemorySlotCount <= kMultiviewSharedMemoryMaxSlots, "Too many shared memory slots");
+	static_assert(sizeof(MultiviewSharedMemoryHeader) <= kSharedMemoryHeaderSize, "Shared memory header does not fit");
+
+	long canvasRowBytes(int width, BMDPixelFormat pixelFormat)
+	{
+		if (pixelFormat == bmdFormat10BitYUV)
+			return ((width + 47) / 48) * 128;
+		return width * 4;
+	}
+}
+
+// Destination of composited canvas frames.  beginFrame() returns the buffer to
+// composite into, endFrame() publishes it.
+class MultiviewSink
+{
+public:
+	virtual ~MultiviewSink() {}
+
+	virtual bool	open(int width, int height, BMDPixelFormat pixelFormat, long rowBytes) = 0;
+	virtual void*	beginFrame(void) = 0;
+	virtual void	endFrame(void) = 0;
+};
+
+namespace
+{
+	// Appends raw canvas frames to a file
+	class FileSink : public MultiviewSink
+	{
+	public:
+		FileSink(const QString& path) : m_path(path), m_file(nullptr) {}
+		virtual ~FileSink()
+		{
+			if (m_file)
+				fclose(m_file);
+		}
+
+		bool open(int /* width */, int height, BMDPixelFormat /* pixelFormat */, long rowBytes) override
+		{
+			m_file = fopen(m_path.toUtf8().constData(), "wb");
+			if (!m_file)
+				return false;
+
+			m_canvas.resize(rowBytes * height);
+			return true;
+		}
+
+		void* beginFrame(void) override { return m_canvas.data(); }
+
+		void endFrame(void) override
+		{
+			if (fwrite(m_canvas.data(), 1, m_canvas.size(), m_file) != m_canvas.size())
+				fprintf(stderr, "Could not write canvas frame to %s\n", m_path.toUtf8().constData());
+		}
+
+	private:
+		QString					m_path;
+		FILE*					m_file;
+		std::vector<uint8_t>	m_canvas;
+	};
+
+	// Publishes canvas frames to a POSIX shared memory ring, see MultiviewSharedMemoryHeader
+	class SharedMemorySink : public MultiviewSink
+	{
+	public:
+		SharedMemorySink(const QString& name) : m_name(name.toUtf8()), m_mapping(MAP_FAILED), m_mappingSize(0), m_header(nullptr), m_frameSize(0) {}
+		virtual ~SharedMemorySink()
+		{
+			if (m_mapping != MAP_FAILED)
+			{
+				munmap(m_mapping, m_mappingSize);
+				shm_unlink(m_name.constData());
+			}
+		}
+
+		bool open(int width, int height, BMDPixelFormat pixelFormat, long rowBytes) override
+		{
+			m_frameSize = (size_t)rowBytes * height;
+			m_mappingSize = kSharedMemoryHeaderSize + m_frameSize * kSharedMemorySlotCount;
+
+			int fd = shm_open(m_name.constData(), O_CREAT | O_RDWR, 0644);
+			if (fd < 0)
+				return false;
+
+			if (ftruncate(fd, m_mappingSize) != 0)
+			{
+				close(fd);
+				return false;
+			}
+
+			m_mapping = mmap(nullptr, m_mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			close(fd);
+			if (m_mapping == MAP_FAILED)
+				return false;
+
+			m_header = new (m_mapping) MultiviewSharedMemoryHeader;
+			m_header->magic			= kSharedMemoryMagic;
+			m_header->version		= kSharedMemoryVersion;
+			m_header->width			= width;
+			m_header->height		= height;
+			m_header->pixelFormat	= pixelFormat;
+			m_header->rowBytes		= rowBytes;
+			m_header->slotCount		= kSharedMemorySlotCount;
+			m_header->headerSize	= kSharedMemoryHeaderSize;
+			for (uint32_t slot = 0; slot < kMultiviewSharedMemoryMaxSlots; slot++)
+				m_header->slotSequence[slot].store(0, std::memory_order_relaxed);
+			m_header->frameCount.store(0, std::memory_order_release);
+			return true;
+		}
+
+		void* beginFrame(void) override
+		{
+			uint64_t	frame	= m_header->frameCount.load(std::memory_order_relaxed);
+			uint64_t	slot	= frame % kSharedMemorySlotCount;
+
+			// An odd sequence marks the slot as being written
+			m_header->slotSequence[slot].store(frame * 2 + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			return (uint8_t*)m_mapping + kSharedMemoryHeaderSize + slot * m_frameSize;
+		}
+
+		void endFrame(void) override
+		{
+			uint64_t	frame	= m_header->frameCount.load(std::memory_order_relaxed);
+			uint64_t	slot	= frame % kSharedMemorySlotCount;
+
+			m_header->slotSequence[slot].store(frame * 2 + 2, std::memory_order_release);
+			m_header->frameCount.store(frame + 1, std::memory_order_release);
+		}
+
+	private:
+		QByteArray						m_name;
+		void*							m_mapping;
+		size_t							m_mappingSize;
+		MultiviewSharedMemoryHeader*	m_header;
+		size_t							m_frameSize;
+	};
+
+	// Plays canvas frames out of a DeckLink device, alternating between two frames
+	class DeviceSink : public MultiviewSink
+	{
+	public:
+		DeviceSink(com_ptr<IDeckLink>& deckLink, BMDDisplayMode displayMode) :
+			m_deckLinkOutput(IID_IDeckLinkOutput, deckLink), m_displayMode(displayMode), m_outputEnabled(false), m_nextFrame(0) {}
+		virtual ~DeviceSink()
+		{
+			if (m_outputEnabled)
+				m_deckLinkOutput->DisableVideoOutput();
+		}
+
+		bool open(int width, int height, BMDPixelFormat pixelFormat, long rowBytes) override
+		{
+			if (!m_deckLinkOutput)
+				return false;
+
+			if (m_deckLinkOutput->EnableVideoOutput(m_displayMode, bmdVideoOutputFlagDefault) != S_OK)
+				return false;
+
+			m_outputEnabled = true;
+
+			for (auto& frame : m_frames)
+			{
+				if (m_deckLinkOutput->CreateVideoFrame(width, height, rowBytes, pixelFormat, bmdFrameFlagDefault, frame.releaseAndGetAddressOf()) != S_OK)
+					return false;
+			}
+
+			return true;
+		}
+
+		void* beginFrame(void) override
+		{
+			void* bytes = nullptr;
+			m_frames[m_nextFrame]->GetBytes(&bytes);
+			return bytes;
+		}
+
+		void endFrame(void) override
+		{
+			m_deckLinkOutput->DisplayVideoFrameSync(m_frames[m_nextFrame].get());
+			m_nextFrame ^= 1;
+		}
+
+	private:
+		com_ptr<IDeckLinkOutput>				m_deckLinkOutput;
+		BMDDisplayMode							m_displayMode;
+		bool									m_outputEnabled;
+		com_ptr<IDeckLinkMutableVideoFrame>		m_frames[2];
+		int										m_nextFrame;
+	};
+}
+
+HeadlessMultiviewer::HeadlessMultiviewer(const Settings& settings, QObject* parent) :
+	QObject(parent),
+	m_settings(settings),
+	m_stopRequested(false)
+{
+}
+
+HeadlessMultiviewer::~HeadlessMultiviewer()
+{
+	stop();
+}
+
+bool HeadlessMultiviewer::openInputs()
+{
+	IDeckLinkIterator*	deckLinkIterator = CreateDeckLinkIteratorInstance();
+	com_ptr<IDeckLink>	deckLink;
+	int					deviceIndex = 0;
+
+	if (!deckLinkIterator)
+	{
+		fprintf(stderr, "This application requires the DeckLink drivers installed.\n");
+		return false;
+	}
+
+	while (deckLinkIterator->Next(deckLink.releaseAndGetAddressOf()) == S_OK)
+	{
+		int index = deviceIndex++;
+
+		if (m_settings.sinkType == SinkType::Device && index == m_settings.outputDeviceIndex)
+		{
+			com_ptr<IDeckLinkOutput>		deckLinkOutput(IID_IDeckLinkOutput, deckLink);
+			com_ptr<IDeckLinkDisplayMode>	displayMode;
+			BMDTimeValue					frameDuration;
+			BMDTimeScale					timeScale;
+
+			if (!deckLinkOutput || deckLinkOutput->GetDisplayMode(m_settings.outputDisplayMode, displayMode.releaseAndGetAddressOf()) != S_OK)
+			{
+				fprintf(stderr, "Output device %d does not support the requested display mode\n", index);
+				return false;
+			}
+
+			// The canvas matches the output display mode
+			displayMode->GetFrameRate(&frameDuration, &timeScale);
+			m_settings.canvasWidth = (int)displayMode->GetWidth();
+			m_settings.canvasHeight = (int)displayMode->GetHeight();
+			m_settings.frameRate = (double)timeScale / frameDuration;
+
+			m_sink.reset(new DeviceSink(deckLink, m_settings.outputDisplayMode));
+			continue;
+		}
+
+		if ((int)m_inputs.size() >= m_settings.maxInputs)
+			continue;
+
+		com_ptr<DeckLinkInputDevice> device = make_com_ptr<DeckLinkInputDevice>(this, deckLink);
+		if (!device->initialize() || !device->isActive())
+			continue;
+
+		std::unique_ptr<Input> input(new Input);
+		input->device = device;
+		input->overlayDirty = true;
+		m_inputs.push_back(std::move(input));
+	}
+
+	deckLinkIterator->Release();
+
+	if (m_inputs.empty())
+	{
+		fprintf(stderr, "No active DeckLink input devices found\n");
+		return false;
+	}
+
+	if (m_settings.sinkType == SinkType::Device && !m_sink)
+	{
+		fprintf(stderr, "Output device %d not found\n", m_settings.outputDeviceIndex);
+		return false;
+	}
+
+	return true;
+}
+
+bool HeadlessMultiviewer::start()
+{
+	int tileWidth;
+	int tileHeight;
+
+	if (!openInputs())
+		return false;
+
+	if (m_settings.sinkType == SinkType::File)
+		m_sink.reset(new FileSink(m_settings.sinkName));
+	else if (m_settings.sinkType == SinkType::SharedMemory)
+		m_sink.reset(new SharedMemorySink(m_settings.sinkName));
+
+	m_compositor.reset(new MultiviewCompositor(m_settings.threadCount));
+	if (!m_compositor->configure(m_settings.canvasWidth, m_settings.canvasHeight, m_settings.canvasFormat, (int)m_inputs.size(), m_settings.filter))
+	{
+		fprintf(stderr, "Invalid canvas size or format for %d inputs\n", (int)m_inputs.size());
+		return false;
+	}
+
+	if (!m_sink->open(m_settings.canvasWidth, m_settings.canvasHeight, m_settings.canvasFormat, canvasRowBytes(m_settings.canvasWidth, m_settings.canvasFormat)))
+	{
+		fprintf(stderr, "Could not open multiview output\n");
+		return false;
+	}
+
+	m_compositor->getTileSize(tileWidth, tileHeight);
+
+	for (auto& input : m_inputs)
+	{
+		Input*	inputPtr = input.get();
+		QString	deviceName;
+
+		input->device->getDeviceName(deviceName);
+
+		// Overlays are painted in software into a transparent tile sized image
+		input->overlay.reset(new DeckLinkPreviewOverlay);
+		input->overlay->setDeviceLabel(deviceName);
+		input->overlay->enableTimecode(m_settings.showTimecode);
+		input->overlay->enableDeviceLabel(m_settings.showDeviceLabels);
+		input->overlayImage = QImage(tileWidth, tileHeight, QImage::Format_ARGB32_Premultiplied);
+		connect(input->overlay.get(), &DeckLinkPreviewOverlay::updatePreview, [inputPtr]() { inputPtr->overlayDirty = true; });
+
+		input->device->setFrameArrivedHandler([this, inputPtr](IDeckLinkVideoInputFrame* frame)
+		{
+			bool signalValid = (frame->GetFlags() & bmdFrameHasNoInputSource) == 0;
+			{
+				std::lock_guard<std::mutex> lock(inputPtr->frameMutex);
+				inputPtr->latestFrame = frame;
+			}
+
+			// Only repaint the overlay when its content can change
+			if (m_settings.showTimecode || signalValid != inputPtr->overlay->signalValid())
+				inputPtr->overlay->setFrame(com_ptr<IDeckLinkVideoFrame>(frame));
+		});
+
+		if (!input->device->startCapture(m_settings.inputDisplayMode, nullptr, input->device->supportsFormatDetection()))
+			fprintf(stderr, "Could not start capture on %s\n", deviceName.toUtf8().constData());
+	}
+
+	m_stopRequested = false;
+	m_compositorThread = std::thread(&HeadlessMultiviewer::compositorThread, this);
+
+	return true;
+}
+
+void HeadlessMultiviewer::stop()
+{
+	m_stopRequested = true;
+	if (m_compositorThread.joinable())
+		m_compositorThread.join();
+
+	for (auto& input : m_inputs)
+	{
+		if (input->device->isCapturing())
+			input->device->stopCapture();
+		input->device->setFrameArrivedHandler(nullptr);
+	}
+
+	m_inputs.clear();
+	m_sink.reset();
+}
+
+void HeadlessMultiviewer::updateOverlay(int tileIndex, Input& input)
+{
+	// While only the timecode changes, just its box is repainted and converted again
+	QRect dirtyRect = input.overlay->takeDirtyRect(&input.overlayImage);
+	if (dirtyRect.isEmpty())
+		return;
+
+	QPainter painter(&input.overlayImage);
+	painter.setCompositionMode(QPainter::CompositionMode_Source);
+	painter.fillRect(dirtyRect, Qt::transparent);
+	painter.end();
+
+	input.overlay->paint(&input.overlayImage);
+	m_compositor->setTileOverlay(tileIndex, (const uint32_t*)input.overlayImage.constBits(), input.overlayImage.bytesPerLine(),
+		dirtyRect.top(), dirtyRect.bottom() + 1);
+}
+
+void HeadlessMultiviewer::compositorThread()
+{
+	using Clock = std::chrono::steady_clock;
+
+	const Clock::duration	framePeriod = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_settings.frameRate));
+	Clock::time_point		nextFrameTime = Clock::now();
+
+	std::vector<com_ptr<IDeckLinkVideoInputFrame>>	frames(m_inputs.size());
+	std::vector<MultiviewCompositor::Frame>			sources(m_inputs.size());
+
+	while (!m_stopRequested)
+	{
+		for (size_t i = 0; i < m_inputs.size(); i++)
+		{
+			Input& input = *m_inputs[i];
+
+			if (input.overlayDirty.exchange(false))
+				updateOverlay((int)i, input);
+
+			{
+				std::lock_guard<std::mutex> lock(input.frameMutex);
+				frames[i] = input.latestFrame;
+			}
+
+			sources[i].bytes = nullptr;
+			if (frames[i] && (frames[i]->GetFlags() & bmdFrameHasNoInputSource) == 0 && frames[i]->GetBytes(&sources[i].bytes) == S_OK)
+			{
+				sources[i].width		= (int)frames[i]->GetWidth();
+				sources[i].height		= (int)frames[i]->GetHeight();
+				sources[i].rowBytes		= frames[i]->GetRowBytes();
+				sources[i].pixelFormat	= frames[i]->GetPixelFormat();
+			}
+		}
+
+		MultiviewCompositor::Frame canvas;
+		canvas.bytes		= m_sink->beginFrame();
+		canvas.width		= m_settings.canvasWidth;
+		canvas.height		= m_settings.canvasHeight;
+		canvas.rowBytes		= canvasRowBytes(m_settings.canvasWidth, m_settings.canvasFormat);
+		canvas.pixelFormat	= m_settings.canvasFormat;
+
+		if (canvas.bytes)
+		{
+			m_compositor->composite(canvas, sources);
+			m_sink->endFrame();
+		}
+
+		// Hand the input frames back to the driver before sleeping
+		for (auto& frame : frames)
+			frame = nullptr;
+
+		nextFrameTime += framePeriod;
+		Clock::time_point now = Clock::now();
+		if (nextFrameTime < now)
+			nextFrameTime = now;
+		else
+			std::this_thread::sleep_until(nextFrameTime);
+	}
+}
+
+void HeadlessMultiviewer::customEvent(QEvent* event)
+{
+	if (event->type() == kErrorRestartingCaptureEvent)
+		fprintf(stderr, "Error restarting capture with the detected input video mode\n");
+}
@@ -0,0 +1,142 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <QImage>
+#include <QObject>
+#include <QString>
+
+#include "com_ptr.h"
+#include "DeckLinkAPI.h"
+#include "DeckLinkInputDevice.h"
+#include "DeckLinkPreviewOverlay.h"
+#include "MultiviewCompositor.h"
+
+// Layout of the shared memory sink.  The header is followed by slotCount canvas
+// frames of rowBytes * height bytes, starting at headerSize.  Frame n (counting from
+// zero) is written to slot (n % slotCount): the writer sets that slot's sequence to
+// the odd value 2n + 1, fills the slot, sets the sequence to 2n + 2 and then sets
+// frameCount to n + 1.
+//
+// To read the most recent frame, load frameCount as n (nothing is published while it
+// is 0) and slotSequence[(n - 1) % slotCount] as s.  If s is not 2n the writer has
+// already moved on, start again.  Otherwise copy the frame, issue an acquire fence and
+// load the slot's sequence again; if it is no longer s the writer lapped the reader
+// during the copy and the copy is torn, start again.
+static const uint32_t kMultiviewSharedMemoryMaxSlots = 8;
+
+struct MultiviewSharedMemoryHeader
+{
+	uint32_t				magic;			// 'MVSH'
+	uint32_t				version;
+	uint32_t				width;
+	uint32_t				height;
+	uint32_t				pixelFormat;
+	uint32_t				rowBytes;
+	uint32_t				slotCount;
+	uint32_t				headerSize;
+	std::atomic<uint64_t>	frameCount;
+	std::atomic<uint64_t>	slotSequence[kMultiviewSharedMemoryMaxSlots];
+};
+
+class MultiviewSink;
+
+class HeadlessMultiviewer : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum class SinkType { File, SharedMemory, Device };
+
+	struct Settings
+	{
+		int								maxInputs;
+		BMDDisplayMode					inputDisplayMode;
+		int								canvasWidth;
+		int								canvasHeight;
+		BMDPixelFormat					canvasFormat;
+		MultiviewCompositor::Filter		filter;
+		int								threadCount;
+		double							frameRate;
+		SinkType						sinkType;
+		QString							sinkName;				// File path or shared memory name
+		int								outputDeviceIndex;
+		BMDDisplayMode					outputDisplayMode;
+		bool							showTimecode;
+		bool							showDeviceLabels;
+	};
+
+	HeadlessMultiviewer(const Settings& settings, QObject* parent = nullptr);
+	virtual ~HeadlessMultiviewer();
+
+	bool		start(void);
+	void		stop(void);
+
+protected:
+	void		customEvent(QEvent* event) override;
+
+private:
+	struct Input
+	{
+		com_ptr<DeckLinkInputDevice>				device;
+		std::unique_ptr<DeckLinkPreviewOverlay>		overlay;
+		QImage										overlayImage;
+		std::atomic<bool>							overlayDirty;
+		std::mutex									frameMutex;
+		com_ptr<IDeckLinkVideoInputFrame>			latestFrame;
+	};
+
+	bool		openInputs(void);
+	void		compositorThread(void);
+	void		updateOverlay(int tileIndex, Input& input);
+
+	Settings										m_settings;
+	std::vector<std::unique_ptr<Input>>				m_inputs;
+	std::unique_ptr<MultiviewCompositor>			m_compositor;
+	std::unique_ptr<MultiviewSink>					m_sink;
+	std::thread										m_compositorThread;
+	std::atomic<bool>								m_stopRequested;
+};
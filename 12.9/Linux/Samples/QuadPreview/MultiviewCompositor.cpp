@@ -0,0 +1,595 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "MultiviewCompositor.h"
+
+namespace
+{
+	const int		kBandRows			= 16;
+	const int		kMaxBoxRows			= 64;		// Keeps 16-bit row sums of 10-bit samples from overflowing
+	const int		kBilinearShift		= 6;
+
+	const uint16_t	kBlackLuma			= 64;
+	const uint16_t	kBlackChroma		= 512;
+
+	// Vertical filter kernels, operating on planar rows of 10-bit samples
+
+	void blendRows(const uint16_t* a, const uint16_t* b, uint16_t weightB, uint16_t* out, int count)
+	{
+		const uint16_t weightA = (1 << kBilinearShift) - weightB;
+		int i = 0;
+#if defined(__SSE2__)
+		const __m128i wa = _mm_set1_epi16((short)weightA);
+		const __m128i wb = _mm_set1_epi16((short)weightB);
+		for (; i + 8 <= count; i += 8)
+		{
+			__m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+			__m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+			__m128i v = _mm_add_epi16(_mm_mullo_epi16(va, wa), _mm_mullo_epi16(vb, wb));
+			_mm_storeu_si128((__m128i*)(out + i), _mm_srli_epi16(v, kBilinearShift));
+		}
+#elif defined(__ARM_NEON)
+		const uint16x8_t wa = vdupq_n_u16(weightA);
+		const uint16x8_t wb = vdupq_n_u16(weightB);
+		for (; i + 8 <= count; i += 8)
+		{
+			uint16x8_t v = vmlaq_u16(vmulq_u16(vld1q_u16(a + i), wa), vld1q_u16(b + i), wb);
+			vst1q_u16(out + i, vshrq_n_u16(v, kBilinearShift));
+		}
+#endif
+		for (; i < count; i++)
+			out[i] = (uint16_t)((a[i] * weightA + b[i] * weightB) >> kBilinearShift);
+	}
+
+	void accumulateRow(uint16_t* sum, const uint16_t* row, int count)
+	{
+		int i = 0;
+#if defined(__SSE2__)
+		for (; i + 8 <= count; i += 8)
+		{
+			__m128i v = _mm_add_epi16(_mm_loadu_si128((const __m128i*)(sum + i)), _mm_loadu_si128((const __m128i*)(row + i)));
+			_mm_storeu_si128((__m128i*)(sum + i), v);
+		}
+#elif defined(__ARM_NEON)
+		for (; i + 8 <= count; i += 8)
+			vst1q_u16(sum + i, vaddq_u16(vld1q_u16(sum + i), vld1q_u16(row + i)));
+#endif
+		for (; i < count; i++)
+			sum[i] += row[i];
+	}
+
+	// sum = sum * reciprocal / 65536, with reciprocal = 65536 / rowCount
+	void scaleRow(uint16_t* sum, uint16_t reciprocal, int count)
+	{
+		int i = 0;
+#if defined(__SSE2__)
+		const __m128i r = _mm_set1_epi16((short)reciprocal);
+		for (; i + 8 <= count; i += 8)
+			_mm_storeu_si128((__m128i*)(sum + i), _mm_mulhi_epu16(_mm_loadu_si128((const __m128i*)(sum + i)), r));
+#elif defined(__ARM_NEON)
+		const uint16x4_t r = vdup_n_u16(reciprocal);
+		for (; i + 8 <= count; i += 8)
+		{
+			uint16x8_t v = vld1q_u16(sum + i);
+			uint16x4_t lo = vshrn_n_u32(vmull_u16(vget_low_u16(v), r), 16);
+			uint16x4_t hi = vshrn_n_u32(vmull_u16(vget_high_u16(v), r), 16);
+			vst1q_u16(sum + i, vcombine_u16(lo, hi));
+		}
+#endif
+		for (; i < count; i++)
+			sum[i] = (uint16_t)(((uint32_t)sum[i] * reciprocal) >> 16);
+	}
+
+	// Unpack a source row to planar luma and interleaved CbCr, both one sample per pixel
+	void unpackRow(const MultiviewCompositor::Frame& source, int row, uint16_t* y, uint16_t* c)
+	{
+		const uint8_t* bytes = (const uint8_t*)source.bytes + (long)row * source.rowBytes;
+
+		if (source.pixelFormat == bmdFormat10BitYUV)
+		{
+			const uint32_t* words = (const uint32_t*)bytes;
+			int groups = (source.width + 5) / 6;
+			for (int g = 0; g < groups; g++, words += 4, y += 6, c += 6)
+			{
+				uint32_t w0 = words[0], w1 = words[1], w2 = words[2], w3 = words[3];
+				c[0] = w0 & 0x3FF;	y[0] = (w0 >> 10) & 0x3FF;	c[1] = (w0 >> 20) & 0x3FF;
+				y[1] = w1 & 0x3FF;	c[2] = (w1 >> 10) & 0x3FF;	y[2] = (w1 >> 20) & 0x3FF;
+				c[3] = w2 & 0x3FF;	y[3] = (w2 >> 10) & 0x3FF;	c[4] = (w2 >> 20) & 0x3FF;
+				y[4] = w3 & 0x3FF;	c[5] = (w3 >> 10) & 0x3FF;	y[5] = (w3 >> 20) & 0x3FF;
+			}
+		}
+		else
+		{
+			// 2vuy: Cb Y0 Cr Y1
+			int pairs = source.width / 2;
+			for (int p = 0; p < pairs; p++, bytes += 4, y += 2, c += 2)
+			{
+				c[0] = (uint16_t)(bytes[0] << 2);
+				y[0] = (uint16_t)(bytes[1] << 2);
+				c[1] = (uint16_t)(bytes[2] << 2);
+				y[1] = (uint16_t)(bytes[3] << 2);
+			}
+		}
+	}
+
+	void computeTaps(std::vector<MultiviewCompositor::Tap>& taps, int sourceSize, int destSize, MultiviewCompositor::Filter filter, int maxBoxSamples)
+	{
+		taps.resize(destSize);
+
+		for (int d = 0; d < destSize; d++)
+		{
+			MultiviewCompositor::Tap& tap = taps[d];
+
+			if (filter == MultiviewCompositor::Filter::Bilinear || destSize >= sourceSize)
+			{
+				double position = (d + 0.5) * sourceSize / destSize - 0.5;
+				int index = std::max(0, std::min(sourceSize - 1, (int)std::floor(position)));
+				double fraction = std::max(0.0, std::min(1.0, position - index));
+
+				tap.index	= index;
+				tap.count	= (index + 1 < sourceSize) ? 2 : 1;
+				tap.step	= 1;
+				tap.weight	= (tap.count == 2) ? (uint32_t)std::lround(fraction * (1 << kBilinearShift)) : 0;
+			}
+			else
+			{
+				int start	= (int)((int64_t)d * sourceSize / destSize);
+				int end		= std::max(start + 1, (int)((int64_t)(d + 1) * sourceSize / destSize));
+				int step	= (end - start + maxBoxSamples - 1) / maxBoxSamples;
+
+				tap.index	= start;
+				tap.step	= step;
+				tap.count	= (end - start + step - 1) / step;
+				tap.weight	= 65536 / tap.count;
+			}
+		}
+	}
+
+	// Resample one plane of a vertically filtered row to the tile width
+	void resampleColumns(const std::vector<MultiviewCompositor::Tap>& taps, bool box,
+						 const uint16_t* in, int inStride, int inCount, uint32_t* prefix, uint16_t* out, int outStride)
+	{
+		if (box)
+		{
+			prefix[0] = 0;
+			for (int i = 0; i < inCount; i++)
+				prefix[i + 1] = prefix[i] + in[i * inStride];
+
+			for (size_t d = 0; d < taps.size(); d++)
+			{
+				const MultiviewCompositor::Tap& tap = taps[d];
+				uint32_t sum = prefix[tap.index + tap.count * tap.step] - prefix[tap.index];
+				out[d * outStride] = (uint16_t)(((uint64_t)sum * tap.weight / tap.step) >> 16);
+			}
+		}
+		else
+		{
+			for (size_t d = 0; d < taps.size(); d++)
+			{
+				const MultiviewCompositor::Tap& tap = taps[d];
+				uint32_t a = in[tap.index * inStride];
+				uint32_t b = (tap.count == 2) ? in[(tap.index + 1) * inStride] : a;
+				out[d * outStride] = (uint16_t)((a * ((1 << kBilinearShift) - tap.weight) + b * tap.weight) >> kBilinearShift);
+			}
+		}
+	}
+
+	void writeBlackV210(uint32_t* words, int groups)
+	{
+		for (int g = 0; g < groups; g++, words += 4)
+		{
+			words[0] = kBlackChroma | (kBlackLuma << 10) | (kBlackChroma << 20);
+			words[1] = kBlackLuma | (kBlackChroma << 10) | (kBlackLuma << 20);
+			words[2] = words[0];
+			words[3] = words[1];
+		}
+	}
+
+	void writeBlackBGRA(uint32_t* pixels, int count)
+	{
+		for (int i = 0; i < count; i++)
+			pixels[i] = 0xFF000000;
+	}
+
+	inline uint8_t clampToByte(int value)
+	{
+		return (uint8_t)std::max(0, std::min(255, value));
+	}
+}
+
+MultiviewCompositor::MultiviewCompositor(size_t threadCount) :
+	m_workerPool(new WorkerPool(std::max<size_t>(1, threadCount))),
+	m_canvasWidth(0),
+	m_canvasHeight(0),
+	m_canvasFormat(bmdFormat10BitYUV),
+	m_columns(0),
+	m_rows(0),
+	m_tileWidth(0),
+	m_tileHeight(0),
+	m_filter(Filter::Bilinear)
+{
+	m_scratch.resize(m_workerPool->workerCount());
+}
+
+MultiviewCompositor::~MultiviewCompositor()
+{
+}
+
+bool MultiviewCompositor::isSupportedSourceFormat(BMDPixelFormat pixelFormat)
+{
+	return pixelFormat == bmdFormat10BitYUV || pixelFormat == bmdFormat8BitYUV;
+}
+
+bool MultiviewCompositor::configure(int canvasWidth, int canvasHeight, BMDPixelFormat canvasFormat, int tileCount, Filter filter)
+{
+	if (tileCount <= 0 || canvasWidth <= 0 || canvasHeight <= 0)
+		return false;
+
+	if (canvasFormat != bmdFormat10BitYUV && canvasFormat != bmdFormat8BitBGRA)
+		return false;
+
+	m_columns = (int)std::ceil(std::sqrt((double)tileCount));
+	m_rows = (tileCount + m_columns - 1) / m_columns;
+
+	// v210 tiles must start and end on a 6 pixel group, BGRA tiles on a chroma pair
+	int alignment = (canvasFormat == bmdFormat10BitYUV) ? 6 : 2;
+	m_tileWidth = (canvasWidth / m_columns) / alignment * alignment;
+	m_tileHeight = canvasHeight / m_rows;
+
+	if (m_tileWidth <= 0 || m_tileHeight <= 0)
+		return false;
+
+	m_canvasWidth = canvasWidth;
+	m_canvasHeight = canvasHeight;
+	m_canvasFormat = canvasFormat;
+	m_filter = filter;
+
+	m_tiles.clear();
+	m_tiles.resize(tileCount);
+	for (int i = 0; i < tileCount; i++)
+	{
+		Tile& tile = m_tiles[i];
+		tile.x = (i % m_columns) * m_tileWidth;
+		tile.y = (i / m_columns) * m_tileHeight;
+		tile.sourceWidth = 0;
+		tile.sourceHeight = 0;
+		tile.hasOverlay = false;
+	}
+
+	for (auto& scratch : m_scratch)
+	{
+		scratch.outY.resize(m_tileWidth);
+		scratch.outC.resize(m_tileWidth);
+	}
+
+	return true;
+}
+
+void MultiviewCompositor::setTileOverlay(int tileIndex, const uint32_t* argb, long rowBytes, int firstRow, int lastRow)
+{
+	if (tileIndex < 0 || tileIndex >= (int)m_tiles.size())
+		return;
+
+	Tile& tile = m_tiles[tileIndex];
+
+	if (argb == nullptr)
+	{
+		tile.hasOverlay = false;
+		return;
+	}
+
+	size_t pixelCount = (size_t)m_tileWidth * m_tileHeight;
+	if (tile.overlayY.size() != pixelCount)
+	{
+		// The first overlay for a tile is always converted in full
+		tile.overlayY.resize(pixelCount);
+		tile.overlayC.resize(pixelCount);
+		tile.overlayAlphaY.resize(pixelCount);
+		tile.overlayAlphaC.resize(pixelCount);
+		tile.overlayRows.assign(m_tileHeight, 0);
+		firstRow = 0;
+		lastRow = m_tileHeight;
+	}
+
+	firstRow = std::max(firstRow, 0);
+	if (lastRow < 0 || lastRow > m_tileHeight)
+		lastRow = m_tileHeight;
+
+	int bandCount = (lastRow - firstRow + kBandRows - 1) / kBandRows;
+	if (bandCount > 0)
+	{
+		m_workerPool->parallelFor(bandCount, [&](size_t task, size_t)
+		{
+			int bandFirstRow	= firstRow + (int)task * kBandRows;
+			int bandLastRow		= std::min(lastRow, bandFirstRow + kBandRows);
+
+			for (int row = bandFirstRow; row < bandLastRow; row++)
+				convertOverlayRow(tile, (const uint32_t*)((const uint8_t*)argb + row * rowBytes), row);
+		});
+	}
+
+	tile.hasOverlay = std::find(tile.overlayRows.begin(), tile.overlayRows.end(), 1) != tile.overlayRows.end();
+}
+
+void MultiviewCompositor::convertOverlayRow(Tile& tile, const uint32_t* pixels, int row)
+{
+	size_t base = (size_t)row * m_tileWidth;
+
+	tile.overlayRows[row] = 0;
+
+	for (int x = 0; x < m_tileWidth; x += 2)
+	{
+		float	componentY[2];
+		float	componentCb[2];
+		float	componentCr[2];
+		int		alpha[2];
+
+		for (int i = 0; i < 2; i++)
+		{
+			uint32_t	pixel	= pixels[x + i];
+			int			a		= pixel >> 24;
+			// Undo premultiplication, then convert full range RGB to 10-bit Rec.709 video range
+			float		scale	= (a > 0) ? 255.0f / a : 0.0f;
+			float		r		= ((pixel >> 16) & 0xFF) * scale;
+			float		g		= ((pixel >> 8) & 0xFF) * scale;
+			float		b		= (pixel & 0xFF) * scale;
+
+			alpha[i]		= a + (a >> 7);
+			componentY[i]	= 64.0f + (876.0f / 255.0f) * (0.2126f * r + 0.7152f * g + 0.0722f * b);
+			componentCb[i]	= 512.0f + (896.0f / 255.0f) * (-0.1146f * r - 0.3854f * g + 0.5f * b);
+			componentCr[i]	= 512.0f + (896.0f / 255.0f) * (0.5f * r - 0.4542f * g - 0.0458f * b);
+
+			tile.overlayY[base + x + i] = (uint16_t)std::lround(componentY[i]);
+			tile.overlayAlphaY[base + x + i] = (uint16_t)alpha[i];
+		}
+
+		int alphaSum = alpha[0] + alpha[1];
+		float cb = 512.0f, cr = 512.0f;
+		if (alphaSum > 0)
+		{
+			cb = (componentCb[0] * alpha[0] + componentCb[1] * alpha[1]) / alphaSum;
+			cr = (componentCr[0] * alpha[0] + componentCr[1] * alpha[1]) / alphaSum;
+			tile.overlayRows[row] = 1;
+		}
+
+		tile.overlayC[base + x]			= (uint16_t)std::lround(cb);
+		tile.overlayC[base + x + 1]		= (uint16_t)std::lround(cr);
+		tile.overlayAlphaC[base + x]		= (uint16_t)(alphaSum / 2);
+		tile.overlayAlphaC[base + x + 1]	= (uint16_t)(alphaSum / 2);
+	}
+}
+
+void MultiviewCompositor::updateTaps(Tile& tile, int sourceWidth, int sourceHeight)
+{
+	if (tile.sourceWidth == sourceWidth && tile.sourceHeight == sourceHeight)
+		return;
+
+	tile.sourceWidth = sourceWidth;
+	tile.sourceHeight = sourceHeight;
+
+	computeTaps(tile.rowTaps, sourceHeight, m_tileHeight, m_filter, kMaxBoxRows);
+	computeTaps(tile.lumaTaps, sourceWidth, m_tileWidth, m_filter, sourceWidth);
+	computeTaps(tile.chromaTaps, sourceWidth / 2, m_tileWidth / 2, m_filter, sourceWidth);
+}
+
+void MultiviewCompositor::composite(const Frame& canvas, const std::vector<Frame>& sources)
+{
+	std::vector<Frame> tileSources(m_tiles.size());
+
+	for (size_t i = 0; i < m_tiles.size(); i++)
+	{
+		if (i < sources.size() && sources[i].bytes != nullptr && isSupportedSourceFormat(sources[i].pixelFormat)
+			&& sources[i].width >= 2 && sources[i].height >= 1)
+		{
+			tileSources[i] = sources[i];
+			updateTaps(m_tiles[i], sources[i].width, sources[i].height);
+		}
+		else
+		{
+			tileSources[i].bytes = nullptr;
+		}
+	}
+
+	for (auto& scratch : m_scratch)
+	{
+		int width = 0;
+		for (auto& source : tileSources)
+		{
+			if (source.bytes != nullptr)
+				width = std::max(width, (source.width + 5) / 6 * 6);
+		}
+
+		if ((int)scratch.filteredY.size() < width)
+		{
+			for (int i = 0; i < 2; i++)
+			{
+				scratch.rowY[i].resize(width);
+				scratch.rowC[i].resize(width);
+			}
+			scratch.filteredY.resize(width);
+			scratch.filteredC.resize(width);
+			scratch.prefix.resize(width + 1);
+		}
+	}
+
+	clearMargins(canvas);
+
+	int bandsPerTile = (m_tileHeight + kBandRows - 1) / kBandRows;
+	m_workerPool->parallelFor(m_tiles.size() * bandsPerTile, [&](size_t task, size_t worker)
+	{
+		size_t	tileIndex	= task / bandsPerTile;
+		int		firstRow	= (int)(task % bandsPerTile) * kBandRows;
+		int		lastRow		= std::min(m_tileHeight, firstRow + kBandRows);
+
+		compositeRows(m_tiles[tileIndex], canvas, tileSources[tileIndex], firstRow, lastRow, m_scratch[worker]);
+	});
+}
+
+void MultiviewCompositor::compositeRows(Tile& tile, const Frame& canvas, const Frame& source, int firstRow, int lastRow, Scratch& scratch)
+{
+	const bool	box			= (m_filter == Filter::Box);
+	uint16_t*	outY		= scratch.outY.data();
+	uint16_t*	outC		= scratch.outC.data();
+
+	for (int row = firstRow; row < lastRow; row++)
+	{
+		if (source.bytes == nullptr)
+		{
+			std::fill(outY, outY + m_tileWidth, kBlackLuma);
+			std::fill(outC, outC + m_tileWidth, kBlackChroma);
+		}
+		else
+		{
+			const Tap&	tap			= tile.rowTaps[row];
+			int			rowWidth	= (source.width + 5) / 6 * 6;
+			uint16_t*	filteredY	= scratch.filteredY.data();
+			uint16_t*	filteredC	= scratch.filteredC.data();
+
+			// Vertical pass
+			if (tap.count == 1)
+			{
+				unpackRow(source, tap.index, filteredY, filteredC);
+			}
+			else if (!box || tile.sourceHeight <= m_tileHeight)
+			{
+				unpackRow(source, tap.index, scratch.rowY[0].data(), scratch.rowC[0].data());
+				unpackRow(source, tap.index + 1, scratch.rowY[1].data(), scratch.rowC[1].data());
+				blendRows(scratch.rowY[0].data(), scratch.rowY[1].data(), (uint16_t)tap.weight, filteredY, rowWidth);
+				blendRows(scratch.rowC[0].data(), scratch.rowC[1].data(), (uint16_t)tap.weight, filteredC, rowWidth);
+			}
+			else
+			{
+				unpackRow(source, tap.index, filteredY, filteredC);
+				for (int i = 1; i < tap.count; i++)
+				{
+					unpackRow(source, tap.index + i * tap.step, scratch.rowY[0].data(), scratch.rowC[0].data());
+					accumulateRow(filteredY, scratch.rowY[0].data(), rowWidth);
+					accumulateRow(filteredC, scratch.rowC[0].data(), rowWidth);
+				}
+				scaleRow(filteredY, (uint16_t)tap.weight, rowWidth);
+				scaleRow(filteredC, (uint16_t)tap.weight, rowWidth);
+			}
+
+			// Horizontal pass, luma then Cb and Cr from the interleaved chroma row
+			bool boxColumns = box && tile.sourceWidth > m_tileWidth;
+			resampleColumns(tile.lumaTaps, boxColumns, filteredY, 1, tile.sourceWidth, scratch.prefix.data(), outY, 1);
+			resampleColumns(tile.chromaTaps, boxColumns, filteredC, 2, tile.sourceWidth / 2, scratch.prefix.data(), outC, 2);
+			resampleColumns(tile.chromaTaps, boxColumns, filteredC + 1, 2, tile.sourceWidth / 2, scratch.prefix.data(), outC + 1, 2);
+		}
+
+		// Overlay, skipping rows with no coverage
+		if (tile.hasOverlay && tile.overlayRows[row])
+		{
+			size_t base = (size_t)row * m_tileWidth;
+			for (int x = 0; x < m_tileWidth; x++)
+			{
+				int alphaY = tile.overlayAlphaY[base + x];
+				int alphaC = tile.overlayAlphaC[base + x];
+				outY[x] = (uint16_t)(outY[x] + (((tile.overlayY[base + x] - outY[x]) * alphaY) >> 8));
+				outC[x] = (uint16_t)(outC[x] + (((tile.overlayC[base + x] - outC[x]) * alphaC) >> 8));
+			}
+		}
+
+		// Pack into the canvas
+		uint8_t* destination = (uint8_t*)canvas.bytes + (long)(tile.y + row) * canvas.rowBytes;
+		if (m_canvasFormat == bmdFormat10BitYUV)
+		{
+			uint32_t* words = (uint32_t*)(destination + (tile.x / 6) * 16);
+			for (int x = 0; x < m_tileWidth; x += 6, words += 4)
+			{
+				const uint16_t* y = outY + x;
+				const uint16_t* c = outC + x;
+				words[0] = c[0] | (y[0] << 10) | (c[1] << 20);
+				words[1] = y[1] | (c[2] << 10) | (y[2] << 20);
+				words[2] = c[3] | (y[3] << 10) | (c[4] << 20);
+				words[3] = y[4] | (c[5] << 10) | (y[5] << 20);
+			}
+		}
+		else
+		{
+			uint8_t* pixel = destination + tile.x * 4;
+			for (int x = 0; x < m_tileWidth; x++, pixel += 4)
+			{
+				// Rec.709 video range to full range RGB, 13-bit fixed point with the 10 to 8-bit shift folded in
+				int y	= (outY[x] - 64) * 9539;
+				int cb	= outC[x & ~1] - 512;
+				int cr	= outC[x | 1] - 512;
+				pixel[0] = clampToByte((y + 17305 * cb) >> 15);
+				pixel[1] = clampToByte((y - 1747 * cb - 4366 * cr) >> 15);
+				pixel[2] = clampToByte((y + 14686 * cr) >> 15);
+				pixel[3] = 0xFF;
+			}
+		}
+	}
+}
+
+void MultiviewCompositor::clearMargins(const Frame& canvas)
+{
+	const int usedWidth		= m_columns * m_tileWidth;
+	const int usedHeight	= m_rows * m_tileHeight;
+
+	for (int row = 0; row < m_canvasHeight; row++)
+	{
+		uint8_t*	destination	= (uint8_t*)canvas.bytes + (long)row * canvas.rowBytes;
+		int			clearFrom	= (row < usedHeight) ? usedWidth : 0;
+
+		// Unused grid cells in the last row of tiles
+		if (row >= (m_rows - 1) * m_tileHeight && row < usedHeight)
+			clearFrom = ((int)m_tiles.size() - (m_rows - 1) * m_columns) * m_tileWidth;
+
+		if (clearFrom >= m_canvasWidth)
+			continue;
+
+		if (m_canvasFormat == bmdFormat10BitYUV)
+			writeBlackV210((uint32_t*)(destination + (clearFrom / 6) * 16), (m_canvasWidth - clearFrom + 5) / 6);
+		else
+			writeBlackBGRA((uint32_t*)destination + clearFrom, m_canvasWidth - clearFrom);
+	}
+}
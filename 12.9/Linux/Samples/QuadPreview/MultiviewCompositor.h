@@ -0,0 +1,143 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "DeckLinkAPI.h"
+#include "WorkerPool.h"
+
+// CPU multiviewer compositor.  Scales N v210 or 2vuy sources into a grid of tiles on
+// a single v210 or BGRA canvas, blending an optional pre-rendered overlay into each
+// tile.  Scaling is separable: source rows are unpacked to planar 10-bit Y and CbCr,
+// filtered vertically with SIMD, then resampled horizontally from precomputed tables.
+// Each tile is split into bands of rows that are processed in parallel.
+class MultiviewCompositor
+{
+public:
+	enum class Filter { Bilinear, Box };
+
+	struct Frame
+	{
+		void*				bytes;
+		int					width;
+		int					height;
+		long				rowBytes;
+		BMDPixelFormat		pixelFormat;
+	};
+
+	// Resampling table entry for one destination row or column
+	struct Tap
+	{
+		int			index;
+		int			count;		// Number of source samples (Bilinear: 1 or 2)
+		int			step;		// Box: distance between sampled rows
+		uint32_t	weight;		// Box: 65536 / count; Bilinear: weight of index + 1 out of 64
+	};
+
+	MultiviewCompositor(size_t threadCount);
+	virtual ~MultiviewCompositor();
+
+	// Lays out tileCount tiles in a near-square grid.  Canvas must be v210 or BGRA.
+	bool		configure(int canvasWidth, int canvasHeight, BMDPixelFormat canvasFormat, int tileCount, Filter filter);
+	int			tileCount(void) const { return (int)m_tiles.size(); }
+	void		getTileSize(int& width, int& height) const { width = m_tileWidth; height = m_tileHeight; }
+
+	// Overlay is a tile sized premultiplied ARGB32 image, converted once and blended on
+	// every composite.  Rows without any coverage are skipped.  Pass nullptr to remove.
+	// Once a tile has an overlay, only rows firstRow to lastRow - 1 are converted again,
+	// in bands on the worker threads; a negative lastRow means the bottom of the tile.
+	void		setTileOverlay(int tile, const uint32_t* argb, long rowBytes, int firstRow = 0, int lastRow = -1);
+
+	// Sources with null bytes, or an unsupported pixel format, are drawn black
+	void		composite(const Frame& canvas, const std::vector<Frame>& sources);
+
+	static bool	isSupportedSourceFormat(BMDPixelFormat pixelFormat);
+
+private:
+	struct Tile
+	{
+		int					x;
+		int					y;
+		int					sourceWidth;
+		int					sourceHeight;
+		std::vector<Tap>	rowTaps;
+		std::vector<Tap>	lumaTaps;
+		std::vector<Tap>	chromaTaps;
+		// Overlay in planar 10-bit YCbCr with 8-bit alpha scaled to 0-256
+		bool					hasOverlay;
+		std::vector<uint8_t>	overlayRows;
+		std::vector<uint16_t>	overlayY;
+		std::vector<uint16_t>	overlayC;
+		std::vector<uint16_t>	overlayAlphaY;
+		std::vector<uint16_t>	overlayAlphaC;
+	};
+
+	struct Scratch
+	{
+		std::vector<uint16_t>	rowY[2];
+		std::vector<uint16_t>	rowC[2];
+		std::vector<uint16_t>	filteredY;
+		std::vector<uint16_t>	filteredC;
+		std::vector<uint32_t>	prefix;
+		std::vector<uint16_t>	outY;
+		std::vector<uint16_t>	outC;
+	};
+
+	void		convertOverlayRow(Tile& tile, const uint32_t* pixels, int row);
+	void		updateTaps(Tile& tile, int sourceWidth, int sourceHeight);
+	void		compositeRows(Tile& tile, const Frame& canvas, const Frame& source, int firstRow, int lastRow, Scratch& scratch);
+	void		clearMargins(const Frame& canvas);
+
+	std::unique_ptr<WorkerPool>		m_workerPool;
+	std::vector<Scratch>			m_scratch;
+	std::vector<Tile>				m_tiles;
+	int								m_canvasWidth;
+	int								m_canvasHeight;
+	BMDPixelFormat					m_canvasFormat;
+	int								m_columns;
+	int								m_rows;
+	int								m_tileWidth;
+	int								m_tileHeight;
+	Filter							m_filter;
+};
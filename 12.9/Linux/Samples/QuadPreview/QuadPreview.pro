@@ -53,7 +53,7 @@ win32:INCLUDEPATH += ../../../Win/include
 unix:!mac:INCLUDEPATH += ../../../Linux/include
 
 macx:LIBS += -framework CoreFoundation -framework Cocoa -framework Metal -framework MetalKit
-unix:!mac:LIBS += -ldl
+unix:!mac:LIBS += -ldl -lrt
 win32:LIBS += -lole32 -lopengl32
 
 macx:QMAKE_MACOSX_DEPLOYMENT_TARGET = 10.13
@@ -78,7 +78,9 @@ SOURCES += main.cpp \
         ProfileCallback.cpp \
         ScreenPreviewCallback.cpp \
         platform.cpp \
-        DeckLinkInputPage.cpp
+        DeckLinkInputPage.cpp \
+        MultiviewCompositor.cpp \
+        HeadlessMultiviewer.cpp
 
 unix:!macx:SOURCES += ../../../Linux/include/DeckLinkAPIDispatch.cpp
 macx:SOURCES += ../../../Mac/include/DeckLinkAPIDispatch.cpp
@@ -93,7 +95,10 @@ HEADERS += \
         platform.h \
         com_ptr.h \
         QuadPreviewEvents.h \
-        DeckLinkInputPage.h
+        DeckLinkInputPage.h \
+        WorkerPool.h \
+        MultiviewCompositor.h \
+        HeadlessMultiviewer.h
 
 mac {
         HEADERS +=  DeckLinkMetalMultiViewWidget.h \
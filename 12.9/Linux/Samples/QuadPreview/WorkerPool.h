@@ -0,0 +1,178 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run an indexed batch of tasks (for example the
+// rows or slices of a frame) and return once every task has completed.  The calling
+// thread takes part in the batch, so worker index 0 is always the caller.
+class WorkerPool
+{
+	using TaskFunction = std::function<void(size_t task, size_t worker)>;
+
+public:
+	WorkerPool(size_t numThreads);
+	virtual ~WorkerPool();
+
+	// Number of distinct worker indices passed to tasks, including the calling thread
+	size_t	workerCount(void) const { return m_workerThreads.size() + 1; }
+
+	void	parallelFor(size_t taskCount, const TaskFunction& func);
+
+private:
+	std::vector<std::thread>		m_workerThreads;
+	std::condition_variable			m_startCondition;
+	std::condition_variable			m_doneCondition;
+	std::mutex						m_mutex;
+
+	const TaskFunction*				m_function;
+	size_t							m_taskCount;
+	std::atomic<size_t>				m_nextTask;
+	size_t							m_activeWorkers;
+	uint64_t						m_generation;
+	bool							m_cancelWorkers;
+
+	void	runTasks(size_t worker);
+	void	workerThread(size_t worker);
+};
+
+inline WorkerPool::WorkerPool(size_t numThreads) :
+	m_function(nullptr),
+	m_taskCount(0),
+	m_nextTask(0),
+	m_activeWorkers(0),
+	m_generation(0),
+	m_cancelWorkers(false)
+{
+	for (size_t i = 1; i < numThreads; i++)
+	{
+		m_workerThreads.emplace_back(&WorkerPool::workerThread, this, i);
+	}
+}
+
+inline WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_cancelWorkers = true;
+	}
+	m_startCondition.notify_all();
+
+	for (auto& worker : m_workerThreads)
+	{
+		worker.join();
+	}
+}
+
+inline void WorkerPool::parallelFor(size_t taskCount, const TaskFunction& func)
+{
+	if (taskCount == 0)
+		return;
+
+	if (m_workerThreads.empty() || taskCount == 1)
+	{
+		for (size_t task = 0; task < taskCount; task++)
+			func(task, 0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_function = &func;
+		m_taskCount = taskCount;
+		m_nextTask = 0;
+		m_activeWorkers = m_workerThreads.size();
+		m_generation++;
+	}
+	m_startCondition.notify_all();
+
+	runTasks(0);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [&] { return m_activeWorkers == 0; });
+	m_function = nullptr;
+}
+
+inline void WorkerPool::runTasks(size_t worker)
+{
+	while (true)
+	{
+		size_t task = m_nextTask++;
+		if (task >= m_taskCount)
+			break;
+
+		(*m_function)(task, worker);
+	}
+}
+
+inline void WorkerPool::workerThread(size_t worker)
+{
+	uint64_t lastGeneration = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_startCondition.wait(lock, [&] { return m_generation != lastGeneration || m_cancelWorkers; });
+
+			if (m_cancelWorkers)
+				// Exit thread
+				break;
+
+			lastGeneration = m_generation;
+		}
+
+		runTasks(worker);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (--m_activeWorkers == 0)
+				m_doneCondition.notify_one();
+		}
+	}
+}
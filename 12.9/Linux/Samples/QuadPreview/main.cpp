@@ -38,12 +38,149 @@
 ** -LICENSE-END-
 */
 
-#include "QuadPreview.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+#include <thread>
+#include <sys/signalfd.h>
+#include <unistd.h>
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QGuiApplication>
+#include <QSocketNotifier>
+
+#include "QuadPreview.h"
+#include "HeadlessMultiviewer.h"
+
+namespace
+{
+	BMDDisplayMode parseDisplayMode(const QString& fourCC)
+	{
+		QByteArray code = fourCC.toLatin1();
+		if (code.size() != 4)
+			return bmdModeUnknown;
+
+		return (BMDDisplayMode)(((uint32_t)(uint8_t)code[0] << 24) | ((uint32_t)(uint8_t)code[1] << 16) | ((uint32_t)(uint8_t)code[2] << 8) | (uint8_t)code[3]);
+	}
+
+	int runHeadless(int argc, char *argv[])
+	{
+		// SIGINT and SIGTERM are delivered through a signalfd and handled on the event loop,
+		// quitting from a signal handler is not async-signal-safe.  They are blocked before
+		// any thread is started so that every thread inherits the mask.
+		sigset_t quitSignals;
+		sigemptyset(&quitSignals);
+		sigaddset(&quitSignals, SIGINT);
+		sigaddset(&quitSignals, SIGTERM);
+		pthread_sigmask(SIG_BLOCK, &quitSignals, nullptr);
+
+		int quitSignalFd = signalfd(-1, &quitSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+		if (quitSignalFd < 0)
+		{
+			perror("signalfd");
+			return 1;
+		}
+
+		// No windowing system is required, overlays are painted into images
+		if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+			qputenv("QT_QPA_PLATFORM", "offscreen");
+
+		QGuiApplication a(argc, argv);
+
+		QCommandLineParser parser;
+		parser.setApplicationDescription("Headless multiviewer: composites all active DeckLink inputs into one tiled canvas");
+		parser.addHelpOption();
+		parser.addOptions({
+			{ "headless",	"Run without a window." },
+			{ "inputs",		"Maximum number of inputs <count>.", "count", "16" },
+			{ "mode",		"Input display mode as a four character code, format detection is used when supported.", "fourcc", "Hp50" },
+			{ "canvas",		"Canvas size <width>x<height>, ignored for device output.", "size", "1920x1080" },
+			{ "format",		"Canvas pixel format: v210 or bgra.", "format", "v210" },
+			{ "filter",		"Downscaling filter: box or bilinear.", "filter", "box" },
+			{ "threads",	"Compositor threads.", "count", QString::number(std::max(1u, std::thread::hardware_concurrency())) },
+			{ "fps",		"Canvas frame rate, ignored for device output.", "rate", "25" },
+			{ "output",		"file:<path>, shm:<name> or device:<index>:<fourcc>.", "sink", "shm:/QuadPreview" },
+			{ "timecode",	"Overlay input timecode." },
+			{ "labels",		"Overlay device labels." },
+		});
+		parser.process(a);
 
+		HeadlessMultiviewer::Settings settings;
+		settings.maxInputs			= parser.value("inputs").toInt();
+		settings.inputDisplayMode	= parseDisplayMode(parser.value("mode"));
+		settings.canvasFormat		= (parser.value("format") == "bgra") ? bmdFormat8BitBGRA : bmdFormat10BitYUV;
+		settings.filter				= (parser.value("filter") == "bilinear") ? MultiviewCompositor::Filter::Bilinear : MultiviewCompositor::Filter::Box;
+		settings.threadCount		= std::max(1, parser.value("threads").toInt());
+		settings.frameRate			= parser.value("fps").toDouble();
+		settings.outputDeviceIndex	= -1;
+		settings.outputDisplayMode	= bmdModeUnknown;
+		settings.showTimecode		= parser.isSet("timecode");
+		settings.showDeviceLabels	= parser.isSet("labels");
+
+		QStringList canvasSize = parser.value("canvas").split('x');
+		settings.canvasWidth		= (canvasSize.size() == 2) ? canvasSize[0].toInt() : 0;
+		settings.canvasHeight		= (canvasSize.size() == 2) ? canvasSize[1].toInt() : 0;
+
+		QString output = parser.value("output");
+		QString outputType = output.section(':', 0, 0);
+		settings.sinkName = output.section(':', 1);
+		if (outputType == "file")
+			settings.sinkType = HeadlessMultiviewer::SinkType::File;
+		else if (outputType == "shm")
+			settings.sinkType = HeadlessMultiviewer::SinkType::SharedMemory;
+		else if (outputType == "device")
+		{
+			settings.sinkType = HeadlessMultiviewer::SinkType::Device;
+			settings.outputDeviceIndex = output.section(':', 1, 1).toInt();
+			settings.outputDisplayMode = parseDisplayMode(output.section(':', 2, 2));
+		}
+		else
+		{
+			fprintf(stderr, "Unknown output %s\n", output.toUtf8().constData());
+			return 1;
+		}
+
+		if (settings.inputDisplayMode == bmdModeUnknown || settings.maxInputs <= 0 || settings.frameRate <= 0.0
+			|| (settings.sinkType == HeadlessMultiviewer::SinkType::Device && settings.outputDisplayMode == bmdModeUnknown))
+		{
+			parser.showHelp(1);
+		}
+
+		HeadlessMultiviewer multiviewer(settings);
+		if (!multiviewer.start())
+			return 1;
+
+		QSocketNotifier quitNotifier(quitSignalFd, QSocketNotifier::Read);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+		auto activated = QOverload<QSocketDescriptor, QSocketNotifier::Type>::of(&QSocketNotifier::activated);
+#else
+		auto activated = &QSocketNotifier::activated;
+#endif
+		QObject::connect(&quitNotifier, activated, [quitSignalFd]() {
+			struct signalfd_siginfo info;
+			while (read(quitSignalFd, &info, sizeof(info)) == sizeof(info))
+				;
+			QCoreApplication::quit();
+		});
+
+		int exitResult = a.exec();
+
+		multiviewer.stop();
+		close(quitSignalFd);
+
+		return exitResult;
+	}
+}
 
 int main(int argc, char *argv[])
 {
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--headless") == 0)
+			return runHeadless(argc, argv);
+	}
+
 	QApplication a(argc, argv);
 
 	qRegisterMetaType<com_ptr<IDeckLinkVideoFrame>>("com_ptr<IDeckLinkVideoFrame>");
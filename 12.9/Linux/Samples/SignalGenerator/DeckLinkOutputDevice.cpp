@@ -40,6 +40,7 @@
 
 
 #include "DeckLinkOutputDevice.h"
+#include "FrameTrace.h"
 
 DeckLinkOutputDevice::DeckLinkOutputDevice(QObject* owner, com_ptr<IDeckLink>& deckLink) : 
 	m_refCount(1),
@@ -116,6 +117,8 @@ ULONG DeckLinkOutputDevice::Release(void)
 
 HRESULT	DeckLinkOutputDevice::ScheduledFrameCompleted(IDeckLinkVideoFrame* /* completedFrame */, BMDOutputFrameCompletionResult /* result */)
 {
+	FRAME_TRACE_INSTANT("ScheduledFrameCompleted", FrameTrace::kNoFrame);
+
 	if (m_scheduledFrameCompletedCallback)
 		m_scheduledFrameCompletedCallback();
 	
@@ -135,6 +138,8 @@ HRESULT	DeckLinkOutputDevice::ScheduledPlaybackHasStopped()
 
 HRESULT	DeckLinkOutputDevice::RenderAudioSamples(bool preroll)
 {
+	FRAME_TRACE_INSTANT("RenderAudioSamples", FrameTrace::kNoFrame);
+
 	if (m_renderAudioSamplesCallback)
 		m_renderAudioSamplesCallback();
 
@@ -0,0 +1,228 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+
+#include "PatternFrameCache.h"
+#include "FrameTrace.h"
+
+PatternFrameCache::PatternFrameCache(size_t budgetBytes, const RenderFrameFunction& renderFrame) :
+	m_budgetBytes(budgetBytes),
+	m_renderFrame(renderFrame),
+	m_deviceGeneration(0),
+	m_statistics(),
+	m_exitPrefetchThread(false)
+{
+	m_prefetchThread = std::thread(&PatternFrameCache::prefetchThread, this);
+}
+
+PatternFrameCache::~PatternFrameCache()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_exitPrefetchThread = true;
+	}
+	m_prefetchCondition.notify_all();
+
+	if (m_prefetchThread.joinable())
+		m_prefetchThread.join();
+}
+
+void PatternFrameCache::setDeviceOutput(com_ptr<IDeckLinkOutput> deckLinkOutput)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (deckLinkOutput == m_deckLinkOutput)
+		return;
+
+	// Frames rendered for the previous device, including any still being prefetched, are discarded
+	m_deckLinkOutput = deckLinkOutput;
+	++m_deviceGeneration;
+
+	m_entries.clear();
+	m_lruList.clear();
+	m_prefetchQueue.clear();
+	m_statistics.frameCount = 0;
+	m_statistics.bytes = 0;
+}
+
+com_ptr<IDeckLinkMutableVideoFrame> PatternFrameCache::getFrame(const PatternFrameKey& key)
+{
+	com_ptr<IDeckLinkMutableVideoFrame>	frame;
+	com_ptr<IDeckLinkOutput>			deckLinkOutput;
+	uint32_t							deviceGeneration;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		// A prefetch of this frame is already under way, wait for it rather than render it twice
+		m_renderedCondition.wait(lock, [&] { return m_rendering.find(key) == m_rendering.end(); });
+
+		auto entry = m_entries.find(key);
+		if (entry != m_entries.end())
+		{
+			m_lruList.splice(m_lruList.begin(), m_lruList, entry->second.lruPosition);
+			++m_statistics.hits;
+			return entry->second.frame;
+		}
+
+		++m_statistics.misses;
+		m_prefetchQueue.erase(std::remove_if(m_prefetchQueue.begin(), m_prefetchQueue.end(),
+											 [&](const PatternFrameKey& queued) { return !(queued < key) && !(key < queued); }),
+							  m_prefetchQueue.end());
+		m_rendering.insert(key);
+
+		deckLinkOutput = m_deckLinkOutput;
+		deviceGeneration = m_deviceGeneration;
+	}
+
+	if (deckLinkOutput)
+	{
+		FRAME_TRACE_SPAN("renderPatternFrame", FrameTrace::kNoFrame);
+		frame = m_renderFrame(deckLinkOutput, key);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_rendering.erase(key);
+		if (frame && (deviceGeneration == m_deviceGeneration))
+			insertLocked(key, frame);
+	}
+	m_renderedCondition.notify_all();
+
+	return frame;
+}
+
+void PatternFrameCache::prefetch(const PatternFrameKey& key)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if ((m_entries.find(key) != m_entries.end()) || (m_rendering.find(key) != m_rendering.end()))
+			return;
+
+		for (auto& queued : m_prefetchQueue)
+		{
+			if (!(queued < key) && !(key < queued))
+				return;
+		}
+
+		m_prefetchQueue.push_back(key);
+	}
+	m_prefetchCondition.notify_one();
+}
+
+PatternFrameCacheStatistics PatternFrameCache::getStatistics()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_statistics;
+}
+
+void PatternFrameCache::prefetchThread()
+{
+	FRAME_TRACE_THREAD_NAME("Pattern prefetch");
+
+	while (true)
+	{
+		PatternFrameKey						key;
+		com_ptr<IDeckLinkOutput>			deckLinkOutput;
+		com_ptr<IDeckLinkMutableVideoFrame>	frame;
+		uint32_t							deviceGeneration;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			m_prefetchCondition.wait(lock, [this] { return m_exitPrefetchThread || !m_prefetchQueue.empty(); });
+			if (m_exitPrefetchThread)
+				break;
+
+			key = m_prefetchQueue.front();
+			m_prefetchQueue.pop_front();
+
+			if (!m_deckLinkOutput || (m_entries.find(key) != m_entries.end()))
+				continue;
+
+			m_rendering.insert(key);
+			deckLinkOutput = m_deckLinkOutput;
+			deviceGeneration = m_deviceGeneration;
+		}
+
+		{
+			FRAME_TRACE_SPAN("prefetchPatternFrame", FrameTrace::kNoFrame);
+			frame = m_renderFrame(deckLinkOutput, key);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_rendering.erase(key);
+			if (frame && (deviceGeneration == m_deviceGeneration))
+			{
+				insertLocked(key, frame);
+				++m_statistics.prefetches;
+			}
+		}
+		m_renderedCondition.notify_all();
+	}
+}
+
+void PatternFrameCache::insertLocked(const PatternFrameKey& key, com_ptr<IDeckLinkMutableVideoFrame>& frame)
+{
+	size_t bytes = (size_t)frame->GetRowBytes() * frame->GetHeight();
+
+	m_lruList.push_front(key);
+	m_entries[key] = CacheEntry { frame, bytes, m_lruList.begin() };
+	m_statistics.bytes += bytes;
+
+	// Evict the least recently used frames over budget, but always keep the newest.  Frames
+	// being output stay valid, the output holds its own reference to them.
+	while ((m_statistics.bytes > m_budgetBytes) && (m_lruList.size() > 1))
+	{
+		auto evicted = m_entries.find(m_lruList.back());
+
+		m_statistics.bytes -= evicted->second.bytes;
+		m_entries.erase(evicted);
+		m_lruList.pop_back();
+		++m_statistics.evictions;
+	}
+
+	m_statistics.frameCount = m_entries.size();
+}
@@ -0,0 +1,134 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <tuple>
+
+#include "com_ptr.h"
+#include "DeckLinkAPI.h"
+
+enum class OutputPattern
+{
+	Black,
+	ColorBars
+};
+
+struct PatternFrameKey
+{
+	BMDDisplayMode	displayMode;
+	BMDPixelFormat	pixelFormat;
+	OutputPattern	pattern;
+
+	bool operator<(const PatternFrameKey& other) const
+	{
+		return std::tie(displayMode, pixelFormat, pattern) < std::tie(other.displayMode, other.pixelFormat, other.pattern);
+	}
+};
+
+struct PatternFrameCacheStatistics
+{
+	uint64_t	hits;
+	uint64_t	misses;
+	uint64_t	prefetches;			// frames rendered in the background
+	uint64_t	evictions;
+	size_t		frameCount;
+	size_t		bytes;
+};
+
+// Least recently used cache of rendered pattern frames, keyed by display mode, pixel format and
+// pattern, so that starting output in a mode that has been used before does not allocate,
+// fill and convert its frames again.  Frames can be rendered ahead of time on a background
+// thread with prefetch().  Frames are created by one output device, changing device empties
+// the cache.
+class PatternFrameCache
+{
+public:
+	using RenderFrameFunction = std::function<com_ptr<IDeckLinkMutableVideoFrame>(com_ptr<IDeckLinkOutput>&, const PatternFrameKey&)>;
+
+	PatternFrameCache(size_t budgetBytes, const RenderFrameFunction& renderFrame);
+	~PatternFrameCache();
+
+	void								setDeviceOutput(com_ptr<IDeckLinkOutput> deckLinkOutput);
+
+	// Returns the cached frame, waits for it if it is being prefetched, or renders it
+	com_ptr<IDeckLinkMutableVideoFrame>	getFrame(const PatternFrameKey& key);
+	void								prefetch(const PatternFrameKey& key);
+
+	PatternFrameCacheStatistics			getStatistics();
+
+private:
+	using LRUList = std::list<PatternFrameKey>;
+
+	struct CacheEntry
+	{
+		com_ptr<IDeckLinkMutableVideoFrame>	frame;
+		size_t								bytes;
+		LRUList::iterator					lruPosition;
+	};
+
+	size_t									m_budgetBytes;
+	RenderFrameFunction						m_renderFrame;
+	com_ptr<IDeckLinkOutput>				m_deckLinkOutput;
+	uint32_t								m_deviceGeneration;
+	//
+	std::map<PatternFrameKey, CacheEntry>	m_entries;
+	LRUList									m_lruList;		// most recently used first
+	std::deque<PatternFrameKey>				m_prefetchQueue;
+	std::set<PatternFrameKey>				m_rendering;
+	PatternFrameCacheStatistics				m_statistics;
+	//
+	std::mutex								m_mutex;
+	std::condition_variable					m_prefetchCondition;
+	std::condition_variable					m_renderedCondition;
+	std::thread								m_prefetchThread;
+	bool									m_exitPrefetchThread;
+
+	void	prefetchThread();
+	void	insertLocked(const PatternFrameKey& key, com_ptr<IDeckLinkMutableVideoFrame>& frame);
+};
@@ -43,6 +43,7 @@
 #include "DeckLinkOutputDevice.h"
 #include "DeckLinkDeviceDiscovery.h"
 #include "DeckLinkOpenGLWidget.h"
+#include "FrameTrace.h"
 
 #include <QStandardItemModel>
 #include <QStandardItem>
@@ -52,6 +53,8 @@
 #include <stdio.h>
 
 const uint32_t		kAudioWaterlevel = 48000;
+const uint32_t		kAudioRingSampleFrames = 4 * 48000;
+const size_t		kPatternFrameCacheBudget = 512 * 1024 * 1024;		// Rendered pattern frames kept for reuse (bytes)
 
 // SD 75% Colour Bars
 static uint32_t gSD75pcColourBars[8] =
@@ -86,6 +89,10 @@ SignalGenerator::SignalGenerator() : QDialog(),
 	audioBuffer(nullptr),
 	scheduledPlaybackStopped(false)
 {
+	patternFrameCache.reset(new PatternFrameCache(kPatternFrameCacheBudget, [this](com_ptr<IDeckLinkOutput>& deckLinkOutput, const PatternFrameKey& key) {
+		return CreateOutputFrame(deckLinkOutput, key);
+	}));
+
 	ui = new Ui::SignalGeneratorDialog();
 	ui->setupUi(this);
 
@@ -291,6 +298,7 @@ void SignalGenerator::removeDevice(com_ptr<IDeckLink>& deckLink)
 		if (running)
 			stopRunning();
 		selectedDevice = nullptr;
+		patternFrameCache->setDeviceOutput(nullptr);
 	}
 
 	// Find the combo box entry to remove (there may be multiple entries with the same name, but each
@@ -336,39 +344,47 @@ void SignalGenerator::playbackStopped()
 	stopPlaybackCondition.notify_one();
 }
 
-com_ptr<IDeckLinkMutableVideoFrame> SignalGenerator::CreateOutputFrame(FillFrameFunction fillFrame)
+com_ptr<IDeckLinkMutableVideoFrame> SignalGenerator::CreateOutputFrame(com_ptr<IDeckLinkOutput>& deckLinkOutput, const PatternFrameKey& key)
 {
-	com_ptr<IDeckLinkOutput>				deckLinkOutput;
+	// Called from the pattern frame cache, possibly on its prefetch thread, so everything
+	// is taken from the key rather than the current selection
+	com_ptr<IDeckLinkDisplayMode>			displayMode;
 	com_ptr<IDeckLinkMutableVideoFrame>		referenceFrame;
 	com_ptr<IDeckLinkMutableVideoFrame>		scheduleFrame;
 	HRESULT									hr;
+	uint32_t								width;
+	uint32_t								height;
 	int										bytesPerRow;
 	int										referenceBytesPerRow;
 	com_ptr<IDeckLinkVideoConversion>		frameConverter;
+	FillFrameFunction						fillFrame = (key.pattern == OutputPattern::ColorBars) ? FillColorBars : FillBlack;
 
-	bytesPerRow = GetRowBytes(selectedPixelFormat, frameWidth);
-	referenceBytesPerRow = GetRowBytes(bmdFormat8BitYUV, frameWidth);
+	if (deckLinkOutput->GetDisplayMode(key.displayMode, displayMode.releaseAndGetAddressOf()) != S_OK)
+		goto bail;
 
-	deckLinkOutput = selectedDevice->getDeviceOutput();
+	width = displayMode->GetWidth();
+	height = displayMode->GetHeight();
+	bytesPerRow = GetRowBytes(key.pixelFormat, width);
+	referenceBytesPerRow = GetRowBytes(bmdFormat8BitYUV, width);
 
 	frameConverter = CreateVideoConversionInstance();
 	if (!frameConverter)
 		goto bail;
 
-	hr = deckLinkOutput->CreateVideoFrame(frameWidth, frameHeight, referenceBytesPerRow, bmdFormat8BitYUV, bmdFrameFlagDefault, referenceFrame.releaseAndGetAddressOf());
+	hr = deckLinkOutput->CreateVideoFrame(width, height, referenceBytesPerRow, bmdFormat8BitYUV, bmdFrameFlagDefault, referenceFrame.releaseAndGetAddressOf());
 	if (hr != S_OK)
 		goto bail;
 
 	fillFrame(referenceFrame);
 
-	if (selectedPixelFormat == bmdFormat8BitYUV)
+	if (key.pixelFormat == bmdFormat8BitYUV)
 	{
 		// Frame is already 8-bit YUV, no conversion required
 		scheduleFrame = referenceFrame;
 	}
 	else
 	{
-		hr = deckLinkOutput->CreateVideoFrame(frameWidth, frameHeight, bytesPerRow, selectedPixelFormat, bmdFrameFlagDefault, scheduleFrame.releaseAndGetAddressOf());
+		hr = deckLinkOutput->CreateVideoFrame(width, height, bytesPerRow, key.pixelFormat, bmdFrameFlagDefault, scheduleFrame.releaseAndGetAddressOf());
 		if (hr != S_OK)
 			goto bail;
 
@@ -381,6 +397,24 @@ bail:
 	return scheduleFrame;
 }
 
+void SignalGenerator::prefetchNeighbouringModes()
+{
+	int currentIndex = ui->videoFormatPopup->currentIndex();
+
+	// Render the modes either side of the current one in the background, so stepping through
+	// the display mode menu finds them ready
+	for (int index : { currentIndex + 1, currentIndex - 1 })
+	{
+		if ((index < 0) || (index >= ui->videoFormatPopup->count()))
+			continue;
+
+		BMDDisplayMode displayMode = (BMDDisplayMode)ui->videoFormatPopup->itemData(index).value<uint64_t>();
+
+		patternFrameCache->prefetch({ displayMode, selectedPixelFormat, OutputPattern::Black });
+		patternFrameCache->prefetch({ displayMode, selectedPixelFormat, OutputPattern::ColorBars });
+	}
+}
+
 void SignalGenerator::startRunning()
 {
 	com_ptr<IDeckLinkOutput>			deckLinkOutput		= selectedDevice->getDeviceOutput();
@@ -391,6 +425,7 @@ void SignalGenerator::startRunning()
 	bool								output444;
 	HRESULT								result;
 	QVariant 							v;
+	AudioFeederSettings					audioFeederSettings;
 	
 	if (!deckLinkAttributes)
 		goto bail;
@@ -488,26 +523,51 @@ void SignalGenerator::startRunning()
 	if (deckLinkOutput->EnableAudioOutput(bmdAudioSampleRate48kHz, audioSampleDepth, audioChannelCount, bmdAudioOutputStreamTimestamped) != S_OK)
 		goto bail;
 	
-	// Generate one second of audio tone
+	// Generate one second of audio, a frame of tone for pip and a frame of silence for drop
 	audioSamplesPerFrame = ((audioSampleRate * frameDuration) / frameTimescale);
 	audioBufferSampleLength = (framesPerSecond * audioSampleRate * frameDuration) / frameTimescale;
-	audioBuffer = malloc(audioBufferSampleLength * audioChannelCount * (audioSampleDepth / 8));
+	audioBuffer = calloc(audioBufferSampleLength, audioChannelCount * (audioSampleDepth / 8));
 	if (audioBuffer == nullptr)
 		goto bail;
-	FillSine(audioBuffer, audioBufferSampleLength, audioChannelCount, audioSampleDepth);
-	
-	// Generate a frame of black
-	videoFrameBlack = CreateOutputFrame(FillBlack);
+	if (outputSignal == kOutputSignalPip)
+		FillSine(audioBuffer, audioSamplesPerFrame, audioChannelCount, audioSampleDepth);
+	else
+		FillSine((uint8_t*)audioBuffer + (audioSamplesPerFrame * audioChannelCount * (audioSampleDepth / 8)), (audioBufferSampleLength - audioSamplesPerFrame), audioChannelCount, audioSampleDepth);
+
+	// The feeder repeats the second of audio through its ring, from stream time 0 where playback starts
+	audioFeederSettings.channelCount = audioChannelCount;
+	audioFeederSettings.sampleDepth = audioSampleDepth;
+	audioFeederSettings.timestamped = true;
+	audioFeederSettings.waterLevel = kAudioWaterlevel;
+	audioFeederSettings.ringSampleFrames = kAudioRingSampleFrames;
+	audioFeeder.reset(new AudioFeeder(deckLinkOutput.get()));
+	if (!audioFeeder->startLoop(audioFeederSettings, audioBuffer, audioBufferSampleLength))
+		goto bail;
+
+	free(audioBuffer);
+	audioBuffer = nullptr;
 	
-	// Generate a frame of colour bars
-	videoFrameBars = CreateOutputFrame(FillColorBars);
+	// Get frames of black and colour bars, rendered now unless this mode has been used before
+	videoFrameBlack = patternFrameCache->getFrame({ selectedDisplayMode, selectedPixelFormat, OutputPattern::Black });
+	videoFrameBars = patternFrameCache->getFrame({ selectedDisplayMode, selectedPixelFormat, OutputPattern::ColorBars });
+	if (!videoFrameBlack || !videoFrameBars)
+		goto bail;
+
+	prefetchNeighbouringModes();
+
+	{
+		PatternFrameCacheStatistics statistics = patternFrameCache->getStatistics();
+		printf("Pattern frame cache: %llu hits, %llu misses, %llu prefetched, %llu evicted; %zu frames, %.1f MB\n",
+			   (unsigned long long)statistics.hits, (unsigned long long)statistics.misses,
+			   (unsigned long long)statistics.prefetches, (unsigned long long)statistics.evictions,
+			   statistics.frameCount, (double)statistics.bytes / (1024 * 1024));
+	}
 	
 	// Begin video preroll by scheduling a second of frames in hardware
 	for (unsigned int i = 0; i < framesPerSecond; i++)
 		scheduleNextFrame(true);
 	
 	// Begin audio preroll.  This will begin calling our audio callback, which will start the DeckLink output stream.
-	totalAudioSecondsScheduled = 0;
 	if (deckLinkOutput->BeginAudioPreroll() != S_OK)
 		goto bail;
 	
@@ -550,6 +610,19 @@ void SignalGenerator::stopRunning()
 
 	deckLinkOutput->DisableAudioOutput();
 	deckLinkOutput->DisableVideoOutput();
+
+	if (audioFeeder)
+	{
+		AudioFeederStatistics statistics;
+
+		audioFeeder->getStatistics(statistics);
+		if (statistics.running)
+			printf("Audio feeder: %llu sample frames in %llu calls, minimum margin %.1f ms, %llu underruns, %llu resyncs\n",
+				   (unsigned long long)statistics.sampleFramesScheduled, (unsigned long long)statistics.scheduleCalls,
+				   (double)statistics.minimumMargin * 1000.0 / AudioFeeder::kSampleRate,
+				   (unsigned long long)statistics.underruns, (unsigned long long)statistics.resyncs);
+		audioFeeder.reset();
+	}
 	
 	if (audioBuffer != nullptr)
 		free(audioBuffer);
@@ -576,6 +649,8 @@ void SignalGenerator::scheduleNextFrame(bool prerolling)
 	bool									setVITC2Timecode = false;
 	unsigned long							totalFramesScheduled = timeCode->frameCount();
 
+	FRAME_TRACE_SPAN("scheduleNextFrame", totalFramesScheduled);
+
 	deckLinkOutput = selectedDevice->getDeviceOutput();
 
 	if (prerolling == false)
@@ -715,22 +790,11 @@ void SignalGenerator::scheduleNextFrame(bool prerolling)
 
 void SignalGenerator::writeNextAudioSamples()
 {
-	// Write one second of audio to the DeckLink API.
-	
-	if (outputSignal == kOutputSignalPip)
-	{
-		// Schedule one-frame of audio tone
-		if (selectedDevice->getDeviceOutput()->ScheduleAudioSamples(audioBuffer, audioSamplesPerFrame, (totalAudioSecondsScheduled * audioBufferSampleLength), audioSampleRate, nullptr) != S_OK)
-			return;
-	}
-	else
-	{
-		// Schedule one-second (minus one frame) of audio tone
-		if (selectedDevice->getDeviceOutput()->ScheduleAudioSamples(audioBuffer, (audioBufferSampleLength - audioSamplesPerFrame), (totalAudioSecondsScheduled * audioBufferSampleLength) + audioSamplesPerFrame, audioSampleRate, nullptr) != S_OK)
-			return;
-	}
-	
-	totalAudioSecondsScheduled += 1;
+	// Top up the audio buffered in the DeckLink API to the water level
+	FRAME_TRACE_SPAN("writeNextAudioSamples", FrameTrace::kNoFrame);
+
+	if (audioFeeder)
+		audioFeeder->feed();
 }
 
 void SignalGenerator::outputDeviceChanged(int selectedDeviceIndex)
@@ -747,6 +811,7 @@ void SignalGenerator::outputDeviceChanged(int selectedDeviceIndex)
 		return;
 
 	selectedDevice = iter->second;
+	patternFrameCache->setDeviceOutput(selectedDevice->getDeviceOutput());
 
 	// Update the video mode popup menu
 	refreshDisplayModeMenu();
@@ -764,6 +829,15 @@ void SignalGenerator::videoFormatChanged(int videoFormatIndex)
 
 	// Update pixel format popup menu
 	refreshPixelFormatMenu();
+
+	// Start rendering the selected mode while the rest of the output is configured
+	if (ui->pixelFormatPopup->count() > 0)
+	{
+		BMDPixelFormat pixelFormat = (BMDPixelFormat)ui->pixelFormatPopup->itemData(ui->pixelFormatPopup->currentIndex()).value<int>();
+
+		patternFrameCache->prefetch({ selectedDisplayMode, pixelFormat, OutputPattern::Black });
+		patternFrameCache->prefetch({ selectedDisplayMode, pixelFormat, OutputPattern::ColorBars });
+	}
 }
 
 /*****************************************/
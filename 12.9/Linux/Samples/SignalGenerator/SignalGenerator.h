@@ -52,9 +52,11 @@
 #include <mutex>
 
 #include "com_ptr.h"
+#include "AudioFeeder.h"
 #include "DeckLinkOpenGLWidget.h"
 #include "DeckLinkOutputDevice.h"
 #include "DeckLinkDeviceDiscovery.h"
+#include "PatternFrameCache.h"
 
 #include "ui_SignalGenerator.h"
 
@@ -148,7 +150,7 @@ public:
 	uint32_t								audioChannelCount;
 	BMDAudioSampleRate						audioSampleRate;
 	uint32_t								audioSampleDepth;
-	uint32_t								totalAudioSecondsScheduled;
+	std::unique_ptr<AudioFeeder>			audioFeeder;
 	//
 	std::mutex								mutex;
 	std::condition_variable					stopPlaybackCondition;
@@ -171,6 +173,7 @@ public:
 	void refreshDisplayModeMenu(void);
 	void refreshPixelFormatMenu(void);
 	void refreshAudioChannelMenu(void);
+	void prefetchNeighbouringModes(void);
 	void addDevice(com_ptr<IDeckLink>& deckLink);
 	void removeDevice(com_ptr<IDeckLink>& deckLink);
 	void playbackStopped(void);
@@ -186,8 +189,9 @@ private:
 
 	bool scheduledPlaybackStopped;
 	std::map<intptr_t, com_ptr<DeckLinkOutputDevice>>		outputDevices;
+	std::unique_ptr<PatternFrameCache>						patternFrameCache;
 
-	com_ptr<IDeckLinkMutableVideoFrame> CreateOutputFrame(FillFrameFunction fillFrame);
+	com_ptr<IDeckLinkMutableVideoFrame> CreateOutputFrame(com_ptr<IDeckLinkOutput>& deckLinkOutput, const PatternFrameKey& key);
 };
 
 int		GetRowBytes(BMDPixelFormat pixelFormat, uint32_t frameWidth);
@@ -6,7 +6,7 @@ QT       += core gui widgets
 TARGET = SignalGenerator
 TEMPLATE = app
 CONFIG += c++11
-INCLUDEPATH = ../../include
+INCLUDEPATH = ../../include ../common
 LIBS += -ldl
 
 # The following define makes your compiler emit warnings if you use
@@ -21,17 +21,23 @@ DEFINES += QT_DEPRECATED_WARNINGS
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 HEADERS 	=	SignalGenerator.h \
+				../common/AudioFeeder.h \
 				SignalGeneratorEvents.h \
 				com_ptr.h \
 				DeckLinkDeviceDiscovery.h \
 				DeckLinkOutputDevice.h \
-				DeckLinkOpenGLWidget.h
+				DeckLinkOpenGLWidget.h \
+				../common/FrameTrace.h \
+				PatternFrameCache.h
 
 SOURCES 	= 	main.cpp \
 				../../include/DeckLinkAPIDispatch.cpp \
+				../common/AudioFeeder.cpp \
 				DeckLinkDeviceDiscovery.cpp \
 				DeckLinkOutputDevice.cpp \
 				DeckLinkOpenGLWidget.cpp \
+				../common/FrameTrace.cpp \
+				PatternFrameCache.cpp \
 				SignalGenerator.cpp
 
 FORMS 		= 	SignalGenerator.ui
@@ -40,6 +40,7 @@
 
 #include <QApplication>
 #include "SignalGenerator.h"
+#include "FrameTrace.h"
 
 int main(int argc, char **argv)
 {
@@ -54,7 +55,13 @@ int main(int argc, char **argv)
 	format.setProfile(QSurfaceFormat::CoreProfile);
 	QSurfaceFormat::setDefaultFormat(format);
 
+	// Set FRAME_TRACE_FILE to record a per-frame trace of the playout
+	FrameTrace::startFromEnvironment();
+
 	SignalGenerator cp;
 	cp.setup();
-	return app.exec();
+	int result = app.exec();
+
+	FrameTrace::stop();
+	return result;
 }
@@ -0,0 +1,111 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <pthread.h>
+#include <chrono>
+
+#include "CardScheduler.h"
+
+CardScheduler::CardScheduler(int64_t groupID, const std::string& name) :
+	m_groupID(groupID),
+	m_name(name),
+	m_frameDuration(0),
+	m_frameTimescale(0),
+	m_running(false)
+{
+}
+
+CardScheduler::~CardScheduler()
+{
+	Stop();
+
+	for (OutputChannel* channel : m_channels)
+		channel->Release();
+}
+
+void CardScheduler::AddChannel(OutputChannel* channel)
+{
+	channel->AddRef();
+	m_channels.push_back(channel);
+}
+
+void CardScheduler::Start(BMDTimeValue frameDuration, BMDTimeScale frameTimescale)
+{
+	m_frameDuration = frameDuration;
+	m_frameTimescale = frameTimescale;
+	m_running = true;
+	m_thread = std::thread(&CardScheduler::TimerThread, this);
+}
+
+void CardScheduler::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = false;
+	}
+	m_stopCondition.notify_all();
+
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+void CardScheduler::TimerThread()
+{
+	std::chrono::nanoseconds					framePeriod((int64_t)m_frameDuration * 1000000000 / m_frameTimescale);
+	std::chrono::steady_clock::time_point		nextTick = std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex>				lock(m_mutex);
+
+	pthread_setname_np(pthread_self(), "CardScheduler");
+
+	while (m_running)
+	{
+		lock.unlock();
+		for (OutputChannel* channel : m_channels)
+			channel->Service();
+		lock.lock();
+
+		// Keep to the frame rate, but do not try to catch up on ticks missed while the thread was held up
+		nextTick += std::chrono::duration_cast<std::chrono::steady_clock::duration>(framePeriod);
+		if (nextTick < std::chrono::steady_clock::now())
+			nextTick = std::chrono::steady_clock::now();
+
+		m_stopCondition.wait_until(lock, nextTick, [this]{ return !m_running; });
+	}
+}
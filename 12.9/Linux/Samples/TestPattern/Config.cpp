@@ -53,6 +53,7 @@ BMDConfig::BMDConfig() :
 	m_outputFlags(bmdVideoOutputFlagDefault),
 	m_pixelFormat(bmdFormat8BitYUV),
 	m_output444(false),
+	m_movingPattern(kMovingPatternNone),
 	m_deckLinkName(),
 	m_displayModeName()
 {
@@ -110,12 +111,26 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 					case 0: m_pixelFormat = bmdFormat8BitYUV;  m_output444 = false; break;
 					case 1: m_pixelFormat = bmdFormat10BitYUV; m_output444 = false; break;
 					case 2: m_pixelFormat = bmdFormat10BitRGB; m_output444 = true;  break;
+					case 3: m_pixelFormat = bmdFormat12BitRGB; m_output444 = true;  break;
 					default:
 						fprintf(stderr, "Invalid argument: Pixel format %d is not valid", atoi(optarg));
 						return false;
 				}
 				break;
 
+			case 't':
+				switch(atoi(optarg))
+				{
+					case 0: m_movingPattern = kMovingPatternNone;			break;
+					case 1: m_movingPattern = kMovingPatternZonePlate;		break;
+					case 2: m_movingPattern = kMovingPatternSweep;			break;
+					case 3: m_movingPattern = kMovingPatternScrollingBars;	break;
+					default:
+						fprintf(stderr, "Invalid argument: Pattern %d is not valid\n", atoi(optarg));
+						return false;
+				}
+				break;
+
 			case '3':
 				m_outputFlags |= bmdVideoOutputDualStream3D;
 				break;
@@ -141,6 +156,12 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 	if (displayHelp)
 		DisplayUsage(0);
 
+	if ((m_movingPattern != kMovingPatternNone) && (m_outputFlags & bmdVideoOutputDualStream3D))
+	{
+		fprintf(stderr, "Moving patterns are not supported with 3D output\n");
+		return false;
+	}
+
 	// Get device, its active state and display mode names
 	IDeckLink *deckLink = GetSelectedDeckLink();
 	if (deckLink != NULL)
@@ -294,6 +315,13 @@ bail:
 		"         0:  8 bit YUV (4:2:2) (default)\n"
 		"         1:  10 bit YUV (4:2:2)\n"
 		"         2:  10 bit RGB (4:4:4)\n"
+		"         3:  12 bit RGB (4:4:4)\n"
+		"    -t <pattern>\n"
+		"         0:  Colour bars / black (default)\n"
+		"         1:  Moving zone plate\n"
+		"         2:  Luma / chroma sweep\n"
+		"         3:  Scrolling colour bars\n"
+		"         Moving patterns have a burned-in timecode and frame counter\n"
 		"    -c <channels>        Audio Channels (2, 8 or 16 - default is 2)\n"
 		"    -s <depth>           Audio Sample Depth (16 or 32 - default is 16)\n"
 		"    -3                   Playback Stereoscopic 3D (Requires 3D Hardware support)\n"
@@ -324,12 +352,14 @@ void BMDConfig::DisplayConfiguration()
 		" - Playback device: %s\n"
 		" - Video mode: %s %s\n"
 		" - Pixel format: %s\n"
+		" - Pattern: %s\n"
 		" - Audio channels: %u\n"
 		" - Audio sample depth: %u bit \n",
 		m_deckLinkName,
 		m_displayModeName,
 		(m_outputFlags & bmdVideoOutputDualStream3D) ? "3D" : "",
 		GetPixelFormatName(m_pixelFormat),
+		MovingPatternRenderer::GetPatternName(m_movingPattern),
 		m_audioChannels,
 		m_audioSampleDepth
 	);
@@ -413,6 +443,8 @@ const char* BMDConfig::GetPixelFormatName(BMDPixelFormat pixelFormat)
 			return "10 bit YUV (4:2:2)";
 		case bmdFormat10BitRGB:
 			return "10 bit RGB (4:4:4)";
+		case bmdFormat12BitRGB:
+			return "12 bit RGB (4:4:4)";
 	}
 	return "unknown";
 }
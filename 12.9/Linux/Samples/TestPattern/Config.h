@@ -42,6 +42,7 @@
 #define BMD_CONFIG_H
 
 #include "DeckLinkAPI.h"
+#include "MovingPatternRenderer.h"
 
 class BMDConfig
 {
@@ -62,6 +63,7 @@ public:
 	BMDVideoOutputFlags		m_outputFlags;
 	BMDPixelFormat			m_pixelFormat;
 	bool					m_output444;
+	MovingPattern			m_movingPattern;
 
 	const char*				m_videoOutputFile;
 	const char*				m_audioOutputFile;
@@ -0,0 +1,759 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "MovingPatternRenderer.h"
+
+namespace
+{
+	const long		kBandRows					= 8;
+
+	// 10-bit video levels
+	const int16_t	kBlackLuma					= 64;
+	const int16_t	kWhiteLuma					= 940;
+	const int16_t	kMidLuma					= 502;
+	const int16_t	kNeutralChroma				= 512;
+	const int		kLumaAmplitude				= 438;
+	const int		kChromaAmplitude			= 224;
+
+	// Motion rates. These are whole numbers of cycles per second, so the phase is exact for any frame number.
+	const unsigned	kPhaseCyclesPerSecond		= 1;
+	const unsigned	kScrollSecondsPerWidth		= 4;
+
+	// Highest frequencies reached by the sweeps and zone plate, in cycles per luma sample
+	const double	kMaxLumaFrequency			= 0.45;
+	const double	kMaxChromaFrequency			= 0.225;
+
+	// Burned-in text uses a 5x7 font in 6x9 cells; the box holds two lines of 11 characters
+	const long		kGlyphWidth					= 5;
+	const long		kGlyphHeight				= 7;
+	const long		kCellWidth					= 6;
+	const long		kCellHeight					= 9;
+	const long		kOverlayColumns				= 11;
+	const long		kOverlayCellsWide			= kOverlayColumns * kCellWidth + 2;
+	const long		kOverlayCellsHigh			= 2 * kCellHeight;
+	const long		kOverlayMarginCells			= 8;
+	const long		kOverlayLinesPerScale		= 270;
+
+	// Colour bars in 10-bit Y'CbCr, matching FillColourBars()
+	const int16_t	kBars[8][3] = {
+		{ 936, 512, 512 }, { 840,  64, 584 }, { 676, 660,  64 }, { 576, 212, 136 },
+		{ 424, 808, 884 }, { 324, 360, 956 }, { 160, 956, 436 }, {  64, 512, 512 }
+	};
+
+	const uint8_t	kDigitGlyphs[11][kGlyphHeight] = {
+		{ 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E },	// 0
+		{ 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E },	// 1
+		{ 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F },	// 2
+		{ 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E },	// 3
+		{ 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 },	// 4
+		{ 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E },	// 5
+		{ 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E },	// 6
+		{ 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },	// 7
+		{ 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E },	// 8
+		{ 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C },	// 9
+		{ 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 }	// :
+	};
+
+	uint8_t glyphRowBits(char c, long glyphRow)
+	{
+		if (c >= '0' && c <= '9')
+			return kDigitGlyphs[c - '0'][glyphRow];
+		if (c == ':')
+			return kDigitGlyphs[10][glyphRow];
+		return 0;
+	}
+
+	// Fill a table of interleaved sin/cos pairs (Q14) for a per-column phase in radians
+	void buildPhaseTable(std::vector<int16_t>& table, long count, double (*phaseFunc)(long x, long width))
+	{
+		table.resize(count * 2);
+		for (long x = 0; x < count; x++)
+		{
+			double phase = phaseFunc(x, count);
+			table[x * 2]		= (int16_t)lrint(sin(phase) * 16384.0);
+			table[x * 2 + 1]	= (int16_t)lrint(cos(phase) * 16384.0);
+		}
+	}
+
+	double zonePlatePhase(long x, long width)
+	{
+		double centred = x - width / 2.0 + 0.5;
+		return fmod(2.0 * M_PI * kMaxLumaFrequency * centred * centred / width, 2.0 * M_PI);
+	}
+
+	double lumaSweepPhase(long x, long width)
+	{
+		return fmod(M_PI * kMaxLumaFrequency * x * x / width, 2.0 * M_PI);
+	}
+
+	double chromaSweepPhase(long x, long width)
+	{
+		return fmod(M_PI * kMaxChromaFrequency * x * x / width, 2.0 * M_PI);
+	}
+
+	// out[x] = offset + amplitude * sin(column phase[x] + rowPhase), using
+	// sin(a + b) = sin(a)cos(b) + cos(a)sin(b) so a row costs one multiply-add per sample
+	void sineRow(const int16_t* table, double rowPhase, int amplitude, int16_t offset, int16_t* out, long count)
+	{
+		const int16_t cosCoef = (int16_t)lrint(cos(rowPhase) * amplitude * 4.0);
+		const int16_t sinCoef = (int16_t)lrint(sin(rowPhase) * amplitude * 4.0);
+		long x = 0;
+#if defined(__SSE2__)
+		const __m128i coef = _mm_set1_epi32((int)(((uint32_t)(uint16_t)sinCoef << 16) | (uint16_t)cosCoef));
+		const __m128i base = _mm_set1_epi16(offset);
+		for (; x + 8 <= count; x += 8)
+		{
+			__m128i lo = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(table + x * 2)), coef);
+			__m128i hi = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(table + x * 2 + 8)), coef);
+			__m128i v = _mm_packs_epi32(_mm_srai_epi32(lo, 16), _mm_srai_epi32(hi, 16));
+			_mm_storeu_si128((__m128i*)(out + x), _mm_add_epi16(v, base));
+		}
+#elif defined(__ARM_NEON)
+		const int16x4_t c = vdup_n_s16(cosCoef);
+		const int16x4_t s = vdup_n_s16(sinCoef);
+		const int16x8_t base = vdupq_n_s16(offset);
+		for (; x + 8 <= count; x += 8)
+		{
+			int16x8x2_t sc = vld2q_s16(table + x * 2);
+			int32x4_t lo = vmlal_s16(vmull_s16(vget_low_s16(sc.val[0]), c), vget_low_s16(sc.val[1]), s);
+			int32x4_t hi = vmlal_s16(vmull_s16(vget_high_s16(sc.val[0]), c), vget_high_s16(sc.val[1]), s);
+			vst1q_s16(out + x, vaddq_s16(vcombine_s16(vshrn_n_s32(lo, 16), vshrn_n_s32(hi, 16)), base));
+		}
+#endif
+		for (; x < count; x++)
+			out[x] = (int16_t)(offset + ((table[x * 2] * cosCoef + table[x * 2 + 1] * sinCoef) >> 16));
+	}
+
+	void fillRow(int16_t* out, int16_t value, long count)
+	{
+		std::fill(out, out + count, value);
+	}
+
+	inline int16_t clampSample(int value, int maximum)
+	{
+		return (int16_t)(value < 0 ? 0 : (value > maximum ? maximum : value));
+	}
+
+	// Rec.709 Y'CbCr to R'G'B' with Q12 coefficients. Colour differences are scaled by 16 so that
+	// the SIMD paths can take the high half of a 16-bit multiply; the scalar path matches them.
+	const int16_t	kCrToR			= 6451;
+	const int16_t	kCbToG			= 767;
+	const int16_t	kCrToG			= 1917;
+	const int16_t	kCbToB			= 7600;
+
+	// 4095 / 876 in Q12, for expanding 10-bit video levels (scaled by 16) to 12-bit full range
+	const int16_t	kExpandTo12Bit	= 19148;
+
+	void convertRowToRGB(const int16_t* y, const int16_t* cb, const int16_t* cr, int16_t* r, int16_t* g, int16_t* b, long count, bool fullRange12)
+	{
+		long x = 0;
+#if defined(__SSE2__)
+		const __m128i neutral	= _mm_set1_epi16(kNeutralChroma);
+		const __m128i black		= _mm_set1_epi16(kBlackLuma);
+		const __m128i zero		= _mm_setzero_si128();
+		const __m128i max10		= _mm_set1_epi16(1023);
+		const __m128i max12		= _mm_set1_epi16(4095);
+		for (; x + 8 <= count; x += 8)
+		{
+			__m128i vy	= _mm_loadu_si128((const __m128i*)(y + x));
+			__m128i vcb	= _mm_slli_epi16(_mm_sub_epi16(_mm_loadu_si128((const __m128i*)(cb + x)), neutral), 4);
+			__m128i vcr	= _mm_slli_epi16(_mm_sub_epi16(_mm_loadu_si128((const __m128i*)(cr + x)), neutral), 4);
+			__m128i rgb[3];
+
+			rgb[0] = _mm_add_epi16(vy, _mm_mulhi_epi16(vcr, _mm_set1_epi16(kCrToR)));
+			rgb[1] = _mm_sub_epi16(_mm_sub_epi16(vy, _mm_mulhi_epi16(vcb, _mm_set1_epi16(kCbToG))), _mm_mulhi_epi16(vcr, _mm_set1_epi16(kCrToG)));
+			rgb[2] = _mm_add_epi16(vy, _mm_mulhi_epi16(vcb, _mm_set1_epi16(kCbToB)));
+
+			for (int i = 0; i < 3; i++)
+			{
+				rgb[i] = _mm_min_epi16(_mm_max_epi16(rgb[i], zero), max10);
+				if (fullRange12)
+				{
+					rgb[i] = _mm_mulhi_epi16(_mm_slli_epi16(_mm_sub_epi16(rgb[i], black), 4), _mm_set1_epi16(kExpandTo12Bit));
+					rgb[i] = _mm_min_epi16(_mm_max_epi16(rgb[i], zero), max12);
+				}
+			}
+
+			_mm_storeu_si128((__m128i*)(r + x), rgb[0]);
+			_mm_storeu_si128((__m128i*)(g + x), rgb[1]);
+			_mm_storeu_si128((__m128i*)(b + x), rgb[2]);
+		}
+#elif defined(__ARM_NEON)
+		// vqdmulh doubles the product, so the differences are scaled by 8 here
+		const int16x8_t neutral	= vdupq_n_s16(kNeutralChroma);
+		const int16x8_t black	= vdupq_n_s16(kBlackLuma);
+		const int16x8_t zero	= vdupq_n_s16(0);
+		const int16x8_t max10	= vdupq_n_s16(1023);
+		const int16x8_t max12	= vdupq_n_s16(4095);
+		for (; x + 8 <= count; x += 8)
+		{
+			int16x8_t vy	= vld1q_s16(y + x);
+			int16x8_t vcb	= vshlq_n_s16(vsubq_s16(vld1q_s16(cb + x), neutral), 3);
+			int16x8_t vcr	= vshlq_n_s16(vsubq_s16(vld1q_s16(cr + x), neutral), 3);
+			int16x8_t rgb[3];
+
+			rgb[0] = vaddq_s16(vy, vqdmulhq_n_s16(vcr, kCrToR));
+			rgb[1] = vsubq_s16(vsubq_s16(vy, vqdmulhq_n_s16(vcb, kCbToG)), vqdmulhq_n_s16(vcr, kCrToG));
+			rgb[2] = vaddq_s16(vy, vqdmulhq_n_s16(vcb, kCbToB));
+
+			for (int i = 0; i < 3; i++)
+			{
+				rgb[i] = vminq_s16(vmaxq_s16(rgb[i], zero), max10);
+				if (fullRange12)
+				{
+					rgb[i] = vqdmulhq_n_s16(vshlq_n_s16(vsubq_s16(rgb[i], black), 3), kExpandTo12Bit);
+					rgb[i] = vminq_s16(vmaxq_s16(rgb[i], zero), max12);
+				}
+			}
+
+			vst1q_s16(r + x, rgb[0]);
+			vst1q_s16(g + x, rgb[1]);
+			vst1q_s16(b + x, rgb[2]);
+		}
+#endif
+		for (; x < count; x++)
+		{
+			int dcb = (cb[x] - kNeutralChroma) * 16;
+			int dcr = (cr[x] - kNeutralChroma) * 16;
+			int16_t rgb[3];
+
+			rgb[0] = clampSample(y[x] + ((dcr * kCrToR) >> 16), 1023);
+			rgb[1] = clampSample(y[x] - ((dcb * kCbToG) >> 16) - ((dcr * kCrToG) >> 16), 1023);
+			rgb[2] = clampSample(y[x] + ((dcb * kCbToB) >> 16), 1023);
+
+			if (fullRange12)
+			{
+				for (int i = 0; i < 3; i++)
+					rgb[i] = clampSample(((rgb[i] - kBlackLuma) * 16 * kExpandTo12Bit) >> 16, 4095);
+			}
+
+			r[x] = rgb[0];
+			g[x] = rgb[1];
+			b[x] = rgb[2];
+		}
+	}
+
+#if defined(__SSE2__)
+	// Output frames are only read by the card, so aligned stores bypass the cache
+	// rather than evicting the scratch rows
+	inline void storeGroup(uint8_t* dest, __m128i group, bool aligned)
+	{
+		if (aligned)
+			_mm_stream_si128((__m128i*)dest, group);
+		else
+			_mm_storeu_si128((__m128i*)dest, group);
+	}
+#endif
+
+	void copyRow(uint8_t* dest, const uint8_t* source, long bytes)
+	{
+		long i = 0;
+#if defined(__SSE2__)
+		const bool aligned = ((uintptr_t)dest & 15) == 0;
+		for (; i + 16 <= bytes; i += 16)
+			storeGroup(dest + i, _mm_loadu_si128((const __m128i*)(source + i)), aligned);
+#endif
+		memcpy(dest + i, source + i, bytes - i);
+	}
+}
+
+MovingPatternRenderer::MovingPatternRenderer(MovingPattern pattern, BMDPixelFormat pixelFormat, long width, long height, unsigned long framesPerSecond, unsigned threadCount) :
+	m_pattern(pattern),
+	m_pixelFormat(pixelFormat),
+	m_width(width),
+	m_height(height),
+	m_paddedWidth(((width + 47) / 48) * 48),
+	m_framesPerSecond(framesPerSecond),
+	m_frameNumber(0),
+	m_timePhase(0.0),
+	m_scrollOffset(0),
+	m_frameBytes(NULL),
+	m_rowBytes(0),
+	m_generation(0),
+	m_busyWorkers(0),
+	m_quit(false),
+	m_nextBand(0)
+{
+	if (m_pattern == kMovingPatternZonePlate)
+	{
+		buildPhaseTable(m_lumaColumnPhase, m_width, zonePlatePhase);
+
+		// The zone plate is circular, so rows use the same phase curve, centred on the picture height
+		m_zonePlateRowPhase.resize(m_height);
+		for (long y = 0; y < m_height; y++)
+		{
+			double centred = y - m_height / 2.0 + 0.5;
+			m_zonePlateRowPhase[y] = fmod(2.0 * M_PI * kMaxLumaFrequency * centred * centred / m_width, 2.0 * M_PI);
+		}
+	}
+	else if (m_pattern == kMovingPatternSweep)
+	{
+		buildPhaseTable(m_lumaColumnPhase, m_width, lumaSweepPhase);
+		buildPhaseTable(m_chromaColumnPhase, m_width, chromaSweepPhase);
+	}
+	else if (m_pattern == kMovingPatternScrollingBars)
+	{
+		m_barColumns.resize(m_width);
+		for (long x = 0; x < m_width; x++)
+			m_barColumns[x] = (uint8_t)((x * 8) / m_width);
+	}
+
+	m_overlayScale	= std::max(1L, m_height / kOverlayLinesPerScale);
+	m_overlayLeft	= kOverlayMarginCells * m_overlayScale;
+	m_overlayTop	= kOverlayMarginCells * m_overlayScale;
+	m_overlayWidth	= std::min(kOverlayCellsWide * m_overlayScale, m_width - m_overlayLeft);
+	m_overlayHeight	= std::min(kOverlayCellsHigh * m_overlayScale, m_height - m_overlayTop);
+	memset(m_overlayText, 0, sizeof(m_overlayText));
+
+	if (threadCount < 1)
+		threadCount = 1;
+
+	// Padding beyond the active width stays black, so partial pixel groups pack cleanly
+	m_rowBuffers.resize(threadCount);
+	for (RowBuffer& buffer : m_rowBuffers)
+	{
+		buffer.y.assign(m_paddedWidth, kBlackLuma);
+		buffer.cb.assign(m_paddedWidth, kNeutralChroma);
+		buffer.cr.assign(m_paddedWidth, kNeutralChroma);
+		buffer.neutralChroma = true;
+
+		if (m_pixelFormat == bmdFormat10BitRGB || m_pixelFormat == bmdFormat12BitRGB)
+		{
+			buffer.r.assign(m_paddedWidth, 0);
+			buffer.g.assign(m_paddedWidth, 0);
+			buffer.b.assign(m_paddedWidth, 0);
+		}
+
+		if (m_pixelFormat == bmdFormat12BitRGB)
+			buffer.packed.assign((m_paddedWidth / 2) * 9, 0);
+	}
+
+	for (unsigned i = 1; i < threadCount; i++)
+		m_workers.push_back(std::thread(&MovingPatternRenderer::WorkerThread, this, i));
+}
+
+MovingPatternRenderer::~MovingPatternRenderer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_startCondition.notify_all();
+
+	for (std::thread& worker : m_workers)
+		worker.join();
+}
+
+bool MovingPatternRenderer::IsPixelFormatSupported(BMDPixelFormat pixelFormat)
+{
+	switch (pixelFormat)
+	{
+		case bmdFormat8BitYUV:
+		case bmdFormat10BitYUV:
+		case bmdFormat10BitRGB:
+		case bmdFormat12BitRGB:
+			return true;
+		default:
+			return false;
+	}
+}
+
+const char* MovingPatternRenderer::GetPatternName(MovingPattern pattern)
+{
+	switch (pattern)
+	{
+		case kMovingPatternNone:
+			return "Colour bars / black";
+		case kMovingPatternZonePlate:
+			return "Moving zone plate";
+		case kMovingPatternSweep:
+			return "Luma / chroma sweep";
+		case kMovingPatternScrollingBars:
+			return "Scrolling colour bars";
+	}
+	return "unknown";
+}
+
+void MovingPatternRenderer::RenderFrame(void* bytes, long rowBytes, unsigned long frameNumber)
+{
+	unsigned long	phaseFrame = frameNumber % m_framesPerSecond;
+	unsigned long	scrollFrames = m_framesPerSecond * kScrollSecondsPerWidth;
+	int				templateCount = 0;
+
+	m_frameNumber	= frameNumber;
+	m_timePhase		= 2.0 * M_PI * kPhaseCyclesPerSecond * phaseFrame / m_framesPerSecond;
+	m_scrollOffset	= (long)(((frameNumber % scrollFrames) * m_width) / scrollFrames);
+	m_frameBytes	= (uint8_t*)bytes;
+	m_rowBytes		= rowBytes;
+
+	// Non-drop timecode counted at the rounded frame rate, and a frame counter
+	snprintf(m_overlayText[0], sizeof(m_overlayText[0]), "%02lu:%02lu:%02lu:%02lu",
+		(frameNumber / (m_framesPerSecond * 3600)) % 24, (frameNumber / (m_framesPerSecond * 60)) % 60,
+		(frameNumber / m_framesPerSecond) % 60, frameNumber % m_framesPerSecond);
+	snprintf(m_overlayText[1], sizeof(m_overlayText[1]), "%08lu", frameNumber % 100000000);
+
+	// Render the rows that repeat down the frame once. The sweep has one for each half.
+	if (m_pattern == kMovingPatternScrollingBars)
+		templateCount = 1;
+	else if (m_pattern == kMovingPatternSweep)
+		templateCount = 2;
+
+	if (m_templateRows.size() != (size_t)(templateCount * rowBytes))
+		m_templateRows.assign(templateCount * rowBytes, 0);
+
+	for (int i = 0; i < templateCount; i++)
+	{
+		RenderPatternRow((i == 0) ? 0 : m_height - 1, m_rowBuffers[0]);
+		PackRow(m_rowBuffers[0], &m_templateRows[i * rowBytes]);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_nextBand = 0;
+		m_busyWorkers = (unsigned)m_workers.size();
+		++m_generation;
+	}
+	m_startCondition.notify_all();
+
+	RenderBands(m_rowBuffers[0]);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this]{ return m_busyWorkers == 0; });
+}
+
+void MovingPatternRenderer::WorkerThread(unsigned index)
+{
+	unsigned long generation = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_startCondition.wait(lock, [&]{ return m_quit || m_generation != generation; });
+			if (m_quit)
+				return;
+			generation = m_generation;
+		}
+
+		RenderBands(m_rowBuffers[index]);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (--m_busyWorkers == 0)
+				m_doneCondition.notify_one();
+		}
+	}
+}
+
+void MovingPatternRenderer::RenderBands(RowBuffer& buffer)
+{
+	const long bandCount = (m_height + kBandRows - 1) / kBandRows;
+
+	for (long band = m_nextBand++; band < bandCount; band = m_nextBand++)
+	{
+		long endRow = std::min(m_height, (band + 1) * kBandRows);
+
+		for (long row = band * kBandRows; row < endRow; row++)
+		{
+			uint8_t*	dest = m_frameBytes + row * m_rowBytes;
+			bool		overlayRow = (row >= m_overlayTop) && (row < m_overlayTop + m_overlayHeight);
+			int			rowTemplate = GetRowTemplate(row);
+
+			if (!overlayRow && rowTemplate >= 0)
+			{
+				copyRow(dest, &m_templateRows[rowTemplate * m_rowBytes], m_rowBytes);
+				continue;
+			}
+
+			RenderPatternRow(row, buffer);
+			if (overlayRow)
+				RenderOverlayRow(row, buffer);
+			PackRow(buffer, dest);
+		}
+	}
+
+#if defined(__SSE2__)
+	// Make the streaming stores visible before the frame is handed to the card
+	_mm_sfence();
+#endif
+}
+
+int MovingPatternRenderer::GetRowTemplate(long row) const
+{
+	switch (m_pattern)
+	{
+		case kMovingPatternScrollingBars:
+			return 0;
+		case kMovingPatternSweep:
+			return (row < m_height / 2) ? 0 : 1;
+		default:
+			return -1;
+	}
+}
+
+void MovingPatternRenderer::RenderPatternRow(long row, RowBuffer& buffer) const
+{
+	int16_t* y	= buffer.y.data();
+	int16_t* cb	= buffer.cb.data();
+	int16_t* cr	= buffer.cr.data();
+
+	// Most rows are grey, so the chroma rows are only refilled after something coloured was drawn
+	auto neutralChroma = [&]()
+	{
+		if (!buffer.neutralChroma)
+		{
+			fillRow(cb, kNeutralChroma, m_width);
+			fillRow(cr, kNeutralChroma, m_width);
+			buffer.neutralChroma = true;
+		}
+	};
+
+	switch (m_pattern)
+	{
+		case kMovingPatternZonePlate:
+			// Rings move outward, one cycle per second
+			sineRow(m_lumaColumnPhase.data(), m_zonePlateRowPhase[row] - m_timePhase, kLumaAmplitude, kMidLuma, y, m_width);
+			neutralChroma();
+			break;
+
+		case kMovingPatternSweep:
+			if (row < m_height / 2)
+			{
+				// Luma frequency sweep, with the phase advancing so each frequency moves across the picture
+				sineRow(m_lumaColumnPhase.data(), m_timePhase, kLumaAmplitude, kMidLuma, y, m_width);
+				neutralChroma();
+			}
+			else
+			{
+				// Chroma frequency sweep at mid grey, with Cr in quadrature to Cb
+				fillRow(y, kMidLuma, m_width);
+				sineRow(m_chromaColumnPhase.data(), m_timePhase, kChromaAmplitude, kNeutralChroma, cb, m_width);
+				sineRow(m_chromaColumnPhase.data(), m_timePhase + M_PI / 2.0, kChromaAmplitude, kNeutralChroma, cr, m_width);
+				buffer.neutralChroma = false;
+			}
+			break;
+
+		case kMovingPatternScrollingBars:
+		{
+			long source = m_scrollOffset;
+			for (long x = 0; x < m_width; x++, source++)
+			{
+				if (source == m_width)
+					source = 0;
+				const int16_t* bar = kBars[m_barColumns[source]];
+				y[x] = bar[0];
+				cb[x] = bar[1];
+				cr[x] = bar[2];
+			}
+			buffer.neutralChroma = false;
+			break;
+		}
+
+		default:
+			fillRow(y, kBlackLuma, m_width);
+			neutralChroma();
+			break;
+	}
+}
+
+void MovingPatternRenderer::RenderOverlayRow(long row, RowBuffer& buffer) const
+{
+	long cellRow = (row - m_overlayTop) / m_overlayScale;
+
+	fillRow(buffer.y.data() + m_overlayLeft, kBlackLuma, m_overlayWidth);
+	if (!buffer.neutralChroma)
+	{
+		fillRow(buffer.cb.data() + m_overlayLeft, kNeutralChroma, m_overlayWidth);
+		fillRow(buffer.cr.data() + m_overlayLeft, kNeutralChroma, m_overlayWidth);
+	}
+
+	for (int line = 0; line < 2; line++)
+	{
+		long glyphRow = cellRow - 1 - line * kCellHeight;
+		if (glyphRow < 0 || glyphRow >= kGlyphHeight)
+			continue;
+
+		for (long column = 0; m_overlayText[line][column] != '\0'; column++)
+		{
+			uint8_t bits = glyphRowBits(m_overlayText[line][column], glyphRow);
+
+			for (long glyphColumn = 0; glyphColumn < kGlyphWidth; glyphColumn++)
+			{
+				if ((bits & (0x10 >> glyphColumn)) == 0)
+					continue;
+
+				long start = (1 + column * kCellWidth + glyphColumn) * m_overlayScale;
+				long end = std::min(start + m_overlayScale, m_overlayWidth);
+				if (start < end)
+					fillRow(buffer.y.data() + m_overlayLeft + start, kWhiteLuma, end - start);
+			}
+		}
+	}
+}
+
+void MovingPatternRenderer::PackRow(RowBuffer& buffer, uint8_t* dest) const
+{
+	const int16_t*	y		= buffer.y.data();
+	const int16_t*	cb		= buffer.cb.data();
+	const int16_t*	cr		= buffer.cr.data();
+	long			x		= 0;
+#if defined(__SSE2__)
+	const bool		aligned	= ((uintptr_t)dest & 15) == 0;
+#endif
+
+	// Refer to DeckLink SDK Manual - 2.7.4 Pixel Formats. 4:2:2 formats take co-sited chroma from even samples.
+	switch (m_pixelFormat)
+	{
+		case bmdFormat8BitYUV:
+#if defined(__SSE2__)
+			for (; x + 8 <= m_width; x += 8, dest += 16)
+			{
+				// Interleave even Cb and Cr, then interleave with luma to give Cb Y Cr Y
+				__m128i chroma = _mm_or_si128(_mm_and_si128(_mm_loadu_si128((const __m128i*)(cb + x)), _mm_set1_epi32(0xFFFF)),
+											  _mm_slli_epi32(_mm_loadu_si128((const __m128i*)(cr + x)), 16));
+				__m128i luma = _mm_loadu_si128((const __m128i*)(y + x));
+				__m128i lo = _mm_srli_epi16(_mm_unpacklo_epi16(chroma, luma), 2);
+				__m128i hi = _mm_srli_epi16(_mm_unpackhi_epi16(chroma, luma), 2);
+				storeGroup(dest, _mm_packus_epi16(lo, hi), aligned);
+			}
+#endif
+			for (; x < m_width; x += 2, dest += 4)
+			{
+				dest[0] = (uint8_t)(cb[x] >> 2);
+				dest[1] = (uint8_t)(y[x] >> 2);
+				dest[2] = (uint8_t)(cr[x] >> 2);
+				dest[3] = (uint8_t)(y[x + 1] >> 2);
+			}
+			break;
+
+		case bmdFormat10BitYUV:
+			// Six pixels in four words; the padded width is a whole number of 128 byte blocks
+			for (; x < m_paddedWidth; x += 6, dest += 16)
+			{
+				uint32_t word0 = cb[x]		| (y[x] << 10)		| (cr[x] << 20);
+				uint32_t word1 = y[x + 1]	| (cb[x + 2] << 10)	| (y[x + 2] << 20);
+				uint32_t word2 = cr[x + 2]	| (y[x + 3] << 10)	| (cb[x + 4] << 20);
+				uint32_t word3 = y[x + 4]	| (cr[x + 4] << 10)	| (y[x + 5] << 20);
+#if defined(__SSE2__)
+				storeGroup(dest, _mm_setr_epi32(word0, word1, word2, word3), aligned);
+#else
+				uint32_t* words = (uint32_t*)dest;
+				words[0] = word0;
+				words[1] = word1;
+				words[2] = word2;
+				words[3] = word3;
+#endif
+			}
+			break;
+
+		case bmdFormat10BitRGB:
+		{
+			const int16_t* r = buffer.r.data();
+			const int16_t* g = buffer.g.data();
+			const int16_t* b = buffer.b.data();
+
+			convertRowToRGB(y, cb, cr, buffer.r.data(), buffer.g.data(), buffer.b.data(), m_width, false);
+
+			// Big-endian words. The row is padded to 64 pixels, so whole groups of eight can be written.
+#if defined(__SSE2__)
+			for (; x < m_width; x += 8, dest += 32)
+			{
+				__m128i vr = _mm_loadu_si128((const __m128i*)(r + x));
+				__m128i vg = _mm_loadu_si128((const __m128i*)(g + x));
+				__m128i vb = _mm_loadu_si128((const __m128i*)(b + x));
+
+				// Per pixel, the low half is (g << 10 | b) & 0xFFFF and the high half is r << 4 | g >> 6
+				__m128i low = _mm_or_si128(_mm_slli_epi16(vg, 10), vb);
+				__m128i high = _mm_or_si128(_mm_slli_epi16(vr, 4), _mm_srli_epi16(vg, 6));
+				__m128i words[2] = { _mm_unpacklo_epi16(low, high), _mm_unpackhi_epi16(low, high) };
+
+				for (int i = 0; i < 2; i++)
+				{
+					// Byte swap each word: swap the halves, then the bytes within each half
+					__m128i swapped = _mm_shufflehi_epi16(_mm_shufflelo_epi16(words[i], _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+					swapped = _mm_or_si128(_mm_slli_epi16(swapped, 8), _mm_srli_epi16(swapped, 8));
+					storeGroup(dest + i * 16, swapped, aligned);
+				}
+			}
+#else
+			for (; x < m_width; x++, dest += 4)
+				*(uint32_t*)dest = __builtin_bswap32((uint32_t)((r[x] << 20) | (g[x] << 10) | b[x]));
+#endif
+			break;
+		}
+
+		case bmdFormat12BitRGB:
+		{
+			const int16_t* r = buffer.r.data();
+			const int16_t* g = buffer.g.data();
+			const int16_t* b = buffer.b.data();
+
+			convertRowToRGB(y, cb, cr, buffer.r.data(), buffer.g.data(), buffer.b.data(), m_width, true);
+
+			// Eight pixels in nine words, which is a little-endian stream of 12-bit R, G, B fields,
+			// so each pair of pixels is nine bytes. Groups don't fall on 16 byte boundaries, so the
+			// row is packed in the scratch buffer and then copied out with streaming stores.
+			uint8_t* packed = buffer.packed.data();
+			for (; x < m_width; x += 2, packed += 9)
+			{
+				uint64_t pair = (uint64_t)r[x] | ((uint64_t)g[x] << 12) | ((uint64_t)b[x] << 24)
+							| ((uint64_t)r[x + 1] << 36) | ((uint64_t)g[x + 1] << 48) | ((uint64_t)b[x + 1] << 60);
+				memcpy(packed, &pair, sizeof(pair));
+				packed[8] = (uint8_t)(b[x + 1] >> 4);
+			}
+			copyRow(dest, buffer.packed.data(), packed - buffer.packed.data());
+			break;
+		}
+
+		default:
+			break;
+	}
+}
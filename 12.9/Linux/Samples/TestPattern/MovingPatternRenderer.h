@@ -0,0 +1,141 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef MOVING_PATTERN_RENDERER_H
+#define MOVING_PATTERN_RENDERER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "DeckLinkAPI.h"
+
+enum MovingPattern
+{
+	kMovingPatternNone			= 0,
+	kMovingPatternZonePlate		= 1,
+	kMovingPatternSweep			= 2,
+	kMovingPatternScrollingBars	= 3
+};
+
+// Renders a moving test signal with a burned-in timecode and frame counter straight into
+// the output frame buffer. Rows are rendered into 4:4:4 10-bit Y'CbCr scratch rows and
+// then packed to the output pixel format. Bands of rows are split between worker threads,
+// and rows that are the same for the whole frame are rendered once and copied. Output
+// frames are only read by the card, so aligned rows are written with streaming stores.
+class MovingPatternRenderer
+{
+public:
+	MovingPatternRenderer(MovingPattern pattern, BMDPixelFormat pixelFormat, long width, long height, unsigned long framesPerSecond, unsigned threadCount);
+	~MovingPatternRenderer();
+
+	static bool		IsPixelFormatSupported(BMDPixelFormat pixelFormat);
+	static const char*	GetPatternName(MovingPattern pattern);
+
+	void			RenderFrame(void* bytes, long rowBytes, unsigned long frameNumber);
+
+private:
+	struct RowBuffer
+	{
+		std::vector<int16_t>	y;
+		std::vector<int16_t>	cb;
+		std::vector<int16_t>	cr;
+		bool					neutralChroma;
+
+		// R'G'B' conversion output for the RGB pixel formats
+		std::vector<int16_t>	r;
+		std::vector<int16_t>	g;
+		std::vector<int16_t>	b;
+		std::vector<uint8_t>	packed;
+	};
+
+	MovingPattern				m_pattern;
+	BMDPixelFormat				m_pixelFormat;
+	long						m_width;
+	long						m_height;
+	long						m_paddedWidth;
+	unsigned long				m_framesPerSecond;
+
+	// Interleaved sin/cos pairs per column, for evaluating sin(column phase + row phase)
+	std::vector<int16_t>		m_lumaColumnPhase;
+	std::vector<int16_t>		m_chromaColumnPhase;
+	std::vector<double>			m_zonePlateRowPhase;
+	std::vector<uint8_t>		m_barColumns;
+
+	// Burned-in timecode and frame counter
+	long						m_overlayScale;
+	long						m_overlayLeft;
+	long						m_overlayTop;
+	long						m_overlayWidth;
+	long						m_overlayHeight;
+	char						m_overlayText[2][32];
+
+	// Per frame state
+	unsigned long				m_frameNumber;
+	double						m_timePhase;
+	long						m_scrollOffset;
+	uint8_t*					m_frameBytes;
+	long						m_rowBytes;
+	std::vector<uint8_t>		m_templateRows;
+
+	// Row-parallel workers. The thread calling RenderFrame() renders bands as well.
+	std::vector<RowBuffer>		m_rowBuffers;
+	std::vector<std::thread>	m_workers;
+	std::mutex					m_mutex;
+	std::condition_variable		m_startCondition;
+	std::condition_variable		m_doneCondition;
+	unsigned long				m_generation;
+	unsigned					m_busyWorkers;
+	bool						m_quit;
+	std::atomic<long>			m_nextBand;
+
+	void			WorkerThread(unsigned index);
+	void			RenderBands(RowBuffer& buffer);
+
+	int				GetRowTemplate(long row) const;
+	void			RenderPatternRow(long row, RowBuffer& buffer) const;
+	void			RenderOverlayRow(long row, RowBuffer& buffer) const;
+	void			PackRow(RowBuffer& buffer, uint8_t* dest) const;
+};
+
+#endif
@@ -0,0 +1,553 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+// Plays colour bars, tone and timecode on every output of every DeckLink card from one process.
+// Frames are rendered once per format and shared read-only by every output that uses it, and
+// each card's outputs are scheduled from a single timer thread.
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "DeckLinkAPI.h"
+#include "CardScheduler.h"
+#include "OutputChannel.h"
+#include "PatternFill.h"
+
+pthread_mutex_t			sleepMutex;
+pthread_cond_t			sleepCond;
+bool					do_exit = false;
+
+// One period of a 1kHz tone at 48kHz, as written by FillSine
+const uint32_t			kAudioPeriodSampleFrames = 48;
+const int				kDefaultStatisticsInterval = 10;
+
+struct MultiOutputConfig
+{
+	const char*			displayModeName;
+	BMDPixelFormat		pixelFormat;
+	bool				output444;
+	int					audioChannels;
+	int					audioSampleDepth;
+	std::set<int>		deviceIndexes;		// Empty for every output
+	int					statisticsInterval;
+};
+
+typedef std::tuple<long, long, BMDPixelFormat>	SharedFrameKey;
+
+static void sigfunc(int signum)
+{
+	if (signum == SIGINT || signum == SIGTERM)
+		do_exit = true;
+	pthread_cond_signal(&sleepCond);
+}
+
+static bool IsDeviceActive(IDeckLink* deckLink)
+{
+	IDeckLinkProfileAttributes*		deckLinkAttributes = NULL;
+	int64_t							duplexMode;
+
+	if (deckLink->QueryInterface(IID_IDeckLinkProfileAttributes, (void**)&deckLinkAttributes) != S_OK)
+		return false;
+
+	if (deckLinkAttributes->GetInt(BMDDeckLinkDuplex, &duplexMode) != S_OK)
+		duplexMode = (int64_t)bmdDuplexInactive;
+
+	deckLinkAttributes->Release();
+
+	return (BMDDuplexMode)duplexMode != bmdDuplexInactive;
+}
+
+static bool IsPlaybackDevice(IDeckLink* deckLink)
+{
+	IDeckLinkProfileAttributes*		deckLinkAttributes = NULL;
+	int64_t							ioSupport;
+
+	if (deckLink->QueryInterface(IID_IDeckLinkProfileAttributes, (void**)&deckLinkAttributes) != S_OK)
+		return false;
+
+	if (deckLinkAttributes->GetInt(BMDDeckLinkVideoIOSupport, &ioSupport) != S_OK)
+		ioSupport = 0;
+
+	deckLinkAttributes->Release();
+
+	return ((BMDVideoIOSupport)ioSupport & bmdDeviceSupportsPlayback) != 0;
+}
+
+// Sub-devices of the same card share a device group ID
+static int64_t GetDeviceGroupID(IDeckLink* deckLink, int deviceIndex)
+{
+	IDeckLinkProfileAttributes*		deckLinkAttributes = NULL;
+	int64_t							groupID;
+
+	if (deckLink->QueryInterface(IID_IDeckLinkProfileAttributes, (void**)&deckLinkAttributes) != S_OK)
+		return -1 - deviceIndex;
+
+	if ((deckLinkAttributes->GetInt(BMDDeckLinkDeviceGroupID, &groupID) != S_OK) &&
+		(deckLinkAttributes->GetInt(BMDDeckLinkPersistentID, &groupID) != S_OK))
+		groupID = -1 - deviceIndex;
+
+	deckLinkAttributes->Release();
+
+	return groupID;
+}
+
+static IDeckLinkDisplayMode* FindDisplayMode(IDeckLinkOutput* deckLinkOutput, const char* displayModeName)
+{
+	IDeckLinkDisplayModeIterator*	displayModeIterator = NULL;
+	IDeckLinkDisplayMode*			displayMode = NULL;
+	char*							name;
+
+	if (deckLinkOutput->GetDisplayModeIterator(&displayModeIterator) != S_OK)
+		return NULL;
+
+	while (displayModeIterator->Next(&displayMode) == S_OK)
+	{
+		if (displayMode->GetName((const char**)&name) == S_OK)
+		{
+			bool match = (strcmp(name, displayModeName) == 0);
+			free(name);
+
+			if (match)
+				break;
+		}
+
+		displayMode->Release();
+		displayMode = NULL;
+	}
+
+	displayModeIterator->Release();
+
+	return displayMode;
+}
+
+static void DisplayUsage(int status)
+{
+	IDeckLinkIterator*				deckLinkIterator = CreateDeckLinkIteratorInstance();
+	IDeckLink*						deckLink = NULL;
+	IDeckLinkOutput*				deckLinkOutput = NULL;
+	IDeckLinkDisplayModeIterator*	displayModeIterator = NULL;
+	IDeckLinkDisplayMode*			displayMode;
+	int								deckLinkCount = 0;
+	char*							name;
+
+	fprintf(stderr,
+		"Usage: MultiOutput -m <mode name> [OPTIONS]\n"
+		"\n"
+		"    Plays colour bars, tone and timecode on every output of every card\n"
+		"\n"
+		"    -d <device id>[,<device id>...]  Only use these outputs (default is every active output):\n"
+	);
+
+	while ((deckLinkIterator != NULL) && (deckLinkIterator->Next(&deckLink) == S_OK))
+	{
+		if (!IsPlaybackDevice(deckLink))
+		{
+			deckLink->Release();
+			continue;
+		}
+
+		if (deckLink->GetDisplayName((const char**)&name) == S_OK)
+		{
+			fprintf(stderr, "        %2d: %s%s\n", deckLinkCount, name, IsDeviceActive(deckLink) ? "" : " (inactive)");
+			free(name);
+		}
+
+		// Display modes are listed for the first output
+		if ((deckLinkOutput == NULL) && (deckLink->QueryInterface(IID_IDeckLinkOutput, (void**)&deckLinkOutput) != S_OK))
+			deckLinkOutput = NULL;
+
+		deckLink->Release();
+		++deckLinkCount;
+	}
+
+	if (deckLinkCount == 0)
+		fprintf(stderr, "        No DeckLink devices supporting output found. Is the driver loaded?\n");
+
+	fprintf(stderr, "    -m <mode name>:\n");
+
+	if ((deckLinkOutput != NULL) && (deckLinkOutput->GetDisplayModeIterator(&displayModeIterator) == S_OK))
+	{
+		while (displayModeIterator->Next(&displayMode) == S_OK)
+		{
+			if (displayMode->GetName((const char**)&name) == S_OK)
+			{
+				fprintf(stderr, "        %s\n", name);
+				free(name);
+			}
+			displayMode->Release();
+		}
+		displayModeIterator->Release();
+	}
+
+	fprintf(stderr,
+		"    -p <pixelformat>\n"
+		"         0:  8 bit YUV (4:2:2) (default)\n"
+		"         1:  10 bit YUV (4:2:2)\n"
+		"         2:  10 bit RGB (4:4:4)\n"
+		"         3:  12 bit RGB (4:4:4)\n"
+		"    -c <channels>        Audio Channels (2, 8 or 16 - default is 2)\n"
+		"    -s <depth>           Audio Sample Depth (16 or 32 - default is 16)\n"
+		"    -i <seconds>         Interval between statistics reports (default is %d)\n"
+		"\n"
+		"Output bars on every output eg:\n"
+		"\n"
+		"    MultiOutput -m 1080i59.94\n",
+		kDefaultStatisticsInterval
+	);
+
+	if (deckLinkOutput != NULL)
+		deckLinkOutput->Release();
+
+	if (deckLinkIterator != NULL)
+		deckLinkIterator->Release();
+
+	exit(status);
+}
+
+static bool ParseArguments(int argc, char** argv, MultiOutputConfig& config)
+{
+	int		ch;
+	char*	list;
+	char*	token;
+	char*	savePointer;
+
+	config.displayModeName = NULL;
+	config.pixelFormat = bmdFormat8BitYUV;
+	config.output444 = false;
+	config.audioChannels = 2;
+	config.audioSampleDepth = 16;
+	config.statisticsInterval = kDefaultStatisticsInterval;
+
+	while ((ch = getopt(argc, argv, "?hd:m:p:c:s:i:")) != -1)
+	{
+		switch (ch)
+		{
+			case 'd':
+				list = strdup(optarg);
+				for (token = strtok_r(list, ",", &savePointer); token != NULL; token = strtok_r(NULL, ",", &savePointer))
+					config.deviceIndexes.insert(atoi(token));
+				free(list);
+				break;
+
+			case 'm':
+				config.displayModeName = optarg;
+				break;
+
+			case 'p':
+				switch (atoi(optarg))
+				{
+					case 0: config.pixelFormat = bmdFormat8BitYUV;  config.output444 = false; break;
+					case 1: config.pixelFormat = bmdFormat10BitYUV; config.output444 = false; break;
+					case 2: config.pixelFormat = bmdFormat10BitRGB; config.output444 = true;  break;
+					case 3: config.pixelFormat = bmdFormat12BitRGB; config.output444 = true;  break;
+					default:
+						fprintf(stderr, "Invalid argument: Pixel format %d is not valid\n", atoi(optarg));
+						return false;
+				}
+				break;
+
+			case 'c':
+				config.audioChannels = atoi(optarg);
+				if (config.audioChannels != 2 && config.audioChannels != 8 && config.audioChannels != 16)
+				{
+					fprintf(stderr, "Invalid argument: Audio Channels must be either 2, 8 or 16\n");
+					return false;
+				}
+				break;
+
+			case 's':
+				config.audioSampleDepth = atoi(optarg);
+				if (config.audioSampleDepth != 16 && config.audioSampleDepth != 32)
+				{
+					fprintf(stderr, "Invalid argument: Audio Sample Depth must be either 16 bits or 32 bits\n");
+					return false;
+				}
+				break;
+
+			case 'i':
+				config.statisticsInterval = atoi(optarg);
+				if (config.statisticsInterval <= 0)
+				{
+					fprintf(stderr, "Invalid argument: Statistics interval must be at least 1 second\n");
+					return false;
+				}
+				break;
+
+			case '?':
+			case 'h':
+				DisplayUsage(0);
+		}
+	}
+
+	if (config.displayModeName == NULL)
+	{
+		fprintf(stderr, "You must select a display mode\n");
+		return false;
+	}
+
+	return true;
+}
+
+static void PrintStatistics(const std::vector<OutputChannel*>& channels)
+{
+	printf("\n%-36s %10s %8s %8s %8s %10s %14s %8s\n",
+		   "Output", "Completed", "Late", "Dropped", "Underrun", "Min ahead", "Audio margin", "Underrun");
+
+	for (OutputChannel* channel : channels)
+	{
+		OutputChannelStatistics		statistics;
+		char						audioMargin[16] = "-";
+
+		channel->GetStatistics(statistics);
+		if (statistics.audio.running)
+			snprintf(audioMargin, sizeof(audioMargin), "%.1f ms", (double)statistics.audio.minimumMargin * 1000.0 / AudioFeeder::kSampleRate);
+
+		printf("%-36.36s %10llu %8llu %8llu %8llu %10lld %14s %8llu\n",
+			   channel->GetName().c_str(),
+			   (unsigned long long)statistics.framesCompleted,
+			   (unsigned long long)statistics.framesLate,
+			   (unsigned long long)statistics.framesDropped,
+			   (unsigned long long)statistics.videoUnderruns,
+			   (long long)statistics.minimumBufferedFrames,
+			   audioMargin,
+			   (unsigned long long)statistics.audio.underruns);
+	}
+
+	fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+	MultiOutputConfig							config;
+	IDeckLinkIterator*							deckLinkIterator = NULL;
+	IDeckLink*									deckLink = NULL;
+	int											deckLinkIndex = 0;
+	std::vector<OutputChannel*>					channels;
+	std::vector<CardScheduler*>					schedulers;
+	std::map<SharedFrameKey, IDeckLinkVideoFrame*>	sharedFrames;
+	void*										audioPeriod = NULL;
+	BMDTimeValue								frameDuration = 0;
+	BMDTimeScale								frameTimescale = 0;
+	int											exitStatus = 1;
+
+	pthread_mutex_init(&sleepMutex, NULL);
+	pthread_cond_init(&sleepCond, NULL);
+
+	signal(SIGINT, sigfunc);
+	signal(SIGTERM, sigfunc);
+	signal(SIGHUP, sigfunc);
+
+	if (!ParseArguments(argc, argv, config))
+		DisplayUsage(1);
+
+	deckLinkIterator = CreateDeckLinkIteratorInstance();
+	if (deckLinkIterator == NULL)
+	{
+		fprintf(stderr, "This application requires the DeckLink drivers installed.\n");
+		goto bail;
+	}
+
+	// One period of tone, copied into each output's audio ring
+	audioPeriod = calloc(kAudioPeriodSampleFrames, config.audioChannels * (config.audioSampleDepth / 8));
+	if (audioPeriod == NULL)
+		goto bail;
+	FillSine(audioPeriod, kAudioPeriodSampleFrames, config.audioChannels, config.audioSampleDepth);
+
+	while (deckLinkIterator->Next(&deckLink) == S_OK)
+	{
+		IDeckLinkDisplayMode*	displayMode = NULL;
+		OutputChannel*			channel = NULL;
+		CardScheduler*			scheduler = NULL;
+		char*					deviceName = NULL;
+		char					channelName[128];
+		int64_t					groupID;
+		bool					supported = false;
+
+		if (!IsPlaybackDevice(deckLink))
+		{
+			deckLink->Release();
+			continue;
+		}
+
+		if ((!config.deviceIndexes.empty() && (config.deviceIndexes.count(deckLinkIndex) == 0)) || !IsDeviceActive(deckLink))
+		{
+			deckLink->Release();
+			++deckLinkIndex;
+			continue;
+		}
+
+		if (deckLink->GetDisplayName((const char**)&deviceName) != S_OK)
+			deviceName = strdup("DeckLink");
+		snprintf(channelName, sizeof(channelName), "%2d: %s", deckLinkIndex, deviceName);
+		free(deviceName);
+
+		groupID = GetDeviceGroupID(deckLink, deckLinkIndex);
+		channel = new OutputChannel(deckLink, channelName);
+		deckLink->Release();
+		++deckLinkIndex;
+
+		if (channel->GetOutput() != NULL)
+		{
+			displayMode = FindDisplayMode(channel->GetOutput(), config.displayModeName);
+			if ((displayMode != NULL) &&
+				(channel->GetOutput()->DoesSupportVideoMode(bmdVideoConnectionUnspecified, displayMode->GetDisplayMode(), config.pixelFormat,
+															bmdNoVideoOutputConversion, bmdSupportedVideoModeDefault, NULL, &supported) != S_OK))
+				supported = false;
+		}
+
+		if (!supported)
+		{
+			fprintf(stderr, "%s: Skipped, %s is not supported\n", channelName, config.displayModeName);
+			if (displayMode != NULL)
+				displayMode->Release();
+			channel->Release();
+			continue;
+		}
+
+		// Render the pattern the first time a format is seen, every other output of that format shares it
+		SharedFrameKey key(displayMode->GetWidth(), displayMode->GetHeight(), config.pixelFormat);
+		if (sharedFrames.find(key) == sharedFrames.end())
+		{
+			IDeckLinkVideoFrame* frame = NULL;
+
+			if (CreatePatternFrame(channel->GetOutput(), displayMode->GetWidth(), displayMode->GetHeight(), config.pixelFormat, FillForwardColourBars, &frame) != S_OK)
+			{
+				displayMode->Release();
+				channel->Release();
+				continue;
+			}
+			sharedFrames[key] = frame;
+		}
+
+		displayMode->GetFrameRate(&frameDuration, &frameTimescale);
+
+		if (!channel->Start(displayMode, config.pixelFormat, config.output444, sharedFrames[key], audioPeriod, kAudioPeriodSampleFrames, config.audioChannels, config.audioSampleDepth))
+		{
+			displayMode->Release();
+			channel->Release();
+			continue;
+		}
+		displayMode->Release();
+
+		for (CardScheduler* cardScheduler : schedulers)
+		{
+			if (cardScheduler->GetGroupID() == groupID)
+				scheduler = cardScheduler;
+		}
+
+		if (scheduler == NULL)
+		{
+			scheduler = new CardScheduler(groupID, channelName);
+			schedulers.push_back(scheduler);
+		}
+
+		scheduler->AddChannel(channel);
+		channels.push_back(channel);
+	}
+
+	if (channels.empty())
+	{
+		fprintf(stderr, "No outputs started\n");
+		goto bail;
+	}
+
+	fprintf(stderr, "Playing %s on %zu outputs of %zu cards, from %zu shared frames\n",
+			config.displayModeName, channels.size(), schedulers.size(), sharedFrames.size());
+
+	// All outputs play the same display mode, so every card ticks at the same rate
+	for (CardScheduler* scheduler : schedulers)
+		scheduler->Start(frameDuration, frameTimescale);
+
+	pthread_mutex_lock(&sleepMutex);
+	while (!do_exit)
+	{
+		struct timeval		now;
+		struct timespec		timeout;
+
+		gettimeofday(&now, NULL);
+		timeout.tv_sec = now.tv_sec + config.statisticsInterval;
+		timeout.tv_nsec = now.tv_usec * 1000;
+
+		if (pthread_cond_timedwait(&sleepCond, &sleepMutex, &timeout) == ETIMEDOUT)
+			PrintStatistics(channels);
+	}
+	pthread_mutex_unlock(&sleepMutex);
+
+	fprintf(stderr, "Stopping playback\n");
+	exitStatus = 0;
+
+bail:
+	for (CardScheduler* scheduler : schedulers)
+		scheduler->Stop();
+
+	for (OutputChannel* channel : channels)
+		channel->Stop();
+
+	if (!channels.empty())
+		PrintStatistics(channels);
+
+	for (CardScheduler* scheduler : schedulers)
+		delete scheduler;
+
+	for (OutputChannel* channel : channels)
+		channel->Release();
+
+	for (auto& sharedFrame : sharedFrames)
+		sharedFrame.second->Release();
+
+	if (audioPeriod != NULL)
+		free(audioPeriod);
+
+	if (deckLinkIterator != NULL)
+		deckLinkIterator->Release();
+
+	return exitStatus;
+}
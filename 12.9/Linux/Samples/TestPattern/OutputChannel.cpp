@@ -0,0 +1,433 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "OutputChannel.h"
+
+// Frames kept scheduled ahead of the output; the timer thread tops them up once a frame
+const int64_t		kBufferedFrames = 6;
+const int			kFramePoolSize = kBufferedFrames + 2;
+const uint32_t		kAudioWaterlevel = 48000 / 4;
+
+static inline bool CompareREFIID(const REFIID& ref1, const REFIID& ref2)
+{
+	return memcmp(&ref1, &ref2, sizeof(REFIID)) == 0;
+}
+
+OutputChannel::OutputChannel(IDeckLink* deckLink, const std::string& name) :
+	m_refCount(1),
+	m_name(name),
+	m_deckLink(deckLink),
+	m_deckLinkOutput(),
+	m_audioFeeder(),
+	m_frameDuration(0),
+	m_frameTimescale(0),
+	m_framesPerSecond(0),
+	m_dropFrames(0),
+	m_progressive(true),
+	m_timecodeFormat(bmdTimecodeRP188Any),
+	m_nextFrameNumber(0),
+	m_running(false),
+	m_playbackStopped(false),
+	m_statistics()
+{
+	m_deckLink->AddRef();
+
+	if (m_deckLink->QueryInterface(IID_IDeckLinkOutput, (void**)&m_deckLinkOutput) == S_OK)
+		m_audioFeeder = new AudioFeeder(m_deckLinkOutput);
+}
+
+OutputChannel::~OutputChannel()
+{
+	ReleaseFrames();
+
+	if (m_audioFeeder != NULL)
+		delete m_audioFeeder;
+
+	if (m_deckLinkOutput != NULL)
+		m_deckLinkOutput->Release();
+
+	m_deckLink->Release();
+}
+
+bool OutputChannel::Start(IDeckLinkDisplayMode* displayMode, BMDPixelFormat pixelFormat, bool output444, IDeckLinkVideoFrame* sharedFrame,
+						  const void* audioPeriod, uint32_t audioPeriodSampleFrames, uint32_t audioChannels, uint32_t audioSampleDepth)
+{
+	HRESULT					result;
+	BMDDisplayMode			mode = displayMode->GetDisplayMode();
+	BMDVideoOutputFlags		outputFlags;
+	IDeckLinkConfiguration*	deckLinkConfiguration = NULL;
+	AudioFeederSettings		audioFeederSettings;
+
+	if (m_deckLinkOutput == NULL)
+		return false;
+
+	displayMode->GetFrameRate(&m_frameDuration, &m_frameTimescale);
+	m_framesPerSecond = (unsigned)((m_frameTimescale + (m_frameDuration - 1)) / m_frameDuration);
+	m_progressive = (displayMode->GetFieldDominance() == bmdProgressiveFrame);
+
+	// m-rate frame rates with multiple 30-frame counting should implement Drop Frames compensation, refer to SMPTE 12-1
+	if (m_frameDuration == 1001 && m_frameTimescale % 30000 == 0)
+		m_dropFrames = 2 * (unsigned)(m_frameTimescale / 30000);
+	else
+		m_dropFrames = 0;
+
+	if (mode == bmdModeNTSC || mode == bmdModeNTSC2398 || mode == bmdModePAL)
+	{
+		m_timecodeFormat = bmdTimecodeVITC;
+		outputFlags = bmdVideoOutputVITC;
+	}
+	else
+	{
+		m_timecodeFormat = bmdTimecodeRP188Any;
+		outputFlags = bmdVideoOutputRP188;
+	}
+
+	// Set the output to 444 if RGB mode is selected
+	if (m_deckLink->QueryInterface(IID_IDeckLinkConfiguration, (void**)&deckLinkConfiguration) == S_OK)
+	{
+		result = deckLinkConfiguration->SetFlag(bmdDeckLinkConfig444SDIVideoOutput, output444);
+		deckLinkConfiguration->Release();
+
+		// If a device without SDI output is used (eg Intensity Pro 4K), then SetFlags will return E_NOTIMPL
+		if ((result != S_OK) && (result != E_NOTIMPL))
+		{
+			fprintf(stderr, "%s: Failed to write to 444 output configuration flag\n", m_name.c_str());
+			return false;
+		}
+	}
+
+	m_deckLinkOutput->SetScheduledFrameCompletionCallback(this);
+
+	if (m_deckLinkOutput->EnableVideoOutput(mode, outputFlags) != S_OK)
+	{
+		fprintf(stderr, "%s: Failed to enable video output. Is another application using the card?\n", m_name.c_str());
+		goto bail;
+	}
+
+	if (m_deckLinkOutput->EnableAudioOutput(bmdAudioSampleRate48kHz, audioSampleDepth, audioChannels, bmdAudioOutputStreamTimestamped) != S_OK)
+	{
+		fprintf(stderr, "%s: Failed to enable audio output\n", m_name.c_str());
+		goto bail;
+	}
+
+	// Every frame in the pool shows the same shared pixels, only the timecode differs
+	for (int i = 0; i < kFramePoolSize; i++)
+	{
+		TimecodedVideoFrame* frame = new TimecodedVideoFrame(sharedFrame);
+		m_framePool.push_back(frame);
+		m_freeFrames.push_back(frame);
+	}
+
+	audioFeederSettings.channelCount = audioChannels;
+	audioFeederSettings.sampleDepth = audioSampleDepth;
+	audioFeederSettings.timestamped = true;
+	audioFeederSettings.waterLevel = kAudioWaterlevel;
+	audioFeederSettings.ringSampleFrames = kAudioWaterlevel;
+	if (!m_audioFeeder->startLoop(audioFeederSettings, audioPeriod, audioPeriodSampleFrames))
+	{
+		fprintf(stderr, "%s: Failed to start audio feeder\n", m_name.c_str());
+		goto bail;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_statistics = OutputChannelStatistics();
+		m_statistics.minimumBufferedFrames = -1;
+		m_playbackStopped = false;
+	}
+	m_nextFrameNumber = 0;
+
+	// Preroll video and audio, then start playback from frame 0
+	if (m_deckLinkOutput->BeginAudioPreroll() != S_OK)
+	{
+		fprintf(stderr, "%s: Failed to begin audio preroll\n", m_name.c_str());
+		goto bail;
+	}
+
+	Service();
+	m_deckLinkOutput->EndAudioPreroll();
+
+	if (m_deckLinkOutput->StartScheduledPlayback(0, m_frameTimescale, 1.0) != S_OK)
+	{
+		fprintf(stderr, "%s: Failed to start scheduled playback\n", m_name.c_str());
+		goto bail;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = true;
+	}
+
+	return true;
+
+bail:
+	Stop();
+	return false;
+}
+
+void OutputChannel::Stop()
+{
+	bool running;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		running = m_running;
+	}
+
+	if (running)
+	{
+		// Stop the audio and video output streams immediately, and wait for them to stop
+		m_deckLinkOutput->StopScheduledPlayback(0, NULL, 0);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_stoppedCondition.wait(lock, [this]{ return m_playbackStopped; });
+		m_running = false;
+	}
+
+	m_deckLinkOutput->DisableAudioOutput();
+	m_deckLinkOutput->DisableVideoOutput();
+	m_deckLinkOutput->SetScheduledFrameCompletionCallback(NULL);
+
+	m_audioFeeder->stop();
+	ReleaseFrames();
+}
+
+void OutputChannel::Service()
+{
+	int64_t		bufferedFrames;
+	bool		running;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		running = m_running;
+		bufferedFrames = (int64_t)(m_statistics.framesScheduled - m_statistics.framesCompleted);
+
+		if (running && ((m_statistics.minimumBufferedFrames < 0) || (bufferedFrames < m_statistics.minimumBufferedFrames)))
+			m_statistics.minimumBufferedFrames = bufferedFrames;
+	}
+
+	if (running && (bufferedFrames == 0))
+	{
+		BMDTimeValue	streamTime;
+		double			playbackSpeed;
+
+		// The output has run out of frames, so carry on from the frame it is showing now rather than
+		// scheduling frames that are already late
+		if (m_deckLinkOutput->GetScheduledStreamTime(m_frameTimescale, &streamTime, &playbackSpeed) == S_OK)
+			m_nextFrameNumber = std::max(m_nextFrameNumber, (uint64_t)(streamTime / m_frameDuration) + 1);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_statistics.videoUnderruns++;
+	}
+
+	while (bufferedFrames < kBufferedFrames)
+	{
+		TimecodedVideoFrame* frame;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_freeFrames.empty())
+				break;
+
+			frame = m_freeFrames.front();
+			m_freeFrames.pop_front();
+		}
+
+		SetFrameTimecode(frame, m_nextFrameNumber);
+
+		if (m_deckLinkOutput->ScheduleVideoFrame(frame, m_nextFrameNumber * m_frameDuration, m_frameDuration, m_frameTimescale) != S_OK)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_freeFrames.push_front(frame);
+			break;
+		}
+
+		m_nextFrameNumber++;
+		bufferedFrames++;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_statistics.framesScheduled++;
+	}
+
+	m_audioFeeder->feed();
+}
+
+void OutputChannel::GetStatistics(OutputChannelStatistics& statistics)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		statistics = m_statistics;
+	}
+
+	m_audioFeeder->getStatistics(statistics.audio);
+}
+
+void OutputChannel::SetFrameTimecode(TimecodedVideoFrame* frame, uint64_t frameNumber)
+{
+	uint64_t			frameCountNormalized = frameNumber;
+	BMDTimecodeFlags	flags = m_dropFrames ? bmdTimecodeIsDropFrame : bmdTimecodeFlagDefault;
+	uint8_t				hours, minutes, seconds, frames;
+
+	if (m_dropFrames)
+	{
+		uint64_t framesIn10mins = (60 * 10 * m_framesPerSecond) - (9 * m_dropFrames);
+		uint64_t deciMins = frameCountNormalized / framesIn10mins;
+		uint64_t deciMinsRemainder = frameCountNormalized - (deciMins * framesIn10mins);
+
+		// Add drop frames for 9 minutes of every 10 minutes that have elapsed
+		// AND drop frames for every minute (over the first minute) in this 10-minute block.
+		frameCountNormalized += m_dropFrames * 9 * deciMins;
+		if (deciMinsRemainder >= m_dropFrames)
+			frameCountNormalized += m_dropFrames * ((deciMinsRemainder - m_dropFrames) / (framesIn10mins / 10));
+	}
+
+	frames = (uint8_t)(frameCountNormalized % m_framesPerSecond);
+	frameCountNormalized /= m_framesPerSecond;
+	seconds = (uint8_t)(frameCountNormalized % 60);
+	frameCountNormalized /= 60;
+	minutes = (uint8_t)(frameCountNormalized % 60);
+	frameCountNormalized /= 60;
+	hours = (uint8_t)(frameCountNormalized % 24);
+
+	frame->ClearTimecodes();
+
+	if (m_timecodeFormat == bmdTimecodeVITC)
+	{
+		frame->SetTimecode(bmdTimecodeVITC, hours, minutes, seconds, frames, flags);
+	}
+	else if (!m_progressive)
+	{
+		// An interlaced or PsF frame has both VITC1 and VITC2 set with the same timecode value (SMPTE ST 12-2:2014 7.2)
+		frame->SetTimecode(bmdTimecodeRP188VITC1, hours, minutes, seconds, frames, flags);
+		frame->SetTimecode(bmdTimecodeRP188VITC2, hours, minutes, seconds, frames, flags);
+	}
+	else if (m_framesPerSecond <= 30)
+	{
+		frame->SetTimecode(bmdTimecodeRP188VITC1, hours, minutes, seconds, frames, flags);
+	}
+	else
+	{
+		// High-P modes carry VITC1 on even frames and VITC2 on odd frames, as the frames field
+		// cannot hold values greater than 30 (SMPTE ST 12-2:2014 7.2, 9.2)
+		if ((frames & 1) == 0)
+			frame->SetTimecode(bmdTimecodeRP188VITC1, hours, minutes, seconds, frames >> 1, flags);
+		else
+			frame->SetTimecode(bmdTimecodeRP188VITC2, hours, minutes, seconds, frames >> 1, flags);
+	}
+}
+
+void OutputChannel::ReleaseFrames()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (TimecodedVideoFrame* frame : m_framePool)
+		frame->Release();
+
+	m_framePool.clear();
+	m_freeFrames.clear();
+}
+
+/************************* DeckLink API Delegate Methods *****************************/
+
+HRESULT OutputChannel::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (CompareREFIID(iid, IID_IUnknown) || CompareREFIID(iid, IID_IDeckLinkVideoOutputCallback))
+	{
+		*ppv = static_cast<IDeckLinkVideoOutputCallback*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = NULL;
+	return E_NOINTERFACE;
+}
+
+ULONG OutputChannel::AddRef()
+{
+	// gcc atomic operation builtin
+	return __sync_add_and_fetch(&m_refCount, 1);
+}
+
+ULONG OutputChannel::Release()
+{
+	// gcc atomic operation builtin
+	ULONG newRefValue = __sync_sub_and_fetch(&m_refCount, 1);
+	if (!newRefValue)
+		delete this;
+	return newRefValue;
+}
+
+HRESULT OutputChannel::ScheduledFrameCompleted(IDeckLinkVideoFrame* completedFrame, BMDOutputFrameCompletionResult result)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_statistics.framesCompleted++;
+	if (result == bmdOutputFrameDisplayedLate)
+		m_statistics.framesLate++;
+	else if (result == bmdOutputFrameDropped)
+		m_statistics.framesDropped++;
+	else if (result == bmdOutputFrameFlushed)
+		m_statistics.framesFlushed++;
+
+	// Return the frame to the free list, so the timer thread can schedule it again
+	for (TimecodedVideoFrame* frame : m_framePool)
+	{
+		if (frame == completedFrame)
+		{
+			m_freeFrames.push_back(frame);
+			break;
+		}
+	}
+
+	return S_OK;
+}
+
+HRESULT OutputChannel::ScheduledPlaybackHasStopped()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_playbackStopped = true;
+	m_stoppedCondition.notify_all();
+
+	return S_OK;
+}
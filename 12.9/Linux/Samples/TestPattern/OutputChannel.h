@@ -0,0 +1,123 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef OUTPUT_CHANNEL_H
+#define OUTPUT_CHANNEL_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "DeckLinkAPI.h"
+#include "AudioFeeder.h"
+#include "TimecodedVideoFrame.h"
+
+struct OutputChannelStatistics
+{
+	uint64_t				framesScheduled;
+	uint64_t				framesCompleted;
+	uint64_t				framesLate;
+	uint64_t				framesDropped;
+	uint64_t				framesFlushed;
+	uint64_t				videoUnderruns;				// Times the output ran out of frames and was realigned
+	int64_t					minimumBufferedFrames;		// Fewest frames scheduled ahead while running, -1 before then
+	AudioFeederStatistics	audio;
+};
+
+// One output of the multi-output generator, playing a shared frame with its own timecode and a tone.
+// Frames are scheduled by the timer thread of the card the output belongs to, calling Service(),
+// rather than from the completion callback, which only counts results and recycles frames.
+class OutputChannel : public IDeckLinkVideoOutputCallback
+{
+public:
+	OutputChannel(IDeckLink* deckLink, const std::string& name);
+
+	bool				Start(IDeckLinkDisplayMode* displayMode, BMDPixelFormat pixelFormat, bool output444, IDeckLinkVideoFrame* sharedFrame,
+							  const void* audioPeriod, uint32_t audioPeriodSampleFrames, uint32_t audioChannels, uint32_t audioSampleDepth);
+	void				Stop();
+	// Tops up the scheduled video and audio, called from the card's timer thread
+	void				Service();
+
+	const std::string&	GetName() const { return m_name; }
+	IDeckLinkOutput*	GetOutput() const { return m_deckLinkOutput; }
+	void				GetStatistics(OutputChannelStatistics& statistics);
+
+	// IUnknown
+	virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv);
+	virtual ULONG STDMETHODCALLTYPE AddRef();
+	virtual ULONG STDMETHODCALLTYPE Release();
+
+	// IDeckLinkVideoOutputCallback
+	virtual HRESULT STDMETHODCALLTYPE ScheduledFrameCompleted(IDeckLinkVideoFrame* completedFrame, BMDOutputFrameCompletionResult result);
+	virtual HRESULT STDMETHODCALLTYPE ScheduledPlaybackHasStopped();
+
+private:
+	virtual ~OutputChannel();
+
+	void				SetFrameTimecode(TimecodedVideoFrame* frame, uint64_t frameNumber);
+	void				ReleaseFrames();
+
+	int32_t								m_refCount;
+	std::string							m_name;
+	IDeckLink*							m_deckLink;
+	IDeckLinkOutput*					m_deckLinkOutput;
+	AudioFeeder*						m_audioFeeder;
+
+	BMDTimeValue						m_frameDuration;
+	BMDTimeScale						m_frameTimescale;
+	unsigned							m_framesPerSecond;
+	unsigned							m_dropFrames;
+	bool								m_progressive;
+	BMDTimecodeFormat					m_timecodeFormat;
+
+	std::vector<TimecodedVideoFrame*>	m_framePool;
+	std::deque<TimecodedVideoFrame*>	m_freeFrames;
+	uint64_t							m_nextFrameNumber;
+	bool								m_running;
+	bool								m_playbackStopped;
+
+	std::mutex							m_mutex;
+	std::condition_variable				m_stoppedCondition;
+	OutputChannelStatistics				m_statistics;
+};
+
+#endif
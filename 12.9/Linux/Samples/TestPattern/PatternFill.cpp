@@ -0,0 +1,220 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <math.h>
+#include <stdio.h>
+
+#include "PatternFill.h"
+
+HRESULT CreatePatternFrame(IDeckLinkOutput* deckLinkOutput, long width, long height, BMDPixelFormat pixelFormat, void (*fillFunc)(IDeckLinkVideoFrame*), IDeckLinkVideoFrame** frame)
+{
+	HRESULT						result;
+	int							bytesPerRow = GetRowBytes(pixelFormat, width);
+	int							referenceBytesPerRow = GetRowBytes(bmdFormat8BitYUV, width);
+	IDeckLinkMutableVideoFrame*	newFrame = NULL;
+	IDeckLinkMutableVideoFrame*	referenceFrame = NULL;
+	IDeckLinkVideoConversion*	frameConverter = NULL;
+
+	*frame = NULL;
+
+	result = deckLinkOutput->CreateVideoFrame(width, height, bytesPerRow, pixelFormat, bmdFrameFlagDefault, &newFrame);
+	if (result != S_OK)
+	{
+		fprintf(stderr, "Failed to create video frame\n");
+		goto bail;
+	}
+
+	if (pixelFormat == bmdFormat8BitYUV)
+	{
+		fillFunc(newFrame);
+	}
+	else
+	{
+		// Create a black frame in 8 bit YUV and convert to desired format
+		result = deckLinkOutput->CreateVideoFrame(width, height, referenceBytesPerRow, bmdFormat8BitYUV, bmdFrameFlagDefault, &referenceFrame);
+		if (result != S_OK)
+		{
+			fprintf(stderr, "Failed to create reference video frame\n");
+			goto bail;
+		}
+
+		fillFunc(referenceFrame);
+
+		frameConverter = CreateVideoConversionInstance();
+
+		result = frameConverter->ConvertFrame(referenceFrame, newFrame);
+		if (result != S_OK)
+		{
+			fprintf(stderr, "Failed to convert frame\n");
+			goto bail;
+		}
+	}
+
+	*frame = newFrame;
+	newFrame = NULL;
+
+bail:
+	if (referenceFrame != NULL)
+		referenceFrame->Release();
+
+	if (frameConverter != NULL)
+		frameConverter->Release();
+
+	if (newFrame != NULL)
+		newFrame->Release();
+
+	return result;
+}
+
+void FillSine(void* audioBuffer, unsigned long samplesToWrite, unsigned long channels, unsigned long sampleDepth)
+{
+	if (sampleDepth == 16)
+	{
+		short*		nextBuffer;
+
+		nextBuffer = (short*)audioBuffer;
+		for (unsigned i = 0; i < samplesToWrite; i++)
+		{
+			short		sample;
+
+			sample = (short)(24576.0 * sin((i * 2.0 * M_PI) / 48.0));
+			for (unsigned ch = 0; ch < channels; ch++)
+				*(nextBuffer++) = sample;
+		}
+	}
+	else if (sampleDepth == 32)
+	{
+		int*		nextBuffer;
+
+		nextBuffer = (int*)audioBuffer;
+		for (unsigned i = 0; i < samplesToWrite; i++)
+		{
+			int		sample;
+
+			sample = (int)(1610612736.0 * sin((i * 2.0 * M_PI) / 48.0));
+			for (unsigned ch = 0; ch < channels; ch++)
+				*(nextBuffer++) = sample;
+		}
+	}
+}
+
+void FillColourBars(IDeckLinkVideoFrame* theFrame, bool reverse)
+{
+	unsigned int*	nextWord;
+	unsigned long	width;
+	unsigned long	height;
+	unsigned int	bars[8] = {0xEA80EA80, 0xD292D210, 0xA910A9A5, 0x90229035, 0x6ADD6ACA, 0x51EF515A, 0x286D28EF, 0x10801080};
+
+	theFrame->GetBytes((void**)&nextWord);
+	width = theFrame->GetWidth();
+	height = theFrame->GetHeight();
+
+	if (reverse)
+	{
+		for (long y = 0; y < height; y++)
+		{
+			for (long x = width - 2; x >= 0; x -= 2)
+			{
+				*(nextWord++) = bars[(x * 8) / width];
+			}
+		}
+	}
+	else
+	{
+		for (long y = 0; y < height; y++)
+		{
+			for (long x = 0; x < width; x += 2)
+			{
+				*(nextWord++) = bars[(x * 8) / width];
+			}
+		}
+	}
+}
+
+void FillBlack(IDeckLinkVideoFrame* theFrame)
+{
+	unsigned int*	nextWord;
+	unsigned long	width;
+	unsigned long	height;
+	unsigned long	wordsRemaining;
+
+	theFrame->GetBytes((void**)&nextWord);
+	width = theFrame->GetWidth();
+	height = theFrame->GetHeight();
+
+	wordsRemaining = (width * 2 * height) / 4;
+
+	while (wordsRemaining-- > 0)
+		*(nextWord++) = 0x10801080;
+}
+
+int GetRowBytes(BMDPixelFormat pixelFormat, int frameWidth)
+{
+	int bytesPerRow;
+
+	// Refer to DeckLink SDK Manual - 2.7.4 Pixel Formats
+	switch (pixelFormat)
+	{
+	case bmdFormat8BitYUV:
+		bytesPerRow = frameWidth * 2;
+		break;
+
+	case bmdFormat10BitYUV:
+		bytesPerRow = ((frameWidth + 47) / 48) * 128;
+		break;
+
+	case bmdFormat10BitRGB:
+		bytesPerRow = ((frameWidth + 63) / 64) * 256;
+		break;
+
+	case bmdFormat12BitRGB:
+		bytesPerRow = ((frameWidth + 7) / 8) * 36;
+		break;
+
+	case bmdFormat8BitARGB:
+	case bmdFormat8BitBGRA:
+	default:
+		bytesPerRow = frameWidth * 4;
+		break;
+	}
+
+	return bytesPerRow;
+}
+
@@ -51,6 +51,8 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <arpa/inet.h>
+#include <algorithm>
+#include <chrono>
 
 #include "TestPattern.h"
 #include "VideoFrame3D.h"
@@ -60,6 +62,12 @@ pthread_cond_t			sleepCond;
 bool					do_exit = false;
 
 const unsigned long		kAudioWaterlevel = 48000;
+const unsigned long		kAudioRingSampleFrames = 4 * 48000;
+
+// Moving patterns are rendered each frame, so they preroll a few frames rather than a second,
+// and the render thread keeps two more frames ready in case a render runs long
+const unsigned long		kMovingPatternPrerollFrames = 4;
+const unsigned long		kMovingPatternRenderAheadFrames = 2;
 
 void sigfunc(int signum)
 {
@@ -121,7 +129,15 @@ TestPattern::TestPattern(BMDConfig *config) :
 	m_videoFrameBars(),
 	m_outputSignal(kOutputSignalDrop),
 	m_audioBuffer(),
-	m_audioSampleRate(bmdAudioSampleRate48kHz)
+	m_audioSampleRate(bmdAudioSampleRate48kHz),
+	m_audioFeeder(),
+	m_movingPatternRenderer(),
+	m_rendering(false),
+	m_totalFramesRendered(0),
+	m_totalFramesLate(0),
+	m_pendingSchedules(0),
+	m_renderTimeTotal(0.0),
+	m_renderTimeMax(0.0)
 {
 }
 
@@ -143,6 +159,9 @@ bool TestPattern::Run()
 	if (m_deckLink->QueryInterface(IID_IDeckLinkOutput, (void**)&m_deckLinkOutput) != S_OK)
 		goto bail;
 
+	// Audio is scheduled from a ring, topped up on each audio callback
+	m_audioFeeder = new AudioFeeder(m_deckLinkOutput);
+
 	// Get the configuration interface of the DeckLink device
 	if (m_deckLink->QueryInterface(IID_IDeckLinkConfiguration, (void**)&m_deckLinkConfiguration) != S_OK)
 		goto bail;
@@ -195,6 +214,14 @@ bool TestPattern::Run()
 	printf("\n");
 
 bail:
+	if (m_videoFrameBlack != NULL)
+		m_videoFrameBlack->Release();
+	m_videoFrameBlack = NULL;
+
+	if (m_videoFrameBars != NULL)
+		m_videoFrameBars->Release();
+	m_videoFrameBars = NULL;
+
 	if (displayModeName != NULL)
 		free(displayModeName);
 
@@ -204,6 +231,9 @@ bail:
 	if (m_deckLinkConfiguration != NULL)
 		m_deckLinkConfiguration->Release();
 
+	if (m_audioFeeder != NULL)
+		delete m_audioFeeder;
+
 	if (m_deckLinkOutput != NULL)
 		m_deckLinkOutput->Release();
 
@@ -217,8 +247,10 @@ void TestPattern::StartRunning()
 {
 	HRESULT					result;
 	unsigned long			audioSamplesPerFrame;
+	unsigned long			prerollFrames;
 	IDeckLinkVideoFrame*	rightFrame;
 	VideoFrame3D*			frame3D;
+	AudioFeederSettings		audioFeederSettings;
 
 	m_frameWidth = m_displayMode->GetWidth();
 	m_frameHeight = m_displayMode->GetHeight();
@@ -271,43 +303,78 @@ void TestPattern::StartRunning()
 	else
 		FillSine((void*)((unsigned long)m_audioBuffer + (audioSamplesPerFrame * m_config->m_audioChannels * m_config->m_audioSampleDepth / 8)), (m_audioBufferSampleLength - audioSamplesPerFrame), m_config->m_audioChannels, m_config->m_audioSampleDepth);
 
-	// Generate a frame of black
-	if (CreateFrame(&m_videoFrameBlack, FillBlack) != S_OK)
-		goto bail;
-
-	if (m_config->m_outputFlags & bmdVideoOutputDualStream3D)
+	// The feeder repeats the second of audio through its ring, so the buffer is no longer needed
+	audioFeederSettings.channelCount = m_config->m_audioChannels;
+	audioFeederSettings.sampleDepth = m_config->m_audioSampleDepth;
+	audioFeederSettings.timestamped = false;
+	audioFeederSettings.waterLevel = kAudioWaterlevel;
+	audioFeederSettings.ringSampleFrames = kAudioRingSampleFrames;
+	if (!m_audioFeeder->startLoop(audioFeederSettings, m_audioBuffer, m_audioBufferSampleLength))
 	{
-		frame3D = new VideoFrame3D(m_videoFrameBlack);
-		m_videoFrameBlack->Release();
-		m_videoFrameBlack = frame3D;
-		frame3D = NULL;
+		fprintf(stderr, "Failed to start audio feeder\n");
+		goto bail;
 	}
 
-	// Generate a frame of colour bars
-	if (CreateFrame(&m_videoFrameBars, FillForwardColourBars) != S_OK)
-		goto bail;
+	free(m_audioBuffer);
+	m_audioBuffer = NULL;
 
-	if (m_config->m_outputFlags & bmdVideoOutputDualStream3D)
+	if (m_config->m_movingPattern != kMovingPatternNone)
 	{
-		if (CreateFrame(&rightFrame, FillReverseColourBars) != S_OK)
+		// Moving patterns render into a pool of frames and preroll only a few of them
+		if (!StartMovingPattern())
 			goto bail;
 
-		frame3D = new VideoFrame3D(m_videoFrameBars, rightFrame);
-		m_videoFrameBars->Release();
-		rightFrame->Release();
-		m_videoFrameBars = frame3D;
-		frame3D = NULL;
+		prerollFrames = std::min(kMovingPatternPrerollFrames, m_framesPerSecond);
 	}
+	else
+	{
+		// The display mode and pixel format do not change between restarts, so the frames
+		// generated for the first start are kept and played again
+		if (m_videoFrameBlack == NULL)
+		{
+			// Generate a frame of black
+			if (CreateFrame(&m_videoFrameBlack, FillBlack) != S_OK)
+				goto bail;
+
+			if (m_config->m_outputFlags & bmdVideoOutputDualStream3D)
+			{
+				frame3D = new VideoFrame3D(m_videoFrameBlack);
+				m_videoFrameBlack->Release();
+				m_videoFrameBlack = frame3D;
+				frame3D = NULL;
+			}
+		}
 
-	// Begin video preroll by scheduling a second of frames in hardware
+		if (m_videoFrameBars == NULL)
+		{
+			// Generate a frame of colour bars
+			if (CreateFrame(&m_videoFrameBars, FillForwardColourBars) != S_OK)
+				goto bail;
+
+			if (m_config->m_outputFlags & bmdVideoOutputDualStream3D)
+			{
+				if (CreateFrame(&rightFrame, FillReverseColourBars) != S_OK)
+					goto bail;
+
+				frame3D = new VideoFrame3D(m_videoFrameBars, rightFrame);
+				m_videoFrameBars->Release();
+				rightFrame->Release();
+				m_videoFrameBars = frame3D;
+				frame3D = NULL;
+			}
+		}
+
+		prerollFrames = m_framesPerSecond;
+	}
+
+	// Begin video preroll by scheduling frames in hardware
 	m_totalFramesScheduled = 0;
 	m_totalFramesDropped = 0;
 	m_totalFramesCompleted = 0;
-	for (unsigned i = 0; i < m_framesPerSecond; i++)
+	for (unsigned i = 0; i < prerollFrames; i++)
 		ScheduleNextFrame(true);
 
 	// Begin audio preroll.  This will begin calling our audio callback, which will start the DeckLink output stream.
-	m_audioBufferOffset = 0;
 	if (m_deckLinkOutput->BeginAudioPreroll() != S_OK)
 	{
 		fprintf(stderr, "Failed to begin audio preroll\n");
@@ -340,19 +407,160 @@ void TestPattern::StopRunning()
 	m_deckLinkOutput->DisableAudioOutput();
 	m_deckLinkOutput->DisableVideoOutput();
 
-	if (m_videoFrameBlack != NULL)
-		m_videoFrameBlack->Release();
-	m_videoFrameBlack = NULL;
-
-	if (m_videoFrameBars != NULL)
-		m_videoFrameBars->Release();
-	m_videoFrameBars = NULL;
+	m_audioFeeder->stop();
+	StopMovingPattern();
 
 	if (m_audioBuffer != NULL)
 		free(m_audioBuffer);
 	m_audioBuffer = NULL;
 }
 
+bool TestPattern::StartMovingPattern()
+{
+	int			bytesPerRow = GetRowBytes(m_config->m_pixelFormat, m_frameWidth);
+	unsigned	threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	m_movingPatternRenderer = new MovingPatternRenderer(m_config->m_movingPattern, m_config->m_pixelFormat, m_frameWidth, m_frameHeight, m_framesPerSecond, threadCount);
+
+	for (unsigned i = 0; i < kMovingPatternPrerollFrames + kMovingPatternRenderAheadFrames; i++)
+	{
+		IDeckLinkMutableVideoFrame* frame = NULL;
+
+		if (m_deckLinkOutput->CreateVideoFrame(m_frameWidth, m_frameHeight, bytesPerRow, m_config->m_pixelFormat, bmdFrameFlagDefault, &frame) != S_OK)
+		{
+			fprintf(stderr, "Failed to create video frame\n");
+			return false;
+		}
+
+		m_framePool.push_back(frame);
+		m_freeFrames.push_back(frame);
+	}
+
+	m_totalFramesRendered = 0;
+	m_totalFramesLate = 0;
+	m_pendingSchedules = 0;
+	m_renderTimeTotal = 0.0;
+	m_renderTimeMax = 0.0;
+
+	m_rendering = true;
+	m_renderThread = std::thread(&TestPattern::RenderThread, this);
+
+	return true;
+}
+
+void TestPattern::StopMovingPattern()
+{
+	if (m_renderThread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_framePoolMutex);
+			m_rendering = false;
+		}
+		m_framePoolCondition.notify_all();
+		m_renderThread.join();
+	}
+
+	if (m_movingPatternRenderer != NULL)
+	{
+		if (m_totalFramesRendered > 0)
+		{
+			fprintf(stderr, "\nRendered %lu frames: average %.2f ms, maximum %.2f ms (half frame period %.2f ms), %lu late\n",
+				m_totalFramesRendered, m_renderTimeTotal / m_totalFramesRendered, m_renderTimeMax,
+				(500.0 * m_frameDuration) / m_frameTimescale, m_totalFramesLate);
+		}
+
+		delete m_movingPatternRenderer;
+		m_movingPatternRenderer = NULL;
+	}
+
+	for (IDeckLinkMutableVideoFrame* frame : m_framePool)
+		frame->Release();
+
+	m_framePool.clear();
+	m_freeFrames.clear();
+	m_renderedFrames.clear();
+}
+
+void TestPattern::RenderThread()
+{
+	std::unique_lock<std::mutex>	lock(m_framePoolMutex);
+	unsigned long					frameNumber = 0;
+
+	while (true)
+	{
+		IDeckLinkMutableVideoFrame*	frame;
+		void*						bytes;
+
+		// Render into each frame as soon as it is returned from the output
+		m_framePoolCondition.wait(lock, [this]{ return !m_rendering || !m_freeFrames.empty(); });
+		if (!m_rendering)
+			break;
+
+		frame = m_freeFrames.front();
+		m_freeFrames.pop_front();
+		lock.unlock();
+
+		auto renderStart = std::chrono::steady_clock::now();
+		frame->GetBytes(&bytes);
+		m_movingPatternRenderer->RenderFrame(bytes, frame->GetRowBytes(), frameNumber++);
+		double renderTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - renderStart).count();
+
+		lock.lock();
+		m_renderedFrames.push_back(frame);
+		m_totalFramesRendered++;
+		m_renderTimeTotal += renderTime;
+		m_renderTimeMax = std::max(m_renderTimeMax, renderTime);
+
+		// Fill a slot the completion callback could not, now that a frame is ready for it
+		if (m_pendingSchedules > 0)
+		{
+			m_pendingSchedules--;
+			ScheduleRenderedFrame();
+		}
+
+		m_framePoolCondition.notify_all();
+	}
+}
+
+void TestPattern::ScheduleNextMovingFrame(bool prerolling)
+{
+	std::unique_lock<std::mutex> lock(m_framePoolMutex);
+
+	if (m_renderedFrames.empty())
+	{
+		if (!prerolling)
+		{
+			// The renderer has fallen behind. This runs on the output's completion thread, so rather
+			// than wait here the slot is handed to the render thread, which schedules the frame when ready.
+			m_totalFramesLate++;
+			m_pendingSchedules++;
+			return;
+		}
+
+		// Preroll is scheduled from StartRunning(), which can wait for the first frames
+		m_framePoolCondition.wait(lock, [this]{ return !m_rendering || !m_renderedFrames.empty(); });
+		if (m_renderedFrames.empty())
+			return;
+	}
+
+	ScheduleRenderedFrame();
+}
+
+void TestPattern::ScheduleRenderedFrame()
+{
+	// Called with m_framePoolMutex held, which also orders the schedule times between the two threads
+	IDeckLinkMutableVideoFrame* frame = m_renderedFrames.front();
+	m_renderedFrames.pop_front();
+
+	if (m_deckLinkOutput->ScheduleVideoFrame(frame, (m_totalFramesScheduled * m_frameDuration), m_frameDuration, m_frameTimescale) != S_OK)
+	{
+		m_renderedFrames.push_front(frame);
+		return;
+	}
+
+	m_totalFramesScheduled += 1;
+}
+
 void TestPattern::ScheduleNextFrame(bool prerolling)
 {
 	if (prerolling == false)
@@ -362,6 +570,11 @@ void TestPattern::ScheduleNextFrame(bool prerolling)
 		if (m_running == false)
 			return;
 	}
+	if (m_movingPatternRenderer != NULL)
+	{
+		ScheduleNextMovingFrame(prerolling);
+		return;
+	}
 	if (m_outputSignal == kOutputSignalPip)
 	{
 		if ((m_totalFramesScheduled % m_framesPerSecond) == 0)
@@ -396,93 +609,23 @@ void TestPattern::ScheduleNextFrame(bool prerolling)
 	m_totalFramesScheduled += 1;
 }
 
-void TestPattern::WriteNextAudioSamples()
-{
-	unsigned int		bufferedSamples;
-
-	// Try to maintain the number of audio samples buffered in the API at a specified waterlevel
-	if ((m_deckLinkOutput->GetBufferedAudioSampleFrameCount(&bufferedSamples) == S_OK) && (bufferedSamples < kAudioWaterlevel))
-	{
-		unsigned int		samplesToEndOfBuffer;
-		unsigned int		samplesToWrite;
-		unsigned int		samplesWritten;
-
-		samplesToEndOfBuffer = (m_audioBufferSampleLength - m_audioBufferOffset);
-		samplesToWrite = (kAudioWaterlevel - bufferedSamples);
-		if (samplesToWrite > samplesToEndOfBuffer)
-			samplesToWrite = samplesToEndOfBuffer;
-
-		if (m_deckLinkOutput->ScheduleAudioSamples((void*)((unsigned long)m_audioBuffer + (m_audioBufferOffset * m_config->m_audioChannels * m_config->m_audioSampleDepth / 8)), samplesToWrite, 0, 0, &samplesWritten) == S_OK)
-		{
-			m_audioBufferOffset = ((m_audioBufferOffset + samplesWritten) % m_audioBufferSampleLength);
-		}
-	}
-}
-
 HRESULT TestPattern::CreateFrame(IDeckLinkVideoFrame** frame, void (*fillFunc)(IDeckLinkVideoFrame*))
 {
-	HRESULT						result;
-	int							bytesPerRow = GetRowBytes(m_config->m_pixelFormat, m_frameWidth);
-	int							referenceBytesPerRow = GetRowBytes(bmdFormat8BitYUV, m_frameWidth);
-	IDeckLinkMutableVideoFrame*	newFrame = NULL;
-	IDeckLinkMutableVideoFrame*	referenceFrame = NULL;
-	IDeckLinkVideoConversion*	frameConverter = NULL;
-
-	*frame = NULL;
-
-	result = m_deckLinkOutput->CreateVideoFrame(m_frameWidth, m_frameHeight, bytesPerRow, m_config->m_pixelFormat, bmdFrameFlagDefault, &newFrame);
-	if (result != S_OK)
-	{
-		fprintf(stderr, "Failed to create video frame\n");
-		goto bail;
-	}
-
-	if (m_config->m_pixelFormat == bmdFormat8BitYUV)
-	{
-		fillFunc(newFrame);
-	}
-	else
-	{
-		// Create a black frame in 8 bit YUV and convert to desired format
-		result = m_deckLinkOutput->CreateVideoFrame(m_frameWidth, m_frameHeight, referenceBytesPerRow, bmdFormat8BitYUV, bmdFrameFlagDefault, &referenceFrame);
-		if (result != S_OK)
-		{
-			fprintf(stderr, "Failed to create reference video frame\n");
-			goto bail;
-		}
-
-		fillFunc(referenceFrame);
-
-		frameConverter = CreateVideoConversionInstance();
-
-		result = frameConverter->ConvertFrame(referenceFrame, newFrame);
-		if (result != S_OK)
-		{
-			fprintf(stderr, "Failed to convert frame\n");
-			goto bail;
-		}
-	}
-
-	*frame = newFrame;
-	newFrame = NULL;
-
-bail:
-	if (referenceFrame != NULL)
-		referenceFrame->Release();
-
-	if (frameConverter != NULL)
-		frameConverter->Release();
-
-	if (newFrame != NULL)
-		newFrame->Release();
-
-	return result;
+	return CreatePatternFrame(m_deckLinkOutput, m_frameWidth, m_frameHeight, m_config->m_pixelFormat, fillFunc, frame);
 }
 
 void TestPattern::PrintStatusLine()
 {
-	printf("\rscheduled %-16lu completed %-16lu dropped %-16lu\r",
-		m_totalFramesScheduled, m_totalFramesCompleted, m_totalFramesDropped);
+	AudioFeederStatistics	audioStatistics;
+	double					audioMargin = 0.0;
+
+	// The least audio that has been buffered ahead of the output since playback started
+	m_audioFeeder->getStatistics(audioStatistics);
+	if (audioStatistics.running)
+		audioMargin = (double)audioStatistics.minimumMargin * 1000.0 / AudioFeeder::kSampleRate;
+
+	printf("\rscheduled %-16lu completed %-16lu dropped %-16lu audio margin %6.1f ms underruns %-8llu\r",
+		m_totalFramesScheduled, m_totalFramesCompleted, m_totalFramesDropped, audioMargin, (unsigned long long)audioStatistics.underruns);
 }
 
 /************************* DeckLink API Delegate Methods *****************************/
@@ -514,6 +657,21 @@ HRESULT TestPattern::ScheduledFrameCompleted(IDeckLinkVideoFrame* completedFrame
 	++m_totalFramesCompleted;
 	PrintStatusLine();
 
+	if (m_movingPatternRenderer != NULL)
+	{
+		// Return the frame to the pool, so the render thread can draw the next one into it
+		std::lock_guard<std::mutex> lock(m_framePoolMutex);
+		for (IDeckLinkMutableVideoFrame* frame : m_framePool)
+		{
+			if (frame == completedFrame)
+			{
+				m_freeFrames.push_back(frame);
+				m_framePoolCondition.notify_all();
+				break;
+			}
+		}
+	}
+
 	// When a video frame has been released by the API, schedule another video frame to be output
 	ScheduleNextFrame(false);
 	return S_OK;
@@ -531,7 +689,7 @@ HRESULT TestPattern::ScheduledPlaybackHasStopped()
 HRESULT TestPattern::RenderAudioSamples(bool preroll)
 {
 	// Provide further audio samples to the DeckLink API until our preferred buffer waterlevel is reached
-	WriteNextAudioSamples();
+	m_audioFeeder->feed();
 
 	if (preroll)
 	{
@@ -541,117 +699,3 @@ HRESULT TestPattern::RenderAudioSamples(bool preroll)
 
 	return S_OK;
 }
-
-/*****************************************/
-
-void FillSine(void* audioBuffer, unsigned long samplesToWrite, unsigned long channels, unsigned long sampleDepth)
-{
-	if (sampleDepth == 16)
-	{
-		short*		nextBuffer;
-
-		nextBuffer = (short*)audioBuffer;
-		for (unsigned i = 0; i < samplesToWrite; i++)
-		{
-			short		sample;
-
-			sample = (short)(24576.0 * sin((i * 2.0 * M_PI) / 48.0));
-			for (unsigned ch = 0; ch < channels; ch++)
-				*(nextBuffer++) = sample;
-		}
-	}
-	else if (sampleDepth == 32)
-	{
-		int*		nextBuffer;
-
-		nextBuffer = (int*)audioBuffer;
-		for (unsigned i = 0; i < samplesToWrite; i++)
-		{
-			int		sample;
-
-			sample = (int)(1610612736.0 * sin((i * 2.0 * M_PI) / 48.0));
-			for (unsigned ch = 0; ch < channels; ch++)
-				*(nextBuffer++) = sample;
-		}
-	}
-}
-
-void FillColourBars(IDeckLinkVideoFrame* theFrame, bool reverse)
-{
-	unsigned int*	nextWord;
-	unsigned long	width;
-	unsigned long	height;
-	unsigned int	bars[8] = {0xEA80EA80, 0xD292D210, 0xA910A9A5, 0x90229035, 0x6ADD6ACA, 0x51EF515A, 0x286D28EF, 0x10801080};
-
-	theFrame->GetBytes((void**)&nextWord);
-	width = theFrame->GetWidth();
-	height = theFrame->GetHeight();
-
-	if (reverse)
-	{
-		for (long y = 0; y < height; y++)
-		{
-			for (long x = width - 2; x >= 0; x -= 2)
-			{
-				*(nextWord++) = bars[(x * 8) / width];
-			}
-		}
-	}
-	else
-	{
-		for (long y = 0; y < height; y++)
-		{
-			for (long x = 0; x < width; x += 2)
-			{
-				*(nextWord++) = bars[(x * 8) / width];
-			}
-		}
-	}
-}
-
-void FillBlack(IDeckLinkVideoFrame* theFrame)
-{
-	unsigned int*	nextWord;
-	unsigned long	width;
-	unsigned long	height;
-	unsigned long	wordsRemaining;
-
-	theFrame->GetBytes((void**)&nextWord);
-	width = theFrame->GetWidth();
-	height = theFrame->GetHeight();
-
-	wordsRemaining = (width * 2 * height) / 4;
-
-	while (wordsRemaining-- > 0)
-		*(nextWord++) = 0x10801080;
-}
-
-int GetRowBytes(BMDPixelFormat pixelFormat, int frameWidth)
-{
-	int bytesPerRow;
-
-	// Refer to DeckLink SDK Manual - 2.7.4 Pixel Formats
-	switch (pixelFormat)
-	{
-	case bmdFormat8BitYUV:
-		bytesPerRow = frameWidth * 2;
-		break;
-
-	case bmdFormat10BitYUV:
-		bytesPerRow = ((frameWidth + 47) / 48) * 128;
-		break;
-
-	case bmdFormat10BitRGB:
-		bytesPerRow = ((frameWidth + 63) / 64) * 256;
-		break;
-
-	case bmdFormat8BitARGB:
-	case bmdFormat8BitBGRA:
-	default:
-		bytesPerRow = frameWidth * 4;
-		break;
-	}
-
-	return bytesPerRow;
-}
-
@@ -40,9 +40,15 @@
 
 #include <mutex>
 #include <condition_variable>
+#include <deque>
+#include <thread>
+#include <vector>
 
 #include "DeckLinkAPI.h"
+#include "AudioFeeder.h"
 #include "Config.h"
+#include "PatternFill.h"
+#include "MovingPatternRenderer.h"
 
 enum OutputSignal
 {
@@ -76,19 +82,39 @@ private:
 	OutputSignal			m_outputSignal;
 	void*					m_audioBuffer;
 	unsigned long			m_audioBufferSampleLength;
-	unsigned long			m_audioBufferOffset;
 	BMDAudioSampleRate		m_audioSampleRate;
+	AudioFeeder*			m_audioFeeder;
 
 	std::mutex				m_mutex;
 	std::condition_variable	m_stoppedCondition;
 
+	// Moving patterns are rendered ahead into a pool of frames, which are recycled as they complete
+	MovingPatternRenderer*						m_movingPatternRenderer;
+	std::vector<IDeckLinkMutableVideoFrame*>	m_framePool;
+	std::deque<IDeckLinkMutableVideoFrame*>		m_freeFrames;
+	std::deque<IDeckLinkMutableVideoFrame*>		m_renderedFrames;
+	std::mutex									m_framePoolMutex;
+	std::condition_variable						m_framePoolCondition;
+	std::thread									m_renderThread;
+	bool										m_rendering;
+	unsigned long								m_totalFramesRendered;
+	unsigned long								m_totalFramesLate;
+	unsigned long								m_pendingSchedules;
+	double										m_renderTimeTotal;
+	double										m_renderTimeMax;
+
 	~TestPattern();
 
 	// Signal Generator Implementation
 	void			StartRunning();
 	void			StopRunning();
 	void			ScheduleNextFrame(bool prerolling);
-	void			WriteNextAudioSamples();
+
+	bool			StartMovingPattern();
+	void			StopMovingPattern();
+	void			RenderThread();
+	void			ScheduleNextMovingFrame(bool prerolling);
+	void			ScheduleRenderedFrame();
 
 	void			PrintStatusLine();
 
@@ -109,16 +135,3 @@ public:
 
 	HRESULT CreateFrame(IDeckLinkVideoFrame** theFrame, void (*fillFunc)(IDeckLinkVideoFrame*));
 };
-
-void FillSine(void* audioBuffer, unsigned long samplesToWrite, unsigned long channels, unsigned long sampleDepth);
-void FillColourBars(IDeckLinkVideoFrame* theFrame, bool reverse);
-static inline void FillForwardColourBars(IDeckLinkVideoFrame* theFrame)
-{
-	FillColourBars(theFrame, false);
-}
-static inline void FillReverseColourBars(IDeckLinkVideoFrame* theFrame)
-{
-	FillColourBars(theFrame, true);
-}
-void FillBlack(IDeckLinkVideoFrame* theFrame);
-int GetRowBytes(BMDPixelFormat pixelFormat, int frameWidth);
@@ -0,0 +1,250 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "TimecodedVideoFrame.h"
+
+static inline bool CompareREFIID(const REFIID& ref1, const REFIID& ref2)
+{
+	return memcmp(&ref1, &ref2, sizeof(REFIID)) == 0;
+}
+
+static inline uint32_t ToBCD(uint8_t value)
+{
+	return ((value / 10) << 4) | (value % 10);
+}
+
+FrameTimecode::FrameTimecode(uint8_t hours, uint8_t minutes, uint8_t seconds, uint8_t frames, BMDTimecodeFlags flags) :
+	m_hours(hours),
+	m_minutes(minutes),
+	m_seconds(seconds),
+	m_frames(frames),
+	m_flags(flags),
+	m_refCount(1)
+{
+}
+
+HRESULT FrameTimecode::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (CompareREFIID(iid, IID_IUnknown) || CompareREFIID(iid, IID_IDeckLinkTimecode))
+	{
+		*ppv = static_cast<IDeckLinkTimecode*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = NULL;
+	return E_NOINTERFACE;
+}
+
+ULONG FrameTimecode::AddRef(void)
+{
+	// gcc atomic operation builtin
+	return __sync_add_and_fetch(&m_refCount, 1);
+}
+
+ULONG FrameTimecode::Release(void)
+{
+	// gcc atomic operation builtin
+	ULONG newRefValue = __sync_sub_and_fetch(&m_refCount, 1);
+	if (!newRefValue)
+		delete this;
+	return newRefValue;
+}
+
+BMDTimecodeBCD FrameTimecode::GetBCD(void)
+{
+	return (ToBCD(m_hours) << 24) | (ToBCD(m_minutes) << 16) | (ToBCD(m_seconds) << 8) | ToBCD(m_frames);
+}
+
+HRESULT FrameTimecode::GetComponents(uint8_t* hours, uint8_t* minutes, uint8_t* seconds, uint8_t* frames)
+{
+	*hours = m_hours;
+	*minutes = m_minutes;
+	*seconds = m_seconds;
+	*frames = m_frames;
+	return S_OK;
+}
+
+HRESULT FrameTimecode::GetString(const char** timecode)
+{
+	char	buffer[16];
+
+	// The caller frees the string
+	snprintf(buffer, sizeof(buffer), "%02u:%02u:%02u%c%02u", m_hours, m_minutes, m_seconds, (m_flags & bmdTimecodeIsDropFrame) ? ';' : ':', m_frames);
+	*timecode = strdup(buffer);
+	return (*timecode != NULL) ? S_OK : E_OUTOFMEMORY;
+}
+
+BMDTimecodeFlags FrameTimecode::GetFlags(void)
+{
+	return m_flags;
+}
+
+HRESULT FrameTimecode::GetTimecodeUserBits(BMDTimecodeUserBits* userBits)
+{
+	*userBits = 0;
+	return S_OK;
+}
+
+TimecodedVideoFrame::TimecodedVideoFrame(IDeckLinkVideoFrame* sharedFrame) :
+	m_sharedFrame(sharedFrame),
+	m_timecodeCount(0),
+	m_refCount(1)
+{
+	m_sharedFrame->AddRef();
+}
+
+TimecodedVideoFrame::~TimecodedVideoFrame()
+{
+	m_sharedFrame->Release();
+	m_sharedFrame = NULL;
+}
+
+HRESULT TimecodedVideoFrame::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (CompareREFIID(iid, IID_IUnknown) || CompareREFIID(iid, IID_IDeckLinkVideoFrame))
+	{
+		*ppv = static_cast<IDeckLinkVideoFrame*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = NULL;
+	return E_NOINTERFACE;
+}
+
+ULONG TimecodedVideoFrame::AddRef(void)
+{
+	// gcc atomic operation builtin
+	return __sync_add_and_fetch(&m_refCount, 1);
+}
+
+ULONG TimecodedVideoFrame::Release(void)
+{
+	// gcc atomic operation builtin
+	ULONG newRefValue = __sync_sub_and_fetch(&m_refCount, 1);
+	if (!newRefValue)
+		delete this;
+	return newRefValue;
+}
+
+long TimecodedVideoFrame::GetWidth(void)
+{
+	return m_sharedFrame->GetWidth();
+}
+
+long TimecodedVideoFrame::GetHeight(void)
+{
+	return m_sharedFrame->GetHeight();
+}
+
+long TimecodedVideoFrame::GetRowBytes(void)
+{
+	return m_sharedFrame->GetRowBytes();
+}
+
+BMDPixelFormat TimecodedVideoFrame::GetPixelFormat(void)
+{
+	return m_sharedFrame->GetPixelFormat();
+}
+
+BMDFrameFlags TimecodedVideoFrame::GetFlags(void)
+{
+	return m_sharedFrame->GetFlags();
+}
+
+HRESULT TimecodedVideoFrame::GetBytes(void** buffer)
+{
+	return m_sharedFrame->GetBytes(buffer);
+}
+
+HRESULT TimecodedVideoFrame::GetTimecode(BMDTimecodeFormat format, IDeckLinkTimecode** timecode)
+{
+	*timecode = NULL;
+
+	for (int i = 0; i < m_timecodeCount; i++)
+	{
+		if (m_timecodes[i].format == format)
+		{
+			*timecode = new FrameTimecode(m_timecodes[i].hours, m_timecodes[i].minutes, m_timecodes[i].seconds, m_timecodes[i].frames, m_timecodes[i].flags);
+			return S_OK;
+		}
+	}
+
+	return S_FALSE;
+}
+
+HRESULT TimecodedVideoFrame::GetAncillaryData(IDeckLinkVideoFrameAncillary** ancillary)
+{
+	*ancillary = NULL;
+	return S_FALSE;
+}
+
+void TimecodedVideoFrame::ClearTimecodes(void)
+{
+	m_timecodeCount = 0;
+}
+
+void TimecodedVideoFrame::SetTimecode(BMDTimecodeFormat format, uint8_t hours, uint8_t minutes, uint8_t seconds, uint8_t frames, BMDTimecodeFlags flags)
+{
+	int i;
+
+	for (i = 0; i < m_timecodeCount; i++)
+	{
+		if (m_timecodes[i].format == format)
+			break;
+	}
+
+	if (i == kMaxTimecodes)
+		return;
+
+	if (i == m_timecodeCount)
+		m_timecodeCount++;
+
+	m_timecodes[i].format = format;
+	m_timecodes[i].hours = hours;
+	m_timecodes[i].minutes = minutes;
+	m_timecodes[i].seconds = seconds;
+	m_timecodes[i].frames = frames;
+	m_timecodes[i].flags = flags;
+}
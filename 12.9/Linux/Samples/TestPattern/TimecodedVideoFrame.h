@@ -0,0 +1,123 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef TIMECODED_VIDEO_FRAME_H
+#define TIMECODED_VIDEO_FRAME_H
+
+#include "DeckLinkAPI.h"
+
+// A timecode value handed to the DeckLink API by TimecodedVideoFrame::GetTimecode
+class FrameTimecode : public IDeckLinkTimecode
+{
+public:
+	FrameTimecode(uint8_t hours, uint8_t minutes, uint8_t seconds, uint8_t frames, BMDTimecodeFlags flags);
+
+	// IUnknown methods
+	virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv);
+	virtual ULONG STDMETHODCALLTYPE AddRef(void);
+	virtual ULONG STDMETHODCALLTYPE Release(void);
+
+	// IDeckLinkTimecode methods
+	virtual BMDTimecodeBCD GetBCD(void);
+	virtual HRESULT GetComponents(uint8_t* hours, uint8_t* minutes, uint8_t* seconds, uint8_t* frames);
+	virtual HRESULT GetString(const char** timecode);
+	virtual BMDTimecodeFlags GetFlags(void);
+	virtual HRESULT GetTimecodeUserBits(BMDTimecodeUserBits* userBits);
+
+private:
+	virtual ~FrameTimecode() {}
+
+	uint8_t				m_hours;
+	uint8_t				m_minutes;
+	uint8_t				m_seconds;
+	uint8_t				m_frames;
+	BMDTimecodeFlags	m_flags;
+	int32_t				m_refCount;
+};
+
+// Shows the pixels of a shared, read-only frame with a timecode of its own, so each output
+// can stamp its own timecode on a frame rendered once for every output of the same format
+class TimecodedVideoFrame : public IDeckLinkVideoFrame
+{
+public:
+	TimecodedVideoFrame(IDeckLinkVideoFrame* sharedFrame);
+
+	// IUnknown methods
+	virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv);
+	virtual ULONG STDMETHODCALLTYPE AddRef(void);
+	virtual ULONG STDMETHODCALLTYPE Release(void);
+
+	// IDeckLinkVideoFrame methods
+	virtual long GetWidth(void);
+	virtual long GetHeight(void);
+	virtual long GetRowBytes(void);
+	virtual BMDPixelFormat GetPixelFormat(void);
+	virtual BMDFrameFlags GetFlags(void);
+	virtual HRESULT GetBytes(/* out */ void** buffer);
+
+	virtual HRESULT GetTimecode(/* in */ BMDTimecodeFormat format, /* out */ IDeckLinkTimecode** timecode);
+	virtual HRESULT GetAncillaryData(/* out */ IDeckLinkVideoFrameAncillary** ancillary);
+
+	// Only called while the frame is not scheduled
+	void ClearTimecodes(void);
+	void SetTimecode(BMDTimecodeFormat format, uint8_t hours, uint8_t minutes, uint8_t seconds, uint8_t frames, BMDTimecodeFlags flags);
+
+private:
+	virtual ~TimecodedVideoFrame();
+
+	static const int kMaxTimecodes = 4;
+
+	struct Timecode
+	{
+		BMDTimecodeFormat	format;
+		uint8_t				hours;
+		uint8_t				minutes;
+		uint8_t				seconds;
+		uint8_t				frames;
+		BMDTimecodeFlags	flags;
+	};
+
+	IDeckLinkVideoFrame*	m_sharedFrame;
+	Timecode				m_timecodes[kMaxTimecodes];
+	int						m_timecodeCount;
+	int32_t					m_refCount;
+};
+
+#endif
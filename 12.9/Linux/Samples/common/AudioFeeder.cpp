@@ -0,0 +1,386 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <limits>
+#include <stdlib.h>
+#include <string.h>
+
+#include "AudioFeeder.h"
+
+// A stream time that rounds to within this many sample frames of the previous write follows on from it
+static const int64_t	kPositionTolerance	= 2;
+// The prediction is corrected when it differs from the device's count by more than 10ms
+static const int64_t	kResyncTolerance	= AudioFeeder::kSampleRate / 100;
+
+AudioFeeder::AudioFeeder(IDeckLinkOutput* deckLinkOutput) :
+	m_deckLinkOutput(deckLinkOutput),
+	m_ringBodySampleFrames(0),
+	m_ringTailSampleFrames(0),
+	m_bytesPerSampleFrame(0),
+	m_settings(),
+	m_active(false),
+	m_looping(false),
+	m_started(false),
+	m_firstPosition(0),
+	m_ringOrigin(0),
+	m_scheduledPosition(0),
+	m_writePosition(0),
+	m_positionCorrection(0),
+	m_lastResyncPosition(0),
+	m_inUnderrun(false),
+	m_statistics()
+{
+}
+
+AudioFeeder::~AudioFeeder()
+{
+	stop();
+}
+
+bool AudioFeeder::startLoop(const AudioFeederSettings& settings, const void* period, uint32_t periodSampleFrames, int64_t startPosition)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	uint32_t	minimumSampleFrames;
+	uint32_t	bodySampleFrames;
+	uint32_t	periodBytes;
+
+	if ((period == nullptr) || (periodSampleFrames == 0) || (settings.waterLevel == 0))
+		return false;
+
+	// Whole periods, so the signal carries on unbroken where the ring wraps
+	minimumSampleFrames = std::max(settings.ringSampleFrames, settings.waterLevel);
+	bodySampleFrames = ((minimumSampleFrames + periodSampleFrames - 1) / periodSampleFrames) * periodSampleFrames;
+	allocateRing(settings, bodySampleFrames);
+
+	periodBytes = periodSampleFrames * m_bytesPerSampleFrame;
+	for (uint32_t offset = 0; offset < bodySampleFrames; offset += periodSampleFrames)
+		memcpy(m_ring.data() + (size_t)offset * m_bytesPerSampleFrame, period, periodBytes);
+	memcpy(m_ring.data() + (size_t)bodySampleFrames * m_bytesPerSampleFrame, m_ring.data(), (size_t)m_ringTailSampleFrames * m_bytesPerSampleFrame);
+
+	m_looping = true;
+	m_started = true;
+	m_firstPosition = startPosition;
+	m_ringOrigin = startPosition;
+	m_scheduledPosition = startPosition;
+	m_writePosition = startPosition;
+	m_lastResyncPosition = startPosition;
+	m_active = true;
+
+	return true;
+}
+
+bool AudioFeeder::startStream(const AudioFeederSettings& settings)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (settings.waterLevel == 0)
+		return false;
+
+	allocateRing(settings, std::max(settings.ringSampleFrames, settings.waterLevel));
+
+	// The timeline starts with the first write
+	m_looping = false;
+	m_started = false;
+	m_active = true;
+
+	return true;
+}
+
+void AudioFeeder::stop()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// The ring is kept, a restart with the same settings reuses it
+	m_active = false;
+	m_started = false;
+}
+
+void AudioFeeder::feed()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	int64_t		bufferedSampleFrames;
+
+	if (!m_active || !m_started)
+		return;
+
+	bufferedSampleFrames = predictBufferedSampleFrames();
+	updateMargin(bufferedSampleFrames);
+
+	if (!m_looping)
+	{
+		// Anything the device could not take when it was written
+		schedulePending();
+		return;
+	}
+
+	if (bufferedSampleFrames < 0)
+	{
+		// The output ran dry, so carry on from where it is playing now rather than falling further behind
+		m_scheduledPosition -= bufferedSampleFrames;
+		bufferedSampleFrames = 0;
+	}
+
+	if (bufferedSampleFrames < m_settings.waterLevel)
+		scheduleSpan((uint32_t)(m_settings.waterLevel - bufferedSampleFrames));
+}
+
+bool AudioFeeder::write(const void* samples, uint32_t sampleFrameCount, BMDTimeValue streamTime, BMDTimeScale timeScale)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	int64_t		position;
+	int64_t		pendingSampleFrames;
+
+	if (!m_active || m_looping || (timeScale <= 0))
+		return false;
+
+	position = (streamTime * kSampleRate + timeScale / 2) / timeScale;
+
+	if (!m_started)
+	{
+		m_firstPosition = position;
+		m_ringOrigin = position;
+		m_scheduledPosition = position;
+		m_writePosition = position;
+		m_lastResyncPosition = position;
+		m_started = true;
+	}
+	else
+	{
+		int64_t gap = position - m_writePosition;
+
+		if (std::abs(gap) <= kPositionTolerance)
+		{
+			// Rounding of the stream time, the samples follow on from the last write
+		}
+		else if ((gap > 0) && (gap <= m_settings.waterLevel) &&
+				 (m_writePosition - m_scheduledPosition + gap + sampleFrameCount <= m_ringBodySampleFrames))
+		{
+			// Fill a short gap, such as a dropped input frame, with silence so the spans stay contiguous
+			copyIntoRing(m_writePosition, nullptr, (uint32_t)gap);
+			m_writePosition = position;
+		}
+		else
+		{
+			// Start again from the new stream time, dropping anything not yet scheduled
+			m_statistics.discontinuities++;
+			m_statistics.droppedSampleFrames += m_writePosition - m_scheduledPosition;
+			m_ringOrigin = position;
+			m_scheduledPosition = position;
+			m_writePosition = position;
+			m_firstPosition = std::min(m_firstPosition, position);
+		}
+	}
+
+	pendingSampleFrames = m_writePosition - m_scheduledPosition;
+	if (pendingSampleFrames + sampleFrameCount > m_ringBodySampleFrames)
+	{
+		// The device has stopped taking samples
+		m_statistics.droppedSampleFrames += sampleFrameCount;
+		return false;
+	}
+
+	copyIntoRing(m_writePosition, samples, sampleFrameCount);
+	m_writePosition += sampleFrameCount;
+
+	updateMargin(predictBufferedSampleFrames());
+	schedulePending();
+
+	return true;
+}
+
+int64_t AudioFeeder::getBufferedSampleFrames()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_active || !m_started)
+		return 0;
+
+	return predictBufferedSampleFrames();
+}
+
+void AudioFeeder::getStatistics(AudioFeederStatistics& statistics)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_active && m_started)
+		m_statistics.bufferedSampleFrames = predictBufferedSampleFrames();
+
+	statistics = m_statistics;
+}
+
+void AudioFeeder::allocateRing(const AudioFeederSettings& settings, uint32_t bodySampleFrames)
+{
+	m_settings = settings;
+	m_bytesPerSampleFrame = settings.channelCount * (settings.sampleDepth / 8);
+	m_ringBodySampleFrames = bodySampleFrames;
+	m_ringTailSampleFrames = settings.waterLevel;
+
+	// Allocated once here, never while feeding
+	m_ring.assign((size_t)(m_ringBodySampleFrames + m_ringTailSampleFrames) * m_bytesPerSampleFrame, 0);
+
+	m_positionCorrection = 0;
+	m_inUnderrun = false;
+	m_statistics = AudioFeederStatistics();
+	m_statistics.minimumMargin = std::numeric_limits<int64_t>::max();
+}
+
+void AudioFeeder::copyIntoRing(int64_t position, const void* samples, uint32_t sampleFrameCount)
+{
+	const uint8_t*	source = (const uint8_t*)samples;
+	uint32_t		index = (uint32_t)(((position - m_ringOrigin) % m_ringBodySampleFrames + m_ringBodySampleFrames) % m_ringBodySampleFrames);
+
+	while (sampleFrameCount > 0)
+	{
+		uint32_t	count = std::min(sampleFrameCount, m_ringBodySampleFrames - index);
+		size_t		bytes = (size_t)count * m_bytesPerSampleFrame;
+		uint8_t*	destination = m_ring.data() + (size_t)index * m_bytesPerSampleFrame;
+
+		if (source != nullptr)
+			memcpy(destination, source, bytes);
+		else
+			memset(destination, 0, bytes);
+
+		// Keep the mirror past the end of the ring up to date
+		if (index < m_ringTailSampleFrames)
+			memcpy(m_ring.data() + (size_t)(m_ringBodySampleFrames + index) * m_bytesPerSampleFrame, destination,
+				   (size_t)std::min(count, m_ringTailSampleFrames - index) * m_bytesPerSampleFrame);
+
+		if (source != nullptr)
+			source += bytes;
+		index = (index + count) % m_ringBodySampleFrames;
+		sampleFrameCount -= count;
+	}
+}
+
+uint32_t AudioFeeder::scheduleSpan(uint32_t sampleFrameCount)
+{
+	uint32_t	index = (uint32_t)(((m_scheduledPosition - m_ringOrigin) % m_ringBodySampleFrames + m_ringBodySampleFrames) % m_ringBodySampleFrames);
+	uint32_t	sampleFramesWritten = 0;
+	HRESULT		result;
+
+	// The mirror makes any span up to the tail size contiguous from any index in the ring
+	sampleFrameCount = std::min(sampleFrameCount, m_ringTailSampleFrames);
+	if (sampleFrameCount == 0)
+		return 0;
+
+	if (m_settings.timestamped)
+		result = m_deckLinkOutput->ScheduleAudioSamples(m_ring.data() + (size_t)index * m_bytesPerSampleFrame, sampleFrameCount, m_scheduledPosition, kSampleRate, &sampleFramesWritten);
+	else
+		result = m_deckLinkOutput->ScheduleAudioSamples(m_ring.data() + (size_t)index * m_bytesPerSampleFrame, sampleFrameCount, 0, 0, &sampleFramesWritten);
+
+	if (result != S_OK)
+		return 0;
+
+	m_scheduledPosition += sampleFramesWritten;
+	m_statistics.sampleFramesScheduled += sampleFramesWritten;
+	m_statistics.scheduleCalls++;
+
+	return sampleFramesWritten;
+}
+
+void AudioFeeder::schedulePending()
+{
+	while (m_scheduledPosition < m_writePosition)
+	{
+		uint32_t sampleFrameCount = (uint32_t)std::min<int64_t>(m_writePosition - m_scheduledPosition, m_ringTailSampleFrames);
+
+		// Stop if the device buffer is full, feed() picks up the rest on a later callback
+		if (scheduleSpan(sampleFrameCount) < sampleFrameCount)
+			break;
+	}
+}
+
+int64_t AudioFeeder::predictBufferedSampleFrames()
+{
+	BMDTimeValue	streamTime;
+	double			playbackSpeed;
+	int64_t			playedPosition;
+	int64_t			bufferedSampleFrames;
+	uint32_t		deviceBufferedSampleFrames;
+
+	if ((m_deckLinkOutput->GetScheduledStreamTime(kSampleRate, &streamTime, &playbackSpeed) != S_OK) || (playbackSpeed == 0.0))
+	{
+		// Prerolling, nothing has been played yet
+		return m_scheduledPosition - m_firstPosition;
+	}
+
+	m_statistics.running = true;
+	playedPosition = std::max(m_firstPosition, streamTime + m_positionCorrection);
+	bufferedSampleFrames = m_scheduledPosition - playedPosition;
+
+	// Check the prediction against the device about once a second
+	if ((playedPosition - m_lastResyncPosition >= kSampleRate) &&
+		(m_deckLinkOutput->GetBufferedAudioSampleFrameCount(&deviceBufferedSampleFrames) == S_OK))
+	{
+		int64_t error = bufferedSampleFrames - deviceBufferedSampleFrames;
+
+		m_statistics.maximumPredictionError = std::max(m_statistics.maximumPredictionError, std::abs(error));
+		if (std::abs(error) > kResyncTolerance)
+		{
+			m_positionCorrection += error;
+			bufferedSampleFrames = deviceBufferedSampleFrames;
+			m_statistics.resyncs++;
+		}
+		m_lastResyncPosition = playedPosition;
+	}
+
+	return bufferedSampleFrames;
+}
+
+void AudioFeeder::updateMargin(int64_t bufferedSampleFrames)
+{
+	if (!m_statistics.running)
+		return;
+
+	m_statistics.minimumMargin = std::min(m_statistics.minimumMargin, bufferedSampleFrames);
+
+	// Count each time the output runs dry, not every callback while it stays dry
+	if (bufferedSampleFrames <= 0)
+	{
+		if (!m_inUnderrun)
+			m_statistics.underruns++;
+		m_inUnderrun = true;
+	}
+	else
+	{
+		m_inUnderrun = false;
+	}
+}
@@ -0,0 +1,139 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+#include "DeckLinkAPI.h"
+
+// Keeps the audio output of a DeckLink device topped up from a preallocated ring.
+//
+// The ring is mirrored past its end by the size of the largest span, so every span
+// is contiguous in memory and is handed to ScheduleAudioSamples in a single call.
+// How much audio is still buffered in the device is predicted from the scheduled
+// playback clock rather than asked of the driver on every callback; the prediction
+// is checked against GetBufferedAudioSampleFrameCount about once a second, and
+// corrected when the two have drifted apart.
+//
+// A loop repeats one period of a generated signal for as long as it runs, topping
+// the device up to the water level on each RenderAudioSamples callback.  A stream
+// is written as samples arrive, with their stream time, and schedules them at once.
+
+struct AudioFeederSettings
+{
+	uint32_t	channelCount;
+	uint32_t	sampleDepth;			// 16 or 32
+	bool		timestamped;			// Audio output was enabled with bmdAudioOutputStreamTimestamped
+	uint32_t	waterLevel;				// Sample frames to keep buffered in the device, and the largest span
+	uint32_t	ringSampleFrames;		// Size of the ring, at least the water level
+};
+
+struct AudioFeederStatistics
+{
+	uint64_t	sampleFramesScheduled;
+	uint64_t	scheduleCalls;
+	uint64_t	underruns;				// Times the device buffer was predicted to have run dry
+	uint64_t	discontinuities;		// Stream writes that did not follow on from the previous write
+	uint64_t	droppedSampleFrames;	// Stream writes that did not fit in the ring
+	uint64_t	resyncs;				// Times the prediction was corrected from the device's count
+	int64_t		maximumPredictionError;	// Largest difference from the device's count, in sample frames
+	int64_t		minimumMargin;			// Fewest sample frames buffered ahead of the output while running
+	int64_t		bufferedSampleFrames;	// Currently predicted
+	bool		running;				// Scheduled playback has started, so the margin is valid
+};
+
+class AudioFeeder
+{
+public:
+	static const uint32_t kSampleRate = bmdAudioSampleRate48kHz;
+
+	// The output must outlive the feeder
+	explicit AudioFeeder(IDeckLinkOutput* deckLinkOutput);
+	~AudioFeeder();
+
+	// Repeats periodSampleFrames of samples, starting at sample frame startPosition of the timeline
+	bool		startLoop(const AudioFeederSettings& settings, const void* period, uint32_t periodSampleFrames, int64_t startPosition = 0);
+	// Schedules samples as they are written
+	bool		startStream(const AudioFeederSettings& settings);
+	void		stop(void);
+
+	// Tops the device up to the water level, call from IDeckLinkAudioOutputCallback::RenderAudioSamples
+	void		feed(void);
+	// Copies samples into the ring at their stream time and schedules everything pending
+	bool		write(const void* samples, uint32_t sampleFrameCount, BMDTimeValue streamTime, BMDTimeScale timeScale);
+
+	// Sample frames predicted to be buffered in the device
+	int64_t		getBufferedSampleFrames(void);
+	void		getStatistics(AudioFeederStatistics& statistics);
+
+private:
+	void		allocateRing(const AudioFeederSettings& settings, uint32_t bodySampleFrames);
+	void		copyIntoRing(int64_t position, const void* samples, uint32_t sampleFrameCount);
+	uint32_t	scheduleSpan(uint32_t sampleFrameCount);
+	void		schedulePending(void);
+	int64_t		predictBufferedSampleFrames(void);
+	void		updateMargin(int64_t bufferedSampleFrames);
+
+	IDeckLinkOutput*		m_deckLinkOutput;
+	std::mutex				m_mutex;
+
+	std::vector<uint8_t>	m_ring;
+	uint32_t				m_ringBodySampleFrames;
+	uint32_t				m_ringTailSampleFrames;
+	uint32_t				m_bytesPerSampleFrame;
+	AudioFeederSettings		m_settings;
+	bool					m_active;
+	bool					m_looping;
+	bool					m_started;				// A stream has been written to
+
+	// Positions are in sample frames on the output timeline
+	int64_t					m_firstPosition;		// Where playback of the feeder's audio begins
+	int64_t					m_ringOrigin;			// Position of ring index 0
+	int64_t					m_scheduledPosition;	// End of the audio handed to the device
+	int64_t					m_writePosition;		// End of the audio written to a stream
+	int64_t					m_positionCorrection;	// Added to the playback clock, from the last resync
+	int64_t					m_lastResyncPosition;
+	bool					m_inUnderrun;
+
+	AudioFeederStatistics	m_statistics;
+};
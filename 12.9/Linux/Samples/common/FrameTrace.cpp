@@ -0,0 +1,338 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "FrameTrace.h"
+
+static const size_t		kDefaultEventCapacity	= 1 << 18;
+
+// Written by any thread without locks.  The sequence is odd while an event is being
+// written, so an event that is overwritten while the trace is written out is skipped.
+struct FrameTrace::Event
+{
+	std::atomic<uint64_t>	sequence;
+	const char*				name;
+	uint64_t				frame;
+	uint64_t				startTime;
+	uint64_t				duration;
+	uint32_t				thread;
+	char					phase;				// 'X' complete span, 'i' instant
+};
+
+std::atomic<bool>		FrameTrace::s_recording(false);
+std::atomic<uint64_t>	FrameTrace::s_nextEvent(0);
+FrameTrace::Event*		FrameTrace::s_events = nullptr;
+size_t					FrameTrace::s_eventMask = 0;
+const char*				FrameTrace::s_path = nullptr;
+
+static std::mutex							g_threadNamesMutex;
+static std::map<uint32_t, std::string>		g_threadNames;
+
+static uint32_t currentThreadID(void)
+{
+	static thread_local uint32_t threadID = 0;
+
+	if (threadID == 0)
+		threadID = (uint32_t)syscall(SYS_gettid);
+
+	return threadID;
+}
+
+uint64_t FrameTrace::now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void FrameTrace::startFromEnvironment()
+{
+	const char*	path = getenv("FRAME_TRACE_FILE");
+	const char*	events = getenv("FRAME_TRACE_EVENTS");
+
+	if (path == nullptr || *path == '\0')
+		return;
+
+	if (!start(path, events != nullptr ? strtoul(events, nullptr, 0) : kDefaultEventCapacity))
+		fprintf(stderr, "Unable to start frame tracing\n");
+}
+
+bool FrameTrace::start(const char* path, size_t eventCapacity)
+{
+	size_t capacity = 1;
+
+	if (s_events != nullptr || eventCapacity == 0)
+		return false;
+
+	// A power of two, so the ring index is a mask of the event count
+	while (capacity < eventCapacity)
+		capacity <<= 1;
+
+	s_events = new (std::nothrow) Event[capacity];
+	if (s_events == nullptr)
+		return false;
+
+	for (size_t i = 0; i < capacity; i++)
+		s_events[i].sequence.store(0, std::memory_order_relaxed);
+
+	s_eventMask	= capacity - 1;
+	s_path		= strdup(path);
+	s_nextEvent.store(0, std::memory_order_relaxed);
+	s_recording.store(true, std::memory_order_release);
+
+	return true;
+}
+
+void FrameTrace::stop()
+{
+	if (s_events == nullptr)
+		return;
+
+	s_recording.store(false, std::memory_order_release);
+
+	if (writeChromeTrace(s_path))
+		fprintf(stderr, "Frame trace written to %s\n", s_path);
+	else
+		fprintf(stderr, "Unable to write frame trace to %s\n", s_path);
+
+	// Threads may still be finishing an event they started before recording
+	// stopped, so the ring is left allocated
+	free((void*)s_path);
+	s_path = nullptr;
+}
+
+void FrameTrace::recordSpan(const char* name, uint64_t frame, uint64_t startTime, uint64_t endTime)
+{
+#if defined(FRAME_TRACE_USDT)
+	DTRACE_PROBE4(decklink_sample, frame_span, name, frame, startTime, endTime - startTime);
+#endif
+	if (isRecording())
+		record(name, frame, startTime, endTime > startTime ? endTime - startTime : 0, 'X');
+}
+
+void FrameTrace::recordInstant(const char* name, uint64_t frame)
+{
+#if defined(FRAME_TRACE_USDT)
+	DTRACE_PROBE2(decklink_sample, frame_instant, name, frame);
+#endif
+	if (isRecording())
+		record(name, frame, now(), 0, 'i');
+}
+
+void FrameTrace::record(const char* name, uint64_t frame, uint64_t startTime, uint64_t duration, char phase)
+{
+	uint64_t	index = s_nextEvent.fetch_add(1, std::memory_order_relaxed);
+	Event&		event = s_events[index & s_eventMask];
+
+	event.sequence.store(index * 2 + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	event.name		= name;
+	event.frame		= frame;
+	event.startTime	= startTime;
+	event.duration	= duration;
+	event.thread	= currentThreadID();
+	event.phase		= phase;
+
+	event.sequence.store(index * 2 + 2, std::memory_order_release);
+}
+
+void FrameTrace::nameThread(const char* name)
+{
+	std::lock_guard<std::mutex> lock(g_threadNamesMutex);
+	g_threadNames[currentThreadID()] = name;
+}
+
+static std::string threadName(uint32_t threadID)
+{
+	char		path[64];
+	char		name[64] = "";
+	FILE*		file;
+
+	{
+		std::lock_guard<std::mutex> lock(g_threadNamesMutex);
+		auto iter = g_threadNames.find(threadID);
+		if (iter != g_threadNames.end())
+			return iter->second;
+	}
+
+	// Threads that have exited since are left unnamed
+	snprintf(path, sizeof(path), "/proc/self/task/%u/comm", threadID);
+	file = fopen(path, "r");
+	if (file != nullptr)
+	{
+		if (fgets(name, sizeof(name), file) != nullptr)
+			name[strcspn(name, "\n")] = '\0';
+		fclose(file);
+	}
+
+	return (*name != '\0') ? name : "thread " + std::to_string(threadID);
+}
+
+static void writeJSONString(FILE* file, const char* string)
+{
+	fputc('"', file);
+	for (const char* c = string; *c != '\0'; c++)
+	{
+		if (*c == '"' || *c == '\\')
+			fputc('\\', file);
+		if ((unsigned char)*c >= 0x20)
+			fputc(*c, file);
+	}
+	fputc('"', file);
+}
+
+bool FrameTrace::writeChromeTrace(const char* path)
+{
+	struct Copy
+	{
+		const char*		name;
+		uint64_t		frame;
+		uint64_t		startTime;
+		uint64_t		duration;
+		uint32_t		thread;
+		char			phase;
+	};
+
+	std::vector<Copy>						events;
+	std::unordered_map<uint64_t, int>		spansPerFrame;
+	std::unordered_map<uint64_t, int>		spansWritten;
+	std::map<uint32_t, bool>				threads;
+	uint64_t								lastEvent = s_nextEvent.load(std::memory_order_acquire);
+	uint64_t								firstEvent = (lastEvent > s_eventMask + 1) ? lastEvent - s_eventMask - 1 : 0;
+	uint64_t								baseTime = UINT64_MAX;
+	FILE*									file;
+	bool									first = true;
+
+	// Copy out the events that were completely written and not overwritten since
+	for (uint64_t index = firstEvent; index < lastEvent; index++)
+	{
+		const Event&	event = s_events[index & s_eventMask];
+		Copy			copy;
+
+		if (event.sequence.load(std::memory_order_acquire) != index * 2 + 2)
+			continue;
+
+		copy.name		= event.name;
+		copy.frame		= event.frame;
+		copy.startTime	= event.startTime;
+		copy.duration	= event.duration;
+		copy.thread		= event.thread;
+		copy.phase		= event.phase;
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (event.sequence.load(std::memory_order_relaxed) != index * 2 + 2)
+			continue;
+
+		events.push_back(copy);
+	}
+
+	std::sort(events.begin(), events.end(), [](const Copy& a, const Copy& b) { return a.startTime < b.startTime; });
+
+	for (const Copy& event : events)
+	{
+		baseTime = std::min(baseTime, event.startTime);
+		threads[event.thread] = true;
+		if (event.phase == 'X' && event.frame != kNoFrame)
+			spansPerFrame[event.frame]++;
+	}
+
+	file = fopen(path, "w");
+	if (file == nullptr)
+		return false;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	for (auto& thread : threads)
+	{
+		fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", (int)getpid(), thread.first);
+		writeJSONString(file, threadName(thread.first).c_str());
+		fprintf(file, "}}");
+		first = false;
+	}
+
+	for (const Copy& event : events)
+	{
+		double timestamp = (event.startTime - baseTime) / 1000.0;
+
+		fprintf(file, "%s{\"ph\":\"%c\",\"name\":", first ? "" : ",\n", event.phase);
+		writeJSONString(file, event.name);
+		fprintf(file, ",\"pid\":%d,\"tid\":%u,\"ts\":%.3f", (int)getpid(), event.thread, timestamp);
+
+		if (event.phase == 'X')
+			fprintf(file, ",\"dur\":%.3f", event.duration / 1000.0);
+		else
+			fprintf(file, ",\"s\":\"t\"");
+
+		if (event.frame != kNoFrame)
+			fprintf(file, ",\"args\":{\"frame\":%llu}", (unsigned long long)event.frame);
+		fprintf(file, "}");
+		first = false;
+
+		// Flow events bind to the span they start in, and chain the spans of a frame
+		if (event.phase == 'X' && event.frame != kNoFrame && spansPerFrame[event.frame] > 1)
+		{
+			int		written = spansWritten[event.frame]++;
+			char	flowPhase = (written == 0) ? 's' : (written + 1 == spansPerFrame[event.frame]) ? 'f' : 't';
+
+			fprintf(file, ",\n{\"ph\":\"%c\",\"name\":\"frame\",\"cat\":\"frame\",\"id\":%llu,\"pid\":%d,\"tid\":%u,\"ts\":%.3f%s}",
+				flowPhase, (unsigned long long)event.frame, (int)getpid(), event.thread, timestamp,
+				(flowPhase == 's') ? "" : ",\"bp\":\"e\"");
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+
+	return fclose(file) == 0;
+}
@@ -0,0 +1,156 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Per-frame tracing of the capture and playout pipeline.
+//
+// Each stage marks itself with FRAME_TRACE_SPAN, tagged with the frame it works on.
+// Spans fire a USDT probe (provider decklink_sample, probes frame_span and
+// frame_instant) when <sys/sdt.h> is available, so perf and bpftrace can attach
+// without a rebuild, and are recorded into an in-process, lock-free ring of the most
+// recent events while tracing is started.  The ring is written out in Chrome trace
+// JSON, which chrome://tracing and the Perfetto UI both load, with flow arrows that
+// link the spans of each frame across threads.
+//
+// Tracing starts when FRAME_TRACE_FILE names an output file in the environment,
+// FRAME_TRACE_EVENTS optionally sets the ring size.  Defining FRAME_TRACE_DISABLED
+// removes every tracepoint at compile time.
+
+#if !defined(FRAME_TRACE_DISABLED) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define FRAME_TRACE_USDT
+#endif
+#endif
+
+class FrameTrace
+{
+public:
+	static const uint64_t kNoFrame = UINT64_MAX;
+
+	// Reads FRAME_TRACE_FILE and FRAME_TRACE_EVENTS, and starts recording if set
+	static void		startFromEnvironment(void);
+	static bool		start(const char* path, size_t eventCapacity);
+	// Stops recording and writes the trace, if one was started
+	static void		stop(void);
+
+	static bool		isRecording(void) { return s_recording.load(std::memory_order_relaxed); }
+	// CLOCK_MONOTONIC_RAW in nanoseconds, the clock of the DeckLink reference timestamps
+	static uint64_t	now(void);
+
+	// Fire the USDT probe, and record the event while tracing is started
+	static void		recordSpan(const char* name, uint64_t frame, uint64_t startTime, uint64_t endTime);
+	static void		recordInstant(const char* name, uint64_t frame);
+	// Name shown for the calling thread, otherwise the name from /proc is used
+	static void		nameThread(const char* name);
+
+private:
+	struct Event;
+
+	static void		record(const char* name, uint64_t frame, uint64_t startTime, uint64_t duration, char phase);
+	static bool		writeChromeTrace(const char* path);
+
+	static std::atomic<bool>		s_recording;
+	static std::atomic<uint64_t>	s_nextEvent;
+	static Event*					s_events;
+	static size_t					s_eventMask;
+	static const char*				s_path;
+};
+
+// Times the enclosing scope
+class FrameTraceSpan
+{
+public:
+	FrameTraceSpan(const char* name, uint64_t frame) :
+		m_name(name),
+		m_frame(frame),
+		m_startTime(0)
+	{
+#if defined(FRAME_TRACE_USDT)
+		m_startTime = FrameTrace::now();
+#else
+		if (FrameTrace::isRecording())
+			m_startTime = FrameTrace::now();
+#endif
+	}
+
+	~FrameTraceSpan()
+	{
+		if (m_startTime != 0)
+			FrameTrace::recordSpan(m_name, m_frame, m_startTime, FrameTrace::now());
+	}
+
+	// For stages that only learn the frame part way through
+	void	setFrame(uint64_t frame) { m_frame = frame; }
+
+private:
+	const char*		m_name;
+	uint64_t		m_frame;
+	uint64_t		m_startTime;
+};
+
+#define FRAME_TRACE_CONCAT_(a, b)	a##b
+#define FRAME_TRACE_CONCAT(a, b)	FRAME_TRACE_CONCAT_(a, b)
+
+#if defined(FRAME_TRACE_DISABLED)
+
+#define FRAME_TRACE_SPAN(name, frame)						do {} while (0)
+#define FRAME_TRACE_NAMED_SPAN(variable, name, frame)		do {} while (0)
+#define FRAME_TRACE_SET_FRAME(variable, frame)				do {} while (0)
+#define FRAME_TRACE_RANGE(name, frame, startTime, endTime)	do { (void)sizeof(startTime); (void)sizeof(endTime); } while (0)
+#define FRAME_TRACE_INSTANT(name, frame)					do {} while (0)
+#define FRAME_TRACE_THREAD_NAME(name)						do {} while (0)
+
+#else
+
+#define FRAME_TRACE_SPAN(name, frame)						FrameTraceSpan FRAME_TRACE_CONCAT(frameTraceSpan, __LINE__)(name, frame)
+#define FRAME_TRACE_NAMED_SPAN(variable, name, frame)		FrameTraceSpan variable(name, frame)
+#define FRAME_TRACE_SET_FRAME(variable, frame)				variable.setFrame(frame)
+// A span measured elsewhere, in FrameTrace::now() nanoseconds
+#define FRAME_TRACE_RANGE(name, frame, startTime, endTime)	FrameTrace::recordSpan(name, frame, startTime, endTime)
+#define FRAME_TRACE_INSTANT(name, frame)					FrameTrace::recordInstant(name, frame)
+#define FRAME_TRACE_THREAD_NAME(name)						FrameTrace::nameThread(name)
+
+#endif